@@ -0,0 +1,104 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "app/boot_metrics.h"
+
+static uint32_t ulSchedulerStartMs = 0;
+static uint32_t ulReachedMask = 0;
+static uint32_t pulMilestoneMs[ BOOT_MILESTONE_MAX ] = { 0 };
+
+static const char * const pcMilestoneNames[ BOOT_MILESTONE_MAX ] =
+{
+    [ BOOT_MILESTONE_SCHEDULER_START ] = "scheduler start",
+    [ BOOT_MILESTONE_FS_READY ]        = "filesystem ready",
+    [ BOOT_MILESTONE_TLS_CONFIGURED ]  = "tls configured",
+    [ BOOT_MILESTONE_NET_CONNECTED ]   = "network connected",
+    [ BOOT_MILESTONE_TLS_CONNECTED ]   = "tls connected",
+    [ BOOT_MILESTONE_MQTT_CONNACK ]    = "mqtt connack",
+};
+
+/*-----------------------------------------------------------*/
+
+void vBootMetricsSetPreSchedulerMs( uint32_t ulPreSchedulerMs )
+{
+    ulSchedulerStartMs = ulPreSchedulerMs;
+    pulMilestoneMs[ BOOT_MILESTONE_SCHEDULER_START ] = ulPreSchedulerMs;
+    ulReachedMask |= ( 1UL << BOOT_MILESTONE_SCHEDULER_START );
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulBootMetricsNowMs( void )
+{
+    return ulSchedulerStartMs + ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS );
+}
+
+/*-----------------------------------------------------------*/
+
+void vBootMetricsMark( BootMilestone_t xMilestone )
+{
+    if( xMilestone < BOOT_MILESTONE_MAX )
+    {
+        uint32_t ulNowMs = ulBootMetricsNowMs();
+
+        taskENTER_CRITICAL();
+
+        if( ( ulReachedMask & ( 1UL << xMilestone ) ) == 0 )
+        {
+            pulMilestoneMs[ xMilestone ] = ulNowMs;
+            ulReachedMask |= ( 1UL << xMilestone );
+        }
+
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool xBootMetricsGet( BootMilestone_t xMilestone,
+                      uint32_t * pulTimeMs )
+{
+    bool xReached = false;
+
+    if( ( xMilestone < BOOT_MILESTONE_MAX ) &&
+        ( pulTimeMs != NULL ) )
+    {
+        taskENTER_CRITICAL();
+
+        xReached = ( ( ulReachedMask & ( 1UL << xMilestone ) ) != 0 );
+        *pulTimeMs = pulMilestoneMs[ xMilestone ];
+
+        taskEXIT_CRITICAL();
+    }
+
+    return xReached;
+}
+
+/*-----------------------------------------------------------*/
+
+const char * pcBootMetricsName( BootMilestone_t xMilestone )
+{
+    return ( xMilestone < BOOT_MILESTONE_MAX ) ? pcMilestoneNames[ xMilestone ] : "unknown";
+}
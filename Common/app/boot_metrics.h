@@ -0,0 +1,73 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file boot_metrics.h
+ * @brief Time from power-on to each stage of bringing up the MQTT connection.
+ *
+ * Each milestone records the first time it is reached after reset, in
+ * milliseconds since hw_init enabled the cycle counter.
+ */
+
+#ifndef APP_BOOT_METRICS_H_
+#define APP_BOOT_METRICS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    BOOT_MILESTONE_SCHEDULER_START = 0,
+    BOOT_MILESTONE_FS_READY,
+    BOOT_MILESTONE_TLS_CONFIGURED, /*!< Keys and certificates for the MQTT connection loaded */
+    BOOT_MILESTONE_NET_CONNECTED,
+    BOOT_MILESTONE_TLS_CONNECTED,  /*!< TLS handshake with the MQTT broker complete */
+    BOOT_MILESTONE_MQTT_CONNACK,
+    BOOT_MILESTONE_MAX
+} BootMilestone_t;
+
+/**
+ * @brief Record the time spent before the scheduler started. Called once from main.
+ */
+void vBootMetricsSetPreSchedulerMs( uint32_t ulPreSchedulerMs );
+
+/**
+ * @brief Milliseconds since power-on.
+ */
+uint32_t ulBootMetricsNowMs( void );
+
+/**
+ * @brief Record a milestone. Only the first call for each milestone has an effect.
+ */
+void vBootMetricsMark( BootMilestone_t xMilestone );
+
+/**
+ * @brief Get the time a milestone was reached.
+ *
+ * @return false if the milestone has not been reached since reset.
+ */
+bool xBootMetricsGet( BootMilestone_t xMilestone,
+                      uint32_t * pulTimeMs );
+
+const char * pcBootMetricsName( BootMilestone_t xMilestone );
+
+#endif /* APP_BOOT_METRICS_H_ */
@@ -0,0 +1,189 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "logging_levels.h"
+
+#define LOG_LEVEL    LOG_INFO
+
+#include "logging.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "event_groups.h"
+
+#include <stdio.h>
+
+#include "app/boot_metrics.h"
+#include "app/boot_stages.h"
+
+/* Enough for the names of all stages on the critical path */
+#define BOOT_STAGES_PATH_STR_LEN    ( 128 )
+
+static const BootStage_t * pxRunStages = NULL;
+static EventGroupHandle_t xStageEvents = NULL;
+static BootTimelineEntry_t xTimeline[ BOOT_TIMELINE_MAX_STAGES ];
+static size_t uxTimelineLen = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvEndStage( size_t uxIndex,
+                         BaseType_t xResult )
+{
+    xTimeline[ uxIndex ].ulEndMs = ulBootMetricsNowMs();
+    xTimeline[ uxIndex ].xState = ( xResult == pdTRUE ) ? BOOT_STAGE_DONE : BOOT_STAGE_FAILED;
+
+    ( void ) xEventGroupSetBits( xStageEvents, ( EventBits_t ) BOOT_STAGE_DEP( uxIndex ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvStageTask( void * pvParameters )
+{
+    size_t uxIndex = ( size_t ) pvParameters;
+    const BootStage_t * pxStage = &( pxRunStages[ uxIndex ] );
+
+    if( pxStage->ulDependsOn != 0 )
+    {
+        ( void ) xEventGroupWaitBits( xStageEvents,
+                                      ( EventBits_t ) pxStage->ulDependsOn,
+                                      pdFALSE,
+                                      pdTRUE,
+                                      portMAX_DELAY );
+    }
+
+    xTimeline[ uxIndex ].ulStartMs = ulBootMetricsNowMs();
+    xTimeline[ uxIndex ].xState = BOOT_STAGE_RUNNING;
+
+    prvEndStage( uxIndex, pxStage->xFunction() );
+
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvLogTimeline( void )
+{
+    uint8_t pucPath[ BOOT_TIMELINE_MAX_STAGES ];
+    char pcPath[ BOOT_STAGES_PATH_STR_LEN ] = { 0 };
+    size_t uxPathLen = uxBootTimelineCriticalPath( xTimeline, uxTimelineLen, pucPath, BOOT_TIMELINE_MAX_STAGES );
+    size_t uxOffset = 0;
+
+    for( size_t i = 0; i < uxTimelineLen; i++ )
+    {
+        LogInfo( "Boot stage %-10s start: %6lu ms, end: %6lu ms, took: %6lu ms%s",
+                 xTimeline[ i ].pcName,
+                 ( unsigned long ) xTimeline[ i ].ulStartMs,
+                 ( unsigned long ) xTimeline[ i ].ulEndMs,
+                 ( unsigned long ) ( xTimeline[ i ].ulEndMs - xTimeline[ i ].ulStartMs ),
+                 ( xTimeline[ i ].xState == BOOT_STAGE_FAILED ) ? ", failed" : "" );
+    }
+
+    for( size_t i = 0; ( i < uxPathLen ) && ( uxOffset < sizeof( pcPath ) ); i++ )
+    {
+        int lLen = snprintf( &( pcPath[ uxOffset ] ), sizeof( pcPath ) - uxOffset, "%s%s",
+                             ( i > 0 ) ? " > " : "",
+                             xTimeline[ pucPath[ i ] ].pcName );
+
+        uxOffset = ( lLen > 0 ) ? ( uxOffset + ( size_t ) lLen ) : sizeof( pcPath );
+    }
+
+    if( uxPathLen > 0 )
+    {
+        LogInfo( "Boot critical path: %s, %lu ms.",
+                 pcPath,
+                 ( unsigned long ) ( xTimeline[ pucPath[ uxPathLen - 1 ] ].ulEndMs - xTimeline[ pucPath[ 0 ] ].ulStartMs ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xBootStagesRun( const BootStage_t * pxStages,
+                           size_t uxNumStages )
+{
+    BaseType_t xSuccess = pdTRUE;
+    EventBits_t xAllMask = 0;
+
+    configASSERT( pxStages != NULL );
+    configASSERT( uxNumStages <= BOOT_TIMELINE_MAX_STAGES );
+
+    pxRunStages = pxStages;
+    uxTimelineLen = uxNumStages;
+
+    for( size_t i = 0; i < uxNumStages; i++ )
+    {
+        xTimeline[ i ].pcName = pxStages[ i ].pcName;
+        xTimeline[ i ].ulDependsOn = pxStages[ i ].ulDependsOn;
+        xTimeline[ i ].xState = BOOT_STAGE_PENDING;
+        xTimeline[ i ].ulStartMs = 0;
+        xTimeline[ i ].ulEndMs = 0;
+        xAllMask |= ( EventBits_t ) BOOT_STAGE_DEP( i );
+    }
+
+    /* A stage waiting on a cycle would never start */
+    configASSERT( xBootTimelineValidate( xTimeline, uxNumStages ) );
+
+    xStageEvents = xEventGroupCreate();
+    configASSERT( xStageEvents != NULL );
+
+    for( size_t i = 0; i < uxNumStages; i++ )
+    {
+        if( xTaskCreate( prvStageTask,
+                         pxStages[ i ].pcName,
+                         pxStages[ i ].uxStackDepth,
+                         ( void * ) i,
+                         pxStages[ i ].uxPriority,
+                         NULL ) != pdTRUE )
+        {
+            LogError( "Failed to start boot stage %s.", pxStages[ i ].pcName );
+            prvEndStage( i, pdFALSE );
+        }
+    }
+
+    ( void ) xEventGroupWaitBits( xStageEvents, xAllMask, pdFALSE, pdTRUE, portMAX_DELAY );
+
+    vEventGroupDelete( xStageEvents );
+    xStageEvents = NULL;
+
+    for( size_t i = 0; i < uxNumStages; i++ )
+    {
+        if( xTimeline[ i ].xState != BOOT_STAGE_DONE )
+        {
+            xSuccess = pdFALSE;
+        }
+    }
+
+    prvLogTimeline();
+
+    return xSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxBootStagesGetTimeline( const BootTimelineEntry_t ** ppxEntries )
+{
+    if( ppxEntries != NULL )
+    {
+        *ppxEntries = xTimeline;
+    }
+
+    return uxTimelineLen;
+}
@@ -0,0 +1,65 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file boot_stages.h
+ * @brief Run the stages of system initialization as a dependency graph.
+ *
+ * Each stage runs in its own task as soon as the stages it depends on have
+ * ended, so independent stages overlap instead of running one after another.
+ */
+
+#ifndef APP_BOOT_STAGES_H_
+#define APP_BOOT_STAGES_H_
+
+#include "FreeRTOS.h"
+
+#include "app/boot_timeline.h"
+
+typedef BaseType_t ( * BootStageFunction_t )( void );
+
+typedef struct
+{
+    const char * pcName;
+    BootStageFunction_t xFunction;
+    uint32_t ulDependsOn; /*!< Mask of BOOT_STAGE_DEP() of the stages to wait for */
+    configSTACK_DEPTH_TYPE uxStackDepth;
+    UBaseType_t uxPriority;
+} BootStage_t;
+
+/**
+ * @brief Run all stages and wait for them to end, then log the timeline and the
+ * critical path. Dependents of a failed stage still run, after it ended.
+ *
+ * @return pdTRUE if every stage returned pdTRUE.
+ */
+BaseType_t xBootStagesRun( const BootStage_t * pxStages,
+                           size_t uxNumStages );
+
+/**
+ * @brief Get the timeline of the last call to xBootStagesRun.
+ *
+ * @return Number of entries, 0 if the stages have not been run.
+ */
+size_t uxBootStagesGetTimeline( const BootTimelineEntry_t ** ppxEntries );
+
+#endif /* APP_BOOT_STAGES_H_ */
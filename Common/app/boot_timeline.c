@@ -0,0 +1,154 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "app/boot_timeline.h"
+
+/*-----------------------------------------------------------*/
+
+static inline bool prvHasEnded( const BootTimelineEntry_t * pxEntry )
+{
+    return ( pxEntry->xState == BOOT_STAGE_DONE ) ||
+           ( pxEntry->xState == BOOT_STAGE_FAILED );
+}
+
+/*-----------------------------------------------------------*/
+
+bool xBootTimelineValidate( const BootTimelineEntry_t * pxEntries,
+                            size_t uxNumEntries )
+{
+    bool xValid = ( pxEntries != NULL ) &&
+                  ( uxNumEntries > 0 ) &&
+                  ( uxNumEntries <= BOOT_TIMELINE_MAX_STAGES );
+    uint32_t ulAllMask = 0;
+    uint32_t ulResolvedMask = 0;
+    bool xProgress = true;
+
+    if( xValid )
+    {
+        ulAllMask = ( 1UL << uxNumEntries ) - 1UL;
+
+        for( size_t i = 0; ( i < uxNumEntries ) && xValid; i++ )
+        {
+            xValid = ( ( pxEntries[ i ].ulDependsOn & ~ulAllMask ) == 0 ) &&
+                     ( ( pxEntries[ i ].ulDependsOn & BOOT_STAGE_DEP( i ) ) == 0 );
+        }
+    }
+
+    /* Resolve stages whose dependencies are resolved until nothing changes, what is left is in a cycle */
+    while( xValid && xProgress )
+    {
+        xProgress = false;
+
+        for( size_t i = 0; i < uxNumEntries; i++ )
+        {
+            if( ( ( ulResolvedMask & BOOT_STAGE_DEP( i ) ) == 0 ) &&
+                ( ( pxEntries[ i ].ulDependsOn & ~ulResolvedMask ) == 0 ) )
+            {
+                ulResolvedMask |= BOOT_STAGE_DEP( i );
+                xProgress = true;
+            }
+        }
+    }
+
+    return xValid && ( ulResolvedMask == ulAllMask );
+}
+
+/*-----------------------------------------------------------*/
+
+bool xBootTimelineCheckOrder( const BootTimelineEntry_t * pxEntries,
+                              size_t uxNumEntries )
+{
+    bool xInOrder = true;
+
+    for( size_t i = 0; ( i < uxNumEntries ) && xInOrder; i++ )
+    {
+        if( prvHasEnded( &( pxEntries[ i ] ) ) )
+        {
+            for( size_t j = 0; ( j < uxNumEntries ) && xInOrder; j++ )
+            {
+                if( ( pxEntries[ i ].ulDependsOn & BOOT_STAGE_DEP( j ) ) != 0 )
+                {
+                    xInOrder = prvHasEnded( &( pxEntries[ j ] ) ) &&
+                               ( pxEntries[ j ].ulEndMs <= pxEntries[ i ].ulStartMs );
+                }
+            }
+        }
+    }
+
+    return xInOrder;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxBootTimelineCriticalPath( const BootTimelineEntry_t * pxEntries,
+                                   size_t uxNumEntries,
+                                   uint8_t * pucPath,
+                                   size_t uxMaxPathLen )
+{
+    size_t uxPathLen = 0;
+    size_t uxCurrent = uxNumEntries;
+
+    /* Last stage to end, the earliest listed one on a tie */
+    for( size_t i = 0; i < uxNumEntries; i++ )
+    {
+        if( prvHasEnded( &( pxEntries[ i ] ) ) &&
+            ( ( uxCurrent == uxNumEntries ) ||
+              ( pxEntries[ i ].ulEndMs > pxEntries[ uxCurrent ].ulEndMs ) ) )
+        {
+            uxCurrent = i;
+        }
+    }
+
+    /* Walk back, collecting the path from its end */
+    while( ( uxCurrent < uxNumEntries ) &&
+           ( uxPathLen < uxMaxPathLen ) )
+    {
+        size_t uxGating = uxNumEntries;
+
+        pucPath[ uxPathLen ] = ( uint8_t ) uxCurrent;
+        uxPathLen++;
+
+        for( size_t j = 0; j < uxNumEntries; j++ )
+        {
+            if( ( ( pxEntries[ uxCurrent ].ulDependsOn & BOOT_STAGE_DEP( j ) ) != 0 ) &&
+                prvHasEnded( &( pxEntries[ j ] ) ) &&
+                ( ( uxGating == uxNumEntries ) ||
+                  ( pxEntries[ j ].ulEndMs > pxEntries[ uxGating ].ulEndMs ) ) )
+            {
+                uxGating = j;
+            }
+        }
+
+        uxCurrent = uxGating;
+    }
+
+    /* First stage first */
+    for( size_t i = 0; i < ( uxPathLen / 2 ); i++ )
+    {
+        uint8_t ucTmp = pucPath[ i ];
+
+        pucPath[ i ] = pucPath[ uxPathLen - 1 - i ];
+        pucPath[ uxPathLen - 1 - i ] = ucTmp;
+    }
+
+    return uxPathLen;
+}
@@ -0,0 +1,88 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file boot_timeline.h
+ * @brief Start and end time of each boot stage, and the chain of stages that
+ * determined when boot completed.
+ *
+ * Only operates on recorded times, so it can be checked on a host without the
+ * kernel. Stages are run by boot_stages.c.
+ */
+
+#ifndef APP_BOOT_TIMELINE_H_
+#define APP_BOOT_TIMELINE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Limited by the number of bits usable in an event group */
+#define BOOT_TIMELINE_MAX_STAGES    ( 16 )
+
+/* Dependency mask entry for the stage at index xIndex */
+#define BOOT_STAGE_DEP( xIndex )    ( 1UL << ( xIndex ) )
+
+typedef enum
+{
+    BOOT_STAGE_PENDING = 0,
+    BOOT_STAGE_RUNNING,
+    BOOT_STAGE_DONE,
+    BOOT_STAGE_FAILED
+} BootStageState_t;
+
+typedef struct
+{
+    const char * pcName;
+    uint32_t ulDependsOn; /*!< Mask of the indices of the stages that must end before this one starts */
+    BootStageState_t xState;
+    uint32_t ulStartMs;
+    uint32_t ulEndMs;
+} BootTimelineEntry_t;
+
+/**
+ * @brief Check that all dependencies refer to other stages of the timeline and
+ * that they do not form a cycle, so every stage can eventually start.
+ */
+bool xBootTimelineValidate( const BootTimelineEntry_t * pxEntries,
+                            size_t uxNumEntries );
+
+/**
+ * @brief Check that every ended stage started after all of its dependencies ended.
+ */
+bool xBootTimelineCheckOrder( const BootTimelineEntry_t * pxEntries,
+                              size_t uxNumEntries );
+
+/**
+ * @brief Find the critical path: starting from the stage that ended last, follow
+ * the dependency that ended last back to a stage without dependencies.
+ *
+ * @param[out] pucPath Stage indices on the path, first stage first.
+ *
+ * @return Number of indices written to pucPath, 0 if no stage has ended.
+ */
+size_t uxBootTimelineCriticalPath( const BootTimelineEntry_t * pxEntries,
+                                   size_t uxNumEntries,
+                                   uint8_t * pucPath,
+                                   size_t uxMaxPathLen );
+
+#endif /* APP_BOOT_TIMELINE_H_ */
@@ -55,6 +55,7 @@
 #include "b_u585i_iot02a_env_sensors.h"
 
 #include "app/sensor_telemetry.h"
+#include "app/telemetry_batch.h"
 
 /*-----------------------------------------------------------*/
 
@@ -158,11 +159,10 @@ void vEnvironmentSensorPublishTask( void * pvParameters )
         {
             payload.bMotionSensorValid = false;
             payload.bEnvSensorDataValid = true;
+            payload.bMotionStatsValid = false;
 
-        	if( xIsMqttConnected() == pdTRUE )
-        	{
-            	iotcApp_create_and_send_telemetry_json(&payload, sizeof(payload));
-        	}
+            /* Published by vTelemetryBatchTask together with other queued samples */
+            ( void ) xTelemetryBatchSubmit( &payload );
         }
 
         /* Adjust remaining tick count */
@@ -0,0 +1,777 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file json_index.c
+ * @brief Single pass JSON key path index.
+ *
+ * Each value is identified by the FNV-1a hash of its path as written in a
+ * coreJSON query. The hash of a child is derived from the hash of its parent,
+ * so building the index costs one pass over the document and a search costs
+ * one pass over the query. Hash matches are confirmed by comparing the query
+ * against the keys of the entry and its parents.
+ */
+
+#include <string.h>
+
+#include "app/json_index.h"
+
+#define FNV_OFFSET_BASIS    ( 2166136261UL )
+#define FNV_PRIME           ( 16777619UL )
+
+#define IS_SPACE( c )       ( ( ( c ) == ' ' ) || ( ( c ) == '\t' ) || ( ( c ) == '\n' ) || ( ( c ) == '\r' ) )
+#define IS_DIGIT( c )       ( ( ( c ) >= '0' ) && ( ( c ) <= '9' ) )
+#define IS_HEX( c )         ( IS_DIGIT( c ) || ( ( ( c ) >= 'a' ) && ( ( c ) <= 'f' ) ) || ( ( ( c ) >= 'A' ) && ( ( c ) <= 'F' ) ) )
+
+#if ( JSON_INDEX_MAX_ENTRIES >= UINT8_MAX ) || ( JSON_INDEX_NUM_BUCKETS <= JSON_INDEX_MAX_ENTRIES )
+#error "JSON_INDEX_MAX_ENTRIES must be less than UINT8_MAX and JSON_INDEX_NUM_BUCKETS"
+#endif
+
+#if ( JSON_INDEX_NUM_BUCKETS & ( JSON_INDEX_NUM_BUCKETS - 1 ) ) != 0
+#error "JSON_INDEX_NUM_BUCKETS must be a power of two"
+#endif
+
+typedef struct
+{
+    JsonIndex_t * pxIndex;
+    const char * pcBuf;
+    size_t uxLen;
+    size_t uxPos;
+} JsonParser_t;
+
+static JSONStatus_t prvParseValue( JsonParser_t * pxParser,
+                                   uint32_t ulPathHash,
+                                   uint8_t ucSelf,
+                                   uint8_t ucDepth,
+                                   JSONTypes_t * pxType );
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvHashByte( uint32_t ulHash,
+                                    char cByte )
+{
+    return ( ulHash ^ ( uint8_t ) cByte ) * FNV_PRIME;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvHashBytes( uint32_t ulHash,
+                              const char * pcBytes,
+                              size_t uxLen )
+{
+    for( size_t i = 0; i < uxLen; i++ )
+    {
+        ulHash = prvHashByte( ulHash, pcBytes[ i ] );
+    }
+
+    return ulHash;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Append an array subscript, "[<ulIndex>]", to a path hash. */
+static uint32_t prvHashSubscript( uint32_t ulHash,
+                                  uint32_t ulIndex )
+{
+    char pcDigits[ 10 ];
+    size_t uxNumDigits = 0;
+
+    do
+    {
+        pcDigits[ uxNumDigits++ ] = ( char ) ( '0' + ( ulIndex % 10 ) );
+        ulIndex /= 10;
+    } while( ulIndex > 0 );
+
+    ulHash = prvHashByte( ulHash, '[' );
+
+    while( uxNumDigits > 0 )
+    {
+        ulHash = prvHashByte( ulHash, pcDigits[ --uxNumDigits ] );
+    }
+
+    return prvHashByte( ulHash, ']' );
+}
+
+/*-----------------------------------------------------------*/
+
+static inline void prvSkipSpace( JsonParser_t * pxParser )
+{
+    while( ( pxParser->uxPos < pxParser->uxLen ) &&
+           IS_SPACE( pxParser->pcBuf[ pxParser->uxPos ] ) )
+    {
+        pxParser->uxPos++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static inline bool prvConsume( JsonParser_t * pxParser,
+                               char cExpected )
+{
+    bool xResult = false;
+
+    if( ( pxParser->uxPos < pxParser->uxLen ) &&
+        ( pxParser->pcBuf[ pxParser->uxPos ] == cExpected ) )
+    {
+        pxParser->uxPos++;
+        xResult = true;
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Skip a quoted string. On success uxPos points past the closing quote. */
+static JSONStatus_t prvSkipString( JsonParser_t * pxParser )
+{
+    JSONStatus_t xStatus = JSONIllegalDocument;
+    const char * pcBuf = pxParser->pcBuf;
+    size_t i = pxParser->uxPos;
+
+    if( ( i < pxParser->uxLen ) && ( pcBuf[ i ] == '"' ) )
+    {
+        i++;
+
+        while( i < pxParser->uxLen )
+        {
+            char c = pcBuf[ i ];
+
+            if( c == '"' )
+            {
+                pxParser->uxPos = i + 1;
+                xStatus = JSONSuccess;
+                break;
+            }
+            else if( ( uint8_t ) c < 0x20U )
+            {
+                break;
+            }
+            else if( c == '\\' )
+            {
+                i++;
+
+                if( i >= pxParser->uxLen )
+                {
+                    break;
+                }
+
+                c = pcBuf[ i ];
+
+                if( c == 'u' )
+                {
+                    if( ( ( i + 4 ) >= pxParser->uxLen ) ||
+                        !IS_HEX( pcBuf[ i + 1 ] ) || !IS_HEX( pcBuf[ i + 2 ] ) ||
+                        !IS_HEX( pcBuf[ i + 3 ] ) || !IS_HEX( pcBuf[ i + 4 ] ) )
+                    {
+                        break;
+                    }
+
+                    i += 4;
+                }
+                else if( strchr( "\"\\/bfnrt", c ) == NULL )
+                {
+                    break;
+                }
+            }
+
+            i++;
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t prvSkipNumber( JsonParser_t * pxParser )
+{
+    JSONStatus_t xStatus = JSONSuccess;
+    const char * pcBuf = pxParser->pcBuf;
+    size_t uxLen = pxParser->uxLen;
+    size_t i = pxParser->uxPos;
+
+    if( ( i < uxLen ) && ( pcBuf[ i ] == '-' ) )
+    {
+        i++;
+    }
+
+    if( ( i < uxLen ) && ( pcBuf[ i ] == '0' ) )
+    {
+        i++;
+    }
+    else if( ( i < uxLen ) && IS_DIGIT( pcBuf[ i ] ) )
+    {
+        while( ( i < uxLen ) && IS_DIGIT( pcBuf[ i ] ) )
+        {
+            i++;
+        }
+    }
+    else
+    {
+        xStatus = JSONIllegalDocument;
+    }
+
+    if( ( xStatus == JSONSuccess ) && ( i < uxLen ) && ( pcBuf[ i ] == '.' ) )
+    {
+        i++;
+
+        if( ( i >= uxLen ) || !IS_DIGIT( pcBuf[ i ] ) )
+        {
+            xStatus = JSONIllegalDocument;
+        }
+
+        while( ( i < uxLen ) && IS_DIGIT( pcBuf[ i ] ) )
+        {
+            i++;
+        }
+    }
+
+    if( ( xStatus == JSONSuccess ) && ( i < uxLen ) && ( ( pcBuf[ i ] == 'e' ) || ( pcBuf[ i ] == 'E' ) ) )
+    {
+        i++;
+
+        if( ( i < uxLen ) && ( ( pcBuf[ i ] == '+' ) || ( pcBuf[ i ] == '-' ) ) )
+        {
+            i++;
+        }
+
+        if( ( i >= uxLen ) || !IS_DIGIT( pcBuf[ i ] ) )
+        {
+            xStatus = JSONIllegalDocument;
+        }
+
+        while( ( i < uxLen ) && IS_DIGIT( pcBuf[ i ] ) )
+        {
+            i++;
+        }
+    }
+
+    if( xStatus == JSONSuccess )
+    {
+        pxParser->uxPos = i;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSkipLiteral( JsonParser_t * pxParser,
+                            const char * pcLiteral,
+                            size_t uxLiteralLen )
+{
+    bool xResult = false;
+
+    if( ( ( pxParser->uxLen - pxParser->uxPos ) >= uxLiteralLen ) &&
+        ( strncmp( &( pxParser->pcBuf[ pxParser->uxPos ] ), pcLiteral, uxLiteralLen ) == 0 ) )
+    {
+        pxParser->uxPos += uxLiteralLen;
+        xResult = true;
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Reserve an entry for a member of a container. Returns the entry index + 1,
+ * or 0 if the member is not recorded because its parent was not recorded or
+ * the index is full.
+ */
+static uint8_t prvAddEntry( JsonIndex_t * pxIndex,
+                            bool xParentRecorded,
+                            uint8_t ucParent,
+                            uint8_t ucDepth,
+                            uint32_t ulPathHash,
+                            size_t uxKeyOffset,
+                            size_t uxKeyLength,
+                            bool xIsArrayElem )
+{
+    uint8_t ucEntry = 0;
+
+    if( xParentRecorded )
+    {
+        if( pxIndex->uxNumEntries < JSON_INDEX_MAX_ENTRIES )
+        {
+            JsonIndexEntry_t * pxEntry = &( pxIndex->xEntries[ pxIndex->uxNumEntries ] );
+
+            pxEntry->ulPathHash = ulPathHash;
+            pxEntry->usKeyOffset = ( uint16_t ) uxKeyOffset;
+            pxEntry->usKeyLength = ( uint16_t ) uxKeyLength;
+            pxEntry->ucParent = ucParent;
+            pxEntry->ucIsArrayElem = xIsArrayElem ? 1 : 0;
+            pxEntry->ucDepth = ucDepth;
+
+            pxIndex->uxNumEntries++;
+            ucEntry = ( uint8_t ) pxIndex->uxNumEntries;
+        }
+        else
+        {
+            pxIndex->xIsComplete = false;
+        }
+    }
+
+    return ucEntry;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Record the value of an entry once it has been parsed and add it to the hash table. */
+static void prvCommitEntry( JsonIndex_t * pxIndex,
+                            uint8_t ucEntry,
+                            size_t uxValueStart,
+                            size_t uxValueEnd,
+                            JSONTypes_t xType )
+{
+    JsonIndexEntry_t * pxEntry = &( pxIndex->xEntries[ ucEntry - 1 ] );
+    uint32_t ulBucket = pxEntry->ulPathHash & ( JSON_INDEX_NUM_BUCKETS - 1 );
+
+    /* Strip the quotes from string values to match JSON_Search */
+    if( xType == JSONString )
+    {
+        uxValueStart++;
+        uxValueEnd--;
+    }
+
+    pxEntry->usValueOffset = ( uint16_t ) uxValueStart;
+    pxEntry->usValueLength = ( uint16_t ) ( uxValueEnd - uxValueStart );
+    pxEntry->ucType = ( uint8_t ) xType;
+
+    /* Linear probing, the table always has free buckets since it is larger than the entry array. */
+    while( pxIndex->pucBuckets[ ulBucket ] != 0 )
+    {
+        ulBucket = ( ulBucket + 1 ) & ( JSON_INDEX_NUM_BUCKETS - 1 );
+    }
+
+    pxIndex->pucBuckets[ ulBucket ] = ucEntry;
+}
+
+/*-----------------------------------------------------------*/
+
+
+static JSONStatus_t prvParseObject( JsonParser_t * pxParser,
+                                    uint32_t ulPathHash,
+                                    uint8_t ucSelf,
+                                    uint8_t ucDepth )
+{
+    JSONStatus_t xStatus = JSONSuccess;
+    bool xRecord = ( ucDepth == 0 ) || ( ucSelf != 0 );
+
+    /* Skip the opening brace */
+    pxParser->uxPos++;
+    prvSkipSpace( pxParser );
+
+    if( prvConsume( pxParser, '}' ) == false )
+    {
+        do
+        {
+            size_t uxKeyOffset;
+            size_t uxKeyLength;
+            size_t uxValueStart;
+            uint32_t ulChildHash;
+            uint8_t ucChild;
+            JSONTypes_t xType;
+
+            prvSkipSpace( pxParser );
+
+            uxKeyOffset = pxParser->uxPos + 1;
+            xStatus = prvSkipString( pxParser );
+
+            if( xStatus != JSONSuccess )
+            {
+                break;
+            }
+
+            uxKeyLength = pxParser->uxPos - 1 - uxKeyOffset;
+
+            prvSkipSpace( pxParser );
+
+            if( prvConsume( pxParser, ':' ) == false )
+            {
+                xStatus = JSONIllegalDocument;
+                break;
+            }
+
+            prvSkipSpace( pxParser );
+
+            /* Top level keys are not preceded by a separator in a query */
+            ulChildHash = ( ucDepth == 0 ) ? ulPathHash : prvHashByte( ulPathHash, '.' );
+            ulChildHash = prvHashBytes( ulChildHash, &( pxParser->pcBuf[ uxKeyOffset ] ), uxKeyLength );
+
+            ucChild = prvAddEntry( pxParser->pxIndex, xRecord, ucSelf, ucDepth + 1,
+                                   ulChildHash, uxKeyOffset, uxKeyLength, false );
+
+            uxValueStart = pxParser->uxPos;
+            xStatus = prvParseValue( pxParser, ulChildHash, ucChild, ucDepth + 1, &xType );
+
+            if( xStatus != JSONSuccess )
+            {
+                break;
+            }
+
+            if( ucChild != 0 )
+            {
+                prvCommitEntry( pxParser->pxIndex, ucChild, uxValueStart, pxParser->uxPos, xType );
+            }
+
+            prvSkipSpace( pxParser );
+        } while( prvConsume( pxParser, ',' ) );
+
+        if( ( xStatus == JSONSuccess ) && ( prvConsume( pxParser, '}' ) == false ) )
+        {
+            xStatus = JSONIllegalDocument;
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t prvParseArray( JsonParser_t * pxParser,
+                                   uint32_t ulPathHash,
+                                   uint8_t ucSelf,
+                                   uint8_t ucDepth )
+{
+    JSONStatus_t xStatus = JSONSuccess;
+    bool xRecord = ( ucDepth == 0 ) || ( ucSelf != 0 );
+    uint32_t ulElemIndex = 0;
+
+    /* Skip the opening bracket */
+    pxParser->uxPos++;
+    prvSkipSpace( pxParser );
+
+    if( prvConsume( pxParser, ']' ) == false )
+    {
+        do
+        {
+            size_t uxValueStart;
+            uint32_t ulChildHash;
+            uint8_t ucChild;
+            JSONTypes_t xType;
+
+            prvSkipSpace( pxParser );
+
+            ulChildHash = prvHashSubscript( ulPathHash, ulElemIndex );
+
+            /* Array elements store their index in place of the key length */
+            ucChild = prvAddEntry( pxParser->pxIndex, xRecord && ( ulElemIndex <= UINT16_MAX ),
+                                   ucSelf, ucDepth + 1, ulChildHash, 0, ulElemIndex, true );
+
+            uxValueStart = pxParser->uxPos;
+            xStatus = prvParseValue( pxParser, ulChildHash, ucChild, ucDepth + 1, &xType );
+
+            if( xStatus != JSONSuccess )
+            {
+                break;
+            }
+
+            if( ucChild != 0 )
+            {
+                prvCommitEntry( pxParser->pxIndex, ucChild, uxValueStart, pxParser->uxPos, xType );
+            }
+
+            ulElemIndex++;
+            prvSkipSpace( pxParser );
+        } while( prvConsume( pxParser, ',' ) );
+
+        if( ( xStatus == JSONSuccess ) && ( prvConsume( pxParser, ']' ) == false ) )
+        {
+            xStatus = JSONIllegalDocument;
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static JSONStatus_t prvParseValue( JsonParser_t * pxParser,
+                                   uint32_t ulPathHash,
+                                   uint8_t ucSelf,
+                                   uint8_t ucDepth,
+                                   JSONTypes_t * pxType )
+{
+    JSONStatus_t xStatus = JSONIllegalDocument;
+    char c = ( pxParser->uxPos < pxParser->uxLen ) ? pxParser->pcBuf[ pxParser->uxPos ] : '\0';
+
+    *pxType = JSONInvalid;
+
+    switch( c )
+    {
+        case '{':
+        case '[':
+
+            if( ucDepth >= JSON_INDEX_MAX_DEPTH )
+            {
+                xStatus = JSONMaxDepthExceeded;
+            }
+            else if( c == '{' )
+            {
+                *pxType = JSONObject;
+                xStatus = prvParseObject( pxParser, ulPathHash, ucSelf, ucDepth );
+            }
+            else
+            {
+                *pxType = JSONArray;
+                xStatus = prvParseArray( pxParser, ulPathHash, ucSelf, ucDepth );
+            }
+
+            break;
+
+        case '"':
+            *pxType = JSONString;
+            xStatus = prvSkipString( pxParser );
+            break;
+
+        case 't':
+            *pxType = JSONTrue;
+            xStatus = prvSkipLiteral( pxParser, "true", 4 ) ? JSONSuccess : JSONIllegalDocument;
+            break;
+
+        case 'f':
+            *pxType = JSONFalse;
+            xStatus = prvSkipLiteral( pxParser, "false", 5 ) ? JSONSuccess : JSONIllegalDocument;
+            break;
+
+        case 'n':
+            *pxType = JSONNull;
+            xStatus = prvSkipLiteral( pxParser, "null", 4 ) ? JSONSuccess : JSONIllegalDocument;
+            break;
+
+        default:
+            *pxType = JSONNumber;
+            xStatus = prvSkipNumber( pxParser );
+            break;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Check that the query names exactly the path from the top level to pxEntry. */
+static bool prvMatchPath( const JsonIndex_t * pxIndex,
+                          const JsonIndexEntry_t * pxEntry,
+                          const char * pcQuery,
+                          size_t uxQueryLength )
+{
+    const JsonIndexEntry_t * pxPath[ JSON_INDEX_MAX_DEPTH ];
+    size_t uxNumLevels = 0;
+    size_t uxPos = 0;
+    bool xMatch = true;
+
+    /* Collect the chain of parents, leaf first */
+    while( ( pxEntry != NULL ) && ( uxNumLevels < JSON_INDEX_MAX_DEPTH ) )
+    {
+        pxPath[ uxNumLevels++ ] = pxEntry;
+        pxEntry = ( pxEntry->ucParent != 0 ) ? &( pxIndex->xEntries[ pxEntry->ucParent - 1 ] ) : NULL;
+    }
+
+    while( xMatch && ( uxNumLevels > 0 ) )
+    {
+        const JsonIndexEntry_t * pxLevel = pxPath[ --uxNumLevels ];
+
+        if( pxLevel->ucIsArrayElem != 0 )
+        {
+            uint32_t ulElemIndex = 0;
+            size_t uxNumDigits = 0;
+
+            xMatch = ( uxPos < uxQueryLength ) && ( pcQuery[ uxPos ] == '[' );
+            uxPos++;
+
+            while( xMatch && ( uxPos < uxQueryLength ) && IS_DIGIT( pcQuery[ uxPos ] ) && ( uxNumDigits < 5 ) )
+            {
+                ulElemIndex = ( ulElemIndex * 10 ) + ( uint32_t ) ( pcQuery[ uxPos ] - '0' );
+                uxNumDigits++;
+                uxPos++;
+            }
+
+            xMatch = xMatch && ( uxNumDigits > 0 ) &&
+                     ( uxPos < uxQueryLength ) && ( pcQuery[ uxPos ] == ']' ) &&
+                     ( ulElemIndex == pxLevel->usKeyLength );
+            uxPos++;
+        }
+        else
+        {
+            size_t uxKeyStart;
+
+            if( pxLevel->ucDepth > 1 )
+            {
+                xMatch = ( uxPos < uxQueryLength ) && ( pcQuery[ uxPos ] == '.' );
+                uxPos++;
+            }
+
+            uxKeyStart = uxPos;
+
+            while( ( uxPos < uxQueryLength ) && ( pcQuery[ uxPos ] != '.' ) && ( pcQuery[ uxPos ] != '[' ) )
+            {
+                uxPos++;
+            }
+
+            xMatch = xMatch &&
+                     ( ( uxPos - uxKeyStart ) == pxLevel->usKeyLength ) &&
+                     ( strncmp( &( pcQuery[ uxKeyStart ] ),
+                                &( pxIndex->pcDocument[ pxLevel->usKeyOffset ] ),
+                                pxLevel->usKeyLength ) == 0 );
+        }
+    }
+
+    return xMatch && ( uxPos == uxQueryLength );
+}
+
+/*-----------------------------------------------------------*/
+
+JSONStatus_t JsonIndex_Build( JsonIndex_t * pxIndex,
+                              const char * pcDocument,
+                              size_t uxDocumentLength )
+{
+    JSONStatus_t xStatus = JSONSuccess;
+    JsonParser_t xParser;
+    JSONTypes_t xType;
+
+    if( ( pxIndex == NULL ) || ( pcDocument == NULL ) )
+    {
+        xStatus = JSONNullParameter;
+    }
+    else if( ( uxDocumentLength == 0 ) || ( uxDocumentLength > UINT16_MAX ) )
+    {
+        xStatus = JSONBadParameter;
+    }
+    else
+    {
+        /* Entries are written in full as they are added, only the buckets need clearing */
+        ( void ) memset( pxIndex->pucBuckets, 0, sizeof( pxIndex->pucBuckets ) );
+        pxIndex->uxNumEntries = 0;
+        pxIndex->pcDocument = pcDocument;
+        pxIndex->uxDocumentLength = uxDocumentLength;
+        pxIndex->xIsComplete = true;
+
+        xParser.pxIndex = pxIndex;
+        xParser.pcBuf = pcDocument;
+        xParser.uxLen = uxDocumentLength;
+        xParser.uxPos = 0;
+
+        prvSkipSpace( &xParser );
+        xStatus = prvParseValue( &xParser, FNV_OFFSET_BASIS, 0, 0, &xType );
+        prvSkipSpace( &xParser );
+
+        /* Like JSON_Validate, allow a NUL terminator but nothing else after the value */
+        if( ( xStatus == JSONSuccess ) &&
+            ( xParser.uxPos < xParser.uxLen ) &&
+            ( xParser.pcBuf[ xParser.uxPos ] != '\0' ) )
+        {
+            xStatus = JSONIllegalDocument;
+        }
+
+        /* Too deep to index, but the document may still be valid for coreJSON */
+        if( xStatus == JSONMaxDepthExceeded )
+        {
+            xStatus = JSON_Validate( pcDocument, uxDocumentLength );
+
+            ( void ) memset( pxIndex->pucBuckets, 0, sizeof( pxIndex->pucBuckets ) );
+            pxIndex->uxNumEntries = 0;
+            pxIndex->xIsComplete = false;
+        }
+
+        if( xStatus != JSONSuccess )
+        {
+            pxIndex->uxNumEntries = 0;
+            pxIndex->pcDocument = NULL;
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+JSONStatus_t JsonIndex_Search( const JsonIndex_t * pxIndex,
+                               const char * pcQuery,
+                               size_t uxQueryLength,
+                               const char ** ppcValue,
+                               size_t * puxValueLength,
+                               JSONTypes_t * pxType )
+{
+    JSONStatus_t xStatus = JSONNotFound;
+
+    if( ( pxIndex == NULL ) || ( pcQuery == NULL ) ||
+        ( ppcValue == NULL ) || ( puxValueLength == NULL ) )
+    {
+        xStatus = JSONNullParameter;
+    }
+    else if( ( pxIndex->pcDocument == NULL ) || ( uxQueryLength == 0 ) )
+    {
+        xStatus = JSONBadParameter;
+    }
+    else
+    {
+        uint32_t ulHash = prvHashBytes( FNV_OFFSET_BASIS, pcQuery, uxQueryLength );
+        uint32_t ulBucket = ulHash & ( JSON_INDEX_NUM_BUCKETS - 1 );
+
+        while( pxIndex->pucBuckets[ ulBucket ] != 0 )
+        {
+            const JsonIndexEntry_t * pxEntry = &( pxIndex->xEntries[ pxIndex->pucBuckets[ ulBucket ] - 1 ] );
+
+            if( ( pxEntry->ulPathHash == ulHash ) &&
+                prvMatchPath( pxIndex, pxEntry, pcQuery, uxQueryLength ) )
+            {
+                *ppcValue = &( pxIndex->pcDocument[ pxEntry->usValueOffset ] );
+                *puxValueLength = pxEntry->usValueLength;
+
+                if( pxType != NULL )
+                {
+                    *pxType = ( JSONTypes_t ) pxEntry->ucType;
+                }
+
+                xStatus = JSONSuccess;
+                break;
+            }
+
+            ulBucket = ( ulBucket + 1 ) & ( JSON_INDEX_NUM_BUCKETS - 1 );
+        }
+
+        /* Values past the capacity of the index can only be found by scanning the document */
+        if( ( xStatus == JSONNotFound ) && ( pxIndex->xIsComplete == false ) )
+        {
+            char * pcValue = NULL;
+            JSONTypes_t xType = JSONInvalid;
+
+            xStatus = JSON_SearchT( ( char * ) pxIndex->pcDocument, pxIndex->uxDocumentLength,
+                                    pcQuery, uxQueryLength, &pcValue, puxValueLength, &xType );
+
+            if( xStatus == JSONSuccess )
+            {
+                *ppcValue = pcValue;
+
+                if( pxType != NULL )
+                {
+                    *pxType = xType;
+                }
+            }
+        }
+    }
+
+    return xStatus;
+}
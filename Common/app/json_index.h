@@ -0,0 +1,132 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file json_index.h
+ * @brief Single pass JSON key path index.
+ *
+ * JsonIndex_Build validates a document and records the location of every
+ * value by key path in one scan. JsonIndex_Search then resolves a query in
+ * the coreJSON syntax ( "state.reported.powerOn", "list[2]" ) with a hash
+ * lookup instead of rescanning the document. If a document has more values
+ * than JSON_INDEX_MAX_ENTRIES, searches for paths missing from the index
+ * fall back to JSON_Search. A document nested deeper than JSON_INDEX_MAX_DEPTH
+ * is validated with JSON_Validate instead and left unindexed, so that every
+ * search falls back to JSON_Search.
+ *
+ * The defaults index a full shadow update/documents message, which is larger
+ * than the delta and accepted messages handled by shadow_device_task.c, with
+ * room for more reported values. Each entry costs 16 bytes and each bucket 1
+ * byte.
+ *
+ * shadow_device_task.c is the only user. The ntz project does not build that
+ * task and excludes this file too, so the index is only linked into tfm.
+ */
+
+#ifndef APP_JSON_INDEX_H_
+#define APP_JSON_INDEX_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "core_json.h"
+
+/* Maximum number of values recorded by the index. Must be less than UINT8_MAX. */
+#ifndef JSON_INDEX_MAX_ENTRIES
+#define JSON_INDEX_MAX_ENTRIES    ( 128 )
+#endif
+
+/* Number of hash buckets. Must be a power of two larger than JSON_INDEX_MAX_ENTRIES. */
+#ifndef JSON_INDEX_NUM_BUCKETS
+#define JSON_INDEX_NUM_BUCKETS    ( 256 )
+#endif
+
+/* Maximum nesting depth of objects and arrays. Each level costs a recursion of the parser. */
+#ifndef JSON_INDEX_MAX_DEPTH
+#define JSON_INDEX_MAX_DEPTH      ( 16 )
+#endif
+
+typedef struct
+{
+    uint32_t ulPathHash;   /*!< FNV-1a hash of the full key path */
+    uint16_t usKeyOffset;  /*!< Offset of the key (object member) in the document */
+    uint16_t usKeyLength;  /*!< Length of the key, or the element index for array members */
+    uint16_t usValueOffset;
+    uint16_t usValueLength;
+    uint8_t ucParent;      /*!< Index of the parent entry + 1, 0 for top level values */
+    uint8_t ucType;        /*!< JSONTypes_t of the value */
+    uint8_t ucIsArrayElem; /*!< Non-zero if the entry is an array element */
+    uint8_t ucDepth;       /*!< Nesting depth, 1 for top level values */
+} JsonIndexEntry_t;
+
+typedef struct
+{
+    const char * pcDocument;
+    size_t uxDocumentLength;
+    size_t uxNumEntries;
+    bool xIsComplete; /*!< false if the document had more values than JSON_INDEX_MAX_ENTRIES or was nested deeper than JSON_INDEX_MAX_DEPTH */
+    JsonIndexEntry_t xEntries[ JSON_INDEX_MAX_ENTRIES ];
+    uint8_t pucBuckets[ JSON_INDEX_NUM_BUCKETS ];
+} JsonIndex_t;
+
+/**
+ * @brief Validate a JSON document and build the key path index for it.
+ *
+ * The index refers to the document buffer, which must remain valid while the
+ * index is in use. Documents larger than UINT16_MAX bytes are rejected.
+ *
+ * @param[out] pxIndex Index to populate.
+ * @param[in] pcDocument JSON document.
+ * @param[in] uxDocumentLength Length of pcDocument.
+ *
+ * @return JSONSuccess, JSONNullParameter, JSONBadParameter, JSONMaxDepthExceeded
+ * or JSONIllegalDocument. JSONMaxDepthExceeded is only returned for documents
+ * that JSON_Validate rejects as well.
+ */
+JSONStatus_t JsonIndex_Build( JsonIndex_t * pxIndex,
+                              const char * pcDocument,
+                              size_t uxDocumentLength );
+
+/**
+ * @brief Find the value for a key path in an indexed document.
+ *
+ * Matches the behavior of JSON_SearchT: string values are returned without
+ * their quotes and containers are returned including their brackets.
+ *
+ * @param[in] pxIndex Index built by JsonIndex_Build.
+ * @param[in] pcQuery Key path to search for.
+ * @param[in] uxQueryLength Length of pcQuery.
+ * @param[out] ppcValue Set to the start of the value in the document.
+ * @param[out] puxValueLength Set to the length of the value.
+ * @param[out] pxType Set to the type of the value. May be NULL.
+ *
+ * @return JSONSuccess, JSONNotFound, JSONNullParameter or JSONBadParameter.
+ */
+JSONStatus_t JsonIndex_Search( const JsonIndex_t * pxIndex,
+                               const char * pcQuery,
+                               size_t uxQueryLength,
+                               const char ** ppcValue,
+                               size_t * puxValueLength,
+                               JSONTypes_t * pxType );
+
+#endif /* APP_JSON_INDEX_H_ */
@@ -0,0 +1,299 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file motion_sampler.c
+ * @brief Data ready driven accelerometer / gyroscope sampling with per window aggregation.
+ *
+ * The ISM330DHCX is configured to pulse INT1 each time a new accelerometer
+ * sample is available. The sampling task is woken from the EXTI callback,
+ * reads both sensors and pushes the result into a single producer, single
+ * consumer ring. The publishing task drains the ring once per publish period
+ * and reduces the samples to min / max / mean / RMS per axis.
+ */
+
+#include "logging_levels.h"
+/* define LOG_LEVEL here if you want to modify the logging level from the default */
+
+#define LOG_LEVEL    LOG_ERROR
+
+#include "logging.h"
+
+/* Standard includes. */
+#include <string.h>
+#include <math.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "hw_defs.h"
+
+#include "ism330dhcx.h"
+
+#include "app/motion_sampler.h"
+
+#if ( MOTION_SAMPLER_RING_LEN & ( MOTION_SAMPLER_RING_LEN - 1 ) ) != 0
+#error "MOTION_SAMPLER_RING_LEN must be a power of two"
+#endif
+
+#define MOTION_SAMPLER_STACK_SIZE    ( 512 )
+
+/* Without the data ready interrupt the task reads the sensor every two sample periods, half the output data rate */
+#define MOTION_SAMPLER_FALLBACK_TICKS    ( pdMS_TO_TICKS( 2000 / MOTION_SAMPLER_ODR_HZ ) + 1 )
+
+typedef struct
+{
+    BSP_MOTION_SENSOR_Axes_t xAccelero;
+    BSP_MOTION_SENSOR_Axes_t xGyro;
+    uint32_t ulCycles;
+} MotionSample_t;
+
+typedef struct
+{
+    int64_t pllSum[ 3 ];
+    uint64_t pullSumSquares[ 3 ];
+    BSP_MOTION_SENSOR_Axes_t xMin;
+    BSP_MOTION_SENSOR_Axes_t xMax;
+} MotionAxesAccumulator_t;
+
+extern void * MotionCompObj[ MOTION_INSTANCES_NBR ];
+
+static TaskHandle_t xSamplerTaskHandle = NULL;
+
+/*
+ * Ring shared between the sampling task (producer, writes ulRingHead) and the
+ * consumer (writes ulRingTail). The indices run freely and are masked on access.
+ */
+static MotionSample_t xRing[ MOTION_SAMPLER_RING_LEN ];
+static uint32_t ulRingHead = 0;
+static uint32_t ulRingTail = 0;
+static uint32_t ulRingDropped = 0;
+
+/* Consumer state */
+static uint32_t ulLastDropped = 0;
+static uint32_t ulLastSampleCycles = 0;
+static bool xHaveLastSample = false;
+
+/*-----------------------------------------------------------*/
+
+static void prvDataReadyCallback( void * pvContext )
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    ( void ) pvContext;
+
+    if( xSamplerTaskHandle != NULL )
+    {
+        vTaskNotifyGiveFromISR( xSamplerTaskHandle, &xHigherPriorityTaskWoken );
+    }
+
+    portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvRingPush( const MotionSample_t * pxSample )
+{
+    uint32_t ulHead = __atomic_load_n( &ulRingHead, __ATOMIC_RELAXED );
+    uint32_t ulTail = __atomic_load_n( &ulRingTail, __ATOMIC_ACQUIRE );
+
+    if( ( ulHead - ulTail ) >= MOTION_SAMPLER_RING_LEN )
+    {
+        ( void ) __atomic_fetch_add( &ulRingDropped, 1, __ATOMIC_RELAXED );
+    }
+    else
+    {
+        xRing[ ulHead & ( MOTION_SAMPLER_RING_LEN - 1 ) ] = *pxSample;
+        __atomic_store_n( &ulRingHead, ulHead + 1, __ATOMIC_RELEASE );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void vMotionSamplerTask( void * pvParameters )
+{
+    bool xWarnedNoInterrupt = false;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        MotionSample_t xSample;
+        int32_t lBspError;
+
+        if( ( ulTaskNotifyTake( pdTRUE, MOTION_SAMPLER_FALLBACK_TICKS ) == 0 ) &&
+            ( xWarnedNoInterrupt == false ) )
+        {
+            LogWarn( "No data ready interrupt from the IMU, polling instead." );
+            xWarnedNoInterrupt = true;
+        }
+
+        lBspError = BSP_MOTION_SENSOR_GetAxes( 0, MOTION_ACCELERO, &xSample.xAccelero );
+        lBspError |= BSP_MOTION_SENSOR_GetAxes( 0, MOTION_GYRO, &xSample.xGyro );
+        xSample.ulCycles = ulGetCycleCount();
+
+        if( lBspError == BSP_ERROR_NONE )
+        {
+            prvRingPush( &xSample );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xMotionSamplerStart( void )
+{
+    int32_t lBspError = BSP_ERROR_NONE;
+    int32_t lDrvError = ISM330DHCX_OK;
+    BaseType_t xResult = pdFALSE;
+
+    lBspError = BSP_MOTION_SENSOR_Init( 0, MOTION_GYRO | MOTION_ACCELERO );
+    lBspError |= BSP_MOTION_SENSOR_Enable( 0, MOTION_GYRO );
+    lBspError |= BSP_MOTION_SENSOR_Enable( 0, MOTION_ACCELERO );
+    lBspError |= BSP_MOTION_SENSOR_SetOutputDataRate( 0, MOTION_GYRO, ( float ) MOTION_SAMPLER_ODR_HZ );
+    lBspError |= BSP_MOTION_SENSOR_SetOutputDataRate( 0, MOTION_ACCELERO, ( float ) MOTION_SAMPLER_ODR_HZ );
+
+    if( lBspError != BSP_ERROR_NONE )
+    {
+        LogError( "Error while initializing the accelerometer and gyroscope." );
+    }
+    else
+    {
+        xResult = xTaskCreate( vMotionSamplerTask, "MotionSampler", MOTION_SAMPLER_STACK_SIZE,
+                               NULL, MOTION_SAMPLER_TASK_PRIORITY, &xSamplerTaskHandle );
+    }
+
+    if( xResult == pdTRUE )
+    {
+        GPIO_EXTI_Register_Callback( IMU_INT1_Pin, prvDataReadyCallback, NULL );
+
+        /* Pulsed mode re-arms the rising edge for every sample, even if a read is late */
+        lDrvError = ISM330DHCX_DRDY_Set_Mode( MotionCompObj[ 0 ], ISM330DHCX_DRDY_PULSED );
+        lDrvError |= ISM330DHCX_ACC_Set_INT1_DRDY( MotionCompObj[ 0 ], PROPERTY_ENABLE );
+
+        if( lDrvError != ISM330DHCX_OK )
+        {
+            LogWarn( "Failed to route the IMU data ready signal to INT1." );
+        }
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvAccumulateAxes( MotionAxesAccumulator_t * pxAcc,
+                               const BSP_MOTION_SENSOR_Axes_t * pxAxes,
+                               bool xFirst )
+{
+    const int32_t plValues[ 3 ] = { pxAxes->x, pxAxes->y, pxAxes->z };
+
+    if( xFirst )
+    {
+        pxAcc->xMin = *pxAxes;
+        pxAcc->xMax = *pxAxes;
+    }
+    else
+    {
+        pxAcc->xMin.x = ( pxAxes->x < pxAcc->xMin.x ) ? pxAxes->x : pxAcc->xMin.x;
+        pxAcc->xMin.y = ( pxAxes->y < pxAcc->xMin.y ) ? pxAxes->y : pxAcc->xMin.y;
+        pxAcc->xMin.z = ( pxAxes->z < pxAcc->xMin.z ) ? pxAxes->z : pxAcc->xMin.z;
+        pxAcc->xMax.x = ( pxAxes->x > pxAcc->xMax.x ) ? pxAxes->x : pxAcc->xMax.x;
+        pxAcc->xMax.y = ( pxAxes->y > pxAcc->xMax.y ) ? pxAxes->y : pxAcc->xMax.y;
+        pxAcc->xMax.z = ( pxAxes->z > pxAcc->xMax.z ) ? pxAxes->z : pxAcc->xMax.z;
+    }
+
+    for( size_t i = 0; i < 3; i++ )
+    {
+        pxAcc->pllSum[ i ] += plValues[ i ];
+        pxAcc->pullSumSquares[ i ] += ( uint64_t ) ( ( int64_t ) plValues[ i ] * plValues[ i ] );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvFinishAxes( const MotionAxesAccumulator_t * pxAcc,
+                           uint32_t ulNumSamples,
+                           MotionAxesStats_t * pxStats )
+{
+    pxStats->xMin = pxAcc->xMin;
+    pxStats->xMax = pxAcc->xMax;
+
+    for( size_t i = 0; i < 3; i++ )
+    {
+        pxStats->pfMean[ i ] = ( float_t ) ( ( double ) pxAcc->pllSum[ i ] / ulNumSamples );
+        pxStats->pfRms[ i ] = sqrtf( ( float_t ) ( ( double ) pxAcc->pullSumSquares[ i ] / ulNumSamples ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool xMotionSamplerGetWindow( MotionWindowStats_t * pxStats )
+{
+    MotionAxesAccumulator_t xAccelero = { 0 };
+    MotionAxesAccumulator_t xGyro = { 0 };
+    uint32_t ulTail = __atomic_load_n( &ulRingTail, __ATOMIC_RELAXED );
+    uint32_t ulHead = __atomic_load_n( &ulRingHead, __ATOMIC_ACQUIRE );
+    uint32_t ulDropped = __atomic_load_n( &ulRingDropped, __ATOMIC_RELAXED );
+    uint32_t ulNumSamples = ulHead - ulTail;
+
+    configASSERT( pxStats != NULL );
+
+    ( void ) memset( pxStats, 0, sizeof( MotionWindowStats_t ) );
+
+    for( uint32_t i = 0; i < ulNumSamples; i++ )
+    {
+        const MotionSample_t * pxSample = &( xRing[ ( ulTail + i ) & ( MOTION_SAMPLER_RING_LEN - 1 ) ] );
+
+        prvAccumulateAxes( &xAccelero, &( pxSample->xAccelero ), ( i == 0 ) );
+        prvAccumulateAxes( &xGyro, &( pxSample->xGyro ), ( i == 0 ) );
+
+        if( xHaveLastSample )
+        {
+            uint32_t ulInterval = pxSample->ulCycles - ulLastSampleCycles;
+
+            if( ulInterval > pxStats->ulMaxIntervalCycles )
+            {
+                pxStats->ulMaxIntervalCycles = ulInterval;
+            }
+        }
+
+        ulLastSampleCycles = pxSample->ulCycles;
+        xHaveLastSample = true;
+    }
+
+    /* Hand the slots back to the producer */
+    __atomic_store_n( &ulRingTail, ulHead, __ATOMIC_RELEASE );
+
+    pxStats->ulNumSamples = ulNumSamples;
+    pxStats->ulDropped = ulDropped - ulLastDropped;
+    ulLastDropped = ulDropped;
+
+    if( ulNumSamples > 0 )
+    {
+        prvFinishAxes( &xAccelero, ulNumSamples, &( pxStats->xAccelero ) );
+        prvFinishAxes( &xGyro, ulNumSamples, &( pxStats->xGyro ) );
+    }
+
+    return( ulNumSamples > 0 );
+}
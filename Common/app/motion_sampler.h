@@ -0,0 +1,88 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef APP_MOTION_SAMPLER_H_
+#define APP_MOTION_SAMPLER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "FreeRTOS.h"
+
+#include "b_u585i_iot02a_motion_sensors.h"
+
+/* Accelerometer and gyroscope output data rate */
+#ifndef MOTION_SAMPLER_ODR_HZ
+#define MOTION_SAMPLER_ODR_HZ      ( 104 )
+#endif
+
+/* Number of samples buffered between the sampling task and the consumer. Must be a power of two. */
+#ifndef MOTION_SAMPLER_RING_LEN
+#define MOTION_SAMPLER_RING_LEN    ( 128 )
+#endif
+
+/* Runs above the network and publishing tasks so sampling does not follow MQTT latency */
+#ifndef MOTION_SAMPLER_TASK_PRIORITY
+#define MOTION_SAMPLER_TASK_PRIORITY    ( 12 )
+#endif
+
+typedef struct
+{
+    BSP_MOTION_SENSOR_Axes_t xMin;
+    BSP_MOTION_SENSOR_Axes_t xMax;
+    float_t pfMean[ 3 ];
+    float_t pfRms[ 3 ];
+} MotionAxesStats_t;
+
+/* Statistics for the samples taken since the previous call to xMotionSamplerGetWindow */
+typedef struct
+{
+    uint32_t ulNumSamples;
+    uint32_t ulDropped;           /*!< Samples lost because the ring was full */
+    uint32_t ulMaxIntervalCycles; /*!< Longest time between two consecutive samples */
+    MotionAxesStats_t xAccelero;
+    MotionAxesStats_t xGyro;
+} MotionWindowStats_t;
+
+/**
+ * @brief Initialize the accelerometer and gyroscope and start the sampling task.
+ *
+ * The sampling task reads the sensor on each data ready interrupt and stores
+ * the sample in a single producer, single consumer ring.
+ *
+ * @return pdTRUE on success.
+ */
+BaseType_t xMotionSamplerStart( void );
+
+/**
+ * @brief Drain the ring and compute min / max / mean / RMS per axis.
+ *
+ * Must only be called from a single consumer task.
+ *
+ * @param[out] pxStats Statistics for the window.
+ *
+ * @return true if at least one sample was available.
+ */
+bool xMotionSamplerGetWindow( MotionWindowStats_t * pxStats );
+
+#endif /* APP_MOTION_SAMPLER_H_ */
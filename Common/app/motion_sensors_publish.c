@@ -66,6 +66,8 @@
 #include "iotcl.h"
 
 #include "app/sensor_telemetry.h"
+#include "app/telemetry_batch.h"
+#include "app/motion_sampler.h"
 
 /**
  * @brief Size of statically allocated buffers for holding topic names and
@@ -74,152 +76,54 @@
 #define MQTT_PUBLISH_MAX_LEN                 ( 200 )
 #define MQTT_PUBLISH_PERIOD_MS               ( 500 )
 #define MQTT_PUBLICH_TOPIC_STR_LEN           ( 256 )
-#define MQTT_PUBLISH_BLOCK_TIME_MS           ( 200 )
-#define MQTT_PUBLISH_NOTIFICATION_WAIT_MS    ( 1000 )
-#define MQTT_NOTIFY_IDX                      ( 1 )
-#define MQTT_PUBLISH_QOS                     ( MQTTQoS0 )
 
 
 /*-----------------------------------------------------------*/
-
-/**
- * @brief Defines the structure to use as the command callback context in this
- * demo.
- */
-struct MQTTAgentCommandContext
-{
-    MQTTStatus_t xReturnStatus;
-    TaskHandle_t xTaskToNotify;
-    uint32_t ulNotificationValue;
-};
-
-/*-----------------------------------------------------------*/
-static void prvPublishCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
-                                       MQTTAgentReturnInfo_t * pxReturnInfo )
+static BaseType_t xInitSensors( void )
 {
-    TaskHandle_t xTaskHandle = ( TaskHandle_t ) pxCommandContext;
+    int32_t lBspError = BSP_ERROR_NONE;
+    BaseType_t xResult;
 
-    configASSERT( pxReturnInfo != NULL );
+    /* Gyro + Accelerometer, sampled by the motion sampler task */
+    xResult = xMotionSamplerStart();
 
-    uint32_t ulNotifyValue = pxReturnInfo->returnCode;
+    /* Magnetometer */
+    lBspError |= BSP_MOTION_SENSOR_Init( 1, MOTION_MAGNETO );
+    lBspError |= BSP_MOTION_SENSOR_Enable( 1, MOTION_MAGNETO );
+    lBspError |= BSP_MOTION_SENSOR_SetOutputDataRate( 1, MOTION_MAGNETO, 1.0f );
 
-    if( xTaskHandle != NULL )
-    {
-        /* Send the context's ulNotificationValue as the notification value so
-         * the receiving task can check the value it set in the context matches
-         * the value it receives in the notification. */
-        ( void ) xTaskNotifyIndexed( xTaskHandle,
-                                     MQTT_NOTIFY_IDX,
-                                     ulNotifyValue,
-                                     eSetValueWithOverwrite );
-    }
+    return( ( ( xResult == pdTRUE ) && ( lBspError == BSP_ERROR_NONE ) ) ? pdTRUE : pdFALSE );
 }
 
+
 /*-----------------------------------------------------------*/
 
-static BaseType_t prvPublishAndWaitForAck( MQTTAgentHandle_t xAgentHandle,
-                                           const char * pcTopic,
-                                           const void * pvPublishData,
-                                           size_t xPublishDataLen )
+static inline int32_t prvRound( float_t fValue )
 {
-    MQTTStatus_t xStatus;
-    size_t uxTopicLen = 0;
-
-    configASSERT( pcTopic != NULL );
-    configASSERT( pvPublishData != NULL );
-    configASSERT( xPublishDataLen > 0 );
-
-    uxTopicLen = strnlen( pcTopic, UINT16_MAX );
-
-    MQTTPublishInfo_t xPublishInfo =
-    {
-        .qos             = MQTT_PUBLISH_QOS,
-        .retain          = 0,
-        .dup             = 0,
-        .pTopicName      = pcTopic,
-        .topicNameLength = ( uint16_t ) uxTopicLen,
-        .pPayload        = pvPublishData,
-        .payloadLength   = xPublishDataLen
-    };
-
-    MQTTAgentCommandInfo_t xCommandParams =
-    {
-        .blockTimeMs                 = MQTT_PUBLISH_BLOCK_TIME_MS,
-        .cmdCompleteCallback         = prvPublishCommandCallback,
-        .pCmdCompleteCallbackContext = ( void * ) xTaskGetCurrentTaskHandle(),
-    };
-
-    if( xPublishInfo.qos > MQTTQoS0 )
-    {
-        xCommandParams.pCmdCompleteCallbackContext = ( void * ) xTaskGetCurrentTaskHandle();
-    }
-
-    /* Clear the notification index */
-    xTaskNotifyStateClearIndexed( NULL, MQTT_NOTIFY_IDX );
-
-
-    xStatus = MQTTAgent_Publish( xAgentHandle,
-                                 &xPublishInfo,
-                                 &xCommandParams );
-
-    if( xStatus == MQTTSuccess )
-    {
-        uint32_t ulNotifyValue = 0;
-        BaseType_t xResult = pdFALSE;
-
-        xResult = xTaskNotifyWaitIndexed( MQTT_NOTIFY_IDX,
-                                          0xFFFFFFFF,
-                                          0xFFFFFFFF,
-                                          &ulNotifyValue,
-                                          pdMS_TO_TICKS( MQTT_PUBLISH_NOTIFICATION_WAIT_MS ) );
-
-        if( xResult )
-        {
-            xStatus = ( MQTTStatus_t ) ulNotifyValue;
-
-            if( xStatus != MQTTSuccess )
-            {
-                LogError( "MQTT Agent returned error code: %d during publish operation.",
-                          xStatus );
-                xResult = pdFALSE;
-            }
-        }
-        else
-        {
-            LogError( "Timed out while waiting for publish ACK or Sent event. xTimeout = %d",
-                      pdMS_TO_TICKS( MQTT_PUBLISH_NOTIFICATION_WAIT_MS ) );
-            xResult = pdFALSE;
-        }
-    }
-    else
-    {
-        LogError( "MQTTAgent_Publish returned error code: %d.", xStatus );
-    }
-
-    return( xStatus == MQTTSuccess );
+    return ( int32_t ) ( fValue + ( ( fValue < 0.0f ) ? -0.5f : 0.5f ) );
 }
 
-/*-----------------------------------------------------------*/
-static BaseType_t xInitSensors( void )
+/* Report the window means as the regular axis values, along with the extra statistics */
+static void prvFillMotionTelemetry( struct IOTC_U5IOT_TELEMETRY * pxPayload,
+                                    const MotionWindowStats_t * pxStats )
 {
-    int32_t lBspError = BSP_ERROR_NONE;
-
-    /* Gyro + Accelerometer*/
-    lBspError = BSP_MOTION_SENSOR_Init( 0, MOTION_GYRO | MOTION_ACCELERO );
-    lBspError |= BSP_MOTION_SENSOR_Enable( 0, MOTION_GYRO );
-    lBspError |= BSP_MOTION_SENSOR_Enable( 0, MOTION_ACCELERO );
-    lBspError |= BSP_MOTION_SENSOR_SetOutputDataRate( 0, MOTION_GYRO, 1.0f );
-    lBspError |= BSP_MOTION_SENSOR_SetOutputDataRate( 0, MOTION_ACCELERO, 1.0f );
+    pxPayload->xAcceleroAxes.x = prvRound( pxStats->xAccelero.pfMean[ 0 ] );
+    pxPayload->xAcceleroAxes.y = prvRound( pxStats->xAccelero.pfMean[ 1 ] );
+    pxPayload->xAcceleroAxes.z = prvRound( pxStats->xAccelero.pfMean[ 2 ] );
+    pxPayload->xGyroAxes.x = prvRound( pxStats->xGyro.pfMean[ 0 ] );
+    pxPayload->xGyroAxes.y = prvRound( pxStats->xGyro.pfMean[ 1 ] );
+    pxPayload->xGyroAxes.z = prvRound( pxStats->xGyro.pfMean[ 2 ] );
 
-    /* Magnetometer */
-    lBspError |= BSP_MOTION_SENSOR_Init( 1, MOTION_MAGNETO );
-    lBspError |= BSP_MOTION_SENSOR_Enable( 1, MOTION_MAGNETO );
-    lBspError |= BSP_MOTION_SENSOR_SetOutputDataRate( 1, MOTION_MAGNETO, 1.0f );
+    pxPayload->xMotionStats.xAcceleroMin = pxStats->xAccelero.xMin;
+    pxPayload->xMotionStats.xAcceleroMax = pxStats->xAccelero.xMax;
 
-    return( lBspError == BSP_ERROR_NONE ? pdTRUE : pdFALSE );
+    for( size_t i = 0; i < 3; i++ )
+    {
+        pxPayload->xMotionStats.pfAcceleroRms[ i ] = pxStats->xAccelero.pfRms[ i ];
+        pxPayload->xMotionStats.pfGyroRms[ i ] = pxStats->xGyro.pfRms[ i ];
+    }
 }
 
-
 /*-----------------------------------------------------------*/
 void vMotionSensorsPublish( void * pvParameters )
 {
@@ -230,7 +134,8 @@ void vMotionSensorsPublish( void * pvParameters )
     MQTTAgentHandle_t xAgentHandle = NULL;
     char pcPayloadBuf[ MQTT_PUBLISH_MAX_LEN ];
     char pcTopicString[ MQTT_PUBLICH_TOPIC_STR_LEN ] = { 0 };
-    char * pcDeviceId = NULL;
+    KVStoreView_t xDeviceId = { 0 };
+    BaseType_t xViewResult = pdFALSE;
     int lTopicLen = 0;
 
     xResult = xInitSensors();
@@ -241,16 +146,25 @@ void vMotionSensorsPublish( void * pvParameters )
         vTaskDelete( NULL );
     }
 
-    pcDeviceId = KVStore_getStringHeap( CS_CORE_THING_NAME, NULL );
+    /* Sensors are initialized while the key value store is loaded */
+    ( void ) xEventGroupWaitBits( xSystemEvents,
+                                  EVT_MASK_KVSTORE_READY,
+                                  pdFALSE,
+                                  pdTRUE,
+                                  portMAX_DELAY );
 
-    if( pcDeviceId == NULL )
-    {
-        xExitFlag = pdTRUE;
-    }
-    else
+    /* Build the topic straight from the cached thing name, retrying if it changes meanwhile */
+    do
     {
-        lTopicLen = snprintf( pcTopicString, ( size_t ) MQTT_PUBLICH_TOPIC_STR_LEN, "%s/motion_sensor_data", pcDeviceId );
+        xViewResult = KVStore_view_CS_CORE_THING_NAME( &xDeviceId );
+
+        if( xViewResult == pdTRUE )
+        {
+            lTopicLen = snprintf( pcTopicString, ( size_t ) MQTT_PUBLICH_TOPIC_STR_LEN, "%.*s/motion_sensor_data",
+                                  ( int ) xDeviceId.xLength, xDeviceId.pcData );
+        }
     }
+    while( ( xViewResult == pdTRUE ) && ( KVStore_isViewCurrent( &xDeviceId ) == pdFALSE ) );
 
     if( ( lTopicLen <= 0 ) || ( lTopicLen > MQTT_PUBLICH_TOPIC_STR_LEN ) )
     {
@@ -267,24 +181,29 @@ void vMotionSensorsPublish( void * pvParameters )
         /* Interpret sensor data */
         int32_t lBspError = BSP_ERROR_NONE;
         struct IOTC_U5IOT_TELEMETRY payload;
+        MotionWindowStats_t xStats;
 
-        lBspError = BSP_MOTION_SENSOR_GetAxes( 0, MOTION_GYRO, &payload.xGyroAxes );
-        lBspError |= BSP_MOTION_SENSOR_GetAxes( 0, MOTION_ACCELERO, &payload.xAcceleroAxes );
-        lBspError |= BSP_MOTION_SENSOR_GetAxes( 1, MOTION_MAGNETO, &payload.xMagnetoAxes );
+        lBspError = BSP_MOTION_SENSOR_GetAxes( 1, MOTION_MAGNETO, &payload.xMagnetoAxes );
 
-        if( lBspError == BSP_ERROR_NONE )
+        if( ( lBspError == BSP_ERROR_NONE ) && xMotionSamplerGetWindow( &xStats ) )
         {
+            prvFillMotionTelemetry( &payload, &xStats );
+
+            LogDebug( "Aggregated %lu motion samples, %lu dropped, max interval %lu cycles.",
+                      ( unsigned long ) xStats.ulNumSamples,
+                      ( unsigned long ) xStats.ulDropped,
+                      ( unsigned long ) xStats.ulMaxIntervalCycles );
+
             payload.bMotionSensorValid = true;
             payload.bEnvSensorDataValid = false;
+            payload.bMotionStatsValid = true;
 
-        	if(xIsMqttAgentConnected() == pdTRUE)
-            {
-            	iotcApp_create_and_send_telemetry_json(&payload, sizeof(payload));
-            }
+            /* Published by vTelemetryBatchTask together with other queued samples */
+            ( void ) xTelemetryBatchSubmit( &payload );
         }
 
         vTaskDelay( pdMS_TO_TICKS( MQTT_PUBLISH_PERIOD_MS ) );
     }
 
-    vPortFree( pcDeviceId );
+    vTaskDelete( NULL );
 }
@@ -42,6 +42,8 @@
 #include "event_groups.h"
 
 #include "mqtt_metrics.h"
+#include "app/boot_metrics.h"
+#include "trace_ring.h"
 
 /* MQTT library includes. */
 #include "core_mqtt.h"
@@ -55,14 +57,15 @@
 /* MQTT Agent ports. */
 #include "freertos_command_pool.h"
 
-/* Exponential backoff retry include. */
-#include "backoff_algorithm.h"
+/* Cause based reconnect scheduling. */
+#include "reconnect_policy.h"
 
 /* Subscription manager header include. */
 #include "subscription_manager.h"
 
 #include "mbedtls_transport.h"
 #include "sys_evt.h"
+#include "mx_netconn.h"
 
 #include "iotconnect.h"
 #include "iotc_mqtt_client.h"
@@ -75,27 +78,6 @@
  */
 #define CONNACK_RECV_TIMEOUT_MS     ( 2000U )
 
-/**
- * @brief The minimum back-off delay to use for network operation retry
- * attempts.
- */
-#define RETRY_BACKOFF_BASE          ( 10U )
-
-/**
- * @brief The maximum back-off delay for retrying failed operation
- *  with server.
- */
-#define RETRY_MAX_BACKOFF_DELAY     ( 5U * 60U )
-
-/**
- * @brief Multiplier to apply to the backoff delay to convert arbitrary units to milliseconds.
- */
-#define RETRY_BACKOFF_MULTIPLIER    ( 100U )
-
-static_assert( RETRY_BACKOFF_BASE < UINT16_MAX );
-static_assert( RETRY_MAX_BACKOFF_DELAY < UINT16_MAX );
-static_assert( ( ( uint64_t ) RETRY_BACKOFF_MULTIPLIER * ( uint64_t ) RETRY_MAX_BACKOFF_DELAY ) < UINT32_MAX );
-
 /**
  * @brief The maximum time interval in seconds which is allowed to elapse
  *  between two Control Packets.
@@ -218,6 +200,17 @@ static MQTTStatus_t prvHandleResubscribe( MQTTAgentContext_t * pxMqttAgentCtx,
  */
 static uint32_t prvGetTimeMs( void );
 
+/**
+ * @brief Check whether the network interface is up.
+ */
+static bool prvIsLinkUp( void );
+
+/**
+ * @brief Wait as long as the reconnect policy requires after a failure and
+ * ask the network task to reconnect if the policy suspects a stale link.
+ */
+static void prvWaitBeforeReconnect( ReconnectCause_t xCause );
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -509,6 +502,8 @@ static bool prvAgentMessageSend( MQTTAgentMessageContext_t * pxMsgCtx,
     {
         xQueueStatus = xQueueSendToBack( pxMsgCtx->xQueue, pxCommandToSend, pdMS_TO_TICKS( blockTimeMs ) );
 
+        TRACE_INSTANT( TRACE_ID_AGENT_ENQUEUE, ( *pxCommandToSend != NULL ) ? ( *pxCommandToSend )->commandType : NONE );
+
         /* Notify the agent that a message is waiting */
         if( pxMsgCtx->xAgentTaskHandle )
         {
@@ -531,6 +526,9 @@ static bool prvAgentMessageReceive( MQTTAgentMessageContext_t * pxMsgCtx,
     BaseType_t xQueueStatus = pdFAIL;
     uint32_t ulNotifyValue = 0;
 
+    /* The agent calls back here once it has finished with the previous command */
+    TRACE_END( TRACE_ID_AGENT_CMD, 0 );
+
     if( pxMsgCtx && ppxReceivedCommand )
     {
         if( xTaskNotifyWaitIndexed( MQTT_AGENT_NOTIFY_IDX,
@@ -549,6 +547,9 @@ static bool prvAgentMessageReceive( MQTTAgentMessageContext_t * pxMsgCtx,
                 xQueueStatus = xQueueReceive( pxMsgCtx->xQueue, ppxReceivedCommand, 0 );
             }
         }
+
+        TRACE_BEGIN( TRACE_ID_AGENT_CMD, ( ( xQueueStatus == pdPASS ) && ( *ppxReceivedCommand != NULL ) ) ?
+                     ( *ppxReceivedCommand )->commandType : NONE );
     }
 
     return ( bool ) xQueueStatus;
@@ -1002,7 +1003,7 @@ void vMQTTAgentTask(void *arg)
     MQTTAgentTaskCtx_t * pxCtx = NULL;
     uint8_t * pucNetworkBuffer = NULL;
     NetworkContext_t * pxNetworkContext = NULL;
-    uint16_t usNextRetryBackOff = 0U;
+    ReconnectCause_t xCause = RECONNECT_CAUSE_MQTT;
 
     /* Miscellaneous initialization. */
     ulGlobalEntryTimeMs = prvGetTimeMs();
@@ -1041,6 +1042,11 @@ void vMQTTAgentTask(void *arg)
             LogError( "Failed to configure mbedtls transport." );
             xMQTTStatus = MQTTBadParameter;
         }
+        else
+        {
+            /* Keys and certificates are loaded before waiting for the network */
+            vBootMetricsMark( BOOT_MILESTONE_TLS_CONFIGURED );
+        }
     }
 
     if( xMQTTStatus == MQTTSuccess )
@@ -1108,20 +1114,10 @@ void vMQTTAgentTask(void *arg)
     /* Outer Reconnect loop */
     while( xExitFlag != pdTRUE )
     {
-        BackoffAlgorithmStatus_t xBackoffAlgStatus = BackoffAlgorithmSuccess;
-        BackoffAlgorithmContext_t xReconnectParams = { 0 };
-
-        /* Initialize backoff algorithm with jitter */
-        BackoffAlgorithm_InitializeParams( &xReconnectParams,
-                                           RETRY_BACKOFF_BASE,
-                                           RETRY_MAX_BACKOFF_DELAY,
-                                           BACKOFF_ALGORITHM_RETRY_FOREVER );
-
         xTlsStatus = TLS_TRANSPORT_UNKNOWN_ERROR;
 
         /* Connect a socket to the broker with retries */
-        while( xTlsStatus != TLS_TRANSPORT_SUCCESS &&
-               xBackoffAlgStatus == BackoffAlgorithmSuccess )
+        while( xTlsStatus != TLS_TRANSPORT_SUCCESS )
         {
             /* Block until the network interface is connected */
             ( void ) xEventGroupWaitBits( xSystemEvents,
@@ -1130,6 +1126,9 @@ void vMQTTAgentTask(void *arg)
                                           pdTRUE,
                                           portMAX_DELAY );
 
+            vBootMetricsMark( BOOT_MILESTONE_NET_CONNECTED );
+            vReconnectPolicyAttemptStart();
+
             LogInfo( "Attempting a TLS connection to %s:%d.",
                      pxCtx->pcMqttEndpoint, pxCtx->ulMqttPort );
 
@@ -1138,25 +1137,13 @@ void vMQTTAgentTask(void *arg)
                                                     ( uint16_t ) pxCtx->ulMqttPort,
                                                     0, 0 );
 
-            if( xTlsStatus != TLS_TRANSPORT_SUCCESS )
+            if( xTlsStatus == TLS_TRANSPORT_SUCCESS )
             {
-                /* Get back-off value (in seconds) for the next connection retry. */
-                xBackoffAlgStatus = BackoffAlgorithm_GetNextBackoff( &xReconnectParams,
-                                                                     uxRand(),
-                                                                     &usNextRetryBackOff );
-
-                if( xBackoffAlgStatus == BackoffAlgorithmSuccess )
-                {
-                    LogWarn( "Connecting to the mqtt broker failed. "
-                             "Retrying connection in %lu ms.",
-                             RETRY_BACKOFF_MULTIPLIER * usNextRetryBackOff );
-                    vTaskDelay( pdMS_TO_TICKS( RETRY_BACKOFF_MULTIPLIER * usNextRetryBackOff ) );
-                }
-                else
-                {
-                    LogError( "Connection to the broker failed, all attempts exhausted." );
-                    xExitFlag = pdTRUE;
-                }
+                vBootMetricsMark( BOOT_MILESTONE_TLS_CONNECTED );
+            }
+            else
+            {
+                prvWaitBeforeReconnect( xReconnectPolicyClassifyTls( xTlsStatus, prvIsLinkUp() ) );
             }
         }
 
@@ -1174,6 +1161,20 @@ void vMQTTAgentTask(void *arg)
                                         CONNACK_RECV_TIMEOUT_MS,
                                         &xSessionPresent );
 
+            if( xMQTTStatus == MQTTSuccess )
+            {
+                uint32_t ulConnackMs = 0;
+
+                if( !xBootMetricsGet( BOOT_MILESTONE_MQTT_CONNACK, &ulConnackMs ) )
+                {
+                    vBootMetricsMark( BOOT_MILESTONE_MQTT_CONNACK );
+                    ( void ) xBootMetricsGet( BOOT_MILESTONE_MQTT_CONNACK, &ulConnackMs );
+                    LogSys( "Boot to MQTT CONNACK took %lu ms.", ( unsigned long ) ulConnackMs );
+                }
+
+                vReconnectPolicyOnConnected();
+            }
+
             configASSERT_CONTINUE( MUTEX_IS_OWNED( pxCtx->xSubMgrCtx.xMutex ) );
 
             /* Resume a session if desired. */
@@ -1237,12 +1238,6 @@ void vMQTTAgentTask(void *arg)
         {
             ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_MQTT_CONNECTED );
 
-            /* Reset backoff timer */
-            BackoffAlgorithm_InitializeParams( &xReconnectParams,
-                                               RETRY_BACKOFF_BASE,
-                                               RETRY_MAX_BACKOFF_DELAY,
-                                               BACKOFF_ALGORITHM_RETRY_FOREVER );
-
             /* MQTTAgent_CommandLoop() is effectively the agent implementation.  It
              * will manage the MQTT protocol until such time that an error occurs,
              * which could be a disconnect.  If an error occurs the MQTT context on
@@ -1252,6 +1247,13 @@ void vMQTTAgentTask(void *arg)
 
             LogDebug( "MQTTAgent_CommandLoop returned with status: %s.",
                       MQTT_Status_strerror( xMQTTStatus ) );
+
+            xCause = xReconnectPolicyClassifyMqtt( xMQTTStatus, prvIsLinkUp() );
+            vReconnectPolicyOnDisconnected( xCause );
+        }
+        else
+        {
+            xCause = xReconnectPolicyClassifyMqtt( xMQTTStatus, prvIsLinkUp() );
         }
 
         ( void ) MQTTAgent_CancelAll( &( pxCtx->xAgentContext ) );
@@ -1273,23 +1275,7 @@ void vMQTTAgentTask(void *arg)
 
         if( !xExitFlag )
         {
-            /* Get back-off value (in seconds) for the next connection retry. */
-            xBackoffAlgStatus = BackoffAlgorithm_GetNextBackoff( &xReconnectParams,
-                                                                 uxRand(),
-                                                                 &usNextRetryBackOff );
-
-            if( xBackoffAlgStatus == BackoffAlgorithmSuccess )
-            {
-                LogWarn( "Disconnected from the MQTT Broker. Retrying in %lu ms.",
-                         RETRY_BACKOFF_MULTIPLIER * usNextRetryBackOff );
-
-                vTaskDelay( pdMS_TO_TICKS( RETRY_BACKOFF_MULTIPLIER * usNextRetryBackOff ) );
-            }
-            else
-            {
-                LogError( "Reconnect limit reached. Will exit..." );
-                xExitFlag = pdTRUE;
-            }
+            prvWaitBeforeReconnect( xCause );
         }
     }
 
@@ -1327,6 +1313,39 @@ static uint32_t prvGetTimeMs( void )
 
 /*-----------------------------------------------------------*/
 
+static bool prvIsLinkUp( void )
+{
+    return( ( xEventGroupGetBits( xSystemEvents ) & EVT_MASK_NET_CONNECTED ) != 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvWaitBeforeReconnect( ReconnectCause_t xCause )
+{
+    bool xRequestLinkReset = false;
+    uint32_t ulDelayMs = ulReconnectPolicyOnFailure( xCause, &xRequestLinkReset );
+
+    if( xRequestLinkReset )
+    {
+        LogWarn( "Repeated %s failures while the network is up. Requesting a network reconnect.",
+                 pcReconnectPolicyCauseName( xCause ) );
+        ( void ) net_request_reconnect();
+    }
+
+    if( ulDelayMs > 0 )
+    {
+        LogWarn( "Connecting to the MQTT broker failed (%s). Retrying in %lu ms.",
+                 pcReconnectPolicyCauseName( xCause ), ( unsigned long ) ulDelayMs );
+        vTaskDelay( pdMS_TO_TICKS( ulDelayMs ) );
+    }
+    else
+    {
+        LogInfo( "Reconnecting to the MQTT broker (%s).", pcReconnectPolicyCauseName( xCause ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 static inline MQTTQoS_t prvGetNewQoS( MQTTQoS_t xCurrentQoS,
                                       MQTTQoS_t xRequestedQoS )
 {
@@ -1839,3 +1858,64 @@ MQTTStatus_t MqttAgent_UnSubscribeSync( MQTTAgentHandle_t xHandle,
 
     return xStatus;
 }
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MqttAgent_PublishSync( MQTTAgentHandle_t xHandle,
+                                    MQTTPublishInfo_t * pxPublishInfo,
+                                    uint32_t ulTimeoutMs )
+{
+    MQTTStatus_t xStatus = MQTTSuccess;
+    MQTTAgentTaskCtx_t * pxTaskCtx = ( MQTTAgentTaskCtx_t * ) xHandle;
+
+    MQTTAgentCommandInfo_t xCommandInfo =
+    {
+        .blockTimeMs                 = ulTimeoutMs,
+        .cmdCompleteCallback         = prvAgentRequestCallback,
+        .pCmdCompleteCallbackContext = ( void * ) xTaskGetCurrentTaskHandle(),
+    };
+
+    if( ( xHandle == NULL ) ||
+        ( pxPublishInfo == NULL ) ||
+        ( pxPublishInfo->pTopicName == NULL ) ||
+        ( pxPublishInfo->topicNameLength == 0 ) ||
+        !prvValidateQoS( pxPublishInfo->qos ) )
+    {
+        xStatus = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) xTaskNotifyStateClearIndexed( NULL, MQTT_AGENT_NOTIFY_IDX );
+
+        xStatus = MQTTAgent_Publish( &( pxTaskCtx->xAgentContext ), pxPublishInfo, &xCommandInfo );
+    }
+
+    if( xStatus == MQTTSuccess )
+    {
+        uint32_t ulNotifyValue = 0;
+
+        if( xTaskNotifyWaitIndexed( MQTT_AGENT_NOTIFY_IDX,
+                                    0x0,
+                                    0xFFFFFFFF,
+                                    &ulNotifyValue,
+                                    pdMS_TO_TICKS( ulTimeoutMs ) ) )
+        {
+            xStatus = ulNotifyValue;
+        }
+        else
+        {
+            LogError( "Timed out waiting for the publish to \"%.*s\" to complete.",
+                      pxPublishInfo->topicNameLength, pxPublishInfo->pTopicName );
+            xStatus = MQTTSendFailed;
+        }
+    }
+
+    if( xStatus != MQTTSuccess )
+    {
+        LogError( "Failed to publish %lu bytes: %s",
+                  ( unsigned long ) ( ( pxPublishInfo != NULL ) ? pxPublishInfo->payloadLength : 0 ),
+                  MQTT_Status_strerror( xStatus ) );
+    }
+
+    return xStatus;
+}
@@ -0,0 +1,409 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file reconnect_policy.c
+ * @brief Cause based reconnect backoff and outage histograms for the MQTT agent.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+#include "reconnect_policy.h"
+
+/* A connection that lasted at least this long resets the backoff when it is lost */
+#define RECONNECT_STABLE_TIME_MS    ( 30U * 1000U )
+
+typedef struct
+{
+    uint32_t ulFirstDelayMs; /*!< Delay after the first failure */
+    uint32_t ulBaseDelayMs;  /*!< Doubled for each further consecutive failure */
+    uint32_t ulMaxDelayMs;
+} ReconnectBackoff_t;
+
+static const ReconnectBackoff_t xBackoffTable[ RECONNECT_CAUSE_MAX ] =
+{
+    [ RECONNECT_CAUSE_LINK_LOSS ]       = { 0U,           0U,           0U                  },
+    [ RECONNECT_CAUSE_CONNECTION_LOST ] = { 0U,           1000U,        60U * 1000U         },
+    [ RECONNECT_CAUSE_DNS ]             = { 1000U,        1000U,        60U * 1000U         },
+    [ RECONNECT_CAUSE_TCP ]             = { 1000U,        1000U,        60U * 1000U         },
+    [ RECONNECT_CAUSE_TLS ]             = { 2000U,        2000U,        5U * 60U * 1000U    },
+    [ RECONNECT_CAUSE_AUTH_REJECTED ]   = { 60U * 1000U,  60U * 1000U,  60U * 60U * 1000U   },
+    [ RECONNECT_CAUSE_MQTT ]            = { 2000U,        2000U,        5U * 60U * 1000U    },
+};
+
+static const uint32_t pulBucketLimitMs[ RECONNECT_HIST_NUM_BUCKETS ] =
+{
+    500U, 1000U, 2000U, 5000U, 10000U, 30000U, 60000U, 300000U, UINT32_MAX
+};
+
+static const char * const pcCauseNames[ RECONNECT_CAUSE_MAX ] =
+{
+    [ RECONNECT_CAUSE_LINK_LOSS ]       = "link_loss",
+    [ RECONNECT_CAUSE_CONNECTION_LOST ] = "connection_lost",
+    [ RECONNECT_CAUSE_DNS ]             = "dns",
+    [ RECONNECT_CAUSE_TCP ]             = "tcp",
+    [ RECONNECT_CAUSE_TLS ]             = "tls",
+    [ RECONNECT_CAUSE_AUTH_REJECTED ]   = "auth_rejected",
+    [ RECONNECT_CAUSE_MQTT ]            = "mqtt",
+};
+
+extern UBaseType_t uxRand( void );
+
+/* Backoff state, only used by the MQTT agent task */
+static ReconnectCause_t xLastCause = RECONNECT_CAUSE_MAX;
+static uint32_t ulConsecutiveFailures = 0;
+static uint32_t ulLinkFailures = 0;
+static bool xAttemptStarted = false;
+static TickType_t xAttemptStartTicks = 0;
+static bool xInOutage = false;
+static TickType_t xOutageStartTicks = 0;
+static TickType_t xConnectedTicks = 0;
+
+/* Read by the CLI, updated in critical sections */
+static ReconnectStats_t xStats = { 0 };
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvTicksToMs( TickType_t xTicks )
+{
+    return ( uint32_t ) ( xTicks * portTICK_PERIOD_MS );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvBucketIndex( uint32_t ulMs )
+{
+    uint32_t ulBucket = 0;
+
+    while( ( ulBucket < ( RECONNECT_HIST_NUM_BUCKETS - 1 ) ) &&
+           ( ulMs >= pulBucketLimitMs[ ulBucket ] ) )
+    {
+        ulBucket++;
+    }
+
+    return ulBucket;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Delay after ulFailures previous consecutive failures, with jitter over the upper half of the ceiling */
+static uint32_t prvBackoffDelayMs( const ReconnectBackoff_t * pxBackoff,
+                                   uint32_t ulFailures )
+{
+    uint32_t ulCeilingMs = pxBackoff->ulFirstDelayMs;
+
+    if( ulFailures > 0 )
+    {
+        ulCeilingMs = pxBackoff->ulBaseDelayMs;
+
+        for( uint32_t i = 0; ( i < ulFailures ) && ( ulCeilingMs < pxBackoff->ulMaxDelayMs ); i++ )
+        {
+            ulCeilingMs *= 2;
+        }
+    }
+
+    if( ulCeilingMs > pxBackoff->ulMaxDelayMs )
+    {
+        ulCeilingMs = pxBackoff->ulMaxDelayMs;
+    }
+
+    if( ulCeilingMs > 1 )
+    {
+        ulCeilingMs = ( ulCeilingMs / 2 ) + ( ( uint32_t ) uxRand() % ( ( ulCeilingMs / 2 ) + 1 ) );
+    }
+
+    return ulCeilingMs;
+}
+
+/*-----------------------------------------------------------*/
+
+ReconnectCause_t xReconnectPolicyClassifyTls( TlsTransportStatus_t xStatus,
+                                              bool xLinkUp )
+{
+    ReconnectCause_t xCause = RECONNECT_CAUSE_TLS;
+
+    if( !xLinkUp )
+    {
+        xCause = RECONNECT_CAUSE_LINK_LOSS;
+    }
+    else
+    {
+        switch( xStatus )
+        {
+            case TLS_TRANSPORT_DNS_FAILED:
+            case TLS_TRANSPORT_INVALID_HOSTNAME:
+                xCause = RECONNECT_CAUSE_DNS;
+                break;
+
+            case TLS_TRANSPORT_CONNECT_FAILURE:
+            case TLS_TRANSPORT_INSUFFICIENT_SOCKETS:
+                xCause = RECONNECT_CAUSE_TCP;
+                break;
+
+            /* Retrying will not help until the device is provisioned again */
+            case TLS_TRANSPORT_INVALID_CREDENTIALS:
+            case TLS_TRANSPORT_PKI_OBJECT_NOT_FOUND:
+            case TLS_TRANSPORT_PKI_OBJECT_PARSE_FAIL:
+            case TLS_TRANSPORT_CLIENT_CERT_INVALID:
+            case TLS_TRANSPORT_NO_VALID_CA_CERT:
+            case TLS_TRANSPORT_CLIENT_KEY_INVALID:
+                xCause = RECONNECT_CAUSE_AUTH_REJECTED;
+                break;
+
+            default:
+                xCause = RECONNECT_CAUSE_TLS;
+                break;
+        }
+    }
+
+    return xCause;
+}
+
+/*-----------------------------------------------------------*/
+
+ReconnectCause_t xReconnectPolicyClassifyMqtt( MQTTStatus_t xStatus,
+                                               bool xLinkUp )
+{
+    ReconnectCause_t xCause = RECONNECT_CAUSE_MQTT;
+
+    if( !xLinkUp )
+    {
+        xCause = RECONNECT_CAUSE_LINK_LOSS;
+    }
+    else
+    {
+        switch( xStatus )
+        {
+            /* coreMQTT does not expose the CONNACK return code, so a broker that is
+             * unavailable is treated the same as one rejecting the credentials. */
+            case MQTTServerRefused:
+                xCause = RECONNECT_CAUSE_AUTH_REJECTED;
+                break;
+
+            /* Disconnect requested through the agent */
+            case MQTTSuccess:
+            case MQTTSendFailed:
+            case MQTTRecvFailed:
+            case MQTTKeepAliveTimeout:
+                xCause = RECONNECT_CAUSE_CONNECTION_LOST;
+                break;
+
+            default:
+                xCause = RECONNECT_CAUSE_MQTT;
+                break;
+        }
+    }
+
+    return xCause;
+}
+
+/*-----------------------------------------------------------*/
+
+void vReconnectPolicyAttemptStart( void )
+{
+    if( !xAttemptStarted )
+    {
+        xAttemptStartTicks = xTaskGetTickCount();
+        xAttemptStarted = true;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulReconnectPolicyOnFailure( ReconnectCause_t xCause,
+                                     bool * pxRequestLinkReset )
+{
+    uint32_t ulDelayMs = 0;
+    bool xRequestLinkReset = false;
+
+    configASSERT( xCause < RECONNECT_CAUSE_MAX );
+
+    if( xCause != xLastCause )
+    {
+        ulConsecutiveFailures = 0;
+        xLastCause = xCause;
+    }
+
+    ulDelayMs = prvBackoffDelayMs( &( xBackoffTable[ xCause ] ), ulConsecutiveFailures );
+
+    if( ulConsecutiveFailures < UINT32_MAX )
+    {
+        ulConsecutiveFailures++;
+    }
+
+    if( ( xCause == RECONNECT_CAUSE_DNS ) ||
+        ( xCause == RECONNECT_CAUSE_TCP ) )
+    {
+        ulLinkFailures++;
+
+        if( ulLinkFailures >= RECONNECT_LINK_RESET_THRESHOLD )
+        {
+            xRequestLinkReset = true;
+            ulLinkFailures = 0;
+        }
+    }
+    else
+    {
+        ulLinkFailures = 0;
+    }
+
+    taskENTER_CRITICAL();
+    xStats.pulCauseCount[ xCause ]++;
+
+    if( xRequestLinkReset )
+    {
+        xStats.ulLinkResets++;
+    }
+
+    taskEXIT_CRITICAL();
+
+    if( pxRequestLinkReset != NULL )
+    {
+        *pxRequestLinkReset = xRequestLinkReset;
+    }
+
+    return ulDelayMs;
+}
+
+/*-----------------------------------------------------------*/
+
+void vReconnectPolicyOnConnected( void )
+{
+    TickType_t xNow = xTaskGetTickCount();
+    uint32_t ulLatencyMs = 0;
+    uint32_t ulOutageMs = 0;
+    bool xHadOutage = xInOutage;
+
+    if( xAttemptStarted )
+    {
+        ulLatencyMs = prvTicksToMs( xNow - xAttemptStartTicks );
+    }
+
+    if( xHadOutage )
+    {
+        ulOutageMs = prvTicksToMs( xNow - xOutageStartTicks );
+        LogSys( "Reconnected to the MQTT broker after %lu ms (last cause: %s).",
+                ( unsigned long ) ulOutageMs, pcReconnectPolicyCauseName( xLastCause ) );
+    }
+
+    taskENTER_CRITICAL();
+
+    if( xAttemptStarted )
+    {
+        xStats.pulLatencyHist[ prvBucketIndex( ulLatencyMs ) ]++;
+    }
+
+    if( xHadOutage )
+    {
+        xStats.pulOutageHist[ prvBucketIndex( ulOutageMs ) ]++;
+        xStats.ulLastOutageMs = ulOutageMs;
+
+        if( ulOutageMs > xStats.ulMaxOutageMs )
+        {
+            xStats.ulMaxOutageMs = ulOutageMs;
+        }
+    }
+
+    taskEXIT_CRITICAL();
+
+    xAttemptStarted = false;
+    xInOutage = false;
+    xConnectedTicks = xNow;
+    ulLinkFailures = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+void vReconnectPolicyOnDisconnected( ReconnectCause_t xCause )
+{
+    TickType_t xNow = xTaskGetTickCount();
+    uint32_t ulConnectedMs = prvTicksToMs( xNow - xConnectedTicks );
+
+    LogWarn( "Lost the connection to the MQTT broker after %lu ms, cause: %s.",
+             ( unsigned long ) ulConnectedMs, pcReconnectPolicyCauseName( xCause ) );
+
+    /* Keep escalating the backoff if connections are dropped soon after they are established */
+    if( ulConnectedMs >= RECONNECT_STABLE_TIME_MS )
+    {
+        ulConsecutiveFailures = 0;
+        xLastCause = RECONNECT_CAUSE_MAX;
+    }
+
+    xInOutage = true;
+    xOutageStartTicks = xNow;
+}
+
+/*-----------------------------------------------------------*/
+
+void vReconnectPolicyGetStats( ReconnectStats_t * pxStats )
+{
+    if( pxStats != NULL )
+    {
+        taskENTER_CRITICAL();
+        ( void ) memcpy( pxStats, &xStats, sizeof( ReconnectStats_t ) );
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vReconnectPolicyClearStats( void )
+{
+    taskENTER_CRITICAL();
+    ( void ) memset( &xStats, 0, sizeof( ReconnectStats_t ) );
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulReconnectPolicyBucketLimitMs( uint32_t ulBucket )
+{
+    uint32_t ulLimitMs = UINT32_MAX;
+
+    if( ulBucket < RECONNECT_HIST_NUM_BUCKETS )
+    {
+        ulLimitMs = pulBucketLimitMs[ ulBucket ];
+    }
+
+    return ulLimitMs;
+}
+
+/*-----------------------------------------------------------*/
+
+const char * pcReconnectPolicyCauseName( ReconnectCause_t xCause )
+{
+    const char * pcName = "none";
+
+    if( xCause < RECONNECT_CAUSE_MAX )
+    {
+        pcName = pcCauseNames[ xCause ];
+    }
+
+    return pcName;
+}
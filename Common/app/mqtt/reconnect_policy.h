@@ -0,0 +1,125 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file reconnect_policy.h
+ * @brief Reconnect scheduling for the MQTT agent based on why the connection failed.
+ *
+ * Each failure is classified by its cause. A link flap or a dropped
+ * connection is retried as soon as the network is back, resuming the
+ * existing MQTT session. Failures that retrying is unlikely to fix, such as
+ * the broker rejecting the client credentials, back off much more slowly.
+ * Repeated DNS or TCP failures while the link reports up ask the network
+ * task to re-associate.
+ *
+ * The time from losing the connection to the next CONNACK (outage) and from
+ * the first attempt to CONNACK (reconnect latency) are kept as histograms.
+ */
+
+#ifndef RECONNECT_POLICY_H
+#define RECONNECT_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "core_mqtt.h"
+#include "mbedtls_transport.h"
+
+/* Consecutive DNS or TCP failures with the link up before requesting a network reconnect */
+#ifndef RECONNECT_LINK_RESET_THRESHOLD
+#define RECONNECT_LINK_RESET_THRESHOLD    ( 3U )
+#endif
+
+#define RECONNECT_HIST_NUM_BUCKETS        ( 9U )
+
+typedef enum
+{
+    RECONNECT_CAUSE_LINK_LOSS = 0,   /*!< Network interface went down */
+    RECONNECT_CAUSE_CONNECTION_LOST, /*!< Broker connection dropped while the link stayed up */
+    RECONNECT_CAUSE_DNS,
+    RECONNECT_CAUSE_TCP,
+    RECONNECT_CAUSE_TLS,
+    RECONNECT_CAUSE_AUTH_REJECTED,   /*!< CONNECT refused by the broker or client credentials unusable */
+    RECONNECT_CAUSE_MQTT,            /*!< Any other MQTT protocol failure */
+    RECONNECT_CAUSE_MAX
+} ReconnectCause_t;
+
+typedef struct
+{
+    uint32_t pulCauseCount[ RECONNECT_CAUSE_MAX ];
+    uint32_t pulOutageHist[ RECONNECT_HIST_NUM_BUCKETS ];  /*!< Connection lost to CONNACK */
+    uint32_t pulLatencyHist[ RECONNECT_HIST_NUM_BUCKETS ]; /*!< First connect attempt to CONNACK */
+    uint32_t ulMaxOutageMs;
+    uint32_t ulLastOutageMs;
+    uint32_t ulLinkResets;
+} ReconnectStats_t;
+
+/**
+ * @brief Classify a failed mbedtls_transport_connect call.
+ */
+ReconnectCause_t xReconnectPolicyClassifyTls( TlsTransportStatus_t xStatus,
+                                              bool xLinkUp );
+
+/**
+ * @brief Classify a failed MQTT_Connect call or the return value of MQTTAgent_CommandLoop.
+ */
+ReconnectCause_t xReconnectPolicyClassifyMqtt( MQTTStatus_t xStatus,
+                                               bool xLinkUp );
+
+/**
+ * @brief Record the start of a connection attempt. Only the first attempt since the last CONNACK is timed.
+ */
+void vReconnectPolicyAttemptStart( void );
+
+/**
+ * @brief Record a failure and get the time to wait before the next attempt.
+ *
+ * @param[in] xCause Cause of the failure.
+ * @param[out] pxRequestLinkReset Set to true if the network interface should be reconnected.
+ *
+ * @return Delay before the next attempt in milliseconds.
+ */
+uint32_t ulReconnectPolicyOnFailure( ReconnectCause_t xCause,
+                                     bool * pxRequestLinkReset );
+
+/**
+ * @brief Record a CONNACK. Updates the histograms and resets the backoff.
+ */
+void vReconnectPolicyOnConnected( void );
+
+/**
+ * @brief Record the loss of an established connection and start timing the outage.
+ */
+void vReconnectPolicyOnDisconnected( ReconnectCause_t xCause );
+
+void vReconnectPolicyGetStats( ReconnectStats_t * pxStats );
+
+void vReconnectPolicyClearStats( void );
+
+/**
+ * @brief Upper bound of a histogram bucket in milliseconds. UINT32_MAX for the last bucket.
+ */
+uint32_t ulReconnectPolicyBucketLimitMs( uint32_t ulBucket );
+
+const char * pcReconnectPolicyCauseName( ReconnectCause_t xCause );
+
+#endif /* RECONNECT_POLICY_H */
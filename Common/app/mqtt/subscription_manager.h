@@ -108,4 +108,18 @@ MQTTStatus_t MqttAgent_UnSubscribeSync( MQTTAgentHandle_t xHandle,
                                         IncomingPubCallback_t pxCallback,
                                         void * pvCallbackCtx );
 
+/* @brief Publish a message and wait until the MQTT Agent has completed the publish.
+ *
+ * For QoS 0 the publish is complete once the message has been sent, so the
+ * payload buffer may be reused as soon as this function returns.
+ *
+ * @param[in] xHandle Handle for the desired MQTT Agent Task instance.
+ * @param[in] pxPublishInfo Topic, QoS and payload of the message.
+ * @param[in] ulTimeoutMs Time to wait to queue the publish and again for it to complete.
+ * @return `MQTTSuccess` if the message was published.
+ **/
+MQTTStatus_t MqttAgent_PublishSync( MQTTAgentHandle_t xHandle,
+                                    MQTTPublishInfo_t * pxPublishInfo,
+                                    uint32_t ulTimeoutMs );
+
 #endif /* SUBSCRIPTION_MANAGER_H */
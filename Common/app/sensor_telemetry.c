@@ -16,6 +16,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <time.h>
 
 /* Kernel includes. */
 #include "FreeRTOS.h"
@@ -43,8 +44,40 @@
 #include "iotcl_log.h"
 #include "iotcl.h"
 
+#include "hw_defs.h"
+
 #include "app/sensor_telemetry.h"
+#include "app/telemetry_serializer.h"
+
+#define TELEMETRY_PAYLOAD_MAX_LEN            ( 4096 )
+#define TELEMETRY_PUBLISH_TIMEOUT_MS         ( 1000 )
+
+/* Publish buffer. Only used by the task publishing telemetry, which waits until each publish has been sent. */
+static char pcTelemetryPayload[ TELEMETRY_PAYLOAD_MAX_LEN ];
+
 
+/* @brief 	Publish a serialized telemetry message on the IoTConnect reporting topic
+ *
+ * Blocks until the MQTT agent has sent the message, so the payload buffer can be reused.
+ */
+static bool iotcApp_publish_telemetry(const char *pcPayload, size_t uxPayloadLen) {
+	IotclMqttConfig *pxMqttConfig = iotcl_mqtt_get_config();
+
+	if (pxMqttConfig == NULL || pxMqttConfig->pub_rpt == NULL) {
+		LogError("IoTConnect MQTT configuration is not available.");
+		return false;
+	}
+
+	MQTTPublishInfo_t xPublishInfo = {
+		.qos = MQTTQoS0,
+		.pTopicName = pxMqttConfig->pub_rpt,
+		.topicNameLength = (uint16_t)strlen(pxMqttConfig->pub_rpt),
+		.pPayload = pcPayload,
+		.payloadLength = uxPayloadLen,
+	};
+
+	return (MqttAgent_PublishSync(xGetMqttAgentHandle(), &xPublishInfo, TELEMETRY_PUBLISH_TIMEOUT_MS) == MQTTSuccess);
+}
 
 /* @brief 	Create JSON message containing telemetry data to publish
  *
@@ -52,40 +85,59 @@
 void iotcApp_create_and_send_telemetry_json(
 		const void *pToTelemetryStruct, size_t siz) {
 
-    const struct IOTC_U5IOT_TELEMETRY *p = (const struct IOTC_U5IOT_TELEMETRY *)pToTelemetryStruct;
-    IotclMessageHandle msg = iotcl_telemetry_create();
+    iotcU5IotTelemetrySample_t xSample;
 
     if(siz != sizeof(const struct IOTC_U5IOT_TELEMETRY)) {
         IOTCL_ERROR(siz, "Expected telemetry size does not match");
         return;
     }
 
-    // Optional. The first time you create a data poiF\Z\nt, the current timestamp will be automatically added
-    // TelemetryAddWith* calls are only required if sending multiple data points in one packet.
-	// FIXME: new iotc-c-lib has new API for adding timestamps
-	// iotcl_telemetry_add_with_iso_time(msg, NULL);
+    (void)memcpy(&xSample.xTelemetry, pToTelemetryStruct, sizeof(xSample.xTelemetry));
+    xSample.xTimestamp = time(NULL);
+    xSample.usTimestampMs = 0;
+
+    (void)iotcApp_create_and_send_telemetry_batch_json(&xSample, 1, NULL);
+}
+
+/* @brief 	Create JSON messages containing a data point per sample and publish them
+ *
+ * Samples are serialized straight into the publish buffer using the schema
+ * generated from the device template. A batch that does not fit in one
+ * message is split over several. Stops at the first message that cannot be
+ * created or published and returns the number of samples published before it.
+ */
+size_t iotcApp_create_and_send_telemetry_batch_json(
+		const iotcU5IotTelemetrySample_t *pxSamples, size_t uxNumSamples, size_t *puxBytesPublished) {
+
+    size_t uxTotalBytes = 0;
+    size_t uxSamplesPublished = 0;
+
+    while ((pxSamples != NULL) && (uxSamplesPublished < uxNumSamples)) {
+    	size_t uxSamplesWritten = 0;
+    	uint32_t ulStartCycles = ulGetCycleCount();
+    	size_t uxLen = uxTelemetrySerialize(&pxSamples[uxSamplesPublished], uxNumSamples - uxSamplesPublished,
+    			pcTelemetryPayload, sizeof(pcTelemetryPayload), &uxSamplesWritten);
+    	uint32_t ulCycles = ulGetCycleCount() - ulStartCycles;
+
+    	if (uxLen == 0) {
+    		LogError("Telemetry sample does not fit in a %u byte message.", (unsigned int)sizeof(pcTelemetryPayload));
+    		break;
+    	}
 
-    if (p->bMotionSensorValid) {
-    	iotcl_telemetry_set_number(msg, "acc_x", (double)p->xAcceleroAxes.x);
-    	iotcl_telemetry_set_number(msg, "acc_y", (double)p->xAcceleroAxes.y);
-    	iotcl_telemetry_set_number(msg, "acc_z", (double)p->xAcceleroAxes.z);
+    	LogDebug("Serialized %u samples into %u bytes in %lu cycles.", (unsigned int)uxSamplesWritten,
+    			(unsigned int)uxLen, (unsigned long)ulCycles);
 
-    	iotcl_telemetry_set_number(msg, "gyro_x", (double)p->xGyroAxes.x);
-		iotcl_telemetry_set_number(msg, "gyro_y", (double)p->xGyroAxes.y);
-		iotcl_telemetry_set_number(msg, "gyro_z", (double)p->xGyroAxes.z);
+    	if (!iotcApp_publish_telemetry(pcTelemetryPayload, uxLen)) {
+    		break;
+    	}
 
-		iotcl_telemetry_set_number(msg, "mgnt_x", (double)p->xMagnetoAxes.x);
-		iotcl_telemetry_set_number(msg, "mgnt_y", (double)p->xMagnetoAxes.y);
-		iotcl_telemetry_set_number(msg, "mgnt_Z", (double)p->xMagnetoAxes.z);
+    	uxTotalBytes += uxLen;
+    	uxSamplesPublished += uxSamplesWritten;
     }
 
-    if (p->bEnvSensorDataValid) {
-		iotcl_telemetry_set_number(msg, "temp_0", (double)p->xEnvSensorData.fTemperature0);
-		iotcl_telemetry_set_number(msg, "temp_1", (double)p->xEnvSensorData.fTemperature1);
-		iotcl_telemetry_set_number(msg, "humidity", (double)p->xEnvSensorData.fHumidity);
-		iotcl_telemetry_set_number(msg, "pressure", (double)p->xEnvSensorData.fBarometricPressure);
+    if (puxBytesPublished != NULL) {
+    	*puxBytesPublished = uxTotalBytes;
     }
 
-    iotcl_mqtt_send_telemetry(msg, true);
-    iotcl_telemetry_destroy(msg);
+    return uxSamplesPublished;
 }
@@ -10,6 +10,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
 
 /* Sensor includes */
 #include "b_u585i_iot02a_motion_sensors.h"
@@ -23,13 +25,45 @@ typedef struct
     float_t fBarometricPressure;
 } EnvironmentalSensorData_t;
 
+/* Accelerometer / gyroscope statistics over one publish period. The means are reported in xAcceleroAxes and xGyroAxes. */
+typedef struct
+{
+    BSP_MOTION_SENSOR_Axes_t xAcceleroMin;
+    BSP_MOTION_SENSOR_Axes_t xAcceleroMax;
+    float_t pfAcceleroRms[ 3 ];
+    float_t pfGyroRms[ 3 ];
+} MotionSensorStats_t;
+
 typedef struct IOTC_U5IOT_TELEMETRY {
     BSP_MOTION_SENSOR_Axes_t xAcceleroAxes, xGyroAxes, xMagnetoAxes;
     EnvironmentalSensorData_t xEnvSensorData;
+    MotionSensorStats_t xMotionStats;
     bool bMotionSensorValid;
     bool bEnvSensorDataValid;
+    bool bMotionStatsValid;
 }iotcU5IotTelemetry_t;
 
+/* A telemetry sample and the wall clock time at which it was captured */
+typedef struct IOTC_U5IOT_TELEMETRY_SAMPLE {
+    iotcU5IotTelemetry_t xTelemetry;
+    time_t xTimestamp;
+    uint16_t usTimestampMs;
+}iotcU5IotTelemetrySample_t;
+
+/* @brief	Publish a single telemetry sample as one IoTConnect message */
+void iotcApp_create_and_send_telemetry_json(const void *pToTelemetryStruct, size_t siz);
 
+/* @brief	Publish samples as IoTConnect messages with one timestamped data point per sample
+ *
+ * A batch that does not fit in one message is split over several. Publishing
+ * stops at the first message that cannot be created or published, so the
+ * published samples are always the first ones of pxSamples.
+ *
+ * @param[out]	puxBytesPublished	Total length of the published messages, may be NULL
+ *
+ * @return	Number of samples published, counted from the start of pxSamples
+ */
+size_t iotcApp_create_and_send_telemetry_batch_json(const iotcU5IotTelemetrySample_t *pxSamples, size_t uxNumSamples,
+		size_t *puxBytesPublished);
 
 #endif /* APP_SENSOR_TELEMETRY_H_ */
@@ -70,6 +70,7 @@
 
 /* JSON library includes. */
 #include "core_json.h"
+#include "app/json_index.h"
 
 /* Shadow API header. */
 #include "shadow.h"
@@ -194,6 +195,13 @@ typedef struct MQTTAgentCommandContext
 
 extern MQTTAgentContext_t xGlobalMqttAgentContext;
 
+/**
+ * @brief Key path index of the last received shadow document.
+ *
+ * Shared by the incoming publish callbacks, which all run in the MQTT agent task.
+ */
+static JsonIndex_t xShadowJsonIndex;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -387,13 +395,39 @@ static bool prvSubscribeToShadowUpdateTopics( ShadowDeviceCtx_t * pxCtx )
 
 /*-----------------------------------------------------------*/
 
+/* Validate an incoming shadow document and index it into xShadowJsonIndex. */
+static JSONStatus_t prvIndexShadowDocument( const MQTTPublishInfo_t * pxPublishInfo )
+{
+    uint32_t ulStartCycles = ulGetCycleCount();
+    JSONStatus_t xResult = JsonIndex_Build( &xShadowJsonIndex,
+                                            ( const char * ) pxPublishInfo->pPayload,
+                                            pxPublishInfo->payloadLength );
+
+    LogDebug( "Indexed %lu byte shadow document in %lu cycles.",
+              ( unsigned long ) pxPublishInfo->payloadLength,
+              ( unsigned long ) ( ulGetCycleCount() - ulStartCycles ) );
+
+    if( ( xResult == JSONSuccess ) &&
+        ( xShadowJsonIndex.xIsComplete == false ) )
+    {
+        LogWarn( "Shadow document of %lu bytes exceeds the index, %lu of its values are indexed. "
+                 "Other searches rescan the document. Raise JSON_INDEX_MAX_ENTRIES or JSON_INDEX_MAX_DEPTH.",
+                 ( unsigned long ) pxPublishInfo->payloadLength,
+                 ( unsigned long ) xShadowJsonIndex.uxNumEntries );
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
 static void prvIncomingPublishUpdateDeltaCallback( void * pvCtx,
                                                    MQTTPublishInfo_t * pxPublishInfo )
 {
     static uint32_t ulCurrentVersion = 0; /* Remember the latest version number we've received */
     uint32_t ulVersion = 0UL;
     uint32_t ulNewState = 0UL;
-    char * pcOutValue = NULL;
+    const char * pcOutValue = NULL;
     uint32_t ulOutValueLength = 0UL;
     JSONStatus_t result = JSONSuccess;
 
@@ -423,8 +457,7 @@ static void prvIncomingPublishUpdateDeltaCallback( void * pvCtx,
      */
 
     /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pxPublishInfo->pPayload,
-                            pxPublishInfo->payloadLength );
+    result = prvIndexShadowDocument( pxPublishInfo );
 
     if( result != JSONSuccess )
     {
@@ -433,12 +466,12 @@ static void prvIncomingPublishUpdateDeltaCallback( void * pvCtx,
     else
     {
         /* Obtain the version value. */
-        result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                              pxPublishInfo->payloadLength,
-                              "version",
-                              sizeof( "version" ) - 1,
-                              &pcOutValue,
-                              ( size_t * ) &ulOutValueLength );
+        result = JsonIndex_Search( &xShadowJsonIndex,
+                                   "version",
+                                   sizeof( "version" ) - 1,
+                                   &pcOutValue,
+                                   ( size_t * ) &ulOutValueLength,
+                                   NULL );
 
         if( result != JSONSuccess )
         {
@@ -471,12 +504,12 @@ static void prvIncomingPublishUpdateDeltaCallback( void * pvCtx,
                 ulCurrentVersion = ulVersion;
 
                 /* Get powerOn state from json documents. */
-                result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                                      pxPublishInfo->payloadLength,
-                                      "state.powerOn",
-                                      sizeof( "state.powerOn" ) - 1,
-                                      &pcOutValue,
-                                      ( size_t * ) &ulOutValueLength );
+                result = JsonIndex_Search( &xShadowJsonIndex,
+                                           "state.powerOn",
+                                           sizeof( "state.powerOn" ) - 1,
+                                           &pcOutValue,
+                                           ( size_t * ) &ulOutValueLength,
+                                           NULL );
 
                 if( result != JSONSuccess )
                 {
@@ -510,7 +543,7 @@ static void prvIncomingPublishUpdateDeltaCallback( void * pvCtx,
 static void prvIncomingPublishUpdateAcceptedCallback( void * pvCtx,
                                                       MQTTPublishInfo_t * pxPublishInfo )
 {
-    char * pcOutValue = NULL;
+    const char * pcOutValue = NULL;
     uint32_t ulOutValueLength = 0UL;
     uint32_t ulReceivedToken = 0UL;
     JSONStatus_t result = JSONSuccess;
@@ -549,8 +582,7 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pvCtx,
      */
 
     /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pxPublishInfo->pPayload,
-                            pxPublishInfo->payloadLength );
+    result = prvIndexShadowDocument( pxPublishInfo );
 
     if( result != JSONSuccess )
     {
@@ -559,12 +591,12 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pvCtx,
     else
     {
         /* Get clientToken from json documents. */
-        result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                              pxPublishInfo->payloadLength,
-                              "clientToken",
-                              sizeof( "clientToken" ) - 1,
-                              &pcOutValue,
-                              ( size_t * ) &ulOutValueLength );
+        result = JsonIndex_Search( &xShadowJsonIndex,
+                                   "clientToken",
+                                   sizeof( "clientToken" ) - 1,
+                                   &pcOutValue,
+                                   ( size_t * ) &ulOutValueLength,
+                                   NULL );
     }
 
     if( result != JSONSuccess )
@@ -590,12 +622,12 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pvCtx,
             LogInfo( "Received accepted response for update with token %lu. ", ( unsigned long ) pxCtx->ulClientToken );
 
             /*  Obtain the accepted state from the response and update our last sent state. */
-            result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                                  pxPublishInfo->payloadLength,
-                                  "state.reported.powerOn",
-                                  sizeof( "state.reported.powerOn" ) - 1,
-                                  &pcOutValue,
-                                  ( size_t * ) &ulOutValueLength );
+            result = JsonIndex_Search( &xShadowJsonIndex,
+                                       "state.reported.powerOn",
+                                       sizeof( "state.reported.powerOn" ) - 1,
+                                       &pcOutValue,
+                                       ( size_t * ) &ulOutValueLength,
+                                       NULL );
 
             if( result != JSONSuccess )
             {
@@ -620,7 +652,7 @@ static void prvIncomingPublishUpdateRejectedCallback( void * pvCtx,
                                                       MQTTPublishInfo_t * pxPublishInfo )
 {
     JSONStatus_t result = JSONSuccess;
-    char * pcOutValue = NULL;
+    const char * pcOutValue = NULL;
     uint32_t ulOutValueLength = 0UL;
     uint32_t ulReceivedToken = 0UL;
 
@@ -644,8 +676,7 @@ static void prvIncomingPublishUpdateRejectedCallback( void * pvCtx,
      */
 
     /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pxPublishInfo->pPayload,
-                            pxPublishInfo->payloadLength );
+    result = prvIndexShadowDocument( pxPublishInfo );
 
     if( result != JSONSuccess )
     {
@@ -654,12 +685,12 @@ static void prvIncomingPublishUpdateRejectedCallback( void * pvCtx,
     else
     {
         /* Get clientToken from json documents. */
-        result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                              pxPublishInfo->payloadLength,
-                              "clientToken",
-                              sizeof( "clientToken" ) - 1,
-                              &pcOutValue,
-                              ( size_t * ) &ulOutValueLength );
+        result = JsonIndex_Search( &xShadowJsonIndex,
+                                   "clientToken",
+                                   sizeof( "clientToken" ) - 1,
+                                   &pcOutValue,
+                                   ( size_t * ) &ulOutValueLength,
+                                   NULL );
     }
 
     if( result != JSONSuccess )
@@ -683,12 +714,12 @@ static void prvIncomingPublishUpdateRejectedCallback( void * pvCtx,
         else
         {
             /*  Obtain the error code. */
-            result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                                  pxPublishInfo->payloadLength,
-                                  "code",
-                                  sizeof( "code" ) - 1,
-                                  &pcOutValue,
-                                  ( size_t * ) &ulOutValueLength );
+            result = JsonIndex_Search( &xShadowJsonIndex,
+                                       "code",
+                                       sizeof( "code" ) - 1,
+                                       &pcOutValue,
+                                       ( size_t * ) &ulOutValueLength,
+                                       NULL );
 
             if( result != JSONSuccess )
             {
@@ -0,0 +1,322 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file telemetry_batch.c
+ * @brief Collects sensor samples from the publisher tasks and sends them to
+ * IoTConnect in batches, one timestamped data point per sample.
+ */
+
+#include "logging_levels.h"
+/* define LOG_LEVEL here if you want to modify the logging level from the default */
+
+#define LOG_LEVEL    LOG_INFO
+
+#include "logging.h"
+
+/* Standard includes. */
+#include <string.h>
+#include <time.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "mqtt_agent_task.h"
+
+#include "app/telemetry_batch.h"
+
+#if ( TELEMETRY_BATCH_RING_LEN < TELEMETRY_BATCH_SIZE )
+#error "TELEMETRY_BATCH_RING_LEN must be at least TELEMETRY_BATCH_SIZE"
+#endif
+
+typedef struct
+{
+    iotcU5IotTelemetry_t xTelemetry;
+    TickType_t xCaptureTick;
+} TelemetryRingEntry_t;
+
+/*
+ * Ring of pending samples. Protected by a mutex rather than a critical section,
+ * as a batch of entries is about 2 KB to copy and both sides are tasks.
+ */
+static TelemetryRingEntry_t xRing[ TELEMETRY_BATCH_RING_LEN ];
+static size_t uxRingTail = 0;
+static size_t uxRingCount = 0;
+
+static StaticSemaphore_t xRingMutexStatic;
+static SemaphoreHandle_t xRingMutex = NULL;
+
+static TaskHandle_t xBatchTaskHandle = NULL;
+
+static uint32_t ulSamplesDropped = 0;
+static uint32_t ulPublishCount = 0;
+static uint32_t ulSamplesPublished = 0;
+static uint64_t ullBytesPublished = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvRingLock( void )
+{
+    taskENTER_CRITICAL();
+
+    if( xRingMutex == NULL )
+    {
+        xRingMutex = xSemaphoreCreateMutexStatic( &xRingMutexStatic );
+    }
+
+    taskEXIT_CRITICAL();
+
+    ( void ) xSemaphoreTake( xRingMutex, portMAX_DELAY );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvRingUnlock( void )
+{
+    ( void ) xSemaphoreGive( xRingMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xTelemetryBatchSubmit( const iotcU5IotTelemetry_t * pxTelemetry )
+{
+    BaseType_t xResult = pdTRUE;
+    size_t uxCount;
+
+    configASSERT( pxTelemetry != NULL );
+
+    prvRingLock();
+    {
+        if( uxRingCount == TELEMETRY_BATCH_RING_LEN )
+        {
+            uxRingTail = ( uxRingTail + 1 ) % TELEMETRY_BATCH_RING_LEN;
+            uxRingCount--;
+            ulSamplesDropped++;
+            xResult = pdFALSE;
+        }
+
+        TelemetryRingEntry_t * pxEntry = &( xRing[ ( uxRingTail + uxRingCount ) % TELEMETRY_BATCH_RING_LEN ] );
+
+        ( void ) memcpy( &( pxEntry->xTelemetry ), pxTelemetry, sizeof( iotcU5IotTelemetry_t ) );
+        pxEntry->xCaptureTick = xTaskGetTickCount();
+
+        uxRingCount++;
+        uxCount = uxRingCount;
+    }
+    prvRingUnlock();
+
+    if( ( uxCount >= TELEMETRY_BATCH_SIZE ) && ( xBatchTaskHandle != NULL ) )
+    {
+        ( void ) xTaskNotifyGive( xBatchTaskHandle );
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Ticks until the oldest queued sample reaches TELEMETRY_BATCH_MAX_AGE_MS */
+static TickType_t prvTicksUntilDeadline( void )
+{
+    TickType_t xWait = pdMS_TO_TICKS( TELEMETRY_BATCH_MAX_AGE_MS );
+
+    prvRingLock();
+    {
+        if( uxRingCount >= TELEMETRY_BATCH_SIZE )
+        {
+            xWait = 0;
+        }
+        else if( uxRingCount > 0 )
+        {
+            TickType_t xAge = xTaskGetTickCount() - xRing[ uxRingTail ].xCaptureTick;
+
+            xWait = ( xAge >= xWait ) ? 0 : ( xWait - xAge );
+        }
+    }
+    prvRingUnlock();
+
+    return xWait;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Remove up to TELEMETRY_BATCH_SIZE samples from the ring if a batch is due and
+ * convert their capture ticks to wall clock time.
+ */
+static size_t prvTakeBatch( iotcU5IotTelemetrySample_t * pxSamples,
+                            TickType_t * pxCaptureTicks )
+{
+    size_t uxNumSamples = 0;
+    TickType_t xNowTick;
+    time_t xNow;
+
+    prvRingLock();
+    {
+        xNowTick = xTaskGetTickCount();
+
+        if( ( uxRingCount >= TELEMETRY_BATCH_SIZE ) ||
+            ( ( uxRingCount > 0 ) &&
+              ( ( xNowTick - xRing[ uxRingTail ].xCaptureTick ) >= pdMS_TO_TICKS( TELEMETRY_BATCH_MAX_AGE_MS ) ) ) )
+        {
+            uxNumSamples = ( uxRingCount < TELEMETRY_BATCH_SIZE ) ? uxRingCount : TELEMETRY_BATCH_SIZE;
+
+            for( size_t i = 0; i < uxNumSamples; i++ )
+            {
+                const TelemetryRingEntry_t * pxEntry = &( xRing[ ( uxRingTail + i ) % TELEMETRY_BATCH_RING_LEN ] );
+
+                ( void ) memcpy( &( pxSamples[ i ].xTelemetry ), &( pxEntry->xTelemetry ), sizeof( iotcU5IotTelemetry_t ) );
+                pxCaptureTicks[ i ] = pxEntry->xCaptureTick;
+            }
+
+            uxRingTail = ( uxRingTail + uxNumSamples ) % TELEMETRY_BATCH_RING_LEN;
+            uxRingCount -= uxNumSamples;
+        }
+    }
+    prvRingUnlock();
+
+    xNow = time( NULL );
+
+    for( size_t i = 0; i < uxNumSamples; i++ )
+    {
+        uint64_t ullAgeMs = ( ( uint64_t ) ( xNowTick - pxCaptureTicks[ i ] ) * 1000ULL ) / configTICK_RATE_HZ;
+        uint64_t ullCaptureMs = ( ( uint64_t ) xNow * 1000ULL ) - ullAgeMs;
+
+        pxSamples[ i ].xTimestamp = ( time_t ) ( ullCaptureMs / 1000ULL );
+        pxSamples[ i ].usTimestampMs = ( uint16_t ) ( ullCaptureMs % 1000ULL );
+    }
+
+    return uxNumSamples;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Put samples that failed to publish back at the head of the ring, ahead of
+ * the samples queued since. If the ring has filled up in the meantime, the
+ * oldest of them are dropped as if they had been queued.
+ */
+static void prvRequeueBatch( const iotcU5IotTelemetrySample_t * pxSamples,
+                             const TickType_t * pxCaptureTicks,
+                             size_t uxNumSamples )
+{
+    size_t uxKeep;
+
+    prvRingLock();
+    {
+        uxKeep = TELEMETRY_BATCH_RING_LEN - uxRingCount;
+        uxKeep = ( uxNumSamples < uxKeep ) ? uxNumSamples : uxKeep;
+
+        for( size_t i = uxNumSamples; i > ( uxNumSamples - uxKeep ); i-- )
+        {
+            TelemetryRingEntry_t * pxEntry;
+
+            uxRingTail = ( uxRingTail + TELEMETRY_BATCH_RING_LEN - 1 ) % TELEMETRY_BATCH_RING_LEN;
+            pxEntry = &( xRing[ uxRingTail ] );
+
+            ( void ) memcpy( &( pxEntry->xTelemetry ), &( pxSamples[ i - 1 ].xTelemetry ), sizeof( iotcU5IotTelemetry_t ) );
+            pxEntry->xCaptureTick = pxCaptureTicks[ i - 1 ];
+        }
+
+        uxRingCount += uxKeep;
+        ulSamplesDropped += ( uint32_t ) ( uxNumSamples - uxKeep );
+    }
+    prvRingUnlock();
+}
+
+/*-----------------------------------------------------------*/
+
+void vTelemetryBatchTask( void * pvParameters )
+{
+    static iotcU5IotTelemetrySample_t xSamples[ TELEMETRY_BATCH_SIZE ];
+    static TickType_t xCaptureTicks[ TELEMETRY_BATCH_SIZE ];
+    TickType_t xStartTick;
+
+    ( void ) pvParameters;
+
+    xBatchTaskHandle = xTaskGetCurrentTaskHandle();
+
+    vSleepUntilMQTTAgentReady();
+
+    xStartTick = xTaskGetTickCount();
+
+    for( ; ; )
+    {
+        size_t uxNumSamples;
+
+        ( void ) ulTaskNotifyTake( pdTRUE, prvTicksUntilDeadline() );
+
+        /* Keep buffering while offline, the ring drops the oldest samples once full */
+        if( xIsMqttAgentConnected() == false )
+        {
+            vSleepUntilMQTTAgentConnected();
+        }
+
+        uxNumSamples = prvTakeBatch( xSamples, xCaptureTicks );
+
+        if( uxNumSamples > 0 )
+        {
+            size_t uxBytes = 0;
+            size_t uxPublished = iotcApp_create_and_send_telemetry_batch_json( xSamples, uxNumSamples, &uxBytes );
+            TickType_t xElapsed = xTaskGetTickCount() - xStartTick;
+            uint32_t ulMilliPublishesPerSec = 0;
+
+            if( uxPublished > 0 )
+            {
+                ulPublishCount++;
+                ulSamplesPublished += uxPublished;
+                ullBytesPublished += uxBytes;
+
+                if( xElapsed > 0 )
+                {
+                    ulMilliPublishesPerSec = ( uint32_t ) ( ( ( uint64_t ) ulPublishCount * 1000ULL * configTICK_RATE_HZ ) / xElapsed );
+                }
+
+                LogInfo( "Published %u samples in %u bytes (%u bytes/sample). Total: %lu publishes, %lu samples, %lu bytes/sample, %lu.%03lu publishes/s, %lu dropped.",
+                         ( unsigned int ) uxPublished,
+                         ( unsigned int ) uxBytes,
+                         ( unsigned int ) ( uxBytes / uxPublished ),
+                         ( unsigned long ) ulPublishCount,
+                         ( unsigned long ) ulSamplesPublished,
+                         ( unsigned long ) ( ullBytesPublished / ulSamplesPublished ),
+                         ( unsigned long ) ( ulMilliPublishesPerSec / 1000UL ),
+                         ( unsigned long ) ( ulMilliPublishesPerSec % 1000UL ),
+                         ( unsigned long ) ulSamplesDropped );
+            }
+
+            if( uxPublished < uxNumSamples )
+            {
+                LogWarn( "Failed to publish %u of %u samples, retrying in %u ms.",
+                         ( unsigned int ) ( uxNumSamples - uxPublished ),
+                         ( unsigned int ) uxNumSamples,
+                         ( unsigned int ) TELEMETRY_BATCH_RETRY_MS );
+
+                prvRequeueBatch( &( xSamples[ uxPublished ] ), &( xCaptureTicks[ uxPublished ] ),
+                                 uxNumSamples - uxPublished );
+
+                vTaskDelay( pdMS_TO_TICKS( TELEMETRY_BATCH_RETRY_MS ) );
+            }
+        }
+    }
+}
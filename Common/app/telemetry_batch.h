@@ -0,0 +1,65 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef APP_TELEMETRY_BATCH_H_
+#define APP_TELEMETRY_BATCH_H_
+
+#include "FreeRTOS.h"
+
+#include "app/sensor_telemetry.h"
+
+/* Number of samples published together in one telemetry message */
+#ifndef TELEMETRY_BATCH_SIZE
+#define TELEMETRY_BATCH_SIZE           ( 20 )
+#endif
+
+/* Maximum time a sample waits before a partial batch is published */
+#ifndef TELEMETRY_BATCH_MAX_AGE_MS
+#define TELEMETRY_BATCH_MAX_AGE_MS     ( 10000 )
+#endif
+
+/* Delay before samples that failed to publish are sent again */
+#ifndef TELEMETRY_BATCH_RETRY_MS
+#define TELEMETRY_BATCH_RETRY_MS       ( 1000 )
+#endif
+
+/* Samples buffered while a batch is being published or while disconnected. The oldest sample is dropped when full. */
+#ifndef TELEMETRY_BATCH_RING_LEN
+#define TELEMETRY_BATCH_RING_LEN       ( 2 * TELEMETRY_BATCH_SIZE )
+#endif
+
+/**
+ * @brief Queue a sensor sample for the next batched telemetry message.
+ *
+ * Safe to call from any task. The sample is timestamped on entry.
+ *
+ * @return pdTRUE if the sample was queued without dropping an older one.
+ */
+BaseType_t xTelemetryBatchSubmit( const iotcU5IotTelemetry_t * pxTelemetry );
+
+/**
+ * @brief Task that publishes queued samples once TELEMETRY_BATCH_SIZE samples
+ * are available or the oldest sample is TELEMETRY_BATCH_MAX_AGE_MS old.
+ */
+void vTelemetryBatchTask( void * pvParameters );
+
+#endif /* APP_TELEMETRY_BATCH_H_ */
@@ -0,0 +1,104 @@
+/*
+ * Generated by tools/telemetry_schema_gen.py from IoTConnect/templates/device-template.json.
+ * Do not edit, run the script again after changing the device template or the bindings in the script.
+ */
+
+#ifndef APP_TELEMETRY_SCHEMA_H_
+#define APP_TELEMETRY_SCHEMA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app/sensor_telemetry.h"
+
+typedef enum
+{
+    TELEMETRY_TYPE_INTEGER = 0,
+    TELEMETRY_TYPE_DECIMAL
+} TelemetryFieldType_t;
+
+/* Validity flag of iotcU5IotTelemetry_t that covers a value */
+typedef enum
+{
+    TELEMETRY_SOURCE_NONE = 0,
+    TELEMETRY_SOURCE_MOTION,
+    TELEMETRY_SOURCE_ENV,
+    TELEMETRY_SOURCE_MOTION_STATS
+} TelemetryFieldSource_t;
+
+typedef enum
+{
+    TELEMETRY_STORAGE_INT32 = 0,
+    TELEMETRY_STORAGE_FLOAT
+} TelemetryFieldStorage_t;
+
+typedef enum
+{
+    TELEMETRY_FIELD_ACC_X,
+    TELEMETRY_FIELD_ACC_Y,
+    TELEMETRY_FIELD_ACC_Z,
+    TELEMETRY_FIELD_MGNT_X,
+    TELEMETRY_FIELD_MGNT_Y,
+    TELEMETRY_FIELD_MGNT_Z,
+    TELEMETRY_FIELD_GYRO_X,
+    TELEMETRY_FIELD_GYRO_Y,
+    TELEMETRY_FIELD_GYRO_Z,
+    TELEMETRY_FIELD_TEMP_1,
+    TELEMETRY_FIELD_TEMP_0,
+    TELEMETRY_FIELD_HUMIDITY,
+    TELEMETRY_FIELD_PRESSURE,
+    TELEMETRY_FIELD_ACC_MIN_X,
+    TELEMETRY_FIELD_ACC_MIN_Y,
+    TELEMETRY_FIELD_ACC_MIN_Z,
+    TELEMETRY_FIELD_ACC_MAX_X,
+    TELEMETRY_FIELD_ACC_MAX_Y,
+    TELEMETRY_FIELD_ACC_MAX_Z,
+    TELEMETRY_FIELD_ACC_RMS_X,
+    TELEMETRY_FIELD_ACC_RMS_Y,
+    TELEMETRY_FIELD_ACC_RMS_Z,
+    TELEMETRY_FIELD_GYRO_RMS_X,
+    TELEMETRY_FIELD_GYRO_RMS_Y,
+    TELEMETRY_FIELD_GYRO_RMS_Z,
+    TELEMETRY_FIELD_COUNT
+} TelemetryFieldId_t;
+
+typedef struct
+{
+    const char * pcKey;    /*!< Key including quotes and the trailing ':' */
+    uint8_t ucKeyLength;
+    uint8_t ucType;        /*!< TelemetryFieldType_t */
+    uint8_t ucSource;      /*!< TelemetryFieldSource_t, TELEMETRY_SOURCE_NONE if the attribute is not sent */
+    uint8_t ucStorage;     /*!< TelemetryFieldStorage_t */
+    uint16_t usOffset;     /*!< Offset of the value in iotcU5IotTelemetry_t */
+} TelemetrySchemaField_t;
+
+static const TelemetrySchemaField_t xTelemetrySchema[ TELEMETRY_FIELD_COUNT ] =
+{
+    [ TELEMETRY_FIELD_ACC_X ] = { "\"acc_x\":", 8, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xAcceleroAxes.x ) },
+    [ TELEMETRY_FIELD_ACC_Y ] = { "\"acc_y\":", 8, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xAcceleroAxes.y ) },
+    [ TELEMETRY_FIELD_ACC_Z ] = { "\"acc_z\":", 8, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xAcceleroAxes.z ) },
+    [ TELEMETRY_FIELD_MGNT_X ] = { "\"mgnt_x\":", 9, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xMagnetoAxes.x ) },
+    [ TELEMETRY_FIELD_MGNT_Y ] = { "\"mgnt_y\":", 9, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xMagnetoAxes.y ) },
+    [ TELEMETRY_FIELD_MGNT_Z ] = { "\"mgnt_Z\":", 9, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xMagnetoAxes.z ) },
+    [ TELEMETRY_FIELD_GYRO_X ] = { "\"gyro_x\":", 9, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xGyroAxes.x ) },
+    [ TELEMETRY_FIELD_GYRO_Y ] = { "\"gyro_y\":", 9, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xGyroAxes.y ) },
+    [ TELEMETRY_FIELD_GYRO_Z ] = { "\"gyro_z\":", 9, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xGyroAxes.z ) },
+    [ TELEMETRY_FIELD_TEMP_1 ] = { "\"temp_1\":", 9, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_ENV, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xEnvSensorData.fTemperature1 ) },
+    [ TELEMETRY_FIELD_TEMP_0 ] = { "\"temp_0\":", 9, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_ENV, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xEnvSensorData.fTemperature0 ) },
+    [ TELEMETRY_FIELD_HUMIDITY ] = { "\"humidity\":", 11, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_ENV, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xEnvSensorData.fHumidity ) },
+    [ TELEMETRY_FIELD_PRESSURE ] = { "\"pressure\":", 11, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_ENV, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xEnvSensorData.fBarometricPressure ) },
+    [ TELEMETRY_FIELD_ACC_MIN_X ] = { "\"acc_min_x\":", 12, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xMotionStats.xAcceleroMin.x ) },
+    [ TELEMETRY_FIELD_ACC_MIN_Y ] = { "\"acc_min_y\":", 12, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xMotionStats.xAcceleroMin.y ) },
+    [ TELEMETRY_FIELD_ACC_MIN_Z ] = { "\"acc_min_z\":", 12, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xMotionStats.xAcceleroMin.z ) },
+    [ TELEMETRY_FIELD_ACC_MAX_X ] = { "\"acc_max_x\":", 12, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xMotionStats.xAcceleroMax.x ) },
+    [ TELEMETRY_FIELD_ACC_MAX_Y ] = { "\"acc_max_y\":", 12, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xMotionStats.xAcceleroMax.y ) },
+    [ TELEMETRY_FIELD_ACC_MAX_Z ] = { "\"acc_max_z\":", 12, TELEMETRY_TYPE_INTEGER, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_INT32, offsetof( iotcU5IotTelemetry_t, xMotionStats.xAcceleroMax.z ) },
+    [ TELEMETRY_FIELD_ACC_RMS_X ] = { "\"acc_rms_x\":", 12, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xMotionStats.pfAcceleroRms[ 0 ] ) },
+    [ TELEMETRY_FIELD_ACC_RMS_Y ] = { "\"acc_rms_y\":", 12, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xMotionStats.pfAcceleroRms[ 1 ] ) },
+    [ TELEMETRY_FIELD_ACC_RMS_Z ] = { "\"acc_rms_z\":", 12, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xMotionStats.pfAcceleroRms[ 2 ] ) },
+    [ TELEMETRY_FIELD_GYRO_RMS_X ] = { "\"gyro_rms_x\":", 13, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xMotionStats.pfGyroRms[ 0 ] ) },
+    [ TELEMETRY_FIELD_GYRO_RMS_Y ] = { "\"gyro_rms_y\":", 13, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xMotionStats.pfGyroRms[ 1 ] ) },
+    [ TELEMETRY_FIELD_GYRO_RMS_Z ] = { "\"gyro_rms_z\":", 13, TELEMETRY_TYPE_DECIMAL, TELEMETRY_SOURCE_MOTION_STATS, TELEMETRY_STORAGE_FLOAT, offsetof( iotcU5IotTelemetry_t, xMotionStats.pfGyroRms[ 2 ] ) },
+};
+
+#endif /* APP_TELEMETRY_SCHEMA_H_ */
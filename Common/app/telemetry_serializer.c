@@ -0,0 +1,326 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file telemetry_serializer.c
+ * @brief Direct to buffer telemetry serializer driven by the generated schema table.
+ */
+
+#include <string.h>
+#include <stdbool.h>
+
+#include "app/telemetry_serializer.h"
+#include "app/telemetry_schema.h"
+
+/* Largest value that is formatted as a number, larger values and NaN are written as null */
+#define TELEMETRY_NUMBER_LIMIT    ( 1.0e15 )
+
+/* Number of fractional digits written for DECIMAL attributes */
+#define TELEMETRY_DECIMAL_SCALE   ( 100 )
+
+#define MESSAGE_PREFIX            "{\"d\":["
+#define MESSAGE_SUFFIX            "]}"
+#define DATA_POINT_PREFIX         "{\"dt\":\""
+#define DATA_POINT_SEPARATOR      "\",\"d\":{"
+#define DATA_POINT_SUFFIX         "}}"
+
+typedef struct
+{
+    char * pcBuf;
+    size_t uxLen;
+    size_t uxPos;
+    bool xOverflow;
+} TelemetryWriter_t;
+
+/*-----------------------------------------------------------*/
+
+static inline void prvAppend( TelemetryWriter_t * pxWriter,
+                              const char * pcData,
+                              size_t uxDataLen )
+{
+    if( ( pxWriter->xOverflow == false ) &&
+        ( ( pxWriter->uxLen - pxWriter->uxPos ) >= uxDataLen ) )
+    {
+        ( void ) memcpy( &( pxWriter->pcBuf[ pxWriter->uxPos ] ), pcData, uxDataLen );
+        pxWriter->uxPos += uxDataLen;
+    }
+    else
+    {
+        pxWriter->xOverflow = true;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+#define prvAppendLiteral( pxWriter, pcLiteral )    prvAppend( ( pxWriter ), ( pcLiteral ), sizeof( pcLiteral ) - 1 )
+
+/*-----------------------------------------------------------*/
+
+/* Append ullValue in decimal, zero padded to at least uxMinDigits digits. */
+static void prvAppendUnsigned( TelemetryWriter_t * pxWriter,
+                               uint64_t ullValue,
+                               size_t uxMinDigits )
+{
+    char pcDigits[ 20 ];
+    size_t uxNumDigits = 0;
+
+    do
+    {
+        pcDigits[ sizeof( pcDigits ) - 1 - uxNumDigits ] = ( char ) ( '0' + ( ullValue % 10U ) );
+        ullValue /= 10U;
+        uxNumDigits++;
+    } while( ( ullValue > 0 ) || ( uxNumDigits < uxMinDigits ) );
+
+    prvAppend( pxWriter, &( pcDigits[ sizeof( pcDigits ) - uxNumDigits ] ), uxNumDigits );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvAppendSigned( TelemetryWriter_t * pxWriter,
+                             int64_t llValue )
+{
+    if( llValue < 0 )
+    {
+        prvAppendLiteral( pxWriter, "-" );
+        prvAppendUnsigned( pxWriter, ( uint64_t ) ( -( llValue + 1 ) ) + 1U, 1 );
+    }
+    else
+    {
+        prvAppendUnsigned( pxWriter, ( uint64_t ) llValue, 1 );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Append a float rounded to an integer or to TELEMETRY_DECIMAL_SCALE fractional digits, without printf. */
+static void prvAppendFloat( TelemetryWriter_t * pxWriter,
+                            float fValue,
+                            bool xDecimal )
+{
+    if( ( fValue != fValue ) ||
+        ( fValue > TELEMETRY_NUMBER_LIMIT ) ||
+        ( fValue < -TELEMETRY_NUMBER_LIMIT ) )
+    {
+        prvAppendLiteral( pxWriter, "null" );
+    }
+    else
+    {
+        double dScaled = ( double ) fValue * ( xDecimal ? TELEMETRY_DECIMAL_SCALE : 1 );
+        int64_t llScaled = ( int64_t ) ( dScaled + ( ( dScaled < 0.0 ) ? -0.5 : 0.5 ) );
+
+        if( xDecimal )
+        {
+            uint64_t ullMagnitude = ( llScaled < 0 ) ? ( uint64_t ) -llScaled : ( uint64_t ) llScaled;
+
+            if( llScaled < 0 )
+            {
+                prvAppendLiteral( pxWriter, "-" );
+            }
+
+            prvAppendUnsigned( pxWriter, ullMagnitude / TELEMETRY_DECIMAL_SCALE, 1 );
+            prvAppendLiteral( pxWriter, "." );
+            prvAppendUnsigned( pxWriter, ullMagnitude % TELEMETRY_DECIMAL_SCALE, 2 );
+        }
+        else
+        {
+            prvAppendSigned( pxWriter, llScaled );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Append a time as "YYYY-MM-DDThh:mm:ss.sssZ" using the days to civil date algorithm, avoiding gmtime and strftime. */
+static void prvAppendIsoTime( TelemetryWriter_t * pxWriter,
+                              time_t xTimestamp,
+                              uint16_t usMs )
+{
+    int64_t llSeconds = ( int64_t ) xTimestamp;
+    int64_t llDays = llSeconds / 86400;
+    int64_t llSecOfDay = llSeconds % 86400;
+    int64_t llEra;
+    int64_t llDayOfEra;
+    int64_t llYearOfEra;
+    int64_t llDayOfYear;
+    int64_t llMonthIndex;
+    int64_t llYear;
+    uint32_t ulMonth;
+    uint32_t ulDay;
+
+    if( llSecOfDay < 0 )
+    {
+        llSecOfDay += 86400;
+        llDays--;
+    }
+
+    llDays += 719468;
+    llEra = ( ( llDays >= 0 ) ? llDays : ( llDays - 146096 ) ) / 146097;
+    llDayOfEra = llDays - ( llEra * 146097 );
+    llYearOfEra = ( llDayOfEra - ( llDayOfEra / 1460 ) + ( llDayOfEra / 36524 ) - ( llDayOfEra / 146096 ) ) / 365;
+    llDayOfYear = llDayOfEra - ( ( 365 * llYearOfEra ) + ( llYearOfEra / 4 ) - ( llYearOfEra / 100 ) );
+    llMonthIndex = ( ( 5 * llDayOfYear ) + 2 ) / 153;
+    ulDay = ( uint32_t ) ( llDayOfYear - ( ( ( 153 * llMonthIndex ) + 2 ) / 5 ) + 1 );
+    ulMonth = ( uint32_t ) ( ( llMonthIndex < 10 ) ? ( llMonthIndex + 3 ) : ( llMonthIndex - 9 ) );
+    llYear = llYearOfEra + ( llEra * 400 ) + ( ( ulMonth <= 2 ) ? 1 : 0 );
+
+    if( llYear < 0 )
+    {
+        llYear = 0;
+    }
+
+    prvAppendUnsigned( pxWriter, ( uint64_t ) llYear, 4 );
+    prvAppendLiteral( pxWriter, "-" );
+    prvAppendUnsigned( pxWriter, ulMonth, 2 );
+    prvAppendLiteral( pxWriter, "-" );
+    prvAppendUnsigned( pxWriter, ulDay, 2 );
+    prvAppendLiteral( pxWriter, "T" );
+    prvAppendUnsigned( pxWriter, ( uint64_t ) ( llSecOfDay / 3600 ), 2 );
+    prvAppendLiteral( pxWriter, ":" );
+    prvAppendUnsigned( pxWriter, ( uint64_t ) ( ( llSecOfDay / 60 ) % 60 ), 2 );
+    prvAppendLiteral( pxWriter, ":" );
+    prvAppendUnsigned( pxWriter, ( uint64_t ) ( llSecOfDay % 60 ), 2 );
+    prvAppendLiteral( pxWriter, "." );
+    prvAppendUnsigned( pxWriter, usMs % 1000U, 3 );
+    prvAppendLiteral( pxWriter, "Z" );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvAppendDataPoint( TelemetryWriter_t * pxWriter,
+                                const iotcU5IotTelemetrySample_t * pxSample )
+{
+    const iotcU5IotTelemetry_t * pxTelemetry = &( pxSample->xTelemetry );
+    const uint8_t * pucBase = ( const uint8_t * ) pxTelemetry;
+    bool xFirst = true;
+
+    prvAppendLiteral( pxWriter, DATA_POINT_PREFIX );
+    prvAppendIsoTime( pxWriter, pxSample->xTimestamp, pxSample->usTimestampMs );
+    prvAppendLiteral( pxWriter, DATA_POINT_SEPARATOR );
+
+    for( size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++ )
+    {
+        const TelemetrySchemaField_t * pxField = &( xTelemetrySchema[ i ] );
+        bool xDecimal = ( pxField->ucType == TELEMETRY_TYPE_DECIMAL );
+
+        if( ( ( pxField->ucSource == TELEMETRY_SOURCE_MOTION ) && pxTelemetry->bMotionSensorValid ) ||
+            ( ( pxField->ucSource == TELEMETRY_SOURCE_ENV ) && pxTelemetry->bEnvSensorDataValid ) ||
+            ( ( pxField->ucSource == TELEMETRY_SOURCE_MOTION_STATS ) && pxTelemetry->bMotionStatsValid ) )
+        {
+            if( xFirst == false )
+            {
+                prvAppendLiteral( pxWriter, "," );
+            }
+
+            xFirst = false;
+
+            prvAppend( pxWriter, pxField->pcKey, pxField->ucKeyLength );
+
+            if( pxField->ucStorage == TELEMETRY_STORAGE_INT32 )
+            {
+                int32_t lValue;
+
+                ( void ) memcpy( &lValue, &( pucBase[ pxField->usOffset ] ), sizeof( lValue ) );
+
+                prvAppendSigned( pxWriter, lValue );
+
+                if( xDecimal )
+                {
+                    prvAppendLiteral( pxWriter, ".00" );
+                }
+            }
+            else
+            {
+                float fValue;
+
+                ( void ) memcpy( &fValue, &( pucBase[ pxField->usOffset ] ), sizeof( fValue ) );
+                prvAppendFloat( pxWriter, fValue, xDecimal );
+            }
+        }
+    }
+
+    prvAppendLiteral( pxWriter, DATA_POINT_SUFFIX );
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxTelemetrySerialize( const iotcU5IotTelemetrySample_t * pxSamples,
+                             size_t uxNumSamples,
+                             char * pcBuffer,
+                             size_t uxBufferLen,
+                             size_t * puxSamplesWritten )
+{
+    /* Reserve room for the NUL terminator */
+    size_t uxCapacity = ( uxBufferLen > 0 ) ? ( uxBufferLen - 1 ) : 0;
+    TelemetryWriter_t xWriter =
+    {
+        .pcBuf     = pcBuffer,
+        .uxLen     = 0,
+        .uxPos     = 0,
+        .xOverflow = false,
+    };
+    size_t uxWritten = 0;
+
+    if( ( pxSamples != NULL ) && ( pcBuffer != NULL ) && ( puxSamplesWritten != NULL ) )
+    {
+        /* Keep room for the closing brackets so the message can always be terminated */
+        xWriter.uxLen = ( uxCapacity > ( sizeof( MESSAGE_SUFFIX ) - 1 ) ) ? ( uxCapacity - ( sizeof( MESSAGE_SUFFIX ) - 1 ) ) : 0;
+
+        prvAppendLiteral( &xWriter, MESSAGE_PREFIX );
+
+        for( ; uxWritten < uxNumSamples; uxWritten++ )
+        {
+            size_t uxMark = xWriter.uxPos;
+
+            if( uxWritten > 0 )
+            {
+                prvAppendLiteral( &xWriter, "," );
+            }
+
+            prvAppendDataPoint( &xWriter, &( pxSamples[ uxWritten ] ) );
+
+            if( xWriter.xOverflow )
+            {
+                /* Drop the partial data point, it is sent in the next message */
+                xWriter.uxPos = uxMark;
+                break;
+            }
+        }
+
+        xWriter.uxLen = uxCapacity;
+        xWriter.xOverflow = false;
+        prvAppendLiteral( &xWriter, MESSAGE_SUFFIX );
+
+        if( uxWritten == 0 )
+        {
+            xWriter.uxPos = 0;
+        }
+
+        if( uxBufferLen > 0 )
+        {
+            pcBuffer[ xWriter.uxPos ] = '\0';
+        }
+
+        *puxSamplesWritten = uxWritten;
+    }
+
+    return xWriter.uxPos;
+}
@@ -0,0 +1,55 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef APP_TELEMETRY_SERIALIZER_H_
+#define APP_TELEMETRY_SERIALIZER_H_
+
+#include <stddef.h>
+
+#include "app/sensor_telemetry.h"
+
+/**
+ * @brief Serialize telemetry samples into an IoTConnect 2.1 telemetry message.
+ *
+ * Keys and types come from the table generated into app/telemetry_schema.h, so
+ * the message is written straight into pcBuffer without building a JSON tree
+ * and without using the heap. Each sample becomes one data point:
+ * {"d":[{"dt":"<ISO 8601 time>","d":{"acc_x":12,...}},...]}
+ *
+ * Samples that do not fit in the buffer are left for the next message.
+ *
+ * @param[in] pxSamples Samples to serialize.
+ * @param[in] uxNumSamples Number of samples in pxSamples.
+ * @param[out] pcBuffer Output buffer. The message is NUL terminated.
+ * @param[in] uxBufferLen Size of pcBuffer.
+ * @param[out] puxSamplesWritten Number of samples included in the message.
+ *
+ * @return Length of the message excluding the NUL terminator, or 0 if not even
+ * one sample fits in the buffer.
+ */
+size_t uxTelemetrySerialize( const iotcU5IotTelemetrySample_t * pxSamples,
+                             size_t uxNumSamples,
+                             char * pcBuffer,
+                             size_t uxBufferLen,
+                             size_t * puxSamplesWritten );
+
+#endif /* APP_TELEMETRY_SERIALIZER_H_ */
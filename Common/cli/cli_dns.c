@@ -0,0 +1,134 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2020-2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* FreeRTOS */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cli.h"
+#include "cli_prv.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "tls_transport_config.h"
+#include "dns_cache.h"
+
+static void prvDnsCommand( ConsoleIO_t * const pxCIO,
+                           uint32_t ulArgc,
+                           char * ppcArgv[] );
+
+const CLI_Command_Definition_t xCommandDef_dns =
+{
+    "dns",
+    "dns\r\n"
+    "    dns [stats]\r\n"
+    "        Display the resolver cache counters and entries.\r\n\n"
+    "    dns flush\r\n"
+    "        Drop all resolver cache entries.\r\n\n",
+    prvDnsCommand
+};
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintScratch( ConsoleIO_t * const pxCIO,
+                             int lLen )
+{
+    if( ( lLen > 0 ) &&
+        ( lLen < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+    {
+        pxCIO->write( pcCliScratchBuffer, ( size_t ) lLen );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvDnsStats( ConsoleIO_t * const pxCIO )
+{
+    DnsCacheStats_t xStats = { 0 };
+    DnsCacheInfo_t * pxInfo = NULL;
+    size_t uxNumEntries = 0;
+
+    vDnsCacheGetStats( &xStats );
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "hits: %lu, misses: %lu (expired: %lu), failures: %lu, "
+                                      "fallbacks: %lu, evictions: %lu\r\n",
+                                      ( unsigned long ) xStats.ulHits,
+                                      ( unsigned long ) xStats.ulMisses,
+                                      ( unsigned long ) xStats.ulExpired,
+                                      ( unsigned long ) xStats.ulFailures,
+                                      ( unsigned long ) xStats.ulFallbacks,
+                                      ( unsigned long ) xStats.ulEvictions ) );
+
+    pxInfo = pvPortMalloc( sizeof( DnsCacheInfo_t ) * DNS_CACHE_MAX_ENTRIES );
+
+    if( pxInfo == NULL )
+    {
+        pxCIO->print( "Error: Out of memory.\r\n" );
+    }
+    else
+    {
+        uxNumEntries = uxDnsCacheGetInfo( pxInfo, DNS_CACHE_MAX_ENTRIES );
+
+        for( size_t i = 0; i < uxNumEntries; i++ )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "%s ttl: %lu s\r\n", pxInfo[ i ].pcHostName,
+                                              ( unsigned long ) pxInfo[ i ].ulTtlRemainingS ) );
+
+            for( size_t j = 0; j < pxInfo[ i ].uxNumAddrs; j++ )
+            {
+                char pcAddr[ IP4ADDR_STRLEN_MAX ] = { 0 };
+
+                ( void ) inet_ntoa_r( pxInfo[ i ].xAddrs[ j ], pcAddr, IP4ADDR_STRLEN_MAX );
+
+                prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                                  "    %s\r\n", pcAddr ) );
+            }
+        }
+
+        vPortFree( pxInfo );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvDnsCommand( ConsoleIO_t * const pxCIO,
+                           uint32_t ulArgc,
+                           char * ppcArgv[] )
+{
+    if( ( ulArgc < 2 ) ||
+        ( strcmp( "stats", ppcArgv[ 1 ] ) == 0 ) )
+    {
+        prvDnsStats( pxCIO );
+    }
+    else if( strcmp( "flush", ppcArgv[ 1 ] ) == 0 )
+    {
+        vDnsCacheFlush();
+        pxCIO->print( "Resolver cache flushed.\r\n" );
+    }
+    else
+    {
+        pxCIO->print( xCommandDef_dns.pcHelpString );
+    }
+}
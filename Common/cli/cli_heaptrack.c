@@ -0,0 +1,384 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2020-2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* FreeRTOS */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cli.h"
+#include "cli_prv.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "heap_track.h"
+#include "heap_arena.h"
+#include "heap_pool.h"
+
+#define HEAPTRACK_DEFAULT_TRACE_EVENTS    ( 1024 )
+#define HEAPTRACK_MAX_ARENAS              ( 4 )
+
+static void prvHeapTrackCommand( ConsoleIO_t * const pxCIO,
+                                 uint32_t ulArgc,
+                                 char * ppcArgv[] );
+
+const CLI_Command_Definition_t xCommandDef_heaptrack =
+{
+    "heaptrack",
+    "heaptrack\r\n"
+    "    heaptrack [subsys]\r\n"
+    "        Display heap usage and peak per subsystem and fragmentation.\r\n\n"
+    "    heaptrack tasks\r\n"
+    "        Display heap usage and peak per task.\r\n\n"
+    "    heaptrack sites\r\n"
+    "        Display heap usage per allocation call site (return address).\r\n\n"
+    "    heaptrack arenas\r\n"
+    "        Display usage of the dedicated heap arenas.\r\n\n"
+    "    heaptrack pools\r\n"
+    "        Display usage of the mbedTLS size class pools.\r\n\n"
+    "    heaptrack peaks\r\n"
+    "        Reset all peak values to the current usage.\r\n\n"
+    "    heaptrack pools clear\r\n"
+    "        Reset the pool peak and exhausted counters.\r\n\n"
+    "    heaptrack trace start [events]\r\n"
+    "        Start recording allocations and frees, by default up to 1024 events.\r\n\n"
+    "    heaptrack trace stop | dump | clear\r\n"
+    "        Stop recording, print the recording in the format read by\r\n"
+    "        Projects/posix_host/Src/bench/heap_replay.c or free the recording.\r\n\n",
+    prvHeapTrackCommand
+};
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintScratch( ConsoleIO_t * const pxCIO,
+                             int lLen )
+{
+    if( ( lLen > 0 ) &&
+        ( lLen < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+    {
+        pxCIO->write( pcCliScratchBuffer, ( size_t ) lLen );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintFragInfo( ConsoleIO_t * const pxCIO )
+{
+    HeapFragInfo_t xFragInfo = { 0 };
+
+    vHeapGetFragInfo( &xFragInfo );
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "free: %lu bytes in %lu blocks, largest: %lu bytes, fragmentation: %lu%%\r\n",
+                                      ( unsigned long ) xFragInfo.uxFree,
+                                      ( unsigned long ) xFragInfo.uxFreeBlocks,
+                                      ( unsigned long ) xFragInfo.uxLargestFree,
+                                      ( unsigned long ) xFragInfo.ulFragmentationPct ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintArenas( ConsoleIO_t * const pxCIO )
+{
+    HeapArenaInfo_t pxArenas[ HEAPTRACK_MAX_ARENAS ];
+    size_t uxNumArenas = uxHeapArenaGetInfo( pxArenas, HEAPTRACK_MAX_ARENAS );
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-10s %8s %8s %8s %6s %8s %9s\r\n",
+                                      "arena", "size", "used", "peak", "live", "allocs", "fallbacks" ) );
+
+    for( size_t i = 0; i < uxNumArenas; i++ )
+    {
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "%-10s %8lu %8lu %8lu %6lu %8lu %9lu\r\n",
+                                          pxArenas[ i ].pcName,
+                                          ( unsigned long ) pxArenas[ i ].uxSize,
+                                          ( unsigned long ) pxArenas[ i ].uxUsed,
+                                          ( unsigned long ) pxArenas[ i ].uxPeak,
+                                          ( unsigned long ) pxArenas[ i ].ulLive,
+                                          ( unsigned long ) pxArenas[ i ].ulAllocs,
+                                          ( unsigned long ) pxArenas[ i ].ulFallbacks ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintPools( ConsoleIO_t * const pxCIO )
+{
+    HeapPoolClassInfo_t pxClasses[ HEAP_POOL_NUM_CLASSES ];
+    size_t uxNumClasses = uxHeapPoolGetInfo( pxClasses, HEAP_POOL_NUM_CLASSES );
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-6s %7s %7s %7s %10s %10s\r\n",
+                                      "class", "blocks", "in use", "peak", "allocs", "exhausted" ) );
+
+    for( size_t i = 0; i < uxNumClasses; i++ )
+    {
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "%-6lu %7lu %7lu %7lu %10lu %10lu\r\n",
+                                          ( unsigned long ) pxClasses[ i ].uxBlockSize,
+                                          ( unsigned long ) pxClasses[ i ].uxNumBlocks,
+                                          ( unsigned long ) pxClasses[ i ].uxInUse,
+                                          ( unsigned long ) pxClasses[ i ].uxPeak,
+                                          ( unsigned long ) pxClasses[ i ].ulAllocs,
+                                          ( unsigned long ) pxClasses[ i ].ulExhausted ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( configHEAP_TRACKING == 1 )
+
+static void prvPrintCountersHeader( ConsoleIO_t * const pxCIO,
+                                    const char * pcFirstColumn )
+{
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-16s %8s %8s %8s %8s\r\n",
+                                      pcFirstColumn, "current", "peak", "allocs", "frees" ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintCounters( ConsoleIO_t * const pxCIO,
+                              const char * pcLabel,
+                              const HeapTrackCounters_t * pxCounters )
+{
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-16s %8lu %8lu %8lu %8lu\r\n",
+                                      pcLabel,
+                                      ( unsigned long ) pxCounters->ulCurrent,
+                                      ( unsigned long ) pxCounters->ulPeak,
+                                      ( unsigned long ) pxCounters->ulAllocs,
+                                      ( unsigned long ) pxCounters->ulFrees ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintSubsystems( ConsoleIO_t * const pxCIO )
+{
+    HeapTrackStats_t xStats = { 0 };
+
+    vHeapTrackGetStats( &xStats );
+
+    prvPrintCountersHeader( pxCIO, "subsystem" );
+
+    for( uint32_t i = 0; i < HEAP_SUBSYS_MAX; i++ )
+    {
+        prvPrintCounters( pxCIO, pcHeapTrackSubsysName( ( HeapSubsys_t ) i ), &( xStats.pxSubsys[ i ] ) );
+    }
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "live blocks: %lu, untracked: %lu, failed allocations: %lu\r\n",
+                                      ( unsigned long ) xStats.ulLive,
+                                      ( unsigned long ) xStats.ulUntracked,
+                                      ( unsigned long ) xStats.ulFailures ) );
+
+    prvPrintFragInfo( pxCIO );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintTasks( ConsoleIO_t * const pxCIO )
+{
+    /* Static to keep them off the CLI task stack */
+    static HeapTrackTaskInfo_t pxTasks[ HEAP_TRACK_MAX_TASKS ];
+    size_t uxNumTasks = uxHeapTrackGetTasks( pxTasks, HEAP_TRACK_MAX_TASKS );
+
+    prvPrintCountersHeader( pxCIO, "task" );
+
+    for( size_t i = 0; i < uxNumTasks; i++ )
+    {
+        prvPrintCounters( pxCIO, pxTasks[ i ].pcName, &( pxTasks[ i ].xCounters ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintSites( ConsoleIO_t * const pxCIO )
+{
+    static HeapTrackSiteInfo_t pxSites[ HEAP_TRACK_MAX_SITES ];
+    size_t uxNumSites = uxHeapTrackGetSites( pxSites, HEAP_TRACK_MAX_SITES );
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-10s %-8s %8s %8s %8s %8s\r\n",
+                                      "site", "subsys", "current", "peak", "allocs", "frees" ) );
+
+    for( size_t i = 0; i < uxNumSites; i++ )
+    {
+        char pcSite[ 12 ];
+
+        if( pxSites[ i ].pvSite == NULL )
+        {
+            ( void ) strncpy( pcSite, "(other)", sizeof( pcSite ) );
+        }
+        else
+        {
+            ( void ) snprintf( pcSite, sizeof( pcSite ), "0x%08lx", ( unsigned long ) pxSites[ i ].pvSite );
+        }
+
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "%-10s %-8s %8lu %8lu %8lu %8lu\r\n",
+                                          pcSite,
+                                          pcHeapTrackSubsysName( pxSites[ i ].xSubsys ),
+                                          ( unsigned long ) pxSites[ i ].xCounters.ulCurrent,
+                                          ( unsigned long ) pxSites[ i ].xCounters.ulPeak,
+                                          ( unsigned long ) pxSites[ i ].xCounters.ulAllocs,
+                                          ( unsigned long ) pxSites[ i ].xCounters.ulFrees ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvTraceCommand( ConsoleIO_t * const pxCIO,
+                             uint32_t ulArgc,
+                             char * ppcArgv[] )
+{
+    size_t uxRecorded = 0;
+    size_t uxDropped = 0;
+
+    if( ulArgc < 3 )
+    {
+        pxCIO->print( xCommandDef_heaptrack.pcHelpString );
+    }
+    else if( strcmp( "start", ppcArgv[ 2 ] ) == 0 )
+    {
+        size_t uxMaxEvents = HEAPTRACK_DEFAULT_TRACE_EVENTS;
+
+        if( ulArgc > 3 )
+        {
+            uxMaxEvents = ( size_t ) strtoul( ppcArgv[ 3 ], NULL, 10 );
+        }
+
+        if( ( uxMaxEvents > 0 ) &&
+            xHeapTrackTraceStart( uxMaxEvents ) )
+        {
+            pxCIO->print( "Heap trace started.\r\n" );
+        }
+        else
+        {
+            pxCIO->print( "Error: Failed to allocate the trace buffer.\r\n" );
+        }
+    }
+    else if( strcmp( "stop", ppcArgv[ 2 ] ) == 0 )
+    {
+        vHeapTrackTraceStop();
+        vHeapTrackTraceGetCounts( &uxRecorded, &uxDropped );
+
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "Heap trace stopped: %lu events recorded, %lu dropped.\r\n",
+                                          ( unsigned long ) uxRecorded,
+                                          ( unsigned long ) uxDropped ) );
+    }
+    else if( strcmp( "dump", ppcArgv[ 2 ] ) == 0 )
+    {
+        size_t uxIndex = 0;
+        size_t uxLen = 0;
+
+        while( ( uxLen = uxHeapTrackTraceFormat( &uxIndex, pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN ) ) > 0 )
+        {
+            pxCIO->write( pcCliScratchBuffer, uxLen );
+        }
+
+        vHeapTrackTraceGetCounts( &uxRecorded, &uxDropped );
+
+        if( uxDropped > 0 )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "# %lu events dropped\r\n",
+                                              ( unsigned long ) uxDropped ) );
+        }
+    }
+    else if( strcmp( "clear", ppcArgv[ 2 ] ) == 0 )
+    {
+        vHeapTrackTraceClear();
+        pxCIO->print( "Heap trace cleared.\r\n" );
+    }
+    else
+    {
+        pxCIO->print( xCommandDef_heaptrack.pcHelpString );
+    }
+}
+
+#endif /* configHEAP_TRACKING */
+
+/*-----------------------------------------------------------*/
+
+static void prvHeapTrackCommand( ConsoleIO_t * const pxCIO,
+                                 uint32_t ulArgc,
+                                 char * ppcArgv[] )
+{
+    if( ( ulArgc >= 2 ) &&
+        ( strcmp( "arenas", ppcArgv[ 1 ] ) == 0 ) )
+    {
+        prvPrintArenas( pxCIO );
+    }
+    else if( ( ulArgc >= 2 ) &&
+             ( strcmp( "pools", ppcArgv[ 1 ] ) == 0 ) )
+    {
+        if( ( ulArgc >= 3 ) &&
+            ( strcmp( "clear", ppcArgv[ 2 ] ) == 0 ) )
+        {
+            vHeapPoolResetStats();
+            pxCIO->print( "Pool statistics cleared.\r\n" );
+        }
+        else
+        {
+            prvPrintPools( pxCIO );
+        }
+    }
+
+    #if ( configHEAP_TRACKING == 1 )
+        else if( ( ulArgc < 2 ) ||
+                 ( strcmp( "subsys", ppcArgv[ 1 ] ) == 0 ) )
+        {
+            prvPrintSubsystems( pxCIO );
+        }
+        else if( strcmp( "tasks", ppcArgv[ 1 ] ) == 0 )
+        {
+            prvPrintTasks( pxCIO );
+        }
+        else if( strcmp( "sites", ppcArgv[ 1 ] ) == 0 )
+        {
+            prvPrintSites( pxCIO );
+        }
+        else if( strcmp( "peaks", ppcArgv[ 1 ] ) == 0 )
+        {
+            vHeapTrackResetPeaks();
+            pxCIO->print( "Heap peaks reset.\r\n" );
+        }
+        else if( strcmp( "trace", ppcArgv[ 1 ] ) == 0 )
+        {
+            prvTraceCommand( pxCIO, ulArgc, ppcArgv );
+        }
+    #else /* configHEAP_TRACKING */
+        else if( ulArgc < 2 )
+        {
+            prvPrintFragInfo( pxCIO );
+            pxCIO->print( "Heap tracking is disabled, build with configHEAP_TRACKING=1 to enable it.\r\n" );
+        }
+    #endif /* configHEAP_TRACKING */
+    else
+    {
+        pxCIO->print( xCommandDef_heaptrack.pcHelpString );
+    }
+}
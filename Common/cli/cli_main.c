@@ -346,6 +346,10 @@ void Task_CLI( void * pvParameters )
     FreeRTOS_CLIRegisterCommand( &xCommandDef_reset );
     FreeRTOS_CLIRegisterCommand( &xCommandDef_uptime );
     FreeRTOS_CLIRegisterCommand( &xCommandDef_rngtest );
+    FreeRTOS_CLIRegisterCommand( &xCommandDef_dns );
+    FreeRTOS_CLIRegisterCommand( &xCommandDef_reconnect );
+    FreeRTOS_CLIRegisterCommand( &xCommandDef_heaptrack );
+    FreeRTOS_CLIRegisterCommand( &xCommandDef_trace );
     FreeRTOS_CLIRegisterCommand( &xCommandDef_assert );
 
     char * pcCommandBuffer = NULL;
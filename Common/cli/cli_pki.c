@@ -37,9 +37,11 @@
 /* Standard Lib */
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 #include "tls_transport_config.h"
 #include "mbedtls_transport.h"
+#include "PkiCertCache.h"
 
 #ifdef MBEDTLS_TRANSPORT_PKCS11
 /* PKCS11 */
@@ -89,7 +91,7 @@ const CLI_Command_Definition_t xCommandDef_pki =
         "    Perform public/private key operations.\r\n"
         "    Usage:\r\n"
         "    pki <verb> <object> <args>\r\n"
-        "        Valid verbs are { generate, import, export, list }\r\n"
+        "        Valid verbs are { generate, import, export, list, stats, cache }\r\n"
         "        Valid object types are { key, csr, cert }\r\n"
         "        Arguments should be specified in --<arg_name> <value>\r\n\n"
         "    pki generate key <label_public> <label_private> <algorithm> <algorithm_param>\r\n"
@@ -110,7 +112,12 @@ const CLI_Command_Definition_t xCommandDef_pki =
         "        Import a public key into the given slot. The key should be \r\n"
         "        copied into the terminal in PEM format, ending with two blank lines.\r\n\n"
         "    pki export key <label>\r\n"
-        "        Export the public portion of the key with the specified label.\r\n\n",
+        "        Export the public portion of the key with the specified label.\r\n\n"
+        "    pki stats\r\n"
+        "        Print the PKCS#11 object cache and session counters.\r\n\n"
+        "    pki cache\r\n"
+        "        List the parsed certificate chains shared between TLS connections\r\n"
+        "        with their parse time and heap usage.\r\n\n",
     .pxCommandInterpreter = vCommand_PKI
 };
 
@@ -967,6 +974,72 @@ static void vSubCommand_ExportKey( ConsoleIO_t * pxCIO,
     }
 }
 
+#ifdef MBEDTLS_TRANSPORT_PKCS11
+    static void vSubCommand_Stats( ConsoleIO_t * pxCIO )
+    {
+        Pkcs11CacheStats_t xStats = { 0 };
+        int lLen;
+
+        vPkcs11GetCacheStats( &xStats );
+
+        lLen = snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                         "sessions_opened=%lu\r\n"
+                         "handle_hits=%lu\r\n"
+                         "handle_misses=%lu\r\n"
+                         "value_hits=%lu\r\n"
+                         "value_reads=%lu\r\n",
+                         ( unsigned long ) xStats.ulSessionsOpened,
+                         ( unsigned long ) xStats.ulHandleHits,
+                         ( unsigned long ) xStats.ulHandleMisses,
+                         ( unsigned long ) xStats.ulValueHits,
+                         ( unsigned long ) xStats.ulValueReads );
+
+        if( ( lLen > 0 ) && ( lLen < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+        {
+            pxCIO->write( pcCliScratchBuffer, ( size_t ) lLen );
+        }
+    }
+#endif /* MBEDTLS_TRANSPORT_PKCS11 */
+
+static void vSubCommand_CertCache( ConsoleIO_t * pxCIO )
+{
+    PkiCertCacheInfo_t pxInfo[ PKI_CERT_CACHE_MAX_ENTRIES ];
+    uint32_t ulHits = 0;
+    uint32_t ulMisses = 0;
+    size_t uxNumEntries;
+    int lLen;
+
+    uxNumEntries = uxPkiCertCacheGetInfo( pxInfo, PKI_CERT_CACHE_MAX_ENTRIES, &ulHits, &ulMisses );
+
+    lLen = snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                     "hits=%lu misses=%lu\r\n",
+                     ( unsigned long ) ulHits, ( unsigned long ) ulMisses );
+
+    if( ( lLen > 0 ) && ( lLen < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+    {
+        pxCIO->write( pcCliScratchBuffer, ( size_t ) lLen );
+    }
+
+    for( size_t i = 0; i < uxNumEntries; i++ )
+    {
+        lLen = snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                         "%u: objects=%lu certs=%lu refs=%lu hits=%lu parse_ms=%lu heap=%lu%s\r\n",
+                         ( unsigned int ) i,
+                         ( unsigned long ) pxInfo[ i ].uxNumObjects,
+                         ( unsigned long ) pxInfo[ i ].uxNumCerts,
+                         ( unsigned long ) pxInfo[ i ].ulRefCount,
+                         ( unsigned long ) pxInfo[ i ].ulHits,
+                         ( unsigned long ) pxInfo[ i ].ulParseTimeMs,
+                         ( unsigned long ) pxInfo[ i ].uxHeapBytes,
+                         pxInfo[ i ].xStale ? " stale" : "" );
+
+        if( ( lLen > 0 ) && ( lLen < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+        {
+            pxCIO->write( pcCliScratchBuffer, ( size_t ) lLen );
+        }
+    }
+}
+
 #define VERB_ARG_INDEX       1
 #define OBJECT_TYPE_INDEX    2
 
@@ -1081,6 +1154,20 @@ static void vCommand_PKI( ConsoleIO_t * pxCIO,
         {
             xSuccess = pdFALSE;
         }
+
+        else if( 0 == strcmp( "cache", pcVerb ) )
+        {
+            vSubCommand_CertCache( pxCIO );
+            xSuccess = pdTRUE;
+        }
+
+        #ifdef MBEDTLS_TRANSPORT_PKCS11
+            else if( 0 == strcmp( "stats", pcVerb ) )
+            {
+                vSubCommand_Stats( pxCIO );
+                xSuccess = pdTRUE;
+            }
+        #endif /* MBEDTLS_TRANSPORT_PKCS11 */
     }
 
     if( xSuccess == pdFALSE )
@@ -132,6 +132,10 @@ extern const CLI_Command_Definition_t xCommandDef_heapStat;
 extern const CLI_Command_Definition_t xCommandDef_reset;
 extern const CLI_Command_Definition_t xCommandDef_uptime;
 extern const CLI_Command_Definition_t xCommandDef_rngtest;
+extern const CLI_Command_Definition_t xCommandDef_dns;
+extern const CLI_Command_Definition_t xCommandDef_reconnect;
+extern const CLI_Command_Definition_t xCommandDef_heaptrack;
+extern const CLI_Command_Definition_t xCommandDef_trace;
 extern const CLI_Command_Definition_t xCommandDef_assert;
 
 #endif /* _CLI_PRIV */
@@ -0,0 +1,130 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2020-2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* FreeRTOS */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cli.h"
+#include "cli_prv.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "reconnect_policy.h"
+
+static void prvReconnectCommand( ConsoleIO_t * const pxCIO,
+                                 uint32_t ulArgc,
+                                 char * ppcArgv[] );
+
+const CLI_Command_Definition_t xCommandDef_reconnect =
+{
+    "reconnect",
+    "reconnect\r\n"
+    "    reconnect [stats]\r\n"
+    "        Display MQTT reconnect causes and histograms of outage duration\r\n"
+    "        and reconnect latency.\r\n\n"
+    "    reconnect clear\r\n"
+    "        Reset the reconnect statistics.\r\n\n",
+    prvReconnectCommand
+};
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintScratch( ConsoleIO_t * const pxCIO,
+                             int lLen )
+{
+    if( ( lLen > 0 ) &&
+        ( lLen < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+    {
+        pxCIO->write( pcCliScratchBuffer, ( size_t ) lLen );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvReconnectStats( ConsoleIO_t * const pxCIO )
+{
+    ReconnectStats_t xStats = { 0 };
+
+    vReconnectPolicyGetStats( &xStats );
+
+    for( uint32_t i = 0; i < RECONNECT_CAUSE_MAX; i++ )
+    {
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "%-16s %lu\r\n",
+                                          pcReconnectPolicyCauseName( ( ReconnectCause_t ) i ),
+                                          ( unsigned long ) xStats.pulCauseCount[ i ] ) );
+    }
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "network reconnects requested: %lu\r\n"
+                                      "last outage: %lu ms, longest outage: %lu ms\r\n\n"
+                                      "%-12s %10s %10s\r\n",
+                                      ( unsigned long ) xStats.ulLinkResets,
+                                      ( unsigned long ) xStats.ulLastOutageMs,
+                                      ( unsigned long ) xStats.ulMaxOutageMs,
+                                      "ms", "outage", "latency" ) );
+
+    for( uint32_t i = 0; i < RECONNECT_HIST_NUM_BUCKETS; i++ )
+    {
+        uint32_t ulLimitMs = ulReconnectPolicyBucketLimitMs( i );
+        char pcLabel[ 16 ] = { 0 };
+
+        if( ulLimitMs == UINT32_MAX )
+        {
+            ( void ) snprintf( pcLabel, sizeof( pcLabel ), ">= %lu",
+                               ( unsigned long ) ulReconnectPolicyBucketLimitMs( i - 1 ) );
+        }
+        else
+        {
+            ( void ) snprintf( pcLabel, sizeof( pcLabel ), "< %lu", ( unsigned long ) ulLimitMs );
+        }
+
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "%-12s %10lu %10lu\r\n", pcLabel,
+                                          ( unsigned long ) xStats.pulOutageHist[ i ],
+                                          ( unsigned long ) xStats.pulLatencyHist[ i ] ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvReconnectCommand( ConsoleIO_t * const pxCIO,
+                                 uint32_t ulArgc,
+                                 char * ppcArgv[] )
+{
+    if( ( ulArgc < 2 ) ||
+        ( strcmp( "stats", ppcArgv[ 1 ] ) == 0 ) )
+    {
+        prvReconnectStats( pxCIO );
+    }
+    else if( strcmp( "clear", ppcArgv[ 1 ] ) == 0 )
+    {
+        vReconnectPolicyClearStats();
+        pxCIO->print( "Reconnect statistics cleared.\r\n" );
+    }
+    else
+    {
+        pxCIO->print( xCommandDef_reconnect.pcHelpString );
+    }
+}
@@ -0,0 +1,186 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2020-2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* FreeRTOS */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cli.h"
+#include "cli_prv.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mbedtls/base64.h"
+
+#include "trace_ring.h"
+
+/* Dump bytes per line, 64 characters once base64 encoded */
+#define TRACE_DUMP_BYTES_PER_LINE    ( 48 )
+#define TRACE_DUMP_LINE_LEN          ( 64 )
+
+static void prvTraceCommand( ConsoleIO_t * const pxCIO,
+                             uint32_t ulArgc,
+                             char * ppcArgv[] );
+
+const CLI_Command_Definition_t xCommandDef_trace =
+{
+    "trace",
+    "trace\r\n"
+    "    trace [status]\r\n"
+    "        Display whether trace points are recorded and the number of events.\r\n\n"
+    "    trace start | stop\r\n"
+    "        Resume or pause recording to the trace ring.\r\n\n"
+    "    trace clear\r\n"
+    "        Discard all recorded events.\r\n\n"
+    "    trace dump\r\n"
+    "        Print the trace ring base64 encoded, to be converted with\r\n"
+    "        tools/trace_to_json.py and opened in Perfetto or chrome://tracing.\r\n\n",
+    prvTraceCommand
+};
+
+/*-----------------------------------------------------------*/
+
+#if ( configTRACE_POINTS == 1 )
+
+static void prvPrintScratch( ConsoleIO_t * const pxCIO,
+                             int lLen )
+{
+    if( ( lLen > 0 ) &&
+        ( lLen < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+    {
+        pxCIO->write( pcCliScratchBuffer, ( size_t ) lLen );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintStatus( ConsoleIO_t * const pxCIO )
+{
+    TraceStatus_t xStatus = { 0 };
+
+    vTraceGetStatus( &xStatus );
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "Trace %s: %lu events recorded, ring holds %lu.\r\n",
+                                      xStatus.xEnabled ? "running" : "stopped",
+                                      ( unsigned long ) xStatus.ulRecorded,
+                                      ( unsigned long ) xStatus.ulCapacity ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvDumpTrace( ConsoleIO_t * const pxCIO )
+{
+    size_t uxDumpLen = uxTraceDumpBegin();
+
+    if( uxDumpLen == 0 )
+    {
+        pxCIO->print( "Error: Failed to allocate the trace task table.\r\n" );
+    }
+    else
+    {
+        uint8_t pucChunk[ TRACE_DUMP_BYTES_PER_LINE ];
+        char pcLine[ TRACE_DUMP_LINE_LEN + 3 ];
+        size_t uxOffset = 0;
+        size_t uxChunkLen = 0;
+        int lRslt = 0;
+
+        pxCIO->print( "-----BEGIN TRACE-----\r\n" );
+
+        while( ( lRslt == 0 ) &&
+               ( ( uxChunkLen = uxTraceDumpRead( uxOffset, pucChunk, sizeof( pucChunk ) ) ) > 0 ) )
+        {
+            size_t uxLineLen = 0;
+
+            lRslt = mbedtls_base64_encode( ( unsigned char * ) pcLine,
+                                           TRACE_DUMP_LINE_LEN + 1,
+                                           &uxLineLen,
+                                           pucChunk,
+                                           uxChunkLen );
+
+            if( lRslt == 0 )
+            {
+                pcLine[ uxLineLen++ ] = '\r';
+                pcLine[ uxLineLen++ ] = '\n';
+                pxCIO->write( pcLine, uxLineLen );
+                uxOffset += uxChunkLen;
+            }
+        }
+
+        vTraceDumpEnd();
+
+        if( lRslt == 0 )
+        {
+            pxCIO->print( "-----END TRACE-----\r\n" );
+        }
+        else
+        {
+            pxCIO->print( "\r\nError: Failed to encode the trace.\r\n" );
+        }
+    }
+}
+
+#endif /* configTRACE_POINTS */
+
+/*-----------------------------------------------------------*/
+
+static void prvTraceCommand( ConsoleIO_t * const pxCIO,
+                             uint32_t ulArgc,
+                             char * ppcArgv[] )
+{
+    #if ( configTRACE_POINTS == 1 )
+        if( ( ulArgc < 2 ) ||
+            ( strcmp( "status", ppcArgv[ 1 ] ) == 0 ) )
+        {
+            prvPrintStatus( pxCIO );
+        }
+        else if( strcmp( "start", ppcArgv[ 1 ] ) == 0 )
+        {
+            vTraceStart();
+            pxCIO->print( "Trace started.\r\n" );
+        }
+        else if( strcmp( "stop", ppcArgv[ 1 ] ) == 0 )
+        {
+            vTraceStop();
+            prvPrintStatus( pxCIO );
+        }
+        else if( strcmp( "clear", ppcArgv[ 1 ] ) == 0 )
+        {
+            vTraceClear();
+            pxCIO->print( "Trace cleared.\r\n" );
+        }
+        else if( strcmp( "dump", ppcArgv[ 1 ] ) == 0 )
+        {
+            prvDumpTrace( pxCIO );
+        }
+        else
+        {
+            pxCIO->print( xCommandDef_trace.pcHelpString );
+        }
+    #else /* configTRACE_POINTS */
+        ( void ) ulArgc;
+        ( void ) ppcArgv;
+
+        pxCIO->print( "Trace points are disabled, set configTRACE_POINTS to 1 in FreeRTOSConfig.h.\r\n" );
+    #endif /* configTRACE_POINTS */
+}
@@ -36,6 +36,10 @@
 #include "cli.h"
 #include "cli_prv.h"
 
+#include "app/boot_metrics.h"
+#include "app/boot_stages.h"
+#include "heap_track.h"
+
 #include "core_cm33.h"
 
 static void prvPSCommand( ConsoleIO_t * const pxConsoleIO,
@@ -127,7 +131,10 @@ const CLI_Command_Definition_t xCommandDef_uptime =
 {
     "uptime",
     "uptime\r\n"
-    "    Display system uptime.\r\n\n",
+    "    Display system uptime.\r\n\n"
+    "    uptime -b | --boot\r\n"
+    "        Also display the time from power-on to each boot milestone, and when each\r\n"
+    "        boot stage started and ended.\r\n\n",
     vUptimeCommand
 };
 
@@ -616,6 +623,33 @@ static void vHeapStatCommand( ConsoleIO_t * const pxCIO,
             xLen = CLI_OUTPUT_SCRATCH_BUF_LEN - 1;
         }
 
+        pxCIO->write( pcCliScratchBuffer, xLen );
+
+        HeapFragInfo_t xFragInfo = { 0 };
+
+        vHeapGetFragInfo( &xFragInfo );
+
+        xLen = snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN, pcFormatString,
+                         "Largest Free", xFragInfo.uxLargestFree / xDivisor, xFragInfo.uxLargestFree,
+                         ( 100 * xFragInfo.uxLargestFree ) / xHeapSize );
+
+        if( xLen >= CLI_OUTPUT_SCRATCH_BUF_LEN )
+        {
+            xLen = CLI_OUTPUT_SCRATCH_BUF_LEN - 1;
+        }
+
+        pxCIO->write( pcCliScratchBuffer, xLen );
+
+        xLen = snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                         "| %-16s | %-11lu | %-11s | %3lu %%   |\r\n",
+                         "Free Blocks", ( unsigned long ) xFragInfo.uxFreeBlocks, "frag.",
+                         ( unsigned long ) xFragInfo.ulFragmentationPct );
+
+        if( xLen >= CLI_OUTPUT_SCRATCH_BUF_LEN )
+        {
+            xLen = CLI_OUTPUT_SCRATCH_BUF_LEN - 1;
+        }
+
         pxCIO->write( pcCliScratchBuffer, xLen );
         pxCIO->print( "+--------------------------------------------------------+\r\n" );
     }
@@ -643,9 +677,6 @@ static void vUptimeCommand( ConsoleIO_t * const pxCIO,
 
     unsigned long ulMsCount = ( xTaskGetTickCount() / portTICK_PERIOD_MS );
 
-    ( void ) ulArgc;
-    ( void ) ppcArgv;
-
     lRslt = snprintf( pcCliScratchBuffer,
                       CLI_OUTPUT_SCRATCH_BUF_LEN,
                       "up %lu day(s) %02lu:%02lu:%02lu.%03lu\r\n",
@@ -660,6 +691,55 @@ static void vUptimeCommand( ConsoleIO_t * const pxCIO,
     {
         pxCIO->write( pcCliScratchBuffer, ( size_t ) lRslt );
     }
+
+    if( ( ulArgc > 1 ) &&
+        ( ( strcmp( "-b", ppcArgv[ 1 ] ) == 0 ) ||
+          ( strcmp( "--boot", ppcArgv[ 1 ] ) == 0 ) ) )
+    {
+        for( BootMilestone_t xMilestone = 0; xMilestone < BOOT_MILESTONE_MAX; xMilestone++ )
+        {
+            uint32_t ulTimeMs = 0;
+
+            if( xBootMetricsGet( xMilestone, &ulTimeMs ) )
+            {
+                lRslt = snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                  "%-20s %8lu ms\r\n",
+                                  pcBootMetricsName( xMilestone ), ( unsigned long ) ulTimeMs );
+            }
+            else
+            {
+                lRslt = snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                  "%-20s %8s\r\n",
+                                  pcBootMetricsName( xMilestone ), "-" );
+            }
+
+            if( ( lRslt > 0 ) &&
+                ( lRslt < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+            {
+                pxCIO->write( pcCliScratchBuffer, ( size_t ) lRslt );
+            }
+        }
+
+        const BootTimelineEntry_t * pxTimeline = NULL;
+        size_t uxStages = uxBootStagesGetTimeline( &pxTimeline );
+
+        for( size_t i = 0; i < uxStages; i++ )
+        {
+            lRslt = snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                              "stage %-14s %8lu ms %8lu ms%s\r\n",
+                              pxTimeline[ i ].pcName,
+                              ( unsigned long ) pxTimeline[ i ].ulStartMs,
+                              ( unsigned long ) pxTimeline[ i ].ulEndMs,
+                              ( pxTimeline[ i ].xState == BOOT_STAGE_FAILED ) ? " failed" :
+                              ( pxTimeline[ i ].xState != BOOT_STAGE_DONE ) ? " running" : "" );
+
+            if( ( lRslt > 0 ) &&
+                ( lRslt < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+            {
+                pxCIO->write( pcCliScratchBuffer, ( size_t ) lRslt );
+            }
+        }
+    }
 }
 
 static void vAssertCommand( ConsoleIO_t * const pxCIO,
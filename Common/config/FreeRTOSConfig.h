@@ -187,6 +187,30 @@
 
 #include "stack_macros.h"
 
+/*
+ * Heap allocation tracking, see heap_track.h. It adds a hook to every allocation
+ * and free, so it is off by default. Define configHEAP_TRACKING=1 in the compiler
+ * symbols of a debug build to enable it.
+ */
+#ifndef configHEAP_TRACKING
+#define configHEAP_TRACKING                         0
+#endif
+
+#if ( configHEAP_TRACKING == 1 ) && ( defined( __ICCARM__ ) || defined( __CC_ARM ) || defined( __GNUC__ ) )
+    #include <stddef.h>
+    void vHeapTrackMalloc( void * pvAddress,
+                           size_t uxSize,
+                           void * pvCaller );
+    void vHeapTrackFree( void * pvAddress,
+                         size_t uxSize );
+
+    #define traceMALLOC( pvAddress, uiSize )    vHeapTrackMalloc( ( pvAddress ), ( uiSize ), __builtin_return_address( 0 ) )
+    #define traceFREE( pvAddress, uiSize )      vHeapTrackFree( ( pvAddress ), ( uiSize ) )
+#endif
+
+/* Cycle counter timestamped trace points, see trace_ring.h */
+#define configTRACE_POINTS                          1
+
 #define configAPPLICATION_PROVIDES_cOutputBuffer    1
 #define configCOMMAND_INT_MAX_OUTPUT_SIZE           128
 
@@ -2,6 +2,7 @@
 #define __HW_DEFS
 
 #include "stm32u5xx_hal.h"
+#include <stdbool.h>
 
 #define LED_RED_Pin                GPIO_PIN_6
 #define LED_RED_GPIO_Port          GPIOH
@@ -23,6 +24,11 @@
 #define MXCHIP_RESET_Pin           GPIO_PIN_15
 #define MXCHIP_RESET_GPIO_Port     GPIOF
 
+/* ISM330DHCX INT1, used as the accelerometer / gyroscope data ready interrupt */
+#define IMU_INT1_Pin               GPIO_PIN_11
+#define IMU_INT1_GPIO_Port         GPIOE
+#define IMU_INT1_EXTI_IRQn         EXTI11_IRQn
+
 extern RTC_HandleTypeDef * pxHndlRtc;
 extern SPI_HandleTypeDef * pxHndlSpi2;
 extern TIM_HandleTypeDef * pxHndlTim5;
@@ -44,6 +50,12 @@ static inline uint32_t timer_get_count( TIM_HandleTypeDef * pxHndl )
     }
 }
 
+/* Core clock cycle count from the DWT unit. Enabled by hw_init and wraps every ~26 s at 160 MHz. */
+static inline uint32_t ulGetCycleCount( void )
+{
+    return DWT->CYCCNT;
+}
+
 void hw_init( void );
 
 typedef void ( * GPIOInterruptCallback_t ) ( void * pvContext );
@@ -54,6 +66,14 @@ void GPIO_EXTI_Register_Callback( uint16_t usGpioPinMask,
 
 void vDoSystemReset( void );
 
+/*
+ * Called by the NMI handler. Returns true if the NMI was raised by a flash double
+ * ECC error that the code reading the flash expected and has cleared, so that
+ * execution can resume. The default implementation returns false and the NMI
+ * handler halts.
+ */
+bool xFlashEccErrorHook( void );
+
 static inline void vPetWatchdog( void )
 {
     /* Check / pet the watchdog */
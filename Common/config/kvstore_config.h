@@ -31,17 +31,30 @@
 #include "test_execution_config.h"
 #include "ota_config.h"
 
+/*
+ * One entry per key: X( key, name, type, default value ).
+ * The key enum, the name map, the defaults and the typed accessors in kvstore.h
+ * are all generated from this table.
+ */
+#define KV_STORE_KEY_TABLE( X )                                                       \
+    X( CS_CORE_THING_NAME,    "thing_name",      KV_TYPE_STRING, THING_NAME_DFLT )    \
+    X( CS_CORE_MQTT_ENDPOINT, "mqtt_endpoint",   KV_TYPE_STRING, MQTT_ENDPOINT_DFLT ) \
+    X( CS_CORE_MQTT_PORT,     "mqtt_port",       KV_TYPE_UINT32, MQTT_PORT_DFLT )     \
+    X( CS_WIFI_SSID,          "wifi_ssid",       KV_TYPE_STRING, WIFI_SSID_DFLT )     \
+    X( CS_WIFI_CREDENTIAL,    "wifi_credential", KV_TYPE_STRING, WIFI_PASSWORD_DFLT ) \
+    X( CS_TIME_HWM_S_1970,    "time_hwm",        KV_TYPE_UINT32, 0 )                  \
+    X( CS_IOTC_PLATFORM,      "platform",        KV_TYPE_STRING, IOTC_PLATFORM_DFLT ) \
+    X( CS_IOTC_CPID,          "cpid",            KV_TYPE_STRING, IOTC_CPID_DFLT )     \
+    X( CS_IOTC_ENV,           "env",             KV_TYPE_STRING, IOTC_ENV_DFLT )      \
+    X( CS_DNS_LKG_ADDR,       "dns_lkg",         KV_TYPE_STRING, "" )
+
+#define KV_STORE_ENUM_ENTRY( key, name, type, value )       key,
+#define KV_STORE_STRING_ENTRY( key, name, type, value )     name,
+#define KV_STORE_DEFAULT_ENTRY( key, name, type, value )    KV_DFLT( type, value ),
+
 typedef enum KvStoreEnum
 {
-    CS_CORE_THING_NAME,
-    CS_CORE_MQTT_ENDPOINT,
-    CS_CORE_MQTT_PORT,
-    CS_WIFI_SSID,
-    CS_WIFI_CREDENTIAL,
-    CS_TIME_HWM_S_1970,
-    CS_IOTC_PLATFORM,
-    CS_IOTC_CPID,
-    CS_IOTC_ENV,
+    KV_STORE_KEY_TABLE( KV_STORE_ENUM_ENTRY )
     CS_NUM_KEYS
 } KVStoreKey_t;
 
@@ -114,30 +127,8 @@ typedef enum KvStoreEnum
 /* -------------------------------- Values for common attributes -------------------------------- */
 
 /* Array to map between strings and KVStoreKey_t IDs */
-#define KV_STORE_STRINGS   \
-    {                      \
-        "thing_name",      \
-        "mqtt_endpoint",   \
-        "mqtt_port",       \
-        "wifi_ssid",       \
-        "wifi_credential", \
-        "time_hwm",        \
-        "platform",        \
-        "cpid",            \
-        "env"              \
-    }
-
-#define KV_STORE_DEFAULTS                                                          \
-    {                                                                              \
-        KV_DFLT( KV_TYPE_STRING, THING_NAME_DFLT ),    /* CS_CORE_THING_NAME */    \
-        KV_DFLT( KV_TYPE_STRING, MQTT_ENDPOINT_DFLT ), /* CS_CORE_MQTT_ENDPOINT */ \
-        KV_DFLT( KV_TYPE_UINT32, MQTT_PORT_DFLT ),     /* CS_CORE_MQTT_PORT */     \
-        KV_DFLT( KV_TYPE_STRING, WIFI_SSID_DFLT ),     /* CS_WIFI_SSID */          \
-        KV_DFLT( KV_TYPE_STRING, WIFI_PASSWORD_DFLT ), /* CS_WIFI_CREDENTIAL */    \
-        KV_DFLT( KV_TYPE_UINT32, 0 ),                  /* CS_TIME_HWM_S_1970 */    \
-        KV_DFLT( KV_TYPE_STRING, IOTC_PLATFORM_DFLT ), /* CS_IOTC_PLATFORM */      \
-        KV_DFLT( KV_TYPE_STRING, IOTC_CPID_DFLT ), 	   /* CS_IOTC_CPID */          \
-        KV_DFLT( KV_TYPE_STRING, IOTC_ENV_DFLT ), 	   /* CS_IOTC_ENV */           \
-    }
+#define KV_STORE_STRINGS    { KV_STORE_KEY_TABLE( KV_STORE_STRING_ENTRY ) }
+
+#define KV_STORE_DEFAULTS   { KV_STORE_KEY_TABLE( KV_STORE_DEFAULT_ENTRY ) }
 
 #endif /* _KVSTORE_CONFIG_H */
@@ -46,7 +46,7 @@ extern "C"
 /*#define HAL_MDF_MODULE_ENABLED */
 /*#define HAL_COMP_MODULE_ENABLED */
 /*#define HAL_CORDIC_MODULE_ENABLED */
-/*#define HAL_CRC_MODULE_ENABLED */
+#define HAL_CRC_MODULE_ENABLED
 #define HAL_CRYP_MODULE_ENABLED
 /*#define HAL_DAC_MODULE_ENABLED */
 /*#define HAL_DMA2D_MODULE_ENABLED */
@@ -25,12 +25,15 @@
 
 /* Lwip related definitions */
 
+#include "lwip/netdb.h"
+
 #define sock_socket         lwip_socket
 #define sock_connect        lwip_connect
 #define sock_send           lwip_send
 #define sock_recv           lwip_recv
 #define sock_close          lwip_close
 #define sock_setsockopt     lwip_setsockopt
+#define sock_getsockopt     lwip_getsockopt
 #define sock_fcntl          lwip_fcntl
 #define sock_select         lwip_select
 
@@ -0,0 +1,88 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TLS_TRANSPORT_POSIX
+#define TLS_TRANSPORT_POSIX
+
+/*
+ * BSD socket definitions for running the transport on a host with the
+ * FreeRTOS POSIX port. Selected in place of tls_transport_lwip.h by the
+ * tls_transport_config.h of a host build.
+ */
+
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define sock_socket         socket
+#define sock_connect        connect
+#define sock_send           send
+#define sock_recv           recv
+#define sock_close          close
+#define sock_setsockopt     sock_posix_setsockopt
+#define sock_getsockopt     getsockopt
+#define sock_fcntl          fcntl
+#define sock_select         sock_posix_select
+
+#define dns_getaddrinfo     getaddrinfo
+#define dns_freeaddrinfo    freeaddrinfo
+
+/* mbedtls_transport.c guards each address family with the lwIP option names */
+#define LWIP_IPV4    1
+#define LWIP_IPV6    0
+
+#define IP4ADDR_STRLEN_MAX    INET_ADDRSTRLEN
+#define inet_ntoa_r( xAddr, pcBuf, xBufLen )    inet_ntop( AF_INET, &( xAddr ), ( pcBuf ), ( xBufLen ) )
+
+/* mbedtls_transport.c reads errno through the newlib accessor */
+#define __errno    __errno_location
+
+typedef int SockHandle_t;
+
+/*
+ * lwIP takes SO_RCVTIMEO and SO_SNDTIMEO as a uint32_t millisecond count,
+ * Linux takes a struct timeval. Other options are passed through.
+ */
+int sock_posix_setsockopt( int lSock,
+                           int lLevel,
+                           int lOptName,
+                           const void * pvOptVal,
+                           socklen_t xOptLen );
+
+/*
+ * A blocking select() would stall the thread of a FreeRTOS task without the
+ * scheduler knowing. Polls with a zero timeout and yields one tick between
+ * polls, so readiness is seen up to one tick late.
+ */
+int sock_posix_select( int lMaxFd,
+                       fd_set * pxReadSet,
+                       fd_set * pxWriteSet,
+                       fd_set * pxErrorSet,
+                       struct timeval * pxTimeout );
+
+#endif /* TLS_TRANSPORT_POSIX */
@@ -0,0 +1,525 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <string.h>
+
+#include "tls_transport_config.h"
+#include "PkiObject.h"
+#include "PkiCertCache.h"
+
+#include "mbedtls/platform.h"
+
+#define FNV64_OFFSET_BASIS    0xCBF29CE484222325ULL
+#define FNV64_PRIME           0x00000100000001B3ULL
+
+struct PkiCertCacheEntry
+{
+    uint64_t ullKey;
+    size_t uxNumObjects;
+    size_t uxNumCerts;
+    mbedtls_x509_crt * pxChain;
+    uint32_t ulRefCount;
+    uint32_t ulHits;
+    uint32_t ulParseTimeMs;
+    size_t uxHeapBytes;
+    TickType_t xLastUsed;
+    bool xInUse;
+    bool xCached; /*!< false for entries allocated while the cache was full */
+    bool xStale;
+};
+
+static PkiCertCacheEntry_t xCacheEntries[ PKI_CERT_CACHE_MAX_ENTRIES ];
+static uint32_t ulCacheHits = 0;
+static uint32_t ulCacheMisses = 0;
+
+static StaticSemaphore_t xCacheMutexStatic;
+static SemaphoreHandle_t xCacheMutex = NULL;
+
+/*-----------------------------------------------------------*/
+
+static void prvCacheLock( void )
+{
+    taskENTER_CRITICAL();
+
+    if( xCacheMutex == NULL )
+    {
+        xCacheMutex = xSemaphoreCreateMutexStatic( &xCacheMutexStatic );
+    }
+
+    taskEXIT_CRITICAL();
+
+    ( void ) xSemaphoreTake( xCacheMutex, portMAX_DELAY );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCacheUnlock( void )
+{
+    ( void ) xSemaphoreGive( xCacheMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvFnv1a64( uint64_t ullHash,
+                            const void * pvData,
+                            size_t uxLen )
+{
+    const uint8_t * pucData = ( const uint8_t * ) pvData;
+
+    for( size_t i = 0; i < uxLen; i++ )
+    {
+        ullHash ^= pucData[ i ];
+        ullHash *= FNV64_PRIME;
+    }
+
+    return ullHash;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Hash the identity of each object: buffer content for PEM / DER objects, otherwise the label or id */
+static bool prvGetKey( const PkiObject_t * pxCertificates,
+                       size_t uxNumCertificates,
+                       uint64_t * pullKey )
+{
+    bool xResult = true;
+    uint64_t ullHash = FNV64_OFFSET_BASIS;
+
+    ullHash = prvFnv1a64( ullHash, &uxNumCertificates, sizeof( uxNumCertificates ) );
+
+    for( size_t i = 0; ( i < uxNumCertificates ) && xResult; i++ )
+    {
+        const PkiObject_t * pxObject = &( pxCertificates[ i ] );
+
+        ullHash = prvFnv1a64( ullHash, &( pxObject->xForm ), sizeof( pxObject->xForm ) );
+
+        switch( pxObject->xForm )
+        {
+            case OBJ_FORM_PEM:
+            case OBJ_FORM_DER:
+                ullHash = prvFnv1a64( ullHash, &( pxObject->uxLen ), sizeof( pxObject->uxLen ) );
+                ullHash = prvFnv1a64( ullHash, pxObject->pucBuffer, pxObject->uxLen );
+                break;
+
+                #ifdef MBEDTLS_TRANSPORT_PKCS11
+                    case OBJ_FORM_PKCS11_LABEL:
+                        ullHash = prvFnv1a64( ullHash, pxObject->pcPkcs11Label,
+                                              strnlen( pxObject->pcPkcs11Label, configTLS_MAX_LABEL_LEN ) );
+                        break;
+                #endif /* MBEDTLS_TRANSPORT_PKCS11 */
+                #ifdef MBEDTLS_TRANSPORT_PSA
+                    case OBJ_FORM_PSA_CRYPTO:
+                        ullHash = prvFnv1a64( ullHash, &( pxObject->xPsaCryptoId ), sizeof( pxObject->xPsaCryptoId ) );
+                        break;
+
+                    case OBJ_FORM_PSA_ITS:
+                    case OBJ_FORM_PSA_PS:
+                        ullHash = prvFnv1a64( ullHash, &( pxObject->xPsaStorageId ), sizeof( pxObject->xPsaStorageId ) );
+                        break;
+                #endif /* MBEDTLS_TRANSPORT_PSA */
+            case OBJ_FORM_NONE:
+            /* Intentional fall through */
+            default:
+                xResult = false;
+                break;
+        }
+    }
+
+    *pullKey = ullHash;
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvFreeChain( PkiCertCacheEntry_t * pxEntry )
+{
+    if( pxEntry->pxChain != NULL )
+    {
+        /* mbedtls_x509_crt_free frees every certificate in the chain except the first */
+        mbedtls_x509_crt_free( pxEntry->pxChain );
+        mbedtls_free( pxEntry->pxChain );
+        pxEntry->pxChain = NULL;
+    }
+
+    pxEntry->uxNumCerts = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static PkiStatus_t prvParseChain( PkiCertCacheEntry_t * pxEntry,
+                                  const PkiObject_t * pxCertificates,
+                                  size_t uxNumCertificates,
+                                  PkiCertCacheFilter_t xFilter,
+                                  void * pvFilterCtx )
+{
+    PkiStatus_t xStatus = PKI_SUCCESS;
+    mbedtls_x509_crt * pxTail = NULL;
+
+    for( size_t uxIdx = 0; uxIdx < uxNumCertificates; uxIdx++ )
+    {
+        mbedtls_x509_crt * pxCert = mbedtls_calloc( 1, sizeof( mbedtls_x509_crt ) );
+
+        if( pxCert == NULL )
+        {
+            LogError( "Failed to allocate memory for mbedtls_x509_crt object." );
+            xStatus = PKI_ERR_NOMEM;
+            break;
+        }
+
+        mbedtls_x509_crt_init( pxCert );
+
+        xStatus = xPkiReadCertificate( pxCert, &( pxCertificates[ uxIdx ] ) );
+
+        if( xStatus != PKI_SUCCESS )
+        {
+            LogError( "Failed to load the certificate at index: %lu.", ( unsigned long ) uxIdx );
+        }
+        else if( ( xFilter != NULL ) &&
+                 ( xFilter( pvFilterCtx, pxCert ) != 0 ) )
+        {
+            xStatus = PKI_ERR_OBJ;
+        }
+        else
+        {
+            /* Append, including any further certificates parsed from the same object */
+            if( pxTail == NULL )
+            {
+                pxEntry->pxChain = pxCert;
+            }
+            else
+            {
+                pxTail->MBEDTLS_PRIVATE( next ) = pxCert;
+            }
+
+            for( pxTail = pxCert; ; pxTail = pxTail->MBEDTLS_PRIVATE( next ) )
+            {
+                pxEntry->uxNumCerts++;
+
+                if( pxTail->MBEDTLS_PRIVATE( next ) == NULL )
+                {
+                    break;
+                }
+            }
+
+            pxCert = NULL;
+        }
+
+        if( pxCert != NULL )
+        {
+            mbedtls_x509_crt_free( pxCert );
+            mbedtls_free( pxCert );
+        }
+
+        if( xStatus == PKI_ERR_NOMEM )
+        {
+            break;
+        }
+    }
+
+    if( xStatus == PKI_ERR_NOMEM )
+    {
+        prvFreeChain( pxEntry );
+    }
+    else if( pxEntry->uxNumCerts == 0 )
+    {
+        xStatus = PKI_ERR_OBJ_PARSING_FAILED;
+    }
+    else
+    {
+        xStatus = PKI_SUCCESS;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Must be called with the cache lock held */
+static PkiCertCacheEntry_t * prvAllocEntry( void )
+{
+    PkiCertCacheEntry_t * pxEntry = NULL;
+
+    for( size_t i = 0; i < PKI_CERT_CACHE_MAX_ENTRIES; i++ )
+    {
+        PkiCertCacheEntry_t * pxCandidate = &( xCacheEntries[ i ] );
+
+        if( !pxCandidate->xInUse )
+        {
+            pxEntry = pxCandidate;
+            break;
+        }
+
+        /* Otherwise evict the least recently used chain that nobody holds */
+        if( ( pxCandidate->ulRefCount == 0 ) &&
+            ( ( pxEntry == NULL ) ||
+              ( ( xTaskGetTickCount() - pxCandidate->xLastUsed ) > ( xTaskGetTickCount() - pxEntry->xLastUsed ) ) ) )
+        {
+            pxEntry = pxCandidate;
+        }
+    }
+
+    if( pxEntry != NULL )
+    {
+        prvFreeChain( pxEntry );
+        ( void ) memset( pxEntry, 0, sizeof( PkiCertCacheEntry_t ) );
+        pxEntry->xCached = true;
+    }
+    else
+    {
+        pxEntry = pvPortMalloc( sizeof( PkiCertCacheEntry_t ) );
+
+        if( pxEntry != NULL )
+        {
+            ( void ) memset( pxEntry, 0, sizeof( PkiCertCacheEntry_t ) );
+            pxEntry->xCached = false;
+        }
+    }
+
+    return pxEntry;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Must be called with the cache lock held */
+static void prvFreeEntry( PkiCertCacheEntry_t * pxEntry )
+{
+    prvFreeChain( pxEntry );
+
+    if( pxEntry->xCached )
+    {
+        ( void ) memset( pxEntry, 0, sizeof( PkiCertCacheEntry_t ) );
+    }
+    else
+    {
+        vPortFree( pxEntry );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+PkiStatus_t xPkiCertCacheAcquire( PkiCertCacheEntry_t ** ppxEntry,
+                                  const PkiObject_t * pxCertificates,
+                                  size_t uxNumCertificates,
+                                  PkiCertCacheFilter_t xFilter,
+                                  void * pvFilterCtx )
+{
+    PkiStatus_t xStatus = PKI_SUCCESS;
+    PkiCertCacheEntry_t * pxEntry = NULL;
+    uint64_t ullKey = 0;
+
+    if( ( ppxEntry == NULL ) ||
+        ( pxCertificates == NULL ) ||
+        ( uxNumCertificates == 0 ) )
+    {
+        xStatus = PKI_ERR_ARG_INVALID;
+    }
+    else if( !prvGetKey( pxCertificates, uxNumCertificates, &ullKey ) )
+    {
+        LogError( "Invalid certificate form specified." );
+        xStatus = PKI_ERR_ARG_INVALID;
+    }
+    else
+    {
+        prvCacheLock();
+
+        for( size_t i = 0; i < PKI_CERT_CACHE_MAX_ENTRIES; i++ )
+        {
+            if( xCacheEntries[ i ].xInUse &&
+                !xCacheEntries[ i ].xStale &&
+                ( xCacheEntries[ i ].ullKey == ullKey ) &&
+                ( xCacheEntries[ i ].uxNumObjects == uxNumCertificates ) )
+            {
+                pxEntry = &( xCacheEntries[ i ] );
+                break;
+            }
+        }
+
+        if( pxEntry != NULL )
+        {
+            pxEntry->ulHits++;
+            ulCacheHits++;
+        }
+        else
+        {
+            pxEntry = prvAllocEntry();
+
+            if( pxEntry == NULL )
+            {
+                xStatus = PKI_ERR_NOMEM;
+            }
+            else
+            {
+                TickType_t xStartTicks = xTaskGetTickCount();
+                size_t uxFreeHeapBefore = xPortGetFreeHeapSize();
+
+                pxEntry->xInUse = true;
+                pxEntry->ullKey = ullKey;
+                pxEntry->uxNumObjects = uxNumCertificates;
+
+                xStatus = prvParseChain( pxEntry, pxCertificates, uxNumCertificates,
+                                         xFilter, pvFilterCtx );
+
+                pxEntry->ulParseTimeMs = ( uint32_t ) ( ( xTaskGetTickCount() - xStartTicks ) * portTICK_PERIOD_MS );
+
+                /* Approximate, other tasks may allocate or free while the chain is parsed */
+                if( uxFreeHeapBefore > xPortGetFreeHeapSize() )
+                {
+                    pxEntry->uxHeapBytes = uxFreeHeapBefore - xPortGetFreeHeapSize();
+                }
+
+                ulCacheMisses++;
+
+                if( xStatus != PKI_SUCCESS )
+                {
+                    prvFreeEntry( pxEntry );
+                    pxEntry = NULL;
+                }
+                else
+                {
+                    LogDebug( "Parsed %lu certificate(s) in %lu ms using %lu bytes of heap.",
+                              ( unsigned long ) pxEntry->uxNumCerts,
+                              ( unsigned long ) pxEntry->ulParseTimeMs,
+                              ( unsigned long ) pxEntry->uxHeapBytes );
+                }
+            }
+        }
+
+        if( pxEntry != NULL )
+        {
+            pxEntry->ulRefCount++;
+            pxEntry->xLastUsed = xTaskGetTickCount();
+        }
+
+        prvCacheUnlock();
+
+        *ppxEntry = pxEntry;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+mbedtls_x509_crt * pxPkiCertCacheGetChain( PkiCertCacheEntry_t * pxEntry )
+{
+    return ( pxEntry != NULL ) ? pxEntry->pxChain : NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+void vPkiCertCacheRelease( PkiCertCacheEntry_t * pxEntry )
+{
+    if( pxEntry != NULL )
+    {
+        prvCacheLock();
+
+        configASSERT( pxEntry->ulRefCount > 0 );
+
+        pxEntry->ulRefCount--;
+
+        if( ( pxEntry->ulRefCount == 0 ) &&
+            ( pxEntry->xStale || !pxEntry->xCached ) )
+        {
+            prvFreeEntry( pxEntry );
+        }
+
+        prvCacheUnlock();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vPkiCertCacheInvalidate( void )
+{
+    prvCacheLock();
+
+    for( size_t i = 0; i < PKI_CERT_CACHE_MAX_ENTRIES; i++ )
+    {
+        PkiCertCacheEntry_t * pxEntry = &( xCacheEntries[ i ] );
+
+        if( pxEntry->xInUse )
+        {
+            if( pxEntry->ulRefCount == 0 )
+            {
+                prvFreeEntry( pxEntry );
+            }
+            else
+            {
+                pxEntry->xStale = true;
+            }
+        }
+    }
+
+    prvCacheUnlock();
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxPkiCertCacheGetInfo( PkiCertCacheInfo_t * pxInfo,
+                              size_t uxMaxEntries,
+                              uint32_t * pulHits,
+                              uint32_t * pulMisses )
+{
+    size_t uxNumEntries = 0;
+
+    prvCacheLock();
+
+    for( size_t i = 0; ( i < PKI_CERT_CACHE_MAX_ENTRIES ) && ( uxNumEntries < uxMaxEntries ); i++ )
+    {
+        const PkiCertCacheEntry_t * pxEntry = &( xCacheEntries[ i ] );
+
+        if( pxEntry->xInUse && ( pxInfo != NULL ) )
+        {
+            pxInfo[ uxNumEntries ].ulRefCount = pxEntry->ulRefCount;
+            pxInfo[ uxNumEntries ].ulHits = pxEntry->ulHits;
+            pxInfo[ uxNumEntries ].ulParseTimeMs = pxEntry->ulParseTimeMs;
+            pxInfo[ uxNumEntries ].uxNumObjects = pxEntry->uxNumObjects;
+            pxInfo[ uxNumEntries ].uxNumCerts = pxEntry->uxNumCerts;
+            pxInfo[ uxNumEntries ].uxHeapBytes = pxEntry->uxHeapBytes;
+            pxInfo[ uxNumEntries ].xStale = pxEntry->xStale;
+            uxNumEntries++;
+        }
+    }
+
+    if( pulHits != NULL )
+    {
+        *pulHits = ulCacheHits;
+    }
+
+    if( pulMisses != NULL )
+    {
+        *pulMisses = ulCacheMisses;
+    }
+
+    prvCacheUnlock();
+
+    return uxNumEntries;
+}
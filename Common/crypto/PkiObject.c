@@ -23,6 +23,7 @@
 #include "tls_transport_config.h"
 #include "PkiObject.h"
 #include "PkiObject_prv.h"
+#include "PkiCertCache.h"
 #include "mbedtls_error_utils.h"
 #include "mbedtls_transport.h"
 
@@ -352,6 +353,12 @@ PkiStatus_t xPkiWriteCertificate( const char * pcCertLabel,
             break;
     }
 
+    /* Chains parsed from the previous certificate must not be handed out anymore */
+    if( xStatus == PKI_SUCCESS )
+    {
+        vPkiCertCacheInvalidate();
+    }
+
     return xStatus;
 }
 
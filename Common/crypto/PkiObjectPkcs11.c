@@ -26,6 +26,7 @@
 #include "logging.h"
 
 #include "FreeRTOS.h"
+#include "semphr.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -69,6 +70,322 @@
 
 /*-----------------------------------------------------------*/
 
+/*
+ * Process wide cache of object handles and values, keyed by label and class.
+ *
+ * Reading an object through the PKCS#11 module reads the whole backing file
+ * from flash on every call, and opening a session per operation discards the
+ * private key parsed by C_SignInit. Lookups for the objects used on each TLS
+ * connection are served from here instead, using a single long-lived session.
+ * Entries are dropped whenever an object with the same label is destroyed.
+ */
+    #ifndef PKCS11_OBJECT_CACHE_ENTRIES
+        #define PKCS11_OBJECT_CACHE_ENTRIES    6
+    #endif
+
+    typedef struct Pkcs11CacheEntry
+    {
+        char pcLabel[ pkcs11configMAX_LABEL_LENGTH + 1 ];
+        CK_OBJECT_CLASS xClass;
+        CK_OBJECT_HANDLE xHandle;
+        unsigned char * pucValue; /*!< Certificate DER, public key DER or private key CKA_EC_POINT */
+        size_t uxValueLen;
+    } Pkcs11CacheEntry_t;
+
+    static Pkcs11CacheEntry_t xObjectCache[ PKCS11_OBJECT_CACHE_ENTRIES ];
+    static size_t uxNextEviction = 0;
+    static CK_SESSION_HANDLE xSharedSession = CK_INVALID_HANDLE;
+    static Pkcs11CacheStats_t xCacheStats = { 0 };
+    static StaticSemaphore_t xCacheMutexStatic;
+    static SemaphoreHandle_t xCacheMutex = NULL;
+
+/*-----------------------------------------------------------*/
+
+    static void prvCacheLock( void )
+    {
+        taskENTER_CRITICAL();
+
+        if( xCacheMutex == NULL )
+        {
+            xCacheMutex = xSemaphoreCreateMutexStatic( &xCacheMutexStatic );
+        }
+
+        taskEXIT_CRITICAL();
+
+        ( void ) xSemaphoreTake( xCacheMutex, portMAX_DELAY );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvCacheUnlock( void )
+    {
+        ( void ) xSemaphoreGive( xCacheMutex );
+    }
+
+/*-----------------------------------------------------------*/
+
+/* Must be called with the cache lock held */
+    static CK_RV prvGetSharedSessionLocked( CK_SESSION_HANDLE * pxSession )
+    {
+        CK_RV xResult = CKR_OK;
+
+        if( xSharedSession == CK_INVALID_HANDLE )
+        {
+            xResult = xInitializePkcs11Session( &xSharedSession );
+
+            if( xResult == CKR_OK )
+            {
+                xCacheStats.ulSessionsOpened++;
+            }
+            else
+            {
+                xSharedSession = CK_INVALID_HANDLE;
+            }
+        }
+
+        *pxSession = xSharedSession;
+
+        return xResult;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static Pkcs11CacheEntry_t * prvCacheFind( const char * pcLabel,
+                                              size_t uxLabelLen,
+                                              CK_OBJECT_CLASS xClass )
+    {
+        Pkcs11CacheEntry_t * pxEntry = NULL;
+
+        for( size_t i = 0; i < PKCS11_OBJECT_CACHE_ENTRIES; i++ )
+        {
+            if( ( xObjectCache[ i ].xHandle != CK_INVALID_HANDLE ) &&
+                ( xObjectCache[ i ].xClass == xClass ) &&
+                ( strnlen( xObjectCache[ i ].pcLabel, pkcs11configMAX_LABEL_LENGTH ) == uxLabelLen ) &&
+                ( strncmp( xObjectCache[ i ].pcLabel, pcLabel, uxLabelLen ) == 0 ) )
+            {
+                pxEntry = &( xObjectCache[ i ] );
+                break;
+            }
+        }
+
+        return pxEntry;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvCacheClearEntry( Pkcs11CacheEntry_t * pxEntry )
+    {
+        if( pxEntry->pucValue != NULL )
+        {
+            vPortFree( pxEntry->pucValue );
+        }
+
+        ( void ) memset( pxEntry, 0, sizeof( Pkcs11CacheEntry_t ) );
+        pxEntry->xHandle = CK_INVALID_HANDLE;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static Pkcs11CacheEntry_t * prvCacheInsert( const char * pcLabel,
+                                                size_t uxLabelLen,
+                                                CK_OBJECT_CLASS xClass,
+                                                CK_OBJECT_HANDLE xHandle )
+    {
+        Pkcs11CacheEntry_t * pxEntry = NULL;
+
+        for( size_t i = 0; i < PKCS11_OBJECT_CACHE_ENTRIES; i++ )
+        {
+            if( xObjectCache[ i ].xHandle == CK_INVALID_HANDLE )
+            {
+                pxEntry = &( xObjectCache[ i ] );
+                break;
+            }
+        }
+
+        /* Evict entries round robin when the cache is full */
+        if( pxEntry == NULL )
+        {
+            pxEntry = &( xObjectCache[ uxNextEviction ] );
+            uxNextEviction = ( uxNextEviction + 1 ) % PKCS11_OBJECT_CACHE_ENTRIES;
+            prvCacheClearEntry( pxEntry );
+        }
+
+        ( void ) strncpy( pxEntry->pcLabel, pcLabel, uxLabelLen );
+        pxEntry->pcLabel[ uxLabelLen ] = '\0';
+        pxEntry->xClass = xClass;
+        pxEntry->xHandle = xHandle;
+
+        return pxEntry;
+    }
+
+/*-----------------------------------------------------------*/
+
+/* Must be called with the cache lock held */
+    static CK_RV prvFindObjectCachedLocked( CK_SESSION_HANDLE xSession,
+                                            const char * pcLabel,
+                                            size_t uxLabelLen,
+                                            CK_OBJECT_CLASS xClass,
+                                            Pkcs11CacheEntry_t ** ppxEntry )
+    {
+        CK_RV xResult = CKR_OK;
+        Pkcs11CacheEntry_t * pxEntry = prvCacheFind( pcLabel, uxLabelLen, xClass );
+
+        if( pxEntry != NULL )
+        {
+            xCacheStats.ulHandleHits++;
+        }
+        else
+        {
+            char pcLabelBuffer[ pkcs11configMAX_LABEL_LENGTH + 1 ] = { 0 };
+            CK_OBJECT_HANDLE xHandle = CK_INVALID_HANDLE;
+
+            ( void ) strncpy( pcLabelBuffer, pcLabel, uxLabelLen );
+
+            xCacheStats.ulHandleMisses++;
+
+            xResult = xFindObjectWithLabelAndClass( xSession,
+                                                    pcLabelBuffer, uxLabelLen,
+                                                    xClass, &xHandle );
+
+            if( ( xResult == CKR_OK ) &&
+                ( xHandle == CK_INVALID_HANDLE ) )
+            {
+                xResult = CKR_OBJECT_HANDLE_INVALID;
+            }
+
+            if( xResult == CKR_OK )
+            {
+                pxEntry = prvCacheInsert( pcLabel, uxLabelLen, xClass, xHandle );
+            }
+        }
+
+        *ppxEntry = pxEntry;
+
+        return xResult;
+    }
+
+/*-----------------------------------------------------------*/
+
+/* Read a single attribute of a cached object into the entry if not already present. */
+    static CK_RV prvCacheReadAttributeLocked( CK_SESSION_HANDLE xSession,
+                                              Pkcs11CacheEntry_t * pxEntry,
+                                              CK_ATTRIBUTE_TYPE xAttribute )
+    {
+        CK_RV xResult = CKR_OK;
+        CK_FUNCTION_LIST_PTR pxFunctionList = NULL;
+        CK_ATTRIBUTE xTemplate = { .type = xAttribute, .pValue = NULL, .ulValueLen = 0 };
+
+        if( pxEntry->pucValue != NULL )
+        {
+            xCacheStats.ulValueHits++;
+        }
+        else
+        {
+            xResult = C_GetFunctionList( &pxFunctionList );
+
+            if( xResult == CKR_OK )
+            {
+                xCacheStats.ulValueReads++;
+                xResult = pxFunctionList->C_GetAttributeValue( xSession, pxEntry->xHandle, &xTemplate, 1 );
+            }
+
+            if( xResult == CKR_OK )
+            {
+                xTemplate.pValue = pvPortMalloc( xTemplate.ulValueLen );
+
+                if( xTemplate.pValue == NULL )
+                {
+                    xResult = CKR_HOST_MEMORY;
+                }
+            }
+
+            if( xResult == CKR_OK )
+            {
+                xCacheStats.ulValueReads++;
+                xResult = pxFunctionList->C_GetAttributeValue( xSession, pxEntry->xHandle, &xTemplate, 1 );
+            }
+
+            if( xResult == CKR_OK )
+            {
+                pxEntry->pucValue = xTemplate.pValue;
+                pxEntry->uxValueLen = xTemplate.ulValueLen;
+            }
+            else if( xTemplate.pValue != NULL )
+            {
+                vPortFree( xTemplate.pValue );
+            }
+        }
+
+        return xResult;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvCacheInvalidate( const char * pcLabel,
+                                    size_t uxLabelLen,
+                                    CK_OBJECT_CLASS xClass )
+    {
+        prvCacheLock();
+
+        Pkcs11CacheEntry_t * pxEntry = prvCacheFind( pcLabel, uxLabelLen, xClass );
+
+        if( pxEntry != NULL )
+        {
+            prvCacheClearEntry( pxEntry );
+        }
+
+        /* The session keeps the key parsed by C_SignInit for as long as the handle matches,
+         * and handles are reused for the same label. Start over with a new session. */
+        if( ( xClass == CKO_PRIVATE_KEY ) &&
+            ( xSharedSession != CK_INVALID_HANDLE ) )
+        {
+            CK_FUNCTION_LIST_PTR pxFunctionList = NULL;
+
+            if( C_GetFunctionList( &pxFunctionList ) == CKR_OK )
+            {
+                ( void ) pxFunctionList->C_CloseSession( xSharedSession );
+            }
+
+            xSharedSession = CK_INVALID_HANDLE;
+        }
+
+        prvCacheUnlock();
+    }
+
+/*-----------------------------------------------------------*/
+
+    CK_RV xPkcs11GetSharedSession( CK_SESSION_HANDLE * pxSession )
+    {
+        CK_RV xResult;
+
+        if( pxSession == NULL )
+        {
+            xResult = CKR_ARGUMENTS_BAD;
+        }
+        else
+        {
+            prvCacheLock();
+            xResult = prvGetSharedSessionLocked( pxSession );
+            prvCacheUnlock();
+        }
+
+        return xResult;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void vPkcs11GetCacheStats( Pkcs11CacheStats_t * pxStats )
+    {
+        if( pxStats != NULL )
+        {
+            prvCacheLock();
+            *pxStats = xCacheStats;
+            prvCacheUnlock();
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
 /*TODO: implement CKA_PUBLIC_KEY_INFO on the backend to make this compliant with the standard and reduce unnecessary memory allocation / deallocation. */
 /* Caller must free the returned buffer */
     static CK_RV xPrvExportPubKeyDer( CK_SESSION_HANDLE xSession,
@@ -189,6 +506,8 @@
             xResult = pxFunctionList->C_DestroyObject( xSessionHandle, xObjectHandle );
         }
 
+        prvCacheInvalidate( pcLabel, uxLabelLen, xClass );
+
         return xResult;
     }
 
@@ -258,10 +577,13 @@
         else
         {
             CK_SESSION_HANDLE xSession = CK_INVALID_HANDLE;
-            CK_OBJECT_HANDLE xPkHandle = CK_INVALID_HANDLE;
+            Pkcs11CacheEntry_t * pxEntry = NULL;
+            CK_KEY_TYPE xKeyType = CKK_EC;
             CK_RV xResult;
 
-            xResult = xInitializePkcs11Session( &xSession );
+            prvCacheLock();
+
+            xResult = prvGetSharedSessionLocked( &xSession );
 
             if( xResult != CKR_OK )
             {
@@ -273,12 +595,10 @@
 
             if( xStatus == PKI_SUCCESS )
             {
-                xResult = xFindObjectWithLabelAndClass( xSession,
-                                                        pcLabelBuffer, uxLabelLen,
-                                                        CKO_PRIVATE_KEY, &xPkHandle );
+                xResult = prvFindObjectCachedLocked( xSession, pcLabelBuffer, uxLabelLen,
+                                                     CKO_PRIVATE_KEY, &pxEntry );
 
-                if( ( xResult != CKR_OK ) ||
-                    ( xPkHandle == CK_INVALID_HANDLE ) )
+                if( xResult != CKR_OK )
                 {
                     LogError( "Failed to find private key with label: %s in PKCS#11 module. CK_RV: %s",
                               pcLabelBuffer, pcPKCS11StrError( xResult ) );
@@ -286,12 +606,52 @@
                 }
             }
 
+            /* Only the public point of an EC key is cached. The private key never leaves the module. */
+            if( ( xStatus == PKI_SUCCESS ) &&
+                ( pxEntry->pucValue == NULL ) )
+            {
+                CK_FUNCTION_LIST_PTR pxFunctionList = NULL;
+                CK_ATTRIBUTE xTemplate = { .type = CKA_KEY_TYPE, .pValue = &xKeyType, .ulValueLen = sizeof( xKeyType ) };
+
+                xResult = C_GetFunctionList( &pxFunctionList );
+
+                if( xResult == CKR_OK )
+                {
+                    xCacheStats.ulValueReads++;
+                    xResult = pxFunctionList->C_GetAttributeValue( xSession, pxEntry->xHandle, &xTemplate, 1 );
+                }
+
+                if( ( xResult == CKR_OK ) &&
+                    ( xKeyType == CKK_EC ) )
+                {
+                    xResult = prvCacheReadAttributeLocked( xSession, pxEntry, CKA_EC_POINT );
+                }
+
+                xStatus = xPrvCkRvToPkiStatus( xResult );
+            }
+            else if( xStatus == PKI_SUCCESS )
+            {
+                xCacheStats.ulValueHits++;
+            }
+
             if( xStatus == PKI_SUCCESS )
             {
-                xResult = xPKCS11_initMbedtlsPkContext( pxPkCtx, xSession, xPkHandle );
+                if( pxEntry->pucValue != NULL )
+                {
+                    xResult = xPKCS11_initMbedtlsPkContextEcPoint( pxPkCtx, xSession, pxEntry->xHandle,
+                                                                   pxEntry->pucValue, pxEntry->uxValueLen );
+                }
+                else
+                {
+                    xResult = xPKCS11_initMbedtlsPkContext( pxPkCtx, xSession, pxEntry->xHandle );
+                }
+
                 xStatus = xPrvCkRvToPkiStatus( xResult );
             }
 
+            prvCacheUnlock();
+
+            /* The shared session is owned by this module and must not be closed by the caller. */
             if( ( xStatus == PKI_SUCCESS ) &&
                 ( pxSessionHandle != NULL ) )
             {
@@ -439,35 +799,51 @@
 
         if( xStatus == PKI_SUCCESS )
         {
-            CK_RV xResult = xInitializePkcs11Session( &xSession );
+            Pkcs11CacheEntry_t * pxEntry = NULL;
+            CK_RV xResult;
+
+            prvCacheLock();
+
+            xResult = prvGetSharedSessionLocked( &xSession );
 
             if( xResult != CKR_OK )
             {
                 LogError( "Failed to initialize PKCS11 session. CK_RV: %s",
                           pcPKCS11StrError( xResult ) );
+            }
+            else
+            {
+                xResult = prvFindObjectCachedLocked( xSession, pcLabel, uxLabelLen,
+                                                     CKO_CERTIFICATE, &pxEntry );
+            }
 
-                xStatus = xPrvCkRvToPkiStatus( xResult );
+            if( xResult == CKR_OK )
+            {
+                xResult = prvCacheReadAttributeLocked( xSession, pxEntry, CKA_VALUE );
             }
-        }
 
-        if( xStatus == PKI_SUCCESS )
-        {
-            int lRslt = 0;
-            mbedtls_x509_crt_init( pxCertificateContext );
+            if( xResult == CKR_OK )
+            {
+                int lRslt = 0;
+                mbedtls_x509_crt_init( pxCertificateContext );
 
-            lRslt = lReadCertificateFromPKCS11( pxCertificateContext,
-                                                xSession,
-                                                pcLabel, uxLabelLen );
+                lRslt = mbedtls_x509_crt_parse( pxCertificateContext,
+                                                pxEntry->pucValue,
+                                                pxEntry->uxValueLen );
 
-            MBEDTLS_LOG_IF_ERROR( lRslt, "Failed to parse certificate(s) from pkcs11 label: %.*s,",
-                                  uxLabelLen, pcLabel );
+                MBEDTLS_LOG_IF_ERROR( lRslt, "Failed to parse certificate(s) from pkcs11 label: %.*s,",
+                                      uxLabelLen, pcLabel );
 
-            xStatus = xPrvMbedtlsErrToPkiStatus( lRslt );
-        }
+                xStatus = xPrvMbedtlsErrToPkiStatus( lRslt );
+            }
+            else
+            {
+                LogError( "Failed to read certificate with label: %.*s from PKCS#11 module. CK_RV: %s",
+                          ( int ) uxLabelLen, pcLabel, pcPKCS11StrError( xResult ) );
+                xStatus = xPrvCkRvToPkiStatus( xResult );
+            }
 
-        if( pxFunctionList && xSession )
-        {
-            pxFunctionList->C_CloseSession( xSession );
+            prvCacheUnlock();
         }
 
         return xStatus;
@@ -588,7 +964,6 @@
 
         CK_SESSION_HANDLE xSession = 0;
         CK_FUNCTION_LIST_PTR pxFunctionList;
-        CK_OBJECT_HANDLE xPubKeyHandle = 0;
 
         uint32_t ulPubKeyLen = 0;
 
@@ -622,36 +997,57 @@
 
         if( xStatus == PKI_SUCCESS )
         {
-            CK_RV xResult = xInitializePkcs11Session( &xSession );
-            xStatus = xPrvCkRvToPkiStatus( xResult );
-        }
+            Pkcs11CacheEntry_t * pxEntry = NULL;
+            CK_RV xResult;
 
-        if( xStatus == PKI_SUCCESS )
-        {
-            CK_RV xResult = xFindObjectWithLabelAndClass( xSession,
-                                                          pcPubKeyLabelBuf,
-                                                          uxPubKeyLabelLen,
-                                                          CKO_PUBLIC_KEY,
-                                                          &xPubKeyHandle );
-            xStatus = xPrvCkRvToPkiStatus( xResult );
-        }
+            prvCacheLock();
 
-        if( xStatus == PKI_SUCCESS )
-        {
-            CK_RV xResult = xPrvExportPubKeyDer( xSession,
-                                                 xPubKeyHandle,
-                                                 ppucPublicKeyDer, &ulPubKeyLen );
-            xStatus = xPrvCkRvToPkiStatus( xResult );
-        }
+            xResult = prvGetSharedSessionLocked( &xSession );
 
-        if( xStatus == PKI_SUCCESS )
-        {
-            *puxPubKeyLen = ( size_t ) ulPubKeyLen;
-        }
+            if( xResult == CKR_OK )
+            {
+                xResult = prvFindObjectCachedLocked( xSession,
+                                                     pcPubKeyLabelBuf,
+                                                     uxPubKeyLabelLen,
+                                                     CKO_PUBLIC_KEY,
+                                                     &pxEntry );
+            }
+
+            if( xResult == CKR_OK )
+            {
+                if( pxEntry->pucValue != NULL )
+                {
+                    xCacheStats.ulValueHits++;
+                }
+                else
+                {
+                    xCacheStats.ulValueReads += 2;
+                    xResult = xPrvExportPubKeyDer( xSession,
+                                                   pxEntry->xHandle,
+                                                   &( pxEntry->pucValue ), &ulPubKeyLen );
+
+                    pxEntry->uxValueLen = ( size_t ) ulPubKeyLen;
+                }
+            }
+
+            /* Hand the caller its own copy so that a later cache eviction cannot free it */
+            if( xResult == CKR_OK )
+            {
+                *ppucPublicKeyDer = pvPortMalloc( pxEntry->uxValueLen );
+
+                if( *ppucPublicKeyDer == NULL )
+                {
+                    xResult = CKR_HOST_MEMORY;
+                }
+                else
+                {
+                    ( void ) memcpy( *ppucPublicKeyDer, pxEntry->pucValue, pxEntry->uxValueLen );
+                    *puxPubKeyLen = pxEntry->uxValueLen;
+                }
+            }
+
+            prvCacheUnlock();
 
-        if( xSession )
-        {
-            CK_RV xResult = pxFunctionList->C_CloseSession( xSession );
             xStatus = xPrvCkRvToPkiStatus( xResult );
         }
 
@@ -47,6 +47,9 @@
     #include "core_pkcs11_config.h"
     #include "core_pkcs11.h"
 
+    #include "FreeRTOS.h"
+    #include "semphr.h"
+
 
     typedef struct P11PkCtx
     {
@@ -76,6 +79,10 @@
 
     static void p11_ecdsa_ctx_free( void * pvCtx );
 
+    static CK_RV prvEcdsaCtxLoadPublic( P11EcDsaCtx_t * pxP11EcDsaCtx,
+                                        const CK_BYTE * pucEcPoint,
+                                        CK_ULONG ulEcPointLen );
+
     static int p11_ecdsa_sign( void * pvCtx,
                                mbedtls_md_type_t xMdAlg,
                                const unsigned char * pucHash,
@@ -88,6 +95,10 @@
 
     static size_t p11_ecdsa_get_bitlen( const void * pvCtx );
 
+/* Serializes C_SignInit / C_Sign pairs, since contexts for the same key share a long-lived session */
+    static StaticSemaphore_t xSignMutexStatic;
+    static SemaphoreHandle_t xSignMutex = NULL;
+
     static int p11_ecdsa_can_do( mbedtls_pk_type_t xType );
 
     static int p11_ecdsa_verify( void * pvCtx,
@@ -1064,17 +1075,12 @@
     {
         CK_RV xResult = CKR_OK;
         P11EcDsaCtx_t * pxP11EcDsaCtx = ( P11EcDsaCtx_t * ) pvCtx;
-        mbedtls_ecdsa_context * pxMbedEcDsaCtx = NULL;
 
         configASSERT( pxFunctionList != NULL );
         configASSERT( xSessionHandle != CK_INVALID_HANDLE );
         configASSERT( xPkHandle != CK_INVALID_HANDLE );
 
-        if( pxP11EcDsaCtx != NULL )
-        {
-            pxMbedEcDsaCtx = &( pxP11EcDsaCtx->xMbedEcDsaCtx );
-        }
-        else
+        if( pxP11EcDsaCtx == NULL )
         {
             xResult = CKR_FUNCTION_FAILED;
         }
@@ -1111,6 +1117,44 @@
                                                            2 );
         }
 
+        if( xResult == CKR_OK )
+        {
+            xResult = prvEcdsaCtxLoadPublic( pxP11EcDsaCtx, pxAttrs[ 1 ].pValue, pxAttrs[ 1 ].ulValueLen );
+        }
+
+        if( pxAttrs[ 0 ].pValue != NULL )
+        {
+            vPortFree( pxAttrs[ 0 ].pValue );
+        }
+
+        if( pxAttrs[ 1 ].pValue != NULL )
+        {
+            vPortFree( pxAttrs[ 1 ].pValue );
+        }
+
+        if( xResult == CKR_OK )
+        {
+            pxP11EcDsaCtx->xP11PkCtx.pxFunctionList = pxFunctionList;
+            pxP11EcDsaCtx->xP11PkCtx.xSessionHandle = xSessionHandle;
+            pxP11EcDsaCtx->xP11PkCtx.xPkHandle = xPkHandle;
+        }
+
+        return xResult;
+    }
+
+    /* Load the P-256 group and the public point from a DER encoded CKA_EC_POINT value */
+    static CK_RV prvEcdsaCtxLoadPublic( P11EcDsaCtx_t * pxP11EcDsaCtx,
+                                        const CK_BYTE * pucEcPoint,
+                                        CK_ULONG ulEcPointLen )
+    {
+        CK_RV xResult = CKR_OK;
+        mbedtls_ecdsa_context * pxMbedEcDsaCtx = &( pxP11EcDsaCtx->xMbedEcDsaCtx );
+
+        if( pucEcPoint == NULL )
+        {
+            xResult = CKR_ATTRIBUTE_VALUE_INVALID;
+        }
+
         /* Parse EC Group */
         if( xResult == CKR_OK )
         {
@@ -1126,8 +1170,8 @@
         /* Parse ECPoint */
         if( xResult == CKR_OK )
         {
-            unsigned char * pucIterator = pxAttrs[ 1 ].pValue;
-            size_t uxLen = pxAttrs[ 1 ].ulValueLen;
+            unsigned char * pucIterator = ( unsigned char * ) pucEcPoint;
+            size_t uxLen = ulEcPointLen;
             int lResult = 0;
 
             lResult = mbedtls_asn1_get_tag( &pucIterator, &( pucIterator[ uxLen ] ), &uxLen, MBEDTLS_ASN1_OCTET_STRING );
@@ -1150,14 +1194,49 @@
             }
         }
 
-        if( pxAttrs[ 0 ].pValue != NULL )
+        return xResult;
+    }
+
+    CK_RV xPKCS11_initMbedtlsPkContextEcPoint( mbedtls_pk_context * pxMbedtlsPkCtx,
+                                               CK_SESSION_HANDLE xSessionHandle,
+                                               CK_OBJECT_HANDLE xPkHandle,
+                                               const CK_BYTE * pucEcPoint,
+                                               CK_ULONG ulEcPointLen )
+    {
+        CK_RV xResult = CKR_OK;
+        CK_FUNCTION_LIST_PTR pxFunctionList = NULL;
+        P11EcDsaCtx_t * pxP11EcDsaCtx = NULL;
+
+        if( ( pxMbedtlsPkCtx == NULL ) || ( pucEcPoint == NULL ) )
         {
-            vPortFree( pxAttrs[ 0 ].pValue );
+            xResult = CKR_ARGUMENTS_BAD;
+        }
+        else if( xSessionHandle == CK_INVALID_HANDLE )
+        {
+            xResult = CKR_SESSION_HANDLE_INVALID;
+        }
+        else if( xPkHandle == CK_INVALID_HANDLE )
+        {
+            xResult = CKR_KEY_HANDLE_INVALID;
+        }
+        else if( ( C_GetFunctionList( &pxFunctionList ) != CKR_OK ) ||
+                 ( pxFunctionList == NULL ) )
+        {
+            xResult = CKR_FUNCTION_FAILED;
         }
+        else
+        {
+            pxP11EcDsaCtx = ( P11EcDsaCtx_t * ) p11_ecdsa_ctx_alloc();
 
-        if( pxAttrs[ 1 ].pValue != NULL )
+            if( pxP11EcDsaCtx == NULL )
+            {
+                xResult = CKR_HOST_MEMORY;
+            }
+        }
+
+        if( xResult == CKR_OK )
         {
-            vPortFree( pxAttrs[ 1 ].pValue );
+            xResult = prvEcdsaCtxLoadPublic( pxP11EcDsaCtx, pucEcPoint, ulEcPointLen );
         }
 
         if( xResult == CKR_OK )
@@ -1165,6 +1244,13 @@
             pxP11EcDsaCtx->xP11PkCtx.pxFunctionList = pxFunctionList;
             pxP11EcDsaCtx->xP11PkCtx.xSessionHandle = xSessionHandle;
             pxP11EcDsaCtx->xP11PkCtx.xPkHandle = xPkHandle;
+
+            pxMbedtlsPkCtx->pk_ctx = pxP11EcDsaCtx;
+            pxMbedtlsPkCtx->pk_info = &mbedtls_pkcs11_pk_ecdsa;
+        }
+        else
+        {
+            p11_ecdsa_ctx_free( pxP11EcDsaCtx );
         }
 
         return xResult;
@@ -1329,6 +1415,17 @@
 
         if( CKR_OK == xResult )
         {
+            taskENTER_CRITICAL();
+
+            if( xSignMutex == NULL )
+            {
+                xSignMutex = xSemaphoreCreateMutexStatic( &xSignMutexStatic );
+            }
+
+            taskEXIT_CRITICAL();
+
+            ( void ) xSemaphoreTake( xSignMutex, portMAX_DELAY );
+
             /* Use the PKCS#11 module to sign. */
             xResult = pxP11Ctx->pxFunctionList->C_SignInit( pxP11Ctx->xSessionHandle,
                                                             &xMech,
@@ -1351,6 +1448,11 @@
             }
         }
 
+        if( pxP11Ctx != NULL )
+        {
+            ( void ) xSemaphoreGive( xSignMutex );
+        }
+
         if( xResult != CKR_OK )
         {
             LogError( "Failed to sign message using PKCS #11 with error code %02X.", xResult );
@@ -0,0 +1,127 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file PkiCertCache.h
+ * @brief Reference counted cache of parsed certificate chains.
+ *
+ * Parsing a certificate costs a read from storage, a PEM to DER conversion
+ * and an X.509 parse. Transport instances that use the same certificates
+ * (MQTT, HTTP and OTA) acquire one shared, read-only mbedtls_x509_crt chain
+ * instead. Chains are keyed by the identity of the PkiObject_t array they
+ * were read from: the content of PEM and DER buffers, the PKCS#11 label or
+ * the PSA id.
+ */
+
+#ifndef _PKI_CERT_CACHE_H_
+#define _PKI_CERT_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "PkiObject.h"
+#include "mbedtls/x509_crt.h"
+
+/* Number of chains kept in the cache. Chains acquired while the cache is full are not cached. */
+#ifndef PKI_CERT_CACHE_MAX_ENTRIES
+    #define PKI_CERT_CACHE_MAX_ENTRIES    4
+#endif
+
+typedef struct PkiCertCacheEntry PkiCertCacheEntry_t;
+
+/**
+ * @brief Called once for each certificate object when a chain is parsed.
+ *
+ * Return 0 to keep the certificate in the chain, or non-zero to drop it.
+ * Since the result is cached with the chain, it must only depend on the
+ * certificate itself.
+ */
+typedef int ( * PkiCertCacheFilter_t )( void * pvCtx,
+                                        mbedtls_x509_crt * pxCert );
+
+typedef struct PkiCertCacheInfo
+{
+    uint32_t ulRefCount;
+    uint32_t ulHits;
+    uint32_t ulParseTimeMs;
+    size_t uxNumObjects;
+    size_t uxNumCerts;
+    size_t uxHeapBytes; /*!< Heap used by the parsed chain, measured around the parse */
+    bool xStale;        /*!< Invalidated, freed once the last reference is released */
+} PkiCertCacheInfo_t;
+
+/**
+ * @brief Get a parsed chain for an array of certificate objects, parsing it if needed.
+ *
+ * Objects that fail to parse or are rejected by xFilter are left out of the chain.
+ *
+ * @param[out] ppxEntry Set to the acquired entry. Release with vPkiCertCacheRelease.
+ * @param[in] pxCertificates Certificate objects making up the chain.
+ * @param[in] uxNumCertificates Number of objects in pxCertificates.
+ * @param[in] xFilter Optional filter applied to each object at parse time.
+ * @param[in] pvFilterCtx Context passed to xFilter.
+ *
+ * @return PKI_SUCCESS, PKI_ERR_ARG_INVALID, PKI_ERR_NOMEM or
+ * PKI_ERR_OBJ_PARSING_FAILED when no certificate could be added to the chain.
+ */
+PkiStatus_t xPkiCertCacheAcquire( PkiCertCacheEntry_t ** ppxEntry,
+                                  const PkiObject_t * pxCertificates,
+                                  size_t uxNumCertificates,
+                                  PkiCertCacheFilter_t xFilter,
+                                  void * pvFilterCtx );
+
+/**
+ * @brief Get the first certificate of an acquired chain.
+ *
+ * The chain is shared and must be treated as read-only.
+ */
+mbedtls_x509_crt * pxPkiCertCacheGetChain( PkiCertCacheEntry_t * pxEntry );
+
+/**
+ * @brief Release a chain returned by xPkiCertCacheAcquire.
+ */
+void vPkiCertCacheRelease( PkiCertCacheEntry_t * pxEntry );
+
+/**
+ * @brief Drop all cached chains. Chains still in use are freed when released.
+ *
+ * Called whenever a stored certificate is written.
+ */
+void vPkiCertCacheInvalidate( void );
+
+/**
+ * @brief Copy information about the cached chains.
+ *
+ * @param[out] pxInfo Array to fill.
+ * @param[in] uxMaxEntries Length of pxInfo.
+ * @param[out] pulHits Total number of acquisitions served from the cache. May be NULL.
+ * @param[out] pulMisses Total number of acquisitions that parsed a chain. May be NULL.
+ *
+ * @return Number of entries written to pxInfo.
+ */
+size_t uxPkiCertCacheGetInfo( PkiCertCacheInfo_t * pxInfo,
+                              size_t uxMaxEntries,
+                              uint32_t * pulHits,
+                              uint32_t * pulMisses );
+
+#endif /* _PKI_CERT_CACHE_H_ */
@@ -171,6 +171,24 @@ PkiStatus_t xPkiGenerateECKeypair( const char * pcPrvKeyLabel,
     PkiStatus_t xPkcs11WritePubKey( const char * pcLabel,
                                     const mbedtls_pk_context * pxPubKeyContext );
 
+    typedef struct Pkcs11CacheStats
+    {
+        uint32_t ulSessionsOpened; /*!< Sessions opened for the shared session */
+        uint32_t ulHandleHits;     /*!< Object handles served from the cache */
+        uint32_t ulHandleMisses;   /*!< Object handles looked up with C_FindObjects */
+        uint32_t ulValueHits;      /*!< Object values served from the cache */
+        uint32_t ulValueReads;     /*!< Attribute reads from the PKCS#11 module */
+    } Pkcs11CacheStats_t;
+
+    /**
+     * @brief Get the long-lived session used to read objects and sign on behalf of TLS connections.
+     *
+     * The session is owned by PkiObjectPkcs11.c and must not be closed by the caller.
+     */
+    CK_RV xPkcs11GetSharedSession( CK_SESSION_HANDLE * pxSession );
+
+    void vPkcs11GetCacheStats( Pkcs11CacheStats_t * pxStats );
+
 #endif /* MBEDTLS_TRANSPORT_PKCS11 */
 
 #ifdef MBEDTLS_TRANSPORT_PSA
@@ -0,0 +1,130 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file dns_cache.h
+ * @brief Resolver cache for the TLS transport.
+ *
+ * Addresses returned by dns_getaddrinfo are kept for DNS_CACHE_TTL_S so
+ * reconnects to the same host skip the lookup. lwip_getaddrinfo does not
+ * report the TTL of the records it returns, so a fixed TTL is used; the
+ * lwIP resolver below honours the record TTLs for lookups that do go out.
+ *
+ * The address of the last successful connection is persisted in the
+ * dns_lkg kvstore entry and returned when a lookup for the same host fails.
+ */
+
+#ifndef _DNS_CACHE_H_
+#define _DNS_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "tls_transport_config.h"
+
+/* Number of hosts kept in the cache */
+#ifndef DNS_CACHE_MAX_ENTRIES
+    #define DNS_CACHE_MAX_ENTRIES    4
+#endif
+
+/* Number of IPv4 addresses kept for each host */
+#ifndef DNS_CACHE_MAX_ADDRS
+    #define DNS_CACHE_MAX_ADDRS    4
+#endif
+
+/* Lifetime of a cache entry in seconds */
+#ifndef DNS_CACHE_TTL_S
+    #define DNS_CACHE_TTL_S    300
+#endif
+
+/* Longer hostnames are resolved without the cache */
+#define DNS_CACHE_MAX_HOSTNAME_LEN    96
+
+typedef enum
+{
+    DNS_CACHE_HIT = 0,  /*!< Served from a live cache entry */
+    DNS_CACHE_RESOLVED, /*!< Looked up and added to the cache */
+    DNS_CACHE_FALLBACK, /*!< Lookup failed, served from an expired entry or the last-known-good address */
+    DNS_CACHE_FAILED    /*!< Lookup failed and no previous address is known */
+} DnsCacheResult_t;
+
+typedef struct
+{
+    uint32_t ulHits;
+    uint32_t ulMisses;    /*!< Lookups sent, including ulExpired */
+    uint32_t ulExpired;   /*!< Lookups sent because the entry had expired */
+    uint32_t ulFailures;  /*!< Lookups that failed */
+    uint32_t ulFallbacks; /*!< Failed lookups answered with a previous address */
+    uint32_t ulEvictions; /*!< Entries dropped after every address failed to connect */
+} DnsCacheStats_t;
+
+typedef struct
+{
+    char pcHostName[ DNS_CACHE_MAX_HOSTNAME_LEN + 1 ];
+    struct in_addr xAddrs[ DNS_CACHE_MAX_ADDRS ];
+    size_t uxNumAddrs;
+    uint32_t ulTtlRemainingS; /*!< 0 once expired */
+} DnsCacheInfo_t;
+
+/**
+ * @brief Resolve a hostname to IPv4 addresses, using the cache when possible.
+ *
+ * @param[in] pcHostName Host to resolve.
+ * @param[out] pxAddrs Array receiving the addresses.
+ * @param[in] uxMaxAddrs Length of pxAddrs.
+ * @param[out] puxNumAddrs Number of addresses written.
+ */
+DnsCacheResult_t xDnsCacheResolve( const char * pcHostName,
+                                   struct in_addr * pxAddrs,
+                                   size_t uxMaxAddrs,
+                                   size_t * puxNumAddrs );
+
+/**
+ * @brief Record a successful connection, updating the last-known-good address.
+ *
+ * The kvstore entry is only written when the address changes.
+ */
+void vDnsCacheReportConnected( const char * pcHostName,
+                               const struct in_addr * pxAddr );
+
+/**
+ * @brief Drop the cache entry for a host after none of its addresses connected.
+ */
+void vDnsCacheReportFailed( const char * pcHostName );
+
+/**
+ * @brief Drop all cache entries. The last-known-good address is kept.
+ */
+void vDnsCacheFlush( void );
+
+void vDnsCacheGetStats( DnsCacheStats_t * pxStats );
+
+/**
+ * @brief Copy the cache entries in use.
+ *
+ * @return Number of entries written to pxInfo.
+ */
+size_t uxDnsCacheGetInfo( DnsCacheInfo_t * pxInfo,
+                          size_t uxMaxEntries );
+
+#endif /* _DNS_CACHE_H_ */
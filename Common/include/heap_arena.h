@@ -0,0 +1,130 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file heap_arena.h
+ * @brief Dedicated heap regions for allocations with a bounded lifetime.
+ *
+ * An arena is a single block taken from the FreeRTOS heap and managed by its
+ * own first fit allocator, so that short lived allocations made while an
+ * arena is bound to a task (for example the mbedTLS handshake) do not
+ * fragment the main heap. Allocations that do not fit in the arena are left
+ * to the caller, which falls back to the main heap.
+ */
+
+#ifndef HEAP_ARENA_H
+#define HEAP_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+
+/* Thread local storage pointer holding the arena bound to a task. Index 0 is used by the lwIP port. */
+#ifndef HEAP_ARENA_TLS_INDEX
+#define HEAP_ARENA_TLS_INDEX    ( 1 )
+#endif
+
+typedef struct HeapArenaBlock HeapArenaBlock_t;
+
+typedef struct HeapArena
+{
+    const char * pcName;
+    uint8_t * pucStart;
+    size_t uxSize;
+    HeapArenaBlock_t * pxFreeList; /*!< Free blocks sorted by address */
+    size_t uxUsed;                 /*!< Bytes in use including block headers */
+    size_t uxPeak;
+    uint32_t ulLive;
+    uint32_t ulAllocs;
+    uint32_t ulFallbacks;          /*!< Allocations that did not fit */
+    bool xOrphaned;                /*!< Deinitialized while blocks were allocated */
+    struct HeapArena * pxNext;
+} HeapArena_t;
+
+typedef struct
+{
+    const char * pcName;
+    size_t uxSize;
+    size_t uxUsed;
+    size_t uxPeak;
+    uint32_t ulLive;
+    uint32_t ulAllocs;
+    uint32_t ulFallbacks;
+} HeapArenaInfo_t;
+
+/**
+ * @brief Allocate the memory for an arena from the FreeRTOS heap and register it.
+ */
+bool xHeapArenaInit( HeapArena_t * pxArena,
+                     const char * pcName,
+                     size_t uxSize );
+
+/**
+ * @brief Unregister an arena and return its memory to the FreeRTOS heap.
+ *
+ * If blocks are still allocated the memory is returned when the last of them is freed.
+ */
+void vHeapArenaDeinit( HeapArena_t * pxArena );
+
+/**
+ * @return A block of at least uxSize bytes, or NULL if none is large enough.
+ */
+void * pvHeapArenaAlloc( HeapArena_t * pxArena,
+                         size_t uxSize );
+
+/**
+ * @brief Free a block if it belongs to a registered arena.
+ *
+ * @return false if pv is not arena memory.
+ */
+bool xHeapArenaFree( void * pv );
+
+/**
+ * @return The usable size of an arena block, or 0 if pv is not arena memory.
+ */
+size_t uxHeapArenaBlockSize( const void * pv );
+
+/**
+ * @brief Return an arena to a single free block and restart its peak.
+ *
+ * @return false, leaving the arena untouched, if blocks are still allocated.
+ */
+bool xHeapArenaReset( HeapArena_t * pxArena );
+
+/**
+ * @brief Bind an arena to the calling task, or unbind with NULL.
+ *
+ * @return The previously bound arena.
+ */
+HeapArena_t * pxHeapArenaBind( HeapArena_t * pxArena );
+
+/**
+ * @return The arena bound to the calling task, or NULL.
+ */
+HeapArena_t * pxHeapArenaGetBound( void );
+
+size_t uxHeapArenaGetInfo( HeapArenaInfo_t * pxInfo,
+                           size_t uxMaxArenas );
+
+#endif /* HEAP_ARENA_H */
@@ -0,0 +1,113 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file heap_pool.h
+ * @brief Segregated size class pools for small mbedTLS allocations.
+ *
+ * Bignum limbs, ASN.1 structures and other small, short lived mbedTLS
+ * allocations are served from fixed size blocks in a static region instead of
+ * the FreeRTOS heap, to keep a handshake from leaving holes in heap_4.
+ * Each size class keeps a LIFO free list protected by a short critical
+ * section. Blocks are cleared when they are freed, which is where secrets
+ * would otherwise linger, so an allocation only has to clear the free list
+ * link. Requests larger than the largest class, or for which all suitable
+ * classes are exhausted, return NULL and are left to the caller.
+ */
+
+#ifndef HEAP_POOL_H
+#define HEAP_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Number of blocks in each size class. A class with 0 blocks is skipped.
+ * The defaults are estimates, not measured handshake peaks. Tune them from
+ * "heaptrack pools" on the board or from tls_pool_bench in Projects/posix_host.
+ */
+#ifndef HEAP_POOL_BLOCKS_16
+#define HEAP_POOL_BLOCKS_16     ( 64 )
+#endif
+
+#ifndef HEAP_POOL_BLOCKS_32
+#define HEAP_POOL_BLOCKS_32     ( 160 )
+#endif
+
+#ifndef HEAP_POOL_BLOCKS_64
+#define HEAP_POOL_BLOCKS_64     ( 96 )
+#endif
+
+#ifndef HEAP_POOL_BLOCKS_128
+#define HEAP_POOL_BLOCKS_128    ( 32 )
+#endif
+
+#ifndef HEAP_POOL_BLOCKS_256
+#define HEAP_POOL_BLOCKS_256    ( 8 )
+#endif
+
+#ifndef HEAP_POOL_BLOCKS_512
+#define HEAP_POOL_BLOCKS_512    ( 4 )
+#endif
+
+#define HEAP_POOL_NUM_CLASSES   ( 6 )
+
+typedef struct
+{
+    size_t uxBlockSize;
+    size_t uxNumBlocks;
+    size_t uxInUse;
+    size_t uxPeak;
+    uint32_t ulAllocs;
+    uint32_t ulExhausted; /*!< Requests for this class served by a larger class or not at all */
+} HeapPoolClassInfo_t;
+
+/**
+ * @return A zeroed block of at least uxSize bytes, or NULL.
+ */
+void * pvHeapPoolAlloc( size_t uxSize );
+
+/**
+ * @brief Clear a block and return it to its size class.
+ *
+ * @return false if pv is not pool memory.
+ */
+bool xHeapPoolFree( void * pv );
+
+/**
+ * @return true if pv points into the pool region.
+ */
+bool xHeapPoolContains( const void * pv );
+
+/**
+ * @return The number of classes written to pxInfo.
+ */
+size_t uxHeapPoolGetInfo( HeapPoolClassInfo_t * pxInfo,
+                          size_t uxMaxClasses );
+
+/**
+ * @brief Reset the peak and exhausted counters.
+ */
+void vHeapPoolResetStats( void );
+
+#endif /* HEAP_POOL_H */
@@ -0,0 +1,194 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file heap_track.h
+ * @brief Allocation tracking for the FreeRTOS heap.
+ *
+ * When configHEAP_TRACKING is enabled the heap_4 traceMALLOC and traceFREE
+ * hooks record bytes in use and the high-water mark per task, per call site
+ * and per subsystem. Call sites are the return address of pvPortMalloc, or
+ * the caller of pvHeapTrackMalloc for allocations made through a wrapper.
+ *
+ * Allocation events can also be recorded to a trace buffer and printed from
+ * the CLI, to be replayed on the host by Projects/posix_host/Src/bench/heap_replay.
+ */
+
+#ifndef HEAP_TRACK_H
+#define HEAP_TRACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifndef configHEAP_TRACKING
+#define configHEAP_TRACKING    0
+#endif
+
+/* Number of live allocations tracked. Must be a power of two. */
+#ifndef HEAP_TRACK_MAX_LIVE
+#define HEAP_TRACK_MAX_LIVE     ( 512 )
+#endif
+
+#ifndef HEAP_TRACK_MAX_TASKS
+#define HEAP_TRACK_MAX_TASKS    ( 24 )
+#endif
+
+#ifndef HEAP_TRACK_MAX_SITES
+#define HEAP_TRACK_MAX_SITES    ( 48 )
+#endif
+
+#define HEAP_TRACK_NAME_LEN     ( 16 )
+
+typedef enum
+{
+    HEAP_SUBSYS_OTHER = 0, /*!< Direct pvPortMalloc calls: kernel objects, tasks and application buffers */
+    HEAP_SUBSYS_TLS,       /*!< mbedtls_platform_calloc */
+    HEAP_SUBSYS_LIBC,      /*!< newlib malloc, used by the IoTConnect library */
+    HEAP_SUBSYS_FS,        /*!< littlefs */
+    HEAP_SUBSYS_KVSTORE,
+    HEAP_SUBSYS_MAX
+} HeapSubsys_t;
+
+typedef struct
+{
+    uint32_t ulCurrent; /*!< Bytes in use, including the heap block header */
+    uint32_t ulPeak;
+    uint32_t ulAllocs;
+    uint32_t ulFrees;
+} HeapTrackCounters_t;
+
+typedef struct
+{
+    char pcName[ HEAP_TRACK_NAME_LEN ];
+    HeapTrackCounters_t xCounters;
+} HeapTrackTaskInfo_t;
+
+typedef struct
+{
+    void * pvSite;
+    HeapSubsys_t xSubsys;
+    HeapTrackCounters_t xCounters;
+} HeapTrackSiteInfo_t;
+
+typedef struct
+{
+    uint32_t ulFailures;  /*!< pvPortMalloc calls that returned NULL */
+    uint32_t ulUntracked; /*!< Allocations not tracked because the live table was full */
+    uint32_t ulLive;
+    HeapTrackCounters_t pxSubsys[ HEAP_SUBSYS_MAX ];
+} HeapTrackStats_t;
+
+typedef struct
+{
+    size_t uxFree;
+    size_t uxLargestFree;
+    size_t uxFreeBlocks;
+    uint32_t ulFragmentationPct; /*!< Share of free space not in the largest free block */
+} HeapFragInfo_t;
+
+/**
+ * @brief Fragmentation of the FreeRTOS heap. Available without configHEAP_TRACKING.
+ */
+void vHeapGetFragInfo( HeapFragInfo_t * pxInfo );
+
+#if ( configHEAP_TRACKING == 1 )
+
+/**
+ * @brief Allocate from the FreeRTOS heap and attribute the block to a subsystem and to the caller.
+ */
+void * pvHeapTrackMalloc( HeapSubsys_t xSubsys,
+                          size_t uxSize );
+
+/* Called from the traceMALLOC and traceFREE hooks in FreeRTOSConfig.h */
+void vHeapTrackMalloc( void * pvAddress,
+                       size_t uxSize,
+                       void * pvCaller );
+
+void vHeapTrackFree( void * pvAddress,
+                     size_t uxSize );
+
+void vHeapTrackGetStats( HeapTrackStats_t * pxStats );
+
+/**
+ * @brief Copy the per task counters, sorted by the order tasks first allocated.
+ *
+ * @return Number of entries written.
+ */
+size_t uxHeapTrackGetTasks( HeapTrackTaskInfo_t * pxTasks,
+                            size_t uxMaxTasks );
+
+size_t uxHeapTrackGetSites( HeapTrackSiteInfo_t * pxSites,
+                            size_t uxMaxSites );
+
+/**
+ * @brief Reset the peak values to the bytes currently in use.
+ */
+void vHeapTrackResetPeaks( void );
+
+/**
+ * @brief Start recording allocation events.
+ *
+ * @param[in] uxMaxEvents Size of the trace buffer, which is taken from the heap.
+ *
+ * @return false if a trace buffer could not be allocated.
+ */
+bool xHeapTrackTraceStart( size_t uxMaxEvents );
+
+void vHeapTrackTraceStop( void );
+
+/**
+ * @brief Free the trace buffer.
+ */
+void vHeapTrackTraceClear( void );
+
+/**
+ * @brief Format the next recorded event as a line of the replay format.
+ *
+ * "m <address> <size> <subsystem>" for an allocation and "f <address>" for a free.
+ *
+ * @param[in,out] puxIndex Index of the event to format. Incremented on return.
+ *
+ * @return Length of the line, or 0 once all recorded events have been formatted.
+ */
+size_t uxHeapTrackTraceFormat( size_t * puxIndex,
+                               char * pcBuffer,
+                               size_t uxBufferLen );
+
+/**
+ * @brief Number of events recorded and dropped because the trace buffer was full.
+ */
+void vHeapTrackTraceGetCounts( size_t * puxRecorded,
+                               size_t * puxDropped );
+
+const char * pcHeapTrackSubsysName( HeapSubsys_t xSubsys );
+
+#else /* configHEAP_TRACKING */
+
+#define pvHeapTrackMalloc( xSubsys, uxSize )    pvPortMalloc( uxSize )
+
+#endif /* configHEAP_TRACKING */
+
+#endif /* HEAP_TRACK_H */
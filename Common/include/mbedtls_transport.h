@@ -31,9 +31,6 @@
 #include "mbedtls_error_utils.h"
 #include "transport_interface.h"
 
-/* socket definitions  */
-#include "lwip/netdb.h"
-
 /* mbed TLS includes. */
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/error.h"
@@ -43,6 +40,7 @@
 #include "mbedtls/x509.h"
 #include "pk_wrap.h"
 
+/* socket definitions, provided by the selected tls_transport_xxx.h header */
 #include "tls_transport_config.h"
 
 #include "PkiObject.h"
@@ -220,6 +218,13 @@ int32_t mbedtls_transport_send( NetworkContext_t * pxNetworkContext,
                                         CK_SESSION_HANDLE xSessionHandle,
                                         CK_OBJECT_HANDLE xPkHandle );
 
+    /* Map an EC private key to a pk context using a previously read CKA_EC_POINT value */
+    CK_RV xPKCS11_initMbedtlsPkContextEcPoint( mbedtls_pk_context * pxMbedtlsPkCtx,
+                                               CK_SESSION_HANDLE xSessionHandle,
+                                               CK_OBJECT_HANDLE xPkHandle,
+                                               const CK_BYTE * pucEcPoint,
+                                               CK_ULONG ulEcPointLen );
+
     const char * pcPKCS11StrError( CK_RV xError );
 
     int lPKCS11RandomCallback( void * pvCtx,
@@ -35,6 +35,7 @@
 #define EVT_MASK_NET_CONNECTED     0x04
 #define EVT_MASK_MQTT_INIT         0x08
 #define EVT_MASK_MQTT_CONNECTED    0x10
+#define EVT_MASK_KVSTORE_READY     0x20
 
 extern EventGroupHandle_t xSystemEvents;
 
@@ -0,0 +1,161 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file trace_ring.h
+ * @brief Cycle counter timestamped trace points for the hot paths.
+ *
+ * Each trace point writes a 16 byte event holding the DWT cycle count, the
+ * current task and a 32 bit argument into a RAM ring buffer, overwriting the
+ * oldest events. Recording is enabled from boot. The "trace dump" CLI command
+ * stops recording and prints the ring base64 encoded, to be converted to the
+ * Chrome trace / Perfetto JSON format by tools/trace_to_json.py.
+ *
+ * The meaning of the argument for each trace point:
+ *
+ * | Id               | Begin                     | End / Instant              |
+ * |------------------|---------------------------|----------------------------|
+ * | AGENT_CMD        | MQTTAgentCommandType_t    | -                          |
+ * | AGENT_ENQUEUE    | -                         | MQTTAgentCommandType_t     |
+ * | SPI_XFER         | TX packets waiting        | ( tx len << 16 ) + rx len  |
+ * | TLS_READ/WRITE   | Requested length          | mbedtls return value       |
+ * | OTA_WRITE_BLOCK  | Image offset              | Bytes written or -1        |
+ * | LFS_READ/PROG    | Flash address             | Length or -1               |
+ * | LFS_ERASE        | Flash address             | 0 or -1                    |
+ */
+
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+
+#ifndef configTRACE_POINTS
+#define configTRACE_POINTS    0
+#endif
+
+/* Number of events in the ring. Must be a power of two. */
+#ifndef TRACE_RING_NUM_EVENTS
+#define TRACE_RING_NUM_EVENTS    ( 512 )
+#endif
+
+#define TRACE_DUMP_MAGIC         "TRC1"
+#define TRACE_DUMP_VERSION       ( 1 )
+
+typedef enum
+{
+    TRACE_ID_AGENT_CMD = 0,  /*!< MQTT agent command or process loop */
+    TRACE_ID_AGENT_ENQUEUE,  /*!< Command queued for the MQTT agent */
+    TRACE_ID_SPI_XFER,       /*!< MXCHIP SPI transaction, from CS low to CS high */
+    TRACE_ID_TLS_READ,       /*!< mbedtls_ssl_read */
+    TRACE_ID_TLS_WRITE,      /*!< mbedtls_ssl_write */
+    TRACE_ID_OTA_WRITE_BLOCK,
+    TRACE_ID_LFS_READ,
+    TRACE_ID_LFS_PROG,
+    TRACE_ID_LFS_ERASE,
+    TRACE_ID_MAX
+} TraceId_t;
+
+typedef enum
+{
+    TRACE_TYPE_BEGIN = 0,
+    TRACE_TYPE_END,
+    TRACE_TYPE_INSTANT
+} TraceType_t;
+
+/* Layout of an event in the ring and in the dump, little endian */
+typedef struct
+{
+    uint32_t ulCycles;
+    uint32_t ulTask;  /*!< Task handle, 0 before the scheduler has started */
+    uint32_t ulArg;
+    uint8_t ucId;
+    uint8_t ucType;
+    uint16_t usReserved;
+} TraceEvent_t;
+
+typedef struct
+{
+    bool xEnabled;
+    uint32_t ulRecorded; /*!< Events recorded since the ring was last cleared */
+    uint32_t ulCapacity;
+} TraceStatus_t;
+
+#if ( configTRACE_POINTS == 1 )
+
+void vTraceRecord( TraceId_t xId,
+                   TraceType_t xType,
+                   uint32_t ulArg );
+
+#define TRACE_BEGIN( xId, ulArg )      vTraceRecord( ( xId ), TRACE_TYPE_BEGIN, ( uint32_t ) ( ulArg ) )
+#define TRACE_END( xId, ulArg )        vTraceRecord( ( xId ), TRACE_TYPE_END, ( uint32_t ) ( ulArg ) )
+#define TRACE_INSTANT( xId, ulArg )    vTraceRecord( ( xId ), TRACE_TYPE_INSTANT, ( uint32_t ) ( ulArg ) )
+
+void vTraceStart( void );
+
+void vTraceStop( void );
+
+/**
+ * @brief Discard all recorded events.
+ */
+void vTraceClear( void );
+
+void vTraceGetStatus( TraceStatus_t * pxStatus );
+
+/**
+ * @brief Stop recording and prepare the dump image.
+ *
+ * The image is a header, the trace point names, the names of the tasks that
+ * currently exist and the events from oldest to newest.
+ *
+ * @return Size of the dump image in bytes, or 0 if the task table could not be allocated.
+ */
+size_t uxTraceDumpBegin( void );
+
+/**
+ * @brief Copy part of the dump image prepared by uxTraceDumpBegin.
+ *
+ * @return Number of bytes copied, 0 past the end of the image.
+ */
+size_t uxTraceDumpRead( size_t uxOffset,
+                        uint8_t * pucBuffer,
+                        size_t uxLen );
+
+/**
+ * @brief Release the dump image and resume recording if it was enabled.
+ */
+void vTraceDumpEnd( void );
+
+const char * pcTraceIdName( TraceId_t xId );
+
+#else /* configTRACE_POINTS */
+
+#define TRACE_BEGIN( xId, ulArg )      ( ( void ) 0 )
+#define TRACE_END( xId, ulArg )        ( ( void ) 0 )
+#define TRACE_INSTANT( xId, ulArg )    ( ( void ) 0 )
+
+#endif /* configTRACE_POINTS */
+
+#endif /* TRACE_RING_H */
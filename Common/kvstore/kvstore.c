@@ -27,10 +27,29 @@
 #include "semphr.h"
 #include "kvstore.h"
 #include "kvstore_prv.h"
+#include "heap_track.h"
 #include <string.h>
+#include <assert.h>
+
+static_assert( CS_NUM_KEYS <= 32, "Subscription key masks are 32 bits wide" );
 
 static SemaphoreHandle_t xKvMutex = NULL;
 
+typedef struct
+{
+    uint32_t ulKeyMask;
+    KVStoreChangeCallback_t xCallback;
+    void * pvContext;
+    TaskHandle_t xTask;
+    UBaseType_t uxIndexToNotify;
+    uint32_t ulNotifyBits;
+} KVStoreSubscription_t;
+
+static KVStoreSubscription_t xSubscriptions[ KV_STORE_MAX_SUBSCRIBERS ] = { 0 };
+
+/* Entries below this count are complete and never change */
+static volatile UBaseType_t uxNumSubscriptions = 0;
+
 #if KV_STORE_CACHE_ENABLE
     #define READ_ENTRY     xprvCopyValueFromCache
     #define WRITE_ENTRY    xprvWriteCacheEntry
@@ -110,6 +129,193 @@ static size_t xReadEntryOrDefault( KVStoreKey_t xKey,
     return xLength;
 }
 
+/* Writers are serialized so that the cache generation seen by views stays consistent */
+static BaseType_t xWriteEntry( KVStoreKey_t xKey,
+                               KVStoreValueType_t xType,
+                               size_t xLength,
+                               const void * pvNewValue )
+{
+    BaseType_t xReturn;
+
+    ( void ) xSemaphoreTake( xKvMutex, portMAX_DELAY );
+
+    xReturn = WRITE_ENTRY( xKey, xType, xLength, pvNewValue );
+
+    ( void ) xSemaphoreGive( xKvMutex );
+
+    return xReturn;
+}
+
+static BaseType_t xAddSubscription( const KVStoreSubscription_t * pxSubscription )
+{
+    BaseType_t xSuccess = pdFALSE;
+
+    if( ( pxSubscription->ulKeyMask != 0 ) &&
+        ( ( pxSubscription->ulKeyMask >> CS_NUM_KEYS ) == 0 ) )
+    {
+        taskENTER_CRITICAL();
+
+        if( uxNumSubscriptions < KV_STORE_MAX_SUBSCRIBERS )
+        {
+            xSubscriptions[ uxNumSubscriptions ] = *pxSubscription;
+            uxNumSubscriptions++;
+            xSuccess = pdTRUE;
+        }
+
+        taskEXIT_CRITICAL();
+    }
+
+    if( xSuccess == pdFALSE )
+    {
+        LogError( "Failed to add a KVStore subscription for key mask 0x%08lx.", pxSubscription->ulKeyMask );
+    }
+
+    return xSuccess;
+}
+
+BaseType_t KVStore_subscribe( uint32_t ulKeyMask,
+                              KVStoreChangeCallback_t xCallback,
+                              void * pvContext )
+{
+    BaseType_t xSuccess = pdFALSE;
+
+    if( xCallback != NULL )
+    {
+        KVStoreSubscription_t xSubscription =
+        {
+            .ulKeyMask = ulKeyMask,
+            .xCallback = xCallback,
+            .pvContext = pvContext
+        };
+
+        xSuccess = xAddSubscription( &xSubscription );
+    }
+
+    return xSuccess;
+}
+
+BaseType_t KVStore_subscribeTask( uint32_t ulKeyMask,
+                                  TaskHandle_t xTask,
+                                  UBaseType_t uxIndexToNotify,
+                                  uint32_t ulNotifyBits )
+{
+    BaseType_t xSuccess = pdFALSE;
+
+    if( ( xTask != NULL ) &&
+        ( uxIndexToNotify < configTASK_NOTIFICATION_ARRAY_ENTRIES ) )
+    {
+        KVStoreSubscription_t xSubscription =
+        {
+            .ulKeyMask       = ulKeyMask,
+            .xTask           = xTask,
+            .uxIndexToNotify = uxIndexToNotify,
+            .ulNotifyBits    = ulNotifyBits
+        };
+
+        xSuccess = xAddSubscription( &xSubscription );
+    }
+
+    return xSuccess;
+}
+
+void vprvLockKvStore( void )
+{
+    ( void ) xSemaphoreTake( xKvMutex, portMAX_DELAY );
+}
+
+void vprvUnlockKvStore( void )
+{
+    ( void ) xSemaphoreGive( xKvMutex );
+}
+
+void vprvNotifyKeysChanged( uint32_t ulChangedKeys )
+{
+    UBaseType_t uxCount = uxNumSubscriptions;
+
+    for( UBaseType_t i = 0; ( i < uxCount ) && ( ulChangedKeys != 0 ); i++ )
+    {
+        const KVStoreSubscription_t * pxSubscription = &( xSubscriptions[ i ] );
+        uint32_t ulKeys = ulChangedKeys & pxSubscription->ulKeyMask;
+
+        if( ulKeys == 0 )
+        {
+            /* Not interested in these keys */
+        }
+        else if( pxSubscription->xCallback != NULL )
+        {
+            pxSubscription->xCallback( ulKeys, pxSubscription->pvContext );
+        }
+        else
+        {
+            ( void ) xTaskNotifyIndexed( pxSubscription->xTask,
+                                         pxSubscription->uxIndexToNotify,
+                                         pxSubscription->ulNotifyBits,
+                                         eSetBits );
+        }
+    }
+}
+
+#if KV_STORE_CACHE_ENABLE
+
+/*
+ * @brief Point a view at the cached value of a key, or at its default value.
+ */
+    static void vGetView( KVStoreKey_t xKey,
+                                KVStoreView_t * pxView )
+    {
+        uint32_t ulGeneration = ulprvGetCacheGeneration();
+
+        /* A write is in progress, wait for the writer to release the mutex */
+        if( ( ulGeneration & 1 ) != 0 )
+        {
+            ( void ) xSemaphoreTake( xKvMutex, portMAX_DELAY );
+            ulGeneration = ulprvGetCacheGeneration();
+            ( void ) xSemaphoreGive( xKvMutex );
+        }
+
+        pxView->ulGeneration = ulGeneration;
+        pxView->pvData = pvprvGetCacheEntryView( xKey, &( pxView->xLength ) );
+
+        if( pxView->pvData == NULL )
+        {
+            pxView->xLength = kvStoreDefaults[ xKey ].length;
+
+            if( pxView->xLength > sizeof( void * ) )
+            {
+                pxView->pvData = kvStoreDefaults[ xKey ].blob;
+            }
+            else
+            {
+                pxView->pvData = &( kvStoreDefaults[ xKey ].u32 );
+            }
+        }
+
+/* TEST_AUTOMATION_INTEGRATION is set in ota_config.h, help us to set attributes easily. */
+        #if ( TEST_AUTOMATION_INTEGRATION == 1 )
+            if( ( xKey == CS_CORE_THING_NAME ) && ( strlen( THING_NAME_DFLT ) > 0 ) )
+            {
+                pxView->pvData = THING_NAME_DFLT;
+                pxView->xLength = sizeof( THING_NAME_DFLT );
+            }
+            else if( ( xKey == CS_CORE_MQTT_ENDPOINT ) && ( strlen( MQTT_ENDPOINT_DFLT ) > 0 ) )
+            {
+                pxView->pvData = MQTT_ENDPOINT_DFLT;
+                pxView->xLength = sizeof( MQTT_ENDPOINT_DFLT );
+            }
+            else if( ( xKey == CS_WIFI_SSID ) && ( strlen( WIFI_SSID_DFLT ) > 0 ) )
+            {
+                pxView->pvData = WIFI_SSID_DFLT;
+                pxView->xLength = sizeof( WIFI_SSID_DFLT );
+            }
+            else if( ( xKey == CS_WIFI_CREDENTIAL ) && ( strlen( WIFI_PASSWORD_DFLT ) > 0 ) )
+            {
+                pxView->pvData = WIFI_PASSWORD_DFLT;
+                pxView->xLength = sizeof( WIFI_PASSWORD_DFLT );
+            }
+        #endif /* if ( TEST_AUTOMATION_INTEGRATION == 1 ) */
+    }
+#endif /* KV_STORE_CACHE_ENABLE */
+
 /*
  * @brief Initialize KeyValue store and load runtime configuration from flash into ram.
  * Must be called after filesystem has been initialized.
@@ -143,7 +349,7 @@ BaseType_t KVStore_setBlob( KVStoreKey_t key,
     if( ( key < CS_NUM_KEYS ) && ( pvNewValue != NULL ) && ( xLength > 0 ) &&
         ( kvStoreDefaults[ key ].type == KV_TYPE_BLOB ) )
     {
-        xReturn = WRITE_ENTRY( key, KV_TYPE_BLOB, xLength, pvNewValue );
+        xReturn = xWriteEntry( key, KV_TYPE_BLOB, xLength, pvNewValue );
     }
 
     return xReturn;
@@ -158,7 +364,7 @@ BaseType_t KVStore_setString( KVStoreKey_t key,
         ( pcNewValue != NULL ) &&
         ( kvStoreDefaults[ key ].type == KV_TYPE_STRING ) )
     {
-        xReturn = WRITE_ENTRY( key, KV_TYPE_STRING, strlen( pcNewValue ) + 1, ( const void * ) pcNewValue );
+        xReturn = xWriteEntry( key, KV_TYPE_STRING, strlen( pcNewValue ) + 1, ( const void * ) pcNewValue );
     }
 
     return xReturn;
@@ -171,7 +377,7 @@ BaseType_t KVStore_setUInt32( KVStoreKey_t key,
 
     if( ( key < CS_NUM_KEYS ) && ( kvStoreDefaults[ key ].type == KV_TYPE_UINT32 ) )
     {
-        xReturn = WRITE_ENTRY( key, KV_TYPE_UINT32, sizeof( uint32_t ), ( const void * ) &ulNewVal );
+        xReturn = xWriteEntry( key, KV_TYPE_UINT32, sizeof( uint32_t ), ( const void * ) &ulNewVal );
     }
 
     return xReturn;
@@ -184,7 +390,7 @@ BaseType_t KVStore_setInt32( KVStoreKey_t key,
 
     if( ( key < CS_NUM_KEYS ) && ( kvStoreDefaults[ key ].type == KV_TYPE_INT32 ) )
     {
-        xReturn = WRITE_ENTRY( key, KV_TYPE_INT32, sizeof( int32_t ), ( const void * ) &lNewVal );
+        xReturn = xWriteEntry( key, KV_TYPE_INT32, sizeof( int32_t ), ( const void * ) &lNewVal );
     }
 
     return xReturn;
@@ -197,7 +403,7 @@ BaseType_t KVStore_setUBase( KVStoreKey_t key,
 
     if( ( key < CS_NUM_KEYS ) && ( kvStoreDefaults[ key ].type == KV_TYPE_UBASE_T ) )
     {
-        xReturn = WRITE_ENTRY( key, KV_TYPE_UBASE_T, sizeof( UBaseType_t ),
+        xReturn = xWriteEntry( key, KV_TYPE_UBASE_T, sizeof( UBaseType_t ),
                                ( const void * ) &uxNewVal );
     }
 
@@ -211,7 +417,7 @@ BaseType_t KVStore_setBase( KVStoreKey_t key,
 
     if( ( key < CS_NUM_KEYS ) && ( kvStoreDefaults[ key ].type == KV_TYPE_BASE_T ) )
     {
-        xReturn = WRITE_ENTRY( key, KV_TYPE_BASE_T, sizeof( BaseType_t ), ( const void * ) &xNewVal );
+        xReturn = xWriteEntry( key, KV_TYPE_BASE_T, sizeof( BaseType_t ), ( const void * ) &xNewVal );
     }
 
     return xReturn;
@@ -291,7 +497,7 @@ void * KVStore_getBlobHeap( KVStoreKey_t key,
 
     if( xLen > 0 )
     {
-        pvBuffer = pvPortMalloc( xLen );
+        pvBuffer = pvHeapTrackMalloc( HEAP_SUBSYS_KVSTORE, xLen );
 
         if( pvBuffer != NULL )
         {
@@ -366,7 +572,7 @@ char * KVStore_getStringHeap( KVStoreKey_t key,
 
     if( xLen > 0 )
     {
-        pcBuffer = pvPortMalloc( xLen );
+        pcBuffer = pvHeapTrackMalloc( HEAP_SUBSYS_KVSTORE, xLen );
 
         if( pcBuffer != NULL )
         {
@@ -392,6 +598,60 @@ char * KVStore_getStringHeap( KVStoreKey_t key,
     return pcBuffer;
 }
 
+BaseType_t KVStore_getBlobView( KVStoreKey_t key,
+                                KVStoreView_t * pxView )
+{
+    BaseType_t xSuccess = pdFALSE;
+
+    if( ( key < CS_NUM_KEYS ) && ( pxView != NULL ) && ( kvStoreDefaults[ key ].type == KV_TYPE_BLOB ) )
+    {
+        #if KV_STORE_CACHE_ENABLE
+            vGetView( key, pxView );
+            xSuccess = pdTRUE;
+        #endif
+    }
+
+    return xSuccess;
+}
+
+BaseType_t KVStore_getStringView( KVStoreKey_t key,
+                                  KVStoreView_t * pxView )
+{
+    BaseType_t xSuccess = pdFALSE;
+
+    if( ( key < CS_NUM_KEYS ) && ( pxView != NULL ) && ( kvStoreDefaults[ key ].type == KV_TYPE_STRING ) )
+    {
+        #if KV_STORE_CACHE_ENABLE
+            vGetView( key, pxView );
+            xSuccess = pdTRUE;
+
+            /* Remove null terminator from returned count */
+            if( pxView->xLength > 0 )
+            {
+                pxView->xLength = pxView->xLength - 1;
+            }
+        #endif
+    }
+
+    return xSuccess;
+}
+
+BaseType_t KVStore_isViewCurrent( const KVStoreView_t * pxView )
+{
+    BaseType_t xCurrent = pdFALSE;
+
+    #if KV_STORE_CACHE_ENABLE
+        if( pxView != NULL )
+        {
+            xCurrent = ( ulprvGetCacheGeneration() == pxView->ulGeneration );
+        }
+    #else
+        ( void ) pxView;
+    #endif
+
+    return xCurrent;
+}
+
 uint32_t KVStore_getUInt32( KVStoreKey_t key,
                             BaseType_t * pxSuccess )
 {
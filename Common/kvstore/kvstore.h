@@ -27,6 +27,7 @@
 #define _KVSTORE_H
 
 #include "FreeRTOS.h"
+#include "task.h"
 #include <stddef.h>
 
 typedef enum KVStoreKey
@@ -116,4 +117,99 @@ KVStoreKey_t kvStringToKey( const char * pcKey );
 
 BaseType_t KVStore_xCommitChanges( void );
 
+typedef struct
+{
+    BaseType_t xFromSnapshot; /* pdTRUE if the cache was loaded from the snapshot instead of key by key */
+    uint32_t ulKeysLoaded;    /* Keys with a value in non-volatile storage */
+    size_t xSnapshotLength;   /* Size of the snapshot loaded or written at boot, 0 if none */
+} KVStoreInitStats_t;
+
+/* How the last call to KVStore_init loaded the cache */
+void KVStore_getInitStats( KVStoreInitStats_t * pxStats );
+
+/* Write a single key to non-volatile storage, leaving other pending changes uncommitted */
+BaseType_t KVStore_xCommitKey( KVStoreKey_t xKey );
+
+/*
+ * Borrowed view of a value in the cache, or of its default if the key is not set.
+ * Getting a view neither allocates nor blocks on writers. The data may be changed
+ * or freed by a later write, so copy or use it immediately, then call
+ * KVStore_isViewCurrent and start over if it returns pdFALSE.
+ */
+typedef struct
+{
+    union
+    {
+        const void * pvData;
+        const char * pcData;
+    };
+    size_t xLength;         /* Bytes for blobs, characters excluding the terminator for strings */
+    uint32_t ulGeneration;
+} KVStoreView_t;
+
+BaseType_t KVStore_getBlobView( KVStoreKey_t key,
+                                KVStoreView_t * pxView );
+
+BaseType_t KVStore_getStringView( KVStoreKey_t key,
+                                  KVStoreView_t * pxView );
+
+/* Returns pdFALSE if any value was written since the view was taken */
+BaseType_t KVStore_isViewCurrent( const KVStoreView_t * pxView );
+
+/* Bit for a key in the masks used by change subscriptions */
+#define KV_STORE_KEY_MASK( key )    ( 1UL << ( key ) )
+
+/*
+ * Called from the committing task once per commit that writes any key in the
+ * subscribed mask, with the mask of those keys. Must not block or use the KVStore setters.
+ */
+typedef void ( * KVStoreChangeCallback_t )( uint32_t ulChangedKeys,
+                                            void * pvContext );
+
+BaseType_t KVStore_subscribe( uint32_t ulKeyMask,
+                              KVStoreChangeCallback_t xCallback,
+                              void * pvContext );
+
+/*
+ * Set ulNotifyBits in notification uxIndexToNotify of xTask after a commit that
+ * writes any key in ulKeyMask. Changes committed before the task waits again
+ * are coalesced into one notification.
+ */
+BaseType_t KVStore_subscribeTask( uint32_t ulKeyMask,
+                                  TaskHandle_t xTask,
+                                  UBaseType_t uxIndexToNotify,
+                                  uint32_t ulNotifyBits );
+
+/*
+ * Typed accessors generated from KV_STORE_KEY_TABLE, such as
+ * KVStore_view_CS_CORE_THING_NAME( &xView ) or KVStore_get_CS_CORE_MQTT_PORT( NULL ).
+ * There is no accessor for a type the key does not have, so a mismatch fails to build.
+ */
+#define KV_ACCESSORS_KV_TYPE_STRING( key )                                                      \
+    static inline BaseType_t KVStore_view_ ## key( KVStoreView_t * pxView )                     \
+    { return KVStore_getStringView( key, pxView ); }                                            \
+    static inline BaseType_t KVStore_set_ ## key( const char * pcNewValue )                     \
+    { return KVStore_setString( key, pcNewValue ); }
+
+#define KV_ACCESSORS_KV_TYPE_BLOB( key )                                                        \
+    static inline BaseType_t KVStore_view_ ## key( KVStoreView_t * pxView )                     \
+    { return KVStore_getBlobView( key, pxView ); }                                              \
+    static inline BaseType_t KVStore_set_ ## key( const void * pvNewValue, size_t xLength )     \
+    { return KVStore_setBlob( key, xLength, pvNewValue ); }
+
+#define KV_ACCESSORS_SCALAR( key, ctype, suffix )                                               \
+    static inline ctype KVStore_get_ ## key( BaseType_t * pxSuccess )                           \
+    { return KVStore_get ## suffix( key, pxSuccess ); }                                         \
+    static inline BaseType_t KVStore_set_ ## key( ctype xNewValue )                             \
+    { return KVStore_set ## suffix( key, xNewValue ); }
+
+#define KV_ACCESSORS_KV_TYPE_UINT32( key )     KV_ACCESSORS_SCALAR( key, uint32_t, UInt32 )
+#define KV_ACCESSORS_KV_TYPE_INT32( key )      KV_ACCESSORS_SCALAR( key, int32_t, Int32 )
+#define KV_ACCESSORS_KV_TYPE_UBASE_T( key )    KV_ACCESSORS_SCALAR( key, UBaseType_t, UBase )
+#define KV_ACCESSORS_KV_TYPE_BASE_T( key )     KV_ACCESSORS_SCALAR( key, BaseType_t, Base )
+
+#define KV_STORE_ACCESSORS( key, name, type, value )    KV_ACCESSORS_ ## type( key )
+
+KV_STORE_KEY_TABLE( KV_STORE_ACCESSORS )
+
 #endif /* _KVSTORE_H */
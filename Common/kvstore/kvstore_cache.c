@@ -25,6 +25,7 @@
 
 #include "FreeRTOS.h"
 #include "kvstore_prv.h"
+#include "heap_track.h"
 #include <string.h>
 
 #if KV_STORE_CACHE_ENABLE
@@ -47,6 +48,59 @@
 
     static KVStoreCacheEntry_t kvStoreCache[ CS_NUM_KEYS ] = { 0 };
 
+    static KVStoreInitStats_t xInitStats = { 0 };
+
+    static volatile uint32_t ulCacheGeneration = 0;
+
+    /* Writers are serialized by xKvMutex, views check the generation instead of taking it */
+    static inline void vBeginCacheChange( void )
+    {
+        ulCacheGeneration++;
+        portMEMORY_BARRIER();
+    }
+
+    static inline void vEndCacheChange( void )
+    {
+        portMEMORY_BARRIER();
+        ulCacheGeneration++;
+    }
+
+    #if KV_STORE_SNAPSHOT_ENABLE
+
+/*
+ * Snapshot payload: a header, one entry per key, then the values, each padded
+ * to 4 bytes. The littlefs layer adds the magic, length and CRC around it.
+ */
+        typedef struct
+        {
+            uint32_t ulKeyMapHash; /* Detects a snapshot written by firmware with a different key map */
+            uint32_t ulNumKeys;
+        } KVStoreSnapshotHeader_t;
+
+        typedef struct
+        {
+            uint32_t ulType;
+            uint32_t ulLength;
+            uint32_t ulOffset; /* From the start of the payload */
+        } KVStoreSnapshotEntry_t;
+
+        #define KVSTORE_SNAPSHOT_DATA_OFFSET    ( sizeof( KVStoreSnapshotHeader_t ) + ( CS_NUM_KEYS * sizeof( KVStoreSnapshotEntry_t ) ) )
+        #define KVSTORE_SNAPSHOT_PAD( x )       ( ( ( x ) + 3UL ) & ~3UL )
+
+        /* Values loaded from the snapshot point into this buffer rather than into individual allocations */
+        static uint8_t * pucSnapshotArena = NULL;
+        static size_t xSnapshotArenaLength = 0;
+
+        static inline BaseType_t xIsInSnapshotArena( const void * pvData )
+        {
+            const uint8_t * pucData = ( const uint8_t * ) pvData;
+
+            return( ( pucSnapshotArena != NULL ) &&
+                    ( pucData >= pucSnapshotArena ) &&
+                    ( pucData < &( pucSnapshotArena[ xSnapshotArenaLength ] ) ) );
+        }
+    #endif /* KV_STORE_SNAPSHOT_ENABLE */
+
 
     static inline void * pvGetDataWritePtr( KVStoreKey_t key )
     {
@@ -90,7 +144,7 @@
     {
         if( xNewLength > sizeof( void * ) )
         {
-            kvStoreCache[ key ].pvData = pvPortMalloc( xNewLength );
+            kvStoreCache[ key ].pvData = pvHeapTrackMalloc( HEAP_SUBSYS_KVSTORE, xNewLength );
             kvStoreCache[ key ].length = xNewLength;
         }
         else
@@ -105,7 +159,13 @@
         /* Check if data is heap allocated > sizeof( void * ) */
         if( kvStoreCache[ key ].length > sizeof( void * ) )
         {
-            vPortFree( kvStoreCache[ key ].pvData );
+            #if KV_STORE_SNAPSHOT_ENABLE
+                if( xIsInSnapshotArena( kvStoreCache[ key ].pvData ) == pdFALSE )
+            #endif
+            {
+                vPortFree( kvStoreCache[ key ].pvData );
+            }
+
             kvStoreCache[ key ].pvData = NULL;
             kvStoreCache[ key ].length = 0;
         }
@@ -131,22 +191,243 @@
         }
     }
 
+    #if KV_STORE_SNAPSHOT_ENABLE && KV_STORE_NVIMPL_ENABLE
+
 /*
- * @brief Initialize the Key Value Store Cache by reading each entry from the storage nvm store.
+ * @brief FNV-1a hash of the key names and their default types.
  */
-    void vprvCacheInit( void )
-    {
-        #if KV_STORE_NVIMPL_ENABLE
-            /* Read from file system into ram */
+        static uint32_t ulKeyMapHash( void )
+        {
+            uint32_t ulHash = 0x811C9DC5UL;
+
+            for( uint32_t i = 0; i < CS_NUM_KEYS; i++ )
+            {
+                const char * pcKey = kvStoreKeyMap[ i ];
+
+                for( size_t j = 0; pcKey[ j ] != '\0'; j++ )
+                {
+                    ulHash = ( ulHash ^ ( uint8_t ) pcKey[ j ] ) * 0x01000193UL;
+                }
+
+                ulHash = ( ulHash ^ ( uint8_t ) kvStoreDefaults[ i ].type ) * 0x01000193UL;
+            }
+
+            return ulHash;
+        }
+
+/*
+ * @brief Check that every entry of a snapshot payload lies within it.
+ */
+        static BaseType_t xValidateSnapshot( const uint8_t * pucSnapshot,
+                                             size_t xLength )
+        {
+            const KVStoreSnapshotHeader_t * pxHeader = ( const KVStoreSnapshotHeader_t * ) pucSnapshot;
+            const KVStoreSnapshotEntry_t * pxEntries = ( const KVStoreSnapshotEntry_t * ) &( pucSnapshot[ sizeof( KVStoreSnapshotHeader_t ) ] );
+            BaseType_t xValid = pdFALSE;
+
+            if( ( xLength >= KVSTORE_SNAPSHOT_DATA_OFFSET ) &&
+                ( pxHeader->ulKeyMapHash == ulKeyMapHash() ) &&
+                ( pxHeader->ulNumKeys == CS_NUM_KEYS ) )
+            {
+                xValid = pdTRUE;
+            }
+
+            for( uint32_t i = 0; ( i < CS_NUM_KEYS ) && ( xValid == pdTRUE ); i++ )
+            {
+                if( pxEntries[ i ].ulType == KV_TYPE_NONE )
+                {
+                    xValid = ( pxEntries[ i ].ulLength == 0 );
+                }
+                else
+                {
+                    xValid = ( ( pxEntries[ i ].ulType < KV_TYPE_LAST ) &&
+                               ( pxEntries[ i ].ulLength > 0 ) &&
+                               ( pxEntries[ i ].ulLength <= KVSTORE_VAL_MAX_LEN ) &&
+                               ( pxEntries[ i ].ulOffset >= KVSTORE_SNAPSHOT_DATA_OFFSET ) &&
+                               ( pxEntries[ i ].ulOffset <= xLength ) &&
+                               ( pxEntries[ i ].ulLength <= ( xLength - pxEntries[ i ].ulOffset ) ) );
+                }
+            }
+
+            return xValid;
+        }
+
+/*
+ * @brief Load the whole cache from the snapshot with a single read.
+ * Values longer than a pointer are left in the snapshot buffer, which is kept.
+ * @return pdTRUE if the snapshot was present, intact and matches the key map.
+ */
+        static BaseType_t xLoadSnapshot( void )
+        {
+            size_t xLength = xprvGetSnapshotLengthFromImpl();
+            uint8_t * pucSnapshot = NULL;
+            BaseType_t xSuccess = pdFALSE;
+
+            if( xLength >= KVSTORE_SNAPSHOT_DATA_OFFSET )
+            {
+                pucSnapshot = pvHeapTrackMalloc( HEAP_SUBSYS_KVSTORE, xLength );
+            }
+
+            if( pucSnapshot != NULL )
+            {
+                xSuccess = xprvReadSnapshotFromImpl( pucSnapshot, xLength );
+            }
+
+            if( xSuccess == pdTRUE )
+            {
+                xSuccess = xValidateSnapshot( pucSnapshot, xLength );
+            }
+
+            if( xSuccess == pdTRUE )
+            {
+                const KVStoreSnapshotEntry_t * pxEntries = ( const KVStoreSnapshotEntry_t * ) &( pucSnapshot[ sizeof( KVStoreSnapshotHeader_t ) ] );
+
+                pucSnapshotArena = pucSnapshot;
+                xSnapshotArenaLength = xLength;
+
+                for( uint32_t i = 0; i < CS_NUM_KEYS; i++ )
+                {
+                    kvStoreCache[ i ].type = ( KVStoreValueType_t ) pxEntries[ i ].ulType;
+                    kvStoreCache[ i ].length = pxEntries[ i ].ulLength;
+
+                    if( pxEntries[ i ].ulLength > sizeof( void * ) )
+                    {
+                        kvStoreCache[ i ].pvData = &( pucSnapshot[ pxEntries[ i ].ulOffset ] );
+                    }
+                    else if( pxEntries[ i ].ulLength > 0 )
+                    {
+                        ( void ) memcpy( &( kvStoreCache[ i ].pvData ), &( pucSnapshot[ pxEntries[ i ].ulOffset ] ),
+                                         pxEntries[ i ].ulLength );
+                    }
+                    else
+                    {
+                        /* Empty */
+                    }
+
+                    if( kvStoreCache[ i ].type != KV_TYPE_NONE )
+                    {
+                        xInitStats.ulKeysLoaded++;
+                    }
+                }
+            }
+            else if( pucSnapshot != NULL )
+            {
+                vPortFree( pucSnapshot );
+            }
+            else
+            {
+                /* Empty */
+            }
+
+            return xSuccess;
+        }
+
+/*
+ * @brief Serialize the whole cache and replace the snapshot with it.
+ * Must only be called when no change is pending, so the snapshot matches the per key files,
+ * and with the store locked, so the values do not change between sizing and copying them.
+ */
+        static BaseType_t xWriteSnapshot( void )
+        {
+            size_t xLength = KVSTORE_SNAPSHOT_DATA_OFFSET;
+            uint8_t * pucSnapshot = NULL;
+            BaseType_t xSuccess = pdFALSE;
+
             for( uint32_t i = 0; i < CS_NUM_KEYS; i++ )
             {
-                /* pvData pointer should be NULL on startup */
-                configASSERT_CONTINUE( kvStoreCache[ i ].pvData == NULL );
+                xLength += KVSTORE_SNAPSHOT_PAD( kvStoreCache[ i ].length );
+            }
+
+            pucSnapshot = pvHeapTrackMalloc( HEAP_SUBSYS_KVSTORE, xLength );
 
+            if( pucSnapshot != NULL )
+            {
+                KVStoreSnapshotHeader_t * pxHeader = ( KVStoreSnapshotHeader_t * ) pucSnapshot;
+                KVStoreSnapshotEntry_t * pxEntries = ( KVStoreSnapshotEntry_t * ) &( pucSnapshot[ sizeof( KVStoreSnapshotHeader_t ) ] );
+                size_t xOffset = KVSTORE_SNAPSHOT_DATA_OFFSET;
+
+                ( void ) memset( pucSnapshot, 0, xLength );
+
+                pxHeader->ulKeyMapHash = ulKeyMapHash();
+                pxHeader->ulNumKeys = CS_NUM_KEYS;
+
+                for( uint32_t i = 0; i < CS_NUM_KEYS; i++ )
+                {
+                    const void * pvData = pvGetDataReadPtr( i );
 
-                kvStoreCache[ i ].xChangePending = pdFALSE;
-                kvStoreCache[ i ].type = KV_TYPE_NONE;
+                    pxEntries[ i ].ulType = kvStoreCache[ i ].type;
+                    pxEntries[ i ].ulLength = ( pvData != NULL ) ? kvStoreCache[ i ].length : 0;
+                    pxEntries[ i ].ulOffset = xOffset;
 
+                    if( pvData != NULL )
+                    {
+                        ( void ) memcpy( &( pucSnapshot[ xOffset ] ), pvData, kvStoreCache[ i ].length );
+                    }
+
+                    xOffset += KVSTORE_SNAPSHOT_PAD( pxEntries[ i ].ulLength );
+                }
+
+                xSuccess = xprvWriteSnapshotToImpl( pucSnapshot, xOffset );
+
+                if( xSuccess == pdTRUE )
+                {
+                    xInitStats.xSnapshotLength = xOffset;
+                }
+
+                vPortFree( pucSnapshot );
+            }
+
+            return xSuccess;
+        }
+
+        static BaseType_t xIsChangePending( void )
+        {
+            BaseType_t xPending = pdFALSE;
+
+            for( uint32_t i = 0; ( i < CS_NUM_KEYS ) && ( xPending == pdFALSE ); i++ )
+            {
+                xPending = kvStoreCache[ i ].xChangePending;
+            }
+
+            return xPending;
+        }
+    #endif /* KV_STORE_SNAPSHOT_ENABLE && KV_STORE_NVIMPL_ENABLE */
+
+/*
+ * @brief Initialize the Key Value Store Cache from the snapshot, or by reading
+ * each entry from the storage nvm store if the snapshot is missing or stale.
+ */
+    void vprvCacheInit( void )
+    {
+        BaseType_t xFromSnapshot = pdFALSE;
+
+        vBeginCacheChange();
+
+        ( void ) memset( &xInitStats, 0, sizeof( xInitStats ) );
+
+        for( uint32_t i = 0; i < CS_NUM_KEYS; i++ )
+        {
+            /* pvData pointer should be NULL on startup */
+            configASSERT_CONTINUE( kvStoreCache[ i ].pvData == NULL );
+
+            kvStoreCache[ i ].xChangePending = pdFALSE;
+            kvStoreCache[ i ].type = KV_TYPE_NONE;
+            kvStoreCache[ i ].length = 0;
+        }
+
+        #if KV_STORE_SNAPSHOT_ENABLE && KV_STORE_NVIMPL_ENABLE
+            xFromSnapshot = xLoadSnapshot();
+
+            if( xFromSnapshot == pdTRUE )
+            {
+                xInitStats.xSnapshotLength = xSnapshotArenaLength;
+            }
+        #endif
+
+        #if KV_STORE_NVIMPL_ENABLE
+            /* Read from file system into ram */
+            for( uint32_t i = 0; ( i < CS_NUM_KEYS ) && ( xFromSnapshot == pdFALSE ); i++ )
+            {
                 size_t xNvLength = xprvGetValueLengthFromImpl( i );
 
                 if( xNvLength > 0 )
@@ -156,10 +437,33 @@
                     KVStoreValueType_t * pxType = &( kvStoreCache[ i ].type );
                     size_t * pxLength = &( kvStoreCache[ i ].length );
 
-                    ( void ) xprvReadValueFromImpl( i, pxType, pxLength, pvGetDataWritePtr( i ), *pxLength );
+                    if( xprvReadValueFromImpl( i, pxType, pxLength, pvGetDataWritePtr( i ), *pxLength ) == pdTRUE )
+                    {
+                        xInitStats.ulKeysLoaded++;
+                    }
                 }
             }
         #endif /* KV_STORE_NVIMPL_ENABLE */
+
+        #if KV_STORE_SNAPSHOT_ENABLE && KV_STORE_NVIMPL_ENABLE
+            if( xFromSnapshot == pdFALSE )
+            {
+                LogInfo( "KVStore snapshot missing or stale, rewriting it from %lu stored keys.", xInitStats.ulKeysLoaded );
+                ( void ) xWriteSnapshot();
+            }
+        #endif
+
+        xInitStats.xFromSnapshot = xFromSnapshot;
+
+        vEndCacheChange();
+    }
+
+    void KVStore_getInitStats( KVStoreInitStats_t * pxStats )
+    {
+        if( pxStats != NULL )
+        {
+            *pxStats = xInitStats;
+        }
     }
 
 /*
@@ -184,6 +488,36 @@
         return kvStoreCache[ xKey ].type;
     }
 
+    uint32_t ulprvGetCacheGeneration( void )
+    {
+        uint32_t ulGeneration = ulCacheGeneration;
+
+        portMEMORY_BARRIER();
+
+        return ulGeneration;
+    }
+
+/*
+ * @brief Get a pointer to the value stored in the cache for a given key.
+ * The caller must check the cache generation after using it.
+ * @param[in] xKey The key to lookup.
+ * @param[out] pxLength Length of the value.
+ * @return pointer to the value or NULL if the key is not set.
+ */
+    const void * pvprvGetCacheEntryView( KVStoreKey_t xKey,
+                                         size_t * pxLength )
+    {
+        const void * pvData = NULL;
+
+        configASSERT( xKey < CS_NUM_KEYS );
+        configASSERT( pxLength != NULL );
+
+        pvData = pvGetDataReadPtr( xKey );
+        *pxLength = ( pvData != NULL ) ? kvStoreCache[ xKey ].length : 0;
+
+        return pvData;
+    }
+
 /*
  * @brief Write a given and / value pair to the cache
  * @param[in] xKey Key to store the provided value in
@@ -202,6 +536,8 @@
         configASSERT( xLength > 0 );
         configASSERT( pvNewValue != NULL );
 
+        vBeginCacheChange();
+
         /* Check if value is not currently set */
         if( kvStoreCache[ xKey ].type == KV_TYPE_NONE )
         {
@@ -244,6 +580,8 @@
             }
         }
 
+        vEndCacheChange();
+
         return pdTRUE;
     }
 
@@ -292,19 +630,104 @@
     BaseType_t KVStore_xCommitChanges( void )
     {
         BaseType_t xSuccess = pdTRUE;
+        uint32_t ulChangedKeys = 0;
+
+        vprvLockKvStore();
 
         #if KV_STORE_NVIMPL_ENABLE
+            #if KV_STORE_SNAPSHOT_ENABLE
+                BaseType_t xChanged = xIsChangePending();
+
+                /* Drop the snapshot first so an interrupted commit falls back to the per key files */
+                if( xChanged == pdTRUE )
+                {
+                    vprvRemoveSnapshotFromImpl();
+                }
+            #endif
+
             for( uint32_t i = 0; i < CS_NUM_KEYS; i++ )
             {
                 if( kvStoreCache[ i ].xChangePending == pdTRUE )
                 {
-                    xSuccess &= xprvWriteValueToImpl( i,
-                                                      kvStoreCache[ i ].type,
-                                                      kvStoreCache[ i ].length,
-                                                      pvGetDataReadPtr( i ) );
+                    BaseType_t xWritten = xprvWriteValueToImpl( i,
+                                                                kvStoreCache[ i ].type,
+                                                                kvStoreCache[ i ].length,
+                                                                pvGetDataReadPtr( i ) );
+
+                    if( xWritten == pdTRUE )
+                    {
+                        kvStoreCache[ i ].xChangePending = pdFALSE;
+                        ulChangedKeys |= KV_STORE_KEY_MASK( i );
+                    }
+
+                    xSuccess &= xWritten;
                 }
             }
+
+            #if KV_STORE_SNAPSHOT_ENABLE
+                if( ( xChanged == pdTRUE ) && ( xSuccess == pdTRUE ) )
+                {
+                    ( void ) xWriteSnapshot();
+                }
+            #endif
         #endif /* if KV_STORE_NVIMPL_ENABLE */
+
+        vprvUnlockKvStore();
+
+        /* One notification per subscriber for everything this commit wrote, outside of the lock so callbacks can read the store */
+        vprvNotifyKeysChanged( ulChangedKeys );
+
+        return xSuccess;
+    }
+
+    BaseType_t KVStore_xCommitKey( KVStoreKey_t xKey )
+    {
+        BaseType_t xSuccess = pdFALSE;
+
+        if( xKey < CS_NUM_KEYS )
+        {
+            BaseType_t xWritten = pdFALSE;
+
+            xSuccess = pdTRUE;
+
+            vprvLockKvStore();
+
+            #if KV_STORE_NVIMPL_ENABLE
+                if( kvStoreCache[ xKey ].xChangePending == pdTRUE )
+                {
+                    #if KV_STORE_SNAPSHOT_ENABLE
+                        vprvRemoveSnapshotFromImpl();
+                    #endif
+
+                    xSuccess = xprvWriteValueToImpl( xKey,
+                                                     kvStoreCache[ xKey ].type,
+                                                     kvStoreCache[ xKey ].length,
+                                                     pvGetDataReadPtr( xKey ) );
+
+                    if( xSuccess == pdTRUE )
+                    {
+                        kvStoreCache[ xKey ].xChangePending = pdFALSE;
+                        xWritten = pdTRUE;
+                    }
+
+                    #if KV_STORE_SNAPSHOT_ENABLE
+                        /* Other uncommitted values must not end up in the snapshot, it is rebuilt at the next boot instead */
+                        if( ( xSuccess == pdTRUE ) && ( xIsChangePending() == pdFALSE ) )
+                        {
+                            ( void ) xWriteSnapshot();
+                        }
+                    #endif
+                }
+            #endif /* if KV_STORE_NVIMPL_ENABLE */
+
+            vprvUnlockKvStore();
+
+            if( xWritten == pdTRUE )
+            {
+                vprvNotifyKeysChanged( KV_STORE_KEY_MASK( xKey ) );
+            }
+        }
+
         return xSuccess;
     }
 
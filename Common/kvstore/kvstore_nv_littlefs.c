@@ -261,6 +261,171 @@
         return( lReturn == LFS_ERR_OK );
     }
 
+    #if KV_STORE_SNAPSHOT_ENABLE
+
+        #define KVSTORE_SNAPSHOT_FILE     KVSTORE_PREFIX ".snapshot"
+        #define KVSTORE_SNAPSHOT_MAGIC    ( 0x3153564BUL ) /* "KVS1" */
+
+        typedef struct
+        {
+            uint32_t ulMagic;
+            uint32_t ulLength; /* Length of the payload following this header */
+            uint32_t ulCrc;    /* lfs_crc of the payload */
+        } KVStoreSnapshotFileHeader_t;
+
+        static lfs_ssize_t lReadSnapshotHeader( lfs_t * pLfsCtx,
+                                                lfs_file_t * pxFile,
+                                                KVStoreSnapshotFileHeader_t * pxHeader )
+        {
+            lfs_ssize_t lReturn = lfs_file_read( pLfsCtx, pxFile, pxHeader, sizeof( KVStoreSnapshotFileHeader_t ) );
+
+            vLfsSSizeToErr( &lReturn, sizeof( KVStoreSnapshotFileHeader_t ) );
+
+            if( ( lReturn == LFS_ERR_OK ) &&
+                ( ( pxHeader->ulMagic != KVSTORE_SNAPSHOT_MAGIC ) ||
+                  ( lfs_file_size( pLfsCtx, pxFile ) != ( lfs_soff_t ) ( sizeof( KVStoreSnapshotFileHeader_t ) + pxHeader->ulLength ) ) ) )
+            {
+                lReturn = LFS_ERR_CORRUPT;
+            }
+
+            return lReturn;
+        }
+
+/*
+ * @brief Get the length of the snapshot payload.
+ * @return length of the payload or 0 if there is no valid looking snapshot.
+ */
+        size_t xprvGetSnapshotLengthFromImpl( void )
+        {
+            lfs_t * pLfsCtx = pxGetDefaultFsCtx();
+            lfs_file_t xFile = { 0 };
+            KVStoreSnapshotFileHeader_t xHeader = { 0 };
+            size_t xLength = 0;
+
+            if( lfs_file_open( pLfsCtx, &xFile, KVSTORE_SNAPSHOT_FILE, LFS_O_RDONLY ) == LFS_ERR_OK )
+            {
+                if( lReadSnapshotHeader( pLfsCtx, &xFile, &xHeader ) == LFS_ERR_OK )
+                {
+                    xLength = xHeader.ulLength;
+                }
+
+                ( void ) lfs_file_close( pLfsCtx, &xFile );
+            }
+
+            return xLength;
+        }
+
+/*
+ * @brief Read the snapshot payload into a buffer of exactly xLength bytes.
+ * @return pdTRUE if the whole payload was read and its CRC matches.
+ */
+        BaseType_t xprvReadSnapshotFromImpl( void * pvBuffer,
+                                             size_t xLength )
+        {
+            lfs_t * pLfsCtx = pxGetDefaultFsCtx();
+            lfs_file_t xFile = { 0 };
+            KVStoreSnapshotFileHeader_t xHeader = { 0 };
+            lfs_ssize_t lReturn = LFS_ERR_INVAL;
+
+            if( pvBuffer != NULL )
+            {
+                lReturn = lfs_file_open( pLfsCtx, &xFile, KVSTORE_SNAPSHOT_FILE, LFS_O_RDONLY );
+            }
+
+            if( lReturn == LFS_ERR_OK )
+            {
+                lReturn = lReadSnapshotHeader( pLfsCtx, &xFile, &xHeader );
+
+                if( ( lReturn == LFS_ERR_OK ) &&
+                    ( xHeader.ulLength != xLength ) )
+                {
+                    lReturn = LFS_ERR_CORRUPT;
+                }
+
+                /* The whole payload in one read */
+                if( lReturn == LFS_ERR_OK )
+                {
+                    lReturn = lfs_file_read( pLfsCtx, &xFile, pvBuffer, xLength );
+                    vLfsSSizeToErr( &lReturn, xLength );
+                }
+
+                if( ( lReturn == LFS_ERR_OK ) &&
+                    ( lfs_crc( 0xFFFFFFFF, pvBuffer, xLength ) != xHeader.ulCrc ) )
+                {
+                    LogWarn( "KVStore snapshot CRC mismatch." );
+                    lReturn = LFS_ERR_CORRUPT;
+                }
+
+                ( void ) lfs_file_close( pLfsCtx, &xFile );
+            }
+
+            return( lReturn == LFS_ERR_OK );
+        }
+
+/*
+ * @brief Replace the snapshot with the given payload.
+ * littlefs only commits the new file contents on close, so a power loss while
+ * writing leaves the previous file in place.
+ */
+        BaseType_t xprvWriteSnapshotToImpl( const void * pvData,
+                                            size_t xLength )
+        {
+            lfs_t * pLfsCtx = pxGetDefaultFsCtx();
+            lfs_file_t xFile = { 0 };
+            lfs_ssize_t lReturn = LFS_ERR_INVAL;
+            BaseType_t xFileOpenFlag = pdFALSE;
+
+            if( pvData != NULL )
+            {
+                lReturn = lfs_file_open( pLfsCtx, &xFile, KVSTORE_SNAPSHOT_FILE, LFS_O_WRONLY | LFS_O_TRUNC | LFS_O_CREAT );
+            }
+
+            if( lReturn == LFS_ERR_OK )
+            {
+                KVStoreSnapshotFileHeader_t xHeader =
+                {
+                    .ulMagic  = KVSTORE_SNAPSHOT_MAGIC,
+                    .ulLength = xLength,
+                    .ulCrc    = lfs_crc( 0xFFFFFFFF, pvData, xLength )
+                };
+
+                xFileOpenFlag = pdTRUE;
+
+                lReturn = lfs_file_write( pLfsCtx, &xFile, &xHeader, sizeof( KVStoreSnapshotFileHeader_t ) );
+                vLfsSSizeToErr( &lReturn, sizeof( KVStoreSnapshotFileHeader_t ) );
+            }
+
+            if( lReturn == LFS_ERR_OK )
+            {
+                lReturn = lfs_file_write( pLfsCtx, &xFile, pvData, xLength );
+                vLfsSSizeToErr( &lReturn, xLength );
+            }
+
+            if( xFileOpenFlag == pdTRUE )
+            {
+                lfs_ssize_t lCloseReturn = lfs_file_close( pLfsCtx, &xFile );
+
+                if( lReturn == LFS_ERR_OK )
+                {
+                    lReturn = lCloseReturn;
+                }
+            }
+
+            if( lReturn != LFS_ERR_OK )
+            {
+                LogError( "Error while writing KVStore snapshot of length %ld bytes: %ld.", xLength, lReturn );
+                ( void ) lfs_remove( pLfsCtx, KVSTORE_SNAPSHOT_FILE );
+            }
+
+            return( lReturn == LFS_ERR_OK );
+        }
+
+        void vprvRemoveSnapshotFromImpl( void )
+        {
+            ( void ) lfs_remove( pxGetDefaultFsCtx(), KVSTORE_SNAPSHOT_FILE );
+        }
+    #endif /* KV_STORE_SNAPSHOT_ENABLE */
+
     void vprvNvImplInit( void )
     {
         /*TODO: Wait for filesystem initialization */
@@ -29,6 +29,16 @@
 #include "kvstore_config_plat.h"
 #include "kvstore.h"
 
+/* Maximum number of change subscriptions, see KVStore_subscribe */
+#ifndef KV_STORE_MAX_SUBSCRIBERS
+    #define KV_STORE_MAX_SUBSCRIBERS    8
+#endif
+
+/* Define KV_STORE_SNAPSHOT_ENABLE to 1 in kvstore_config_plat.h to load the cache from a single snapshot at boot */
+#ifndef KV_STORE_SNAPSHOT_ENABLE
+    #define KV_STORE_SNAPSHOT_ENABLE    0
+#endif
+
 /* Private Types */
 
 typedef struct
@@ -48,6 +58,13 @@ typedef struct
 
 extern const KVStoreDefaultEntry_t kvStoreDefaults[ CS_NUM_KEYS ];
 
+/* Run the change subscriptions for keys written to non-volatile storage by a commit */
+void vprvNotifyKeysChanged( uint32_t ulChangedKeys );
+
+/* Serialize a commit with the setters, so values cannot change while they are written */
+void vprvLockKvStore( void );
+void vprvUnlockKvStore( void );
+
 /* Private functions for NVM implementation */
 
 #if KV_STORE_NVIMPL_ENABLE
@@ -72,6 +89,21 @@ extern const KVStoreDefaultEntry_t kvStoreDefaults[ CS_NUM_KEYS ];
 
     void vprvNvImplInit( void );
 
+    #if KV_STORE_SNAPSHOT_ENABLE
+        /* Length of the snapshot payload, 0 if there is no snapshot */
+        size_t xprvGetSnapshotLengthFromImpl( void );
+
+        /* Read the whole payload, fails if its CRC does not match */
+        BaseType_t xprvReadSnapshotFromImpl( void * pvBuffer,
+                                             size_t xLength );
+
+        BaseType_t xprvWriteSnapshotToImpl( const void * pvData,
+                                            size_t xLength );
+
+        /* Called before writing individual keys, so an interrupted commit leaves no stale snapshot */
+        void vprvRemoveSnapshotFromImpl( void );
+    #endif /* KV_STORE_SNAPSHOT_ENABLE */
+
 #endif /* KV_STORE_NVIMPL_ENABLE */
 
 
@@ -93,6 +125,13 @@ extern const KVStoreDefaultEntry_t kvStoreDefaults[ CS_NUM_KEYS ];
     size_t prvGetCacheEntryLength( KVStoreKey_t xKey );
     KVStoreValueType_t prvGetCacheEntryType( KVStoreKey_t xKey );
 
+    /* Incremented before and after every write to the cache, odd while a write is in progress */
+    uint32_t ulprvGetCacheGeneration( void );
+
+    /* Pointer to the cached value without copying, NULL if the key is not set */
+    const void * pvprvGetCacheEntryView( KVStoreKey_t xKey,
+                                         size_t * pxLength );
+
 #endif /* KV_STORE_CACHE_ENABLE */
 
 #endif /* _KVSTORE_PRV_H */
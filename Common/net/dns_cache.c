@@ -0,0 +1,477 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2022 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "dns_cache.h"
+#include "kvstore.h"
+
+/* Length of "a.b.c.d" */
+#define DNS_CACHE_ADDR_STR_LEN    16
+
+/* kvstore value: "<hostname>,<a.b.c.d>" */
+#define DNS_CACHE_LKG_STR_LEN     ( DNS_CACHE_MAX_HOSTNAME_LEN + 1 + DNS_CACHE_ADDR_STR_LEN )
+
+typedef struct
+{
+    bool xInUse;
+    char pcHostName[ DNS_CACHE_MAX_HOSTNAME_LEN + 1 ];
+    struct in_addr xAddrs[ DNS_CACHE_MAX_ADDRS ];
+    size_t uxNumAddrs;
+    TickType_t xResolvedTicks;
+    TickType_t xLastUsedTicks;
+} DnsCacheEntry_t;
+
+static DnsCacheEntry_t xCacheEntries[ DNS_CACHE_MAX_ENTRIES ] = { 0 };
+static DnsCacheStats_t xCacheStats = { 0 };
+
+/* Last-known-good address, loaded from kvstore on first use */
+static bool xLkgLoaded = false;
+static bool xLkgValid = false;
+static char pcLkgHostName[ DNS_CACHE_MAX_HOSTNAME_LEN + 1 ] = { 0 };
+static struct in_addr xLkgAddr = { 0 };
+
+static StaticSemaphore_t xCacheMutexStatic;
+static SemaphoreHandle_t xCacheMutex = NULL;
+
+/*-----------------------------------------------------------*/
+
+static void prvCacheLock( void )
+{
+    taskENTER_CRITICAL();
+
+    if( xCacheMutex == NULL )
+    {
+        xCacheMutex = xSemaphoreCreateMutexStatic( &xCacheMutexStatic );
+    }
+
+    taskEXIT_CRITICAL();
+
+    ( void ) xSemaphoreTake( xCacheMutex, portMAX_DELAY );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCacheUnlock( void )
+{
+    ( void ) xSemaphoreGive( xCacheMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+static inline bool prvIsExpired( const DnsCacheEntry_t * pxEntry,
+                                 TickType_t xNow )
+{
+    return( ( xNow - pxEntry->xResolvedTicks ) >= pdMS_TO_TICKS( DNS_CACHE_TTL_S * 1000UL ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static DnsCacheEntry_t * prvFindEntryLocked( const char * pcHostName )
+{
+    DnsCacheEntry_t * pxEntry = NULL;
+
+    for( size_t i = 0; i < DNS_CACHE_MAX_ENTRIES; i++ )
+    {
+        if( xCacheEntries[ i ].xInUse &&
+            ( strcmp( xCacheEntries[ i ].pcHostName, pcHostName ) == 0 ) )
+        {
+            pxEntry = &( xCacheEntries[ i ] );
+            break;
+        }
+    }
+
+    return pxEntry;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Return a free entry, or the least recently used one. */
+static DnsCacheEntry_t * prvAllocEntryLocked( void )
+{
+    DnsCacheEntry_t * pxEntry = &( xCacheEntries[ 0 ] );
+
+    for( size_t i = 0; i < DNS_CACHE_MAX_ENTRIES; i++ )
+    {
+        if( !xCacheEntries[ i ].xInUse )
+        {
+            pxEntry = &( xCacheEntries[ i ] );
+            break;
+        }
+        else if( ( xCacheEntries[ i ].xLastUsedTicks - pxEntry->xLastUsedTicks ) > ( portMAX_DELAY / 2 ) )
+        {
+            /* Used longer ago than the current candidate */
+            pxEntry = &( xCacheEntries[ i ] );
+        }
+    }
+
+    return pxEntry;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t prvCopyAddrs( struct in_addr * pxDest,
+                            size_t uxMaxAddrs,
+                            const struct in_addr * pxSrc,
+                            size_t uxNumAddrs )
+{
+    size_t uxCount = ( uxNumAddrs < uxMaxAddrs ) ? uxNumAddrs : uxMaxAddrs;
+
+    ( void ) memcpy( pxDest, pxSrc, uxCount * sizeof( struct in_addr ) );
+
+    return uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvLoadLkgLocked( void )
+{
+    char pcValue[ DNS_CACHE_LKG_STR_LEN + 1 ] = { 0 };
+    char * pcSeparator;
+
+    if( !xLkgLoaded )
+    {
+        xLkgLoaded = true;
+
+        if( KVStore_getString( CS_DNS_LKG_ADDR, pcValue, sizeof( pcValue ) ) > 0 )
+        {
+            pcValue[ DNS_CACHE_LKG_STR_LEN ] = '\0';
+            pcSeparator = strrchr( pcValue, ',' );
+
+            if( ( pcSeparator != NULL ) &&
+                ( ( size_t ) ( pcSeparator - pcValue ) <= DNS_CACHE_MAX_HOSTNAME_LEN ) &&
+                ( inet_aton( pcSeparator + 1, &xLkgAddr ) != 0 ) )
+            {
+                *pcSeparator = '\0';
+                ( void ) strncpy( pcLkgHostName, pcValue, DNS_CACHE_MAX_HOSTNAME_LEN );
+                xLkgValid = true;
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Look up pcHostName without holding the cache lock. */
+static size_t prvLookup( const char * pcHostName,
+                         struct in_addr * pxAddrs,
+                         size_t uxMaxAddrs )
+{
+    const struct addrinfo xAddrInfoHint =
+    {
+        .ai_family   = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+        .ai_protocol = IPPROTO_TCP,
+    };
+    struct addrinfo * pxAddrInfo = NULL;
+    size_t uxNumAddrs = 0;
+    int lError;
+
+    lError = dns_getaddrinfo( pcHostName, NULL, &xAddrInfoHint, &pxAddrInfo );
+
+    if( lError == 0 )
+    {
+        for( struct addrinfo * pxIter = pxAddrInfo;
+             ( pxIter != NULL ) && ( uxNumAddrs < uxMaxAddrs );
+             pxIter = pxIter->ai_next )
+        {
+            if( pxIter->ai_family == AF_INET )
+            {
+                pxAddrs[ uxNumAddrs ] = ( ( struct sockaddr_in * ) pxIter->ai_addr )->sin_addr;
+                uxNumAddrs++;
+            }
+        }
+    }
+
+    if( pxAddrInfo != NULL )
+    {
+        dns_freeaddrinfo( pxAddrInfo );
+    }
+
+    return uxNumAddrs;
+}
+
+/*-----------------------------------------------------------*/
+
+DnsCacheResult_t xDnsCacheResolve( const char * pcHostName,
+                                   struct in_addr * pxAddrs,
+                                   size_t uxMaxAddrs,
+                                   size_t * puxNumAddrs )
+{
+    DnsCacheResult_t xResult = DNS_CACHE_FAILED;
+    DnsCacheEntry_t * pxEntry = NULL;
+    struct in_addr xResolved[ DNS_CACHE_MAX_ADDRS ];
+    size_t uxNumResolved = 0;
+    bool xCacheable;
+
+    if( ( pcHostName == NULL ) ||
+        ( pxAddrs == NULL ) ||
+        ( uxMaxAddrs == 0 ) ||
+        ( puxNumAddrs == NULL ) )
+    {
+        return DNS_CACHE_FAILED;
+    }
+
+    *puxNumAddrs = 0;
+    xCacheable = ( strnlen( pcHostName, DNS_CACHE_MAX_HOSTNAME_LEN + 1 ) <= DNS_CACHE_MAX_HOSTNAME_LEN );
+
+    prvCacheLock();
+
+    if( xCacheable )
+    {
+        TickType_t xNow = xTaskGetTickCount();
+
+        pxEntry = prvFindEntryLocked( pcHostName );
+
+        if( ( pxEntry != NULL ) && !prvIsExpired( pxEntry, xNow ) )
+        {
+            *puxNumAddrs = prvCopyAddrs( pxAddrs, uxMaxAddrs, pxEntry->xAddrs, pxEntry->uxNumAddrs );
+            pxEntry->xLastUsedTicks = xNow;
+            xCacheStats.ulHits++;
+            xResult = DNS_CACHE_HIT;
+        }
+        else if( pxEntry != NULL )
+        {
+            xCacheStats.ulExpired++;
+        }
+    }
+
+    if( xResult != DNS_CACHE_HIT )
+    {
+        xCacheStats.ulMisses++;
+    }
+
+    prvCacheUnlock();
+
+    if( xResult == DNS_CACHE_HIT )
+    {
+        return xResult;
+    }
+
+    /* The lookup can take seconds, so it is done without the lock held */
+    uxNumResolved = prvLookup( pcHostName, xResolved, DNS_CACHE_MAX_ADDRS );
+
+    prvCacheLock();
+
+    if( uxNumResolved > 0 )
+    {
+        *puxNumAddrs = prvCopyAddrs( pxAddrs, uxMaxAddrs, xResolved, uxNumResolved );
+        xResult = DNS_CACHE_RESOLVED;
+
+        if( xCacheable )
+        {
+            pxEntry = prvFindEntryLocked( pcHostName );
+
+            if( pxEntry == NULL )
+            {
+                pxEntry = prvAllocEntryLocked();
+                ( void ) strncpy( pxEntry->pcHostName, pcHostName, DNS_CACHE_MAX_HOSTNAME_LEN );
+                pxEntry->pcHostName[ DNS_CACHE_MAX_HOSTNAME_LEN ] = '\0';
+                pxEntry->xInUse = true;
+            }
+
+            pxEntry->uxNumAddrs = prvCopyAddrs( pxEntry->xAddrs, DNS_CACHE_MAX_ADDRS, xResolved, uxNumResolved );
+            pxEntry->xResolvedTicks = xTaskGetTickCount();
+            pxEntry->xLastUsedTicks = pxEntry->xResolvedTicks;
+        }
+    }
+    else
+    {
+        xCacheStats.ulFailures++;
+
+        if( xCacheable )
+        {
+            pxEntry = prvFindEntryLocked( pcHostName );
+            prvLoadLkgLocked();
+
+            if( pxEntry != NULL )
+            {
+                /* Serve the expired entry rather than nothing */
+                *puxNumAddrs = prvCopyAddrs( pxAddrs, uxMaxAddrs, pxEntry->xAddrs, pxEntry->uxNumAddrs );
+                xResult = DNS_CACHE_FALLBACK;
+            }
+            else if( xLkgValid &&
+                     ( strcmp( pcLkgHostName, pcHostName ) == 0 ) )
+            {
+                pxAddrs[ 0 ] = xLkgAddr;
+                *puxNumAddrs = 1;
+                xResult = DNS_CACHE_FALLBACK;
+            }
+
+            if( xResult == DNS_CACHE_FALLBACK )
+            {
+                xCacheStats.ulFallbacks++;
+                LogWarn( "Failed to resolve %s, using the last known address.", pcHostName );
+            }
+        }
+    }
+
+    prvCacheUnlock();
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+void vDnsCacheReportConnected( const char * pcHostName,
+                               const struct in_addr * pxAddr )
+{
+    char pcValue[ DNS_CACHE_LKG_STR_LEN + 1 ];
+    char pcAddr[ DNS_CACHE_ADDR_STR_LEN ];
+    bool xChanged = false;
+
+    if( ( pcHostName == NULL ) ||
+        ( pxAddr == NULL ) ||
+        ( strnlen( pcHostName, DNS_CACHE_MAX_HOSTNAME_LEN + 1 ) > DNS_CACHE_MAX_HOSTNAME_LEN ) )
+    {
+        return;
+    }
+
+    prvCacheLock();
+
+    prvLoadLkgLocked();
+
+    if( !xLkgValid ||
+        ( xLkgAddr.s_addr != pxAddr->s_addr ) ||
+        ( strcmp( pcLkgHostName, pcHostName ) != 0 ) )
+    {
+        ( void ) strncpy( pcLkgHostName, pcHostName, DNS_CACHE_MAX_HOSTNAME_LEN );
+        pcLkgHostName[ DNS_CACHE_MAX_HOSTNAME_LEN ] = '\0';
+        xLkgAddr = *pxAddr;
+        xLkgValid = true;
+        xChanged = true;
+    }
+
+    prvCacheUnlock();
+
+    /* Only write flash when the address changes */
+    if( xChanged )
+    {
+        ( void ) inet_ntoa_r( *pxAddr, pcAddr, sizeof( pcAddr ) );
+        ( void ) snprintf( pcValue, sizeof( pcValue ), "%s,%s", pcHostName, pcAddr );
+
+        if( ( KVStore_setString( CS_DNS_LKG_ADDR, pcValue ) != pdTRUE ) ||
+            ( KVStore_xCommitKey( CS_DNS_LKG_ADDR ) != pdTRUE ) )
+        {
+            LogWarn( "Failed to store the last known address for %s.", pcHostName );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vDnsCacheReportFailed( const char * pcHostName )
+{
+    DnsCacheEntry_t * pxEntry;
+
+    if( pcHostName != NULL )
+    {
+        prvCacheLock();
+
+        pxEntry = prvFindEntryLocked( pcHostName );
+
+        if( pxEntry != NULL )
+        {
+            ( void ) memset( pxEntry, 0, sizeof( DnsCacheEntry_t ) );
+            xCacheStats.ulEvictions++;
+        }
+
+        prvCacheUnlock();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vDnsCacheFlush( void )
+{
+    prvCacheLock();
+
+    ( void ) memset( xCacheEntries, 0, sizeof( xCacheEntries ) );
+
+    prvCacheUnlock();
+}
+
+/*-----------------------------------------------------------*/
+
+void vDnsCacheGetStats( DnsCacheStats_t * pxStats )
+{
+    if( pxStats != NULL )
+    {
+        prvCacheLock();
+
+        *pxStats = xCacheStats;
+
+        prvCacheUnlock();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxDnsCacheGetInfo( DnsCacheInfo_t * pxInfo,
+                          size_t uxMaxEntries )
+{
+    size_t uxCount = 0;
+
+    if( pxInfo != NULL )
+    {
+        TickType_t xNow = xTaskGetTickCount();
+
+        prvCacheLock();
+
+        for( size_t i = 0; ( i < DNS_CACHE_MAX_ENTRIES ) && ( uxCount < uxMaxEntries ); i++ )
+        {
+            const DnsCacheEntry_t * pxEntry = &( xCacheEntries[ i ] );
+
+            if( pxEntry->xInUse )
+            {
+                ( void ) memcpy( pxInfo[ uxCount ].pcHostName, pxEntry->pcHostName, sizeof( pxEntry->pcHostName ) );
+                pxInfo[ uxCount ].uxNumAddrs = prvCopyAddrs( pxInfo[ uxCount ].xAddrs, DNS_CACHE_MAX_ADDRS,
+                                                             pxEntry->xAddrs, pxEntry->uxNumAddrs );
+
+                if( prvIsExpired( pxEntry, xNow ) )
+                {
+                    pxInfo[ uxCount ].ulTtlRemainingS = 0;
+                }
+                else
+                {
+                    pxInfo[ uxCount ].ulTtlRemainingS = DNS_CACHE_TTL_S -
+                                                        ( ( xNow - pxEntry->xResolvedTicks ) * portTICK_PERIOD_MS / 1000UL );
+                }
+
+                uxCount++;
+            }
+        }
+
+        prvCacheUnlock();
+    }
+
+    return uxCount;
+}
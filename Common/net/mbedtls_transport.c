@@ -33,10 +33,15 @@
 #define MBEDTLS_ALLOW_PRIVATE_ACCESS
 
 #include "mbedtls_transport.h"
+#include "PkiCertCache.h"
+#include "dns_cache.h"
+#include "heap_arena.h"
+#include "trace_ring.h"
 #include <string.h>
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 
 
 /* mbedTLS includes. */
@@ -56,6 +61,15 @@
 
 #define MBEDTLS_DEBUG_THRESHOLD    1
 
+/*
+ * Size of the arena holding the allocations made during the TLS handshake, reserved
+ * for the lifetime of each TLS context. 0 disables the arena. When enabling it, size
+ * it from the peak reported by "heaptrack arenas" after a few handshakes.
+ */
+#ifndef MBEDTLS_TRANSPORT_ARENA_SIZE
+#define MBEDTLS_TRANSPORT_ARENA_SIZE    ( 0 )
+#endif
+
 #ifdef MBEDTLS_TRANSPORT_PKCS11
     #include "core_pkcs11_config.h"
     #include "core_pkcs11.h"
@@ -85,13 +99,20 @@ typedef struct TLSContext
     mbedtls_ssl_config xSslConfig;
     mbedtls_ssl_context xSslCtx;
 
-    /* Certificates */
-    mbedtls_x509_crt xRootCaChain;
-    mbedtls_x509_crt xClientCert;
+    /* Certificates, shared with other contexts through the certificate cache */
+    PkiCertCacheEntry_t * pxRootCaChain;
+    PkiCertCacheEntry_t * pxClientCert;
 
     /* Private Key */
     mbedtls_pk_context xPkCtx;
 
+    /* Address of the last successful connection, tried first on reconnect */
+    struct sockaddr_in xLastAddr;
+    bool xLastAddrValid;
+
+    /* Handshake and session allocations, released by mbedtls_ssl_session_reset */
+    HeapArena_t xArena;
+
     #ifdef MBEDTLS_TRANSPORT_PKCS11
         CK_SESSION_HANDLE xP11SessionHandle;
     #endif /* MBEDTLS_TRANSPORT_PKCS11 */
@@ -477,8 +498,8 @@ NetworkContext_t * mbedtls_transport_allocate( void )
         mbedtls_ssl_config_init( &( pxTLSCtx->xSslConfig ) );
         mbedtls_ssl_init( &( pxTLSCtx->xSslCtx ) );
 
-        mbedtls_x509_crt_init( &( pxTLSCtx->xClientCert ) );
-        mbedtls_x509_crt_init( &( pxTLSCtx->xRootCaChain ) );
+        pxTLSCtx->pxClientCert = NULL;
+        pxTLSCtx->pxRootCaChain = NULL;
         mbedtls_pk_init( &( pxTLSCtx->xPkCtx ) );
 
         #ifdef MBEDTLS_TRANSPORT_PKCS11
@@ -491,6 +512,12 @@ NetworkContext_t * mbedtls_transport_allocate( void )
             mbedtls_ctr_drbg_init( &( pxTLSCtx->xCtrDrbgCtx ) );
         #endif /* TRANSPORT_USE_CTR_DRBG */
 
+        if( ( MBEDTLS_TRANSPORT_ARENA_SIZE > 0 ) &&
+            ( xHeapArenaInit( &( pxTLSCtx->xArena ), "tls", MBEDTLS_TRANSPORT_ARENA_SIZE ) == false ) )
+        {
+            LogWarn( "Failed to allocate the TLS arena, handshakes will use the main heap." );
+        }
+
         #ifdef MBEDTLS_THREADING_ALT
             mbedtls_platform_threading_init();
         #endif /* MBEDTLS_THREADING_ALT */
@@ -516,21 +543,15 @@ void mbedtls_transport_free( NetworkContext_t * pxNetworkContext )
 
         mbedtls_ssl_config_free( &( pxTLSCtx->xSslConfig ) );
         mbedtls_ssl_free( &( pxTLSCtx->xSslCtx ) );
-        mbedtls_x509_crt_free( &( pxTLSCtx->xRootCaChain ) );
-        mbedtls_x509_crt_free( &( pxTLSCtx->xClientCert ) );
+        vPkiCertCacheRelease( pxTLSCtx->pxRootCaChain );
+        pxTLSCtx->pxRootCaChain = NULL;
+        vPkiCertCacheRelease( pxTLSCtx->pxClientCert );
+        pxTLSCtx->pxClientCert = NULL;
         mbedtls_pk_free( &( pxTLSCtx->xPkCtx ) );
 
         #ifdef MBEDTLS_TRANSPORT_PKCS11
-            if( pxTLSCtx->xP11SessionHandle != CK_INVALID_HANDLE )
-            {
-                CK_FUNCTION_LIST_PTR pxFunctionList = NULL;
-
-                if( ( C_GetFunctionList( &pxFunctionList ) == CKR_OK ) &&
-                    ( pxFunctionList->C_CloseSession != NULL ) )
-                {
-                    pxFunctionList->C_CloseSession( pxTLSCtx->xP11SessionHandle );
-                }
-            }
+            /* xP11SessionHandle is the shared session owned by PkiObjectPkcs11.c, which stays open. */
+            pxTLSCtx->xP11SessionHandle = CK_INVALID_HANDLE;
         #endif /* MBEDTLS_TRANSPORT_PKCS11 */
 
         #ifdef TRANSPORT_USE_CTR_DRBG
@@ -538,12 +559,38 @@ void mbedtls_transport_free( NetworkContext_t * pxNetworkContext )
             mbedtls_ctr_drbg_free( &( pxTLSCtx->xCtrDrbgCtx ) );
         #endif /* TRANSPORT_USE_CTR_DRBG */
 
+        vHeapArenaDeinit( &( pxTLSCtx->xArena ) );
+
         vPortFree( ( void * ) pxTLSCtx );
     }
 }
 
 /*-----------------------------------------------------------*/
 
+/* Called after mbedtls_ssl_session_reset, once all connection state should have been released */
+static void prvResetArena( TLSContext_t * pxTLSCtx )
+{
+    if( ( pxTLSCtx != NULL ) &&
+        ( pxTLSCtx->xArena.pucStart != NULL ) )
+    {
+        LogDebug( "Network connection %p: TLS arena peak %lu of %lu bytes, %lu fallbacks.",
+                  pxTLSCtx,
+                  ( unsigned long ) pxTLSCtx->xArena.uxPeak,
+                  ( unsigned long ) pxTLSCtx->xArena.uxSize,
+                  ( unsigned long ) pxTLSCtx->xArena.ulFallbacks );
+
+        if( xHeapArenaReset( &( pxTLSCtx->xArena ) ) == false )
+        {
+            /* Allocations that outlive the connection stay where they are until freed. */
+            LogWarn( "Network connection %p: %lu TLS arena blocks still allocated after reset.",
+                     pxTLSCtx,
+                     ( unsigned long ) pxTLSCtx->xArena.ulLive );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 static int lValidateCertByProfile( TLSContext_t * pxTLSCtx,
                                    mbedtls_x509_crt * pxCert )
 {
@@ -619,17 +666,16 @@ static TlsTransportStatus_t xConfigureCertificateAuth( TLSContext_t * pxTLSCtx,
     configASSERT( pxPrivateKey );
     configASSERT( pxClientCert );
 
-    pxCertCtx = &( pxTLSCtx->xClientCert );
     pxPkCtx = &( pxTLSCtx->xPkCtx );
 
     /* Reset pk and certificate contexts if this is a reconfiguration */
     if( pxTLSCtx->xConnectionState == STATE_CONFIGURED )
     {
         mbedtls_pk_free( pxPkCtx );
-        mbedtls_x509_crt_free( pxCertCtx );
+        vPkiCertCacheRelease( pxTLSCtx->pxClientCert );
 
         mbedtls_pk_init( pxPkCtx );
-        mbedtls_x509_crt_init( pxCertCtx );
+        pxTLSCtx->pxClientCert = NULL;
     }
 
     configASSERT( pxTLSCtx->xSslConfig.f_rng );
@@ -644,7 +690,7 @@ static TlsTransportStatus_t xConfigureCertificateAuth( TLSContext_t * pxTLSCtx,
     }
     else
     {
-        xStatus = xPkiReadCertificate( pxCertCtx, pxClientCert );
+        xStatus = xPkiCertCacheAcquire( &( pxTLSCtx->pxClientCert ), pxClientCert, 1, NULL, NULL );
 
         if( xStatus != TLS_TRANSPORT_SUCCESS )
         {
@@ -652,6 +698,7 @@ static TlsTransportStatus_t xConfigureCertificateAuth( TLSContext_t * pxTLSCtx,
         }
         else
         {
+            pxCertCtx = pxPkiCertCacheGetChain( pxTLSCtx->pxClientCert );
             pxCertPkCtx = &( pxCertCtx->MBEDTLS_PRIVATE( pk ) );
         }
     }
@@ -719,106 +766,51 @@ static TlsTransportStatus_t xConfigureCertificateAuth( TLSContext_t * pxTLSCtx,
 
 /*-----------------------------------------------------------*/
 
+/* Drop CA certificates that are not allowed by the certificate profile when a chain is first parsed */
+static int lFilterCACert( void * pvCtx,
+                          mbedtls_x509_crt * pxCert )
+{
+    int lError = lValidateCertByProfile( ( TLSContext_t * ) pvCtx, pxCert );
+
+    if( lError != 0 )
+    {
+        #if !defined( MBEDTLS_X509_REMOVE_INFO )
+            LogError( "Failed to validate a CA Certificate. Reason: %s",
+                      pcGetVerifyInfoString( lError ) );
+        #else /* !defined( MBEDTLS_X509_REMOVE_INFO ) */
+            LogError( "Failed to validate a CA Certificate." );
+        #endif
+    }
+    else
+    {
+        vLogCertInfo( pxCert, "CA Certificate: " );
+    }
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
 static TlsTransportStatus_t xConfigureCAChain( TLSContext_t * pxTLSCtx,
                                                const PkiObject_t * pxRootCaCerts,
                                                const size_t uxNumRootCA )
 {
     TlsTransportStatus_t xStatus = TLS_TRANSPORT_SUCCESS;
-
-    mbedtls_x509_crt * pxRootCertIterator = NULL;
-    mbedtls_x509_crt * pxRootCaChain = NULL;
-    size_t uxValidCertCount = 0;
-    int lError = 0;
+    PkiStatus_t xPkiStatus;
 
     configASSERT( pxTLSCtx );
     configASSERT( pxRootCaCerts );
     configASSERT( uxNumRootCA );
 
-    pxRootCaChain = &( pxTLSCtx->xRootCaChain );
+    /* The profile is always mbedtls_x509_crt_profile_default, so filtering once per cached chain is enough. */
+    xPkiStatus = xPkiCertCacheAcquire( &( pxTLSCtx->pxRootCaChain ), pxRootCaCerts, uxNumRootCA,
+                                       lFilterCACert, pxTLSCtx );
 
-    for( size_t uxIdx = 0; uxIdx < uxNumRootCA; uxIdx++ )
+    if( xPkiStatus == PKI_ERR_NOMEM )
     {
-        const PkiObject_t * pxRootCert = &( pxRootCaCerts[ uxIdx ] );
-        mbedtls_x509_crt * pxTempCaCert = NULL;
-
-        /* Heap allocate all but the first mbedtls_x509_crt object */
-        if( pxRootCertIterator == NULL )
-        {
-            pxTempCaCert = pxRootCaChain;
-        }
-        else
-        {
-            pxTempCaCert = mbedtls_calloc( 1, sizeof( mbedtls_x509_crt ) );
-        }
-
-        /* If heap allocation failed, break out of loop */
-        if( pxTempCaCert == NULL )
-        {
-            LogError( "Failed to allocate memory for mbedtls_x509_crt object." );
-            lError = MBEDTLS_ERR_X509_ALLOC_FAILED;
-        }
-        else
-        {
-            mbedtls_x509_crt_init( pxTempCaCert );
-
-            /* load the certificate onto the heap */
-            lError = xPkiReadCertificate( pxTempCaCert, pxRootCert );
-
-            MBEDTLS_LOG_IF_ERROR( lError, "Failed to load the CA Certificate at index: %ld, Error: ", uxIdx );
-        }
-
-        if( lError == 0 )
-        {
-            lError = lValidateCertByProfile( pxTLSCtx, pxTempCaCert );
-
-            if( lError != 0 )
-            {
-                #if !defined( MBEDTLS_X509_REMOVE_INFO )
-                    LogError( "Failed to validate the CA Certificate at index: %ld. Reason: %s", uxIdx,
-                              pcGetVerifyInfoString( lError ) );
-                #else /* !defined( MBEDTLS_X509_REMOVE_INFO ) */
-                    LogError( "Failed to validate the CA Certificate at index: %ld.", uxIdx );
-                #endif
-            }
-        }
-
-        if( lError == 0 )
-        {
-            vLogCertInfo( pxTempCaCert, "CA Certificate: " );
-
-            /* Append to the list */
-            if( pxRootCertIterator != NULL )
-            {
-                pxRootCertIterator->MBEDTLS_PRIVATE( next ) = pxTempCaCert;
-            }
-
-            pxRootCertIterator = pxTempCaCert;
-            uxValidCertCount++;
-        }
-        /* Otherwise, handle the error */
-        else if( pxTempCaCert != NULL )
-        {
-            /* Free any allocated data */
-            mbedtls_x509_crt_free( pxTempCaCert );
-
-            /* Free pxTempCaCert if it is heap allocated (not first in list) */
-            if( pxRootCertIterator != NULL )
-            {
-                mbedtls_free( pxTempCaCert );
-            }
-        }
-
-        /* Break on memory allocation failure */
-        if( lError == MBEDTLS_ERR_X509_ALLOC_FAILED )
-        {
-            break;
-        }
+        xStatus = TLS_TRANSPORT_INSUFFICIENT_MEMORY;
     }
-
-    xStatus = lMbedtlsErrToTransportError( lError );
-
-    if( ( uxValidCertCount == 0 ) &&
-        ( lError != MBEDTLS_ERR_X509_ALLOC_FAILED ) )
+    else if( xPkiStatus != PKI_SUCCESS )
     {
         LogError( "Failed to load any valid Root CA Certificates." );
         xStatus = TLS_TRANSPORT_NO_VALID_CA_CERT;
@@ -838,6 +830,7 @@ TlsTransportStatus_t mbedtls_transport_configure( NetworkContext_t * pxNetworkCo
     TLSContext_t * pxTLSCtx = ( TLSContext_t * ) pxNetworkContext;
     mbedtls_ssl_config * pxSslConfig = NULL;
     TlsTransportStatus_t xStatus = TLS_TRANSPORT_SUCCESS;
+    TickType_t xStartTicks = xTaskGetTickCount();
     int lError = 0;
 
     if( pxNetworkContext == NULL )
@@ -878,7 +871,7 @@ TlsTransportStatus_t mbedtls_transport_configure( NetworkContext_t * pxNetworkCo
         #ifdef MBEDTLS_TRANSPORT_PKCS11
             if( xStatus == TLS_TRANSPORT_SUCCESS )
             {
-                if( xInitializePkcs11Session( &( pxTLSCtx->xP11SessionHandle ) ) != CKR_OK )
+                if( xPkcs11GetSharedSession( &( pxTLSCtx->xP11SessionHandle ) ) != CKR_OK )
                 {
                     LogError( "Failed to initialize PKCS11 session." );
 
@@ -1020,15 +1013,15 @@ TlsTransportStatus_t mbedtls_transport_configure( NetworkContext_t * pxNetworkCo
     {
         if( pxTLSCtx->xConnectionState == STATE_CONFIGURED )
         {
-            mbedtls_x509_crt_free( &( pxTLSCtx->xRootCaChain ) );
-            mbedtls_x509_crt_init( &( pxTLSCtx->xRootCaChain ) );
+            vPkiCertCacheRelease( pxTLSCtx->pxRootCaChain );
+            pxTLSCtx->pxRootCaChain = NULL;
         }
 
         xStatus = xConfigureCAChain( pxTLSCtx, pxRootCaCerts, uxNumRootCA );
 
         if( xStatus == TLS_TRANSPORT_SUCCESS )
         {
-            mbedtls_ssl_conf_ca_chain( pxSslConfig, &( pxTLSCtx->xRootCaChain ), NULL );
+            mbedtls_ssl_conf_ca_chain( pxSslConfig, pxPkiCertCacheGetChain( pxTLSCtx->pxRootCaChain ), NULL );
         }
     }
 
@@ -1063,165 +1056,427 @@ TlsTransportStatus_t mbedtls_transport_configure( NetworkContext_t * pxNetworkCo
         }
     }
 
+    LogInfo( "TLS configuration took %lu ms.",
+             ( unsigned long ) ( ( xTaskGetTickCount() - xStartTicks ) * portTICK_PERIOD_MS ) );
+
     return xStatus;
 }
 
-static TlsTransportStatus_t xConnectSocket( TLSContext_t * pxTLSCtx,
-                                            const char * pcHostName,
-                                            uint16_t usPort )
+/* Start a new connection attempt when the previous one has not completed within this time. (RFC 8305) */
+#define CONNECT_ATTEMPT_DELAY_MS    ( 250 )
+
+/* Give up on all pending connection attempts after this time */
+#define CONNECT_TIMEOUT_MS          ( 10000 )
+
+/* Maximum number of addresses raced for one connection */
+#define CONNECT_MAX_ADDRS           ( 4 )
+
+/* Maximum number of connection attempts in flight at once */
+#define CONNECT_MAX_PENDING         ( 2 )
+
+typedef struct
+{
+    struct sockaddr_in xAddrs[ CONNECT_MAX_ADDRS ];
+    size_t uxNumAddrs;
+    size_t uxNextAddr;
+    SockHandle_t xPending[ CONNECT_MAX_PENDING ];
+    size_t uxPendingAddr[ CONNECT_MAX_PENDING ];
+    size_t uxNumPending;
+    TickType_t xLastStartTicks;
+    SockHandle_t xWinner;
+    size_t uxWinnerAddr;
+} ConnectRace_t;
+
+/*-----------------------------------------------------------*/
+
+static void prvRaceInit( ConnectRace_t * pxRace )
+{
+    ( void ) memset( pxRace, 0, sizeof( ConnectRace_t ) );
+    pxRace->xWinner = -1;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvRaceAddCandidate( ConnectRace_t * pxRace,
+                                 const struct sockaddr_in * pxAddr,
+                                 uint16_t usPort )
+{
+    bool xDuplicate = false;
+
+    for( size_t i = 0; i < pxRace->uxNumAddrs; i++ )
+    {
+        if( pxRace->xAddrs[ i ].sin_addr.s_addr == pxAddr->sin_addr.s_addr )
+        {
+            xDuplicate = true;
+            break;
+        }
+    }
+
+    if( !xDuplicate && ( pxRace->uxNumAddrs < CONNECT_MAX_ADDRS ) )
+    {
+        pxRace->xAddrs[ pxRace->uxNumAddrs ] = *pxAddr;
+        pxRace->xAddrs[ pxRace->uxNumAddrs ].sin_port = htons( usPort );
+        pxRace->uxNumAddrs++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvRaceLogAddress( const char * pcMessage,
+                               const struct sockaddr_in * pxAddr,
+                               const char * pcHostName )
+{
+    char ipAddrBuff[ IP4ADDR_STRLEN_MAX ] = { 0 };
+
+    ( void ) pcMessage;
+    ( void ) pcHostName;
+    ( void ) inet_ntoa_r( pxAddr->sin_addr, ipAddrBuff, IP4ADDR_STRLEN_MAX );
+
+    LogInfo( "%s address: %.*s, port: %u for host: %s.",
+             pcMessage, IP4ADDR_STRLEN_MAX, ipAddrBuff,
+             ntohs( pxAddr->sin_port ), pcHostName );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Start a non-blocking connect to the next candidate address. */
+static TlsTransportStatus_t prvRaceStartNext( ConnectRace_t * pxRace,
+                                              const char * pcHostName )
 {
     TlsTransportStatus_t xStatus = TLS_TRANSPORT_SUCCESS;
-    int lError = 0;
-    struct addrinfo * pxAddrInfo = NULL;
+    size_t uxAddr = pxRace->uxNextAddr;
+    SockHandle_t xSockHandle;
+    int lFlags;
+    int lError;
 
-    configASSERT( pxTLSCtx != NULL );
-    configASSERT( pcHostName != NULL );
-    configASSERT( usPort > 0 );
+    pxRace->uxNextAddr++;
+    pxRace->xLastStartTicks = xTaskGetTickCount();
 
-    /* Close socket if already allocated */
-    if( pxTLSCtx->xSockHandle >= 0 )
+    prvRaceLogAddress( "Trying", &( pxRace->xAddrs[ uxAddr ] ), pcHostName );
+
+    xSockHandle = sock_socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+
+    if( xSockHandle < 0 )
     {
-        ( void ) sock_close( pxTLSCtx->xSockHandle );
-        pxTLSCtx->xSockHandle = -1;
+        LogError( "Failed to allocate socket." );
+        xStatus = TLS_TRANSPORT_INSUFFICIENT_SOCKETS;
+    }
+    else
+    {
+        lFlags = sock_fcntl( xSockHandle, F_GETFL, 0 );
+
+        if( ( lFlags == -1 ) ||
+            ( sock_fcntl( xSockHandle, F_SETFL, lFlags | O_NONBLOCK ) != 0 ) )
+        {
+            LogError( "Failed to set socket O_NONBLOCK flag." );
+            ( void ) sock_close( xSockHandle );
+            xStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
     }
 
-    /* Perform address (DNS) lookup */
     if( xStatus == TLS_TRANSPORT_SUCCESS )
     {
-        const struct addrinfo xAddrInfoHint =
+        lError = sock_connect( xSockHandle,
+                               ( struct sockaddr * ) &( pxRace->xAddrs[ uxAddr ] ),
+                               sizeof( struct sockaddr_in ) );
+
+        if( lError == 0 )
+        {
+            pxRace->xWinner = xSockHandle;
+            pxRace->uxWinnerAddr = uxAddr;
+        }
+        else if( *__errno() == EINPROGRESS )
         {
-            .ai_family   = AF_INET,
-            .ai_socktype = SOCK_STREAM,
-            .ai_protocol = IPPROTO_TCP,
-        };
+            pxRace->xPending[ pxRace->uxNumPending ] = xSockHandle;
+            pxRace->uxPendingAddr[ pxRace->uxNumPending ] = uxAddr;
+            pxRace->uxNumPending++;
+        }
+        else
+        {
+            /* Failed immediately, the caller moves on to the next address */
+            ( void ) sock_close( xSockHandle );
+        }
+    }
 
-        lError = dns_getaddrinfo( pcHostName, NULL,
-                                  &xAddrInfoHint, &pxAddrInfo );
+    return xStatus;
+}
 
-        if( ( lError != 0 ) || ( pxAddrInfo == NULL ) )
-        {
-            LogError( "Failed to resolve hostname: %s to IP address.", pcHostName );
-            xStatus = TLS_TRANSPORT_DNS_FAILED;
+/*-----------------------------------------------------------*/
 
-            if( pxAddrInfo != NULL )
-            {
-                dns_freeaddrinfo( pxAddrInfo );
-                pxAddrInfo = NULL;
-            }
+/* Wait for up to xWaitTicks for any pending attempt to complete. Failed attempts are closed. */
+static void prvRaceWait( ConnectRace_t * pxRace,
+                         TickType_t xWaitTicks )
+{
+    fd_set xWriteSet;
+    fd_set xErrorSet;
+    SockHandle_t xMaxSock = -1;
+    struct timeval xTimeout;
+    int lRslt;
+
+    FD_ZERO( &xWriteSet );
+    FD_ZERO( &xErrorSet );
+
+    for( size_t i = 0; i < pxRace->uxNumPending; i++ )
+    {
+        FD_SET( pxRace->xPending[ i ], &xWriteSet );
+        FD_SET( pxRace->xPending[ i ], &xErrorSet );
+
+        if( pxRace->xPending[ i ] > xMaxSock )
+        {
+            xMaxSock = pxRace->xPending[ i ];
         }
     }
 
-    if( xStatus == TLS_TRANSPORT_SUCCESS )
+    xTimeout.tv_sec = ( xWaitTicks * portTICK_PERIOD_MS ) / 1000;
+    xTimeout.tv_usec = ( ( xWaitTicks * portTICK_PERIOD_MS ) % 1000 ) * 1000;
+
+    lRslt = sock_select( xMaxSock + 1, NULL, &xWriteSet, &xErrorSet, &xTimeout );
+
+    if( lRslt > 0 )
     {
-        struct addrinfo * pxAddrIter = NULL;
+        size_t i = 0;
 
-        /* Try all of the addresses returned by getaddrinfo */
-        for( pxAddrIter = pxAddrInfo; pxAddrIter != NULL; pxAddrIter = pxAddrIter->ai_next )
+        while( i < pxRace->uxNumPending )
         {
-            /* Set port number */
-            switch( pxAddrIter->ai_family )
+            SockHandle_t xSockHandle = pxRace->xPending[ i ];
+            bool xDone = false;
+
+            if( FD_ISSET( xSockHandle, &xWriteSet ) ||
+                FD_ISSET( xSockHandle, &xErrorSet ) )
             {
-                #if LWIP_IPV4 == 1
-                    case AF_INET:
-                        ( ( struct sockaddr_in * ) pxAddrIter->ai_addr )->sin_port = htons( usPort );
-                        break;
-                #endif
-                #if LWIP_IPV6 == 1
-                    case AF_INET6:
-                        ( ( struct sockaddr_in6 * ) pxAddrIter->ai_addr )->sin6_port = htons( usPort );
-                        break;
-                #endif
-                default:
-                    continue;
-                    break;
-            }
+                int lSockError = 0;
+                socklen_t xOptLen = sizeof( lSockError );
 
-            #if LWIP_IPV4 == 1
-                if( pxAddrIter->ai_family == AF_INET )
+                xDone = true;
+
+                if( ( sock_getsockopt( xSockHandle, SOL_SOCKET, SO_ERROR, &lSockError, &xOptLen ) == 0 ) &&
+                    ( lSockError == 0 ) &&
+                    ( pxRace->xWinner < 0 ) )
                 {
-                    char ipAddrBuff[ IP4ADDR_STRLEN_MAX ] = { 0 };
-                    ( void ) inet_ntoa_r( ( ( struct sockaddr_in * ) pxAddrIter->ai_addr )->sin_addr, ipAddrBuff, IP4ADDR_STRLEN_MAX );
-                    LogInfo( "Trying address: %.*s, port: %uh for host: %s.",
-                             IP4ADDR_STRLEN_MAX, ipAddrBuff, usPort, pcHostName );
+                    pxRace->xWinner = xSockHandle;
+                    pxRace->uxWinnerAddr = pxRace->uxPendingAddr[ i ];
                 }
-            #endif
-            #if LWIP_IPV6 == 1
-                if( pxAddrIter->ai_family == AF_INET6 )
+                else
                 {
-                    char ipAddrBuff[ IP6ADDR_STRLEN_MAX ] = { 0 };
-                    ( void ) inet6_ntoa_r( ( ( struct sockaddr_in6 * ) pxAddrIter->ai_addr )->sin_addr, ipAddrBuff, IP6ADDR_STRLEN_MAX );
-                    LogInfo( "Trying address: %.*s, port: %uh for host: %s.",
-                             IP6ADDR_STRLEN_MAX, ipAddrBuff, usPort, pcHostName );
+                    ( void ) sock_close( xSockHandle );
                 }
-            #endif
-
-            /* Allocate socket */
-            pxTLSCtx->xSockHandle = sock_socket( pxAddrIter->ai_family,
-                                                 pxAddrIter->ai_socktype,
-                                                 pxAddrIter->ai_protocol );
+            }
 
-            if( pxTLSCtx->xSockHandle < 0 )
+            if( xDone )
             {
-                LogError( "Failed to allocate socket." );
-                xStatus = TLS_TRANSPORT_INSUFFICIENT_SOCKETS;
+                /* Remove the attempt from the pending list */
+                pxRace->uxNumPending--;
+                pxRace->xPending[ i ] = pxRace->xPending[ pxRace->uxNumPending ];
+                pxRace->uxPendingAddr[ i ] = pxRace->uxPendingAddr[ pxRace->uxNumPending ];
             }
             else
             {
-                lError = sock_connect( pxTLSCtx->xSockHandle,
-                                       pxAddrIter->ai_addr,
-                                       pxAddrIter->ai_addrlen );
-
-                /* Upon connection error, continue to next address */
-                if( lError != 0 )
-                {
-                    ( void ) sock_close( pxTLSCtx->xSockHandle );
-                    pxTLSCtx->xSockHandle = -1;
-                }
-                else
-                {
-                    #if LWIP_IPV4 == 1
-                        if( pxAddrIter->ai_family == AF_INET )
-                        {
-                            char ipAddrBuff[ IP4ADDR_STRLEN_MAX ] = { 0 };
-
-                            ( void ) inet_ntoa_r( ( ( struct sockaddr_in * ) pxAddrIter->ai_addr )->sin_addr, ipAddrBuff, IP4ADDR_STRLEN_MAX );
-
-                            LogInfo( "Connected socket: %ld to host: %s, address: %.*s, port: %uh.",
-                                     pxTLSCtx->xSockHandle, pcHostName,
-                                     IP4ADDR_STRLEN_MAX, ipAddrBuff, usPort );
-                        }
-                    #endif /* if LWIP_IPV4 == 1 */
-                    #if LWIP_IPV6 == 1
-                        if( pxAddrIter->ai_family == AF_INET6 )
-                        {
-                            char ipAddrBuff[ IP6ADDR_STRLEN_MAX ] = { 0 };
-                            ( void ) inet6_ntoa_r( ( ( struct sockaddr_in6 * ) pxAddrIter->ai_addr )->sin_addr, ipAddrBuff, IP6ADDR_STRLEN_MAX );
-                            LogInfo( "Connected socket: %ld to host: %s, address: %.*s, port: %uh.",
-                                     pxTLSCtx->xSockHandle, pcHostName,
-                                     IP6ADDR_STRLEN_MAX, ipAddrBuff, usPort );
-                        }
-                    #endif
-                }
+                i++;
             }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
 
-            /* Exit loop on an irrecoverable error or successful connection. */
-            if( ( xStatus != TLS_TRANSPORT_SUCCESS ) ||
-                ( pxTLSCtx->xSockHandle >= 0 ) )
+/*
+ * Race the candidate addresses until one connects or xDeadline passes, starting
+ * a new attempt each time the newest one has been pending for CONNECT_ATTEMPT_DELAY_MS.
+ * With xStopAtLastCandidate set, return once all candidates have been started
+ * and the newest one has had its delay, so more candidates can be added.
+ */
+static TlsTransportStatus_t prvRaceRun( ConnectRace_t * pxRace,
+                                        const char * pcHostName,
+                                        TickType_t xDeadline,
+                                        bool xStopAtLastCandidate )
+{
+    TlsTransportStatus_t xStatus = TLS_TRANSPORT_SUCCESS;
+    const TickType_t xAttemptDelay = pdMS_TO_TICKS( CONNECT_ATTEMPT_DELAY_MS );
+
+    while( ( xStatus == TLS_TRANSPORT_SUCCESS ) &&
+           ( pxRace->xWinner < 0 ) )
+    {
+        TickType_t xNow = xTaskGetTickCount();
+        TickType_t xSinceStart = xNow - pxRace->xLastStartTicks;
+        TickType_t xWait;
+        bool xCanStart = ( pxRace->uxNextAddr < pxRace->uxNumAddrs ) &&
+                         ( pxRace->uxNumPending < CONNECT_MAX_PENDING );
+
+        if( ( TickType_t ) ( xDeadline - xNow ) > pdMS_TO_TICKS( CONNECT_TIMEOUT_MS ) )
+        {
+            /* Deadline passed */
+            break;
+        }
+
+        if( xCanStart &&
+            ( ( pxRace->uxNumPending == 0 ) || ( xSinceStart >= xAttemptDelay ) ) )
+        {
+            xStatus = prvRaceStartNext( pxRace, pcHostName );
+
+            if( ( xStatus != TLS_TRANSPORT_SUCCESS ) &&
+                ( pxRace->uxNumPending > 0 ) )
             {
-                break;
+                /* Out of sockets, keep waiting on the attempts already started */
+                pxRace->uxNumAddrs = pxRace->uxNextAddr;
+                xStatus = TLS_TRANSPORT_SUCCESS;
             }
+
+            continue;
+        }
+
+        if( pxRace->uxNumPending == 0 )
+        {
+            /* Every candidate failed */
+            break;
+        }
+
+        if( xStopAtLastCandidate &&
+            ( pxRace->uxNextAddr >= pxRace->uxNumAddrs ) &&
+            ( xSinceStart >= xAttemptDelay ) )
+        {
+            break;
+        }
+
+        xWait = xDeadline - xNow;
+
+        if( ( xCanStart || xStopAtLastCandidate ) &&
+            ( xAttemptDelay - xSinceStart < xWait ) )
+        {
+            xWait = xAttemptDelay - xSinceStart;
         }
+
+        prvRaceWait( pxRace, xWait );
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvRaceFinish( ConnectRace_t * pxRace )
+{
+    for( size_t i = 0; i < pxRace->uxNumPending; i++ )
+    {
+        ( void ) sock_close( pxRace->xPending[ i ] );
     }
 
-    if( pxAddrInfo != NULL )
+    pxRace->uxNumPending = 0;
+
+    if( pxRace->xWinner >= 0 )
     {
-        dns_freeaddrinfo( pxAddrInfo );
-        pxAddrInfo = NULL;
+        /* mbedtls_transport_connect expects a blocking socket */
+        int lFlags = sock_fcntl( pxRace->xWinner, F_GETFL, 0 );
+
+        if( ( lFlags == -1 ) ||
+            ( sock_fcntl( pxRace->xWinner, F_SETFL, lFlags & ~O_NONBLOCK ) != 0 ) )
+        {
+            LogError( "Failed to clear socket O_NONBLOCK flag." );
+            ( void ) sock_close( pxRace->xWinner );
+            pxRace->xWinner = -1;
+        }
     }
+}
+
+/*-----------------------------------------------------------*/
 
+/*
+ * Connect a socket to the host, racing the resolved IPv4 addresses happy eyeballs
+ * style. When the context has connected to this host before, the previous address
+ * is tried before the DNS lookup, which is skipped if it answers within
+ * CONNECT_ATTEMPT_DELAY_MS.
+ */
+static TlsTransportStatus_t xConnectSocket( TLSContext_t * pxTLSCtx,
+                                            const char * pcHostName,
+                                            uint16_t usPort )
+{
+    TlsTransportStatus_t xStatus = TLS_TRANSPORT_SUCCESS;
+    ConnectRace_t xRace;
+    DnsCacheResult_t xDnsResult = DNS_CACHE_HIT;
+    TickType_t xStartTicks = xTaskGetTickCount();
+    TickType_t xDeadline = xStartTicks + pdMS_TO_TICKS( CONNECT_TIMEOUT_MS );
+    TickType_t xDnsTicks = 0;
+
+    configASSERT( pxTLSCtx != NULL );
+    configASSERT( pcHostName != NULL );
+    configASSERT( usPort > 0 );
+
+    /* Close socket if already allocated */
+    if( pxTLSCtx->xSockHandle >= 0 )
+    {
+        ( void ) sock_close( pxTLSCtx->xSockHandle );
+        pxTLSCtx->xSockHandle = -1;
+    }
+
+    prvRaceInit( &xRace );
+
+    if( pxTLSCtx->xLastAddrValid )
+    {
+        prvRaceAddCandidate( &xRace, &( pxTLSCtx->xLastAddr ), usPort );
+        xStatus = prvRaceRun( &xRace, pcHostName, xDeadline, true );
+    }
+
+    /* Perform address (DNS) lookup, through the resolver cache */
     if( ( xStatus == TLS_TRANSPORT_SUCCESS ) &&
-        ( pxTLSCtx->xSockHandle < 0 ) )
+        ( xRace.xWinner < 0 ) )
     {
+        struct in_addr xAddrs[ CONNECT_MAX_ADDRS ];
+        size_t uxNumAddrs = 0;
+        TickType_t xDnsStartTicks = xTaskGetTickCount();
+
+        xDnsResult = xDnsCacheResolve( pcHostName, xAddrs, CONNECT_MAX_ADDRS, &uxNumAddrs );
+
+        xDnsTicks = xTaskGetTickCount() - xDnsStartTicks;
+
+        if( xDnsResult == DNS_CACHE_FAILED )
+        {
+            LogError( "Failed to resolve hostname: %s to IP address.", pcHostName );
+
+            /* Keep waiting on the previous address if it is still pending */
+            if( xRace.uxNumPending == 0 )
+            {
+                xStatus = TLS_TRANSPORT_DNS_FAILED;
+            }
+        }
+
+        for( size_t i = 0; i < uxNumAddrs; i++ )
+        {
+            struct sockaddr_in xAddr =
+            {
+                .sin_family = AF_INET,
+                .sin_addr   = xAddrs[ i ],
+            };
+
+            prvRaceAddCandidate( &xRace, &xAddr, usPort );
+        }
+
+        if( xStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            xStatus = prvRaceRun( &xRace, pcHostName, xDeadline, false );
+        }
+    }
+
+    prvRaceFinish( &xRace );
+
+    if( xRace.xWinner >= 0 )
+    {
+        pxTLSCtx->xSockHandle = xRace.xWinner;
+        pxTLSCtx->xLastAddr = xRace.xAddrs[ xRace.uxWinnerAddr ];
+        pxTLSCtx->xLastAddrValid = true;
+
+        prvRaceLogAddress( "Connected to", &( xRace.xAddrs[ xRace.uxWinnerAddr ] ), pcHostName );
+
+        LogInfo( "TCP connection took %lu ms, including %lu ms for DNS%s.",
+                 ( unsigned long ) ( ( xTaskGetTickCount() - xStartTicks ) * portTICK_PERIOD_MS ),
+                 ( unsigned long ) ( xDnsTicks * portTICK_PERIOD_MS ),
+                 ( xDnsResult == DNS_CACHE_HIT ) ? " (cached)" : "" );
+
+        vDnsCacheReportConnected( pcHostName, &( xRace.xAddrs[ xRace.uxWinnerAddr ].sin_addr ) );
+    }
+    else if( xStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        /* Forget the previous addresses so the next attempt starts with a fresh lookup */
+        pxTLSCtx->xLastAddrValid = false;
+        vDnsCacheReportFailed( pcHostName );
         xStatus = TLS_TRANSPORT_CONNECT_FAILURE;
     }
 
@@ -1276,6 +1531,9 @@ TlsTransportStatus_t mbedtls_transport_connect( NetworkContext_t * pxNetworkCont
     {
         lError = mbedtls_ssl_set_hostname( pxSslCtx, pcHostName );
 
+        /* The previous address belongs to a different host */
+        pxTLSCtx->xLastAddrValid = false;
+
         if( lError != 0 )
         {
             LogError( "Failed to set server hostname: Error: %s : %s.",
@@ -1346,6 +1604,9 @@ TlsTransportStatus_t mbedtls_transport_connect( NetworkContext_t * pxNetworkCont
     /* Perform TLS handshake. */
     if( xStatus == TLS_TRANSPORT_SUCCESS )
     {
+        TickType_t xHandshakeStartTicks = xTaskGetTickCount();
+        HeapArena_t * pxPrevArena = pxHeapArenaBind( &( pxTLSCtx->xArena ) );
+
         /* Perform the TLS handshake. */
         do
         {
@@ -1354,6 +1615,8 @@ TlsTransportStatus_t mbedtls_transport_connect( NetworkContext_t * pxNetworkCont
         while( ( lError == MBEDTLS_ERR_SSL_WANT_READ ) ||
                ( lError == MBEDTLS_ERR_SSL_WANT_WRITE ) );
 
+        ( void ) pxHeapArenaBind( pxPrevArena );
+
         if( lError != 0 )
         {
             LogError( "Failed to perform TLS handshake: Error: %s : %s.",
@@ -1364,8 +1627,9 @@ TlsTransportStatus_t mbedtls_transport_connect( NetworkContext_t * pxNetworkCont
         }
         else
         {
-            LogInfo( "Network connection %p: TLS handshake successful.",
-                     pxTLSCtx );
+            LogInfo( "Network connection %p: TLS handshake successful in %lu ms.",
+                     pxTLSCtx,
+                     ( unsigned long ) ( ( xTaskGetTickCount() - xHandshakeStartTicks ) * portTICK_PERIOD_MS ) );
         }
     }
 
@@ -1395,6 +1659,7 @@ TlsTransportStatus_t mbedtls_transport_connect( NetworkContext_t * pxNetworkCont
 
         /* Reset SSL session context for reconnect attempt */
         mbedtls_ssl_session_reset( pxSslCtx );
+        prvResetArena( pxTLSCtx );
 
         LogInfo( "Network connection %p: to %s:%u failed.",
                  pxNetworkContext,
@@ -1596,6 +1861,7 @@ void mbedtls_transport_disconnect( NetworkContext_t * pxNetworkContext )
         if( pxTLSCtx->xConnectionState == STATE_CONFIGURED )
         {
             mbedtls_ssl_session_reset( &( pxTLSCtx->xSslCtx ) );
+            prvResetArena( pxTLSCtx );
         }
     }
 }
@@ -1628,9 +1894,11 @@ int32_t mbedtls_transport_recv( NetworkContext_t * pxNetworkContext,
     {
         if( pxTLSCtx->xConnectionState == STATE_CONNECTED )
         {
+            TRACE_BEGIN( TRACE_ID_TLS_READ, uxBytesToRecv );
             tlsStatus = ( int32_t ) mbedtls_ssl_read( &( pxTLSCtx->xSslCtx ),
                                                       pBuffer,
                                                       uxBytesToRecv );
+            TRACE_END( TRACE_ID_TLS_READ, tlsStatus );
         }
         else
         {
@@ -1709,9 +1977,11 @@ int32_t mbedtls_transport_send( NetworkContext_t * pxNetworkContext,
     {
         if( pxTLSCtx->xConnectionState == STATE_CONNECTED )
         {
+            TRACE_BEGIN( TRACE_ID_TLS_WRITE, uxBytesToSend );
             tlsStatus = ( int32_t ) mbedtls_ssl_write( &( pxTLSCtx->xSslCtx ),
                                                        pBuffer,
                                                        uxBytesToSend );
+            TRACE_END( TRACE_ID_TLS_WRITE, tlsStatus );
         }
         else
         {
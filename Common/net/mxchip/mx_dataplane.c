@@ -36,6 +36,7 @@
 #include "stm32u5xx_hal.h"
 #include "message_buffer.h"
 #include "atomic.h"
+#include "trace_ring.h"
 
 #include "mx_ipc.h"
 #include "mx_prv.h"
@@ -510,6 +511,8 @@ void vDataplaneThread( void * pvParameters )
     {
         PacketBuffer_t * pxTxBuff = NULL;
         PacketBuffer_t * pxRxBuff = NULL;
+        uint16_t usTxLen = 0;
+        uint16_t usRxLen = 0;
 
         if( pxCtx->ulTxPacketsWaiting == 0 )
         {
@@ -529,6 +532,8 @@ void vDataplaneThread( void * pvParameters )
         /* Clear flow state */
         xTaskNotifyStateClearIndexed( NULL, SPI_EVT_FLOW_IDX );
 
+        TRACE_BEGIN( TRACE_ID_SPI_XFER, pxCtx->ulTxPacketsWaiting );
+
         /* Set CS low to initiate transaction */
         vGpioClear( pxCtx->gpio_nss );
 
@@ -537,9 +542,6 @@ void vDataplaneThread( void * pvParameters )
         /* Wait for the module to be ready */
         if( xWaitForFlow( pxCtx ) == pdTRUE )
         {
-            uint16_t usTxLen = 0;
-            uint16_t usRxLen = 0;
-
             QueueHandle_t xSourceQueue = NULL;
 
             /* Prepare a control plane messages for TX */
@@ -641,6 +643,8 @@ void vDataplaneThread( void * pvParameters )
         /* Set CS / NSS high (idle) */
         vGpioSet( pxCtx->gpio_nss );
 
+        TRACE_END( TRACE_ID_SPI_XFER, ( ( uint32_t ) usTxLen << 16 ) | usRxLen );
+
         if( pxTxBuff != NULL )
         {
             /* Decrement TX packets waiting counter */
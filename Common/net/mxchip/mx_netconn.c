@@ -471,6 +471,19 @@ void net_main( void * pvParameters )
 
     ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_NET_INIT );
 
+    /* The access point credentials are read from the key value store */
+    ( void ) xEventGroupWaitBits( xSystemEvents,
+                                  EVT_MASK_KVSTORE_READY,
+                                  pdFALSE,
+                                  pdTRUE,
+                                  portMAX_DELAY );
+
+    /* Reconnect when new access point credentials are committed */
+    ( void ) KVStore_subscribeTask( KV_STORE_KEY_MASK( CS_WIFI_SSID ) | KV_STORE_KEY_MASK( CS_WIFI_CREDENTIAL ),
+                                    xNetTaskHandle,
+                                    NET_EVT_IDX,
+                                    ASYNC_REQUEST_RECONNECT_BIT );
+
     /* If already connected to the AP, bring interface up */
     if( xCtx.xStatus >= MX_STATUS_STA_UP )
     {
@@ -555,7 +568,7 @@ void net_main( void * pvParameters )
                 ( void ) xEventGroupClearBits( xSystemEvents, EVT_MASK_NET_CONNECTED );
             }
 
-            /* Reconnect requested by configStore or cli process */
+            /* Reconnect requested by a KVStore commit or the cli process */
             if( ulNotificationValue & ASYNC_REQUEST_RECONNECT_BIT )
             {
                 ( void ) xEventGroupClearBits( xSystemEvents, EVT_MASK_NET_CONNECTED );
@@ -56,6 +56,7 @@ static void hw_spi2_msp_init( SPI_HandleTypeDef * pxHndlSpi );
 static void hw_spi2_msp_deinit( SPI_HandleTypeDef * pxHndlSpi );
 static void hw_spi_init( void );
 static void hw_tim5_init( void );
+static void hw_cyccnt_init( void );
 static void hw_watchdog_init( void );
 
 #ifndef TFM_PSA_API
@@ -104,6 +105,8 @@ void hw_init( void )
 
     hw_tim5_init();
 
+    hw_cyccnt_init();
+
     hw_watchdog_init();
 }
 
@@ -285,6 +288,7 @@ static void hw_gpio_init( void )
     __HAL_RCC_GPIOB_CLK_ENABLE();
     __HAL_RCC_GPIOH_CLK_ENABLE();
     __HAL_RCC_GPIOF_CLK_ENABLE();
+    __HAL_RCC_GPIOE_CLK_ENABLE();
 
     /* LED Outputs */
     {
@@ -337,6 +341,23 @@ static void hw_gpio_init( void )
         HAL_NVIC_EnableIRQ( MXCHIP_NOTIFY_EXTI_IRQn );
     }
 
+    /* IMU_INT1_Pin Input */
+    {
+        GPIO_InitTypeDef xGpioInit =
+        {
+            .Pin       = IMU_INT1_Pin,
+            .Mode      = GPIO_MODE_IT_RISING,
+            .Pull      = GPIO_NOPULL,
+            .Speed     = GPIO_SPEED_FREQ_LOW,
+            .Alternate = 0X0,
+        };
+
+        HAL_GPIO_Init( IMU_INT1_GPIO_Port, &xGpioInit );
+
+        HAL_NVIC_SetPriority( IMU_INT1_EXTI_IRQn, 5, 5 );
+        HAL_NVIC_EnableIRQ( IMU_INT1_EXTI_IRQn );
+    }
+
 
     /* MXCHIP_NSS_Pin Output */
     {
@@ -647,6 +668,14 @@ static void hw_tim5_init( void )
     }
 }
 
+static void hw_cyccnt_init( void )
+{
+    /* Enable the DWT cycle counter used for profiling */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
 static void hw_watchdog_init( void )
 {
     HAL_StatusTypeDef xResult = HAL_OK;
@@ -0,0 +1,446 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file heap_arena.c
+ * @brief First fit allocator over a region taken from the FreeRTOS heap.
+ *
+ * Free blocks are kept in a list sorted by address and merged with their
+ * neighbours when freed. Like heap_4, the allocator is protected by
+ * suspending the scheduler.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+#include "heap_arena.h"
+
+#define ARENA_ALIGNMENT           ( 8U )
+#define ARENA_ALIGN( x )          ( ( ( x ) + ( ARENA_ALIGNMENT - 1 ) ) & ~( ( size_t ) ARENA_ALIGNMENT - 1 ) )
+#define ARENA_HEADER_SIZE         ARENA_ALIGN( sizeof( HeapArenaBlock_t ) )
+#define ARENA_MIN_BLOCK_SIZE      ( 2 * ARENA_HEADER_SIZE )
+#define ARENA_ALLOCATED_FLAG      ( ( size_t ) 1 << ( ( sizeof( size_t ) * 8 ) - 1 ) )
+
+struct HeapArenaBlock
+{
+    HeapArenaBlock_t * pxNext; /*!< Next free block, only valid while free */
+    size_t uxSize;             /*!< Size including the header, ARENA_ALLOCATED_FLAG while allocated */
+};
+
+static HeapArena_t * pxArenaList = NULL;
+
+/*-----------------------------------------------------------*/
+
+static HeapArena_t * prvFindArena( const void * pv )
+{
+    HeapArena_t * pxArena = pxArenaList;
+
+    while( ( pxArena != NULL ) &&
+           ( ( ( const uint8_t * ) pv < pxArena->pucStart ) ||
+             ( ( const uint8_t * ) pv >= ( pxArena->pucStart + pxArena->uxSize ) ) ) )
+    {
+        pxArena = pxArena->pxNext;
+    }
+
+    return pxArena;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Must be called with the scheduler suspended */
+static void prvUnlinkArena( HeapArena_t * pxArena )
+{
+    HeapArena_t ** ppxLink = &pxArenaList;
+
+    while( ( *ppxLink != NULL ) && ( *ppxLink != pxArena ) )
+    {
+        ppxLink = &( ( *ppxLink )->pxNext );
+    }
+
+    if( *ppxLink != NULL )
+    {
+        *ppxLink = pxArena->pxNext;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvArenaFormat( HeapArena_t * pxArena )
+{
+    HeapArenaBlock_t * pxBlock = ( HeapArenaBlock_t * ) pxArena->pucStart;
+
+    pxBlock->pxNext = NULL;
+    pxBlock->uxSize = pxArena->uxSize;
+
+    pxArena->pxFreeList = pxBlock;
+    pxArena->uxUsed = 0;
+    pxArena->uxPeak = 0;
+    pxArena->ulLive = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvInsertFreeBlock( HeapArena_t * pxArena,
+                                HeapArenaBlock_t * pxBlock )
+{
+    HeapArenaBlock_t * pxPrev = NULL;
+    HeapArenaBlock_t * pxNext = pxArena->pxFreeList;
+
+    while( ( pxNext != NULL ) && ( pxNext < pxBlock ) )
+    {
+        pxPrev = pxNext;
+        pxNext = pxNext->pxNext;
+    }
+
+    /* Merge with the following block */
+    if( ( pxNext != NULL ) &&
+        ( ( ( uint8_t * ) pxBlock + pxBlock->uxSize ) == ( uint8_t * ) pxNext ) )
+    {
+        pxBlock->uxSize += pxNext->uxSize;
+        pxNext = pxNext->pxNext;
+    }
+
+    pxBlock->pxNext = pxNext;
+
+    /* Merge with the preceding block */
+    if( ( pxPrev != NULL ) &&
+        ( ( ( uint8_t * ) pxPrev + pxPrev->uxSize ) == ( uint8_t * ) pxBlock ) )
+    {
+        pxPrev->uxSize += pxBlock->uxSize;
+        pxPrev->pxNext = pxBlock->pxNext;
+    }
+    else if( pxPrev != NULL )
+    {
+        pxPrev->pxNext = pxBlock;
+    }
+    else
+    {
+        pxArena->pxFreeList = pxBlock;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+bool xHeapArenaInit( HeapArena_t * pxArena,
+                     const char * pcName,
+                     size_t uxSize )
+{
+    bool xResult = false;
+
+    if( ( pxArena != NULL ) &&
+        ( uxSize >= ARENA_MIN_BLOCK_SIZE ) )
+    {
+        ( void ) memset( pxArena, 0, sizeof( HeapArena_t ) );
+
+        uxSize &= ~( ( size_t ) ARENA_ALIGNMENT - 1 );
+        pxArena->pucStart = pvPortMalloc( uxSize );
+
+        if( pxArena->pucStart != NULL )
+        {
+            pxArena->pcName = pcName;
+            pxArena->uxSize = uxSize;
+            prvArenaFormat( pxArena );
+
+            vTaskSuspendAll();
+            pxArena->pxNext = pxArenaList;
+            pxArenaList = pxArena;
+            ( void ) xTaskResumeAll();
+
+            xResult = true;
+        }
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+void vHeapArenaDeinit( HeapArena_t * pxArena )
+{
+    if( ( pxArena != NULL ) &&
+        ( pxArena->pucStart != NULL ) )
+    {
+        /* Blocks that are still allocated keep their region alive: the arena
+         * state moves to the heap and is released with the last block. */
+        HeapArena_t * pxOrphan = NULL;
+        uint8_t * pucRegion = NULL;
+
+        if( pxArena->ulLive > 0 )
+        {
+            pxOrphan = pvPortMalloc( sizeof( HeapArena_t ) );
+            configASSERT_CONTINUE( pxOrphan != NULL );
+        }
+
+        vTaskSuspendAll();
+        {
+            prvUnlinkArena( pxArena );
+
+            if( pxArena->ulLive == 0 )
+            {
+                pucRegion = pxArena->pucStart;
+            }
+            else if( pxOrphan != NULL )
+            {
+                *pxOrphan = *pxArena;
+                pxOrphan->xOrphaned = true;
+                pxOrphan->pxNext = pxArenaList;
+                pxArenaList = pxOrphan;
+                pxOrphan = NULL;
+            }
+            else
+            {
+                /* Out of memory, the region is leaked */
+            }
+        }
+        ( void ) xTaskResumeAll();
+
+        /* pxOrphan is still set if the last block was freed before the scheduler was suspended */
+        vPortFree( pxOrphan );
+        vPortFree( pucRegion );
+        ( void ) memset( pxArena, 0, sizeof( HeapArena_t ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void * pvHeapArenaAlloc( HeapArena_t * pxArena,
+                         size_t uxSize )
+{
+    void * pvBuffer = NULL;
+
+    if( ( pxArena == NULL ) ||
+        ( pxArena->pucStart == NULL ) ||
+        ( uxSize == 0 ) ||
+        ( uxSize > ( pxArena->uxSize - ARENA_HEADER_SIZE ) ) )
+    {
+        return NULL;
+    }
+
+    size_t uxWanted = ARENA_ALIGN( uxSize ) + ARENA_HEADER_SIZE;
+
+    vTaskSuspendAll();
+    {
+        HeapArenaBlock_t * pxPrev = NULL;
+        HeapArenaBlock_t * pxBlock = pxArena->pxFreeList;
+
+        while( ( pxBlock != NULL ) && ( pxBlock->uxSize < uxWanted ) )
+        {
+            pxPrev = pxBlock;
+            pxBlock = pxBlock->pxNext;
+        }
+
+        if( pxBlock != NULL )
+        {
+            HeapArenaBlock_t * pxRemainder = pxBlock->pxNext;
+
+            /* Split off the end of the block if it is large enough to be useful */
+            if( ( pxBlock->uxSize - uxWanted ) >= ARENA_MIN_BLOCK_SIZE )
+            {
+                pxRemainder = ( HeapArenaBlock_t * ) ( ( uint8_t * ) pxBlock + uxWanted );
+                pxRemainder->uxSize = pxBlock->uxSize - uxWanted;
+                pxRemainder->pxNext = pxBlock->pxNext;
+                pxBlock->uxSize = uxWanted;
+            }
+
+            if( pxPrev == NULL )
+            {
+                pxArena->pxFreeList = pxRemainder;
+            }
+            else
+            {
+                pxPrev->pxNext = pxRemainder;
+            }
+
+            pxArena->uxUsed += pxBlock->uxSize;
+            pxArena->ulLive++;
+            pxArena->ulAllocs++;
+
+            if( pxArena->uxUsed > pxArena->uxPeak )
+            {
+                pxArena->uxPeak = pxArena->uxUsed;
+            }
+
+            pxBlock->pxNext = NULL;
+            pxBlock->uxSize |= ARENA_ALLOCATED_FLAG;
+            pvBuffer = ( uint8_t * ) pxBlock + ARENA_HEADER_SIZE;
+        }
+        else
+        {
+            pxArena->ulFallbacks++;
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    return pvBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+bool xHeapArenaFree( void * pv )
+{
+    bool xResult = false;
+
+    if( pv != NULL )
+    {
+        HeapArena_t * pxReleased = NULL;
+
+        vTaskSuspendAll();
+        {
+            HeapArena_t * pxArena = prvFindArena( pv );
+
+            if( pxArena != NULL )
+            {
+                HeapArenaBlock_t * pxBlock = ( HeapArenaBlock_t * ) ( ( uint8_t * ) pv - ARENA_HEADER_SIZE );
+
+                configASSERT( ( pxBlock->uxSize & ARENA_ALLOCATED_FLAG ) != 0 );
+
+                pxBlock->uxSize &= ~ARENA_ALLOCATED_FLAG;
+                pxArena->uxUsed -= pxBlock->uxSize;
+                pxArena->ulLive--;
+
+                prvInsertFreeBlock( pxArena, pxBlock );
+
+                if( pxArena->xOrphaned &&
+                    ( pxArena->ulLive == 0 ) )
+                {
+                    prvUnlinkArena( pxArena );
+                    pxReleased = pxArena;
+                }
+
+                xResult = true;
+            }
+        }
+        ( void ) xTaskResumeAll();
+
+        if( pxReleased != NULL )
+        {
+            vPortFree( pxReleased->pucStart );
+            vPortFree( pxReleased );
+        }
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxHeapArenaBlockSize( const void * pv )
+{
+    size_t uxSize = 0;
+
+    if( pv != NULL )
+    {
+        vTaskSuspendAll();
+
+        if( prvFindArena( pv ) != NULL )
+        {
+            const HeapArenaBlock_t * pxBlock = ( const HeapArenaBlock_t * ) ( ( const uint8_t * ) pv - ARENA_HEADER_SIZE );
+
+            uxSize = ( pxBlock->uxSize & ~ARENA_ALLOCATED_FLAG ) - ARENA_HEADER_SIZE;
+        }
+
+        ( void ) xTaskResumeAll();
+    }
+
+    return uxSize;
+}
+
+/*-----------------------------------------------------------*/
+
+bool xHeapArenaReset( HeapArena_t * pxArena )
+{
+    bool xResult = false;
+
+    if( ( pxArena != NULL ) &&
+        ( pxArena->pucStart != NULL ) )
+    {
+        vTaskSuspendAll();
+
+        if( pxArena->ulLive == 0 )
+        {
+            prvArenaFormat( pxArena );
+            xResult = true;
+        }
+
+        ( void ) xTaskResumeAll();
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+HeapArena_t * pxHeapArenaBind( HeapArena_t * pxArena )
+{
+    HeapArena_t * pxPrevious = pvTaskGetThreadLocalStoragePointer( NULL, HEAP_ARENA_TLS_INDEX );
+
+    vTaskSetThreadLocalStoragePointer( NULL, HEAP_ARENA_TLS_INDEX, pxArena );
+
+    return pxPrevious;
+}
+
+/*-----------------------------------------------------------*/
+
+HeapArena_t * pxHeapArenaGetBound( void )
+{
+    HeapArena_t * pxArena = NULL;
+
+    if( xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED )
+    {
+        pxArena = pvTaskGetThreadLocalStoragePointer( NULL, HEAP_ARENA_TLS_INDEX );
+    }
+
+    return pxArena;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxHeapArenaGetInfo( HeapArenaInfo_t * pxInfo,
+                           size_t uxMaxArenas )
+{
+    size_t uxCount = 0;
+
+    if( pxInfo != NULL )
+    {
+        vTaskSuspendAll();
+
+        for( HeapArena_t * pxArena = pxArenaList;
+             ( pxArena != NULL ) && ( uxCount < uxMaxArenas );
+             pxArena = pxArena->pxNext )
+        {
+            pxInfo[ uxCount ].pcName = pxArena->pcName;
+            pxInfo[ uxCount ].uxSize = pxArena->uxSize;
+            pxInfo[ uxCount ].uxUsed = pxArena->uxUsed;
+            pxInfo[ uxCount ].uxPeak = pxArena->uxPeak;
+            pxInfo[ uxCount ].ulLive = pxArena->ulLive;
+            pxInfo[ uxCount ].ulAllocs = pxArena->ulAllocs;
+            pxInfo[ uxCount ].ulFallbacks = pxArena->ulFallbacks;
+            uxCount++;
+        }
+
+        ( void ) xTaskResumeAll();
+    }
+
+    return uxCount;
+}
@@ -0,0 +1,259 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file heap_pool.c
+ * @brief Segregated size class pools for small mbedTLS allocations.
+ *
+ * The region lives in .bss, so blocks that have never been handed out are
+ * zero and are carved off the end of their class on demand. Freed blocks are
+ * cleared and pushed onto a per class LIFO free list, which keeps recently
+ * used blocks hot and makes allocation and free a few instructions inside a
+ * critical section.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+#include "heap_pool.h"
+
+#define POOL_MIN_BLOCK_SIZE    ( 16U )
+
+#define POOL_REGION_SIZE                    \
+    ( ( 16U * HEAP_POOL_BLOCKS_16 ) +       \
+      ( 32U * HEAP_POOL_BLOCKS_32 ) +       \
+      ( 64U * HEAP_POOL_BLOCKS_64 ) +       \
+      ( 128U * HEAP_POOL_BLOCKS_128 ) +     \
+      ( 256U * HEAP_POOL_BLOCKS_256 ) +     \
+      ( 512U * HEAP_POOL_BLOCKS_512 ) )
+
+typedef struct HeapPoolBlock
+{
+    struct HeapPoolBlock * pxNext;
+} HeapPoolBlock_t;
+
+typedef struct
+{
+    uint8_t * pucStart;
+    HeapPoolBlock_t * pxFreeList;
+    size_t uxCarved; /*!< Blocks handed out at least once */
+    HeapPoolClassInfo_t xInfo;
+} HeapPoolClass_t;
+
+/* uint64_t keeps every block 8 byte aligned */
+static uint64_t ullPoolRegion[ ( POOL_REGION_SIZE + sizeof( uint64_t ) - 1 ) / sizeof( uint64_t ) ];
+
+static HeapPoolClass_t xClasses[ HEAP_POOL_NUM_CLASSES ] =
+{
+    { .xInfo = { .uxBlockSize = 16, .uxNumBlocks = HEAP_POOL_BLOCKS_16 } },
+    { .xInfo = { .uxBlockSize = 32, .uxNumBlocks = HEAP_POOL_BLOCKS_32 } },
+    { .xInfo = { .uxBlockSize = 64, .uxNumBlocks = HEAP_POOL_BLOCKS_64 } },
+    { .xInfo = { .uxBlockSize = 128, .uxNumBlocks = HEAP_POOL_BLOCKS_128 } },
+    { .xInfo = { .uxBlockSize = 256, .uxNumBlocks = HEAP_POOL_BLOCKS_256 } },
+    { .xInfo = { .uxBlockSize = 512, .uxNumBlocks = HEAP_POOL_BLOCKS_512 } },
+};
+
+/*-----------------------------------------------------------*/
+
+/* Classes are laid out back to back in order of size */
+static uint8_t * prvClassStart( size_t uxClass )
+{
+    uint8_t * pucStart = ( uint8_t * ) ullPoolRegion;
+
+    for( size_t i = 0; i < uxClass; i++ )
+    {
+        pucStart += xClasses[ i ].xInfo.uxBlockSize * xClasses[ i ].xInfo.uxNumBlocks;
+    }
+
+    return pucStart;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Must be called from a critical section */
+static HeapPoolBlock_t * prvTakeBlock( HeapPoolClass_t * pxClass,
+                                       size_t uxClass )
+{
+    HeapPoolBlock_t * pxBlock = pxClass->pxFreeList;
+
+    if( pxBlock != NULL )
+    {
+        pxClass->pxFreeList = pxBlock->pxNext;
+    }
+    else if( pxClass->uxCarved < pxClass->xInfo.uxNumBlocks )
+    {
+        if( pxClass->pucStart == NULL )
+        {
+            pxClass->pucStart = prvClassStart( uxClass );
+        }
+
+        pxBlock = ( HeapPoolBlock_t * ) ( pxClass->pucStart + ( pxClass->uxCarved * pxClass->xInfo.uxBlockSize ) );
+        pxClass->uxCarved++;
+    }
+
+    if( pxBlock != NULL )
+    {
+        pxClass->xInfo.uxInUse++;
+        pxClass->xInfo.ulAllocs++;
+
+        if( pxClass->xInfo.uxInUse > pxClass->xInfo.uxPeak )
+        {
+            pxClass->xInfo.uxPeak = pxClass->xInfo.uxInUse;
+        }
+    }
+
+    return pxBlock;
+}
+
+/*-----------------------------------------------------------*/
+
+void * pvHeapPoolAlloc( size_t uxSize )
+{
+    HeapPoolBlock_t * pxBlock = NULL;
+    size_t uxClass = 0;
+
+    while( ( uxClass < HEAP_POOL_NUM_CLASSES ) &&
+           ( xClasses[ uxClass ].xInfo.uxBlockSize < uxSize ) )
+    {
+        uxClass++;
+    }
+
+    for( size_t i = uxClass; ( i < HEAP_POOL_NUM_CLASSES ) && ( pxBlock == NULL ); i++ )
+    {
+        taskENTER_CRITICAL();
+        {
+            pxBlock = prvTakeBlock( &( xClasses[ i ] ), i );
+
+            if( ( pxBlock == NULL ) &&
+                ( xClasses[ uxClass ].xInfo.uxNumBlocks > 0 ) &&
+                ( i == uxClass ) )
+            {
+                xClasses[ uxClass ].xInfo.ulExhausted++;
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    if( pxBlock != NULL )
+    {
+        /* The rest of the block was cleared when it was freed */
+        pxBlock->pxNext = NULL;
+    }
+
+    return pxBlock;
+}
+
+/*-----------------------------------------------------------*/
+
+bool xHeapPoolContains( const void * pv )
+{
+    return( ( ( const uint8_t * ) pv >= ( const uint8_t * ) ullPoolRegion ) &&
+            ( ( const uint8_t * ) pv < ( ( const uint8_t * ) ullPoolRegion + POOL_REGION_SIZE ) ) );
+}
+
+/*-----------------------------------------------------------*/
+
+bool xHeapPoolFree( void * pv )
+{
+    bool xResult = false;
+
+    if( ( pv != NULL ) &&
+        xHeapPoolContains( pv ) )
+    {
+        uint8_t * pucClassEnd = ( uint8_t * ) ullPoolRegion;
+        size_t uxClass = 0;
+
+        for( uxClass = 0; uxClass < HEAP_POOL_NUM_CLASSES; uxClass++ )
+        {
+            pucClassEnd += xClasses[ uxClass ].xInfo.uxBlockSize * xClasses[ uxClass ].xInfo.uxNumBlocks;
+
+            if( ( uint8_t * ) pv < pucClassEnd )
+            {
+                break;
+            }
+        }
+
+        configASSERT( uxClass < HEAP_POOL_NUM_CLASSES );
+
+        HeapPoolClass_t * pxClass = &( xClasses[ uxClass ] );
+        HeapPoolBlock_t * pxBlock = ( HeapPoolBlock_t * ) pv;
+
+        configASSERT( ( ( ( uint8_t * ) pv - pxClass->pucStart ) % pxClass->xInfo.uxBlockSize ) == 0 );
+
+        explicit_bzero( pv, pxClass->xInfo.uxBlockSize );
+
+        taskENTER_CRITICAL();
+        {
+            pxBlock->pxNext = pxClass->pxFreeList;
+            pxClass->pxFreeList = pxBlock;
+            pxClass->xInfo.uxInUse--;
+        }
+        taskEXIT_CRITICAL();
+
+        xResult = true;
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxHeapPoolGetInfo( HeapPoolClassInfo_t * pxInfo,
+                          size_t uxMaxClasses )
+{
+    size_t uxCount = 0;
+
+    if( pxInfo != NULL )
+    {
+        taskENTER_CRITICAL();
+
+        for( size_t i = 0; ( i < HEAP_POOL_NUM_CLASSES ) && ( uxCount < uxMaxClasses ); i++ )
+        {
+            if( xClasses[ i ].xInfo.uxNumBlocks > 0 )
+            {
+                pxInfo[ uxCount ] = xClasses[ i ].xInfo;
+                uxCount++;
+            }
+        }
+
+        taskEXIT_CRITICAL();
+    }
+
+    return uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+void vHeapPoolResetStats( void )
+{
+    taskENTER_CRITICAL();
+
+    for( size_t i = 0; i < HEAP_POOL_NUM_CLASSES; i++ )
+    {
+        xClasses[ i ].xInfo.uxPeak = xClasses[ i ].xInfo.uxInUse;
+        xClasses[ i ].xInfo.ulExhausted = 0;
+    }
+
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,618 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file heap_track.c
+ * @brief Per task, per call site and per subsystem accounting of FreeRTOS heap allocations.
+ *
+ * The hooks run from pvPortMalloc and vPortFree with the scheduler suspended,
+ * which also serializes access to the tables below. Interrupt handlers must
+ * not allocate.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "heap_track.h"
+
+/*-----------------------------------------------------------*/
+
+void vHeapGetFragInfo( HeapFragInfo_t * pxInfo )
+{
+    HeapStats_t xHeapStats = { 0 };
+
+    if( pxInfo != NULL )
+    {
+        vPortGetHeapStats( &xHeapStats );
+
+        pxInfo->uxFree = xHeapStats.xAvailableHeapSpaceInBytes;
+        pxInfo->uxLargestFree = xHeapStats.xSizeOfLargestFreeBlockInBytes;
+        pxInfo->uxFreeBlocks = xHeapStats.xNumberOfFreeBlocks;
+        pxInfo->ulFragmentationPct = 0;
+
+        if( pxInfo->uxFree > 0 )
+        {
+            pxInfo->ulFragmentationPct = ( uint32_t ) ( 100U - ( ( 100U * ( uint64_t ) pxInfo->uxLargestFree ) / pxInfo->uxFree ) );
+        }
+    }
+}
+
+#if ( configHEAP_TRACKING == 1 )
+
+#define HEAP_TRACK_LIVE_MASK       ( HEAP_TRACK_MAX_LIVE - 1 )
+
+/* Slot 0 collects allocations made before the scheduler started, the last slot those of tasks that did not fit */
+#define HEAP_TRACK_TASK_INIT       ( 0 )
+#define HEAP_TRACK_TASK_OTHER      ( HEAP_TRACK_MAX_TASKS - 1 )
+
+/* The last site slot collects sites that did not fit */
+#define HEAP_TRACK_SITE_OTHER      ( HEAP_TRACK_MAX_SITES - 1 )
+
+/* Trace event encoding */
+#define HEAP_TRACE_FREE_FLAG       ( 1UL << 31 )
+#define HEAP_TRACE_SUBSYS_SHIFT    ( 24 )
+#define HEAP_TRACE_SIZE_MASK       ( ( 1UL << HEAP_TRACE_SUBSYS_SHIFT ) - 1 )
+
+static_assert( ( HEAP_TRACK_MAX_LIVE & HEAP_TRACK_LIVE_MASK ) == 0, "HEAP_TRACK_MAX_LIVE must be a power of two" );
+static_assert( HEAP_TRACK_MAX_TASKS <= UINT8_MAX, "Task index must fit in a uint8_t" );
+static_assert( HEAP_TRACK_MAX_SITES <= UINT8_MAX, "Site index must fit in a uint8_t" );
+
+typedef struct
+{
+    void * pvAddress;
+    uint32_t ulSize;
+    uint8_t ucTask;
+    uint8_t ucSite;
+    uint8_t ucSubsys;
+} HeapTrackLive_t;
+
+typedef struct
+{
+    uint32_t ulAddress;
+    uint32_t ulInfo; /*!< Free flag, subsystem and size */
+} HeapTraceEvent_t;
+
+static HeapTrackLive_t xLive[ HEAP_TRACK_MAX_LIVE ] = { 0 };
+
+static TaskHandle_t pxTaskHandles[ HEAP_TRACK_MAX_TASKS ] = { 0 };
+static HeapTrackTaskInfo_t xTasks[ HEAP_TRACK_MAX_TASKS ] = { 0 };
+static size_t uxNumTasks = 1;
+
+static HeapTrackSiteInfo_t xSites[ HEAP_TRACK_MAX_SITES ] = { 0 };
+static size_t uxNumSites = 0;
+
+static HeapTrackStats_t xStats = { 0 };
+
+/* Set by pvHeapTrackMalloc for the duration of its pvPortMalloc call */
+static void * pvPendingSite = NULL;
+static HeapSubsys_t xPendingSubsys = HEAP_SUBSYS_OTHER;
+
+static HeapTraceEvent_t * pxTraceEvents = NULL;
+static size_t uxTraceMaxEvents = 0;
+static size_t uxTraceCount = 0;
+static size_t uxTraceDropped = 0;
+static bool xTraceActive = false;
+
+static const char * const pcSubsysNames[ HEAP_SUBSYS_MAX ] =
+{
+    [ HEAP_SUBSYS_OTHER ]   = "other",
+    [ HEAP_SUBSYS_TLS ]     = "tls",
+    [ HEAP_SUBSYS_LIBC ]    = "libc",
+    [ HEAP_SUBSYS_FS ]      = "fs",
+    [ HEAP_SUBSYS_KVSTORE ] = "kvstore",
+};
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvLiveHome( const void * pvAddress )
+{
+    return ( ( ( ( uint32_t ) ( uintptr_t ) pvAddress >> 3 ) * 2654435761UL ) >> 16 ) & HEAP_TRACK_LIVE_MASK;
+}
+
+/*-----------------------------------------------------------*/
+
+static inline void prvCountAlloc( HeapTrackCounters_t * pxCounters,
+                                  uint32_t ulSize )
+{
+    pxCounters->ulCurrent += ulSize;
+    pxCounters->ulAllocs++;
+
+    if( pxCounters->ulCurrent > pxCounters->ulPeak )
+    {
+        pxCounters->ulPeak = pxCounters->ulCurrent;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static inline void prvCountFree( HeapTrackCounters_t * pxCounters,
+                                 uint32_t ulSize )
+{
+    pxCounters->ulCurrent -= ulSize;
+    pxCounters->ulFrees++;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t prvTaskIndex( void )
+{
+    size_t uxIndex = HEAP_TRACK_TASK_INIT;
+
+    if( xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED )
+    {
+        TaskHandle_t xTask = xTaskGetCurrentTaskHandle();
+
+        for( uxIndex = 1; uxIndex < uxNumTasks; uxIndex++ )
+        {
+            if( pxTaskHandles[ uxIndex ] == xTask )
+            {
+                break;
+            }
+        }
+
+        if( uxIndex == uxNumTasks )
+        {
+            if( uxNumTasks < HEAP_TRACK_TASK_OTHER )
+            {
+                pxTaskHandles[ uxIndex ] = xTask;
+                ( void ) strncpy( xTasks[ uxIndex ].pcName, pcTaskGetName( xTask ), HEAP_TRACK_NAME_LEN - 1 );
+                uxNumTasks++;
+            }
+            else
+            {
+                uxIndex = HEAP_TRACK_TASK_OTHER;
+            }
+        }
+    }
+
+    return ( uint8_t ) uxIndex;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t prvSiteIndex( void * pvSite,
+                             HeapSubsys_t xSubsys )
+{
+    size_t uxIndex = 0;
+
+    for( uxIndex = 0; uxIndex < uxNumSites; uxIndex++ )
+    {
+        if( xSites[ uxIndex ].pvSite == pvSite )
+        {
+            break;
+        }
+    }
+
+    if( uxIndex == uxNumSites )
+    {
+        if( uxNumSites < HEAP_TRACK_SITE_OTHER )
+        {
+            xSites[ uxIndex ].pvSite = pvSite;
+            xSites[ uxIndex ].xSubsys = xSubsys;
+            uxNumSites++;
+        }
+        else
+        {
+            uxIndex = HEAP_TRACK_SITE_OTHER;
+        }
+    }
+
+    return ( uint8_t ) uxIndex;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvTraceRecord( void * pvAddress,
+                            uint32_t ulInfo )
+{
+    if( xTraceActive )
+    {
+        if( uxTraceCount < uxTraceMaxEvents )
+        {
+            pxTraceEvents[ uxTraceCount ].ulAddress = ( uint32_t ) ( uintptr_t ) pvAddress;
+            pxTraceEvents[ uxTraceCount ].ulInfo = ulInfo;
+            uxTraceCount++;
+        }
+        else
+        {
+            uxTraceDropped++;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Remove a slot from the live table, moving later entries of the same probe sequence back */
+static void prvLiveRemove( uint32_t ulSlot )
+{
+    uint32_t ulNext = ulSlot;
+
+    for( ; ; )
+    {
+        ulNext = ( ulNext + 1 ) & HEAP_TRACK_LIVE_MASK;
+
+        if( xLive[ ulNext ].pvAddress == NULL )
+        {
+            break;
+        }
+
+        uint32_t ulHome = prvLiveHome( xLive[ ulNext ].pvAddress );
+
+        /* Move the entry if its home slot is not cyclically within ( ulSlot, ulNext ] */
+        if( ( ( ulNext - ulHome ) & HEAP_TRACK_LIVE_MASK ) >= ( ( ulNext - ulSlot ) & HEAP_TRACK_LIVE_MASK ) )
+        {
+            xLive[ ulSlot ] = xLive[ ulNext ];
+            ulSlot = ulNext;
+        }
+    }
+
+    ( void ) memset( &( xLive[ ulSlot ] ), 0, sizeof( HeapTrackLive_t ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void * pvHeapTrackMalloc( HeapSubsys_t xSubsys,
+                          size_t uxSize )
+{
+    void * pvBuffer = NULL;
+
+    vTaskSuspendAll();
+    {
+        pvPendingSite = __builtin_return_address( 0 );
+        xPendingSubsys = xSubsys;
+
+        pvBuffer = pvPortMalloc( uxSize );
+
+        pvPendingSite = NULL;
+        xPendingSubsys = HEAP_SUBSYS_OTHER;
+    }
+    ( void ) xTaskResumeAll();
+
+    return pvBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+void vHeapTrackMalloc( void * pvAddress,
+                       size_t uxSize,
+                       void * pvCaller )
+{
+    HeapSubsys_t xSubsys = xPendingSubsys;
+    void * pvSite = ( pvPendingSite != NULL ) ? pvPendingSite : pvCaller;
+
+    if( pvAddress == NULL )
+    {
+        xStats.ulFailures++;
+    }
+    else if( xStats.ulLive >= ( HEAP_TRACK_MAX_LIVE - 1 ) )
+    {
+        /* Keep one slot empty so that probe sequences terminate */
+        xStats.ulUntracked++;
+    }
+    else
+    {
+        uint32_t ulSlot = prvLiveHome( pvAddress );
+        uint8_t ucTask = prvTaskIndex();
+        uint8_t ucSite = prvSiteIndex( pvSite, xSubsys );
+
+        while( xLive[ ulSlot ].pvAddress != NULL )
+        {
+            ulSlot = ( ulSlot + 1 ) & HEAP_TRACK_LIVE_MASK;
+        }
+
+        xLive[ ulSlot ].pvAddress = pvAddress;
+        xLive[ ulSlot ].ulSize = ( uint32_t ) uxSize;
+        xLive[ ulSlot ].ucTask = ucTask;
+        xLive[ ulSlot ].ucSite = ucSite;
+        xLive[ ulSlot ].ucSubsys = ( uint8_t ) xSubsys;
+        xStats.ulLive++;
+
+        prvCountAlloc( &( xTasks[ ucTask ].xCounters ), ( uint32_t ) uxSize );
+        prvCountAlloc( &( xSites[ ucSite ].xCounters ), ( uint32_t ) uxSize );
+        prvCountAlloc( &( xStats.pxSubsys[ xSubsys ] ), ( uint32_t ) uxSize );
+
+        prvTraceRecord( pvAddress,
+                        ( ( uint32_t ) xSubsys << HEAP_TRACE_SUBSYS_SHIFT ) |
+                        ( ( uint32_t ) uxSize & HEAP_TRACE_SIZE_MASK ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vHeapTrackFree( void * pvAddress,
+                     size_t uxSize )
+{
+    uint32_t ulSlot = prvLiveHome( pvAddress );
+
+    ( void ) uxSize;
+
+    while( ( xLive[ ulSlot ].pvAddress != NULL ) &&
+           ( xLive[ ulSlot ].pvAddress != pvAddress ) )
+    {
+        ulSlot = ( ulSlot + 1 ) & HEAP_TRACK_LIVE_MASK;
+    }
+
+    /* Blocks allocated while the live table was full are not found */
+    if( xLive[ ulSlot ].pvAddress != NULL )
+    {
+        HeapTrackLive_t * pxEntry = &( xLive[ ulSlot ] );
+
+        /* Use the size recorded at allocation, heap_4 may have handed out a slightly larger block */
+        prvCountFree( &( xTasks[ pxEntry->ucTask ].xCounters ), pxEntry->ulSize );
+        prvCountFree( &( xSites[ pxEntry->ucSite ].xCounters ), pxEntry->ulSize );
+        prvCountFree( &( xStats.pxSubsys[ pxEntry->ucSubsys ] ), pxEntry->ulSize );
+
+        prvLiveRemove( ulSlot );
+        xStats.ulLive--;
+
+        prvTraceRecord( pvAddress, HEAP_TRACE_FREE_FLAG );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vHeapTrackGetStats( HeapTrackStats_t * pxStats )
+{
+    if( pxStats != NULL )
+    {
+        vTaskSuspendAll();
+        ( void ) memcpy( pxStats, &xStats, sizeof( HeapTrackStats_t ) );
+        ( void ) xTaskResumeAll();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxHeapTrackGetTasks( HeapTrackTaskInfo_t * pxTasks,
+                            size_t uxMaxTasks )
+{
+    size_t uxCount = 0;
+
+    if( pxTasks != NULL )
+    {
+        vTaskSuspendAll();
+
+        for( size_t i = 0; ( i < HEAP_TRACK_MAX_TASKS ) && ( uxCount < uxMaxTasks ); i++ )
+        {
+            if( ( i < uxNumTasks ) ||
+                ( xTasks[ i ].xCounters.ulAllocs > 0 ) )
+            {
+                pxTasks[ uxCount ] = xTasks[ i ];
+
+                if( i == HEAP_TRACK_TASK_INIT )
+                {
+                    ( void ) strncpy( pxTasks[ uxCount ].pcName, "(init)", HEAP_TRACK_NAME_LEN );
+                }
+                else if( i == HEAP_TRACK_TASK_OTHER )
+                {
+                    ( void ) strncpy( pxTasks[ uxCount ].pcName, "(other)", HEAP_TRACK_NAME_LEN );
+                }
+
+                uxCount++;
+            }
+        }
+
+        ( void ) xTaskResumeAll();
+    }
+
+    return uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxHeapTrackGetSites( HeapTrackSiteInfo_t * pxSites,
+                            size_t uxMaxSites )
+{
+    size_t uxCount = 0;
+
+    if( pxSites != NULL )
+    {
+        vTaskSuspendAll();
+
+        for( size_t i = 0; ( i < HEAP_TRACK_MAX_SITES ) && ( uxCount < uxMaxSites ); i++ )
+        {
+            if( ( i < uxNumSites ) ||
+                ( xSites[ i ].xCounters.ulAllocs > 0 ) )
+            {
+                pxSites[ uxCount ] = xSites[ i ];
+                uxCount++;
+            }
+        }
+
+        ( void ) xTaskResumeAll();
+    }
+
+    return uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+void vHeapTrackResetPeaks( void )
+{
+    vTaskSuspendAll();
+
+    for( size_t i = 0; i < HEAP_TRACK_MAX_TASKS; i++ )
+    {
+        xTasks[ i ].xCounters.ulPeak = xTasks[ i ].xCounters.ulCurrent;
+    }
+
+    for( size_t i = 0; i < HEAP_TRACK_MAX_SITES; i++ )
+    {
+        xSites[ i ].xCounters.ulPeak = xSites[ i ].xCounters.ulCurrent;
+    }
+
+    for( size_t i = 0; i < HEAP_SUBSYS_MAX; i++ )
+    {
+        xStats.pxSubsys[ i ].ulPeak = xStats.pxSubsys[ i ].ulCurrent;
+    }
+
+    ( void ) xTaskResumeAll();
+}
+
+/*-----------------------------------------------------------*/
+
+bool xHeapTrackTraceStart( size_t uxMaxEvents )
+{
+    bool xResult = true;
+
+    vTaskSuspendAll();
+    xTraceActive = false;
+    ( void ) xTaskResumeAll();
+
+    if( ( pxTraceEvents == NULL ) ||
+        ( uxTraceMaxEvents != uxMaxEvents ) )
+    {
+        vHeapTrackTraceClear();
+        pxTraceEvents = pvPortMalloc( uxMaxEvents * sizeof( HeapTraceEvent_t ) );
+    }
+
+    if( pxTraceEvents == NULL )
+    {
+        xResult = false;
+    }
+    else
+    {
+        vTaskSuspendAll();
+        uxTraceMaxEvents = uxMaxEvents;
+        uxTraceCount = 0;
+        uxTraceDropped = 0;
+        xTraceActive = true;
+        ( void ) xTaskResumeAll();
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+void vHeapTrackTraceStop( void )
+{
+    vTaskSuspendAll();
+    xTraceActive = false;
+    ( void ) xTaskResumeAll();
+}
+
+/*-----------------------------------------------------------*/
+
+void vHeapTrackTraceClear( void )
+{
+    HeapTraceEvent_t * pxEvents = NULL;
+
+    vTaskSuspendAll();
+    xTraceActive = false;
+    pxEvents = pxTraceEvents;
+    pxTraceEvents = NULL;
+    uxTraceMaxEvents = 0;
+    uxTraceCount = 0;
+    uxTraceDropped = 0;
+    ( void ) xTaskResumeAll();
+
+    vPortFree( pxEvents );
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxHeapTrackTraceFormat( size_t * puxIndex,
+                               char * pcBuffer,
+                               size_t uxBufferLen )
+{
+    HeapTraceEvent_t xEvent = { 0 };
+    bool xValid = false;
+    int lLen = 0;
+
+    if( ( puxIndex != NULL ) && ( pcBuffer != NULL ) )
+    {
+        vTaskSuspendAll();
+
+        if( *puxIndex < uxTraceCount )
+        {
+            xEvent = pxTraceEvents[ *puxIndex ];
+            xValid = true;
+        }
+
+        ( void ) xTaskResumeAll();
+    }
+
+    if( xValid )
+    {
+        if( xEvent.ulInfo & HEAP_TRACE_FREE_FLAG )
+        {
+            lLen = snprintf( pcBuffer, uxBufferLen, "f %08lx\r\n", ( unsigned long ) xEvent.ulAddress );
+        }
+        else
+        {
+            lLen = snprintf( pcBuffer, uxBufferLen, "m %08lx %lu %s\r\n",
+                             ( unsigned long ) xEvent.ulAddress,
+                             ( unsigned long ) ( xEvent.ulInfo & HEAP_TRACE_SIZE_MASK ),
+                             pcHeapTrackSubsysName( ( HeapSubsys_t ) ( ( xEvent.ulInfo & ~HEAP_TRACE_FREE_FLAG ) >> HEAP_TRACE_SUBSYS_SHIFT ) ) );
+        }
+
+        ( *puxIndex )++;
+    }
+
+    if( ( lLen < 0 ) || ( ( size_t ) lLen >= uxBufferLen ) )
+    {
+        lLen = 0;
+    }
+
+    return ( size_t ) lLen;
+}
+
+/*-----------------------------------------------------------*/
+
+void vHeapTrackTraceGetCounts( size_t * puxRecorded,
+                               size_t * puxDropped )
+{
+    vTaskSuspendAll();
+
+    if( puxRecorded != NULL )
+    {
+        *puxRecorded = uxTraceCount;
+    }
+
+    if( puxDropped != NULL )
+    {
+        *puxDropped = uxTraceDropped;
+    }
+
+    ( void ) xTaskResumeAll();
+}
+
+/*-----------------------------------------------------------*/
+
+const char * pcHeapTrackSubsysName( HeapSubsys_t xSubsys )
+{
+    const char * pcName = "unknown";
+
+    if( xSubsys < HEAP_SUBSYS_MAX )
+    {
+        pcName = pcSubsysNames[ xSubsys ];
+    }
+
+    return pcName;
+}
+
+#endif /* configHEAP_TRACKING */
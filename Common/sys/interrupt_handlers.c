@@ -32,11 +32,20 @@
 static GPIOInterruptCallback_t volatile xGpioCallbacks[ 16 ] = { NULL };
 static void * volatile xGpioCallbackContext[ 16 ] = { NULL };
 
+__attribute__( ( weak ) ) bool xFlashEccErrorHook( void )
+{
+    return false;
+}
+
 void NMI_Handler( void )
 {
-    while( 1 )
+    /* A double ECC error in flash raises an NMI, the code reading the flash may expect it */
+    if( xFlashEccErrorHook() == false )
     {
-        __NOP();
+        while( 1 )
+        {
+            __NOP();
+        }
     }
 }
 
@@ -133,6 +142,11 @@ void DebugMon_Handler( void )
 }
 
 /* STM32U5xx Peripheral Interrupt Handlers */
+void EXTI11_IRQHandler( void )
+{
+    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_11 );
+}
+
 void EXTI14_IRQHandler( void )
 {
     HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_14 );
@@ -41,12 +41,19 @@
 #include "mbedtls/entropy.h"
 
 #include "mbedtls_freertos_port.h"
+#include "heap_arena.h"
+#include "heap_pool.h"
+#include "heap_track.h"
 
 /*-----------------------------------------------------------*/
 
 /**
  * @brief Allocates memory for an array of members.
  *
+ * Small allocations are served from the size class pools. Others are taken
+ * from the arena bound to the calling task if there is one and it has room,
+ * otherwise from the FreeRTOS heap.
+ *
  * @param[in] nmemb Number of members that need to be allocated.
  * @param[in] size Size of each member.
  *
@@ -64,11 +71,22 @@ void * mbedtls_platform_calloc( size_t nmemb,
         /* Overflow check. */
         if( ( totalSize / size ) == nmemb )
         {
-            pBuffer = pvPortMalloc( totalSize );
+            /* Pool blocks are cleared when they are freed */
+            pBuffer = pvHeapPoolAlloc( totalSize );
 
-            if( pBuffer != NULL )
+            if( pBuffer == NULL )
             {
-                explicit_bzero( pBuffer, totalSize );
+                pBuffer = pvHeapArenaAlloc( pxHeapArenaGetBound(), totalSize );
+
+                if( pBuffer == NULL )
+                {
+                    pBuffer = pvHeapTrackMalloc( HEAP_SUBSYS_TLS, totalSize );
+                }
+
+                if( pBuffer != NULL )
+                {
+                    explicit_bzero( pBuffer, totalSize );
+                }
             }
         }
     }
@@ -85,12 +103,32 @@ void * mbedtls_platform_calloc( size_t nmemb,
  */
 void mbedtls_platform_free( void * ptr )
 {
-    size_t xBlockLen = malloc_usable_size( ptr );
+    size_t xBlockLen = 0;
 
-    if( xBlockLen > 0 )
+    if( xHeapPoolContains( ptr ) )
     {
-        explicit_bzero( ptr, xBlockLen );
-        vPortFree( ptr );
+        /* Clears the block */
+        ( void ) xHeapPoolFree( ptr );
+    }
+    else
+    {
+        xBlockLen = uxHeapArenaBlockSize( ptr );
+
+        if( xBlockLen > 0 )
+        {
+            explicit_bzero( ptr, xBlockLen );
+            ( void ) xHeapArenaFree( ptr );
+        }
+        else
+        {
+            xBlockLen = malloc_usable_size( ptr );
+
+            if( xBlockLen > 0 )
+            {
+                explicit_bzero( ptr, xBlockLen );
+                vPortFree( ptr );
+            }
+        }
     }
 }
 
@@ -30,6 +30,8 @@
 #include <malloc.h>
 #include <string.h>
 
+#include "heap_track.h"
+
 /* copied from heap_4.c */
 typedef struct A_BLOCK_LINK
 {
@@ -40,20 +42,20 @@ typedef struct A_BLOCK_LINK
 /* Override newlibc memory allocator functions */
 void * malloc( size_t xLen )
 {
-    return pvPortMalloc( xLen );
+    return pvHeapTrackMalloc( HEAP_SUBSYS_LIBC, xLen );
 }
 
 void * _malloc_r( struct _reent * pxReent,
                   size_t xLen )
 {
     ( void ) pxReent;
-    return pvPortMalloc( xLen );
+    return pvHeapTrackMalloc( HEAP_SUBSYS_LIBC, xLen );
 }
 
 void * calloc( size_t xNum,
                size_t xLen )
 {
-    void * pvBuffer = pvPortMalloc( xNum * xLen );
+    void * pvBuffer = pvHeapTrackMalloc( HEAP_SUBSYS_LIBC, xNum * xLen );
 
     if( pvBuffer != NULL )
     {
@@ -103,7 +105,7 @@ void * realloc( void * pvPtr,
 
     if( pvPtr == NULL )
     {
-        pvNewBuff = pvPortMalloc( xNewLen );
+        pvNewBuff = pvHeapTrackMalloc( HEAP_SUBSYS_LIBC, xNewLen );
     }
     else /* pvPtr is not NULL */
     {
@@ -116,7 +118,7 @@ void * realloc( void * pvPtr,
         }
         else
         {
-            pvNewBuff = pvPortMalloc( xNewLen );
+            pvNewBuff = pvHeapTrackMalloc( HEAP_SUBSYS_LIBC, xNewLen );
         }
 
         if( pvNewBuff != NULL )
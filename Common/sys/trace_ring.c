@@ -0,0 +1,326 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file trace_ring.c
+ * @brief Cycle counter timestamped trace points for the hot paths.
+ *
+ * Events are written with interrupts up to configMAX_SYSCALL_INTERRUPT_PRIORITY
+ * masked, which takes a few tens of cycles and never blocks. The ring head is
+ * a free running event counter, so the number of overwritten events is known
+ * when the ring is dumped.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+#include "hw_defs.h"
+#include "trace_ring.h"
+
+#if ( configTRACE_POINTS == 1 )
+
+#define TRACE_HEADER_LEN       ( 20 )
+#define TRACE_TASK_ENTRY_MAX   ( 5 + configMAX_TASK_NAME_LEN )
+
+static const char * const pcTraceIdNames[ TRACE_ID_MAX ] =
+{
+    "agent_cmd",
+    "agent_enqueue",
+    "spi_xfer",
+    "tls_read",
+    "tls_write",
+    "ota_write_block",
+    "lfs_read",
+    "lfs_prog",
+    "lfs_erase",
+};
+
+static TraceEvent_t pxTraceRing[ TRACE_RING_NUM_EVENTS ];
+static uint32_t ulTraceHead = 0;
+static bool xTraceEnabled = true;
+
+/* Dump image state, owned by the task running the dump */
+static uint8_t * pucDumpMeta = NULL;
+static size_t uxDumpMetaLen = 0;
+static uint32_t ulDumpFirst = 0;
+static uint32_t ulDumpCount = 0;
+static bool xResumeAfterDump = false;
+
+/*-----------------------------------------------------------*/
+
+void vTraceRecord( TraceId_t xId,
+                   TraceType_t xType,
+                   uint32_t ulArg )
+{
+    UBaseType_t uxSavedMask = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    if( xTraceEnabled )
+    {
+        TraceEvent_t * pxEvent = &( pxTraceRing[ ulTraceHead & ( TRACE_RING_NUM_EVENTS - 1 ) ] );
+
+        pxEvent->ulCycles = ulGetCycleCount();
+        pxEvent->ulTask = ( uint32_t ) ( uintptr_t ) xTaskGetCurrentTaskHandle();
+        pxEvent->ulArg = ulArg;
+        pxEvent->ucId = ( uint8_t ) xId;
+        pxEvent->ucType = ( uint8_t ) xType;
+        pxEvent->usReserved = 0;
+
+        ulTraceHead++;
+    }
+
+    portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedMask );
+}
+
+/*-----------------------------------------------------------*/
+
+void vTraceStart( void )
+{
+    taskENTER_CRITICAL();
+    xTraceEnabled = true;
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+void vTraceStop( void )
+{
+    taskENTER_CRITICAL();
+    xTraceEnabled = false;
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+void vTraceClear( void )
+{
+    taskENTER_CRITICAL();
+    ulTraceHead = 0;
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+void vTraceGetStatus( TraceStatus_t * pxStatus )
+{
+    configASSERT( pxStatus != NULL );
+
+    taskENTER_CRITICAL();
+    pxStatus->xEnabled = xTraceEnabled;
+    pxStatus->ulRecorded = ulTraceHead;
+    taskEXIT_CRITICAL();
+
+    pxStatus->ulCapacity = TRACE_RING_NUM_EVENTS;
+}
+
+/*-----------------------------------------------------------*/
+
+const char * pcTraceIdName( TraceId_t xId )
+{
+    const char * pcName = "unknown";
+
+    if( xId < TRACE_ID_MAX )
+    {
+        pcName = pcTraceIdNames[ xId ];
+    }
+
+    return pcName;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * prvPutLe32( uint8_t * pucOut,
+                             uint32_t ulValue )
+{
+    pucOut[ 0 ] = ( uint8_t ) ulValue;
+    pucOut[ 1 ] = ( uint8_t ) ( ulValue >> 8 );
+    pucOut[ 2 ] = ( uint8_t ) ( ulValue >> 16 );
+    pucOut[ 3 ] = ( uint8_t ) ( ulValue >> 24 );
+
+    return &( pucOut[ 4 ] );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * prvPutName( uint8_t * pucOut,
+                             const char * pcName )
+{
+    size_t uxLen = strnlen( pcName, configMAX_TASK_NAME_LEN );
+
+    *pucOut = ( uint8_t ) uxLen;
+    ( void ) memcpy( &( pucOut[ 1 ] ), pcName, uxLen );
+
+    return &( pucOut[ 1 + uxLen ] );
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxTraceDumpBegin( void )
+{
+    UBaseType_t uxNumTasks = uxTaskGetNumberOfTasks();
+    TaskStatus_t * pxTasks = NULL;
+    size_t uxMetaMax = 0;
+    size_t uxDumpLen = 0;
+
+    vTraceDumpEnd();
+
+    taskENTER_CRITICAL();
+    {
+        xResumeAfterDump = xTraceEnabled;
+        xTraceEnabled = false;
+
+        if( ulTraceHead > TRACE_RING_NUM_EVENTS )
+        {
+            ulDumpCount = TRACE_RING_NUM_EVENTS;
+            ulDumpFirst = ulTraceHead - TRACE_RING_NUM_EVENTS;
+        }
+        else
+        {
+            ulDumpCount = ulTraceHead;
+            ulDumpFirst = 0;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    /* Leave room for tasks created while the system state is read */
+    uxNumTasks += 2;
+
+    uxMetaMax = TRACE_HEADER_LEN + ( TRACE_ID_MAX * TRACE_TASK_ENTRY_MAX ) + ( uxNumTasks * TRACE_TASK_ENTRY_MAX );
+
+    pxTasks = pvPortMalloc( uxNumTasks * sizeof( TaskStatus_t ) );
+    pucDumpMeta = pvPortMalloc( uxMetaMax );
+
+    if( ( pxTasks != NULL ) &&
+        ( pucDumpMeta != NULL ) )
+    {
+        uint8_t * pucOut = pucDumpMeta;
+
+        uxNumTasks = uxTaskGetSystemState( pxTasks, uxNumTasks, NULL );
+
+        ( void ) memcpy( pucOut, TRACE_DUMP_MAGIC, 4 );
+        pucOut[ 4 ] = TRACE_DUMP_VERSION;
+        pucOut[ 5 ] = ( uint8_t ) sizeof( TraceEvent_t );
+        pucOut[ 6 ] = ( uint8_t ) TRACE_ID_MAX;
+        pucOut[ 7 ] = ( uint8_t ) uxNumTasks;
+        pucOut = prvPutLe32( &( pucOut[ 8 ] ), SystemCoreClock );
+        pucOut = prvPutLe32( pucOut, ulDumpCount );
+        pucOut = prvPutLe32( pucOut, ulDumpFirst );
+
+        for( uint32_t i = 0; i < TRACE_ID_MAX; i++ )
+        {
+            pucOut = prvPutName( pucOut, pcTraceIdNames[ i ] );
+        }
+
+        for( UBaseType_t i = 0; i < uxNumTasks; i++ )
+        {
+            pucOut = prvPutLe32( pucOut, ( uint32_t ) ( uintptr_t ) pxTasks[ i ].xHandle );
+            pucOut = prvPutName( pucOut, pxTasks[ i ].pcTaskName );
+        }
+
+        uxDumpMetaLen = ( size_t ) ( pucOut - pucDumpMeta );
+        uxDumpLen = uxDumpMetaLen + ( ulDumpCount * sizeof( TraceEvent_t ) );
+    }
+    else
+    {
+        vPortFree( pucDumpMeta );
+        pucDumpMeta = NULL;
+
+        if( xResumeAfterDump )
+        {
+            vTraceStart();
+        }
+    }
+
+    vPortFree( pxTasks );
+
+    return uxDumpLen;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxTraceDumpRead( size_t uxOffset,
+                        uint8_t * pucBuffer,
+                        size_t uxLen )
+{
+    size_t uxCopied = 0;
+
+    configASSERT( pucBuffer != NULL );
+
+    if( pucDumpMeta != NULL )
+    {
+        while( uxCopied < uxLen )
+        {
+            size_t uxPos = uxOffset + uxCopied;
+            size_t uxChunk = 0;
+            const uint8_t * pucSrc = NULL;
+
+            if( uxPos < uxDumpMetaLen )
+            {
+                pucSrc = &( pucDumpMeta[ uxPos ] );
+                uxChunk = uxDumpMetaLen - uxPos;
+            }
+            else if( uxPos < ( uxDumpMetaLen + ( ulDumpCount * sizeof( TraceEvent_t ) ) ) )
+            {
+                size_t uxEventOffset = uxPos - uxDumpMetaLen;
+                uint32_t ulEvent = ulDumpFirst + ( uint32_t ) ( uxEventOffset / sizeof( TraceEvent_t ) );
+                size_t uxWithinEvent = uxEventOffset % sizeof( TraceEvent_t );
+
+                pucSrc = &( ( ( const uint8_t * ) &( pxTraceRing[ ulEvent & ( TRACE_RING_NUM_EVENTS - 1 ) ] ) )[ uxWithinEvent ] );
+                uxChunk = sizeof( TraceEvent_t ) - uxWithinEvent;
+            }
+            else
+            {
+                break;
+            }
+
+            if( uxChunk > ( uxLen - uxCopied ) )
+            {
+                uxChunk = uxLen - uxCopied;
+            }
+
+            ( void ) memcpy( &( pucBuffer[ uxCopied ] ), pucSrc, uxChunk );
+            uxCopied += uxChunk;
+        }
+    }
+
+    return uxCopied;
+}
+
+/*-----------------------------------------------------------*/
+
+void vTraceDumpEnd( void )
+{
+    if( pucDumpMeta != NULL )
+    {
+        vPortFree( pucDumpMeta );
+        pucDumpMeta = NULL;
+        uxDumpMetaLen = 0;
+
+        if( xResumeAfterDump )
+        {
+            vTraceStart();
+        }
+    }
+}
+
+#endif /* configTRACE_POINTS */
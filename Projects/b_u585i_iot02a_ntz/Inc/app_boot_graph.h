@@ -0,0 +1,68 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/*
+ * Boot stages run by vInitTask in app_main.c, and their dependencies.
+ * Projects/posix_host/Src/bench/boot_timeline_check.c builds its graph from the
+ * same table, so it checks the critical path of the stages the firmware runs.
+ *
+ * X( id, name, function, dependencies, stack depth, priority )
+ */
+
+#ifndef APP_BOOT_GRAPH_H_
+#define APP_BOOT_GRAPH_H_
+
+#include "iotconnect_config.h"
+#include "app/boot_timeline.h"
+
+#ifdef IOTCONFIG_ENABLE_OTA
+    /* The OTA PAL state is kept outside of the filesystem */
+    #define APP_BOOT_STAGE_OTA( X )    X( APP_STAGE_OTA, "ota", prvStageOta, 0, 1024, 8 )
+    #define APP_STAGE_DEPS_APP         ( BOOT_STAGE_DEP( APP_STAGE_KVSTORE ) | BOOT_STAGE_DEP( APP_STAGE_OTA ) )
+#else
+    #define APP_BOOT_STAGE_OTA( X )
+    #define APP_STAGE_DEPS_APP         ( BOOT_STAGE_DEP( APP_STAGE_KVSTORE ) )
+#endif
+
+#define APP_BOOT_STAGE_TABLE( X )                                                              \
+    X( APP_STAGE_FS,      "fs",      prvStageFs,      0,                              1024, 8 ) \
+    APP_BOOT_STAGE_OTA( X )                                                                    \
+    X( APP_STAGE_KVSTORE, "kvstore", prvStageKvStore, BOOT_STAGE_DEP( APP_STAGE_FS ), 1024, 8 ) \
+    X( APP_STAGE_NET,     "net",     prvStageNet,     0,                              512,  8 ) \
+    X( APP_STAGE_SENSORS, "sensors", prvStageSensors, 0,                              512,  8 ) \
+    X( APP_STAGE_APP,     "app",     prvStageApp,     APP_STAGE_DEPS_APP,             512,  8 )
+
+#define APP_BOOT_STAGE_ID( xId, pcName, xFunction, ulDependsOn, uxStackDepth, uxPriority )    xId,
+
+typedef enum
+{
+    APP_BOOT_STAGE_TABLE( APP_BOOT_STAGE_ID )
+    APP_STAGE_MAX
+} AppBootStage_t;
+
+#endif /* APP_BOOT_GRAPH_H_ */
@@ -36,6 +36,9 @@
 
 #define KV_STORE_NVIMPL_ARM_PSA     0
 
+/* Define KV_STORE_SNAPSHOT_ENABLE to 1 to also store the whole cache as one image, read in one go at boot */
+#define KV_STORE_SNAPSHOT_ENABLE    1
+
 #define KVSTORE_KEY_MAX_LEN         16
 #define KVSTORE_VAL_MAX_LEN         256
 
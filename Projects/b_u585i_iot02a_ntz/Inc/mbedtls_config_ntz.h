@@ -3039,8 +3039,9 @@ void mbedtls_platform_free( void * ptr );
 /*#define MBEDTLS_HMAC_DRBG_MAX_SEED_INPUT      384 / **< Maximum size of (re)seed buffer * / */
 
 /* ECP options */
-/*#define MBEDTLS_ECP_WINDOW_SIZE            4 / **< Maximum window size used * / */
-/*#define MBEDTLS_ECP_FIXED_POINT_OPTIM      1 / **< Enable fixed-point speed-up * / */
+/* A window size of 5 lets ota_pal_sig_verify.c keep a 16 point table for the OTA signing key */
+#define MBEDTLS_ECP_WINDOW_SIZE          5 /**< Maximum window size used */
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM    1 /**< Enable fixed-point speed-up */
 
 /* Entropy options */
 /*#define MBEDTLS_ENTROPY_MAX_SOURCES                20 / **< Maximum number of sources supported * / */
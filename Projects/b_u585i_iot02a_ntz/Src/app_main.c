@@ -37,6 +37,9 @@
 #include "stm32u5xx.h"
 #include "kvstore.h"
 #include "hw_defs.h"
+#include "app/boot_metrics.h"
+#include "app/boot_stages.h"
+#include "app_boot_graph.h"
 #include <string.h>
 
 #include "lfs.h"
@@ -46,7 +49,9 @@
 #include "test_execution_config.h"
 
 #include "cli/cli.h"
+#include "cli/cli_prv.h"
 #include "ota_pal.h"
+#include "ota_pal_state_log.h"
 
 #include "iotconnect_app.h"
 
@@ -61,6 +66,8 @@
         * ( OTA_PAL_TEST_ENABLED == 1 ) || ( OTA_E2E_TEST_ENABLED == 1 ) || ( CORE_PKCS11_TEST_ENABLED == 1 ) */
 
 static lfs_t * pxLfsCtx = NULL;
+static uint32_t ulFsMountTimeUs = 0;
+static uint32_t ulKvStoreInitTimeUs = 0;
 
 EventGroupHandle_t xSystemEvents = NULL;
 
@@ -77,6 +84,16 @@ lfs_t * pxGetDefaultFsCtx( void )
     return pxLfsCtx;
 }
 
+uint32_t ulGetFsMountTimeUs( void )
+{
+    return ulFsMountTimeUs;
+}
+
+uint32_t ulGetKvStoreInitTimeUs( void )
+{
+    return ulKvStoreInitTimeUs;
+}
+
 static int fs_init( void )
 {
     static lfs_t xLfsCtx = { 0 };
@@ -86,9 +103,14 @@ static int fs_init( void )
     /* Block time of up to 1 s for filesystem to initialize */
     const struct lfs_config * pxCfg = pxInitializeOSPIFlashFs( pdMS_TO_TICKS( 30 * 1000 ) );
 
+    uint32_t ulStartCycles = ulGetCycleCount();
+
     /* mount the filesystem */
     int err = lfs_mount( &xLfsCtx, pxCfg );
 
+    ulFsMountTimeUs = ( ulGetCycleCount() - ulStartCycles ) / ( SystemCoreClock / 1000000 );
+    LogInfo( "lfs_mount returned %d after %lu us.", err, ulFsMountTimeUs );
+
     /* format if we can't mount the filesystem
      * this should only happen on the first boot
      */
@@ -191,6 +213,7 @@ extern void net_main( void * pvParameters );
 extern void vMQTTAgentTask( void * );
 extern void vMotionSensorsPublish( void * );
 extern void vEnvironmentSensorPublishTask( void * );
+extern void vTelemetryBatchTask( void * );
 extern void vShadowDeviceTask( void * );
 extern void vOTAUpdateTask( void * pvParam );
 extern void vDefenderAgentTask( void * );
@@ -201,17 +224,14 @@ extern void iotconnect_app( void * );
 
 extern void otaPal_EarlyInit( void );
 
-void vInitTask( void * pvArgs )
-{
-    BaseType_t xResult;
-    int xMountStatus;
-
-    ( void ) pvArgs;
+extern const CLI_Command_Definition_t xCommandDef_flashbench;
 
-    xResult = xTaskCreate( Task_CLI, "cli", 2048, NULL, 10, NULL );
-    configASSERT( xResult == pdTRUE );
+/* Set by the filesystem stage. The stages that use the filesystem skip that work if it is not mounted. */
+static BaseType_t xFsMounted = pdFALSE;
 
-    xMountStatus = fs_init();
+static BaseType_t prvStageFs( void )
+{
+    int xMountStatus = fs_init();
 
     if( xMountStatus == LFS_ERR_OK )
     {
@@ -223,7 +243,41 @@ void vInitTask( void * pvArgs )
 
         LogInfo( "File System mounted." );
 
+        ( void ) FreeRTOS_CLIRegisterCommand( &xCommandDef_flashbench );
+
+        xFsMounted = pdTRUE;
+        vBootMetricsMark( BOOT_MILESTONE_FS_READY );
+    }
+    else
+    {
+        LogError( "Failed to mount filesystem." );
+    }
+
+    ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_FS_READY );
+
+    return xFsMounted;
+}
+
 #ifdef IOTCONFIG_ENABLE_OTA
+static BaseType_t prvStageOta( void )
+{
+    BaseType_t xReady = pdTRUE;
+    uint32_t ulState = 0;
+    uint32_t ulTargetBank = 0;
+
+    /*
+     * The OTA PAL keeps its state in a flash log of its own. The log is only empty
+     * before the first boot has migrated the former state file, which needs the filesystem.
+     */
+    if( ( xOtaStateLogInit() == pdTRUE ) &&
+        ( xOtaStateLogRead( &ulState, &ulTargetBank ) == pdFALSE ) )
+    {
+        ( void ) xEventGroupWaitBits( xSystemEvents, EVT_MASK_FS_READY, pdFALSE, pdTRUE, portMAX_DELAY );
+        xReady = xFsMounted;
+    }
+
+    if( xReady == pdTRUE )
+    {
         otaPal_EarlyInit();
 
         /*
@@ -244,41 +298,76 @@ void vInitTask( void * pvArgs )
         } else {
             otaPal_RejectImage();
         }
-#endif
+    }
 
-        ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_FS_READY );
+    return xReady;
+}
+#endif /* IOTCONFIG_ENABLE_OTA */
 
-        KVStore_init();
-    }
-    else
+static BaseType_t prvStageKvStore( void )
+{
+    if( xFsMounted == pdTRUE )
     {
-        LogError( "Failed to mount filesystem." );
+        KVStoreInitStats_t xStats = { 0 };
+        uint32_t ulStartCycles = ulGetCycleCount();
+
+        KVStore_init();
+
+        ulKvStoreInitTimeUs = ( ulGetCycleCount() - ulStartCycles ) / ( SystemCoreClock / 1000000 );
+
+        KVStore_getInitStats( &xStats );
+        LogInfo( "KVStore_init loaded %lu keys from %s after %lu us.",
+                 xStats.ulKeysLoaded, ( xStats.xFromSnapshot == pdTRUE ) ? "the snapshot" : "per key files",
+                 ulKvStoreInitTimeUs );
     }
 
-    ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_FS_READY );
+    /* Readers fall back to the default values if the filesystem is not available */
+    ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_KVSTORE_READY );
 
-//        xResult = xTaskCreate( vHeartbeatTask, "Heartbeat", 128, NULL, tskIDLE_PRIORITY, NULL );
-//        configASSERT( xResult == pdTRUE );
+    return xFsMounted;
+}
 
-    xResult = xTaskCreate( &net_main, "MxNet", 1024, NULL, 23, NULL );
-    configASSERT( xResult == pdTRUE );
+/* The Wi-Fi module boots and reports its firmware version while the filesystem is mounted */
+static BaseType_t prvStageNet( void )
+{
+    return xTaskCreate( &net_main, "MxNet", 1024, NULL, 23, NULL );
+}
+
+/* Sensor tasks initialize their sensors first, then wait for the data they need */
+static BaseType_t prvStageSensors( void )
+{
+    BaseType_t xResult = pdTRUE;
+
+    #if !DEMO_QUALIFICATION_TEST
+        xResult = xTaskCreate( vEnvironmentSensorPublishTask, "EnvSense", 1024, NULL, 6, NULL );
+
+        if( xResult == pdTRUE )
+        {
+            xResult = xTaskCreate( vMotionSensorsPublish, "MotionS", 2048, NULL, 5, NULL );
+        }
+
+        if( xResult == pdTRUE )
+        {
+            xResult = xTaskCreate( vTelemetryBatchTask, "TelemetryBatch", 2048, NULL, 5, NULL );
+        }
+    #endif /* !DEMO_QUALIFICATION_TEST */
+
+    return xResult;
+}
+
+static BaseType_t prvStageApp( void )
+{
+    BaseType_t xResult = pdFALSE;
 
     #if DEMO_QUALIFICATION_TEST
         xResult = xTaskCreate( run_qualification_main, "QualTest", 4096, NULL, 10, NULL );
-        configASSERT( xResult == pdTRUE );
     #else
 //        xResult = xTaskCreate( vMQTTAgentTask, "MQTTAgent", 2048, NULL, 10, NULL );
 //        configASSERT( xResult == pdTRUE );
 //
 //        xResult = xTaskCreate( vOTAUpdateTask, "OTAUpdate", 4096, NULL, tskIDLE_PRIORITY + 1, NULL );
 //        configASSERT( xResult == pdTRUE );
-
-        xResult = xTaskCreate( vEnvironmentSensorPublishTask, "EnvSense", 1024, NULL, 6, NULL );
-        configASSERT( xResult == pdTRUE );
-
-        xResult = xTaskCreate( vMotionSensorsPublish, "MotionS", 2048, NULL, 5, NULL );
-        configASSERT( xResult == pdTRUE );
-
+//
 //        xResult = xTaskCreate( vShadowDeviceTask, "ShadowDevice", 1024, NULL, 5, NULL );
 //        configASSERT( xResult == pdTRUE );
 //
@@ -287,9 +376,39 @@ void vInitTask( void * pvArgs )
         LogInfo("IOTC RUNNING\n");
 
         xResult = xTaskCreate( iotconnect_app, "iotconnect_app", 4096, NULL, 5, NULL );
-        configASSERT( xResult == pdTRUE );
     #endif /* DEMO_QUALIFICATION_TEST */
 
+    return xResult;
+}
+
+#define APP_BOOT_STAGE_ENTRY( xId, pcName, xFunction, ulDependsOn, uxStackDepth, uxPriority ) \
+    [ xId ] = { pcName, xFunction, ulDependsOn, uxStackDepth, uxPriority },
+
+static const BootStage_t xBootStages[ APP_STAGE_MAX ] =
+{
+    APP_BOOT_STAGE_TABLE( APP_BOOT_STAGE_ENTRY )
+};
+
+void vInitTask( void * pvArgs )
+{
+    BaseType_t xResult;
+
+    ( void ) pvArgs;
+
+    xResult = xTaskCreate( Task_CLI, "cli", 2048, NULL, 10, NULL );
+    configASSERT( xResult == pdTRUE );
+
+//        xResult = xTaskCreate( vHeartbeatTask, "Heartbeat", 128, NULL, tskIDLE_PRIORITY, NULL );
+//        configASSERT( xResult == pdTRUE );
+
+    /* Starts every stage as soon as the stages it depends on have ended */
+    xResult = xBootStagesRun( xBootStages, APP_STAGE_MAX );
+
+    if( xResult != pdTRUE )
+    {
+        LogError( "One or more boot stages failed." );
+    }
+
     while( 1 )
     {
         vTaskSuspend( NULL );
@@ -368,6 +487,8 @@ int main( void )
 
     xTaskCreate( vInitTask, "Init", 1024, NULL, 8, NULL );
 
+    vBootMetricsSetPreSchedulerMs( ulGetCycleCount() / ( SystemCoreClock / 1000 ) );
+
     /* Start scheduler */
     vTaskStartScheduler();
 
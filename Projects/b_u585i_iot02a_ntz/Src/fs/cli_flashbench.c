@@ -0,0 +1,983 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/*
+ * Read throughput and mount time benchmark for the OSPI NOR littlefs backend,
+ * comparing memory mapped and indirect (8READ command) reads, and read latency
+ * while a sector erase is in flight with and without erase suspend, and
+ * program throughput with page by page and streamed programs. Also checks and
+ * measures the littlefs CRC backends, and compares littlefs on the internal
+ * flash with littlefs on the OSPI NOR flash.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cli_prv.h"
+
+#include "hw_defs.h"
+#include "lfs.h"
+#include "lfs_port.h"
+#include "lfs_port_prv.h"
+#include "lfs_port_crc.h"
+#include "ospi_nor_mx25lmxxx45g.h"
+#include "kvstore.h"
+
+#define FLASHBENCH_DEFAULT_KIB    ( 256 )
+#define FLASHBENCH_MAX_KIB        ( 4096 )
+#define FLASHBENCH_LARGE_READ     ( 4096 )
+#define FLASHBENCH_SMALL_READ     ( 16 )
+
+#define FLASHBENCH_DEFAULT_SECTORS    ( 8 )
+#define FLASHBENCH_MAX_SECTORS        ( 64 )
+#define FLASHBENCH_MAX_SAMPLES        ( 1024 )
+
+/* littlefs computes CRCs over at most one cache (one 4 KiB sector) at a time */
+#define FLASHBENCH_CRC_CHUNK          ( 4096 )
+
+/* The internal flash partition only holds a few blocks */
+#define FLASHBENCH_FS_DEFAULT_KIB     ( 16 )
+#define FLASHBENCH_FS_MAX_KIB         ( 32 )
+#define FLASHBENCH_FS_CHUNK           ( 1024 )
+#define FLASHBENCH_FS_FILE_NAME       "/flashbench.tmp"
+
+/* Sectors past the end of the filesystem, erased by the erase and write benchmarks */
+#define FLASHBENCH_SCRATCH_ADDR       ( OPI_START_ADDRESS + MX25LM_MEM_SZ_USABLE )
+
+_Static_assert( ( FLASHBENCH_SCRATCH_ADDR + ( FLASHBENCH_MAX_SECTORS * MX25LM_SECTOR_SZ ) ) <= MX25LM_MEM_SZ_BYTES,
+                "Benchmark scratch area is out of range" );
+
+static void prvFlashBenchCommand( ConsoleIO_t * const pxCIO,
+                                  uint32_t ulArgc,
+                                  char * ppcArgv[] );
+
+const CLI_Command_Definition_t xCommandDef_flashbench =
+{
+    "flashbench",
+    "flashbench\r\n"
+    "    flashbench [status]\r\n"
+    "        Display the read mode and the time taken to mount the filesystem and load the KVStore at boot.\r\n\n"
+    "    flashbench read [KiB]\r\n"
+    "        Measure read throughput with memory mapped and indirect reads, by default over 256 KiB.\r\n"
+    "        Filesystem access from other tasks is blocked while the benchmark runs.\r\n\n"
+    "    flashbench mount\r\n"
+    "        Measure the time to mount the filesystem with memory mapped and indirect reads.\r\n\n"
+    "    flashbench erase [sectors]\r\n"
+    "        Measure the latency of small filesystem reads while sectors outside of the filesystem\r\n"
+    "        are erased, with and without erase suspend. 8 sectors are erased by default.\r\n\n"
+    "    flashbench write [sectors]\r\n"
+    "        Measure program throughput on sectors outside of the filesystem, programming one page\r\n"
+    "        at a time and streaming all pages of a sector, with interrupt and DMA transfers.\r\n"
+    "        8 sectors are programmed by default.\r\n\n"
+    "    flashbench crc [KiB]\r\n"
+    "        Check that every littlefs CRC backend matches the software implementation and\r\n"
+    "        measure its throughput in bytes per cycle, by default over 256 KiB.\r\n\n"
+    "    flashbench fs [KiB]\r\n"
+    "        Compare littlefs on the internal flash and on the OSPI flash: mount time and the\r\n"
+    "        throughput of writing and reading back a file, by default of 16 KiB.\r\n"
+    "        The internal flash filesystem is formatted if it cannot be mounted.\r\n\n",
+    prvFlashBenchCommand
+};
+
+/*-----------------------------------------------------------*/
+
+static void prvPrintScratch( ConsoleIO_t * const pxCIO,
+                             int lLen )
+{
+    if( ( lLen > 0 ) &&
+        ( lLen < CLI_OUTPUT_SCRATCH_BUF_LEN ) )
+    {
+        pxCIO->write( pcCliScratchBuffer, ( size_t ) lLen );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvCyclesToUs( uint32_t ulCycles )
+{
+    return ulCycles / ( SystemCoreClock / 1000000 );
+}
+
+/*-----------------------------------------------------------*/
+
+static const char * prvModeName( BaseType_t xMemoryMapped )
+{
+    return ( xMemoryMapped == pdTRUE ) ? "mapped" : "indirect";
+}
+
+/*-----------------------------------------------------------*/
+
+/* Switch the read mode with the filesystem lock held, so no read is in progress */
+static BaseType_t prvSetReadMode( const struct lfs_config * pxCfg,
+                                  BaseType_t xMemoryMapped )
+{
+    BaseType_t xSuccess = pdFALSE;
+    struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) pxCfg->context;
+
+    if( lfs_port_lock( pxCfg ) == 0 )
+    {
+        ospi_SetMemoryMappedRead( &( pxCtx->xOSPIHandle ), xMemoryMapped );
+        ( void ) lfs_port_unlock( pxCfg );
+        xSuccess = pdTRUE;
+    }
+
+    return xSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvReadBench( ConsoleIO_t * const pxCIO,
+                          const struct lfs_config * pxCfg,
+                          uint32_t ulBytes,
+                          uint32_t ulReadLen,
+                          uint8_t * pucBuffer )
+{
+    struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) pxCfg->context;
+    BaseType_t xPrevMode = ospi_GetMemoryMappedRead();
+
+    for( BaseType_t xMemoryMapped = pdFALSE; xMemoryMapped <= pdTRUE; xMemoryMapped++ )
+    {
+        BaseType_t xSuccess = pdTRUE;
+        uint32_t ulReads = ulBytes / ulReadLen;
+        uint32_t ulCycles = 0;
+
+        if( lfs_port_lock( pxCfg ) != 0 )
+        {
+            xSuccess = pdFALSE;
+        }
+        else
+        {
+            ospi_SetMemoryMappedRead( &( pxCtx->xOSPIHandle ), xMemoryMapped );
+
+            uint32_t ulStartCycles = ulGetCycleCount();
+
+            for( uint32_t i = 0; ( i < ulReads ) && ( xSuccess == pdTRUE ); i++ )
+            {
+                xSuccess = ospi_ReadAddr( &( pxCtx->xOSPIHandle ),
+                                          OPI_START_ADDRESS + ( i * ulReadLen ),
+                                          pucBuffer,
+                                          ulReadLen,
+                                          pdMS_TO_TICKS( MX25LM_READ_TIMEOUT_MS ) );
+            }
+
+            ulCycles = ulGetCycleCount() - ulStartCycles;
+
+            ospi_SetMemoryMappedRead( &( pxCtx->xOSPIHandle ), xPrevMode );
+            ( void ) lfs_port_unlock( pxCfg );
+        }
+
+        if( xSuccess != pdTRUE )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "%-9s %6lu  read failed\r\n",
+                                              prvModeName( xMemoryMapped ),
+                                              ( unsigned long ) ulReadLen ) );
+        }
+        else
+        {
+            uint32_t ulTimeUs = prvCyclesToUs( ulCycles );
+
+            if( ulTimeUs == 0 )
+            {
+                ulTimeUs = 1;
+            }
+
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "%-9s %6lu %8lu %10lu %8lu %9lu\r\n",
+                                              prvModeName( xMemoryMapped ),
+                                              ( unsigned long ) ulReadLen,
+                                              ( unsigned long ) ulReads,
+                                              ( unsigned long ) ulTimeUs,
+                                              ( unsigned long ) ( ( ( uint64_t ) ulReads * ulReadLen * 1000000 ) / ( ( uint64_t ) ulTimeUs * 1024 ) ),
+                                              ( unsigned long ) ( ulCycles / ulReads ) ) );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvMountBench( ConsoleIO_t * const pxCIO,
+                           const struct lfs_config * pxCfg )
+{
+    /* Mounted alongside the default instance. Mounting only reads the flash. */
+    static lfs_t xBenchLfs;
+    BaseType_t xPrevMode = ospi_GetMemoryMappedRead();
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-9s %10s %6s\r\n", "mode", "time us", "result" ) );
+
+    for( BaseType_t xMemoryMapped = pdFALSE; xMemoryMapped <= pdTRUE; xMemoryMapped++ )
+    {
+        int lErr = LFS_ERR_IO;
+        uint32_t ulCycles = 0;
+
+        if( prvSetReadMode( pxCfg, xMemoryMapped ) == pdTRUE )
+        {
+            uint32_t ulStartCycles = ulGetCycleCount();
+
+            lErr = lfs_mount( &xBenchLfs, pxCfg );
+
+            ulCycles = ulGetCycleCount() - ulStartCycles;
+
+            if( lErr == LFS_ERR_OK )
+            {
+                ( void ) lfs_unmount( &xBenchLfs );
+            }
+        }
+
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "%-9s %10lu %6d\r\n",
+                                          prvModeName( xMemoryMapped ),
+                                          ( unsigned long ) prvCyclesToUs( ulCycles ),
+                                          lErr ) );
+    }
+
+    ( void ) prvSetReadMode( pxCfg, xPrevMode );
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvCompareU32( const void * pvA,
+                          const void * pvB )
+{
+    uint32_t ulA = *( ( const uint32_t * ) pvA );
+    uint32_t ulB = *( ( const uint32_t * ) pvB );
+
+    return ( ulA > ulB ) - ( ulA < ulB );
+}
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvPercentileUs( const uint32_t * pulSorted,
+                                        uint32_t ulCount,
+                                        uint32_t ulPercent )
+{
+    return prvCyclesToUs( pulSorted[ ( ( ulCount - 1 ) * ulPercent ) / 100 ] );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvEraseBench( ConsoleIO_t * const pxCIO,
+                           const struct lfs_config * pxCfg,
+                           uint32_t ulSectors,
+                           uint32_t * pulSamples )
+{
+    struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) pxCfg->context;
+    BaseType_t xPrevSuspend = ospi_GetSuspendForRead();
+    uint8_t ucReadBuffer[ FLASHBENCH_SMALL_READ ];
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-8s %6s %8s %8s %8s %8s %9s %8s\r\n",
+                                      "suspend", "reads", "p50 us", "p90 us", "p99 us", "max us", "erase us", "suspends" ) );
+
+    for( BaseType_t xSuspend = pdFALSE; xSuspend <= pdTRUE; xSuspend++ )
+    {
+        BaseType_t xSuccess = pdTRUE;
+        uint32_t ulSamples = 0;
+        uint32_t ulEraseCycles = 0;
+        OspiNorStats_t xStatsBefore;
+        OspiNorStats_t xStatsAfter;
+
+        if( lfs_port_lock( pxCfg ) != 0 )
+        {
+            xSuccess = pdFALSE;
+        }
+        else
+        {
+            ospi_SetSuspendForRead( xSuspend );
+            ospi_GetStats( &xStatsBefore );
+
+            for( uint32_t ulSector = 0; ( ulSector < ulSectors ) && ( xSuccess == pdTRUE ); ulSector++ )
+            {
+                uint32_t ulStartCycles = ulGetCycleCount();
+
+                xSuccess = ospi_EraseSectorStart( &( pxCtx->xOSPIHandle ),
+                                                  FLASHBENCH_SCRATCH_ADDR + ( ulSector * MX25LM_SECTOR_SZ ),
+                                                  pdMS_TO_TICKS( MX25LM_ERASE_TIMEOUT_MS ) );
+
+                /* Read a different filesystem sector every tick until the erase completes */
+                while( ( xSuccess == pdTRUE ) &&
+                       ( ulSamples < FLASHBENCH_MAX_SAMPLES ) &&
+                       ( ospi_IsBusy( &( pxCtx->xOSPIHandle ) ) == pdTRUE ) )
+                {
+                    uint32_t ulReadCycles = ulGetCycleCount();
+
+                    xSuccess = ospi_ReadAddr( &( pxCtx->xOSPIHandle ),
+                                              OPI_START_ADDRESS + ( ( ulSamples * MX25LM_SECTOR_SZ ) % MX25LM_MEM_SZ_USABLE ),
+                                              ucReadBuffer,
+                                              sizeof( ucReadBuffer ),
+                                              pdMS_TO_TICKS( MX25LM_READ_TIMEOUT_MS ) );
+
+                    pulSamples[ ulSamples ] = ulGetCycleCount() - ulReadCycles;
+                    ulSamples++;
+
+                    vTaskDelay( 1 );
+                }
+
+                if( xSuccess == pdTRUE )
+                {
+                    xSuccess = ospi_WaitForIdle( &( pxCtx->xOSPIHandle ),
+                                                 pdMS_TO_TICKS( MX25LM_ERASE_TIMEOUT_MS ) );
+                }
+
+                ulEraseCycles += ulGetCycleCount() - ulStartCycles;
+            }
+
+            ospi_GetStats( &xStatsAfter );
+            ospi_SetSuspendForRead( xPrevSuspend );
+            ( void ) lfs_port_unlock( pxCfg );
+        }
+
+        if( ( xSuccess != pdTRUE ) ||
+            ( ulSamples == 0 ) )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "%-8s erase or read failed\r\n",
+                                              ( xSuspend == pdTRUE ) ? "on" : "off" ) );
+        }
+        else
+        {
+            qsort( pulSamples, ulSamples, sizeof( uint32_t ), prvCompareU32 );
+
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "%-8s %6lu %8lu %8lu %8lu %8lu %9lu %8lu\r\n",
+                                              ( xSuspend == pdTRUE ) ? "on" : "off",
+                                              ( unsigned long ) ulSamples,
+                                              ( unsigned long ) prvPercentileUs( pulSamples, ulSamples, 50 ),
+                                              ( unsigned long ) prvPercentileUs( pulSamples, ulSamples, 90 ),
+                                              ( unsigned long ) prvPercentileUs( pulSamples, ulSamples, 99 ),
+                                              ( unsigned long ) prvCyclesToUs( pulSamples[ ulSamples - 1 ] ),
+                                              ( unsigned long ) ( prvCyclesToUs( ulEraseCycles ) / ulSectors ),
+                                              ( unsigned long ) ( xStatsAfter.ulSuspends - xStatsBefore.ulSuspends ) ) );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Program ulSectors erased sectors of the scratch area from pucData and wait for the last program */
+static BaseType_t prvProgramScratch( OSPI_HandleTypeDef * pxOSPI,
+                                     uint32_t ulSectors,
+                                     BaseType_t xStream,
+                                     const uint8_t * pucData )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    for( uint32_t ulSector = 0; ( ulSector < ulSectors ) && ( xSuccess == pdTRUE ); ulSector++ )
+    {
+        uint32_t ulSectorAddr = FLASHBENCH_SCRATCH_ADDR + ( ulSector * MX25LM_SECTOR_SZ );
+
+        if( xStream == pdTRUE )
+        {
+            /* As programmed by lfs_port_prog when littlefs flushes its cache */
+            xSuccess = ospi_WritePagesStart( pxOSPI,
+                                             ulSectorAddr,
+                                             pucData,
+                                             MX25LM_SECTOR_SZ,
+                                             pdMS_TO_TICKS( MX25LM_WRITE_TIMEOUT_MS ) );
+        }
+        else
+        {
+            for( uint32_t ulOffset = 0; ( ulOffset < MX25LM_SECTOR_SZ ) && ( xSuccess == pdTRUE ); ulOffset += MX25LM_PROGRAM_FIFO_LEN )
+            {
+                xSuccess = ospi_WriteAddr( pxOSPI,
+                                           ulSectorAddr + ulOffset,
+                                           &( pucData[ ulOffset ] ),
+                                           MX25LM_PROGRAM_FIFO_LEN,
+                                           pdMS_TO_TICKS( MX25LM_WRITE_TIMEOUT_MS ) );
+            }
+        }
+    }
+
+    if( xSuccess == pdTRUE )
+    {
+        xSuccess = ospi_WaitForIdle( pxOSPI, pdMS_TO_TICKS( MX25LM_WRITE_TIMEOUT_MS ) );
+    }
+
+    return xSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvWriteBench( ConsoleIO_t * const pxCIO,
+                           const struct lfs_config * pxCfg,
+                           uint32_t ulSectors,
+                           uint8_t * pucData )
+{
+    struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) pxCfg->context;
+    BaseType_t xPrevDma = ospi_GetProgramDma();
+
+    for( uint32_t i = 0; i < MX25LM_SECTOR_SZ; i++ )
+    {
+        pucData[ i ] = ( uint8_t ) ( i * 7 );
+    }
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-7s %-4s %6s %10s %8s %10s\r\n",
+                                      "mode", "dma", "KiB", "time us", "KiB/s", "us/sector" ) );
+
+    for( BaseType_t xStream = pdFALSE; xStream <= pdTRUE; xStream++ )
+    {
+        for( BaseType_t xDma = pdFALSE; xDma <= pdTRUE; xDma++ )
+        {
+            BaseType_t xSuccess = pdTRUE;
+            BaseType_t xDmaSelected = pdFALSE;
+            uint32_t ulCycles = 0;
+
+            if( lfs_port_lock( pxCfg ) != 0 )
+            {
+                xSuccess = pdFALSE;
+            }
+            else
+            {
+                /* Erase outside of the timed section */
+                for( uint32_t ulSector = 0; ( ulSector < ulSectors ) && ( xSuccess == pdTRUE ); ulSector++ )
+                {
+                    xSuccess = ospi_EraseSector( &( pxCtx->xOSPIHandle ),
+                                                 FLASHBENCH_SCRATCH_ADDR + ( ulSector * MX25LM_SECTOR_SZ ),
+                                                 pdMS_TO_TICKS( MX25LM_ERASE_TIMEOUT_MS ) );
+                }
+
+                ospi_SetProgramDma( xDma );
+                xDmaSelected = ospi_GetProgramDma();
+
+                if( ( xSuccess == pdTRUE ) &&
+                    ( xDmaSelected == xDma ) )
+                {
+                    uint32_t ulStartCycles = ulGetCycleCount();
+
+                    xSuccess = prvProgramScratch( &( pxCtx->xOSPIHandle ), ulSectors, xStream, pucData );
+
+                    ulCycles = ulGetCycleCount() - ulStartCycles;
+                }
+
+                ospi_SetProgramDma( xPrevDma );
+                ( void ) lfs_port_unlock( pxCfg );
+            }
+
+            if( xSuccess != pdTRUE )
+            {
+                prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                                  "%-7s %-4s erase or program failed\r\n",
+                                                  ( xStream == pdTRUE ) ? "stream" : "page",
+                                                  ( xDma == pdTRUE ) ? "on" : "off" ) );
+            }
+            else if( xDmaSelected != xDma )
+            {
+                prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                                  "%-7s %-4s DMA is not available\r\n",
+                                                  ( xStream == pdTRUE ) ? "stream" : "page", "on" ) );
+            }
+            else
+            {
+                uint32_t ulTimeUs = prvCyclesToUs( ulCycles );
+
+                if( ulTimeUs == 0 )
+                {
+                    ulTimeUs = 1;
+                }
+
+                prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                                  "%-7s %-4s %6lu %10lu %8lu %10lu\r\n",
+                                                  ( xStream == pdTRUE ) ? "stream" : "page",
+                                                  ( xDma == pdTRUE ) ? "on" : "off",
+                                                  ( unsigned long ) ( ( ulSectors * MX25LM_SECTOR_SZ ) / 1024 ),
+                                                  ( unsigned long ) ulTimeUs,
+                                                  ( unsigned long ) ( ( ( uint64_t ) ulSectors * MX25LM_SECTOR_SZ * 1000000 ) / ( ( uint64_t ) ulTimeUs * 1024 ) ),
+                                                  ( unsigned long ) ( ulTimeUs / ulSectors ) ) );
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Compare a CRC backend against the nibble table implementation littlefs ships with */
+static uint32_t prvCrcCheck( LfsCrcFunction_t xCrcFunction,
+                             const uint8_t * pucData )
+{
+    static const uint16_t usSizes[] = { 0, 1, 3, 4, 7, 8, 9, 15, 16, 31, 255, 256, 1021, FLASHBENCH_CRC_CHUNK };
+    uint32_t ulMismatches = 0;
+
+    for( uint32_t ulOffset = 0; ulOffset < 4; ulOffset++ )
+    {
+        for( uint32_t i = 0; i < ( sizeof( usSizes ) / sizeof( usSizes[ 0 ] ) ); i++ )
+        {
+            size_t uxSize = usSizes[ i ];
+            size_t uxSplit = uxSize / 3;
+            uint32_t ulExpected = lfs_crc_nibble( 0xffffffff, &( pucData[ ulOffset ] ), uxSize );
+
+            /* Also check that the running value carries over between calls, as in lfs_bd_crc */
+            uint32_t ulCrc = xCrcFunction( 0xffffffff, &( pucData[ ulOffset ] ), uxSplit );
+
+            ulCrc = xCrcFunction( ulCrc, &( pucData[ ulOffset + uxSplit ] ), uxSize - uxSplit );
+
+            if( ulCrc != ulExpected )
+            {
+                ulMismatches++;
+            }
+        }
+    }
+
+    return ulMismatches;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCrcBench( ConsoleIO_t * const pxCIO,
+                         uint32_t ulKiB,
+                         uint8_t * pucData )
+{
+    uint32_t ulRandom = 0x2545f491;
+
+    /* Chunk plus room for the unaligned checks */
+    for( uint32_t i = 0; i < ( FLASHBENCH_CRC_CHUNK + 4 ); i++ )
+    {
+        ulRandom ^= ulRandom << 13;
+        ulRandom ^= ulRandom >> 17;
+        ulRandom ^= ulRandom << 5;
+        pucData[ i ] = ( uint8_t ) ulRandom;
+    }
+
+    prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-8s %10s %6s %10s %11s\r\n",
+                                      "backend", "mismatches", "KiB", "cycles", "bytes/cycle" ) );
+
+    for( LfsCrcBackend_t xBackend = LFS_CRC_BACKEND_NIBBLE; xBackend < LFS_CRC_BACKEND_MAX; xBackend++ )
+    {
+        LfsCrcFunction_t xCrcFunction = lfs_crc_get_function( xBackend );
+
+        if( xCrcFunction == NULL )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "%-8s not available\r\n",
+                                              lfs_crc_get_name( xBackend ) ) );
+        }
+        else
+        {
+            uint32_t ulMismatches = prvCrcCheck( xCrcFunction, pucData );
+            uint32_t ulCrc = 0xffffffff;
+            uint32_t ulStartCycles = ulGetCycleCount();
+
+            for( uint32_t i = 0; i < ( ( ulKiB * 1024 ) / FLASHBENCH_CRC_CHUNK ); i++ )
+            {
+                ulCrc = xCrcFunction( ulCrc, pucData, FLASHBENCH_CRC_CHUNK );
+            }
+
+            uint32_t ulCycles = ulGetCycleCount() - ulStartCycles;
+            uint64_t ullMilliBytesPerCycle = ( ( uint64_t ) ulKiB * 1024 * 1000 ) / ( ( ulCycles > 0 ) ? ulCycles : 1 );
+
+            ( void ) ulCrc;
+
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "%-8s %10lu %6lu %10lu %7lu.%03lu\r\n",
+                                              lfs_crc_get_name( xBackend ),
+                                              ( unsigned long ) ulMismatches,
+                                              ( unsigned long ) ulKiB,
+                                              ( unsigned long ) ulCycles,
+                                              ( unsigned long ) ( ullMilliBytesPerCycle / 1000 ),
+                                              ( unsigned long ) ( ullMilliBytesPerCycle % 1000 ) ) );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Mounted on first use, the internal flash filesystem is not used by the application */
+static lfs_t xInternalLfs;
+static lfs_t * pxInternalLfs = NULL;
+
+static lfs_t * prvGetInternalFs( ConsoleIO_t * const pxCIO )
+{
+    if( pxInternalLfs == NULL )
+    {
+        const struct lfs_config * pxCfg = pxInitializeInternalFlashFs( pdMS_TO_TICKS( 30 * 1000 ) );
+        int lErr = lfs_mount( &xInternalLfs, pxCfg );
+
+        if( lErr != LFS_ERR_OK )
+        {
+            pxCIO->print( "Formatting the internal flash filesystem.\r\n" );
+            lErr = lfs_format( &xInternalLfs, pxCfg );
+
+            if( lErr == LFS_ERR_OK )
+            {
+                lErr = lfs_mount( &xInternalLfs, pxCfg );
+            }
+        }
+
+        if( lErr == LFS_ERR_OK )
+        {
+            pxInternalLfs = &xInternalLfs;
+        }
+    }
+
+    return pxInternalLfs;
+}
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvKiBPerSecond( uint32_t ulKiB,
+                                        uint32_t ulCycles )
+{
+    uint32_t ulTimeUs = prvCyclesToUs( ulCycles );
+
+    return ( uint32_t ) ( ( ( uint64_t ) ulKiB * 1000000 ) / ( ( ulTimeUs > 0 ) ? ulTimeUs : 1 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvFsBench( ConsoleIO_t * const pxCIO,
+                        const char * pcName,
+                        lfs_t * pxLfs,
+                        uint32_t ulKiB,
+                        uint8_t * pucData )
+{
+    /* Mounted alongside the instance in use. Mounting only reads the flash. */
+    static lfs_t xBenchLfs;
+    const struct lfs_config * pxCfg = pxLfs->cfg;
+    lfs_t * pxMountLfs = &xBenchLfs;
+    lfs_file_t xFile;
+    uint32_t ulMountCycles = 0;
+    uint32_t ulWriteCycles = 0;
+    uint32_t ulReadCycles = 0;
+    uint32_t ulStartCycles = 0;
+    int lErr = LFS_ERR_OK;
+
+    /*
+     * The internal flash port has static caches when built with LFS_NO_MALLOC, which a
+     * second instance would share. Only this benchmark uses that instance, so it is
+     * remounted instead.
+     */
+    if( pxLfs == &xInternalLfs )
+    {
+        ( void ) lfs_unmount( pxLfs );
+        pxMountLfs = pxLfs;
+    }
+
+    ulStartCycles = ulGetCycleCount();
+    lErr = lfs_mount( pxMountLfs, pxCfg );
+    ulMountCycles = ulGetCycleCount() - ulStartCycles;
+
+    if( pxMountLfs == &xBenchLfs )
+    {
+        if( lErr == LFS_ERR_OK )
+        {
+            ( void ) lfs_unmount( &xBenchLfs );
+        }
+    }
+    else if( lErr != LFS_ERR_OK )
+    {
+        /* Mounted again, or formatted, on the next run */
+        pxInternalLfs = NULL;
+    }
+
+    if( lErr == LFS_ERR_OK )
+    {
+        ulStartCycles = ulGetCycleCount();
+        lErr = lfs_file_open( pxLfs, &xFile, FLASHBENCH_FS_FILE_NAME, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC );
+
+        if( lErr == LFS_ERR_OK )
+        {
+            for( uint32_t i = 0; ( i < ulKiB ) && ( lErr >= 0 ); i++ )
+            {
+                ( void ) memset( pucData, ( int ) i, FLASHBENCH_FS_CHUNK );
+                lErr = lfs_file_write( pxLfs, &xFile, pucData, FLASHBENCH_FS_CHUNK );
+            }
+
+            /* Closing writes out the cached data and the metadata */
+            int lCloseErr = lfs_file_close( pxLfs, &xFile );
+
+            lErr = ( lErr < 0 ) ? lErr : lCloseErr;
+        }
+
+        ulWriteCycles = ulGetCycleCount() - ulStartCycles;
+    }
+
+    if( lErr == LFS_ERR_OK )
+    {
+        ulStartCycles = ulGetCycleCount();
+        lErr = lfs_file_open( pxLfs, &xFile, FLASHBENCH_FS_FILE_NAME, LFS_O_RDONLY );
+
+        if( lErr == LFS_ERR_OK )
+        {
+            for( uint32_t i = 0; ( i < ulKiB ) && ( lErr >= 0 ); i++ )
+            {
+                lErr = lfs_file_read( pxLfs, &xFile, pucData, FLASHBENCH_FS_CHUNK );
+
+                if( ( lErr >= 0 ) &&
+                    ( ( lErr != FLASHBENCH_FS_CHUNK ) ||
+                      ( pucData[ 0 ] != ( uint8_t ) i ) ||
+                      ( pucData[ FLASHBENCH_FS_CHUNK - 1 ] != ( uint8_t ) i ) ) )
+                {
+                    lErr = LFS_ERR_CORRUPT;
+                }
+            }
+
+            int lCloseErr = lfs_file_close( pxLfs, &xFile );
+
+            lErr = ( lErr < 0 ) ? lErr : lCloseErr;
+        }
+
+        ulReadCycles = ulGetCycleCount() - ulStartCycles;
+    }
+
+    if( ( pxLfs != &xInternalLfs ) || ( pxInternalLfs != NULL ) )
+    {
+        ( void ) lfs_remove( pxLfs, FLASHBENCH_FS_FILE_NAME );
+    }
+
+    if( lErr != LFS_ERR_OK )
+    {
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "%-9s failed: %d\r\n", pcName, lErr ) );
+    }
+    else
+    {
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "%-9s %9lu %6lu %10lu %8lu %10lu %8lu\r\n",
+                                          pcName,
+                                          ( unsigned long ) prvCyclesToUs( ulMountCycles ),
+                                          ( unsigned long ) ulKiB,
+                                          ( unsigned long ) prvCyclesToUs( ulWriteCycles ),
+                                          ( unsigned long ) prvKiBPerSecond( ulKiB, ulWriteCycles ),
+                                          ( unsigned long ) prvCyclesToUs( ulReadCycles ),
+                                          ( unsigned long ) prvKiBPerSecond( ulKiB, ulReadCycles ) ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvFlashBenchCommand( ConsoleIO_t * const pxCIO,
+                                  uint32_t ulArgc,
+                                  char * ppcArgv[] )
+{
+    lfs_t * pxLfs = pxGetDefaultFsCtx();
+
+    if( ( ulArgc < 2 ) ||
+        ( strcmp( "status", ppcArgv[ 1 ] ) == 0 ) )
+    {
+        OspiNorStats_t xStats;
+        KVStoreInitStats_t xKvStats;
+
+        ospi_GetStats( &xStats );
+        KVStore_getInitStats( &xKvStats );
+
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "Read mode: %s, mount at boot: %lu us\r\n",
+                                          prvModeName( ospi_GetMemoryMappedRead() ),
+                                          ( unsigned long ) ulGetFsMountTimeUs() ) );
+
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "Suspend for read: %s, reads during program/erase: %lu, suspended: %lu, waited: %lu, failed operations: %lu\r\n",
+                                          ( ospi_GetSuspendForRead() == pdTRUE ) ? "on" : "off",
+                                          ( unsigned long ) xStats.ulReadsDuringOp,
+                                          ( unsigned long ) xStats.ulSuspends,
+                                          ( unsigned long ) xStats.ulReadWaits,
+                                          ( unsigned long ) xStats.ulOpFailures ) );
+
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "Program transfers: %s, CRC: %s\r\n",
+                                          ( ospi_GetProgramDma() == pdTRUE ) ? "DMA" : "interrupt",
+                                          lfs_crc_get_name( lfs_crc_get_backend() ) ) );
+
+        prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "KVStore at boot: %lu us, %lu keys from %s, snapshot: %lu bytes\r\n",
+                                          ( unsigned long ) ulGetKvStoreInitTimeUs(),
+                                          ( unsigned long ) xKvStats.ulKeysLoaded,
+                                          ( xKvStats.xFromSnapshot == pdTRUE ) ? "snapshot" : "per key files",
+                                          ( unsigned long ) xKvStats.xSnapshotLength ) );
+    }
+    else if( strcmp( "read", ppcArgv[ 1 ] ) == 0 )
+    {
+        uint32_t ulKiB = FLASHBENCH_DEFAULT_KIB;
+        uint8_t * pucBuffer = NULL;
+
+        if( ulArgc > 2 )
+        {
+            ulKiB = ( uint32_t ) strtoul( ppcArgv[ 2 ], NULL, 10 );
+        }
+
+        if( ( ulKiB < ( FLASHBENCH_LARGE_READ / 1024 ) ) ||
+            ( ulKiB > FLASHBENCH_MAX_KIB ) )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "Error: Size must be between %d and %d KiB.\r\n",
+                                              FLASHBENCH_LARGE_READ / 1024,
+                                              FLASHBENCH_MAX_KIB ) );
+        }
+        else if( ( pucBuffer = pvPortMalloc( FLASHBENCH_LARGE_READ ) ) == NULL )
+        {
+            pxCIO->print( "Error: Failed to allocate the read buffer.\r\n" );
+        }
+        else
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "%-9s %6s %8s %10s %8s %9s\r\n",
+                                              "mode", "size", "reads", "time us", "KiB/s", "cyc/read" ) );
+
+            prvReadBench( pxCIO, pxLfs->cfg, ulKiB * 1024, FLASHBENCH_LARGE_READ, pucBuffer );
+
+            /* Small reads, as issued by littlefs for metadata, mostly measure the per read overhead */
+            prvReadBench( pxCIO, pxLfs->cfg, ulKiB * 64, FLASHBENCH_SMALL_READ, pucBuffer );
+
+            vPortFree( pucBuffer );
+        }
+    }
+    else if( strcmp( "mount", ppcArgv[ 1 ] ) == 0 )
+    {
+        prvMountBench( pxCIO, pxLfs->cfg );
+    }
+    else if( strcmp( "erase", ppcArgv[ 1 ] ) == 0 )
+    {
+        uint32_t ulSectors = FLASHBENCH_DEFAULT_SECTORS;
+        uint32_t * pulSamples = NULL;
+
+        if( ulArgc > 2 )
+        {
+            ulSectors = ( uint32_t ) strtoul( ppcArgv[ 2 ], NULL, 10 );
+        }
+
+        if( ( ulSectors == 0 ) ||
+            ( ulSectors > FLASHBENCH_MAX_SECTORS ) )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "Error: Number of sectors must be between 1 and %d.\r\n",
+                                              FLASHBENCH_MAX_SECTORS ) );
+        }
+        else if( ( pulSamples = pvPortMalloc( FLASHBENCH_MAX_SAMPLES * sizeof( uint32_t ) ) ) == NULL )
+        {
+            pxCIO->print( "Error: Failed to allocate the sample buffer.\r\n" );
+        }
+        else
+        {
+            prvEraseBench( pxCIO, pxLfs->cfg, ulSectors, pulSamples );
+            vPortFree( pulSamples );
+        }
+    }
+    else if( strcmp( "write", ppcArgv[ 1 ] ) == 0 )
+    {
+        uint32_t ulSectors = FLASHBENCH_DEFAULT_SECTORS;
+        uint8_t * pucData = NULL;
+
+        if( ulArgc > 2 )
+        {
+            ulSectors = ( uint32_t ) strtoul( ppcArgv[ 2 ], NULL, 10 );
+        }
+
+        if( ( ulSectors == 0 ) ||
+            ( ulSectors > FLASHBENCH_MAX_SECTORS ) )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "Error: Number of sectors must be between 1 and %d.\r\n",
+                                              FLASHBENCH_MAX_SECTORS ) );
+        }
+        else if( ( pucData = pvPortMalloc( MX25LM_SECTOR_SZ ) ) == NULL )
+        {
+            pxCIO->print( "Error: Failed to allocate the data buffer.\r\n" );
+        }
+        else
+        {
+            prvWriteBench( pxCIO, pxLfs->cfg, ulSectors, pucData );
+            vPortFree( pucData );
+        }
+    }
+    else if( strcmp( "crc", ppcArgv[ 1 ] ) == 0 )
+    {
+        uint32_t ulKiB = FLASHBENCH_DEFAULT_KIB;
+        uint8_t * pucData = NULL;
+
+        if( ulArgc > 2 )
+        {
+            ulKiB = ( uint32_t ) strtoul( ppcArgv[ 2 ], NULL, 10 );
+        }
+
+        if( ( ulKiB < ( FLASHBENCH_CRC_CHUNK / 1024 ) ) ||
+            ( ulKiB > FLASHBENCH_MAX_KIB ) )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "Error: Size must be between %d and %d KiB.\r\n",
+                                              FLASHBENCH_CRC_CHUNK / 1024,
+                                              FLASHBENCH_MAX_KIB ) );
+        }
+        else if( ( pucData = pvPortMalloc( FLASHBENCH_CRC_CHUNK + 4 ) ) == NULL )
+        {
+            pxCIO->print( "Error: Failed to allocate the data buffer.\r\n" );
+        }
+        else
+        {
+            prvCrcBench( pxCIO, ulKiB, pucData );
+            vPortFree( pucData );
+        }
+    }
+    else if( strcmp( "fs", ppcArgv[ 1 ] ) == 0 )
+    {
+        uint32_t ulKiB = FLASHBENCH_FS_DEFAULT_KIB;
+        uint8_t * pucData = NULL;
+        lfs_t * pxInternalLfs = NULL;
+
+        if( ulArgc > 2 )
+        {
+            ulKiB = ( uint32_t ) strtoul( ppcArgv[ 2 ], NULL, 10 );
+        }
+
+        if( ( ulKiB == 0 ) ||
+            ( ulKiB > FLASHBENCH_FS_MAX_KIB ) )
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "Error: Size must be between 1 and %d KiB.\r\n",
+                                              FLASHBENCH_FS_MAX_KIB ) );
+        }
+        else if( ( pxInternalLfs = prvGetInternalFs( pxCIO ) ) == NULL )
+        {
+            pxCIO->print( "Error: Failed to mount the internal flash filesystem.\r\n" );
+        }
+        else if( ( pucData = pvPortMalloc( FLASHBENCH_FS_CHUNK ) ) == NULL )
+        {
+            pxCIO->print( "Error: Failed to allocate the data buffer.\r\n" );
+        }
+        else
+        {
+            prvPrintScratch( pxCIO, snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "%-9s %9s %6s %10s %8s %10s %8s\r\n",
+                                              "backend", "mount us", "KiB", "write us", "KiB/s", "read us", "KiB/s" ) );
+
+            prvFsBench( pxCIO, "internal", pxInternalLfs, ulKiB, pucData );
+            prvFsBench( pxCIO, "ospi", pxLfs, ulKiB, pucData );
+            vPortFree( pucData );
+        }
+    }
+    else
+    {
+        pxCIO->print( xCommandDef_flashbench.pcHelpString );
+    }
+}
@@ -58,6 +58,7 @@ extern "C"
 #include <string.h>
 #include <inttypes.h>
 #include "FreeRTOS.h"
+#include "heap_track.h"
 
 /* Configuration */
 #define LFS_THREADSAFE
@@ -223,7 +224,7 @@ uint32_t lfs_crc( uint32_t crc,
 static inline void * lfs_malloc( size_t size )
 {
     #ifndef LFS_NO_MALLOC
-        return pvPortMalloc( size );
+        return pvHeapTrackMalloc( HEAP_SUBSYS_FS, size );
     #else
         ( void ) size;
         return NULL;
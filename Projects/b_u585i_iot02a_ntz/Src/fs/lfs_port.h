@@ -38,3 +38,9 @@
 
 /* Provided outside of the lfs port */
 lfs_t * pxGetDefaultFsCtx( void );
+
+/* Time taken by the lfs_mount call at boot */
+uint32_t ulGetFsMountTimeUs( void );
+
+/* Time taken by KVStore_init at boot, 0 if it did not run */
+uint32_t ulGetKvStoreInitTimeUs( void );
@@ -0,0 +1,89 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * CRC-32 implementations for littlefs (polynomial 0x04c11db7, reflected, no
+ * final xor). lfs_crc uses the CRC peripheral once lfs_crc_hw_init has been
+ * called and the slice-by-8 software implementation otherwise. All backends
+ * return identical results and can be chained across buffers.
+ */
+
+#ifndef _LFS_PORT_CRC_H
+#define _LFS_PORT_CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Set to 0 to build without the STM32 CRC peripheral, as in the host benchmark */
+#ifndef LFS_PORT_CRC_HW
+#define LFS_PORT_CRC_HW    ( 1 )
+#endif
+
+typedef enum
+{
+    LFS_CRC_BACKEND_NIBBLE = 0, /* 16 entry table, 4 bits per step */
+    LFS_CRC_BACKEND_SLICE8,     /* 8 x 256 entry tables, 8 bytes per step */
+    LFS_CRC_BACKEND_HW,         /* STM32 CRC peripheral */
+    LFS_CRC_BACKEND_MAX
+} LfsCrcBackend_t;
+
+typedef uint32_t ( * LfsCrcFunction_t )( uint32_t crc,
+                                         const void * buffer,
+                                         size_t size );
+
+uint32_t lfs_crc_nibble( uint32_t crc,
+                         const void * buffer,
+                         size_t size );
+
+uint32_t lfs_crc_slice8( uint32_t crc,
+                         const void * buffer,
+                         size_t size );
+
+#if LFS_PORT_CRC_HW != 0
+
+/* Setup the CRC peripheral and select it for lfs_crc. Returns 0 on success. */
+    int lfs_crc_hw_init( void );
+
+    uint32_t lfs_crc_hw( uint32_t crc,
+                         const void * buffer,
+                         size_t size );
+#endif
+
+/* Returns the implementation of a backend, or NULL if it is not available */
+LfsCrcFunction_t lfs_crc_get_function( LfsCrcBackend_t xBackend );
+
+const char * lfs_crc_get_name( LfsCrcBackend_t xBackend );
+
+/*
+ * Select the implementation used by lfs_crc, for benchmarking. Returns 0 on
+ * success. Must not be called while another task accesses a filesystem.
+ */
+int lfs_crc_set_backend( LfsCrcBackend_t xBackend );
+
+LfsCrcBackend_t lfs_crc_get_backend( void );
+
+#endif /* _LFS_PORT_CRC_H */
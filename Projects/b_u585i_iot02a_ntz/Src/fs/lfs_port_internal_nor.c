@@ -33,46 +33,88 @@
 #include "lfs_util.h"
 #include "lfs.h"
 #include "lfs_port_prv.h"
+#include "lfs_port_crc.h"
 
 #include "stm32u585xx.h"
 #include "stm32u5xx.h"
 #include "stm32u5xx_hal_flash.h"
 #include "stm32u5xx_hal_flash_ex.h"
+#include "stm32u5xx_hal_icache.h"
 
-/* Uses all pages of Bank 2
- *
+/*
+ * The filesystem uses the pages reserved at the end of a bank by the LFS_INT region
+ * of the linker script, which are outside of the image and of the OTA erase.
+ * LFS_INTERNAL_NOR_BANK selects the physical bank. Where the partition appears in
+ * the memory map depends on the bank swap option, which is read at initialization.
+ * Pick the bank that does not hold the running image to avoid stalling on fetches
+ * while a page is programmed or erased.
  */
-/*TODO: Modify to use a single portion of the first flash bank and handle flash bank-swapping for OTA. */
+#ifndef LFS_INTERNAL_NOR_BANK
+#define LFS_INTERNAL_NOR_BANK        FLASH_BANK_2
+#endif
 
-/* Use second bank to avoid program flash. TODO: Should add variable in linker script to mark end of program flash */
-#define CONFIG_LFS_FLASH_BASE        ( FLASH_BASE + FLASH_BANK_SIZE )
 #define LFS_CONFIG_LOOKAHEAD_SIZE    16
-#define LFS_CONFIG_CACHE_SIZE        16
+#define LFS_CONFIG_CACHE_SIZE        512
+
+/* Smallest program unit, and the unit of a burst program */
+#define LFS_INTERNAL_QUADWORD_SZ     ( 4 * sizeof( uint32_t ) )
+#define LFS_INTERNAL_BURST_SZ        ( 8 * LFS_INTERNAL_QUADWORD_SZ )
+
+/* Provided by the linker script, relative to the start of a bank */
+extern uint32_t _lfs_internal_offset[];
+extern uint32_t _lfs_internal_size[];
+
+static uint32_t ulPartitionAddr = 0;
+static uint32_t ulPartitionFirstPage = 0;
 
 #ifdef LFS_NO_MALLOC
-static uint8_t __ALIGN_BEGIN ucReadBuffer[ CONFIG_SIZE_CACHE_BUFFER ] __ALIGN_END = { 0 };
-static uint8_t __ALIGN_BEGIN ucProgBuffer[ CONFIG_SIZE_CACHE_BUFFER ] __ALIGN_END = { 0 };
-static uint8_t __ALIGN_BEGIN ucLookAheadBuffer[ CONFIG_SIZE_LOOKAHEAD_BUFFER ] __ALIGN_END = { 0 };
+static uint8_t __ALIGN_BEGIN ucReadBuffer[ LFS_CONFIG_CACHE_SIZE ] __ALIGN_END = { 0 };
+static uint8_t __ALIGN_BEGIN ucProgBuffer[ LFS_CONFIG_CACHE_SIZE ] __ALIGN_END = { 0 };
+static uint8_t __ALIGN_BEGIN ucLookAheadBuffer[ LFS_CONFIG_LOOKAHEAD_SIZE ] __ALIGN_END = { 0 };
 static struct lfs_config xLfsCfg = { 0 };
 static struct LfsPortCtx xLfsCtx = { 0 };
 static StaticSemaphore_t xMutexStatic;
 #endif
 
+static void prvInitPartition( void )
+{
+    uint32_t ulBankAddr = FLASH_BASE;
+    BaseType_t xSwapped = ( READ_BIT( FLASH->OPTR, FLASH_OPTR_SWAP_BANK ) != 0 ) ? pdTRUE : pdFALSE;
+
+    /* Bank 2 is mapped first when the banks are swapped */
+    if( ( LFS_INTERNAL_NOR_BANK == FLASH_BANK_2 ) != ( xSwapped == pdTRUE ) )
+    {
+        ulBankAddr += FLASH_BANK_SIZE;
+    }
+
+    ulPartitionAddr = ulBankAddr + ( uint32_t ) _lfs_internal_offset;
+    ulPartitionFirstPage = ( uint32_t ) _lfs_internal_offset / FLASH_PAGE_SIZE;
+
+    configASSERT( ( ( uint32_t ) _lfs_internal_offset % FLASH_PAGE_SIZE ) == 0 );
+    configASSERT( ( ( uint32_t ) _lfs_internal_offset + ( uint32_t ) _lfs_internal_size ) <= FLASH_BANK_SIZE );
+}
+
+/*
+ * The flash interface writes behind the instruction cache, which also caches data
+ * loads from flash. Drop any lines of the partition left over from before a program
+ * or erase.
+ */
+static void prvInvalidateCache( void )
+{
+    ( void ) HAL_ICACHE_Invalidate();
+}
+
+/* Reads are plain loads from the memory map, the flash interface is not involved */
 static int lfs_port_read( const struct lfs_config * c,
                           lfs_block_t block,
                           lfs_off_t off,
                           void * buffer,
                           lfs_size_t size )
 {
-    HAL_FLASH_Unlock();
-    __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
-
-    uint32_t src_address = CONFIG_LFS_FLASH_BASE + block * c->block_size + off;
+    uint32_t src_address = ulPartitionAddr + block * c->block_size + off;
 
     ( void ) memcpy( buffer, ( void * ) src_address, size );
 
-    HAL_FLASH_Lock();
-
     return 0;
 }
 
@@ -83,57 +125,84 @@ static int lfs_port_prog( const struct lfs_config * c,
                           lfs_size_t size )
 {
     HAL_StatusTypeDef xHAL_Status = HAL_OK;
-    uint32_t n_rows = size / c->prog_size;
-    uint32_t dest_address = 0;
-    uint32_t src_address = 0;
-    uint32_t block_base_addr = CONFIG_LFS_FLASH_BASE + block * c->block_size;
+    uint32_t dest_address = ulPartitionAddr + block * c->block_size + off;
+    uint32_t src_address = ( uint32_t ) buffer;
+    uint32_t end_address = dest_address + size;
 
     struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) c->context;
 
     configASSERT( xQueueGetMutexHolder( pxCtx->xMutex ) == xTaskGetCurrentTaskHandle() );
+    configASSERT( ( size % LFS_INTERNAL_QUADWORD_SZ ) == 0 );
 
-    HAL_FLASH_Unlock();
+    xHAL_Status = HAL_FLASH_Unlock();
     __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
 
-    for( uint32_t i_row = 0; i_row < n_rows; i_row++ )
+    /* Burst program aligned runs of 8 quad-words, single quad-words around them */
+    while( ( xHAL_Status == HAL_OK ) &&
+           ( dest_address < end_address ) )
     {
-        dest_address = block_base_addr + off + i_row * 4 * sizeof( uint32_t );
-        src_address = ( uint32_t ) buffer + i_row * 4 * sizeof( uint32_t );
-        xHAL_Status = HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, dest_address, src_address );
-
-        if( xHAL_Status != HAL_OK )
+        if( ( ( dest_address % LFS_INTERNAL_BURST_SZ ) == 0 ) &&
+            ( ( end_address - dest_address ) >= LFS_INTERNAL_BURST_SZ ) )
         {
-            HAL_FLASH_Lock();
-            return -1;
+            xHAL_Status = HAL_FLASH_Program( FLASH_TYPEPROGRAM_BURST, dest_address, src_address );
+            dest_address += LFS_INTERNAL_BURST_SZ;
+            src_address += LFS_INTERNAL_BURST_SZ;
+        }
+        else
+        {
+            xHAL_Status = HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, dest_address, src_address );
+            dest_address += LFS_INTERNAL_QUADWORD_SZ;
+            src_address += LFS_INTERNAL_QUADWORD_SZ;
         }
     }
 
-    HAL_FLASH_Lock();
+    ( void ) HAL_FLASH_Lock();
 
-    return 0;
+    prvInvalidateCache();
+
+    if( xHAL_Status != HAL_OK )
+    {
+        LogError( "Failed to program block %lu at offset %lu, error: 0x%08lx.",
+                  ( unsigned long ) block, ( unsigned long ) off, ( unsigned long ) HAL_FLASH_GetError() );
+    }
+
+    return ( xHAL_Status == HAL_OK ) ? 0 : LFS_ERR_IO;
 }
 
 static int lfs_port_erase( const struct lfs_config * c,
                            lfs_block_t block )
 {
     uint32_t ulPageError = 0;
+    HAL_StatusTypeDef xHAL_Status = HAL_OK;
     FLASH_EraseInitTypeDef xErase_Config = { 0 };
     struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) c->context;
 
     configASSERT( xQueueGetMutexHolder( pxCtx->xMutex ) == xTaskGetCurrentTaskHandle() );
 
     xErase_Config.TypeErase = FLASH_TYPEERASE_PAGES;
-    xErase_Config.Banks = FLASH_BANK_2;
-    xErase_Config.Page = block;
+    xErase_Config.Banks = LFS_INTERNAL_NOR_BANK;
+    xErase_Config.Page = ulPartitionFirstPage + block;
     xErase_Config.NbPages = 1;
 
-    HAL_FLASH_Unlock();
+    xHAL_Status = HAL_FLASH_Unlock();
     __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
-    HAL_StatusTypeDef xHAL_Status = HAL_FLASHEx_Erase( &xErase_Config, &ulPageError );
 
-    HAL_FLASH_Lock();
+    if( xHAL_Status == HAL_OK )
+    {
+        xHAL_Status = HAL_FLASHEx_Erase( &xErase_Config, &ulPageError );
+    }
+
+    ( void ) HAL_FLASH_Lock();
+
+    prvInvalidateCache();
+
+    if( xHAL_Status != HAL_OK )
+    {
+        LogError( "Failed to erase block %lu, error: 0x%08lx.",
+                  ( unsigned long ) block, ( unsigned long ) HAL_FLASH_GetError() );
+    }
 
-    return xHAL_Status == HAL_OK ? 0 : -1;
+    return ( xHAL_Status == HAL_OK ) ? 0 : LFS_ERR_IO;
 }
 
 static int lfs_port_sync( const struct lfs_config * c )
@@ -154,16 +223,17 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
 
     #ifdef LFS_THREADSAFE
         pxCfg->lock = &lfs_port_lock;
-        pxCfg->lock = &lfs_port_unlock;
+        pxCfg->unlock = &lfs_port_unlock;
     #endif
 
     pxCfg->read_size = 1;
-    pxCfg->prog_size = 16;
+    pxCfg->prog_size = LFS_INTERNAL_QUADWORD_SZ;
     pxCfg->block_size = FLASH_PAGE_SIZE;
 
-    pxCfg->block_count = FLASH_PAGE_NB;
+    pxCfg->block_count = ( uint32_t ) _lfs_internal_size / FLASH_PAGE_SIZE;
     pxCfg->block_cycles = 500;
 
+    /* Programs of a whole cache line can use burst programming */
     pxCfg->cache_size = LFS_CONFIG_CACHE_SIZE;
     pxCfg->lookahead_size = LFS_CONFIG_LOOKAHEAD_SIZE;
 
@@ -194,12 +264,19 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
     {
         xLfsCfg.context = ( void * ) &xLfsCtx;
 
-        xLfsCtx.xMutex = xSemaphoreCreateMutexStatic( &( &xMutexStatic ) );
+        xLfsCtx.xMutex = xSemaphoreCreateMutexStatic( &xMutexStatic );
         xLfsCtx.xBlockTime = xBlockTime;
 
         configASSERT( xLfsCtx.xMutex != NULL );
 
+        prvInitPartition();
+
         vPopulateConfig( &xLfsCfg, &xLfsCtx );
+
+        /* Falls back to the software CRC if the peripheral is not available */
+        ( void ) lfs_crc_hw_init();
+
+        return &xLfsCfg;
     }
 #else /* ifdef LFS_NO_MALLOC */
 
@@ -214,7 +291,7 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
 
         configASSERT( pxCfg != NULL );
 
-        struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) ( pvPortMalloc( sizeof( struct lfs_config ) ) );
+        struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) ( pvPortMalloc( sizeof( struct LfsPortCtx ) ) );
 
         configASSERT( pxCtx != NULL );
 
@@ -222,7 +299,12 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
         pxCtx->xMutex = xSemaphoreCreateMutex();
         configASSERT( pxCtx->xMutex != NULL );
 
+        prvInitPartition();
+
         vPopulateConfig( pxCfg, pxCtx );
+
+        /* Falls back to the software CRC if the peripheral is not available */
+        ( void ) lfs_crc_hw_init();
         return pxCfg;
     }
 #endif /* LFS_NO_MALLOC */
@@ -236,7 +318,7 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
         const char * path = "boot_count";
 
         #ifdef LFS_NO_MALLOC
-        static uint8_t __ALIGN_BEGIN ucFileCache[ CONFIG_SIZE_CACHE_BUFFER ] __ALIGN_END = { 0 };
+        static uint8_t __ALIGN_BEGIN ucFileCache[ LFS_CONFIG_CACHE_SIZE ] __ALIGN_END = { 0 };
         struct lfs_file_config xFileConfig = { 0 };
 
         xFileConfig.buffer = ( void * ) ucFileCache;
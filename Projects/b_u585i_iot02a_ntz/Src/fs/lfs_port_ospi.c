@@ -35,7 +35,9 @@
 #include "lfs_util.h"
 #include "lfs.h"
 #include "lfs_port_prv.h"
+#include "lfs_port_crc.h"
 #include "ospi_nor_mx25lmxxx45g.h"
+#include "trace_ring.h"
 
 /*
  * LittleFS port for the external NOR flash connected to the STM32U5 octo-spi interface
@@ -136,6 +138,9 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
         configASSERT( xLfsCtx.xMutex != NULL );
 
         vPopulateConfig( &xLfsCfg, &xLfsCtx );
+
+        /* Falls back to the software CRC if the peripheral is not available */
+        ( void ) lfs_crc_hw_init();
     }
 #else /* ifdef LFS_NO_MALLOC */
 
@@ -162,6 +167,9 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
 
         vPopulateConfig( pxCfg, pxCtx );
 
+        /* Falls back to the software CRC if the peripheral is not available */
+        ( void ) lfs_crc_hw_init();
+
         BaseType_t xSuccess = ospi_Init( &( pxCtx->xOSPIHandle ) );
 
         configASSERT( xSuccess == pdTRUE );
@@ -198,6 +206,8 @@ static int lfs_port_read( const struct lfs_config * c,
 
     uint32_t ulReadAddr = OPI_START_ADDRESS + ( block * c->block_size ) + off;
 
+    TRACE_BEGIN( TRACE_ID_LFS_READ, ulReadAddr );
+
     if( ospi_ReadAddr( &( pxCtx->xOSPIHandle ),
                        ulReadAddr,
                        pvBuffer,
@@ -207,6 +217,8 @@ static int lfs_port_read( const struct lfs_config * c,
         lReturnValue = -1;
     }
 
+    TRACE_END( TRACE_ID_LFS_READ, ( lReturnValue == 0 ) ? size : lReturnValue );
+
     LogDebug( "Reading address 0x%010lX, size: %lu, rv: %ld", ulReadAddr, size, lReturnValue );
 
     return lReturnValue;
@@ -239,21 +251,20 @@ static int lfs_port_prog( const struct lfs_config * pxCfg,
     LogDebug( "Programming Start Addr: 0x%010lX, End Addr: 0x%010lX, size: %lu, block: %lu, offset: %lu, rv: %ld",
               ulStartAddr, ulLastAddr, size, block, off, lReturnValue );
 
-    for( uint32_t ulWriteAddr = ulStartAddr; ulWriteAddr <= ulLastAddr; ulWriteAddr += MX25LM_PROGRAM_FIFO_LEN )
+    TRACE_BEGIN( TRACE_ID_LFS_PROG, ulStartAddr );
+
+    /* Each page program waits for the previous one, the last one completes in the background */
+    if( ospi_WritePagesStart( &( pxCtx->xOSPIHandle ),
+                              ulStartAddr,
+                              pvBuffer,
+                              size,
+                              pdMS_TO_TICKS( MX25LM_WRITE_TIMEOUT_MS ) ) != pdTRUE )
     {
-        LogDebug( "Writing block at addr: 0x%010lX, len: %lu", ulWriteAddr, MX25LM_PROGRAM_FIFO_LEN );
-
-        if( ospi_WriteAddr( &( pxCtx->xOSPIHandle ),
-                            ulWriteAddr,
-                            &( ( ( uint8_t * ) pvBuffer )[ ulWriteAddr - ulStartAddr ] ),
-                            MX25LM_PROGRAM_FIFO_LEN,
-                            pdMS_TO_TICKS( MX25LM_WRITE_TIMEOUT_MS ) ) != pdTRUE )
-        {
-            lReturnValue = -1;
-            break;
-        }
+        lReturnValue = -1;
     }
 
+    TRACE_END( TRACE_ID_LFS_PROG, ( lReturnValue == 0 ) ? size : lReturnValue );
+
     return lReturnValue;
 }
 
@@ -271,19 +282,39 @@ static int lfs_port_erase( const struct lfs_config * pxCfg,
 
     LogDebug( "Starting erase operation addr: 0x%010lX ", ulEraseAddr );
 
-    if( ospi_EraseSector( &( pxCtx->xOSPIHandle ),
-                          ulEraseAddr,
-                          pdMS_TO_TICKS( MX25LM_ERASE_TIMEOUT_MS ) ) != pdTRUE )
+    TRACE_BEGIN( TRACE_ID_LFS_ERASE, ulEraseAddr );
+
+    /* Reads from other sectors suspend the erase until it completes */
+    if( ospi_EraseSectorStart( &( pxCtx->xOSPIHandle ),
+                               ulEraseAddr,
+                               pdMS_TO_TICKS( MX25LM_ERASE_TIMEOUT_MS ) ) != pdTRUE )
     {
         lReturnValue = -1;
     }
 
-    LogDebug( "Erase operation completed. Address: 0x%010lX Return Value: %ld", ulEraseAddr, lReturnValue );
+    TRACE_END( TRACE_ID_LFS_ERASE, lReturnValue );
+
+    LogDebug( "Erase operation started. Address: 0x%010lX Return Value: %ld", ulEraseAddr, lReturnValue );
 
     return lReturnValue;
 }
 
+/*
+ * Wait for the last program or erase to complete, so littlefs only considers
+ * data committed once it is on the flash.
+ */
 static int lfs_port_sync( const struct lfs_config * c )
 {
-    return 0;
+    configASSERT( c != NULL );
+
+    int32_t lReturnValue = 0;
+    struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) c->context;
+
+    if( ospi_WaitForIdle( &( pxCtx->xOSPIHandle ),
+                          pdMS_TO_TICKS( MX25LM_ERASE_TIMEOUT_MS ) ) != pdTRUE )
+    {
+        lReturnValue = -1;
+    }
+
+    return lReturnValue;
 }
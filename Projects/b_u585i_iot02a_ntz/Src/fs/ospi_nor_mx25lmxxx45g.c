@@ -32,11 +32,68 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+#include <string.h>
+
+#include "hw_defs.h"
 #include "ospi_nor_mx25lmxxx45g.h"
 
+/* DCACHE1 line size */
+#define OSPI_DCACHE_LINE_SZ    ( 16 )
+
+/* GPDMA channel used for page program data, channels 4 and 5 are used by SPI2 */
+#define OSPI_GPDMA_CHANNEL     GPDMA1_Channel6
+#define OSPI_GPDMA_IRQn        GPDMA1_Channel6_IRQn
+
 static TaskHandle_t xTaskHandle = NULL;
 static OSPI_HandleTypeDef * s_pxOSPI = NULL;
 
+static BaseType_t xMemMappedReadEnabled = ( MX25LM_MEMORY_MAPPED_READ != 0 );
+static BaseType_t xMemMappedActive = pdFALSE;
+
+typedef enum
+{
+    OSPI_OP_NONE = 0,
+    OSPI_OP_PROGRAM,
+    OSPI_OP_ERASE
+} OspiOp_t;
+
+/* Program or erase started by ospi_WriteAddrStart or ospi_EraseSectorStart which has not completed yet */
+static OspiOp_t xOpInFlight = OSPI_OP_NONE;
+static uint32_t ulOpAddr = 0;
+static uint32_t ulOpLen = 0;
+
+/* Cycle count at the last start or resume of the operation in flight */
+static uint32_t ulOpRunCycles = 0;
+
+/* Set when a completed operation failed, until reported by ospi_WaitForIdle */
+static BaseType_t xOpFailed = pdFALSE;
+
+static BaseType_t xSuspendForReadEnabled = ( MX25LM_SUSPEND_FOR_READ != 0 );
+static OspiNorStats_t xStats = { 0 };
+
+static BaseType_t xProgramDmaEnabled = ( MX25LM_PROGRAM_DMA != 0 );
+
+static DMA_HandleTypeDef xHndlGpdmaOspi =
+{
+    .Instance                  = OSPI_GPDMA_CHANNEL,
+    .Init                      =
+    {
+        .Request               = GPDMA1_REQUEST_OCTOSPI2,
+        .BlkHWRequest          = DMA_BREQ_SINGLE_BURST,
+        .Direction             = DMA_MEMORY_TO_PERIPH,
+        .SrcInc                = DMA_SINC_INCREMENTED,
+        .DestInc               = DMA_DINC_FIXED,
+        .SrcDataWidth          = DMA_SRC_DATAWIDTH_BYTE,
+        .DestDataWidth         = DMA_DEST_DATAWIDTH_BYTE,
+        .Priority              = DMA_LOW_PRIORITY_HIGH_WEIGHT,
+        .SrcBurstLength        = 1,
+        .DestBurstLength       = 1,
+        .TransferAllocatedPort = DMA_SRC_ALLOCATED_PORT0 | DMA_DEST_ALLOCATED_PORT1,
+        .TransferEventMode     = DMA_TCEM_BLOCK_TRANSFER,
+        .Mode                  = DMA_NORMAL,
+    },
+};
+
 static inline void ospi_HandleCallback( OSPI_HandleTypeDef * pxOSPI,
                                         HAL_OSPI_CallbackIDTypeDef xCallbackId )
 {
@@ -123,6 +180,41 @@ static void ospi_IRQHandler( void )
     HAL_OSPI_IRQHandler( s_pxOSPI );
 }
 
+static void ospi_DmaIRQHandler( void )
+{
+    HAL_DMA_IRQHandler( &xHndlGpdmaOspi );
+}
+
+/* Setup the GPDMA channel for page program data, falling back to interrupt transfers on failure */
+static void ospi_DmaInit( OSPI_HandleTypeDef * pxOSPI )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+
+    __HAL_RCC_GPDMA1_CLK_ENABLE();
+
+    xHalStatus = HAL_DMA_Init( &xHndlGpdmaOspi );
+
+    if( xHalStatus == HAL_OK )
+    {
+        __HAL_LINKDMA( pxOSPI, hdma, xHndlGpdmaOspi );
+
+        xHalStatus = HAL_DMA_ConfigChannelAttributes( &xHndlGpdmaOspi, DMA_CHANNEL_NPRIV );
+    }
+
+    if( xHalStatus == HAL_OK )
+    {
+        NVIC_SetVector( OSPI_GPDMA_IRQn, ( uint32_t ) ospi_DmaIRQHandler );
+
+        HAL_NVIC_SetPriority( OSPI_GPDMA_IRQn, 5, 0 );
+        HAL_NVIC_EnableIRQ( OSPI_GPDMA_IRQn );
+    }
+    else
+    {
+        xProgramDmaEnabled = pdFALSE;
+        LogError( "Error while initializing GPDMA for OSPI, using interrupt transfers." );
+    }
+}
+
 /* Initialize static variables for the current operation */
 static inline void ospi_OpInit( OSPI_HandleTypeDef * pxOSPI )
 {
@@ -195,6 +287,8 @@ static void ospi_MspInitCallback( OSPI_HandleTypeDef * pxOSPI )
     /* OCTOSPI2 interrupt Init */
     HAL_NVIC_SetPriority( OCTOSPI2_IRQn, 5, 0 );
     HAL_NVIC_EnableIRQ( OCTOSPI2_IRQn );
+
+    ospi_DmaInit( pxOSPI );
 }
 
 static void ospi_MspDeInitCallback( OSPI_HandleTypeDef * pxOSPI )
@@ -225,6 +319,9 @@ static void ospi_MspDeInitCallback( OSPI_HandleTypeDef * pxOSPI )
 
     /* OCTOSPI2 interrupt DeInit */
     HAL_NVIC_DisableIRQ( OCTOSPI2_IRQn );
+
+    HAL_NVIC_DisableIRQ( OSPI_GPDMA_IRQn );
+    ( void ) HAL_DMA_DeInit( &xHndlGpdmaOspi );
 }
 
 static BaseType_t ospi_InitDriver( OSPI_HandleTypeDef * pxOSPI )
@@ -344,18 +441,21 @@ static void ospi_AbortTransaction( OSPI_HandleTypeDef * pxOSPI,
     ( void ) ospi_WaitForCallback( HAL_OSPI_ABORT_CB_ID, xTimeout );
 }
 
-static BaseType_t ospi_cmd_OPI_WREN( OSPI_HandleTypeDef * pxOSPI,
-                                     TickType_t xTimeout )
+/*
+ * Send an instruction without address or data in OPI mode. The command completes
+ * within a few bus cycles, so the transfer complete flag is polled rather than
+ * waiting for an interrupt and a task notification.
+ */
+static BaseType_t ospi_OPI_SendInstruction( OSPI_HandleTypeDef * pxOSPI,
+                                            uint32_t ulInstruction,
+                                            TickType_t xTimeout )
 {
-    HAL_StatusTypeDef xHalStatus = HAL_OK;
-    BaseType_t xSuccess = pdTRUE;
-
     OSPI_RegularCmdTypeDef xCmd =
     {
         .OperationType      = HAL_OSPI_OPTYPE_COMMON_CFG,
         .FlashId            = HAL_OSPI_FLASH_ID_1,
 
-        .Instruction        = MX25LM_OPI_WREN,
+        .Instruction        = ulInstruction,
         .InstructionMode    = HAL_OSPI_INSTRUCTION_8_LINES, /* 8 line STR mode */
         .InstructionSize    = HAL_OSPI_INSTRUCTION_16_BITS, /* 2 byte instructions */
         .InstructionDtrMode = HAL_OSPI_INSTRUCTION_DTR_DISABLE,
@@ -371,23 +471,13 @@ static BaseType_t ospi_cmd_OPI_WREN( OSPI_HandleTypeDef * pxOSPI,
         .SIOOMode           = HAL_OSPI_SIOO_INST_EVERY_CMD,
     };
 
-    /* Clear notification state */
-    ( void ) xTaskNotifyStateClearIndexed( NULL, 1 );
-
-    /* Send command */
-    xHalStatus = HAL_OSPI_Command_IT( pxOSPI, &xCmd );
-
-    /* Wait for command complete callback */
-    if( xHalStatus == HAL_OK )
-    {
-        xSuccess = ospi_WaitForCallback( HAL_OSPI_CMD_CPLT_CB_ID, xTimeout );
-    }
-    else
-    {
-        xSuccess = pdFALSE;
-    }
+    return( HAL_OSPI_Command( pxOSPI, &xCmd, xTimeout ) == HAL_OK );
+}
 
-    return( xSuccess );
+static BaseType_t ospi_cmd_OPI_WREN( OSPI_HandleTypeDef * pxOSPI,
+                                     TickType_t xTimeout )
+{
+    return ospi_OPI_SendInstruction( pxOSPI, MX25LM_OPI_WREN, xTimeout );
 }
 
 static BaseType_t ospi_OPI_WaitForStatus( OSPI_HandleTypeDef * pxOSPI,
@@ -465,6 +555,103 @@ static BaseType_t ospi_OPI_WaitForStatus( OSPI_HandleTypeDef * pxOSPI,
     return xSuccess;
 }
 
+/* Setup a one byte register read (RDSR, RDSCUR) in OPI mode */
+static void ospi_OPI_GetReadRegCmd( OSPI_RegularCmdTypeDef * pxCmd,
+                                    uint32_t ulInstruction )
+{
+    OSPI_RegularCmdTypeDef xCmd =
+    {
+        .OperationType      = HAL_OSPI_OPTYPE_COMMON_CFG,
+        .FlashId            = HAL_OSPI_FLASH_ID_1,
+
+        .Instruction        = ulInstruction,
+        .InstructionMode    = HAL_OSPI_INSTRUCTION_8_LINES, /* 8 line STR mode */
+        .InstructionSize    = HAL_OSPI_INSTRUCTION_16_BITS, /* 2 byte instructions */
+        .InstructionDtrMode = HAL_OSPI_INSTRUCTION_DTR_DISABLE,
+
+        .Address            = 0x00000000,
+        .AddressMode        = HAL_OSPI_ADDRESS_8_LINES,
+        .AddressSize        = HAL_OSPI_ADDRESS_32_BITS,
+        .AddressDtrMode     = HAL_OSPI_DATA_DTR_DISABLE,
+
+        .AlternateBytesMode = HAL_OSPI_ALTERNATE_BYTES_NONE,
+
+        .DataMode           = HAL_OSPI_DATA_8_LINES,
+        .DataDtrMode        = HAL_OSPI_DATA_DTR_DISABLE,
+        .NbData             = 1,
+
+        .DummyCycles        = 4,
+        .DQSMode            = HAL_OSPI_DQS_DISABLE,
+        .SIOOMode           = HAL_OSPI_SIOO_INST_EVERY_CMD,
+    };
+
+    *pxCmd = xCmd;
+}
+
+/* Read a one byte register, polling for the single data byte */
+static BaseType_t ospi_OPI_ReadReg( OSPI_HandleTypeDef * pxOSPI,
+                                    uint32_t ulInstruction,
+                                    uint8_t * pucValue,
+                                    TickType_t xTimeout )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+    OSPI_RegularCmdTypeDef xCmd = { 0 };
+
+    ospi_OPI_GetReadRegCmd( &xCmd, ulInstruction );
+
+    xHalStatus = HAL_OSPI_Command( pxOSPI, &xCmd, xTimeout );
+
+    if( xHalStatus == HAL_OK )
+    {
+        xHalStatus = HAL_OSPI_Receive( pxOSPI, pucValue, xTimeout );
+    }
+
+    if( xHalStatus != HAL_OK )
+    {
+        ( void ) HAL_OSPI_Abort( pxOSPI );
+    }
+
+    return( xHalStatus == HAL_OK );
+}
+
+/*
+ * Poll the status register until it matches, without waiting for an interrupt.
+ * Only used for conditions expected within microseconds (WEL after WREN, WIP
+ * after a suspend). ospi_OPI_WaitForStatus is used for program and erase completion.
+ */
+static BaseType_t ospi_OPI_PollStatus( OSPI_HandleTypeDef * pxOSPI,
+                                       uint32_t ulMask,
+                                       uint32_t ulMatch,
+                                       TickType_t xTimeout )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+    OSPI_RegularCmdTypeDef xCmd = { 0 };
+
+    OSPI_AutoPollingTypeDef xPollingCfg =
+    {
+        .MatchMode     = HAL_OSPI_MATCH_MODE_AND,
+        .AutomaticStop = HAL_OSPI_AUTOMATIC_STOP_ENABLE,
+        .Interval      = 0x10,
+        .Match         = ulMatch,
+        .Mask          = ulMask,
+    };
+
+    ospi_OPI_GetReadRegCmd( &xCmd, MX25LM_OPI_RDSR );
+
+    xHalStatus = HAL_OSPI_Command( pxOSPI, &xCmd, xTimeout );
+
+    if( xHalStatus == HAL_OK )
+    {
+        xHalStatus = HAL_OSPI_AutoPolling( pxOSPI, &xPollingCfg, xTimeout );
+    }
+
+    if( xHalStatus != HAL_OK )
+    {
+        ( void ) HAL_OSPI_Abort( pxOSPI );
+    }
+
+    return( xHalStatus == HAL_OK );
+}
 
 static BaseType_t ospi_SPI_WaitForStatus( OSPI_HandleTypeDef * pxOSPI,
                                           uint32_t ulMask,
@@ -691,42 +878,139 @@ BaseType_t ospi_Init( OSPI_HandleTypeDef * pxOSPI )
     return xSuccess;
 }
 
-BaseType_t ospi_ReadAddr( OSPI_HandleTypeDef * pxOSPI,
-                          uint32_t ulAddr,
-                          void * pxBuffer,
-                          uint32_t ulBufferLen,
-                          TickType_t xTimeout )
+/* Setup an 8READ transaction, used for both indirect and memory mapped reads */
+static void ospi_Get8ReadCmd( OSPI_RegularCmdTypeDef * pxCmd,
+                              uint32_t ulOperationType,
+                              uint32_t ulAddr,
+                              uint32_t ulBufferLen )
+{
+    OSPI_RegularCmdTypeDef xCmd =
+    {
+        .OperationType      = ulOperationType,
+        .FlashId            = HAL_OSPI_FLASH_ID_1,
+
+        .Instruction        = MX25LM_OPI_8READ,
+        .InstructionMode    = HAL_OSPI_INSTRUCTION_8_LINES, /* 8 line STR mode */
+        .InstructionSize    = HAL_OSPI_INSTRUCTION_16_BITS, /* 2 byte instructions */
+        .InstructionDtrMode = HAL_OSPI_INSTRUCTION_DTR_DISABLE,
+
+        .Address            = ulAddr,
+        .AddressMode        = HAL_OSPI_ADDRESS_8_LINES,
+        .AddressSize        = HAL_OSPI_ADDRESS_32_BITS,
+        .AddressDtrMode     = HAL_OSPI_DATA_DTR_DISABLE,
+
+        .AlternateBytesMode = HAL_OSPI_ALTERNATE_BYTES_NONE,
+
+        .DataMode           = HAL_OSPI_DATA_8_LINES,
+        .DataDtrMode        = HAL_OSPI_DATA_DTR_DISABLE,
+        .NbData             = ulBufferLen,
+
+        .DummyCycles        = MX25LM_8READ_DUMMY_CYCLES,
+        .DQSMode            = HAL_OSPI_DQS_DISABLE,
+        .SIOOMode           = HAL_OSPI_SIOO_INST_EVERY_CMD,
+    };
+
+    *pxCmd = xCmd;
+}
+
+/*
+ * Switch the controller to memory mapped mode. The flash must not have a
+ * program or erase in flight, which is checked once here rather than on every read.
+ */
+static BaseType_t ospi_EnterMemoryMapped( OSPI_HandleTypeDef * pxOSPI,
+                                          TickType_t xTimeout )
 {
     HAL_StatusTypeDef xHalStatus = HAL_OK;
     BaseType_t xSuccess = pdTRUE;
+    OSPI_RegularCmdTypeDef xCmd = { 0 };
 
-    ospi_OpInit( pxOSPI );
+    /* Wait for idle condition (WIP bit should be 0) */
+    xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
+                                       MX25LM_REG_SR_WIP,
+                                       0x0,
+                                       xTimeout );
 
-    if( pxOSPI == NULL )
+    if( xSuccess == pdTRUE )
     {
-        xSuccess = pdFALSE;
-        LogError( "pxOSPI is NULL." );
+        ospi_Get8ReadCmd( &xCmd, HAL_OSPI_OPTYPE_READ_CFG, 0, 0 );
+        xHalStatus = HAL_OSPI_Command( pxOSPI, &xCmd, MX25LM_DEFAULT_TIMEOUT_MS );
     }
 
-    if( ulAddr >= MX25LM_MEM_SZ_BYTES )
+    if( ( xSuccess == pdTRUE ) &&
+        ( xHalStatus == HAL_OK ) )
     {
-        xSuccess = pdFALSE;
-        LogError( "Address is out of range." );
+        /* The controller requires a write configuration, writes to the region are not used */
+        xCmd.OperationType = HAL_OSPI_OPTYPE_WRITE_CFG;
+        xCmd.Instruction = MX25LM_OPI_PP;
+        xCmd.DummyCycles = 0;
+        xHalStatus = HAL_OSPI_Command( pxOSPI, &xCmd, MX25LM_DEFAULT_TIMEOUT_MS );
     }
 
-    if( pxBuffer == NULL )
+    if( ( xSuccess == pdTRUE ) &&
+        ( xHalStatus == HAL_OK ) )
     {
-        xSuccess = pdFALSE;
-        LogError( "pxBuffer is NULL." );
+        OSPI_MemoryMappedTypeDef xMemMappedCfg =
+        {
+            .TimeOutActivation = HAL_OSPI_TIMEOUT_COUNTER_ENABLE,
+            .TimeOutPeriod     = MX25LM_MEM_MAPPED_TIMEOUT,
+        };
+
+        xHalStatus = HAL_OSPI_MemoryMapped( pxOSPI, &xMemMappedCfg );
     }
 
-    if( ulBufferLen == 0 )
+    if( xSuccess != pdTRUE )
+    {
+        LogError( "Timed out while waiting for OSPI IDLE condition." );
+    }
+    else if( xHalStatus != HAL_OK )
     {
         xSuccess = pdFALSE;
-        LogError( "ulBufferLen is 0." );
+        ( void ) HAL_OSPI_Abort( pxOSPI );
+        LogError( "Failed to enter memory mapped mode." );
     }
+    else
+    {
+        xMemMappedActive = pdTRUE;
+    }
+
+    return xSuccess;
+}
+
+/* Return the controller to indirect mode before a command is sent */
+static void ospi_ExitMemoryMapped( OSPI_HandleTypeDef * pxOSPI )
+{
+    if( xMemMappedActive == pdTRUE )
+    {
+        if( HAL_OSPI_Abort( pxOSPI ) != HAL_OK )
+        {
+            LogError( "Failed to exit memory mapped mode." );
+        }
+
+        xMemMappedActive = pdFALSE;
+    }
+}
+
+/* Drop lines of the memory mapped region cached by DCACHE1 after a program or erase */
+static void ospi_InvalidateCache( uint32_t ulAddr,
+                                  uint32_t ulLen )
+{
+    if( pxHndlDCache != NULL )
+    {
+        uint32_t ulStart = ( MX25LM_MEM_MAPPED_BASE + ulAddr ) & ~( OSPI_DCACHE_LINE_SZ - 1 );
+        uint32_t ulEnd = ( MX25LM_MEM_MAPPED_BASE + ulAddr + ulLen + OSPI_DCACHE_LINE_SZ - 1 ) & ~( OSPI_DCACHE_LINE_SZ - 1 );
+
+        ( void ) HAL_DCACHE_InvalidateByAddr( pxHndlDCache, ( uint32_t * ) ulStart, ulEnd - ulStart );
+    }
+}
 
-    /*TODO is there a limit to the number of bytes read? */
+static BaseType_t ospi_ReadIndirect( OSPI_HandleTypeDef * pxOSPI,
+                                     uint32_t ulAddr,
+                                     void * pxBuffer,
+                                     uint32_t ulBufferLen,
+                                     TickType_t xTimeout )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+    BaseType_t xSuccess = pdTRUE;
 
     /* Wait for idle condition (WIP bit should be 0) */
     xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
@@ -741,32 +1025,9 @@ BaseType_t ospi_ReadAddr( OSPI_HandleTypeDef * pxOSPI,
     }
     else
     {
-        /* Setup an 8READ transaction */
-        OSPI_RegularCmdTypeDef xCmd =
-        {
-            .OperationType      = HAL_OSPI_OPTYPE_COMMON_CFG,
-            .FlashId            = HAL_OSPI_FLASH_ID_1,
-
-            .Instruction        = MX25LM_OPI_8READ,
-            .InstructionMode    = HAL_OSPI_INSTRUCTION_8_LINES, /* 8 line STR mode */
-            .InstructionSize    = HAL_OSPI_INSTRUCTION_16_BITS, /* 2 byte instructions */
-            .InstructionDtrMode = HAL_OSPI_INSTRUCTION_DTR_DISABLE,
+        OSPI_RegularCmdTypeDef xCmd = { 0 };
 
-            .Address            = ulAddr,
-            .AddressMode        = HAL_OSPI_ADDRESS_8_LINES,
-            .AddressSize        = HAL_OSPI_ADDRESS_32_BITS,
-            .AddressDtrMode     = HAL_OSPI_DATA_DTR_DISABLE,
-
-            .AlternateBytesMode = HAL_OSPI_ALTERNATE_BYTES_NONE,
-
-            .DataMode           = HAL_OSPI_DATA_8_LINES,
-            .DataDtrMode        = HAL_OSPI_DATA_DTR_DISABLE,
-            .NbData             = ulBufferLen,
-
-            .DummyCycles        = MX25LM_8READ_DUMMY_CYCLES,
-            .DQSMode            = HAL_OSPI_DQS_DISABLE,
-            .SIOOMode           = HAL_OSPI_SIOO_INST_EVERY_CMD,
-        };
+        ospi_Get8ReadCmd( &xCmd, HAL_OSPI_OPTYPE_COMMON_CFG, ulAddr, ulBufferLen );
 
         /* Clear notification state */
         ( void ) xTaskNotifyStateClearIndexed( NULL, 1 );
@@ -794,50 +1055,358 @@ BaseType_t ospi_ReadAddr( OSPI_HandleTypeDef * pxOSPI,
         {
             xSuccess = ospi_WaitForCallback( HAL_OSPI_RX_CPLT_CB_ID, xTimeout );
         }
+        else
+        {
+            xSuccess = pdFALSE;
+        }
     }
 
-    return( xSuccess );
+    return xSuccess;
 }
 
-/*
- * @Brief write up to 256 bytes to the given address.
- */
-BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
-                           uint32_t ulAddr,
-                           const void * pxBuffer,
-                           uint32_t ulBufferLen,
-                           TickType_t xTimeout )
+/* Finish the operation in flight once WIP has cleared, latching any failure reported by the flash */
+static BaseType_t ospi_OpComplete( OSPI_HandleTypeDef * pxOSPI,
+                                   TickType_t xTimeout )
 {
-    HAL_StatusTypeDef xHalStatus = HAL_OK;
     BaseType_t xSuccess = pdTRUE;
+    uint8_t ucScur = 0;
 
-    ospi_OpInit( pxOSPI );
+    xSuccess = ospi_OPI_ReadReg( pxOSPI, MX25LM_OPI_RDSCUR, &ucScur, xTimeout );
 
-    if( pxOSPI == NULL )
+    if( xSuccess != pdTRUE )
     {
-        xSuccess = pdFALSE;
+        xOpFailed = pdTRUE;
+        LogError( "Failed to read the security register." );
+    }
+    else if( ( ucScur & ( MX25LM_REG_SCUR_P_FAIL | MX25LM_REG_SCUR_E_FAIL ) ) != 0 )
+    {
+        xOpFailed = pdTRUE;
+        xStats.ulOpFailures++;
+        LogError( "%s at address 0x%08lX failed, SCUR: 0x%02X.",
+                  ( xOpInFlight == OSPI_OP_ERASE ) ? "Erase" : "Program",
+                  ulOpAddr, ucScur );
     }
 
-    if( ( ulBufferLen > 256 ) ||
-        ( ulBufferLen == 0 ) )
+    ospi_InvalidateCache( ulOpAddr, ulOpLen );
+    xOpInFlight = OSPI_OP_NONE;
+
+    return xSuccess;
+}
+
+/* Wait with hardware auto-polling for the operation in flight to complete */
+static BaseType_t ospi_WaitForOp( OSPI_HandleTypeDef * pxOSPI,
+                                  TickType_t xTimeout )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    if( xOpInFlight != OSPI_OP_NONE )
+    {
+        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
+                                           MX25LM_REG_SR_WIP | MX25LM_REG_SR_WEL,
+                                           0x0,
+                                           xTimeout );
+
+        if( xSuccess != pdTRUE )
+        {
+            LogError( "Timed out while waiting for program or erase to complete." );
+        }
+        else
+        {
+            xSuccess = ospi_OpComplete( pxOSPI, xTimeout );
+        }
+    }
+
+    return xSuccess;
+}
+
+/* Suspend the operation in flight, read with an 8READ command and resume the operation */
+static BaseType_t ospi_SuspendAndRead( OSPI_HandleTypeDef * pxOSPI,
+                                       uint32_t ulAddr,
+                                       void * pxBuffer,
+                                       uint32_t ulBufferLen,
+                                       TickType_t xTimeout,
+                                       BaseType_t * pxServed )
+{
+    const uint32_t ulMinRunCycles = ( SystemCoreClock / 1000000 ) * MX25LM_RESUME_TO_SUSPEND_US;
+    BaseType_t xSuccess = pdTRUE;
+    uint8_t ucScur = 0;
+
+    /* Back to back reads would otherwise keep the operation from making progress */
+    while( ( ulGetCycleCount() - ulOpRunCycles ) < ulMinRunCycles )
+    {
+    }
+
+    xSuccess = ospi_OPI_SendInstruction( pxOSPI, MX25LM_OPI_SUSPEND, xTimeout );
+
+    /* WIP clears once the operation is suspended */
+    if( xSuccess == pdTRUE )
+    {
+        xSuccess = ospi_OPI_PollStatus( pxOSPI,
+                                        MX25LM_REG_SR_WIP,
+                                        0x0,
+                                        xTimeout );
+    }
+
+    if( xSuccess == pdTRUE )
+    {
+        xSuccess = ospi_OPI_ReadReg( pxOSPI, MX25LM_OPI_RDSCUR, &ucScur, xTimeout );
+    }
+
+    if( xSuccess != pdTRUE )
+    {
+        LogError( "Failed to suspend program or erase." );
+    }
+    else if( ( ucScur & ( MX25LM_REG_SCUR_PSB | MX25LM_REG_SCUR_ESB ) ) == 0 )
+    {
+        /* The operation completed before the suspend took effect */
+        xSuccess = ospi_OpComplete( pxOSPI, xTimeout );
+    }
+    else
+    {
+        xStats.ulSuspends++;
+        *pxServed = pdTRUE;
+
+        xSuccess = ospi_ReadIndirect( pxOSPI, ulAddr, pxBuffer, ulBufferLen, xTimeout );
+
+        /* Resume even if the read failed */
+        if( ospi_OPI_SendInstruction( pxOSPI, MX25LM_OPI_RESUME, xTimeout ) != pdTRUE )
+        {
+            xSuccess = pdFALSE;
+            LogError( "Failed to resume program or erase." );
+        }
+
+        ulOpRunCycles = ulGetCycleCount();
+    }
+
+    return xSuccess;
+}
+
+/*
+ * Handle a read issued while a program or erase is in flight. *pxServed is left
+ * pdFALSE when the operation has completed and the read is left to the caller.
+ */
+static BaseType_t ospi_ReadDuringOp( OSPI_HandleTypeDef * pxOSPI,
+                                     uint32_t ulAddr,
+                                     void * pxBuffer,
+                                     uint32_t ulBufferLen,
+                                     TickType_t xTimeout,
+                                     BaseType_t * pxServed )
+{
+    BaseType_t xSuccess = pdTRUE;
+    uint8_t ucStatus = 0;
+
+    *pxServed = pdFALSE;
+    xStats.ulReadsDuringOp++;
+
+    xSuccess = ospi_OPI_ReadReg( pxOSPI, MX25LM_OPI_RDSR, &ucStatus, xTimeout );
+
+    if( xSuccess != pdTRUE )
+    {
+        LogError( "Failed to read the status register." );
+    }
+    else if( ( ucStatus & MX25LM_REG_SR_WIP ) == 0 )
+    {
+        xSuccess = ospi_OpComplete( pxOSPI, xTimeout );
+    }
+    else if( ( xSuspendForReadEnabled == pdFALSE ) ||
+             ( ( ulAddr < ( ulOpAddr + ulOpLen ) ) &&
+               ( ulOpAddr < ( ulAddr + ulBufferLen ) ) ) )
+    {
+        /* The range being programmed or erased cannot be read until the operation completes */
+        xStats.ulReadWaits++;
+        xSuccess = ospi_WaitForOp( pxOSPI, xTimeout );
+    }
+    else
+    {
+        xSuccess = ospi_SuspendAndRead( pxOSPI, ulAddr, pxBuffer, ulBufferLen, xTimeout, pxServed );
+    }
+
+    return xSuccess;
+}
+
+BaseType_t ospi_ReadAddr( OSPI_HandleTypeDef * pxOSPI,
+                          uint32_t ulAddr,
+                          void * pxBuffer,
+                          uint32_t ulBufferLen,
+                          TickType_t xTimeout )
+{
+    BaseType_t xSuccess = pdTRUE;
+    BaseType_t xServed = pdFALSE;
+
+    ospi_OpInit( pxOSPI );
+
+    if( pxOSPI == NULL )
     {
         xSuccess = pdFALSE;
+        LogError( "pxOSPI is NULL." );
+    }
+
+    if( ( ulAddr >= MX25LM_MEM_SZ_BYTES ) ||
+        ( ulBufferLen > ( MX25LM_MEM_SZ_BYTES - ulAddr ) ) )
+    {
+        xSuccess = pdFALSE;
+        LogError( "Address is out of range." );
     }
 
     if( pxBuffer == NULL )
     {
         xSuccess = pdFALSE;
+        LogError( "pxBuffer is NULL." );
     }
 
-    if( xSuccess == pdTRUE )
+    if( ulBufferLen == 0 )
     {
-        /* Wait for idle condition (WIP bit should be 0) */
-        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
-                                           MX25LM_REG_SR_WIP,
-                                           0x0,
-                                           xTimeout );
+        xSuccess = pdFALSE;
+        LogError( "ulBufferLen is 0." );
     }
 
+    if( ( xSuccess == pdTRUE ) &&
+        ( xOpInFlight != OSPI_OP_NONE ) )
+    {
+        xSuccess = ospi_ReadDuringOp( pxOSPI, ulAddr, pxBuffer, ulBufferLen, xTimeout, &xServed );
+    }
+
+    if( ( xSuccess != pdTRUE ) ||
+        ( xServed == pdTRUE ) )
+    {
+        /* Invalid arguments, or served while the operation in flight was suspended */
+    }
+    else if( xMemMappedReadEnabled == pdTRUE )
+    {
+        if( xMemMappedActive == pdFALSE )
+        {
+            xSuccess = ospi_EnterMemoryMapped( pxOSPI, xTimeout );
+        }
+
+        if( xSuccess == pdTRUE )
+        {
+            ( void ) memcpy( pxBuffer, ( const void * ) ( MX25LM_MEM_MAPPED_BASE + ulAddr ), ulBufferLen );
+        }
+    }
+    else
+    {
+        xSuccess = ospi_ReadIndirect( pxOSPI, ulAddr, pxBuffer, ulBufferLen, xTimeout );
+    }
+
+    return( xSuccess );
+}
+
+void ospi_SetMemoryMappedRead( OSPI_HandleTypeDef * pxOSPI,
+                               BaseType_t xEnable )
+{
+    configASSERT( pxOSPI != NULL );
+
+    if( xEnable == pdFALSE )
+    {
+        ospi_ExitMemoryMapped( pxOSPI );
+    }
+
+    xMemMappedReadEnabled = ( xEnable != pdFALSE );
+}
+
+BaseType_t ospi_GetMemoryMappedRead( void )
+{
+    return xMemMappedReadEnabled;
+}
+
+void ospi_SetSuspendForRead( BaseType_t xEnable )
+{
+    xSuspendForReadEnabled = ( xEnable != pdFALSE );
+}
+
+BaseType_t ospi_GetSuspendForRead( void )
+{
+    return xSuspendForReadEnabled;
+}
+
+void ospi_GetStats( OspiNorStats_t * pxStats )
+{
+    configASSERT( pxStats != NULL );
+
+    *pxStats = xStats;
+}
+
+BaseType_t ospi_WaitForIdle( OSPI_HandleTypeDef * pxOSPI,
+                             TickType_t xTimeout )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    ospi_OpInit( pxOSPI );
+
+    if( pxOSPI == NULL )
+    {
+        xSuccess = pdFALSE;
+    }
+    else
+    {
+        xSuccess = ospi_WaitForOp( pxOSPI, xTimeout );
+    }
+
+    /* Report a failed operation once */
+    if( xOpFailed == pdTRUE )
+    {
+        xSuccess = pdFALSE;
+        xOpFailed = pdFALSE;
+    }
+
+    return xSuccess;
+}
+
+BaseType_t ospi_IsBusy( OSPI_HandleTypeDef * pxOSPI )
+{
+    BaseType_t xBusy = pdFALSE;
+    uint8_t ucStatus = 0;
+
+    ospi_OpInit( pxOSPI );
+
+    if( ( pxOSPI != NULL ) &&
+        ( xOpInFlight != OSPI_OP_NONE ) )
+    {
+        if( ospi_OPI_ReadReg( pxOSPI, MX25LM_OPI_RDSR, &ucStatus, MX25LM_DEFAULT_TIMEOUT_MS ) != pdTRUE )
+        {
+            /* Status unknown, the caller should wait with ospi_WaitForIdle */
+            xBusy = pdTRUE;
+        }
+        else if( ( ucStatus & MX25LM_REG_SR_WIP ) != 0 )
+        {
+            xBusy = pdTRUE;
+        }
+        else
+        {
+            ( void ) ospi_OpComplete( pxOSPI, MX25LM_DEFAULT_TIMEOUT_MS );
+        }
+    }
+
+    return xBusy;
+}
+
+/* Track an operation started on the flash until it completes */
+static void ospi_OpStarted( OspiOp_t xOp,
+                            uint32_t ulAddr,
+                            uint32_t ulLen )
+{
+    xOpInFlight = xOp;
+    ulOpAddr = ulAddr;
+    ulOpLen = ulLen;
+    ulOpRunCycles = ulGetCycleCount();
+}
+
+/*
+ * Program one page, after waiting for the previous program or erase. Returns
+ * once the data has been transferred, the program completes in the background.
+ */
+static BaseType_t ospi_ProgramPage( OSPI_HandleTypeDef * pxOSPI,
+                                    uint32_t ulAddr,
+                                    const void * pxBuffer,
+                                    uint32_t ulBufferLen,
+                                    TickType_t xTimeout )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+    BaseType_t xSuccess = pdTRUE;
+
+    /* Wait for the previous program or erase to complete */
+    xSuccess = ospi_WaitForIdle( pxOSPI, xTimeout );
+
     if( xSuccess == pdTRUE )
     {
         /* Enable write */
@@ -847,10 +1416,10 @@ BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
     /* Wait for Write Enable Latch */
     if( xSuccess == pdTRUE )
     {
-        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
-                                           MX25LM_REG_SR_WEL | MX25LM_REG_SR_WIP,
-                                           MX25LM_REG_SR_WEL,
-                                           xTimeout );
+        xSuccess = ospi_OPI_PollStatus( pxOSPI,
+                                        MX25LM_REG_SR_WEL | MX25LM_REG_SR_WIP,
+                                        MX25LM_REG_SR_WEL,
+                                        xTimeout );
     }
 
     if( xSuccess == pdTRUE )
@@ -889,7 +1458,8 @@ BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
     /* Clear notification state */
     ( void ) xTaskNotifyStateClearIndexed( NULL, 1 );
 
-    if( xHalStatus != HAL_OK )
+    if( ( xSuccess != pdTRUE ) ||
+        ( xHalStatus != HAL_OK ) )
     {
         xSuccess = pdFALSE;
     }
@@ -897,36 +1467,169 @@ BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
     {
         #pragma GCC diagnostic push
         #pragma GCC diagnostic ignored "-Wdiscarded-qualifiers"
-        xHalStatus = HAL_OSPI_Transmit_IT( pxOSPI, pxBuffer );
+
+        /* Interrupt transfers take an interrupt per byte, DMA one per page */
+        if( xProgramDmaEnabled == pdTRUE )
+        {
+            xHalStatus = HAL_OSPI_Transmit_DMA( pxOSPI, pxBuffer );
+        }
+        else
+        {
+            xHalStatus = HAL_OSPI_Transmit_IT( pxOSPI, pxBuffer );
+        }
+
         #pragma GCC diagnostic pop
+
+        if( xHalStatus != HAL_OK )
+        {
+            xSuccess = pdFALSE;
+        }
+        else
+        {
+            xSuccess = ospi_WaitForCallback( HAL_OSPI_TX_CPLT_CB_ID, xTimeout );
+        }
     }
 
-    if( xHalStatus != HAL_OK )
+    if( xSuccess == pdTRUE )
     {
-        xSuccess = pdFALSE;
+        /* Completion is checked by the next access to the flash */
+        ospi_OpStarted( OSPI_OP_PROGRAM, ulAddr, ulBufferLen );
     }
     else
     {
-        xSuccess = ospi_WaitForCallback( HAL_OSPI_TX_CPLT_CB_ID, xTimeout );
+        ospi_InvalidateCache( ulAddr, ulBufferLen );
+    }
+
+    return xSuccess;
+}
+
+/*
+ * @Brief start writing up to 256 bytes to the given address.
+ */
+BaseType_t ospi_WriteAddrStart( OSPI_HandleTypeDef * pxOSPI,
+                                uint32_t ulAddr,
+                                const void * pxBuffer,
+                                uint32_t ulBufferLen,
+                                TickType_t xTimeout )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    ospi_OpInit( pxOSPI );
+
+    if( pxOSPI == NULL )
+    {
+        xSuccess = pdFALSE;
+    }
+
+    if( ( ulBufferLen > MX25LM_PROGRAM_FIFO_LEN ) ||
+        ( ulBufferLen == 0 ) )
+    {
+        xSuccess = pdFALSE;
+    }
+
+    if( pxBuffer == NULL )
+    {
+        xSuccess = pdFALSE;
     }
 
     if( xSuccess == pdTRUE )
     {
-        vTaskDelay( 1 );
+        ospi_ExitMemoryMapped( pxOSPI );
 
-        /* Wait for idle condition (WIP bit should be 0) */
-        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
-                                           MX25LM_REG_SR_WIP | MX25LM_REG_SR_WEL,
-                                           0x0,
-                                           xTimeout );
+        xSuccess = ospi_ProgramPage( pxOSPI, ulAddr, pxBuffer, ulBufferLen, xTimeout );
     }
 
     return xSuccess;
 }
 
-BaseType_t ospi_EraseSector( OSPI_HandleTypeDef * pxOSPI,
-                             uint32_t ulAddr,
-                             TickType_t xTimeout )
+/*
+ * @Brief start writing whole pages from a page aligned address.
+ */
+BaseType_t ospi_WritePagesStart( OSPI_HandleTypeDef * pxOSPI,
+                                 uint32_t ulAddr,
+                                 const void * pxBuffer,
+                                 uint32_t ulBufferLen,
+                                 TickType_t xTimeout )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    ospi_OpInit( pxOSPI );
+
+    if( pxOSPI == NULL )
+    {
+        xSuccess = pdFALSE;
+    }
+
+    if( ( ( ulAddr % MX25LM_PROGRAM_FIFO_LEN ) != 0 ) ||
+        ( ( ulBufferLen % MX25LM_PROGRAM_FIFO_LEN ) != 0 ) ||
+        ( ulBufferLen == 0 ) )
+    {
+        xSuccess = pdFALSE;
+        LogError( "Address and length must be page aligned." );
+    }
+
+    if( ( ulAddr >= MX25LM_MEM_SZ_BYTES ) ||
+        ( ulBufferLen > ( MX25LM_MEM_SZ_BYTES - ulAddr ) ) )
+    {
+        xSuccess = pdFALSE;
+        LogError( "Address is out of range." );
+    }
+
+    if( pxBuffer == NULL )
+    {
+        xSuccess = pdFALSE;
+    }
+
+    if( xSuccess == pdTRUE )
+    {
+        ospi_ExitMemoryMapped( pxOSPI );
+    }
+
+    for( uint32_t ulOffset = 0; ( ulOffset < ulBufferLen ) && ( xSuccess == pdTRUE ); ulOffset += MX25LM_PROGRAM_FIFO_LEN )
+    {
+        xSuccess = ospi_ProgramPage( pxOSPI,
+                                     ulAddr + ulOffset,
+                                     &( ( ( const uint8_t * ) pxBuffer )[ ulOffset ] ),
+                                     MX25LM_PROGRAM_FIFO_LEN,
+                                     xTimeout );
+    }
+
+    return xSuccess;
+}
+
+/*
+ * @Brief write up to 256 bytes to the given address and wait for the program to complete.
+ */
+BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
+                           uint32_t ulAddr,
+                           const void * pxBuffer,
+                           uint32_t ulBufferLen,
+                           TickType_t xTimeout )
+{
+    BaseType_t xSuccess = ospi_WriteAddrStart( pxOSPI, ulAddr, pxBuffer, ulBufferLen, xTimeout );
+
+    if( xSuccess == pdTRUE )
+    {
+        xSuccess = ospi_WaitForIdle( pxOSPI, xTimeout );
+    }
+
+    return xSuccess;
+}
+
+void ospi_SetProgramDma( BaseType_t xEnable )
+{
+    xProgramDmaEnabled = ( ( xEnable != pdFALSE ) &&
+                           ( xHndlGpdmaOspi.State != HAL_DMA_STATE_RESET ) );
+}
+
+BaseType_t ospi_GetProgramDma( void )
+{
+    return xProgramDmaEnabled;
+}
+
+BaseType_t ospi_EraseSectorStart( OSPI_HandleTypeDef * pxOSPI,
+                                  uint32_t ulAddr,
+                                  TickType_t xTimeout )
 {
     HAL_StatusTypeDef xHalStatus = HAL_OK;
     BaseType_t xSuccess = pdTRUE;
@@ -946,11 +1649,10 @@ BaseType_t ospi_EraseSector( OSPI_HandleTypeDef * pxOSPI,
 
     if( xSuccess == pdTRUE )
     {
-        /* Wait for idle condition (WIP bit should be 0) */
-        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
-                                           MX25LM_REG_SR_WIP,
-                                           0x0,
-                                           xTimeout );
+        ospi_ExitMemoryMapped( pxOSPI );
+
+        /* Wait for the previous program or erase to complete */
+        xSuccess = ospi_WaitForIdle( pxOSPI, xTimeout );
     }
 
     if( xSuccess == pdTRUE )
@@ -962,10 +1664,10 @@ BaseType_t ospi_EraseSector( OSPI_HandleTypeDef * pxOSPI,
     /* Wait for Write Enable Latch */
     if( xSuccess == pdTRUE )
     {
-        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
-                                           MX25LM_REG_SR_WEL,
-                                           MX25LM_REG_SR_WEL,
-                                           xTimeout );
+        xSuccess = ospi_OPI_PollStatus( pxOSPI,
+                                        MX25LM_REG_SR_WEL | MX25LM_REG_SR_WIP,
+                                        MX25LM_REG_SR_WEL,
+                                        xTimeout );
     }
 
     if( xSuccess == pdTRUE )
@@ -1002,25 +1704,40 @@ BaseType_t ospi_EraseSector( OSPI_HandleTypeDef * pxOSPI,
 
         /* Send command */
         xHalStatus = HAL_OSPI_Command_IT( pxOSPI, &xCmd );
+
+        if( xHalStatus != HAL_OK )
+        {
+            xSuccess = pdFALSE;
+        }
+        else
+        {
+            xSuccess = ospi_WaitForCallback( HAL_OSPI_CMD_CPLT_CB_ID, xTimeout );
+        }
     }
 
-    if( xHalStatus != HAL_OK )
+    if( xSuccess == pdTRUE )
     {
-        xSuccess = pdFALSE;
+        /* Completion is checked by the next access to the flash */
+        ospi_OpStarted( OSPI_OP_ERASE, ulAddr & ~( MX25LM_SECTOR_SZ - 1 ), MX25LM_SECTOR_SZ );
     }
-    else
+    else if( ( pxOSPI != NULL ) &&
+             ( ulAddr < MX25LM_MEM_SZ_BYTES ) )
     {
-        xSuccess = ospi_WaitForCallback( HAL_OSPI_CMD_CPLT_CB_ID, xTimeout );
+        ospi_InvalidateCache( ulAddr & ~( MX25LM_SECTOR_SZ - 1 ), MX25LM_SECTOR_SZ );
     }
 
+    return( xSuccess );
+}
+
+BaseType_t ospi_EraseSector( OSPI_HandleTypeDef * pxOSPI,
+                             uint32_t ulAddr,
+                             TickType_t xTimeout )
+{
+    BaseType_t xSuccess = ospi_EraseSectorStart( pxOSPI, ulAddr, xTimeout );
+
     if( xSuccess == pdTRUE )
     {
-        vTaskDelay( 1 );
-        /* Wait for idle condition (WIP bit should be 0) */
-        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
-                                           MX25LM_REG_SR_WEL | MX25LM_REG_SR_WIP,
-                                           0x0,
-                                           xTimeout );
+        xSuccess = ospi_WaitForIdle( pxOSPI, xTimeout );
     }
 
     return( xSuccess );
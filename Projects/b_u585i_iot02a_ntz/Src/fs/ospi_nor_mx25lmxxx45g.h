@@ -65,6 +65,12 @@
 #define MX25LM_REG_SR_WIP            ( 0x01 )   /* Write in progress  */
 #define MX25LM_REG_SR_WEL            ( 0x02 )   /* Write enable latch */
 
+/* Security register definition */
+#define MX25LM_REG_SCUR_PSB          ( 0x04 )   /* Program suspended */
+#define MX25LM_REG_SCUR_ESB          ( 0x08 )   /* Erase suspended   */
+#define MX25LM_REG_SCUR_P_FAIL       ( 0x20 )   /* Last program failed */
+#define MX25LM_REG_SCUR_E_FAIL       ( 0x40 )   /* Last erase failed */
+
 /* OPI mode commands */
 #define MX25LM_OPI_RDSR              ( 0x05FA )
 #define MX25LM_OPI_WREN              ( 0x06F9 )
@@ -72,11 +78,58 @@
 #define MX25LM_OPI_PP                ( 0x12ED ) /* Page Program, starting address must be 0 in DTR OPI mode */
 #define MX25LM_PROGRAM_FIFO_LEN      ( 256 )
 #define MX25LM_OPI_SE                ( 0x21DE ) /* Sector Erase */
+#define MX25LM_OPI_RDSCUR            ( 0x2BD4 ) /* Read Security Register */
+#define MX25LM_OPI_SUSPEND           ( 0xB04F ) /* Program / Erase Suspend */
+#define MX25LM_OPI_RESUME            ( 0x30CF ) /* Program / Erase Resume */
 
 #define MX25LM_WRITE_TIMEOUT_MS      ( 10 * 1000 )
 #define MX25LM_ERASE_TIMEOUT_MS      ( 10 * 1000 )
 #define MX25LM_READ_TIMEOUT_MS       ( 10 * 1000 )
 
+/*
+ * Serve reads from the memory mapped OCTOSPI2 region. The controller is
+ * switched to memory mapped mode on the first read after a program or erase
+ * and back to indirect mode for the next program or erase, so reads are plain
+ * loads through DCACHE1 instead of an 8READ command and a status poll each.
+ */
+#ifndef MX25LM_MEMORY_MAPPED_READ
+#define MX25LM_MEMORY_MAPPED_READ    ( 1 )
+#endif
+
+#define MX25LM_MEM_MAPPED_BASE       ( OCTOSPI2_BASE )
+
+/* Release NCS after this many idle clock cycles in memory mapped mode */
+#define MX25LM_MEM_MAPPED_TIMEOUT    ( 0x34 )
+
+/*
+ * Suspend a program or erase in flight to serve a read from another sector,
+ * instead of making the read wait for the whole operation.
+ */
+#ifndef MX25LM_SUSPEND_FOR_READ
+#define MX25LM_SUSPEND_FOR_READ      ( 1 )
+#endif
+
+/* Minimum time an operation runs after a resume before it is suspended again */
+#ifndef MX25LM_RESUME_TO_SUSPEND_US
+#define MX25LM_RESUME_TO_SUSPEND_US  ( 100 )
+#endif
+
+/*
+ * Transfer page program data with GPDMA instead of an interrupt per byte.
+ * Falls back to interrupt transfers if the DMA channel cannot be set up.
+ */
+#ifndef MX25LM_PROGRAM_DMA
+#define MX25LM_PROGRAM_DMA           ( 1 )
+#endif
+
+typedef struct
+{
+    uint32_t ulReadsDuringOp; /* Reads issued while a program or erase was in flight */
+    uint32_t ulSuspends;      /* Reads served by suspending the operation */
+    uint32_t ulReadWaits;     /* Reads that waited for the operation to complete */
+    uint32_t ulOpFailures;    /* Programs and erases reported as failed by the flash */
+} OspiNorStats_t;
+
 
 BaseType_t ospi_Init( OSPI_HandleTypeDef * pxOSPI );
 
@@ -96,5 +149,65 @@ BaseType_t ospi_ReadAddr( OSPI_HandleTypeDef * pxOSPI,
                           uint32_t ulBufferLen,
                           TickType_t xTimeout );
 
+/*
+ * Start a page program or sector erase and return without waiting for the
+ * flash to finish it. The next program or erase waits for the operation in
+ * flight, and reads from other sectors suspend it. A failure of the operation
+ * is reported by the next call to ospi_WaitForIdle or to a start function.
+ */
+BaseType_t ospi_WriteAddrStart( OSPI_HandleTypeDef * pxOSPI,
+                                uint32_t ulAddr,
+                                const void * pxBuffer,
+                                uint32_t ulBufferLen,
+                                TickType_t xTimeout );
+
+/*
+ * Start programming whole pages from a page aligned address. Returns once the
+ * program of the last page has started, each page waits for the previous one.
+ */
+BaseType_t ospi_WritePagesStart( OSPI_HandleTypeDef * pxOSPI,
+                                 uint32_t ulAddr,
+                                 const void * pxBuffer,
+                                 uint32_t ulBufferLen,
+                                 TickType_t xTimeout );
+
+BaseType_t ospi_EraseSectorStart( OSPI_HandleTypeDef * pxOSPI,
+                                  uint32_t ulAddr,
+                                  TickType_t xTimeout );
+
+/* Wait for the program or erase in flight, if any, to complete */
+BaseType_t ospi_WaitForIdle( OSPI_HandleTypeDef * pxOSPI,
+                             TickType_t xTimeout );
+
+/* Returns pdTRUE while a started program or erase has not completed */
+BaseType_t ospi_IsBusy( OSPI_HandleTypeDef * pxOSPI );
+
+/*
+ * Select memory mapped or indirect reads at run time, for benchmarking.
+ * Must not be called while another task accesses the flash.
+ */
+void ospi_SetMemoryMappedRead( OSPI_HandleTypeDef * pxOSPI,
+                               BaseType_t xEnable );
+
+BaseType_t ospi_GetMemoryMappedRead( void );
+
+/*
+ * Enable or disable suspending operations for reads at run time, for benchmarking.
+ * Must not be called while another task accesses the flash.
+ */
+void ospi_SetSuspendForRead( BaseType_t xEnable );
+
+BaseType_t ospi_GetSuspendForRead( void );
+
+/*
+ * Select DMA or interrupt page program transfers at run time, for benchmarking.
+ * Must not be called while another task accesses the flash.
+ */
+void ospi_SetProgramDma( BaseType_t xEnable );
+
+BaseType_t ospi_GetProgramDma( void );
+
+void ospi_GetStats( OspiNorStats_t * pxStats );
+
 
 #endif /* _OSPI_NOR_DRV */
@@ -0,0 +1,290 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_pal_decompress.c
+ * @brief Streaming decoder for heatshrink (LZSS) compressed OTA images.
+ *
+ * The bitstream matches the heatshrink encoder: each symbol starts with a tag
+ * bit. A set tag bit is followed by an 8 bit literal. A clear tag bit is
+ * followed by a back-reference made up of ( distance - 1 ) in ucWindowBits bits
+ * and ( length - 1 ) in ucLookaheadBits bits. All fields are stored MSB first.
+ */
+
+#include <string.h>
+
+#include "ota_pal_decompress.h"
+
+typedef enum
+{
+    DECOMPRESS_STATE_TAG = 0,
+    DECOMPRESS_STATE_LITERAL,
+    DECOMPRESS_STATE_BACKREF_INDEX,
+    DECOMPRESS_STATE_BACKREF_COUNT,
+    DECOMPRESS_STATE_BACKREF_COPY
+} DecompressState_t;
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvReadLe32( const uint8_t * pucData )
+{
+    return ( ( uint32_t ) pucData[ 0 ] ) |
+           ( ( uint32_t ) pucData[ 1 ] << 8 ) |
+           ( ( uint32_t ) pucData[ 2 ] << 16 ) |
+           ( ( uint32_t ) pucData[ 3 ] << 24 );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Pull ucNumBits bits from the input, buffering any partial bytes in the context. */
+static bool prvGetBits( OtaDecompressCtx_t * pxCtx,
+                        uint8_t ucNumBits,
+                        const uint8_t ** ppucIn,
+                        size_t * puxInRemaining,
+                        uint16_t * pusValue )
+{
+    bool xResult = true;
+
+    while( pxCtx->ucBitCount < ucNumBits )
+    {
+        if( *puxInRemaining == 0 )
+        {
+            xResult = false;
+            break;
+        }
+
+        pxCtx->ulBitBuffer = ( pxCtx->ulBitBuffer << 8 ) | **ppucIn;
+        pxCtx->ucBitCount += 8;
+        ( *ppucIn )++;
+        ( *puxInRemaining )--;
+    }
+
+    if( xResult )
+    {
+        pxCtx->ucBitCount -= ucNumBits;
+        *pusValue = ( uint16_t ) ( ( pxCtx->ulBitBuffer >> pxCtx->ucBitCount ) & ( ( 1UL << ucNumBits ) - 1UL ) );
+        pxCtx->ulBitBuffer &= ( ( 1UL << pxCtx->ucBitCount ) - 1UL );
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static inline void prvEmitByte( OtaDecompressCtx_t * pxCtx,
+                                uint8_t ucByte,
+                                uint8_t * pucOut,
+                                size_t * puxOutProduced )
+{
+    const uint16_t usMask = ( uint16_t ) ( ( 1UL << pxCtx->ucWindowBits ) - 1UL );
+
+    pxCtx->pucWindow[ pxCtx->usWindowHead ] = ucByte;
+    pxCtx->usWindowHead = ( pxCtx->usWindowHead + 1 ) & usMask;
+
+    pucOut[ *puxOutProduced ] = ucByte;
+    ( *puxOutProduced )++;
+    pxCtx->ulBytesOut++;
+}
+
+/*-----------------------------------------------------------*/
+
+bool xOtaDecompress_IsCompressed( const uint8_t * pucData,
+                                  size_t uxDataLen )
+{
+    return( ( pucData != NULL ) &&
+            ( uxDataLen >= OTA_COMPRESSED_HEADER_LEN ) &&
+            ( memcmp( pucData, OTA_COMPRESSED_MAGIC, OTA_COMPRESSED_MAGIC_LEN ) == 0 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+OtaDecompressStatus_t xOtaDecompress_Init( OtaDecompressCtx_t * pxCtx,
+                                           const uint8_t * pucHeader )
+{
+    OtaDecompressStatus_t xStatus = OTA_DECOMPRESS_ERROR;
+
+    if( ( pxCtx != NULL ) &&
+        xOtaDecompress_IsCompressed( pucHeader, OTA_COMPRESSED_HEADER_LEN ) )
+    {
+        uint8_t ucWindowBits = pucHeader[ 4 ];
+        uint8_t ucLookaheadBits = pucHeader[ 5 ];
+        uint32_t ulImageSize = prvReadLe32( &pucHeader[ 8 ] );
+        uint32_t ulReserved = ( uint32_t ) pucHeader[ 6 ] | ( uint32_t ) pucHeader[ 7 ] | prvReadLe32( &pucHeader[ 12 ] );
+
+        /* Reserved fields must be zero so that a later header version is not decoded as this one */
+        if( ( ulReserved == 0 ) &&
+            ( ucWindowBits >= OTA_DECOMPRESS_WINDOW_BITS_MIN ) &&
+            ( ucWindowBits <= OTA_DECOMPRESS_WINDOW_BITS_MAX ) &&
+            ( ucLookaheadBits >= 3 ) &&
+            ( ucLookaheadBits < ucWindowBits ) &&
+            ( ulImageSize > 0 ) )
+        {
+            ( void ) memset( pxCtx, 0, sizeof( OtaDecompressCtx_t ) );
+
+            pxCtx->ucWindowBits = ucWindowBits;
+            pxCtx->ucLookaheadBits = ucLookaheadBits;
+            pxCtx->ulImageSize = ulImageSize;
+            pxCtx->ucState = DECOMPRESS_STATE_TAG;
+
+            xStatus = OTA_DECOMPRESS_OK;
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+OtaDecompressStatus_t xOtaDecompress_Process( OtaDecompressCtx_t * pxCtx,
+                                              const uint8_t * pucIn,
+                                              size_t uxInLen,
+                                              size_t * puxInConsumed,
+                                              uint8_t * pucOut,
+                                              size_t uxOutLen,
+                                              size_t * puxOutProduced )
+{
+    OtaDecompressStatus_t xStatus = OTA_DECOMPRESS_OK;
+    size_t uxInRemaining = uxInLen;
+    bool xNeedInput = false;
+    uint16_t usValue = 0;
+
+    if( ( pxCtx == NULL ) ||
+        ( puxInConsumed == NULL ) ||
+        ( puxOutProduced == NULL ) ||
+        ( ( pucIn == NULL ) && ( uxInLen > 0 ) ) ||
+        ( ( pucOut == NULL ) && ( uxOutLen > 0 ) ) ||
+        ( pxCtx->ucWindowBits == 0 ) )
+    {
+        return OTA_DECOMPRESS_ERROR;
+    }
+
+    *puxOutProduced = 0;
+
+    while( ( xStatus == OTA_DECOMPRESS_OK ) && ( xNeedInput == false ) )
+    {
+        if( pxCtx->ulBytesOut >= pxCtx->ulImageSize )
+        {
+            xStatus = OTA_DECOMPRESS_DONE;
+            break;
+        }
+
+        switch( pxCtx->ucState )
+        {
+            case DECOMPRESS_STATE_TAG:
+
+                if( prvGetBits( pxCtx, 1, &pucIn, &uxInRemaining, &usValue ) )
+                {
+                    pxCtx->ucState = ( usValue != 0 ) ? DECOMPRESS_STATE_LITERAL : DECOMPRESS_STATE_BACKREF_INDEX;
+                }
+                else
+                {
+                    xNeedInput = true;
+                }
+
+                break;
+
+            case DECOMPRESS_STATE_LITERAL:
+
+                if( *puxOutProduced >= uxOutLen )
+                {
+                    xStatus = OTA_DECOMPRESS_OUTPUT_FULL;
+                }
+                else if( prvGetBits( pxCtx, 8, &pucIn, &uxInRemaining, &usValue ) )
+                {
+                    prvEmitByte( pxCtx, ( uint8_t ) usValue, pucOut, puxOutProduced );
+                    pxCtx->ucState = DECOMPRESS_STATE_TAG;
+                }
+                else
+                {
+                    xNeedInput = true;
+                }
+
+                break;
+
+            case DECOMPRESS_STATE_BACKREF_INDEX:
+
+                if( prvGetBits( pxCtx, pxCtx->ucWindowBits, &pucIn, &uxInRemaining, &usValue ) )
+                {
+                    pxCtx->usBackrefDistance = usValue + 1;
+                    pxCtx->ucState = DECOMPRESS_STATE_BACKREF_COUNT;
+                }
+                else
+                {
+                    xNeedInput = true;
+                }
+
+                break;
+
+            case DECOMPRESS_STATE_BACKREF_COUNT:
+
+                if( prvGetBits( pxCtx, pxCtx->ucLookaheadBits, &pucIn, &uxInRemaining, &usValue ) )
+                {
+                    pxCtx->usBackrefRemaining = usValue + 1;
+                    pxCtx->ucState = DECOMPRESS_STATE_BACKREF_COPY;
+                }
+                else
+                {
+                    xNeedInput = true;
+                }
+
+                break;
+
+            case DECOMPRESS_STATE_BACKREF_COPY:
+               {
+                   const uint16_t usMask = ( uint16_t ) ( ( 1UL << pxCtx->ucWindowBits ) - 1UL );
+
+                   while( ( pxCtx->usBackrefRemaining > 0 ) &&
+                          ( *puxOutProduced < uxOutLen ) &&
+                          ( pxCtx->ulBytesOut < pxCtx->ulImageSize ) )
+                   {
+                       uint16_t usIndex = ( pxCtx->usWindowHead - pxCtx->usBackrefDistance ) & usMask;
+
+                       prvEmitByte( pxCtx, pxCtx->pucWindow[ usIndex ], pucOut, puxOutProduced );
+                       pxCtx->usBackrefRemaining--;
+                   }
+
+                   if( pxCtx->usBackrefRemaining == 0 )
+                   {
+                       pxCtx->ucState = DECOMPRESS_STATE_TAG;
+                   }
+                   else if( pxCtx->ulBytesOut >= pxCtx->ulImageSize )
+                   {
+                       /* Back-reference runs past the end of the image */
+                       xStatus = OTA_DECOMPRESS_ERROR;
+                   }
+                   else
+                   {
+                       xStatus = OTA_DECOMPRESS_OUTPUT_FULL;
+                   }
+               }
+               break;
+
+            default:
+                xStatus = OTA_DECOMPRESS_ERROR;
+                break;
+        }
+    }
+
+    *puxInConsumed = uxInLen - uxInRemaining;
+
+    return xStatus;
+}
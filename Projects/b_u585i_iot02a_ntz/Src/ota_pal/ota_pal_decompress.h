@@ -0,0 +1,136 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_pal_decompress.h
+ * @brief Streaming decoder for heatshrink (LZSS) compressed OTA images.
+ *
+ * Compressed images are produced by tools/ota_compress.py and start with an
+ * OtaCompressedHeader_t. The decoder keeps all of its state, including the
+ * back-reference window, in the caller supplied context so that no heap is
+ * used while decoding.
+ */
+
+#ifndef OTA_PAL_DECOMPRESS_H_
+#define OTA_PAL_DECOMPRESS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Magic bytes at the start of a compressed image ( "HSZ1" ) */
+#define OTA_COMPRESSED_MAGIC              "HSZ1"
+#define OTA_COMPRESSED_MAGIC_LEN          ( 4 )
+
+/* Size of OtaCompressedHeader_t in the byte stream */
+#define OTA_COMPRESSED_HEADER_LEN         ( 16 )
+
+/* Largest window supported by the decoder. Determines the size of the static window buffer. */
+#ifndef OTA_DECOMPRESS_WINDOW_BITS_MAX
+#define OTA_DECOMPRESS_WINDOW_BITS_MAX    ( 11 )
+#endif
+
+#define OTA_DECOMPRESS_WINDOW_BITS_MIN    ( 4 )
+
+/**
+ * @brief Header prepended to a compressed image. All fields are little endian.
+ */
+typedef struct
+{
+    uint8_t pucMagic[ OTA_COMPRESSED_MAGIC_LEN ]; /*!< OTA_COMPRESSED_MAGIC */
+    uint8_t ucWindowBits;                         /*!< log2 of the back-reference window size */
+    uint8_t ucLookaheadBits;                      /*!< log2 of the maximum back-reference length */
+    uint16_t usReserved;                          /*!< Must be zero */
+    uint32_t ulImageSize;                         /*!< Size of the decompressed image in bytes */
+    uint32_t ulReserved;                          /*!< Must be zero */
+} OtaCompressedHeader_t;
+
+typedef enum
+{
+    OTA_DECOMPRESS_OK = 0,        /*!< All provided input was consumed. */
+    OTA_DECOMPRESS_OUTPUT_FULL,   /*!< The output buffer is full, call again with more space. */
+    OTA_DECOMPRESS_DONE,          /*!< The complete image has been decompressed. */
+    OTA_DECOMPRESS_ERROR          /*!< The stream or header is invalid. */
+} OtaDecompressStatus_t;
+
+typedef struct
+{
+    uint32_t ulImageSize;
+    uint32_t ulBytesOut;
+    uint32_t ulBitBuffer;
+    uint8_t ucBitCount;
+    uint8_t ucState;
+    uint8_t ucWindowBits;
+    uint8_t ucLookaheadBits;
+    uint16_t usWindowHead;
+    uint16_t usBackrefDistance;
+    uint16_t usBackrefRemaining;
+    uint8_t pucWindow[ 1UL << OTA_DECOMPRESS_WINDOW_BITS_MAX ];
+} OtaDecompressCtx_t;
+
+/**
+ * @brief Check whether a block of data begins with a compressed image header.
+ *
+ * @param[in] pucData Data received at offset 0 of the OTA file.
+ * @param[in] uxDataLen Length of pucData.
+ *
+ * @return true if the data starts with OTA_COMPRESSED_MAGIC.
+ */
+bool xOtaDecompress_IsCompressed( const uint8_t * pucData,
+                                  size_t uxDataLen );
+
+/**
+ * @brief Parse the compressed image header and reset the decoder state.
+ *
+ * @param[out] pxCtx Decoder context to initialize.
+ * @param[in] pucHeader Pointer to at least OTA_COMPRESSED_HEADER_LEN bytes.
+ *
+ * @return OTA_DECOMPRESS_OK on success, OTA_DECOMPRESS_ERROR if the header is invalid,
+ * has a non-zero reserved field or uses a window larger than OTA_DECOMPRESS_WINDOW_BITS_MAX.
+ */
+OtaDecompressStatus_t xOtaDecompress_Init( OtaDecompressCtx_t * pxCtx,
+                                           const uint8_t * pucHeader );
+
+/**
+ * @brief Decode compressed input into the provided output buffer.
+ *
+ * Decoding stops when the input is exhausted, the output buffer is full or
+ * the complete image has been produced. Partial symbols are kept in the
+ * context, so input may be split at any byte boundary.
+ *
+ * @param[in] pxCtx Decoder context.
+ * @param[in] pucIn Compressed input.
+ * @param[in] uxInLen Length of pucIn.
+ * @param[out] puxInConsumed Number of input bytes consumed.
+ * @param[out] pucOut Output buffer.
+ * @param[in] uxOutLen Space available in pucOut.
+ * @param[out] puxOutProduced Number of bytes written to pucOut.
+ */
+OtaDecompressStatus_t xOtaDecompress_Process( OtaDecompressCtx_t * pxCtx,
+                                              const uint8_t * pucIn,
+                                              size_t uxInLen,
+                                              size_t * puxInConsumed,
+                                              uint8_t * pucOut,
+                                              size_t uxOutLen,
+                                              size_t * puxOutProduced );
+
+#endif /* OTA_PAL_DECOMPRESS_H_ */
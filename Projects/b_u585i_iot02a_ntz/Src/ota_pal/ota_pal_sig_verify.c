@@ -0,0 +1,640 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_pal_sig_verify.c
+ * @brief ECDSA P-256 verification with a precomputed table for the OTA signing key.
+ *
+ * Follows mbedtls_ecdsa_verify, but computes u2 * Q in a group whose generator
+ * is Q. With MBEDTLS_ECP_FIXED_POINT_OPTIM, mbedtls caches the comb table of a
+ * group's generator in the group, so the table for Q is only built once.
+ */
+
+#include <string.h>
+
+#include "ota_pal_sig_verify.h"
+
+#include "mbedtls/asn1.h"
+#include "mbedtls/bignum.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/version.h"
+
+#if !defined( MBEDTLS_ECP_FIXED_POINT_OPTIM ) || ( MBEDTLS_ECP_FIXED_POINT_OPTIM != 1 )
+#error "ota_pal_sig_verify.c requires MBEDTLS_ECP_FIXED_POINT_OPTIM to keep the table for the signing key."
+#endif
+
+#define P256_COORD_LEN    ( 32 )
+
+/*-----------------------------------------------------------*/
+
+static inline void prvWriteLe32( uint8_t * pucData,
+                                 uint32_t ulValue )
+{
+    pucData[ 0 ] = ( uint8_t ) ulValue;
+    pucData[ 1 ] = ( uint8_t ) ( ulValue >> 8 );
+    pucData[ 2 ] = ( uint8_t ) ( ulValue >> 16 );
+    pucData[ 3 ] = ( uint8_t ) ( ulValue >> 24 );
+}
+
+/*-----------------------------------------------------------*/
+
+static inline uint32_t prvReadLe32( const uint8_t * pucData )
+{
+    return ( ( uint32_t ) pucData[ 0 ] ) |
+           ( ( uint32_t ) pucData[ 1 ] << 8 ) |
+           ( ( uint32_t ) pucData[ 2 ] << 16 ) |
+           ( ( uint32_t ) pucData[ 3 ] << 24 );
+}
+
+/*-----------------------------------------------------------*/
+
+static const mbedtls_ecp_keypair * prvGetP256Key( mbedtls_pk_context * pxPubKey )
+{
+    const mbedtls_ecp_keypair * pxKeypair = NULL;
+
+    if( ( pxPubKey != NULL ) &&
+        mbedtls_pk_can_do( pxPubKey, MBEDTLS_PK_ECDSA ) )
+    {
+        pxKeypair = mbedtls_pk_ec( *pxPubKey );
+
+        if( ( pxKeypair != NULL ) &&
+            ( pxKeypair->MBEDTLS_PRIVATE( grp ).id != MBEDTLS_ECP_DP_SECP256R1 ) )
+        {
+            pxKeypair = NULL;
+        }
+    }
+
+    return pxKeypair;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Release the generator of a group, which may point at constants when the group was loaded with mbedtls_ecp_group_load */
+static void prvClearGroupGenerator( mbedtls_ecp_group * pxGroup )
+{
+    if( pxGroup->MBEDTLS_PRIVATE( h ) != 1 )
+    {
+        mbedtls_ecp_point_free( &( pxGroup->G ) );
+    }
+
+    mbedtls_ecp_point_init( &( pxGroup->G ) );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Discard the built in table for G, which is the wrong table once G is replaced */
+static void prvClearGroupTable( mbedtls_ecp_group * pxGroup )
+{
+    if( pxGroup->MBEDTLS_PRIVATE( T_size ) == 0 )
+    {
+        /* Static table, owned by mbedtls */
+        pxGroup->MBEDTLS_PRIVATE( T ) = NULL;
+    }
+    else
+    {
+        for( size_t i = 0; i < pxGroup->MBEDTLS_PRIVATE( T_size ); i++ )
+        {
+            mbedtls_ecp_point_free( &( pxGroup->MBEDTLS_PRIVATE( T )[ i ] ) );
+        }
+
+        mbedtls_free( pxGroup->MBEDTLS_PRIVATE( T ) );
+        pxGroup->MBEDTLS_PRIVATE( T ) = NULL;
+        pxGroup->MBEDTLS_PRIVATE( T_size ) = 0;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int lOtaSigVerifier_Init( OtaSigVerifier_t * pxVerifier,
+                          mbedtls_pk_context * pxPubKey )
+{
+    int lError = 0;
+    const mbedtls_ecp_keypair * pxKeypair = prvGetP256Key( pxPubKey );
+    size_t uxLen = 0;
+
+    if( pxVerifier == NULL )
+    {
+        return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    ( void ) memset( pxVerifier, 0, sizeof( OtaSigVerifier_t ) );
+    mbedtls_ecp_group_init( &( pxVerifier->xGroup ) );
+    mbedtls_ecp_group_init( &( pxVerifier->xKeyGroup ) );
+
+    if( pxKeypair == NULL )
+    {
+        lError = MBEDTLS_ERR_PK_TYPE_MISMATCH;
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_ecp_group_load( &( pxVerifier->xGroup ), MBEDTLS_ECP_DP_SECP256R1 );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_ecp_group_load( &( pxVerifier->xKeyGroup ), MBEDTLS_ECP_DP_SECP256R1 );
+    }
+
+    if( lError == 0 )
+    {
+        prvClearGroupTable( &( pxVerifier->xKeyGroup ) );
+        prvClearGroupGenerator( &( pxVerifier->xKeyGroup ) );
+        pxVerifier->xGeneratorReplaced = true;
+
+        lError = mbedtls_ecp_copy( &( pxVerifier->xKeyGroup.G ), &( pxKeypair->MBEDTLS_PRIVATE( Q ) ) );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_ecp_point_write_binary( &( pxVerifier->xGroup ), &( pxKeypair->MBEDTLS_PRIVATE( Q ) ),
+                                                 MBEDTLS_ECP_PF_UNCOMPRESSED, &uxLen,
+                                                 pxVerifier->pucPublicKey, sizeof( pxVerifier->pucPublicKey ) );
+    }
+
+    if( lError == 0 )
+    {
+        pxVerifier->xInitialized = true;
+    }
+    else
+    {
+        vOtaSigVerifier_Free( pxVerifier );
+    }
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+bool xOtaSigVerifier_IsKey( const OtaSigVerifier_t * pxVerifier,
+                            mbedtls_pk_context * pxPubKey )
+{
+    bool xResult = false;
+    const mbedtls_ecp_keypair * pxKeypair = prvGetP256Key( pxPubKey );
+
+    if( ( pxVerifier != NULL ) &&
+        pxVerifier->xInitialized &&
+        ( pxKeypair != NULL ) )
+    {
+        uint8_t pucPoint[ OTA_SIG_VERIFY_POINT_LEN ];
+        size_t uxLen = 0;
+
+        if( ( mbedtls_ecp_point_write_binary( &( pxVerifier->xGroup ), &( pxKeypair->MBEDTLS_PRIVATE( Q ) ),
+                                              MBEDTLS_ECP_PF_UNCOMPRESSED, &uxLen,
+                                              pucPoint, sizeof( pucPoint ) ) == 0 ) &&
+            ( uxLen == sizeof( pucPoint ) ) &&
+            ( memcmp( pucPoint, pxVerifier->pucPublicKey, sizeof( pucPoint ) ) == 0 ) )
+        {
+            xResult = true;
+        }
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+int lOtaSigVerifier_BuildTable( OtaSigVerifier_t * pxVerifier )
+{
+    int lError = 0;
+
+    if( ( pxVerifier == NULL ) || !pxVerifier->xInitialized )
+    {
+        lError = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+    else if( pxVerifier->xKeyGroup.MBEDTLS_PRIVATE( T ) == NULL )
+    {
+        mbedtls_ecp_point xResult;
+        mbedtls_mpi xTwo;
+        mbedtls_mpi xZero;
+
+        mbedtls_ecp_point_init( &xResult );
+        mbedtls_mpi_init( &xTwo );
+        mbedtls_mpi_init( &xZero );
+
+        /* Any scalar other than 0, 1 and -1 goes through the comb method, which stores the table for G in the group */
+        lError = mbedtls_mpi_lset( &xTwo, 2 );
+
+        if( lError == 0 )
+        {
+            lError = mbedtls_ecp_muladd( &( pxVerifier->xKeyGroup ), &xResult,
+                                         &xTwo, &( pxVerifier->xKeyGroup.G ),
+                                         &xZero, &( pxVerifier->xKeyGroup.G ) );
+        }
+
+        if( ( lError == 0 ) &&
+            ( pxVerifier->xKeyGroup.MBEDTLS_PRIVATE( T ) == NULL ) )
+        {
+            lError = MBEDTLS_ERR_ECP_FEATURE_UNAVAILABLE;
+        }
+
+        mbedtls_ecp_point_free( &xResult );
+        mbedtls_mpi_free( &xTwo );
+        mbedtls_mpi_free( &xZero );
+    }
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+int lOtaSigVerifier_ExportTable( const OtaSigVerifier_t * pxVerifier,
+                                 uint8_t * pucBuffer,
+                                 size_t uxBufferLen,
+                                 size_t * puxWritten )
+{
+    int lError = 0;
+    size_t uxTableSize = 0;
+    size_t uxLen = 0;
+
+    if( ( pxVerifier == NULL ) ||
+        ( pucBuffer == NULL ) ||
+        ( puxWritten == NULL ) ||
+        ( pxVerifier->xKeyGroup.MBEDTLS_PRIVATE( T ) == NULL ) )
+    {
+        return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    uxTableSize = pxVerifier->xKeyGroup.MBEDTLS_PRIVATE( T_size );
+    uxLen = OTA_SIG_VERIFY_TABLE_HDR_LEN + ( uxTableSize * OTA_SIG_VERIFY_TABLE_ENTRY_LEN );
+
+    if( ( uxTableSize == 0 ) || ( uxTableSize > UINT8_MAX ) )
+    {
+        lError = MBEDTLS_ERR_ECP_FEATURE_UNAVAILABLE;
+    }
+    else if( uxBufferLen < uxLen )
+    {
+        lError = MBEDTLS_ERR_ECP_BUFFER_TOO_SMALL;
+    }
+    else
+    {
+        uint8_t * pucEntry = &( pucBuffer[ OTA_SIG_VERIFY_TABLE_HDR_LEN ] );
+
+        ( void ) memcpy( pucBuffer, OTA_SIG_VERIFY_TABLE_MAGIC, 4 );
+        prvWriteLe32( &( pucBuffer[ 4 ] ), MBEDTLS_VERSION_NUMBER );
+        pucBuffer[ 8 ] = MBEDTLS_ECP_WINDOW_SIZE;
+        pucBuffer[ 9 ] = ( uint8_t ) uxTableSize;
+        pucBuffer[ 10 ] = 0;
+        pucBuffer[ 11 ] = 0;
+        ( void ) memcpy( &( pucBuffer[ 12 ] ), pxVerifier->pucPublicKey, OTA_SIG_VERIFY_POINT_LEN );
+
+        for( size_t i = 0; ( i < uxTableSize ) && ( lError == 0 ); i++ )
+        {
+            const mbedtls_ecp_point * pxPoint = &( pxVerifier->xKeyGroup.MBEDTLS_PRIVATE( T )[ i ] );
+
+            lError = mbedtls_mpi_write_binary( &( pxPoint->MBEDTLS_PRIVATE( X ) ), pucEntry, P256_COORD_LEN );
+
+            if( lError == 0 )
+            {
+                lError = mbedtls_mpi_write_binary( &( pxPoint->MBEDTLS_PRIVATE( Y ) ), &( pucEntry[ P256_COORD_LEN ] ), P256_COORD_LEN );
+            }
+
+            pucEntry += OTA_SIG_VERIFY_TABLE_ENTRY_LEN;
+        }
+    }
+
+    *puxWritten = ( lError == 0 ) ? uxLen : 0;
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+int lOtaSigVerifier_ImportTable( OtaSigVerifier_t * pxVerifier,
+                                 const uint8_t * pucBuffer,
+                                 size_t uxBufferLen )
+{
+    int lError = 0;
+    size_t uxTableSize = 0;
+    mbedtls_ecp_point * pxTable = NULL;
+
+    if( ( pxVerifier == NULL ) ||
+        !pxVerifier->xInitialized ||
+        ( pucBuffer == NULL ) ||
+        ( uxBufferLen < OTA_SIG_VERIFY_TABLE_HDR_LEN ) )
+    {
+        return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    uxTableSize = pucBuffer[ 9 ];
+
+    /* The layout of the table depends on the mbedtls version and window size it was built with */
+    if( ( memcmp( pucBuffer, OTA_SIG_VERIFY_TABLE_MAGIC, 4 ) != 0 ) ||
+        ( prvReadLe32( &( pucBuffer[ 4 ] ) ) != MBEDTLS_VERSION_NUMBER ) ||
+        ( pucBuffer[ 8 ] != MBEDTLS_ECP_WINDOW_SIZE ) ||
+        ( uxTableSize == 0 ) ||
+        ( uxBufferLen != OTA_SIG_VERIFY_TABLE_HDR_LEN + ( uxTableSize * OTA_SIG_VERIFY_TABLE_ENTRY_LEN ) ) ||
+        ( memcmp( &( pucBuffer[ 12 ] ), pxVerifier->pucPublicKey, OTA_SIG_VERIFY_POINT_LEN ) != 0 ) )
+    {
+        lError = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    if( lError == 0 )
+    {
+        /* Allocated the same way as mbedtls allocates its own tables, so mbedtls_ecp_group_free releases it */
+        pxTable = mbedtls_calloc( uxTableSize, sizeof( mbedtls_ecp_point ) );
+
+        if( pxTable == NULL )
+        {
+            lError = MBEDTLS_ERR_ECP_ALLOC_FAILED;
+        }
+    }
+
+    if( lError == 0 )
+    {
+        const uint8_t * pucEntry = &( pucBuffer[ OTA_SIG_VERIFY_TABLE_HDR_LEN ] );
+
+        for( size_t i = 0; i < uxTableSize; i++ )
+        {
+            mbedtls_ecp_point_init( &( pxTable[ i ] ) );
+        }
+
+        for( size_t i = 0; ( i < uxTableSize ) && ( lError == 0 ); i++ )
+        {
+            mbedtls_ecp_point * pxPoint = &( pxTable[ i ] );
+
+            lError = mbedtls_mpi_read_binary( &( pxPoint->MBEDTLS_PRIVATE( X ) ), pucEntry, P256_COORD_LEN );
+
+            if( lError == 0 )
+            {
+                lError = mbedtls_mpi_read_binary( &( pxPoint->MBEDTLS_PRIVATE( Y ) ), &( pucEntry[ P256_COORD_LEN ] ), P256_COORD_LEN );
+            }
+
+            if( lError == 0 )
+            {
+                lError = mbedtls_mpi_lset( &( pxPoint->MBEDTLS_PRIVATE( Z ) ), 1 );
+            }
+
+            if( lError == 0 )
+            {
+                lError = mbedtls_ecp_check_pubkey( &( pxVerifier->xGroup ), pxPoint );
+            }
+
+            pucEntry += OTA_SIG_VERIFY_TABLE_ENTRY_LEN;
+        }
+    }
+
+    /* The first entry of a comb table is the point itself */
+    if( ( lError == 0 ) &&
+        ( mbedtls_ecp_point_cmp( &( pxTable[ 0 ] ), &( pxVerifier->xKeyGroup.G ) ) != 0 ) )
+    {
+        lError = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    if( lError == 0 )
+    {
+        prvClearGroupTable( &( pxVerifier->xKeyGroup ) );
+        pxVerifier->xKeyGroup.MBEDTLS_PRIVATE( T ) = pxTable;
+        pxVerifier->xKeyGroup.MBEDTLS_PRIVATE( T_size ) = uxTableSize;
+    }
+    else if( pxTable != NULL )
+    {
+        for( size_t i = 0; i < uxTableSize; i++ )
+        {
+            mbedtls_ecp_point_free( &( pxTable[ i ] ) );
+        }
+
+        mbedtls_free( pxTable );
+    }
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Convert a hash to an integer as done by mbedtls_ecdsa_verify ( SEC1 4.1.3 step 5 ) */
+static int prvHashToMpi( const mbedtls_ecp_group * pxGroup,
+                         mbedtls_mpi * pxE,
+                         const uint8_t * pucHash,
+                         size_t uxHashLen )
+{
+    int lError;
+    size_t uxNumBytes = ( pxGroup->nbits + 7 ) / 8;
+    size_t uxUseLen = ( uxHashLen > uxNumBytes ) ? uxNumBytes : uxHashLen;
+
+    lError = mbedtls_mpi_read_binary( pxE, pucHash, uxUseLen );
+
+    if( ( lError == 0 ) && ( ( uxUseLen * 8 ) > pxGroup->nbits ) )
+    {
+        lError = mbedtls_mpi_shift_r( pxE, ( uxUseLen * 8 ) - pxGroup->nbits );
+    }
+
+    if( ( lError == 0 ) && ( mbedtls_mpi_cmp_mpi( pxE, &( pxGroup->N ) ) >= 0 ) )
+    {
+        lError = mbedtls_mpi_sub_mpi( pxE, pxE, &( pxGroup->N ) );
+    }
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvReadSignature( const uint8_t * pucSignature,
+                             size_t uxSignatureLen,
+                             mbedtls_mpi * pxR,
+                             mbedtls_mpi * pxS )
+{
+    unsigned char * pucIter = ( unsigned char * ) pucSignature;
+    const unsigned char * pucEnd = pucSignature + uxSignatureLen;
+    size_t uxLen = 0;
+    int lError;
+
+    lError = mbedtls_asn1_get_tag( &pucIter, pucEnd, &uxLen,
+                                   MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE );
+
+    if( ( lError == 0 ) && ( pucIter + uxLen != pucEnd ) )
+    {
+        lError = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_asn1_get_mpi( &pucIter, pucEnd, pxR );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_asn1_get_mpi( &pucIter, pucEnd, pxS );
+    }
+
+    if( ( lError == 0 ) && ( pucIter != pucEnd ) )
+    {
+        lError = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+int lOtaSigVerifier_Verify( OtaSigVerifier_t * pxVerifier,
+                            const uint8_t * pucHash,
+                            size_t uxHashLen,
+                            const uint8_t * pucSignature,
+                            size_t uxSignatureLen )
+{
+    int lError = 0;
+    mbedtls_ecp_group * pxGroup = NULL;
+    mbedtls_mpi xR, xS, xE, xSInv, xU1, xU2, xV, xZero, xOne;
+    mbedtls_ecp_point xU2Q, xSum;
+
+    if( ( pxVerifier == NULL ) ||
+        !pxVerifier->xInitialized ||
+        ( pucHash == NULL ) ||
+        ( pucSignature == NULL ) )
+    {
+        return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    pxGroup = &( pxVerifier->xGroup );
+
+    mbedtls_mpi_init( &xR );
+    mbedtls_mpi_init( &xS );
+    mbedtls_mpi_init( &xE );
+    mbedtls_mpi_init( &xSInv );
+    mbedtls_mpi_init( &xU1 );
+    mbedtls_mpi_init( &xU2 );
+    mbedtls_mpi_init( &xV );
+    mbedtls_mpi_init( &xZero );
+    mbedtls_mpi_init( &xOne );
+    mbedtls_ecp_point_init( &xU2Q );
+    mbedtls_ecp_point_init( &xSum );
+
+    lError = lOtaSigVerifier_BuildTable( pxVerifier );
+
+    if( lError == 0 )
+    {
+        lError = prvReadSignature( pucSignature, uxSignatureLen, &xR, &xS );
+    }
+
+    /* 1 <= r, s < n */
+    if( ( lError == 0 ) &&
+        ( ( mbedtls_mpi_cmp_int( &xR, 1 ) < 0 ) ||
+          ( mbedtls_mpi_cmp_mpi( &xR, &( pxGroup->N ) ) >= 0 ) ||
+          ( mbedtls_mpi_cmp_int( &xS, 1 ) < 0 ) ||
+          ( mbedtls_mpi_cmp_mpi( &xS, &( pxGroup->N ) ) >= 0 ) ) )
+    {
+        lError = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+    }
+
+    if( lError == 0 )
+    {
+        lError = prvHashToMpi( pxGroup, &xE, pucHash, uxHashLen );
+    }
+
+    /* u1 = e / s mod n, u2 = r / s mod n */
+    if( lError == 0 )
+    {
+        lError = mbedtls_mpi_inv_mod( &xSInv, &xS, &( pxGroup->N ) );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_mpi_mul_mpi( &xU1, &xE, &xSInv );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_mpi_mod_mpi( &xU1, &xU1, &( pxGroup->N ) );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_mpi_mul_mpi( &xU2, &xR, &xSInv );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_mpi_mod_mpi( &xU2, &xU2, &( pxGroup->N ) );
+    }
+
+    /* u2 * Q, using the table kept in the key group */
+    if( lError == 0 )
+    {
+        lError = mbedtls_ecp_muladd( &( pxVerifier->xKeyGroup ), &xU2Q,
+                                     &xU2, &( pxVerifier->xKeyGroup.G ),
+                                     &xZero, &( pxVerifier->xKeyGroup.G ) );
+    }
+
+    /* u1 * G + u2 * Q, using the built in table for G */
+    if( lError == 0 )
+    {
+        lError = mbedtls_mpi_lset( &xOne, 1 );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_ecp_muladd( pxGroup, &xSum, &xU1, &( pxGroup->G ), &xOne, &xU2Q );
+    }
+
+    if( ( lError == 0 ) && mbedtls_ecp_is_zero( &xSum ) )
+    {
+        lError = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+    }
+
+    /* v = x mod n, valid if v == r */
+    if( lError == 0 )
+    {
+        lError = mbedtls_mpi_mod_mpi( &xV, &( xSum.MBEDTLS_PRIVATE( X ) ), &( pxGroup->N ) );
+    }
+
+    if( ( lError == 0 ) && ( mbedtls_mpi_cmp_mpi( &xV, &xR ) != 0 ) )
+    {
+        lError = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+    }
+
+    mbedtls_mpi_free( &xR );
+    mbedtls_mpi_free( &xS );
+    mbedtls_mpi_free( &xE );
+    mbedtls_mpi_free( &xSInv );
+    mbedtls_mpi_free( &xU1 );
+    mbedtls_mpi_free( &xU2 );
+    mbedtls_mpi_free( &xV );
+    mbedtls_mpi_free( &xZero );
+    mbedtls_mpi_free( &xOne );
+    mbedtls_ecp_point_free( &xU2Q );
+    mbedtls_ecp_point_free( &xSum );
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+void vOtaSigVerifier_Free( OtaSigVerifier_t * pxVerifier )
+{
+    if( pxVerifier != NULL )
+    {
+        mbedtls_ecp_group_free( &( pxVerifier->xGroup ) );
+
+        /* The generator of the key group was allocated by mbedtls_ecp_copy, which
+         * mbedtls_ecp_group_free does not release for groups with static constants. */
+        if( pxVerifier->xGeneratorReplaced &&
+            ( pxVerifier->xKeyGroup.MBEDTLS_PRIVATE( h ) == 1 ) )
+        {
+            mbedtls_ecp_point_free( &( pxVerifier->xKeyGroup.G ) );
+        }
+
+        mbedtls_ecp_group_free( &( pxVerifier->xKeyGroup ) );
+        pxVerifier->xGeneratorReplaced = false;
+        pxVerifier->xInitialized = false;
+    }
+}
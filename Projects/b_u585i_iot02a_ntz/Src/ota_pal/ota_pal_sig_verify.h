@@ -0,0 +1,127 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_pal_sig_verify.h
+ * @brief ECDSA P-256 verification with a precomputed table for the OTA signing key.
+ *
+ * mbedtls_pk_verify computes u1 * G + u2 * Q for every image. mbedtls keeps a
+ * precomputed comb table for the base point G, but the table for the public
+ * key Q is built again and discarded on each verification.
+ *
+ * The verifier keeps a second group in which the generator is replaced by Q,
+ * so that mbedtls builds the comb table for Q once and keeps it in that group.
+ * The table can be exported and imported again, which lets the OTA PAL keep it
+ * in flash across reboots instead of rebuilding it.
+ */
+
+#ifndef OTA_PAL_SIG_VERIFY_H_
+#define OTA_PAL_SIG_VERIFY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "mbedtls/pk.h"
+#include "mbedtls/ecp.h"
+
+/* Length of an uncompressed P-256 point */
+#define OTA_SIG_VERIFY_POINT_LEN         ( 65 )
+
+/* Serialized table header: magic, mbedtls version, window size, point count, reserved, public key */
+#define OTA_SIG_VERIFY_TABLE_MAGIC       "ECT1"
+#define OTA_SIG_VERIFY_TABLE_HDR_LEN     ( 4 + 4 + 1 + 1 + 2 + OTA_SIG_VERIFY_POINT_LEN )
+
+/* Each table point is stored as affine X and Y coordinates */
+#define OTA_SIG_VERIFY_TABLE_ENTRY_LEN   ( 64 )
+
+/* Upper bound on the serialized table size, for a window size of up to 6 */
+#define OTA_SIG_VERIFY_TABLE_MAX_LEN     ( OTA_SIG_VERIFY_TABLE_HDR_LEN + ( 32 * OTA_SIG_VERIFY_TABLE_ENTRY_LEN ) )
+
+typedef struct
+{
+    mbedtls_ecp_group xGroup;    /*!< secp256r1 with the built in table for G */
+    mbedtls_ecp_group xKeyGroup; /*!< secp256r1 with G replaced by the signing key */
+    uint8_t pucPublicKey[ OTA_SIG_VERIFY_POINT_LEN ];
+    bool xGeneratorReplaced;     /*!< xKeyGroup.G was allocated by the verifier */
+    bool xInitialized;
+} OtaSigVerifier_t;
+
+/**
+ * @brief Set up a verifier for a P-256 public key. The table is not built yet.
+ *
+ * @return 0 on success, MBEDTLS_ERR_PK_TYPE_MISMATCH if the key is not a P-256
+ * key, or another mbedtls error code.
+ */
+int lOtaSigVerifier_Init( OtaSigVerifier_t * pxVerifier,
+                          mbedtls_pk_context * pxPubKey );
+
+/**
+ * @brief Check if a verifier was set up for the given public key.
+ */
+bool xOtaSigVerifier_IsKey( const OtaSigVerifier_t * pxVerifier,
+                            mbedtls_pk_context * pxPubKey );
+
+/**
+ * @brief Build the precomputed table for the public key if not built or imported yet.
+ */
+int lOtaSigVerifier_BuildTable( OtaSigVerifier_t * pxVerifier );
+
+/**
+ * @brief Serialize the table for storage.
+ *
+ * @param[out] pucBuffer Output buffer of at least OTA_SIG_VERIFY_TABLE_MAX_LEN bytes.
+ * @param[in] uxBufferLen Length of pucBuffer.
+ * @param[out] puxWritten Number of bytes written.
+ */
+int lOtaSigVerifier_ExportTable( const OtaSigVerifier_t * pxVerifier,
+                                 uint8_t * pucBuffer,
+                                 size_t uxBufferLen,
+                                 size_t * puxWritten );
+
+/**
+ * @brief Load a table written by lOtaSigVerifier_ExportTable.
+ *
+ * The table is rejected unless it was built for the same key, mbedtls version
+ * and window size, and every point in it is on the curve.
+ */
+int lOtaSigVerifier_ImportTable( OtaSigVerifier_t * pxVerifier,
+                                 const uint8_t * pucBuffer,
+                                 size_t uxBufferLen );
+
+/**
+ * @brief Verify a DER encoded ECDSA signature over a hash.
+ *
+ * Builds the table first if needed.
+ *
+ * @return 0 if the signature is valid, MBEDTLS_ERR_ECP_VERIFY_FAILED if not,
+ * or another mbedtls error code.
+ */
+int lOtaSigVerifier_Verify( OtaSigVerifier_t * pxVerifier,
+                            const uint8_t * pucHash,
+                            size_t uxHashLen,
+                            const uint8_t * pucSignature,
+                            size_t uxSignatureLen );
+
+void vOtaSigVerifier_Free( OtaSigVerifier_t * pxVerifier );
+
+#endif /* OTA_PAL_SIG_VERIFY_H_ */
@@ -0,0 +1,391 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "ota_pal_state_log.h"
+#include "hw_defs.h"
+#include "stm32u5xx.h"
+#include "stm32u5xx_hal_flash.h"
+#include "stm32u5xx_hal_flash_ex.h"
+#include "stm32u5xx_hal_icache.h"
+
+/*
+ * Physical bank holding the log, in the pages reserved at the end of the bank by
+ * the OTA_STATE region of the linker script. These pages are outside of the
+ * image, so the OTA erase of the inactive bank leaves them alone.
+ */
+#ifndef OTA_STATE_LOG_BANK
+#define OTA_STATE_LOG_BANK      FLASH_BANK_2
+#endif
+
+#define OTA_STATE_LOG_MAGIC     ( 0x4F544153UL ) /* "OTAS" */
+#define OTA_STATE_LOG_ERASED    ( 0xFFFFFFFFUL )
+
+/* One record per quad-word, the flash program unit */
+typedef struct
+{
+    uint32_t ulSequence;
+    uint32_t ulState;
+    uint32_t ulTargetBank;
+    uint32_t ulCheck;
+} OtaStateRecord_t;
+
+#define OTA_STATE_LOG_SLOTS     ( FLASH_PAGE_SIZE / sizeof( OtaStateRecord_t ) )
+#define OTA_STATE_LOG_PAGES     ( 2 )
+
+/* Provided by the linker script, relative to the start of a bank */
+extern uint32_t _ota_state_offset[];
+extern uint32_t _ota_state_size[];
+
+static const OtaStateRecord_t * pxLogPages[ OTA_STATE_LOG_PAGES ] = { NULL };
+static uint32_t ulFirstPage = 0;
+
+/* Position of the newest record, and of the slot the next one goes to */
+static uint32_t ulCurrentPage = 0;
+static uint32_t ulNextSlot = 0;
+static BaseType_t xHasRecord = pdFALSE;
+static OtaStateRecord_t xNewest = { 0 };
+
+/* Set while a slot is read, and by the NMI hook when that read hit a double ECC error */
+static volatile BaseType_t xReadingSlot = pdFALSE;
+static volatile BaseType_t xSlotEccError = pdFALSE;
+
+static inline uint32_t ulRecordCheck( const OtaStateRecord_t * pxRecord )
+{
+    return pxRecord->ulSequence ^ pxRecord->ulState ^ pxRecord->ulTargetBank ^ OTA_STATE_LOG_MAGIC;
+}
+
+static inline BaseType_t xIsErased( const OtaStateRecord_t * pxRecord )
+{
+    return( ( pxRecord->ulSequence == OTA_STATE_LOG_ERASED ) &&
+            ( pxRecord->ulState == OTA_STATE_LOG_ERASED ) &&
+            ( pxRecord->ulTargetBank == OTA_STATE_LOG_ERASED ) &&
+            ( pxRecord->ulCheck == OTA_STATE_LOG_ERASED ) );
+}
+
+static inline BaseType_t xIsValid( const OtaStateRecord_t * pxRecord )
+{
+    return( ( pxRecord->ulSequence != OTA_STATE_LOG_ERASED ) &&
+            ( pxRecord->ulCheck == ulRecordCheck( pxRecord ) ) );
+}
+
+/*
+ * A quad-word program cut off by a reset leaves a double ECC error in the slot,
+ * and reading it raises an NMI. xFlashEccErrorHook clears the error when it comes
+ * from a read by this function, which then reports the slot as unreadable.
+ */
+static BaseType_t xReadSlot( const OtaStateRecord_t * pxSlot,
+                             OtaStateRecord_t * pxRecord )
+{
+    const volatile uint32_t * pulSlot = ( const volatile uint32_t * ) pxSlot;
+
+    xSlotEccError = pdFALSE;
+    xReadingSlot = pdTRUE;
+
+    pxRecord->ulSequence = pulSlot[ 0 ];
+    pxRecord->ulState = pulSlot[ 1 ];
+    pxRecord->ulTargetBank = pulSlot[ 2 ];
+    pxRecord->ulCheck = pulSlot[ 3 ];
+
+    /* Let the NMI of a failed load be taken before the flag is checked */
+    __DSB();
+    __ISB();
+
+    xReadingSlot = pdFALSE;
+
+    return ( xSlotEccError == pdFALSE ) ? pdTRUE : pdFALSE;
+}
+
+static BaseType_t xIsSlotErased( const OtaStateRecord_t * pxSlot )
+{
+    OtaStateRecord_t xRecord;
+
+    return( ( xReadSlot( pxSlot, &xRecord ) == pdTRUE ) &&
+            ( xIsErased( &xRecord ) == pdTRUE ) );
+}
+
+/*
+ * Records are appended in order from the start of a page, so the first free slot
+ * is found with a binary search. A slot torn by a reset while it was programmed
+ * counts as written: it fails its check or cannot be read, and the record before
+ * it is used instead.
+ */
+static uint32_t ulFindFirstFreeSlot( const OtaStateRecord_t * pxPage )
+{
+    uint32_t ulLow = 0;
+    uint32_t ulHigh = OTA_STATE_LOG_SLOTS;
+
+    while( ulLow < ulHigh )
+    {
+        uint32_t ulMid = ulLow + ( ( ulHigh - ulLow ) / 2 );
+
+        if( xIsSlotErased( &( pxPage[ ulMid ] ) ) == pdTRUE )
+        {
+            ulHigh = ulMid;
+        }
+        else
+        {
+            ulLow = ulMid + 1;
+        }
+    }
+
+    return ulLow;
+}
+
+static BaseType_t xFindNewest( const OtaStateRecord_t * pxPage,
+                               uint32_t ulFreeSlot,
+                               OtaStateRecord_t * pxNewest )
+{
+    BaseType_t xFound = pdFALSE;
+
+    for( uint32_t ulSlot = ulFreeSlot; ( ulSlot > 0 ) && ( xFound == pdFALSE ); ulSlot-- )
+    {
+        if( ( xReadSlot( &( pxPage[ ulSlot - 1 ] ), pxNewest ) == pdTRUE ) &&
+            ( xIsValid( pxNewest ) == pdTRUE ) )
+        {
+            xFound = pdTRUE;
+        }
+    }
+
+    return xFound;
+}
+
+static BaseType_t xErasePage( uint32_t ulPage )
+{
+    BaseType_t xResult = pdFALSE;
+    FLASH_EraseInitTypeDef xEraseInit =
+    {
+        .TypeErase = FLASH_TYPEERASE_PAGES,
+        .Banks     = OTA_STATE_LOG_BANK,
+        .Page      = ulFirstPage + ulPage,
+        .NbPages   = 1
+    };
+    uint32_t ulPageError = 0;
+
+    if( HAL_FLASH_Unlock() == HAL_OK )
+    {
+        __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
+
+        if( HAL_FLASHEx_Erase( &xEraseInit, &ulPageError ) == HAL_OK )
+        {
+            xResult = pdTRUE;
+        }
+        else
+        {
+            LogError( "Failed to erase OTA state log page %lu, error: 0x%08lx.", ulPage, HAL_FLASH_GetError() );
+        }
+
+        ( void ) HAL_FLASH_Lock();
+    }
+
+    /* The instruction cache also caches data loads from flash */
+    ( void ) HAL_ICACHE_Invalidate();
+
+    return xResult;
+}
+
+static BaseType_t xProgramRecord( const OtaStateRecord_t * pxDest,
+                                  const OtaStateRecord_t * pxRecord )
+{
+    BaseType_t xResult = pdFALSE;
+
+    if( HAL_FLASH_Unlock() == HAL_OK )
+    {
+        __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
+
+        if( HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, ( uint32_t ) pxDest, ( uint32_t ) pxRecord ) == HAL_OK )
+        {
+            xResult = pdTRUE;
+        }
+        else
+        {
+            LogError( "Failed to program OTA state record, error: 0x%08lx.", HAL_FLASH_GetError() );
+        }
+
+        ( void ) HAL_FLASH_Lock();
+    }
+
+    ( void ) HAL_ICACHE_Invalidate();
+
+    if( xResult == pdTRUE )
+    {
+        OtaStateRecord_t xWritten;
+
+        if( ( xReadSlot( pxDest, &xWritten ) == pdFALSE ) ||
+            ( memcmp( &xWritten, pxRecord, sizeof( OtaStateRecord_t ) ) != 0 ) )
+        {
+            xResult = pdFALSE;
+        }
+    }
+
+    return xResult;
+}
+
+/*
+ * Only a double ECC error in the log pages, raised while the log reads one of its
+ * slots, is recovered from. ADDR_ECC is the offset of the failing quad-word in its bank.
+ */
+bool xFlashEccErrorHook( void )
+{
+    bool xHandled = false;
+    uint32_t ulEccr = READ_REG( FLASH->ECCR );
+    uint32_t ulOffset = ulEccr & FLASH_ECCR_ADDR_ECC;
+
+    if( ( xReadingSlot == pdTRUE ) &&
+        ( ( ulEccr & FLASH_ECCR_ECCD ) != 0 ) &&
+        ( ( ulEccr & FLASH_ECCR_SYSF_ECC ) == 0 ) &&
+        ( ulOffset >= ( uint32_t ) _ota_state_offset ) &&
+        ( ulOffset < ( ( uint32_t ) _ota_state_offset + ( uint32_t ) _ota_state_size ) ) )
+    {
+        __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ECCD );
+        xSlotEccError = pdTRUE;
+        xHandled = true;
+    }
+
+    return xHandled;
+}
+
+BaseType_t xOtaStateLogInit( void )
+{
+    uint32_t ulBankAddr = FLASH_BASE;
+    BaseType_t xSwapped = ( READ_BIT( FLASH->OPTR, FLASH_OPTR_SWAP_BANK ) != 0 ) ? pdTRUE : pdFALSE;
+    uint32_t ulFreeSlots[ OTA_STATE_LOG_PAGES ] = { 0 };
+
+    configASSERT( ( ( uint32_t ) _ota_state_offset % FLASH_PAGE_SIZE ) == 0 );
+    configASSERT( ( uint32_t ) _ota_state_size == ( OTA_STATE_LOG_PAGES * FLASH_PAGE_SIZE ) );
+
+    /* Bank 2 is mapped first when the banks are swapped */
+    if( ( OTA_STATE_LOG_BANK == FLASH_BANK_2 ) != ( xSwapped == pdTRUE ) )
+    {
+        ulBankAddr += FLASH_BANK_SIZE;
+    }
+
+    ulFirstPage = ( uint32_t ) _ota_state_offset / FLASH_PAGE_SIZE;
+    xHasRecord = pdFALSE;
+
+    for( uint32_t ulPage = 0; ulPage < OTA_STATE_LOG_PAGES; ulPage++ )
+    {
+        OtaStateRecord_t xRecord;
+
+        pxLogPages[ ulPage ] = ( const OtaStateRecord_t * ) ( ulBankAddr + ( uint32_t ) _ota_state_offset +
+                                                              ( ulPage * FLASH_PAGE_SIZE ) );
+
+        ulFreeSlots[ ulPage ] = ulFindFirstFreeSlot( pxLogPages[ ulPage ] );
+
+        if( ( xFindNewest( pxLogPages[ ulPage ], ulFreeSlots[ ulPage ], &xRecord ) == pdTRUE ) &&
+            ( ( xHasRecord == pdFALSE ) || ( xRecord.ulSequence > xNewest.ulSequence ) ) )
+        {
+            xNewest = xRecord;
+            xHasRecord = pdTRUE;
+            ulCurrentPage = ulPage;
+        }
+    }
+
+    if( xHasRecord == pdTRUE )
+    {
+        ulNextSlot = ulFreeSlots[ ulCurrentPage ];
+    }
+    else
+    {
+        /* Nothing usable, start over on an erased page at the next append */
+        ulCurrentPage = OTA_STATE_LOG_PAGES - 1;
+        ulNextSlot = OTA_STATE_LOG_SLOTS;
+    }
+
+    return pdTRUE;
+}
+
+BaseType_t xOtaStateLogRead( uint32_t * pulState,
+                             uint32_t * pulTargetBank )
+{
+    configASSERT( pulState != NULL );
+    configASSERT( pulTargetBank != NULL );
+
+    if( xHasRecord == pdTRUE )
+    {
+        *pulState = xNewest.ulState;
+        *pulTargetBank = xNewest.ulTargetBank;
+    }
+
+    return xHasRecord;
+}
+
+BaseType_t xOtaStateLogAppend( uint32_t ulState,
+                               uint32_t ulTargetBank )
+{
+    BaseType_t xResult = pdTRUE;
+    OtaStateRecord_t xRecord __attribute__( ( aligned( 16 ) ) ) =
+    {
+        .ulSequence   = ( xHasRecord == pdTRUE ) ? ( xNewest.ulSequence + 1 ) : 0,
+        .ulState      = ulState,
+        .ulTargetBank = ulTargetBank,
+    };
+
+    xRecord.ulCheck = ulRecordCheck( &xRecord );
+
+    /* A slot left unusable by an interrupted program also moves the log to the other page */
+    if( ( ulNextSlot >= OTA_STATE_LOG_SLOTS ) ||
+        ( xIsSlotErased( &( pxLogPages[ ulCurrentPage ][ ulNextSlot ] ) ) == pdFALSE ) )
+    {
+        uint32_t ulOtherPage = ( ulCurrentPage + 1 ) % OTA_STATE_LOG_PAGES;
+
+        xResult = xErasePage( ulOtherPage );
+
+        if( xResult == pdTRUE )
+        {
+            ulCurrentPage = ulOtherPage;
+            ulNextSlot = 0;
+        }
+    }
+
+    if( xResult == pdTRUE )
+    {
+        xResult = xProgramRecord( &( pxLogPages[ ulCurrentPage ][ ulNextSlot ] ), &xRecord );
+
+        /* Keep the written slots contiguous: a failed program is only skipped if it left something behind */
+        if( xIsSlotErased( &( pxLogPages[ ulCurrentPage ][ ulNextSlot ] ) ) == pdFALSE )
+        {
+            ulNextSlot++;
+        }
+    }
+
+    if( xResult == pdTRUE )
+    {
+        xNewest = xRecord;
+        xHasRecord = pdTRUE;
+    }
+
+    return xResult;
+}
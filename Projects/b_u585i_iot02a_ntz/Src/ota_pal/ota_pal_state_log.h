@@ -0,0 +1,56 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/*
+ * Append-only log of the OTA PAL state in a few dedicated internal flash pages.
+ *
+ * Each state change is programmed as one quad-word record with a sequence
+ * number, so it costs a single flash program instead of a filesystem commit.
+ * Two pages are used in turn: when the current page is full, the other one is
+ * erased and the next record is written at its start, so the previous state
+ * stays readable until the new one is in place.
+ */
+
+#ifndef OTA_PAL_STATE_LOG_H_
+#define OTA_PAL_STATE_LOG_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/* Locate the log and find its newest record. Called once before the other functions. */
+BaseType_t xOtaStateLogInit( void );
+
+/* Get the newest record, returns pdFALSE if the log is empty */
+BaseType_t xOtaStateLogRead( uint32_t * pulState,
+                             uint32_t * pulTargetBank );
+
+BaseType_t xOtaStateLogAppend( uint32_t ulState,
+                               uint32_t ulTargetBank );
+
+#endif /* OTA_PAL_STATE_LOG_H_ */
@@ -35,6 +35,10 @@
 #include "task.h"
 
 #include "ota_pal.h"
+#include "ota_pal_decompress.h"
+#include "ota_pal_sig_verify.h"
+#include "ota_pal_state_log.h"
+#include "trace_ring.h"
 #include "stm32u5xx.h"
 #include "stm32u5xx_hal_flash.h"
 #include "lfs.h"
@@ -42,9 +46,11 @@
 
 #include "mbedtls/pk.h"
 #include "mbedtls/md.h"
+#include "mbedtls/sha256.h"
 #include "mbedtls_error_utils.h"
 
 #include "PkiObject.h"
+#include "tls_transport_config.h"
 
 #define FLASH_START_INACTIVE_BANK    ( ( uint32_t ) ( FLASH_BASE + FLASH_BANK_SIZE ) )
 
@@ -52,10 +58,22 @@
 
 #define NUM_REMAINING_BYTES( length )    ( length & 0x0F )
 
+/* Former location of the image state, read once to migrate it to the state log */
 #define IMAGE_CONTEXT_FILE_NAME    "/ota/image_state"
 
+/* Precomputed verification table for the OTA signing key */
+#define SIG_TABLE_FILE_NAME        "/ota/sig_table"
+
 #define OTA_IMAGE_MIN_SIZE         ( 16 )
 
+/* Images are limited to the start of a bank, the rest is reserved for the internal flash filesystem */
+extern uint32_t _image_max_size[];
+
+#define OTA_IMAGE_MAX_SIZE         ( ( uint32_t ) _image_max_size )
+
+/* Size of the write combining buffer used when decompressing images. Must be a multiple of 16 bytes. */
+#define OTA_PAL_WRITE_BUFFER_LEN    ( 1024 )
+
 
 typedef enum
 {
@@ -100,8 +118,23 @@ typedef struct
     uint32_t ulBaseAddress;
     uint32_t ulImageSize;
     OtaPalState_t xPalState;
+    BaseType_t xIsCompressed;
 } OtaPalContext_t;
 
+/* State for decompressing an image received with an OtaCompressedHeader_t */
+typedef struct
+{
+    OtaDecompressCtx_t xDecompressCtx;
+    uint8_t pucWriteBuffer[ OTA_PAL_WRITE_BUFFER_LEN ] __attribute__( ( aligned( 16 ) ) );
+    size_t uxWriteBufferLen;
+    uint32_t ulFlashOffset;
+    uint32_t ulNextFileOffset;
+    uint32_t ulBlockCount;
+    uint32_t ulMaxBlockCycles;
+    uint64_t ullTotalCycles;
+    mbedtls_sha256_context xFileHashCtx; /* Hash of the compressed file, which is what the signature covers */
+} OtaPalDecompressContext_t;
+
 
 const char OTA_JsonFileSignatureKey[] = "sig-sha256-ecdsa";
 
@@ -112,8 +145,11 @@ static OtaPalContext_t xPalContext =
     .ulPendingBank = 0,
     .ulBaseAddress = 0,
     .ulImageSize   = 0,
+    .xIsCompressed = pdFALSE,
 };
 
+static OtaPalDecompressContext_t xDecompressContext = { 0 };
+
 static uint32_t ulBankAtBootup = 0;
 
 /* Static function forward declarations */
@@ -142,6 +178,12 @@ static HAL_StatusTypeDef prvWriteToFlash( uint32_t destination,
 
 static BaseType_t prvEraseBank( uint32_t bankNumber );
 
+/* Compressed image handling */
+static int16_t prvWriteCompressedBlock( OtaPalContext_t * pxContext,
+                                        uint32_t ulOffset,
+                                        const uint8_t * pucData,
+                                        uint32_t ulBlockSize );
+
 /* Verify signature */
 static OtaPalStatus_t prvValidateSignature( const char * pcPubKeyLabel,
                                             const unsigned char * pucSignature,
@@ -187,30 +229,23 @@ static inline uint32_t ulGetOtherBank( uint32_t ulBankNumber )
     return ulRevertBank;
 }
 
-static BaseType_t prvInitializePalContext( OtaPalContext_t * pxContext )
+/*
+ * Read the state left in the littlefs file by firmware predating the state
+ * log, and delete the file. Only called while the state log is empty.
+ */
+static void prvMigrateLegacyNvContext( OtaPalContext_t * pxContext )
 {
-    BaseType_t xResult = pdTRUE;
-    lfs_t * pxLfsCtx = NULL;
-
-    configASSERT( pxContext != NULL );
-
-    pxLfsCtx = pxGetDefaultFsCtx();
+    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
 
     if( pxLfsCtx == NULL )
     {
-        LogError( "File system is not ready" );
-        xResult = pdFALSE;
+        LogWarn( "File system is not ready, OTA image context not migrated." );
     }
     else
     {
         lfs_file_t xFile = { 0 };
         lfs_ssize_t xLfsErr = LFS_ERR_CORRUPT;
 
-        pxContext->xPalState = OTA_PAL_READY;
-        pxContext->ulTargetBank = 0;
-        pxContext->ulBaseAddress = 0;
-        pxContext->ulImageSize = 0;
-
         /* Open the file */
         xLfsErr = lfs_file_open( pxLfsCtx, &xFile, IMAGE_CONTEXT_FILE_NAME, LFS_O_RDONLY );
 
@@ -232,97 +267,86 @@ static BaseType_t prvInitializePalContext( OtaPalContext_t * pxContext )
             {
                 pxContext->xPalState = xNvContext.xPalState;
                 pxContext->ulTargetBank = xNvContext.ulFileTargetBank;
-                pxContext->ulBaseAddress = 0;
-                pxContext->ulImageSize = 0;
             }
 
             ( void ) lfs_file_close( pxLfsCtx, &xFile );
+            ( void ) lfs_remove( pxLfsCtx, IMAGE_CONTEXT_FILE_NAME );
         }
     }
-
-    return xResult;
 }
 
-static BaseType_t prvWritePalNvContext( OtaPalContext_t * pxContext )
+static BaseType_t prvInitializePalContext( OtaPalContext_t * pxContext )
 {
     BaseType_t xResult = pdTRUE;
-    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
+    uint32_t ulState = OTA_PAL_READY;
+    uint32_t ulTargetBank = 0;
 
     configASSERT( pxContext != NULL );
 
-    if( pxLfsCtx == NULL )
+    pxContext->xPalState = OTA_PAL_READY;
+    pxContext->ulTargetBank = 0;
+    pxContext->ulBaseAddress = 0;
+    pxContext->ulImageSize = 0;
+
+    if( xOtaStateLogInit() != pdTRUE )
     {
+        LogError( "OTA state log is not usable." );
         xResult = pdFALSE;
-        LogError( "File system not ready." );
     }
-    else
+    else if( xOtaStateLogRead( &ulState, &ulTargetBank ) == pdTRUE )
     {
-        lfs_ssize_t xLfsErr = LFS_ERR_CORRUPT;
-        lfs_file_t xFile = { 0 };
-        OtaPalNvContext_t xNvContext;
-
-        xNvContext.ulFileTargetBank = pxContext->ulTargetBank;
-        xNvContext.xPalState = pxContext->xPalState;
-
-        /* Open the file */
-        xLfsErr = lfs_file_open( pxLfsCtx, &xFile, IMAGE_CONTEXT_FILE_NAME, ( LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC ) );
-
-        if( xLfsErr == LFS_ERR_OK )
+        if( ulState < OTA_PAL_INVALID )
         {
-            xLfsErr = lfs_file_write( pxLfsCtx, &xFile, &xNvContext, sizeof( OtaPalNvContext_t ) );
-
-            if( xLfsErr != sizeof( OtaPalNvContext_t ) )
-            {
-                LogError( "Failed to save OTA image context to file %s, error = %d.", IMAGE_CONTEXT_FILE_NAME, xLfsErr );
-                xResult = pdFALSE;
-            }
-
-            ( void ) lfs_file_close( pxLfsCtx, &xFile );
+            pxContext->xPalState = ( OtaPalState_t ) ulState;
+            pxContext->ulTargetBank = ulTargetBank;
         }
         else
         {
-            LogError( "Failed to open file %s to save OTA image context, error = %d. ", IMAGE_CONTEXT_FILE_NAME, xLfsErr );
+            LogError( "Invalid state in the OTA state log: %lu. Using defaults.", ulState );
         }
     }
+    else
+    {
+        prvMigrateLegacyNvContext( pxContext );
+
+        /* Record the state even when it is the default, so later boots do not need the file system */
+        xResult = prvWritePalNvContext( pxContext );
+    }
 
     return xResult;
 }
 
-static BaseType_t prvDeletePalNvContext( void )
+static BaseType_t prvWritePalNvContext( OtaPalContext_t * pxContext )
 {
     BaseType_t xResult = pdTRUE;
-    lfs_t * pxLfsCtx = NULL;
 
-    pxLfsCtx = pxGetDefaultFsCtx();
+    configASSERT( pxContext != NULL );
 
-    if( pxLfsCtx == NULL )
+    xResult = xOtaStateLogAppend( ( uint32_t ) pxContext->xPalState, pxContext->ulTargetBank );
+
+    if( xResult != pdTRUE )
     {
-        xResult = pdFALSE;
-        LogError( "File system not ready." );
+        LogError( "Failed to save OTA image context, state: %s.", pcPalStateToString( pxContext->xPalState ) );
     }
-    else
-    {
-        struct lfs_info xFileInfo = { 0 };
 
-        lfs_ssize_t xLfsErr = LFS_ERR_CORRUPT;
+    return xResult;
+}
 
-        xLfsErr = lfs_stat( pxLfsCtx, IMAGE_CONTEXT_FILE_NAME, &xFileInfo );
+/* Appending the default state has the same effect as deleting the former context file */
+static BaseType_t prvDeletePalNvContext( void )
+{
+    BaseType_t xResult = pdTRUE;
 
-        if( xLfsErr == LFS_ERR_OK )
-        {
-            xLfsErr = lfs_remove( pxLfsCtx, IMAGE_CONTEXT_FILE_NAME );
+    xResult = xOtaStateLogAppend( ( uint32_t ) OTA_PAL_READY, 0 );
 
-            if( xLfsErr != LFS_ERR_OK )
-            {
-                xResult = pdFALSE;
-            }
-        }
+    if( xResult != pdTRUE )
+    {
+        LogError( "Failed to reset OTA image context." );
     }
 
     return xResult;
 }
 
-
 static OtaPalContext_t * prvGetImageContext( void )
 {
     OtaPalContext_t * pxCtx = NULL;
@@ -604,10 +628,11 @@ static BaseType_t prvEraseBank( uint32_t bankNumber )
         uint32_t pageError = 0U;
         FLASH_EraseInitTypeDef pEraseInit;
 
+        /* Erase the image area only, the end of the bank may hold a filesystem */
         pEraseInit.Banks = bankNumber;
-        pEraseInit.NbPages = FLASH_PAGE_NB;
+        pEraseInit.NbPages = OTA_IMAGE_MAX_SIZE / FLASH_PAGE_SIZE;
         pEraseInit.Page = 0U;
-        pEraseInit.TypeErase = FLASH_TYPEERASE_MASSERASE;
+        pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
 
         if( HAL_FLASHEx_Erase( &pEraseInit, &pageError ) != HAL_OK )
         {
@@ -626,6 +651,142 @@ static BaseType_t prvEraseBank( uint32_t bankNumber )
     return xResult;
 }
 
+static HAL_StatusTypeDef prvFlushWriteBuffer( OtaPalContext_t * pxContext )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+    OtaPalDecompressContext_t * pxDecompCtx = &xDecompressContext;
+
+    if( pxDecompCtx->uxWriteBufferLen > 0 )
+    {
+        xHalStatus = prvWriteToFlash( pxContext->ulBaseAddress + pxDecompCtx->ulFlashOffset,
+                                      pxDecompCtx->pucWriteBuffer,
+                                      pxDecompCtx->uxWriteBufferLen );
+
+        if( xHalStatus == HAL_OK )
+        {
+            pxDecompCtx->ulFlashOffset += pxDecompCtx->uxWriteBufferLen;
+            pxDecompCtx->uxWriteBufferLen = 0;
+        }
+    }
+
+    return xHalStatus;
+}
+
+/*
+ * Decompress a block of a compressed image into the write combining buffer,
+ * programming the flash each time the buffer fills. Blocks must be received
+ * in order since the decoder state carries over from one block to the next.
+ */
+static int16_t prvWriteCompressedBlock( OtaPalContext_t * pxContext,
+                                        uint32_t ulOffset,
+                                        const uint8_t * pucData,
+                                        uint32_t ulBlockSize )
+{
+    int16_t sBytesWritten = -1;
+    OtaPalDecompressContext_t * pxDecompCtx = &xDecompressContext;
+    OtaDecompressStatus_t xStatus = OTA_DECOMPRESS_OK;
+    const uint8_t * pucInput = pucData;
+    size_t uxInputLen = ulBlockSize;
+    size_t uxFlashOutBefore = 0;
+    uint32_t ulStartCycles = ulGetCycleCount();
+
+    if( ulOffset == 0 )
+    {
+        mbedtls_sha256_free( &( pxDecompCtx->xFileHashCtx ) );
+        ( void ) memset( pxDecompCtx, 0, sizeof( OtaPalDecompressContext_t ) );
+        mbedtls_sha256_init( &( pxDecompCtx->xFileHashCtx ) );
+
+        xStatus = xOtaDecompress_Init( &( pxDecompCtx->xDecompressCtx ), pucData );
+
+        if( xStatus != OTA_DECOMPRESS_OK )
+        {
+            LogError( "Invalid compressed image header." );
+        }
+        else if( pxDecompCtx->xDecompressCtx.ulImageSize > OTA_IMAGE_MAX_SIZE )
+        {
+            LogError( "Decompressed image size %lu exceeds the maximum image size.",
+                      pxDecompCtx->xDecompressCtx.ulImageSize );
+            xStatus = OTA_DECOMPRESS_ERROR;
+        }
+        else
+        {
+            LogInfo( "Receiving compressed image, decompressed size: %lu bytes, window: %u bytes.",
+                     pxDecompCtx->xDecompressCtx.ulImageSize,
+                     ( 1U << pxDecompCtx->xDecompressCtx.ucWindowBits ) );
+
+            pucInput += OTA_COMPRESSED_HEADER_LEN;
+            uxInputLen -= OTA_COMPRESSED_HEADER_LEN;
+        }
+    }
+    else if( ulOffset != pxDecompCtx->ulNextFileOffset )
+    {
+        LogError( "Compressed image blocks must be received in order. Expected offset: %lu, received: %lu.",
+                  pxDecompCtx->ulNextFileOffset, ulOffset );
+        xStatus = OTA_DECOMPRESS_ERROR;
+    }
+
+    if( ( xStatus == OTA_DECOMPRESS_OK ) &&
+        ( ( ( ulOffset == 0 ) && ( mbedtls_sha256_starts( &( pxDecompCtx->xFileHashCtx ), 0 ) != 0 ) ) ||
+          ( mbedtls_sha256_update( &( pxDecompCtx->xFileHashCtx ), pucData, ulBlockSize ) != 0 ) ) )
+    {
+        LogError( "Failed to hash the compressed image block at offset %lu.", ulOffset );
+        xStatus = OTA_DECOMPRESS_ERROR;
+    }
+
+    uxFlashOutBefore = pxDecompCtx->ulFlashOffset + pxDecompCtx->uxWriteBufferLen;
+
+    while( ( xStatus == OTA_DECOMPRESS_OK ) || ( xStatus == OTA_DECOMPRESS_OUTPUT_FULL ) )
+    {
+        size_t uxConsumed = 0;
+        size_t uxProduced = 0;
+
+        xStatus = xOtaDecompress_Process( &( pxDecompCtx->xDecompressCtx ),
+                                          pucInput, uxInputLen, &uxConsumed,
+                                          &( pxDecompCtx->pucWriteBuffer[ pxDecompCtx->uxWriteBufferLen ] ),
+                                          OTA_PAL_WRITE_BUFFER_LEN - pxDecompCtx->uxWriteBufferLen,
+                                          &uxProduced );
+
+        pucInput += uxConsumed;
+        uxInputLen -= uxConsumed;
+        pxDecompCtx->uxWriteBufferLen += uxProduced;
+
+        if( ( ( pxDecompCtx->uxWriteBufferLen == OTA_PAL_WRITE_BUFFER_LEN ) ||
+              ( xStatus == OTA_DECOMPRESS_DONE ) ) &&
+            ( prvFlushWriteBuffer( pxContext ) != HAL_OK ) )
+        {
+            LogError( "Failed to write decompressed data to flash at offset %lu.", pxDecompCtx->ulFlashOffset );
+            xStatus = OTA_DECOMPRESS_ERROR;
+        }
+
+        if( ( xStatus == OTA_DECOMPRESS_OK ) && ( uxInputLen == 0 ) )
+        {
+            break;
+        }
+    }
+
+    if( xStatus != OTA_DECOMPRESS_ERROR )
+    {
+        uint32_t ulCycles = ulGetCycleCount() - ulStartCycles;
+        size_t uxBytesOut = pxDecompCtx->ulFlashOffset + pxDecompCtx->uxWriteBufferLen - uxFlashOutBefore;
+
+        pxDecompCtx->ulNextFileOffset = ulOffset + ulBlockSize;
+        pxDecompCtx->ulBlockCount++;
+        pxDecompCtx->ullTotalCycles += ulCycles;
+
+        if( ulCycles > pxDecompCtx->ulMaxBlockCycles )
+        {
+            pxDecompCtx->ulMaxBlockCycles = ulCycles;
+        }
+
+        LogDebug( "Compressed block at offset %lu: %lu bytes in, %lu bytes out, %lu cycles.",
+                  ulOffset, ulBlockSize, ( uint32_t ) uxBytesOut, ulCycles );
+
+        sBytesWritten = ( int16_t ) ulBlockSize;
+    }
+
+    return sBytesWritten;
+}
+
 static BaseType_t xCalculateImageHash( const unsigned char * pucImageAddress,
                                        const size_t uxImageLength,
                                        unsigned char * pucHashBuffer,
@@ -678,6 +839,114 @@ static BaseType_t xCalculateImageHash( const unsigned char * pucImageAddress,
     return xResult;
 }
 
+/* Verifier for the signing key, kept until the key changes */
+static OtaSigVerifier_t xSigVerifier = { 0 };
+
+/*
+ * Set up xSigVerifier for the given key. The precomputed table is read from
+ * flash when available, otherwise it is built and saved for the next boot.
+ */
+static BaseType_t prvLoadSigVerifier( mbedtls_pk_context * pxPubKeyCtx )
+{
+    BaseType_t xResult = pdTRUE;
+    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
+    uint8_t * pucTable = NULL;
+    size_t uxTableLen = 0;
+
+    if( xOtaSigVerifier_IsKey( &xSigVerifier, pxPubKeyCtx ) )
+    {
+        return pdTRUE;
+    }
+
+    vOtaSigVerifier_Free( &xSigVerifier );
+
+    if( lOtaSigVerifier_Init( &xSigVerifier, pxPubKeyCtx ) != 0 )
+    {
+        LogInfo( "OTA signing key is not a P-256 key. Using the generic verification path." );
+        xResult = pdFALSE;
+    }
+    else
+    {
+        pucTable = pvPortMalloc( OTA_SIG_VERIFY_TABLE_MAX_LEN );
+    }
+
+    if( ( xResult == pdTRUE ) &&
+        ( pucTable != NULL ) &&
+        ( pxLfsCtx != NULL ) )
+    {
+        lfs_file_t xFile = { 0 };
+
+        if( lfs_file_open( pxLfsCtx, &xFile, SIG_TABLE_FILE_NAME, LFS_O_RDONLY ) == LFS_ERR_OK )
+        {
+            lfs_ssize_t xBytesRead = lfs_file_read( pxLfsCtx, &xFile, pucTable, OTA_SIG_VERIFY_TABLE_MAX_LEN );
+
+            ( void ) lfs_file_close( pxLfsCtx, &xFile );
+
+            if( ( xBytesRead > 0 ) &&
+                ( lOtaSigVerifier_ImportTable( &xSigVerifier, pucTable, ( size_t ) xBytesRead ) == 0 ) )
+            {
+                LogInfo( "Loaded the OTA signing key verification table from %s.", SIG_TABLE_FILE_NAME );
+                uxTableLen = ( size_t ) xBytesRead;
+            }
+            else
+            {
+                LogWarn( "Ignoring stale OTA signing key verification table in %s.", SIG_TABLE_FILE_NAME );
+            }
+        }
+    }
+
+    /* Build the table and save it for the next boot */
+    if( ( xResult == pdTRUE ) &&
+        ( uxTableLen == 0 ) )
+    {
+        TickType_t xStartTicks = xTaskGetTickCount();
+
+        if( lOtaSigVerifier_BuildTable( &xSigVerifier ) != 0 )
+        {
+            LogError( "Failed to build the OTA signing key verification table." );
+            vOtaSigVerifier_Free( &xSigVerifier );
+            xResult = pdFALSE;
+        }
+        else
+        {
+            LogInfo( "Built the OTA signing key verification table in %lu ms.",
+                     ( unsigned long ) ( ( xTaskGetTickCount() - xStartTicks ) * portTICK_PERIOD_MS ) );
+        }
+
+        if( ( xResult == pdTRUE ) &&
+            ( pucTable != NULL ) &&
+            ( pxLfsCtx != NULL ) &&
+            ( lOtaSigVerifier_ExportTable( &xSigVerifier, pucTable, OTA_SIG_VERIFY_TABLE_MAX_LEN, &uxTableLen ) == 0 ) )
+        {
+            lfs_file_t xFile = { 0 };
+            lfs_ssize_t xLfsErr = lfs_file_open( pxLfsCtx, &xFile, SIG_TABLE_FILE_NAME, ( LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC ) );
+
+            if( xLfsErr == LFS_ERR_OK )
+            {
+                xLfsErr = lfs_file_write( pxLfsCtx, &xFile, pucTable, uxTableLen );
+
+                if( xLfsErr != ( lfs_ssize_t ) uxTableLen )
+                {
+                    LogError( "Failed to save OTA signing key verification table to file %s, error = %d.", SIG_TABLE_FILE_NAME, xLfsErr );
+                }
+
+                ( void ) lfs_file_close( pxLfsCtx, &xFile );
+            }
+            else
+            {
+                LogError( "Failed to open file %s to save OTA signing key verification table, error = %d.", SIG_TABLE_FILE_NAME, xLfsErr );
+            }
+        }
+    }
+
+    if( pucTable != NULL )
+    {
+        vPortFree( pucTable );
+    }
+
+    return xResult;
+}
+
 static OtaPalStatus_t prvValidateSignature( const char * pcPubKeyLabel,
                                             const unsigned char * pucSignature,
                                             const size_t uxSignatureLength,
@@ -712,9 +981,25 @@ static OtaPalStatus_t prvValidateSignature( const char * pcPubKeyLabel,
     /* Verify the provided signature against the image hash */
     if( OTA_PAL_MAIN_ERR( uxStatus ) == OtaPalSuccess )
     {
-        int lRslt = mbedtls_pk_verify( &xPubKeyCtx, MBEDTLS_MD_SHA256,
+        int lRslt;
+        BaseType_t xUseSigVerifier = prvLoadSigVerifier( &xPubKeyCtx );
+        TickType_t xStartTicks = xTaskGetTickCount();
+
+        if( xUseSigVerifier == pdTRUE )
+        {
+            lRslt = lOtaSigVerifier_Verify( &xSigVerifier,
+                                            pucImageHash, uxHashLength,
+                                            pucSignature, uxSignatureLength );
+        }
+        else
+        {
+            lRslt = mbedtls_pk_verify( &xPubKeyCtx, MBEDTLS_MD_SHA256,
                                        pucImageHash, uxHashLength,
                                        pucSignature, uxSignatureLength );
+        }
+
+        LogInfo( "OTA image signature verification took %lu ms.",
+                 ( unsigned long ) ( ( xTaskGetTickCount() - xStartTicks ) * portTICK_PERIOD_MS ) );
 
         if( lRslt != 0 )
         {
@@ -742,7 +1027,7 @@ OtaPalStatus_t otaPal_CreateFileForRx( OtaFileContext_t * const pxFileContext )
 
     LogInfo( "CreateFileForRx: xPalState: %s", pcPalStateToString( pxContext->xPalState ) );
 
-    if( ( pxFileContext->fileSize > FLASH_BANK_SIZE ) ||
+    if( ( pxFileContext->fileSize > OTA_IMAGE_MAX_SIZE ) ||
         ( pxFileContext->fileSize < OTA_IMAGE_MIN_SIZE ) )
     {
         uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalRxFileTooLarge, 0 );
@@ -789,6 +1074,7 @@ OtaPalStatus_t otaPal_CreateFileForRx( OtaFileContext_t * const pxFileContext )
             pxContext->ulPendingBank = prvGetActiveBank();
             pxContext->ulBaseAddress = FLASH_START_INACTIVE_BANK;
             pxContext->ulImageSize = pxFileContext->fileSize;
+            pxContext->xIsCompressed = pdFALSE;
             pxContext->xPalState = OTA_PAL_FILE_OPEN;
             pxFileContext->pFile = pxContext;
         }
@@ -817,6 +1103,8 @@ int16_t otaPal_WriteBlock( OtaFileContext_t * const pxFileContext,
 
     configASSERT( blockSize < INT16_MAX );
 
+    TRACE_BEGIN( TRACE_ID_OTA_WRITE_BLOCK, offset );
+
     if( ( pxFileContext == NULL ) ||
         ( pxFileContext->pFile != ( uint8_t * ) ( pxContext ) ) )
     {
@@ -838,11 +1126,25 @@ int16_t otaPal_WriteBlock( OtaFileContext_t * const pxFileContext,
     {
         LogError( "pData is NULL." );
     }
+    /* A compressed image is identified by its header. An uncompressed image
+     * starts with the initial stack pointer, which can never match the magic. */
+    else if( ( offset == 0 ) &&
+             xOtaDecompress_IsCompressed( pData, blockSize ) )
+    {
+        pxContext->xIsCompressed = pdTRUE;
+        sBytesWritten = prvWriteCompressedBlock( pxContext, offset, pData, blockSize );
+    }
+    else if( pxContext->xIsCompressed == pdTRUE )
+    {
+        sBytesWritten = prvWriteCompressedBlock( pxContext, offset, pData, blockSize );
+    }
     else if( prvWriteToFlash( ( pxContext->ulBaseAddress + offset ), pData, blockSize ) == HAL_OK )
     {
         sBytesWritten = ( int16_t ) blockSize;
     }
 
+    TRACE_END( TRACE_ID_OTA_WRITE_BLOCK, sBytesWritten );
+
     return sBytesWritten;
 }
 
@@ -851,6 +1153,8 @@ OtaPalStatus_t otaPal_CloseFile( OtaFileContext_t * const pxFileContext )
     OtaPalStatus_t uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
 
     OtaPalContext_t * pxContext = prvGetImageContext();
+    unsigned char pucHash[ MBEDTLS_MD_MAX_SIZE ] = { 0 };
+    size_t uxHashLength = 0;
 
     configASSERT( pxFileContext );
     configASSERT( pxContext );
@@ -860,10 +1164,68 @@ OtaPalStatus_t otaPal_CloseFile( OtaFileContext_t * const pxFileContext )
         ( pxContext->xPalState == OTA_PAL_FILE_OPEN ) )
 
     {
+        if( pxContext->xIsCompressed == pdTRUE )
+        {
+            OtaPalDecompressContext_t * pxDecompCtx = &xDecompressContext;
+            uint32_t ulImageSize = pxDecompCtx->xDecompressCtx.ulImageSize;
+
+            if( pxDecompCtx->ulFlashOffset != ulImageSize )
+            {
+                LogError( "Compressed image is incomplete. Decompressed %lu of %lu bytes.",
+                          pxDecompCtx->ulFlashOffset, ulImageSize );
+                uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
+            }
+            else
+            {
+                uint32_t ulCyclesPerUs = SystemCoreClock / 1000000UL;
+
+                LogInfo( "Compressed image: %lu -> %lu bytes, ratio: %lu%%, blocks: %lu, "
+                         "decompress time avg: %lu us/block, max: %lu us/block.",
+                         pxDecompCtx->ulNextFileOffset, ulImageSize,
+                         ( uint32_t ) ( ( 100ULL * pxDecompCtx->ulNextFileOffset ) / ulImageSize ),
+                         pxDecompCtx->ulBlockCount,
+                         ( uint32_t ) ( pxDecompCtx->ullTotalCycles / pxDecompCtx->ulBlockCount / ulCyclesPerUs ),
+                         pxDecompCtx->ulMaxBlockCycles / ulCyclesPerUs );
+
+                if( mbedtls_sha256_finish( &( pxDecompCtx->xFileHashCtx ), pucHash ) == 0 )
+                {
+                    uxHashLength = 32;
+                }
+            }
+
+            mbedtls_sha256_free( &( pxDecompCtx->xFileHashCtx ) );
+        }
+        else if( xCalculateImageHash( ( const unsigned char * ) pxContext->ulBaseAddress,
+                                      pxContext->ulImageSize,
+                                      pucHash, sizeof( pucHash ),
+                                      &uxHashLength ) != pdTRUE )
+        {
+            uxHashLength = 0;
+        }
+
+        if( ( OTA_PAL_MAIN_ERR( uxOtaStatus ) == OtaPalSuccess ) &&
+            ( uxHashLength == 0 ) )
+        {
+            LogError( "Failed to compute the hash of the received image." );
+            uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalSignatureCheckFailed, 0 );
+        }
+        else if( OTA_PAL_MAIN_ERR( uxOtaStatus ) == OtaPalSuccess )
+        {
+            /* The signature covers the file as received, so a compressed image is checked against the hash of the compressed data */
+            uxOtaStatus = prvValidateSignature( OTA_SIGNING_KEY_LABEL,
+                                                pxFileContext->pSignature->data,
+                                                pxFileContext->pSignature->size,
+                                                pucHash, uxHashLength );
+        }
+
         if( OTA_PAL_MAIN_ERR( uxOtaStatus ) == OtaPalSuccess )
         {
             pxContext->xPalState = OTA_PAL_PENDING_ACTIVATION;
         }
+        else
+        {
+            LogError( "Rejecting the received image, error: 0x%08lx.", ( uint32_t ) uxOtaStatus );
+        }
     }
     else if( pxFileContext == NULL )
     {
@@ -131,6 +131,8 @@ void vInitTask( void * pvArgs )
 
     KVStore_init();
 
+    ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_KVSTORE_READY );
+
     xResult = xTaskCreate( vHeartbeatTask, "Heartbeat", 128, NULL, tskIDLE_PRIORITY, NULL );
     configASSERT( xResult == pdTRUE );
 
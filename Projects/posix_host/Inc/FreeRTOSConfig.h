@@ -0,0 +1,132 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include "logging.h"
+
+/*-----------------------------------------------------------
+* Host configuration for the FreeRTOS POSIX port.
+*
+* Follows Common/config/FreeRTOSConfig.h where the kernel features used by the
+* Common code are concerned. Every task runs on its own POSIX thread and the
+* tick comes from a SIGALRM timer, so the Cortex-M specific settings, the
+* stack overflow check and the run time counter are left out.
+*
+* See http://www.freertos.org/a00110.html
+*----------------------------------------------------------*/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define configUSE_PREEMPTION                       1
+#define configUSE_TIME_SLICING                     1
+#define configSUPPORT_STATIC_ALLOCATION            1
+#define configSUPPORT_DYNAMIC_ALLOCATION           1
+#define configUSE_IDLE_HOOK                        0
+#define configUSE_TICK_HOOK                        0
+#define configUSE_MALLOC_FAILED_HOOK               1
+#define configCPU_CLOCK_HZ                         ( ( unsigned long ) 1000000000 )
+#define configTICK_RATE_HZ                         ( ( TickType_t ) 1000 )
+#define configMAX_PRIORITIES                       ( 56 )
+
+/* Task stacks are handed to pthread_attr_setstack, so keep them above PTHREAD_STACK_MIN (16 KiB) */
+#define configMINIMAL_STACK_SIZE                   ( ( uint16_t ) 4096 )
+#define configMAX_TASK_NAME_LEN                    ( 32 )
+#define configUSE_TRACE_FACILITY                   1
+#define configUSE_16_BIT_TICKS                     0
+#define configUSE_MUTEXES                          1
+#define configQUEUE_REGISTRY_SIZE                  8
+#define configUSE_RECURSIVE_MUTEXES                1
+#define configUSE_COUNTING_SEMAPHORES              1
+#define configENABLE_BACKWARD_COMPATIBILITY        0
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS    5
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION    0
+#define configCHECK_FOR_STACK_OVERFLOW             0
+#define configRECORD_STACK_HIGH_ADDRESS            1
+#define configMESSAGE_BUFFER_LENGTH_TYPE           size_t
+#define configGENERATE_RUN_TIME_STATS              0
+#define configUSE_NEWLIB_REENTRANT                 0
+#define configUSE_CO_ROUTINES                      0
+
+/* Software timer definitions. */
+#define configUSE_TIMERS                           1
+#define configTIMER_TASK_PRIORITY                  ( 24 )
+#define configTIMER_QUEUE_LENGTH                   10
+#define configTIMER_TASK_STACK_DEPTH               ( configMINIMAL_STACK_SIZE * 2 )
+
+/* Task notification array entries */
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES      8
+
+/* Set the following definitions to 1 to include the API function, or zero
+ * to exclude the API function. */
+#define INCLUDE_vTaskPrioritySet                   1
+#define INCLUDE_uxTaskPriorityGet                  1
+#define INCLUDE_vTaskDelete                        1
+#define INCLUDE_vTaskCleanUpResources              1
+#define INCLUDE_vTaskSuspend                       1
+#define INCLUDE_vTaskDelayUntil                    1
+#define INCLUDE_xTaskAbortDelay                    1
+#define INCLUDE_vTaskDelay                         1
+#define INCLUDE_xTaskGetSchedulerState             1
+#define INCLUDE_xTaskResumeFromISR                 0
+#define INCLUDE_xTaskGetHandle                     1
+#define INCLUDE_xTimerPendFunctionCall             1
+#define INCLUDE_xQueueGetMutexHolder               1
+#define INCLUDE_uxTaskGetStackHighWaterMark        1
+#define INCLUDE_xTaskGetCurrentTaskHandle          1
+#define INCLUDE_eTaskGetState                      1
+
+/* Flush the log sink before stopping the process, so the failed assertion is printed */
+#define configASSERT( x )                     \
+    do {                                      \
+        if( ( x ) == 0 ) {                    \
+            vDyingGasp();                     \
+            LogAssert( "Assertion failed." ); \
+            vDyingGasp();                     \
+            abort();                          \
+        }                                     \
+    } while( 0 )
+
+
+#define configASSERT_CONTINUE( x )                      \
+    do {                                                \
+        if( ( x ) == 0 ) {                              \
+            LogAssert( "Non-fatal assertion failed." ); \
+        }                                               \
+    } while( 0 )
+
+/* heap_3 passes allocations to the C library, so heap_4 block tracking is not available */
+#define configHEAP_TRACKING                         0
+
+/* The trace ring time stamps events with the DWT cycle counter */
+#define configTRACE_POINTS                          0
+
+#include "hw_defs.h"
+
+#endif /* FREERTOS_CONFIG_H */
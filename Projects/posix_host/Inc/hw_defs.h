@@ -0,0 +1,90 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#ifndef __HW_DEFS
+#define __HW_DEFS
+
+/*
+ * Host replacement for Common/config/hw_defs.h. Only the HAL types and calls
+ * used by the early and dying gasp log output of logging.c are kept. They are
+ * implemented by Src/cli/log_sink_posix.c, which writes to stdout.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+    GPIO_PIN_RESET = 0U,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct
+{
+    uint32_t ulUnused;
+} GPIO_TypeDef;
+
+typedef struct
+{
+    int lFd;
+} UART_HandleTypeDef;
+
+#define LED_RED_Pin            ( ( uint16_t ) 0x0040 )
+#define LED_RED_GPIO_Port      ( ( GPIO_TypeDef * ) NULL )
+
+#define LED_GREEN_Pin          ( ( uint16_t ) 0x0080 )
+#define LED_GREEN_GPIO_Port    ( ( GPIO_TypeDef * ) NULL )
+
+HAL_StatusTypeDef HAL_UART_Transmit( UART_HandleTypeDef * pxHuart,
+                                     const uint8_t * pucData,
+                                     uint16_t usSize,
+                                     uint32_t ulTimeout );
+
+void HAL_GPIO_WritePin( GPIO_TypeDef * pxPort,
+                        uint16_t usPin,
+                        GPIO_PinState xPinState );
+
+/* The POSIX port does not run code in interrupt context. Defined in Src/sys/sys_posix.c */
+long xPortIsInsideInterrupt( void );
+
+void vDoSystemReset( void );
+
+static inline void vPetWatchdog( void )
+{
+    /* No watchdog on the host */
+}
+
+#endif /* __HW_DEFS */
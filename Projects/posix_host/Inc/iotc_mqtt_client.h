@@ -0,0 +1,52 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#ifndef IOTC_MQTT_CLIENT_H
+#define IOTC_MQTT_CLIENT_H
+
+/*
+ * Host stand-in for the MQTT client header of the IoTConnect SDK submodule.
+ * Holds the broker and client identity that vMQTTAgentTask takes as its
+ * task parameter.
+ */
+
+#include "iotconnect.h"
+
+typedef struct
+{
+    const char * username;
+    char * duid;
+} IotConnectMqttConfig;
+
+typedef struct
+{
+    const char * host;
+    IotConnectMqttConfig * cfg;
+    IotConnectAuthInfo * auth;
+} IotConnectDeviceClientConfig;
+
+#endif /* IOTC_MQTT_CLIENT_H */
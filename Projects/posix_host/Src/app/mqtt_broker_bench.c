@@ -0,0 +1,349 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * MQTT broker benchmark for the host build. The task subscribes to an echo
+ * topic and publishes to it through the MQTT agent, so every message makes a
+ * full trip through mbedtls_transport.c, coreMQTT and the broker.
+ *
+ * Latency phase: one message in flight at a time, timed from the call to
+ * MqttAgent_PublishSync until the echo reaches the subscription callback.
+ *
+ * Throughput phase: messages published back to back, timed until the last
+ * echo arrives.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "event_groups.h"
+
+#include "core_mqtt.h"
+#include "core_mqtt_agent.h"
+#include "mqtt_agent_task.h"
+#include "subscription_manager.h"
+#include "sys_evt.h"
+
+#include "app/mqtt_broker_bench.h"
+#include "cli/log_sink_posix.h"
+
+/* The MQTT agent waits on index MQTT_AGENT_NOTIFY_IDX in the calling task */
+#define BENCH_NOTIFY_IDX              ( 1U )
+
+#define BENCH_CONNECT_TIMEOUT_MS      ( 60 * 1000U )
+#define BENCH_PUBLISH_TIMEOUT_MS      ( 10 * 1000U )
+#define BENCH_ECHO_TIMEOUT_MS         ( 10 * 1000U )
+#define BENCH_TOPIC_MAX_LEN           ( 128U )
+
+typedef struct
+{
+    TaskHandle_t xTaskHandle;
+    volatile uint32_t ulEchoCount;
+    volatile uint32_t ulNotifyAt; /*!< Echo count at which the task is notified */
+    volatile size_t uxEchoBytes;
+} BenchCtx_t;
+
+static char pcEchoTopic[ BENCH_TOPIC_MAX_LEN ];
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000ULL ) + ( ( uint64_t ) xNow.tv_nsec / 1000ULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvCompareU32( const void * pvA,
+                          const void * pvB )
+{
+    uint32_t ulA = *( const uint32_t * ) pvA;
+    uint32_t ulB = *( const uint32_t * ) pvB;
+
+    return ( ulA > ulB ) - ( ulA < ulB );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Runs in the MQTT agent task */
+static void prvEchoCallback( void * pvCtx,
+                             MQTTPublishInfo_t * pxPublishInfo )
+{
+    BenchCtx_t * pxCtx = ( BenchCtx_t * ) pvCtx;
+
+    pxCtx->ulEchoCount++;
+    pxCtx->uxEchoBytes += pxPublishInfo->payloadLength;
+
+    if( pxCtx->ulEchoCount == pxCtx->ulNotifyAt )
+    {
+        ( void ) xTaskNotifyGiveIndexed( pxCtx->xTaskHandle, BENCH_NOTIFY_IDX );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t prvPublish( MQTTAgentHandle_t xHandle,
+                                const MqttBrokerBenchConfig_t * pxCfg,
+                                uint8_t * pucPayload,
+                                uint32_t ulSeq )
+{
+    MQTTPublishInfo_t xPublishInfo = { 0 };
+
+    /* The sequence number makes every payload distinct */
+    ( void ) memcpy( pucPayload, &ulSeq, sizeof( ulSeq ) );
+
+    xPublishInfo.qos = pxCfg->xQoS;
+    xPublishInfo.pTopicName = pcEchoTopic;
+    xPublishInfo.topicNameLength = ( uint16_t ) strlen( pcEchoTopic );
+    xPublishInfo.pPayload = pucPayload;
+    xPublishInfo.payloadLength = pxCfg->uxPayloadLen;
+
+    return MqttAgent_PublishSync( xHandle, &xPublishInfo, BENCH_PUBLISH_TIMEOUT_MS );
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvRunLatency( MQTTAgentHandle_t xHandle,
+                                 const MqttBrokerBenchConfig_t * pxCfg,
+                                 BenchCtx_t * pxCtx,
+                                 uint8_t * pucPayload )
+{
+    BaseType_t xResult = pdTRUE;
+    uint32_t * pulLatencyUs = pvPortMalloc( pxCfg->ulLatencyCount * sizeof( uint32_t ) );
+    uint64_t ullTotalUs = 0;
+    uint32_t ulDone = 0;
+
+    if( pulLatencyUs == NULL )
+    {
+        LogError( "Failed to allocate the latency samples." );
+        xResult = pdFALSE;
+    }
+
+    while( ( xResult == pdTRUE ) && ( ulDone < pxCfg->ulLatencyCount ) )
+    {
+        uint64_t ullStartUs;
+
+        ( void ) ulTaskNotifyValueClearIndexed( NULL, BENCH_NOTIFY_IDX, 0xFFFFFFFF );
+        pxCtx->ulNotifyAt = pxCtx->ulEchoCount + 1;
+
+        ullStartUs = prvNowUs();
+
+        if( prvPublish( xHandle, pxCfg, pucPayload, ulDone ) != MQTTSuccess )
+        {
+            xResult = pdFALSE;
+        }
+        else if( ulTaskNotifyTakeIndexed( BENCH_NOTIFY_IDX, pdTRUE, pdMS_TO_TICKS( BENCH_ECHO_TIMEOUT_MS ) ) == 0 )
+        {
+            LogError( "No echo received for message %lu.", ( unsigned long ) ulDone );
+            xResult = pdFALSE;
+        }
+        else
+        {
+            pulLatencyUs[ ulDone ] = ( uint32_t ) ( prvNowUs() - ullStartUs );
+            ullTotalUs += pulLatencyUs[ ulDone ];
+            ulDone++;
+        }
+    }
+
+    if( ( xResult == pdTRUE ) && ( ulDone > 0 ) )
+    {
+        qsort( pulLatencyUs, ulDone, sizeof( uint32_t ), prvCompareU32 );
+
+        LogSys( "Latency, %lu round trips of %lu bytes at QoS %d: avg %lu us, p50 %lu us, p99 %lu us, max %lu us.",
+                ( unsigned long ) ulDone,
+                ( unsigned long ) pxCfg->uxPayloadLen,
+                ( int ) pxCfg->xQoS,
+                ( unsigned long ) ( ullTotalUs / ulDone ),
+                ( unsigned long ) pulLatencyUs[ ulDone / 2 ],
+                ( unsigned long ) pulLatencyUs[ ( ( uint64_t ) ulDone * 99 ) / 100 ],
+                ( unsigned long ) pulLatencyUs[ ulDone - 1 ] );
+    }
+
+    if( pulLatencyUs != NULL )
+    {
+        vPortFree( pulLatencyUs );
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvRunThroughput( MQTTAgentHandle_t xHandle,
+                                    const MqttBrokerBenchConfig_t * pxCfg,
+                                    BenchCtx_t * pxCtx,
+                                    uint8_t * pucPayload )
+{
+    BaseType_t xResult = pdTRUE;
+    uint32_t ulFirstEcho = pxCtx->ulEchoCount;
+    size_t uxFirstBytes = pxCtx->uxEchoBytes;
+    uint32_t ulSent = 0;
+    uint32_t ulEchoed;
+    uint64_t ullStartUs;
+    uint64_t ullPublishedUs;
+    uint64_t ullEndUs;
+
+    ( void ) ulTaskNotifyValueClearIndexed( NULL, BENCH_NOTIFY_IDX, 0xFFFFFFFF );
+    pxCtx->ulNotifyAt = ulFirstEcho + pxCfg->ulThroughputCount;
+
+    ullStartUs = prvNowUs();
+
+    while( ( xResult == pdTRUE ) && ( ulSent < pxCfg->ulThroughputCount ) )
+    {
+        if( prvPublish( xHandle, pxCfg, pucPayload, ulSent ) == MQTTSuccess )
+        {
+            ulSent++;
+        }
+        else
+        {
+            xResult = pdFALSE;
+        }
+    }
+
+    ullPublishedUs = prvNowUs();
+
+    if( ( xResult == pdTRUE ) &&
+        ( ulTaskNotifyTakeIndexed( BENCH_NOTIFY_IDX, pdTRUE, pdMS_TO_TICKS( BENCH_ECHO_TIMEOUT_MS ) ) == 0 ) )
+    {
+        xResult = pdFALSE;
+    }
+
+    ullEndUs = prvNowUs();
+    ulEchoed = pxCtx->ulEchoCount - ulFirstEcho;
+
+    if( ulEchoed != ulSent )
+    {
+        LogError( "%lu of %lu messages were echoed.", ( unsigned long ) ulEchoed, ( unsigned long ) ulSent );
+        xResult = pdFALSE;
+    }
+
+    if( ( ulSent > 0 ) &&
+        ( ullPublishedUs > ullStartUs ) &&
+        ( ullEndUs > ullStartUs ) )
+    {
+        LogSys( "Throughput, %lu messages of %lu bytes at QoS %d: published %lu msg/s, echoed %lu msg/s, %lu bytes/s.",
+                ( unsigned long ) ulSent,
+                ( unsigned long ) pxCfg->uxPayloadLen,
+                ( int ) pxCfg->xQoS,
+                ( unsigned long ) ( ( ( uint64_t ) ulSent * 1000000ULL ) / ( ullPublishedUs - ullStartUs ) ),
+                ( unsigned long ) ( ( ( uint64_t ) ulEchoed * 1000000ULL ) / ( ullEndUs - ullStartUs ) ),
+                ( unsigned long ) ( ( ( uint64_t ) ( pxCtx->uxEchoBytes - uxFirstBytes ) * 1000000ULL ) / ( ullEndUs - ullStartUs ) ) );
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+void vMqttBrokerBenchTask( void * pvParameters )
+{
+    const MqttBrokerBenchConfig_t * pxCfg = ( const MqttBrokerBenchConfig_t * ) pvParameters;
+    static BenchCtx_t xCtx = { 0 };
+    MQTTAgentHandle_t xHandle = NULL;
+    uint8_t * pucPayload = NULL;
+    BaseType_t xResult = pdTRUE;
+    EventBits_t uxEvents;
+
+    configASSERT( pxCfg != NULL );
+    configASSERT( pxCfg->uxPayloadLen >= sizeof( uint32_t ) );
+    configASSERT( pxCfg->uxPayloadLen <= MQTT_BROKER_BENCH_MAX_PAYLOAD );
+
+    xCtx.xTaskHandle = xTaskGetCurrentTaskHandle();
+
+    uxEvents = xEventGroupWaitBits( xSystemEvents,
+                                    EVT_MASK_MQTT_CONNECTED,
+                                    pdFALSE,
+                                    pdTRUE,
+                                    pdMS_TO_TICKS( BENCH_CONNECT_TIMEOUT_MS ) );
+
+    if( ( uxEvents & EVT_MASK_MQTT_CONNECTED ) == 0 )
+    {
+        LogError( "Timed out waiting for the MQTT agent to connect." );
+        xResult = pdFALSE;
+    }
+    else
+    {
+        xHandle = xGetMqttAgentHandle();
+        configASSERT( xHandle != NULL );
+
+        ( void ) snprintf( pcEchoTopic, sizeof( pcEchoTopic ), "bench/%s/echo", pxCfg->pcClientId );
+    }
+
+    if( xResult == pdTRUE )
+    {
+        pucPayload = pvPortMalloc( pxCfg->uxPayloadLen );
+
+        if( pucPayload == NULL )
+        {
+            LogError( "Failed to allocate a %lu byte payload.", ( unsigned long ) pxCfg->uxPayloadLen );
+            xResult = pdFALSE;
+        }
+        else
+        {
+            ( void ) memset( pucPayload, 'b', pxCfg->uxPayloadLen );
+        }
+    }
+
+    if( ( xResult == pdTRUE ) &&
+        ( MqttAgent_SubscribeSync( xHandle, pcEchoTopic, pxCfg->xQoS, prvEchoCallback, &xCtx ) != MQTTSuccess ) )
+    {
+        LogError( "Failed to subscribe to %s.", pcEchoTopic );
+        xResult = pdFALSE;
+    }
+
+    if( xResult == pdTRUE )
+    {
+        LogInfo( "Subscribed to %s.", pcEchoTopic );
+        xResult = prvRunLatency( xHandle, pxCfg, &xCtx, pucPayload );
+    }
+
+    if( xResult == pdTRUE )
+    {
+        xResult = prvRunThroughput( xHandle, pxCfg, &xCtx, pucPayload );
+    }
+
+    if( xResult != pdTRUE )
+    {
+        LogError( "MQTT broker benchmark failed." );
+    }
+
+    vLogSinkFlush( pdMS_TO_TICKS( 1000 ) );
+
+    exit( ( xResult == pdTRUE ) ? EXIT_SUCCESS : EXIT_FAILURE );
+}
@@ -0,0 +1,55 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#ifndef MQTT_BROKER_BENCH_H
+#define MQTT_BROKER_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core_mqtt.h"
+
+/* Largest payload that fits in the agent network buffer with the topic and header */
+#define MQTT_BROKER_BENCH_MAX_PAYLOAD    ( 4096U )
+
+typedef struct
+{
+    const char * pcClientId;    /*!< Used to build the echo topic "bench/<client id>/echo" */
+    uint32_t ulLatencyCount;    /*!< Round trips timed one at a time */
+    uint32_t ulThroughputCount; /*!< Messages published back to back */
+    size_t uxPayloadLen;        /*!< Payload of every message, 4 to MQTT_BROKER_BENCH_MAX_PAYLOAD bytes */
+    MQTTQoS_t xQoS;             /*!< QoS of the publishes and of the echo subscription */
+} MqttBrokerBenchConfig_t;
+
+/*
+ * Measures round trip latency and throughput through the MQTT agent against
+ * the broker it is connected to, then exits the process with a non-zero
+ * status if a publish failed or an echo was lost.
+ */
+void vMqttBrokerBenchTask( void * pvParameters );
+
+#endif /* MQTT_BROKER_BENCH_H */
@@ -0,0 +1,447 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Entry point of the host build. Brings up the Common MQTT stack on the
+ * FreeRTOS POSIX port in the order the ntz app_main.c does, with the network
+ * already up, then runs the MQTT broker benchmark and optionally the OTA task.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "event_groups.h"
+
+#include "sys_evt.h"
+#include "kvstore.h"
+#include "hw_defs.h"
+
+#include "lfs.h"
+#include "fs/lfs_port.h"
+
+#include "iotc_mqtt_client.h"
+#include "ota_pal.h"
+#include "app/mqtt_broker_bench.h"
+#include "cli/log_sink_posix.h"
+
+#define APP_MQTT_AGENT_STACK_DEPTH    ( 8192U )
+#define APP_BENCH_STACK_DEPTH         ( 4096U )
+#define APP_OTA_STACK_DEPTH           ( 8192U )
+
+typedef struct
+{
+    const char * pcFsImagePath;
+    const char * pcSigningKeyPath;
+    BaseType_t xRunOta;
+} AppConfig_t;
+
+static AppConfig_t xAppConfig =
+{
+    .pcFsImagePath    = "posix_host_fs.img",
+    .pcSigningKeyPath = NULL,
+    .xRunOta          = pdFALSE,
+};
+
+static IotConnectAuthInfo xAuthInfo;
+
+static IotConnectMqttConfig xMqttConfig =
+{
+    .username = NULL,
+    .duid     = "posix-host",
+};
+
+static IotConnectDeviceClientConfig xClientConfig =
+{
+    .host = "localhost",
+    .cfg  = &xMqttConfig,
+    .auth = &xAuthInfo,
+};
+
+static MqttBrokerBenchConfig_t xBenchConfig =
+{
+    .pcClientId        = "posix-host",
+    .ulLatencyCount    = 100,
+    .ulThroughputCount = 1000,
+    .uxPayloadLen      = 256,
+    .xQoS              = MQTTQoS0,
+};
+
+static lfs_t * pxLfsCtx = NULL;
+
+EventGroupHandle_t xSystemEvents = NULL;
+
+extern void vMQTTAgentTask( void * );
+extern void vOTAUpdateTask( void * pvParam );
+
+/*-----------------------------------------------------------*/
+
+lfs_t * pxGetDefaultFsCtx( void )
+{
+    while( pxLfsCtx == NULL )
+    {
+        LogDebug( "Waiting for FS Initialization." );
+        /* Wait for FS to be initialized */
+        vTaskDelay( 1000 );
+    }
+
+    return pxLfsCtx;
+}
+
+/*-----------------------------------------------------------*/
+
+static int fs_init( void )
+{
+    static lfs_t xLfsCtx = { 0 };
+
+    struct lfs_info xDirInfo = { 0 };
+
+    const struct lfs_config * pxCfg = pxInitializeFileFs( xAppConfig.pcFsImagePath, pdMS_TO_TICKS( 30 * 1000 ) );
+
+    /* mount the filesystem */
+    int err = lfs_mount( &xLfsCtx, pxCfg );
+
+    /* format if we can't mount the filesystem
+     * this should only happen on the first run with a new image file
+     */
+    if( err != LFS_ERR_OK )
+    {
+        LogError( "Failed to mount %s. Formatting...", xAppConfig.pcFsImagePath );
+        err = lfs_format( &xLfsCtx, pxCfg );
+
+        if( err == 0 )
+        {
+            err = lfs_mount( &xLfsCtx, pxCfg );
+        }
+
+        if( err != LFS_ERR_OK )
+        {
+            LogError( "Failed to format littlefs device." );
+        }
+    }
+
+    if( ( err == LFS_ERR_OK ) &&
+        ( lfs_stat( &xLfsCtx, "/cfg", &xDirInfo ) == LFS_ERR_NOENT ) )
+    {
+        err = lfs_mkdir( &xLfsCtx, "/cfg" );
+
+        if( err != LFS_ERR_OK )
+        {
+            LogError( "Failed to create /cfg directory." );
+        }
+    }
+
+    if( err == 0 )
+    {
+        /* Export the FS context */
+        pxLfsCtx = &xLfsCtx;
+    }
+
+    return err;
+}
+
+/*-----------------------------------------------------------*/
+
+static void vInitTask( void * pvArgs )
+{
+    BaseType_t xResult = pdTRUE;
+
+    ( void ) pvArgs;
+
+    if( fs_init() == LFS_ERR_OK )
+    {
+        LogInfo( "File System mounted." );
+    }
+    else
+    {
+        LogError( "Failed to mount filesystem." );
+        xResult = pdFALSE;
+    }
+
+    ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_FS_READY );
+
+    if( xResult == pdTRUE )
+    {
+        KVStore_init();
+
+        /* The OTA task subscribes to the job topics of the thing name */
+        if( ( xAppConfig.xRunOta == pdTRUE ) &&
+            ( ( KVStore_setString( CS_CORE_THING_NAME, xMqttConfig.duid ) != pdTRUE ) ||
+              ( KVStore_xCommitChanges() != pdTRUE ) ) )
+        {
+            LogError( "Failed to store the thing name." );
+            xResult = pdFALSE;
+        }
+    }
+
+    ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_KVSTORE_READY );
+
+    if( xResult == pdTRUE )
+    {
+        xResult = xTaskCreate( vMQTTAgentTask, "MQTTAgent", APP_MQTT_AGENT_STACK_DEPTH, &xClientConfig, 10, NULL );
+    }
+
+    if( xResult == pdTRUE )
+    {
+        xResult = xTaskCreate( vMqttBrokerBenchTask, "MqttBench", APP_BENCH_STACK_DEPTH, &xBenchConfig, 5, NULL );
+    }
+
+    if( ( xResult == pdTRUE ) &&
+        ( xAppConfig.xRunOta == pdTRUE ) )
+    {
+        xResult = xTaskCreate( vOTAUpdateTask, "OTAUpdate", APP_OTA_STACK_DEPTH, NULL, tskIDLE_PRIORITY + 1, NULL );
+    }
+
+    if( xResult != pdTRUE )
+    {
+        LogError( "Failed to start the application." );
+        vLogSinkFlush( pdMS_TO_TICKS( 1000 ) );
+        exit( EXIT_FAILURE );
+    }
+
+    while( 1 )
+    {
+        vTaskSuspend( NULL );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Reads a PEM file into a NUL terminated buffer, which mbedtls needs to parse PEM */
+static BaseType_t prvReadPemFile( const char * pcPath,
+                                  PkiObject_t * pxObject )
+{
+    BaseType_t xResult = pdFALSE;
+    FILE * pxFile = fopen( pcPath, "rb" );
+    long lLen = -1;
+
+    if( ( pxFile != NULL ) &&
+        ( fseek( pxFile, 0, SEEK_END ) == 0 ) )
+    {
+        lLen = ftell( pxFile );
+    }
+
+    if( ( lLen > 0 ) &&
+        ( fseek( pxFile, 0, SEEK_SET ) == 0 ) )
+    {
+        unsigned char * pucBuffer = malloc( ( size_t ) lLen + 1 );
+
+        if( ( pucBuffer != NULL ) &&
+            ( fread( pucBuffer, 1, ( size_t ) lLen, pxFile ) == ( size_t ) lLen ) )
+        {
+            PkiObject_t xObject = PKI_OBJ_PEM( pucBuffer, ( size_t ) lLen + 1 );
+
+            pucBuffer[ lLen ] = '\0';
+            *pxObject = xObject;
+            xResult = pdTRUE;
+        }
+        else
+        {
+            free( pucBuffer );
+        }
+    }
+
+    if( pxFile != NULL )
+    {
+        ( void ) fclose( pxFile );
+    }
+
+    if( xResult != pdTRUE )
+    {
+        fprintf( stderr, "Failed to read %s.\n", pcPath );
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvUsage( const char * pcProgram )
+{
+    fprintf( stderr,
+             "Usage: %s -a <CA cert> -c <client cert> -k <client key> [options]\n"
+             "  -h <host>       Broker host name, port 8883 (default localhost)\n"
+             "  -i <client id>  MQTT client identifier and OTA thing name (default posix-host)\n"
+             "  -u <user name>  MQTT user name (default none)\n"
+             "  -f <image>      littlefs image file (default posix_host_fs.img)\n"
+             "  -n <count>      Latency round trips (default 100)\n"
+             "  -m <count>      Throughput messages (default 1000)\n"
+             "  -s <bytes>      Payload size, 4 to %u (default 256)\n"
+             "  -q <qos>        QoS 0 or 1 (default 0)\n"
+             "  -o              Also run the OTA update task\n"
+             "  -p <key>        OTA signing public key, PEM\n",
+             pcProgram, MQTT_BROKER_BENCH_MAX_PAYLOAD );
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvParseArgs( int argc,
+                                char ** argv )
+{
+    BaseType_t xResult = pdTRUE;
+    BaseType_t xHaveCa = pdFALSE;
+    BaseType_t xHaveCert = pdFALSE;
+    BaseType_t xHaveKey = pdFALSE;
+    PkiObject_t xSigningKey;
+    unsigned long ulValue;
+    int lOpt;
+
+    while( ( xResult == pdTRUE ) &&
+           ( ( lOpt = getopt( argc, argv, "a:c:k:h:i:u:f:n:m:s:q:op:" ) ) != -1 ) )
+    {
+        switch( lOpt )
+        {
+            case 'a':
+                xHaveCa = prvReadPemFile( optarg, &( xAuthInfo.mqtt_root_ca ) );
+                xResult = xHaveCa;
+                break;
+
+            case 'c':
+                xHaveCert = prvReadPemFile( optarg, &( xAuthInfo.data.cert_info.device_cert ) );
+                xResult = xHaveCert;
+                break;
+
+            case 'k':
+                xHaveKey = prvReadPemFile( optarg, &( xAuthInfo.data.cert_info.device_key ) );
+                xResult = xHaveKey;
+                break;
+
+            case 'h':
+                xClientConfig.host = optarg;
+                break;
+
+            case 'i':
+                xMqttConfig.duid = optarg;
+                xBenchConfig.pcClientId = optarg;
+                break;
+
+            case 'u':
+                xMqttConfig.username = optarg;
+                break;
+
+            case 'f':
+                xAppConfig.pcFsImagePath = optarg;
+                break;
+
+            case 'n':
+                ulValue = strtoul( optarg, NULL, 0 );
+                xResult = ( ulValue > 0 ) && ( ulValue <= UINT32_MAX );
+                xBenchConfig.ulLatencyCount = ( uint32_t ) ulValue;
+                break;
+
+            case 'm':
+                ulValue = strtoul( optarg, NULL, 0 );
+                xResult = ( ulValue > 0 ) && ( ulValue <= UINT32_MAX );
+                xBenchConfig.ulThroughputCount = ( uint32_t ) ulValue;
+                break;
+
+            case 's':
+                ulValue = strtoul( optarg, NULL, 0 );
+                xResult = ( ulValue >= sizeof( uint32_t ) ) && ( ulValue <= MQTT_BROKER_BENCH_MAX_PAYLOAD );
+                xBenchConfig.uxPayloadLen = ( size_t ) ulValue;
+                break;
+
+            case 'q':
+                ulValue = strtoul( optarg, NULL, 0 );
+                xResult = ( ulValue <= 1 );
+                xBenchConfig.xQoS = ( MQTTQoS_t ) ulValue;
+                break;
+
+            case 'o':
+                xAppConfig.xRunOta = pdTRUE;
+                break;
+
+            case 'p':
+                xResult = prvReadPemFile( optarg, &xSigningKey );
+
+                if( xResult == pdTRUE )
+                {
+                    otaPal_SetSigningKey( &xSigningKey );
+                }
+
+                break;
+
+            default:
+                xResult = pdFALSE;
+                break;
+        }
+    }
+
+    if( ( xResult == pdTRUE ) &&
+        ( ( xHaveCa != pdTRUE ) || ( xHaveCert != pdTRUE ) || ( xHaveKey != pdTRUE ) ) )
+    {
+        xResult = pdFALSE;
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    BaseType_t xResult;
+
+    if( prvParseArgs( argc, argv ) != pdTRUE )
+    {
+        prvUsage( argv[ 0 ] );
+        return EXIT_FAILURE;
+    }
+
+    vInitLoggingEarly();
+
+    vLoggingInit();
+
+    LogInfo( "Host Init Complete." );
+
+    xSystemEvents = xEventGroupCreate();
+    configASSERT( xSystemEvents != NULL );
+
+    /* The host network is up before the scheduler starts */
+    ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_NET_INIT | EVT_MASK_NET_CONNECTED );
+
+    xResult = xTaskCreate( vLogSinkTask, "LogSink", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, NULL );
+    configASSERT( xResult == pdTRUE );
+
+    xResult = xTaskCreate( vInitTask, "Init", configMINIMAL_STACK_SIZE, NULL, 8, NULL );
+    configASSERT( xResult == pdTRUE );
+
+    /* Start scheduler */
+    vTaskStartScheduler();
+
+    LogError( "Kernel start returned." );
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,54 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file FreeRTOSConfig.h
+ * @brief Minimal kernel configuration for the host benchmarks that link parts of the kernel, such as heap_replay.c.
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <assert.h>
+
+#define configUSE_PREEMPTION                       1
+#define configUSE_IDLE_HOOK                        0
+#define configUSE_TICK_HOOK                        0
+#define configUSE_16_BIT_TICKS                     0
+#define configUSE_CO_ROUTINES                      0
+#define configTICK_RATE_HZ                         ( 1000 )
+#define configMAX_PRIORITIES                       ( 8 )
+#define configMINIMAL_STACK_SIZE                   ( 128 )
+#define configMAX_TASK_NAME_LEN                    ( 16 )
+
+#define configSUPPORT_DYNAMIC_ALLOCATION           1
+#define configSUPPORT_STATIC_ALLOCATION            0
+#define configUSE_MALLOC_FAILED_HOOK               0
+
+/* Same heap size as the target, see Common/config/FreeRTOSConfig.h */
+#ifndef configTOTAL_HEAP_SIZE
+#define configTOTAL_HEAP_SIZE                      ( ( size_t ) 300 * 1024 )
+#endif
+
+#define configASSERT( x )    assert( x )
+
+#endif /* FREERTOS_CONFIG_H */
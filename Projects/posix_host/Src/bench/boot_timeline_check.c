@@ -0,0 +1,220 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/*
+ * Host check of the boot stage timeline analysis in boot_timeline.c. Stage
+ * times are simulated for the graph run by vInitTask in the ntz project, taken
+ * from app_boot_graph.h, each stage starting as soon as its dependencies ended,
+ * then the dependency order and the critical path found for them are checked.
+ *
+ * See the README in Projects/posix_host for build instructions.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "app/boot_timeline.h"
+#include "app_boot_graph.h"
+
+/* The stage graph of the ntz project, the stage functions are not referenced */
+#define CHECK_GRAPH_ENTRY( xId, pcName, xFunction, ulDependsOn, uxStackDepth, uxPriority ) \
+    [ xId ] = { pcName, ulDependsOn, BOOT_STAGE_PENDING, 0, 0 },
+
+static const BootTimelineEntry_t xGraph[ APP_STAGE_MAX ] =
+{
+    APP_BOOT_STAGE_TABLE( CHECK_GRAPH_ENTRY )
+};
+
+static int lFailures = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvCheck( int lCondition,
+                      const char * pcWhat )
+{
+    printf( "%-60s %s\n", pcWhat, lCondition ? "ok" : "FAILED" );
+
+    if( !lCondition )
+    {
+        lFailures++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Start every stage when its last dependency ends, with as many tasks as stages */
+static void prvSimulate( BootTimelineEntry_t * pxEntries,
+                         const uint32_t * pulDurationMs )
+{
+    uint32_t ulEndedMask = 0;
+
+    ( void ) memcpy( pxEntries, xGraph, sizeof( xGraph ) );
+
+    while( ulEndedMask != ( BOOT_STAGE_DEP( APP_STAGE_MAX ) - 1UL ) )
+    {
+        for( size_t i = 0; i < APP_STAGE_MAX; i++ )
+        {
+            if( ( ( ulEndedMask & BOOT_STAGE_DEP( i ) ) == 0 ) &&
+                ( ( pxEntries[ i ].ulDependsOn & ~ulEndedMask ) == 0 ) )
+            {
+                uint32_t ulStartMs = 0;
+
+                for( size_t j = 0; j < APP_STAGE_MAX; j++ )
+                {
+                    if( ( ( pxEntries[ i ].ulDependsOn & BOOT_STAGE_DEP( j ) ) != 0 ) &&
+                        ( pxEntries[ j ].ulEndMs > ulStartMs ) )
+                    {
+                        ulStartMs = pxEntries[ j ].ulEndMs;
+                    }
+                }
+
+                pxEntries[ i ].ulStartMs = ulStartMs;
+                pxEntries[ i ].ulEndMs = ulStartMs + pulDurationMs[ i ];
+                pxEntries[ i ].xState = BOOT_STAGE_DONE;
+                ulEndedMask |= BOOT_STAGE_DEP( i );
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvPathIs( const BootTimelineEntry_t * pxEntries,
+                      const AppBootStage_t * pxExpected,
+                      size_t uxExpectedLen )
+{
+    uint8_t pucPath[ BOOT_TIMELINE_MAX_STAGES ];
+    size_t uxPathLen = uxBootTimelineCriticalPath( pxEntries, APP_STAGE_MAX, pucPath, BOOT_TIMELINE_MAX_STAGES );
+    int lMatch = ( uxPathLen == uxExpectedLen );
+
+    printf( "  path:" );
+
+    for( size_t i = 0; i < uxPathLen; i++ )
+    {
+        printf( " %s", pxEntries[ pucPath[ i ] ].pcName );
+        lMatch = lMatch && ( i < uxExpectedLen ) && ( pucPath[ i ] == ( uint8_t ) pxExpected[ i ] );
+    }
+
+    printf( "\n" );
+
+    return lMatch;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    BootTimelineEntry_t xEntries[ APP_STAGE_MAX ];
+    uint32_t pulDurationMs[ APP_STAGE_MAX ] = { 0 };
+    uint32_t ulSequentialMs = 0;
+
+    /* Graph validation */
+    ( void ) memcpy( xEntries, xGraph, sizeof( xGraph ) );
+    prvCheck( xBootTimelineValidate( xEntries, APP_STAGE_MAX ), "boot graph is valid" );
+
+    xEntries[ APP_STAGE_FS ].ulDependsOn = BOOT_STAGE_DEP( APP_STAGE_APP );
+    prvCheck( !xBootTimelineValidate( xEntries, APP_STAGE_MAX ), "cycle through fs and app is rejected" );
+
+    xEntries[ APP_STAGE_FS ].ulDependsOn = BOOT_STAGE_DEP( APP_STAGE_FS );
+    prvCheck( !xBootTimelineValidate( xEntries, APP_STAGE_MAX ), "stage depending on itself is rejected" );
+
+    xEntries[ APP_STAGE_FS ].ulDependsOn = BOOT_STAGE_DEP( APP_STAGE_MAX );
+    prvCheck( !xBootTimelineValidate( xEntries, APP_STAGE_MAX ), "dependency on a missing stage is rejected" );
+
+    /* Mount dominates, loading the key value store follows it */
+    pulDurationMs[ APP_STAGE_FS ] = 350;
+    pulDurationMs[ APP_STAGE_KVSTORE ] = 40;
+    pulDurationMs[ APP_STAGE_NET ] = 2;
+    pulDurationMs[ APP_STAGE_SENSORS ] = 2;
+    pulDurationMs[ APP_STAGE_APP ] = 3;
+
+    #ifdef IOTCONFIG_ENABLE_OTA
+        pulDurationMs[ APP_STAGE_OTA ] = 120;
+    #endif
+
+    for( size_t i = 0; i < APP_STAGE_MAX; i++ )
+    {
+        ulSequentialMs += pulDurationMs[ i ];
+    }
+
+    prvSimulate( xEntries, pulDurationMs );
+    prvCheck( xBootTimelineCheckOrder( xEntries, APP_STAGE_MAX ), "stages start after their dependencies" );
+    prvCheck( xEntries[ APP_STAGE_NET ].ulStartMs == 0, "network starts without waiting for the filesystem" );
+    prvCheck( xEntries[ APP_STAGE_APP ].ulEndMs < ulSequentialMs, "boot ends before a sequential boot would" );
+
+    #ifdef IOTCONFIG_ENABLE_OTA
+        prvCheck( xEntries[ APP_STAGE_OTA ].ulStartMs == 0, "OTA starts without waiting for the filesystem" );
+    #endif
+
+    {
+        static const AppBootStage_t xExpected[] = { APP_STAGE_FS, APP_STAGE_KVSTORE, APP_STAGE_APP };
+        prvCheck( prvPathIs( xEntries, xExpected, 3 ), "critical path is fs, kvstore, app" );
+    }
+
+    #ifdef IOTCONFIG_ENABLE_OTA
+        /* An OTA PAL early init outlasting the mount and the key value store moves the critical path */
+        pulDurationMs[ APP_STAGE_OTA ] = 500;
+        prvSimulate( xEntries, pulDurationMs );
+
+        {
+            static const AppBootStage_t xExpected[] = { APP_STAGE_OTA, APP_STAGE_APP };
+            prvCheck( prvPathIs( xEntries, xExpected, 2 ), "critical path follows the slower dependency" );
+        }
+
+        pulDurationMs[ APP_STAGE_OTA ] = 120;
+    #endif /* IOTCONFIG_ENABLE_OTA */
+
+    /* A stage without dependencies that ends last is the whole path */
+    pulDurationMs[ APP_STAGE_SENSORS ] = 5000;
+    prvSimulate( xEntries, pulDurationMs );
+
+    {
+        static const AppBootStage_t xExpected[] = { APP_STAGE_SENSORS };
+        prvCheck( prvPathIs( xEntries, xExpected, 1 ), "critical path is a single independent stage" );
+    }
+
+    /* Failed stages count, stages that have not ended do not */
+    pulDurationMs[ APP_STAGE_SENSORS ] = 2;
+    prvSimulate( xEntries, pulDurationMs );
+    xEntries[ APP_STAGE_KVSTORE ].xState = BOOT_STAGE_FAILED;
+    xEntries[ APP_STAGE_APP ].xState = BOOT_STAGE_RUNNING;
+
+    {
+        static const AppBootStage_t xExpected[] = { APP_STAGE_FS, APP_STAGE_KVSTORE };
+        prvCheck( prvPathIs( xEntries, xExpected, 2 ), "critical path ends at the last stage to end" );
+    }
+
+    /* A stage started before its dependency ended is reported */
+    prvSimulate( xEntries, pulDurationMs );
+    xEntries[ APP_STAGE_APP ].ulStartMs = xEntries[ APP_STAGE_KVSTORE ].ulEndMs - 1;
+    prvCheck( !xBootTimelineCheckOrder( xEntries, APP_STAGE_MAX ), "out of order start is detected" );
+
+    printf( "%d check(s) failed\n", lFailures );
+
+    return ( lFailures == 0 ) ? 0 : 1;
+}
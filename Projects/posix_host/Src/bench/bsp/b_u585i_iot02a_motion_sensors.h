@@ -0,0 +1,70 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file b_u585i_iot02a_motion_sensors.h
+ * @brief Host stand-in for the B-U585I-IOT02A motion sensor BSP, with the types and
+ * calls used by sensor_telemetry.h and motion_sampler.c. The functions are
+ * provided by the host program that includes it.
+ */
+
+#ifndef B_U585I_IOT02A_MOTION_SENSORS_H
+#define B_U585I_IOT02A_MOTION_SENSORS_H
+
+#include <stdint.h>
+
+#define BSP_ERROR_NONE                 ( 0 )
+#define BSP_ERROR_COMPONENT_FAILURE    ( -5 )
+
+#define MOTION_INSTANCES_NBR           ( 1U )
+
+#define MOTION_GYRO                    ( 1U )
+#define MOTION_ACCELERO                ( 2U )
+#define MOTION_MAGNETO                 ( 4U )
+
+typedef struct
+{
+    int32_t x;
+    int32_t y;
+    int32_t z;
+} BSP_MOTION_SENSOR_Axes_t;
+
+/* Component objects, motion_sampler.c passes the first one to the ISM330DHCX driver */
+extern void * MotionCompObj[ MOTION_INSTANCES_NBR ];
+
+int32_t BSP_MOTION_SENSOR_Init( uint32_t Instance,
+                                uint32_t Functions );
+int32_t BSP_MOTION_SENSOR_Enable( uint32_t Instance,
+                                  uint32_t Function );
+int32_t BSP_MOTION_SENSOR_SetOutputDataRate( uint32_t Instance,
+                                             uint32_t Function,
+                                             float Odr );
+int32_t BSP_MOTION_SENSOR_GetAxes( uint32_t Instance,
+                                   uint32_t Function,
+                                   BSP_MOTION_SENSOR_Axes_t * pAxes );
+
+#endif /* B_U585I_IOT02A_MOTION_SENSORS_H */
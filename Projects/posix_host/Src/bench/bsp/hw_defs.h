@@ -0,0 +1,50 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file hw_defs.h
+ * @brief Host stand-in for Common/config/hw_defs.h, with the IMU interrupt pin,
+ * the cycle counter and the EXTI callback registration used by motion_sampler.c.
+ * The functions are provided by the host program that includes it.
+ */
+
+#ifndef HW_DEFS_H
+#define HW_DEFS_H
+
+#include <stdint.h>
+
+#define IMU_INT1_Pin    ( 1U << 11 )
+
+uint32_t ulGetCycleCount( void );
+
+typedef void ( * GPIOInterruptCallback_t ) ( void * pvContext );
+
+void GPIO_EXTI_Register_Callback( uint16_t usGpioPinMask,
+                                  GPIOInterruptCallback_t pvCallback,
+                                  void * pvContext );
+
+#endif /* HW_DEFS_H */
@@ -0,0 +1,57 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file ism330dhcx.h
+ * @brief Host stand-in for the ISM330DHCX component driver, with the data ready
+ * routing calls used by motion_sampler.c. The functions are provided by the
+ * host program that includes it.
+ */
+
+#ifndef ISM330DHCX_H
+#define ISM330DHCX_H
+
+#include <stdint.h>
+
+#define ISM330DHCX_OK       ( 0 )
+#define ISM330DHCX_ERROR    ( -1 )
+
+#define PROPERTY_DISABLE    ( 0U )
+#define PROPERTY_ENABLE     ( 1U )
+
+typedef enum
+{
+    ISM330DHCX_DRDY_LATCHED = 0,
+    ISM330DHCX_DRDY_PULSED  = 1,
+} ism330dhcx_dataready_pulsed_t;
+
+int32_t ISM330DHCX_DRDY_Set_Mode( void * pObj,
+                                  ism330dhcx_dataready_pulsed_t Mode );
+int32_t ISM330DHCX_ACC_Set_INT1_DRDY( void * pObj,
+                                      uint8_t Status );
+
+#endif /* ISM330DHCX_H */
@@ -0,0 +1,219 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/*
+ * Host benchmark and cross check of the littlefs CRC backends in
+ * lfs_port_crc.c. The software backends are compared against a bit at a time
+ * reference, and so is a model of the CRC peripheral configuration used by
+ * lfs_crc_hw, which has to give the same result for the same register values.
+ *
+ * See the README in Projects/posix_host for build instructions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lfs_port_crc.h"
+
+#define BENCH_CHUNK_LEN     ( 4096 )
+#define BENCH_TOTAL_MIB     ( 64 )
+#define BENCH_NUM_CHECKS    ( 20000 )
+
+static uint8_t pucData[ BENCH_CHUNK_LEN + 8 ];
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000ULL ) + ( ( uint64_t ) xNow.tv_nsec / 1000ULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvXorShift( uint32_t * pulState )
+{
+    *pulState ^= *pulState << 13;
+    *pulState ^= *pulState >> 17;
+    *pulState ^= *pulState << 5;
+
+    return *pulState;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvBitReverse( uint32_t ulValue,
+                               uint32_t ulBits )
+{
+    uint32_t ulResult = 0;
+
+    for( uint32_t i = 0; i < ulBits; i++ )
+    {
+        ulResult = ( ulResult << 1 ) | ( ulValue & 1 );
+        ulValue >>= 1;
+    }
+
+    return ulResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Reflected CRC-32, one bit at a time */
+static uint32_t prvCrcReference( uint32_t ulCrc,
+                                 const void * pvBuffer,
+                                 size_t uxSize )
+{
+    const uint8_t * pucBuffer = pvBuffer;
+
+    for( size_t i = 0; i < uxSize; i++ )
+    {
+        ulCrc ^= pucBuffer[ i ];
+
+        for( uint32_t ulBit = 0; ulBit < 8; ulBit++ )
+        {
+            ulCrc = ( ulCrc >> 1 ) ^ ( ( ulCrc & 1 ) ? 0xedb88320 : 0 );
+        }
+    }
+
+    return ulCrc;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * CRC peripheral with the default polynomial, input reversed by byte and the
+ * output reversed. lfs_crc_hw loads INIT with the bit reversed running value and
+ * writes words byte swapped, so bytes are processed in memory order.
+ */
+static uint32_t prvCrcPeripheralModel( uint32_t ulCrc,
+                                       const void * pvBuffer,
+                                       size_t uxSize )
+{
+    const uint8_t * pucBuffer = pvBuffer;
+    uint32_t ulDr = prvBitReverse( ulCrc, 32 );
+
+    for( size_t i = 0; i < uxSize; i++ )
+    {
+        ulDr ^= prvBitReverse( pucBuffer[ i ], 8 ) << 24;
+
+        for( uint32_t ulBit = 0; ulBit < 8; ulBit++ )
+        {
+            ulDr = ( ulDr << 1 ) ^ ( ( ulDr & 0x80000000 ) ? 0x04c11db7 : 0 );
+        }
+    }
+
+    return prvBitReverse( ulDr, 32 );
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvCheck( const char * pcName,
+                     LfsCrcFunction_t xCrcFunction )
+{
+    uint32_t ulState = 0x2545f491;
+    int lMismatches = 0;
+
+    for( uint32_t i = 0; i < BENCH_NUM_CHECKS; i++ )
+    {
+        size_t uxOffset = prvXorShift( &ulState ) % 8;
+        size_t uxSize = prvXorShift( &ulState ) % ( ( i % 2 ) ? 64 : BENCH_CHUNK_LEN );
+        size_t uxSplit = ( uxSize > 0 ) ? ( prvXorShift( &ulState ) % uxSize ) : 0;
+        uint32_t ulInit = ( i % 3 ) ? prvXorShift( &ulState ) : 0xffffffff;
+        uint32_t ulExpected = prvCrcReference( ulInit, &( pucData[ uxOffset ] ), uxSize );
+
+        /* Chained over two calls, as littlefs does when a CRC spans cache loads */
+        uint32_t ulCrc = xCrcFunction( ulInit, &( pucData[ uxOffset ] ), uxSplit );
+
+        ulCrc = xCrcFunction( ulCrc, &( pucData[ uxOffset + uxSplit ] ), uxSize - uxSplit );
+
+        if( ulCrc != ulExpected )
+        {
+            lMismatches++;
+        }
+    }
+
+    printf( "%-8s %d mismatches in %d checks\n", pcName, lMismatches, BENCH_NUM_CHECKS );
+
+    return lMismatches;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvBench( const char * pcName,
+                      LfsCrcFunction_t xCrcFunction )
+{
+    uint32_t ulCrc = 0xffffffff;
+    uint32_t ulChunks = ( BENCH_TOTAL_MIB * 1024 * 1024 ) / BENCH_CHUNK_LEN;
+    uint64_t ullStart = prvNowUs();
+    uint64_t ullElapsedUs;
+
+    for( uint32_t i = 0; i < ulChunks; i++ )
+    {
+        ulCrc = xCrcFunction( ulCrc, pucData, BENCH_CHUNK_LEN );
+    }
+
+    ullElapsedUs = prvNowUs() - ullStart;
+
+    if( ullElapsedUs == 0 )
+    {
+        ullElapsedUs = 1;
+    }
+
+    printf( "%-8s %8lu us %8lu MiB/s (crc 0x%08lx)\n",
+            pcName,
+            ( unsigned long ) ullElapsedUs,
+            ( unsigned long ) ( ( ( uint64_t ) BENCH_TOTAL_MIB * 1000000ULL ) / ullElapsedUs ),
+            ( unsigned long ) ulCrc );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    uint32_t ulState = 0x9e3779b9;
+    int lMismatches = 0;
+
+    for( size_t i = 0; i < sizeof( pucData ); i++ )
+    {
+        pucData[ i ] = ( uint8_t ) prvXorShift( &ulState );
+    }
+
+    lMismatches += prvCheck( lfs_crc_get_name( LFS_CRC_BACKEND_NIBBLE ), lfs_crc_nibble );
+    lMismatches += prvCheck( lfs_crc_get_name( LFS_CRC_BACKEND_SLICE8 ), lfs_crc_slice8 );
+    lMismatches += prvCheck( "hw model", prvCrcPeripheralModel );
+
+    prvBench( lfs_crc_get_name( LFS_CRC_BACKEND_NIBBLE ), lfs_crc_nibble );
+    prvBench( lfs_crc_get_name( LFS_CRC_BACKEND_SLICE8 ), lfs_crc_slice8 );
+
+    return ( lMismatches == 0 ) ? 0 : 1;
+}
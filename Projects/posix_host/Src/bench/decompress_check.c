@@ -0,0 +1,274 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Host check of the OTA image decoder in ota_pal_decompress.c against the
+ * output of tools/ota_compress.py. The compressed image is decoded with input
+ * and output split at several sizes, as blocks arrive over OTA and the PAL
+ * fills its write buffer, and compared with the original image. Headers with
+ * a non-zero reserved field or other invalid values must be rejected.
+ *
+ * See the README in Projects/posix_host for build instructions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ota_pal_decompress.h"
+
+static OtaDecompressCtx_t xCtx;
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * prvReadFile( const char * pcPath,
+                              size_t * puxLen )
+{
+    uint8_t * pucData = NULL;
+    FILE * pxFile = fopen( pcPath, "rb" );
+
+    if( pxFile == NULL )
+    {
+        printf( "Failed to open %s\n", pcPath );
+    }
+    else
+    {
+        long lLen;
+
+        ( void ) fseek( pxFile, 0, SEEK_END );
+        lLen = ftell( pxFile );
+        ( void ) fseek( pxFile, 0, SEEK_SET );
+
+        pucData = malloc( ( lLen > 0 ) ? ( size_t ) lLen : 1 );
+
+        if( ( pucData != NULL ) &&
+            ( lLen > 0 ) &&
+            ( fread( pucData, 1, ( size_t ) lLen, pxFile ) == ( size_t ) lLen ) )
+        {
+            *puxLen = ( size_t ) lLen;
+        }
+        else
+        {
+            printf( "Failed to read %s\n", pcPath );
+            free( pucData );
+            pucData = NULL;
+        }
+
+        ( void ) fclose( pxFile );
+    }
+
+    return pucData;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Decode pucBlob, feeding at most uxInChunk bytes and accepting at most
+ * uxOutChunk bytes per call. Returns the final status and the output length.
+ */
+static OtaDecompressStatus_t prvDecode( const uint8_t * pucBlob,
+                                        size_t uxBlobLen,
+                                        size_t uxInChunk,
+                                        size_t uxOutChunk,
+                                        uint8_t * pucOut,
+                                        size_t uxOutMax,
+                                        size_t * puxOutLen )
+{
+    OtaDecompressStatus_t xStatus = xOtaDecompress_Init( &xCtx, pucBlob );
+    size_t uxInPos = OTA_COMPRESSED_HEADER_LEN;
+    size_t uxOutPos = 0;
+
+    while( ( xStatus != OTA_DECOMPRESS_ERROR ) &&
+           ( xStatus != OTA_DECOMPRESS_DONE ) &&
+           ( uxInPos < uxBlobLen ) )
+    {
+        size_t uxInLen = ( ( uxBlobLen - uxInPos ) < uxInChunk ) ? ( uxBlobLen - uxInPos ) : uxInChunk;
+
+        do
+        {
+            size_t uxOutLen = ( ( uxOutMax - uxOutPos ) < uxOutChunk ) ? ( uxOutMax - uxOutPos ) : uxOutChunk;
+            size_t uxConsumed = 0;
+            size_t uxProduced = 0;
+
+            xStatus = xOtaDecompress_Process( &xCtx, &( pucBlob[ uxInPos ] ), uxInLen, &uxConsumed,
+                                              &( pucOut[ uxOutPos ] ), uxOutLen, &uxProduced );
+
+            uxInPos += uxConsumed;
+            uxInLen -= uxConsumed;
+            uxOutPos += uxProduced;
+        } while( ( xStatus == OTA_DECOMPRESS_OUTPUT_FULL ) && ( uxOutPos < uxOutMax ) );
+
+        if( ( xStatus == OTA_DECOMPRESS_OUTPUT_FULL ) && ( uxOutPos == uxOutMax ) )
+        {
+            /* More output than the image holds */
+            xStatus = OTA_DECOMPRESS_ERROR;
+        }
+    }
+
+    *puxOutLen = uxOutPos;
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvCheckDecode( const uint8_t * pucBlob,
+                           size_t uxBlobLen,
+                           const uint8_t * pucImage,
+                           size_t uxImageLen,
+                           uint8_t * pucOut )
+{
+    static const size_t puxInChunks[] = { 1, 7, 128, 4096, SIZE_MAX };
+    static const size_t puxOutChunks[] = { 1, 16, 1024 };
+    int lFailures = 0;
+
+    for( size_t i = 0; i < sizeof( puxInChunks ) / sizeof( puxInChunks[ 0 ] ); i++ )
+    {
+        for( size_t j = 0; j < sizeof( puxOutChunks ) / sizeof( puxOutChunks[ 0 ] ); j++ )
+        {
+            size_t uxOutLen = 0;
+            OtaDecompressStatus_t xStatus = prvDecode( pucBlob, uxBlobLen, puxInChunks[ i ], puxOutChunks[ j ],
+                                                       pucOut, uxImageLen, &uxOutLen );
+
+            if( ( xStatus != OTA_DECOMPRESS_DONE ) ||
+                ( uxOutLen != uxImageLen ) ||
+                ( memcmp( pucOut, pucImage, uxImageLen ) != 0 ) )
+            {
+                printf( "FAIL: input chunk %zu, output chunk %zu: status %d, %zu of %zu bytes\n",
+                        ( puxInChunks[ i ] == SIZE_MAX ) ? uxBlobLen : puxInChunks[ i ], puxOutChunks[ j ],
+                        ( int ) xStatus, uxOutLen, uxImageLen );
+                lFailures++;
+            }
+        }
+    }
+
+    /* A stream cut short must never report a complete image */
+    if( uxBlobLen > OTA_COMPRESSED_HEADER_LEN + 1 )
+    {
+        size_t uxOutLen = 0;
+        OtaDecompressStatus_t xStatus = prvDecode( pucBlob, uxBlobLen - 1, 4096, 1024,
+                                                   pucOut, uxImageLen, &uxOutLen );
+
+        if( xStatus == OTA_DECOMPRESS_DONE )
+        {
+            printf( "FAIL: truncated stream decoded to a complete image\n" );
+            lFailures++;
+        }
+    }
+
+    return lFailures;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvCheckHeader( const uint8_t * pucBlob,
+                           size_t uxOffset,
+                           uint8_t ucValue,
+                           const char * pcName )
+{
+    uint8_t pucHeader[ OTA_COMPRESSED_HEADER_LEN ];
+    int lFailures = 0;
+
+    ( void ) memcpy( pucHeader, pucBlob, sizeof( pucHeader ) );
+    pucHeader[ uxOffset ] = ucValue;
+
+    if( xOtaDecompress_Init( &xCtx, pucHeader ) != OTA_DECOMPRESS_ERROR )
+    {
+        printf( "FAIL: header with %s was accepted\n", pcName );
+        lFailures++;
+    }
+
+    return lFailures;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    uint8_t * pucImage = NULL;
+    uint8_t * pucBlob = NULL;
+    uint8_t * pucOut = NULL;
+    size_t uxImageLen = 0;
+    size_t uxBlobLen = 0;
+    int lFailures = 0;
+
+    if( argc != 3 )
+    {
+        printf( "Usage: %s <image> <compressed image>\n", argv[ 0 ] );
+        return 2;
+    }
+
+    pucImage = prvReadFile( argv[ 1 ], &uxImageLen );
+    pucBlob = prvReadFile( argv[ 2 ], &uxBlobLen );
+
+    if( ( pucImage == NULL ) || ( pucBlob == NULL ) || ( uxBlobLen < OTA_COMPRESSED_HEADER_LEN ) )
+    {
+        lFailures++;
+    }
+    else
+    {
+        struct timespec xStart;
+        struct timespec xEnd;
+        size_t uxOutLen = 0;
+        double dSeconds;
+
+        pucOut = malloc( uxImageLen );
+
+        if( pucOut == NULL )
+        {
+            return 1;
+        }
+
+        lFailures += prvCheckDecode( pucBlob, uxBlobLen, pucImage, uxImageLen, pucOut );
+
+        lFailures += prvCheckHeader( pucBlob, 6, 0x01, "usReserved = 0x0001" );
+        lFailures += prvCheckHeader( pucBlob, 7, 0x80, "usReserved = 0x8000" );
+        lFailures += prvCheckHeader( pucBlob, 12, 0x01, "ulReserved = 0x00000001" );
+        lFailures += prvCheckHeader( pucBlob, 15, 0x80, "ulReserved = 0x80000000" );
+        lFailures += prvCheckHeader( pucBlob, 0, 'X', "a bad magic" );
+        lFailures += prvCheckHeader( pucBlob, 4, OTA_DECOMPRESS_WINDOW_BITS_MAX + 1, "a window above the maximum" );
+        lFailures += prvCheckHeader( pucBlob, 5, pucBlob[ 4 ], "lookahead bits equal to window bits" );
+
+        ( void ) clock_gettime( CLOCK_MONOTONIC, &xStart );
+        ( void ) prvDecode( pucBlob, uxBlobLen, 4096, 1024, pucOut, uxImageLen, &uxOutLen );
+        ( void ) clock_gettime( CLOCK_MONOTONIC, &xEnd );
+
+        dSeconds = ( double ) ( xEnd.tv_sec - xStart.tv_sec ) + ( ( double ) ( xEnd.tv_nsec - xStart.tv_nsec ) / 1e9 );
+
+        printf( "%s: %zu -> %zu bytes, window %u, lookahead %u, decoded in %.3f ms\n",
+                argv[ 2 ], uxBlobLen, uxImageLen, 1U << pucBlob[ 4 ], 1U << pucBlob[ 5 ], dSeconds * 1e3 );
+        printf( "Failures: %d\n", lFailures );
+    }
+
+    free( pucOut );
+    free( pucBlob );
+    free( pucImage );
+
+    return ( lFailures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,416 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Host benchmark comparing mbedtls_pk_verify against ota_pal_sig_verify.c for
+ * the OTA signing key. Both paths verify the same signatures, so the benchmark
+ * also checks that they agree, including on corrupted signatures. It then signs
+ * an image the way the OTA service does and checks that otaPal_CloseFile would
+ * reject it once the image or its signature is modified.
+ *
+ * See the README in Projects/posix_host for build instructions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/ecdsa.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+
+#include "ota_pal_sig_verify.h"
+
+#define BENCH_NUM_SIGNATURES    ( 32 )
+#define BENCH_ITERATIONS        ( 8 )
+#define BENCH_IMAGE_LEN         ( 64 * 1024 )
+#define BENCH_IMAGE_BLOCK_LEN   ( 4096 )
+
+typedef struct
+{
+    uint8_t pucHash[ 32 ];
+    uint8_t pucSignature[ MBEDTLS_ECDSA_MAX_LEN ];
+    size_t uxSignatureLen;
+} BenchSignature_t;
+
+static BenchSignature_t xSignatures[ BENCH_NUM_SIGNATURES ];
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000ULL ) + ( ( uint64_t ) xNow.tv_nsec / 1000ULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvGenerateSignatures( mbedtls_pk_context * pxPrvKey,
+                                  mbedtls_ctr_drbg_context * pxDrbg )
+{
+    int lError = 0;
+
+    for( size_t i = 0; ( i < BENCH_NUM_SIGNATURES ) && ( lError == 0 ); i++ )
+    {
+        uint8_t pucMessage[ 64 ];
+
+        lError = mbedtls_ctr_drbg_random( pxDrbg, pucMessage, sizeof( pucMessage ) );
+
+        if( lError == 0 )
+        {
+            lError = mbedtls_sha256( pucMessage, sizeof( pucMessage ), xSignatures[ i ].pucHash, 0 );
+        }
+
+        if( lError == 0 )
+        {
+            lError = mbedtls_pk_sign( pxPrvKey, MBEDTLS_MD_SHA256,
+                                      xSignatures[ i ].pucHash, sizeof( xSignatures[ i ].pucHash ),
+                                      xSignatures[ i ].pucSignature, sizeof( xSignatures[ i ].pucSignature ),
+                                      &( xSignatures[ i ].uxSignatureLen ),
+                                      mbedtls_ctr_drbg_random, pxDrbg );
+        }
+    }
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Hash the image one block at a time, as otaPal_WriteBlock does for a
+ * compressed image, and check the signature with both verification paths.
+ */
+static int prvVerifyImage( mbedtls_pk_context * pxPubKey,
+                           OtaSigVerifier_t * pxVerifier,
+                           const uint8_t * pucImage,
+                           const uint8_t * pucSignature,
+                           size_t uxSignatureLen,
+                           int * plAccepted )
+{
+    mbedtls_sha256_context xHashCtx;
+    uint8_t pucHash[ 32 ];
+    int lError;
+
+    mbedtls_sha256_init( &xHashCtx );
+
+    lError = mbedtls_sha256_starts( &xHashCtx, 0 );
+
+    for( size_t uxOffset = 0; ( uxOffset < BENCH_IMAGE_LEN ) && ( lError == 0 ); uxOffset += BENCH_IMAGE_BLOCK_LEN )
+    {
+        lError = mbedtls_sha256_update( &xHashCtx, &( pucImage[ uxOffset ] ), BENCH_IMAGE_BLOCK_LEN );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_sha256_finish( &xHashCtx, pucHash );
+    }
+
+    mbedtls_sha256_free( &xHashCtx );
+
+    if( lError == 0 )
+    {
+        int lDefault = mbedtls_pk_verify( pxPubKey, MBEDTLS_MD_SHA256, pucHash, sizeof( pucHash ),
+                                          pucSignature, uxSignatureLen );
+        int lFixed = lOtaSigVerifier_Verify( pxVerifier, pucHash, sizeof( pucHash ),
+                                             pucSignature, uxSignatureLen );
+
+        *plAccepted = ( lDefault == 0 ) && ( lFixed == 0 );
+
+        if( ( lDefault == 0 ) != ( lFixed == 0 ) )
+        {
+            printf( "Verification paths disagree on an image signature\n" );
+            *plAccepted = -1;
+        }
+    }
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Sign an image over the whole file, as the OTA service does, then check that
+ * it is accepted as is and rejected with a modified image or signature.
+ */
+static int prvCheckImageSignature( mbedtls_pk_context * pxPrvKey,
+                                   mbedtls_pk_context * pxPubKey,
+                                   OtaSigVerifier_t * pxVerifier,
+                                   mbedtls_ctr_drbg_context * pxDrbg,
+                                   int * plFailures )
+{
+    uint8_t * pucImage = malloc( BENCH_IMAGE_LEN );
+    uint8_t pucHash[ 32 ];
+    uint8_t pucSignature[ MBEDTLS_ECDSA_MAX_LEN ];
+    size_t uxSignatureLen = 0;
+    int lAccepted = 0;
+    int lError = ( pucImage != NULL ) ? 0 : MBEDTLS_ERR_ECP_ALLOC_FAILED;
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_ctr_drbg_random( pxDrbg, pucImage, BENCH_IMAGE_LEN );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_sha256( pucImage, BENCH_IMAGE_LEN, pucHash, 0 );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_pk_sign( pxPrvKey, MBEDTLS_MD_SHA256, pucHash, sizeof( pucHash ),
+                                  pucSignature, sizeof( pucSignature ), &uxSignatureLen,
+                                  mbedtls_ctr_drbg_random, pxDrbg );
+    }
+
+    if( lError == 0 )
+    {
+        lError = prvVerifyImage( pxPubKey, pxVerifier, pucImage, pucSignature, uxSignatureLen, &lAccepted );
+
+        if( ( lError == 0 ) && ( lAccepted != 1 ) )
+        {
+            printf( "FAIL: signed image was rejected\n" );
+            ( *plFailures )++;
+        }
+    }
+
+    /* A single bit flipped in the last block of the image */
+    if( lError == 0 )
+    {
+        pucImage[ BENCH_IMAGE_LEN - 1 ] ^= 0x80;
+        lError = prvVerifyImage( pxPubKey, pxVerifier, pucImage, pucSignature, uxSignatureLen, &lAccepted );
+        pucImage[ BENCH_IMAGE_LEN - 1 ] ^= 0x80;
+
+        if( ( lError == 0 ) && ( lAccepted != 0 ) )
+        {
+            printf( "FAIL: modified image was accepted\n" );
+            ( *plFailures )++;
+        }
+    }
+
+    /* A single bit flipped in the s value of the signature */
+    if( lError == 0 )
+    {
+        pucSignature[ uxSignatureLen - 1 ] ^= 0x01;
+        lError = prvVerifyImage( pxPubKey, pxVerifier, pucImage, pucSignature, uxSignatureLen, &lAccepted );
+
+        if( ( lError == 0 ) && ( lAccepted != 0 ) )
+        {
+            printf( "FAIL: bad signature was accepted\n" );
+            ( *plFailures )++;
+        }
+    }
+
+    /* A truncated signature */
+    if( lError == 0 )
+    {
+        pucSignature[ uxSignatureLen - 1 ] ^= 0x01;
+        lError = prvVerifyImage( pxPubKey, pxVerifier, pucImage, pucSignature, uxSignatureLen - 1, &lAccepted );
+
+        if( ( lError == 0 ) && ( lAccepted != 0 ) )
+        {
+            printf( "FAIL: truncated signature was accepted\n" );
+            ( *plFailures )++;
+        }
+    }
+
+    free( pucImage );
+
+    return lError;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    int lError = 0;
+    int lMismatches = 0;
+    int lImageFailures = 0;
+    mbedtls_entropy_context xEntropy;
+    mbedtls_ctr_drbg_context xDrbg;
+    mbedtls_pk_context xPrvKey;
+    mbedtls_pk_context xPubKey;
+    OtaSigVerifier_t xVerifier;
+    uint8_t pucPubKeyDer[ 128 ];
+    uint8_t * pucTable = NULL;
+    size_t uxTableLen = 0;
+    uint64_t ullDefaultUs = 0;
+    uint64_t ullVerifierUs = 0;
+    uint64_t ullStart;
+    int lDerLen;
+
+    mbedtls_entropy_init( &xEntropy );
+    mbedtls_ctr_drbg_init( &xDrbg );
+    mbedtls_pk_init( &xPrvKey );
+    mbedtls_pk_init( &xPubKey );
+    ( void ) memset( &xVerifier, 0, sizeof( xVerifier ) );
+
+    lError = mbedtls_ctr_drbg_seed( &xDrbg, mbedtls_entropy_func, &xEntropy, NULL, 0 );
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_pk_setup( &xPrvKey, mbedtls_pk_info_from_type( MBEDTLS_PK_ECKEY ) );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_ecp_gen_key( MBEDTLS_ECP_DP_SECP256R1, mbedtls_pk_ec( xPrvKey ),
+                                      mbedtls_ctr_drbg_random, &xDrbg );
+    }
+
+    /* Load the public half the way the OTA PAL does, from its DER encoding */
+    if( lError == 0 )
+    {
+        lDerLen = mbedtls_pk_write_pubkey_der( &xPrvKey, pucPubKeyDer, sizeof( pucPubKeyDer ) );
+        lError = ( lDerLen > 0 ) ? 0 : lDerLen;
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_pk_parse_public_key( &xPubKey, &( pucPubKeyDer[ sizeof( pucPubKeyDer ) - lDerLen ] ),
+                                              ( size_t ) lDerLen );
+    }
+
+    if( lError == 0 )
+    {
+        lError = prvGenerateSignatures( &xPrvKey, &xDrbg );
+    }
+
+    /* Round trip the table through its serialized form, as on a reboot */
+    if( lError == 0 )
+    {
+        OtaSigVerifier_t xBuilder;
+
+        ullStart = prvNowUs();
+        lError = lOtaSigVerifier_Init( &xBuilder, &xPubKey );
+
+        if( lError == 0 )
+        {
+            lError = lOtaSigVerifier_BuildTable( &xBuilder );
+        }
+
+        printf( "Table build: %lu us\n", ( unsigned long ) ( prvNowUs() - ullStart ) );
+
+        pucTable = malloc( OTA_SIG_VERIFY_TABLE_MAX_LEN );
+
+        if( pucTable == NULL )
+        {
+            lError = MBEDTLS_ERR_ECP_ALLOC_FAILED;
+        }
+
+        if( lError == 0 )
+        {
+            lError = lOtaSigVerifier_ExportTable( &xBuilder, pucTable, OTA_SIG_VERIFY_TABLE_MAX_LEN, &uxTableLen );
+        }
+
+        vOtaSigVerifier_Free( &xBuilder );
+    }
+
+    if( lError == 0 )
+    {
+        lError = lOtaSigVerifier_Init( &xVerifier, &xPubKey );
+    }
+
+    if( lError == 0 )
+    {
+        ullStart = prvNowUs();
+        lError = lOtaSigVerifier_ImportTable( &xVerifier, pucTable, uxTableLen );
+        printf( "Table import: %lu us, %lu bytes\n", ( unsigned long ) ( prvNowUs() - ullStart ),
+                ( unsigned long ) uxTableLen );
+    }
+
+    for( size_t ulIter = 0; ( ulIter < BENCH_ITERATIONS ) && ( lError == 0 ); ulIter++ )
+    {
+        for( size_t i = 0; i < BENCH_NUM_SIGNATURES; i++ )
+        {
+            BenchSignature_t * pxSig = &( xSignatures[ i ] );
+            int lDefault;
+            int lFixed;
+
+            /* Corrupt every fourth signature on odd iterations */
+            if( ( ( ulIter & 1 ) == 1 ) && ( ( i % 4 ) == 0 ) )
+            {
+                pxSig->pucSignature[ pxSig->uxSignatureLen - 1 ] ^= 0x01;
+            }
+
+            ullStart = prvNowUs();
+            lDefault = mbedtls_pk_verify( &xPubKey, MBEDTLS_MD_SHA256,
+                                          pxSig->pucHash, sizeof( pxSig->pucHash ),
+                                          pxSig->pucSignature, pxSig->uxSignatureLen );
+            ullDefaultUs += prvNowUs() - ullStart;
+
+            ullStart = prvNowUs();
+            lFixed = lOtaSigVerifier_Verify( &xVerifier,
+                                             pxSig->pucHash, sizeof( pxSig->pucHash ),
+                                             pxSig->pucSignature, pxSig->uxSignatureLen );
+            ullVerifierUs += prvNowUs() - ullStart;
+
+            if( ( lDefault == 0 ) != ( lFixed == 0 ) )
+            {
+                lMismatches++;
+            }
+
+            if( ( ( ulIter & 1 ) == 1 ) && ( ( i % 4 ) == 0 ) )
+            {
+                pxSig->pucSignature[ pxSig->uxSignatureLen - 1 ] ^= 0x01;
+            }
+        }
+    }
+
+    if( lError == 0 )
+    {
+        lError = prvCheckImageSignature( &xPrvKey, &xPubKey, &xVerifier, &xDrbg, &lImageFailures );
+    }
+
+    if( lError == 0 )
+    {
+        unsigned long ulCount = BENCH_NUM_SIGNATURES * BENCH_ITERATIONS;
+
+        printf( "mbedtls_pk_verify:      %lu us per signature\n", ( unsigned long ) ( ullDefaultUs / ulCount ) );
+        printf( "lOtaSigVerifier_Verify: %lu us per signature\n", ( unsigned long ) ( ullVerifierUs / ulCount ) );
+        printf( "Mismatched results: %d\n", lMismatches );
+        printf( "Image signature check failures: %d\n", lImageFailures );
+    }
+    else
+    {
+        printf( "Benchmark failed: -0x%04X\n", ( unsigned int ) -lError );
+    }
+
+    vOtaSigVerifier_Free( &xVerifier );
+    free( pucTable );
+    mbedtls_pk_free( &xPubKey );
+    mbedtls_pk_free( &xPrvKey );
+    mbedtls_ctr_drbg_free( &xDrbg );
+    mbedtls_entropy_free( &xEntropy );
+
+    return ( ( lError == 0 ) && ( lMismatches == 0 ) && ( lImageFailures == 0 ) ) ? 0 : 1;
+}
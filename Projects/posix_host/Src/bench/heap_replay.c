@@ -0,0 +1,345 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/*
+ * Replays a heap trace recorded on the board with "heaptrack trace" against
+ * the kernel's heap_4.c, so that changes to allocation patterns can be
+ * compared for peak usage and fragmentation without a board in the loop.
+ *
+ * The trace is read from the file given as the first argument, or from stdin.
+ * Lines have the form "m <address> <size> <subsystem>" for an allocation,
+ * where size is the heap_4 block size including its header, and
+ * "f <address>" for a free. Anything else, such as the CLI prompt or lines
+ * starting with '#', is ignored.
+ *
+ * Build with -m32 so that the heap_4 block header has the same size as on the
+ * target. See the README in Projects/posix_host for build instructions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Size of the heap_4 block header on the target, included in the recorded sizes */
+#define REPLAY_TARGET_HEADER_SIZE    ( 8 )
+
+/* Number of allocations that can be live at once. Must be a power of two. */
+#define REPLAY_MAX_LIVE              ( 16384 )
+
+#define REPLAY_NUM_SUBSYS            ( 8 )
+
+typedef struct
+{
+    uint32_t ulAddress; /*!< Address on the target, 0 for an empty slot */
+    void * pvReplay;
+} ReplayEntry_t;
+
+typedef struct
+{
+    char pcName[ 16 ];
+    uint32_t ulAllocs;
+    uint32_t ulFailures;
+} ReplaySubsys_t;
+
+static ReplayEntry_t xLive[ REPLAY_MAX_LIVE ];
+static size_t uxNumLive = 0;
+
+static ReplaySubsys_t xSubsys[ REPLAY_NUM_SUBSYS ];
+
+/*-----------------------------------------------------------*/
+
+/* heap_4.c only needs the scheduler and critical section calls, there is no scheduler on the host. */
+void vTaskSuspendAll( void )
+{
+}
+
+BaseType_t xTaskResumeAll( void )
+{
+    return pdFALSE;
+}
+
+void vPortEnterCritical( void )
+{
+}
+
+void vPortExitCritical( void )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t prvHash( uint32_t ulAddress )
+{
+    /* Blocks are 8 byte aligned, drop the bits that are always zero */
+    return ( size_t ) ( ( ulAddress >> 3 ) * 2654435761UL ) & ( REPLAY_MAX_LIVE - 1 );
+}
+
+/*-----------------------------------------------------------*/
+
+static ReplayEntry_t * prvFind( uint32_t ulAddress )
+{
+    size_t uxIndex = prvHash( ulAddress );
+
+    while( ( xLive[ uxIndex ].ulAddress != 0 ) &&
+           ( xLive[ uxIndex ].ulAddress != ulAddress ) )
+    {
+        uxIndex = ( uxIndex + 1 ) & ( REPLAY_MAX_LIVE - 1 );
+    }
+
+    return &( xLive[ uxIndex ] );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvRemove( ReplayEntry_t * pxEntry )
+{
+    size_t uxHole = ( size_t ) ( pxEntry - xLive );
+    size_t uxIndex = uxHole;
+
+    /* Backward shift deletion keeps the probe sequences intact */
+    for( ; ; )
+    {
+        uxIndex = ( uxIndex + 1 ) & ( REPLAY_MAX_LIVE - 1 );
+
+        if( xLive[ uxIndex ].ulAddress == 0 )
+        {
+            break;
+        }
+
+        size_t uxHome = prvHash( xLive[ uxIndex ].ulAddress );
+
+        if( ( ( uxIndex - uxHome ) & ( REPLAY_MAX_LIVE - 1 ) ) >= ( ( uxIndex - uxHole ) & ( REPLAY_MAX_LIVE - 1 ) ) )
+        {
+            xLive[ uxHole ] = xLive[ uxIndex ];
+            uxHole = uxIndex;
+        }
+    }
+
+    xLive[ uxHole ].ulAddress = 0;
+    xLive[ uxHole ].pvReplay = NULL;
+    uxNumLive--;
+}
+
+/*-----------------------------------------------------------*/
+
+static ReplaySubsys_t * prvGetSubsys( const char * pcName )
+{
+    ReplaySubsys_t * pxSubsys = NULL;
+
+    for( size_t i = 0; i < REPLAY_NUM_SUBSYS; i++ )
+    {
+        if( xSubsys[ i ].pcName[ 0 ] == '\0' )
+        {
+            ( void ) snprintf( xSubsys[ i ].pcName, sizeof( xSubsys[ i ].pcName ), "%s", pcName );
+        }
+
+        if( strncmp( xSubsys[ i ].pcName, pcName, sizeof( xSubsys[ i ].pcName ) - 1 ) == 0 )
+        {
+            pxSubsys = &( xSubsys[ i ] );
+            break;
+        }
+    }
+
+    /* Unknown names beyond the table are counted with the last entry */
+    return ( pxSubsys != NULL ) ? pxSubsys : &( xSubsys[ REPLAY_NUM_SUBSYS - 1 ] );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvFragmentationPct( const HeapStats_t * pxStats )
+{
+    uint32_t ulPct = 0;
+
+    if( pxStats->xAvailableHeapSpaceInBytes > 0 )
+    {
+        ulPct = ( uint32_t ) ( 100U - ( ( 100U * ( uint64_t ) pxStats->xSizeOfLargestFreeBlockInBytes ) /
+                                        pxStats->xAvailableHeapSpaceInBytes ) );
+    }
+
+    return ulPct;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char * argv[] )
+{
+    FILE * pxFile = stdin;
+    char pcLine[ 128 ];
+    uint32_t ulLineNum = 0;
+    uint32_t ulAllocs = 0;
+    uint32_t ulFrees = 0;
+    uint32_t ulFailures = 0;
+    uint32_t ulUnmatchedFrees = 0;
+    uint32_t ulMaxFragPct = 0;
+    size_t uxUsed = 0;
+    size_t uxPeakUsed = 0;
+    HeapStats_t xStats = { 0 };
+    HeapStats_t xPeakStats = { 0 };
+
+    if( argc > 1 )
+    {
+        pxFile = fopen( argv[ 1 ], "r" );
+
+        if( pxFile == NULL )
+        {
+            fprintf( stderr, "Failed to open %s\n", argv[ 1 ] );
+            return EXIT_FAILURE;
+        }
+    }
+
+    while( fgets( pcLine, sizeof( pcLine ), pxFile ) != NULL )
+    {
+        unsigned long ulAddress = 0;
+        unsigned long ulSize = 0;
+        char pcSubsys[ 16 ] = "other";
+        bool xEvent = false;
+
+        ulLineNum++;
+
+        if( sscanf( pcLine, "m %lx %lu %15s", &ulAddress, &ulSize, pcSubsys ) >= 2 )
+        {
+            ReplayEntry_t * pxEntry = prvFind( ( uint32_t ) ulAddress );
+            ReplaySubsys_t * pxSubsys = prvGetSubsys( pcSubsys );
+            size_t uxRequest = ( ulSize > REPLAY_TARGET_HEADER_SIZE ) ? ( ulSize - REPLAY_TARGET_HEADER_SIZE ) : 1;
+            void * pvReplay = NULL;
+
+            if( pxEntry->ulAddress != 0 )
+            {
+                /* The matching free was not recorded, release the old block first */
+                vPortFree( pxEntry->pvReplay );
+                prvRemove( pxEntry );
+                pxEntry = prvFind( ( uint32_t ) ulAddress );
+                ulUnmatchedFrees++;
+            }
+
+            pvReplay = pvPortMalloc( uxRequest );
+            ulAllocs++;
+            pxSubsys->ulAllocs++;
+
+            if( pvReplay == NULL )
+            {
+                ulFailures++;
+                pxSubsys->ulFailures++;
+                fprintf( stderr, "line %lu: allocation of %lu bytes (%s) failed\n",
+                         ( unsigned long ) ulLineNum, ulSize, pcSubsys );
+            }
+            else if( uxNumLive < ( REPLAY_MAX_LIVE - 1 ) )
+            {
+                pxEntry->ulAddress = ( uint32_t ) ulAddress;
+                pxEntry->pvReplay = pvReplay;
+                uxNumLive++;
+            }
+            else
+            {
+                fprintf( stderr, "line %lu: more than %u live allocations\n",
+                         ( unsigned long ) ulLineNum, ( unsigned int ) REPLAY_MAX_LIVE );
+                return EXIT_FAILURE;
+            }
+
+            xEvent = true;
+        }
+        else if( sscanf( pcLine, "f %lx", &ulAddress ) == 1 )
+        {
+            ReplayEntry_t * pxEntry = prvFind( ( uint32_t ) ulAddress );
+
+            if( pxEntry->ulAddress != 0 )
+            {
+                vPortFree( pxEntry->pvReplay );
+                prvRemove( pxEntry );
+            }
+            else
+            {
+                /* Allocated before the trace was started */
+                ulUnmatchedFrees++;
+            }
+
+            ulFrees++;
+            xEvent = true;
+        }
+
+        if( xEvent )
+        {
+            vPortGetHeapStats( &xStats );
+
+            uxUsed = configTOTAL_HEAP_SIZE - xStats.xAvailableHeapSpaceInBytes;
+
+            if( uxUsed > uxPeakUsed )
+            {
+                uxPeakUsed = uxUsed;
+                xPeakStats = xStats;
+            }
+
+            if( prvFragmentationPct( &xStats ) > ulMaxFragPct )
+            {
+                ulMaxFragPct = prvFragmentationPct( &xStats );
+            }
+        }
+    }
+
+    if( pxFile != stdin )
+    {
+        ( void ) fclose( pxFile );
+    }
+
+    vPortGetHeapStats( &xStats );
+
+    printf( "events: %lu allocations, %lu frees, %lu unmatched frees\n",
+            ( unsigned long ) ulAllocs, ( unsigned long ) ulFrees, ( unsigned long ) ulUnmatchedFrees );
+    printf( "failed allocations: %lu\n", ( unsigned long ) ulFailures );
+    printf( "heap: %lu bytes, peak used: %lu bytes, minimum ever free: %lu bytes\n",
+            ( unsigned long ) configTOTAL_HEAP_SIZE,
+            ( unsigned long ) uxPeakUsed,
+            ( unsigned long ) xPortGetMinimumEverFreeHeapSize() );
+    printf( "at peak: largest free block %lu bytes, %lu free blocks, fragmentation %lu%%\n",
+            ( unsigned long ) xPeakStats.xSizeOfLargestFreeBlockInBytes,
+            ( unsigned long ) xPeakStats.xNumberOfFreeBlocks,
+            ( unsigned long ) prvFragmentationPct( &xPeakStats ) );
+    printf( "at end: largest free block %lu bytes, %lu free blocks, fragmentation %lu%%, %lu live\n",
+            ( unsigned long ) xStats.xSizeOfLargestFreeBlockInBytes,
+            ( unsigned long ) xStats.xNumberOfFreeBlocks,
+            ( unsigned long ) prvFragmentationPct( &xStats ),
+            ( unsigned long ) uxNumLive );
+    printf( "worst fragmentation: %lu%%\n\n", ( unsigned long ) ulMaxFragPct );
+
+    printf( "%-10s %10s %10s\n", "subsystem", "allocs", "failures" );
+
+    for( size_t i = 0; ( i < REPLAY_NUM_SUBSYS ) && ( xSubsys[ i ].pcName[ 0 ] != '\0' ); i++ )
+    {
+        printf( "%-10s %10lu %10lu\n", xSubsys[ i ].pcName,
+                ( unsigned long ) xSubsys[ i ].ulAllocs,
+                ( unsigned long ) xSubsys[ i ].ulFailures );
+    }
+
+    return ( ulFailures == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
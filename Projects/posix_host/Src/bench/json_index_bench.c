@@ -0,0 +1,248 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Host benchmark of json_index.c against coreJSON for shadow documents. Each
+ * document is searched for the same paths with JsonIndex_Search and with
+ * JSON_SearchT, and the results must match. The time to validate a document
+ * and run all of its searches is then measured for both.
+ *
+ * See the README in Projects/posix_host for build instructions.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "app/json_index.h"
+
+#define BENCH_ITERATIONS    ( 20000 )
+
+typedef struct
+{
+    const char * pcName;
+    const char * pcDocument;
+    const char * const * ppcQueries;
+} BenchDocument_t;
+
+/* Message on the update/delta topic, as handled by shadow_device_task.c */
+static const char pcDelta[] =
+    "{\"version\":12,\"timestamp\":1595437367,"
+    "\"state\":{\"powerOn\":1},"
+    "\"metadata\":{\"powerOn\":{\"timestamp\":1595437367}},"
+    "\"clientToken\":\"388062\"}";
+
+static const char * const ppcDeltaQueries[] =
+{
+    "version", "state.powerOn", "clientToken", "state.missing", NULL
+};
+
+/* Message on the update/accepted topic */
+static const char pcAccepted[] =
+    "{\"state\":{\"reported\":{\"powerOn\":1}},"
+    "\"metadata\":{\"reported\":{\"powerOn\":{\"timestamp\":1596573647}}},"
+    "\"version\":14698,\"timestamp\":1596573647,\"clientToken\":\"022485\"}";
+
+static const char * const ppcAcceptedQueries[] =
+{
+    "clientToken", "state.reported.powerOn", "metadata.reported.powerOn.timestamp", "version", NULL
+};
+
+/* Message on the update/documents topic for a shadow with sensor values */
+static const char pcDocuments[] =
+    "{\"previous\":{\"state\":{\"desired\":{\"powerOn\":0,\"interval\":5},"
+    "\"reported\":{\"powerOn\":0,\"interval\":5,\"fw\":\"1.2.0\",\"temp\":21.5,\"hum\":40,\"accel\":[0,0,1]}},"
+    "\"metadata\":{\"desired\":{\"powerOn\":{\"timestamp\":1596573600},\"interval\":{\"timestamp\":1596573600}},"
+    "\"reported\":{\"powerOn\":{\"timestamp\":1596573600},\"interval\":{\"timestamp\":1596573600},"
+    "\"fw\":{\"timestamp\":1596573600},\"temp\":{\"timestamp\":1596573600},\"hum\":{\"timestamp\":1596573600},"
+    "\"accel\":[{\"timestamp\":1596573600},{\"timestamp\":1596573600},{\"timestamp\":1596573600}]}},"
+    "\"version\":14697},"
+    "\"current\":{\"state\":{\"desired\":{\"powerOn\":1,\"interval\":5},"
+    "\"reported\":{\"powerOn\":1,\"interval\":5,\"fw\":\"1.2.0\",\"temp\":21.7,\"hum\":41,\"accel\":[0,0,1]}},"
+    "\"metadata\":{\"desired\":{\"powerOn\":{\"timestamp\":1596573647},\"interval\":{\"timestamp\":1596573600}},"
+    "\"reported\":{\"powerOn\":{\"timestamp\":1596573647},\"interval\":{\"timestamp\":1596573600},"
+    "\"fw\":{\"timestamp\":1596573600},\"temp\":{\"timestamp\":1596573647},\"hum\":{\"timestamp\":1596573647},"
+    "\"accel\":[{\"timestamp\":1596573647},{\"timestamp\":1596573647},{\"timestamp\":1596573647}]}},"
+    "\"version\":14698},"
+    "\"timestamp\":1596573647,\"clientToken\":\"022485\"}";
+
+static const char * const ppcDocumentsQueries[] =
+{
+    "current.state.reported.powerOn", "current.state.reported.accel[2]", "current.version",
+    "previous.state.desired.interval", "current.metadata.reported.accel[1].timestamp",
+    "clientToken", "current.state.reported.missing", NULL
+};
+
+/* Reported state nested deeper than JSON_INDEX_MAX_DEPTH */
+static const char pcDeep[] =
+    "{\"state\":{\"reported\":{\"a\":{\"b\":{\"c\":{\"d\":{\"e\":{\"f\":{\"g\":{\"h\":{\"i\":{\"j\":{\"k\":{\"l\":{\"m\":{\"n\":{\"o\":{\"p\":{\"q\":{\"r\":{\"s\":{\"t\":1}}}}}}}}}}}}}}}}}}}}},"
+    "\"version\":3,\"clientToken\":\"000001\"}";
+
+static const char * const ppcDeepQueries[] =
+{
+    "version", "clientToken", "state.reported.a.b.c.d.e.f.g.h.i.j.k.l.m.n.o.p.q.r.s.t", NULL
+};
+
+static const BenchDocument_t xDocuments[] =
+{
+    { "update/delta",     pcDelta,     ppcDeltaQueries     },
+    { "update/accepted",  pcAccepted,  ppcAcceptedQueries  },
+    { "update/documents", pcDocuments, ppcDocumentsQueries },
+    { "deep reported",    pcDeep,      ppcDeepQueries      },
+};
+
+static JsonIndex_t xIndex;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000000ULL ) + ( uint64_t ) xNow.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Compare every search of a document between the index and coreJSON. */
+static int prvCheckDocument( const BenchDocument_t * pxDoc )
+{
+    size_t uxDocLen = strlen( pxDoc->pcDocument );
+    int lMismatches = 0;
+
+    if( JsonIndex_Build( &xIndex, pxDoc->pcDocument, uxDocLen ) != JSONSuccess )
+    {
+        printf( "FAIL: %s: not a valid document for the index\n", pxDoc->pcName );
+        return 1;
+    }
+
+    printf( "%-16s %4zu bytes, %3zu values indexed%s\n", pxDoc->pcName, uxDocLen, xIndex.uxNumEntries,
+            xIndex.xIsComplete ? "" : ", falls back to coreJSON" );
+
+    for( size_t i = 0; pxDoc->ppcQueries[ i ] != NULL; i++ )
+    {
+        const char * pcQuery = pxDoc->ppcQueries[ i ];
+        const char * pcIndexValue = NULL;
+        char * pcCoreValue = NULL;
+        size_t uxIndexLen = 0;
+        size_t uxCoreLen = 0;
+        JSONTypes_t xIndexType = JSONInvalid;
+        JSONTypes_t xCoreType = JSONInvalid;
+        JSONStatus_t xIndexStatus;
+        JSONStatus_t xCoreStatus;
+
+        xIndexStatus = JsonIndex_Search( &xIndex, pcQuery, strlen( pcQuery ),
+                                         &pcIndexValue, &uxIndexLen, &xIndexType );
+        xCoreStatus = JSON_SearchT( ( char * ) pxDoc->pcDocument, uxDocLen, pcQuery, strlen( pcQuery ),
+                                    &pcCoreValue, &uxCoreLen, &xCoreType );
+
+        if( ( xIndexStatus != xCoreStatus ) ||
+            ( ( xCoreStatus == JSONSuccess ) &&
+              ( ( pcIndexValue != pcCoreValue ) || ( uxIndexLen != uxCoreLen ) || ( xIndexType != xCoreType ) ) ) )
+        {
+            printf( "FAIL: %s: %s: index status %d, coreJSON status %d\n",
+                    pxDoc->pcName, pcQuery, ( int ) xIndexStatus, ( int ) xCoreStatus );
+            lMismatches++;
+        }
+    }
+
+    return lMismatches;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Validate and search a document the way shadow_device_task.c did before the index, then with it. */
+static void prvBenchDocument( const BenchDocument_t * pxDoc )
+{
+    size_t uxDocLen = strlen( pxDoc->pcDocument );
+    uint64_t ullStart;
+    uint64_t ullCoreNs;
+    uint64_t ullIndexNs;
+
+    ullStart = prvNowNs();
+
+    for( size_t ulIter = 0; ulIter < BENCH_ITERATIONS; ulIter++ )
+    {
+        ( void ) JSON_Validate( pxDoc->pcDocument, uxDocLen );
+
+        for( size_t i = 0; pxDoc->ppcQueries[ i ] != NULL; i++ )
+        {
+            char * pcValue = NULL;
+            size_t uxValueLen = 0;
+
+            ( void ) JSON_Search( ( char * ) pxDoc->pcDocument, uxDocLen, pxDoc->ppcQueries[ i ],
+                                  strlen( pxDoc->ppcQueries[ i ] ), &pcValue, &uxValueLen );
+        }
+    }
+
+    ullCoreNs = prvNowNs() - ullStart;
+    ullStart = prvNowNs();
+
+    for( size_t ulIter = 0; ulIter < BENCH_ITERATIONS; ulIter++ )
+    {
+        ( void ) JsonIndex_Build( &xIndex, pxDoc->pcDocument, uxDocLen );
+
+        for( size_t i = 0; pxDoc->ppcQueries[ i ] != NULL; i++ )
+        {
+            const char * pcValue = NULL;
+            size_t uxValueLen = 0;
+
+            ( void ) JsonIndex_Search( &xIndex, pxDoc->ppcQueries[ i ], strlen( pxDoc->ppcQueries[ i ] ),
+                                       &pcValue, &uxValueLen, NULL );
+        }
+    }
+
+    ullIndexNs = prvNowNs() - ullStart;
+
+    printf( "%-16s coreJSON: %6lu ns, index: %6lu ns per message\n", pxDoc->pcName,
+            ( unsigned long ) ( ullCoreNs / BENCH_ITERATIONS ),
+            ( unsigned long ) ( ullIndexNs / BENCH_ITERATIONS ) );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    int lMismatches = 0;
+    size_t uxNumDocuments = sizeof( xDocuments ) / sizeof( xDocuments[ 0 ] );
+
+    for( size_t i = 0; i < uxNumDocuments; i++ )
+    {
+        lMismatches += prvCheckDocument( &( xDocuments[ i ] ) );
+    }
+
+    for( size_t i = 0; i < uxNumDocuments; i++ )
+    {
+        prvBenchDocument( &( xDocuments[ i ] ) );
+    }
+
+    printf( "Mismatched results: %d\n", lMismatches );
+
+    return ( lMismatches == 0 ) ? 0 : 1;
+}
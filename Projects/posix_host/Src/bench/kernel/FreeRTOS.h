@@ -0,0 +1,56 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in for the kernel types and macros used by motion_sampler.c.
+ * The task functions declared in task.h are provided by the host program, on
+ * top of POSIX threads. Programs that build parts of the real kernel use
+ * Src/bench/FreeRTOSConfig.h instead.
+ */
+
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <assert.h>
+#include <stdint.h>
+
+typedef long             BaseType_t;
+typedef unsigned long    UBaseType_t;
+typedef uint32_t         TickType_t;
+
+#define pdFALSE                    ( ( BaseType_t ) 0 )
+#define pdTRUE                     ( ( BaseType_t ) 1 )
+#define pdPASS                     ( pdTRUE )
+
+#define configTICK_RATE_HZ         ( 1000 )
+#define pdMS_TO_TICKS( xTimeInMs )    ( ( TickType_t ) ( ( ( uint64_t ) ( xTimeInMs ) * configTICK_RATE_HZ ) / 1000U ) )
+
+#define configASSERT( x )          assert( x )
+#define portYIELD_FROM_ISR( x )    ( void ) ( x )
+
+#endif /* INC_FREERTOS_H */
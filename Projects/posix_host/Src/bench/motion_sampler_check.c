@@ -0,0 +1,505 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Host check of the data ready driven IMU sampling in motion_sampler.c. The
+ * sampling task runs on a POSIX thread behind the task calls of
+ * kernel/task.h, and the board support calls of bsp/ are faked here. The
+ * fake sensor returns a counter, so every window can be checked for lost,
+ * repeated or reordered samples. The program checks the sensor set up, the
+ * per window statistics while interrupts arrive at the output data rate, the
+ * drop count when the consumer falls behind the ring, and the polling rate
+ * when no interrupt arrives.
+ *
+ * See the README in Projects/posix_host for build instructions.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "hw_defs.h"
+#include "ism330dhcx.h"
+
+#include "app/motion_sampler.h"
+
+/* Cycle counter rate of the board, 160 MHz */
+#define CHECK_CYCLES_PER_US      ( 160U )
+
+#define CHECK_SAMPLE_PERIOD_US   ( 1000000U / MOTION_SAMPLER_ODR_HZ )
+
+void * MotionCompObj[ MOTION_INSTANCES_NBR ];
+
+static int lFailures = 0;
+
+/* Fake kernel state, one task */
+static pthread_t xTaskThread;
+static pthread_mutex_t xNotifyMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xNotifyCond;
+static uint32_t ulNotifyCount = 0;
+static bool xStopTask = false;
+
+/* Fake board state */
+static GPIOInterruptCallback_t pxExtiCallback = NULL;
+static uint16_t usExtiPin = 0;
+static void * pvDrdyModeObj = NULL;
+static int32_t lDrdyMode = -1;
+static void * pvInt1Obj = NULL;
+static uint8_t ucInt1Status = 0;
+static float fAcceleroOdr = 0.0f;
+static float fGyroOdr = 0.0f;
+static uint32_t ulSensorReads = 0;
+static int32_t lSampleCounter = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvCheck( int lCondition,
+                      const char * pcWhat )
+{
+    printf( "%-60s %s\n", pcWhat, lCondition ? "ok" : "FAILED" );
+
+    if( lCondition == 0 )
+    {
+        lFailures++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000ULL ) + ( ( uint64_t ) xNow.tv_nsec / 1000U );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSleepUs( uint64_t ullUs )
+{
+    struct timespec xDelay =
+    {
+        .tv_sec  = ( time_t ) ( ullUs / 1000000U ),
+        .tv_nsec = ( long ) ( ( ullUs % 1000000U ) * 1000U ),
+    };
+
+    ( void ) nanosleep( &xDelay, NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( const char * const pcLogLevel,
+                     const char * const pcFunctionName,
+                     const unsigned long ulLineNumber,
+                     const char * const pcFormat,
+                     ... )
+{
+    va_list xArgs;
+
+    printf( "<%s> %s:%lu ", pcLogLevel, pcFunctionName, ulLineNumber );
+    va_start( xArgs, pcFormat );
+    vprintf( pcFormat, xArgs );
+    va_end( xArgs );
+    printf( "\n" );
+}
+
+void vTaskSuspendAll( void )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvTaskThread( void * pvArg )
+{
+    void ** ppvTask = ( void ** ) pvArg;
+    TaskFunction_t pxTaskCode = ( TaskFunction_t ) ppvTask[ 0 ];
+
+    pxTaskCode( ppvTask[ 1 ] );
+
+    return NULL;
+}
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const uint32_t usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask )
+{
+    static void * pvTask[ 2 ];
+    pthread_condattr_t xAttr;
+
+    ( void ) pcName;
+    ( void ) usStackDepth;
+    ( void ) uxPriority;
+
+    ( void ) pthread_condattr_init( &xAttr );
+    ( void ) pthread_condattr_setclock( &xAttr, CLOCK_MONOTONIC );
+    ( void ) pthread_cond_init( &xNotifyCond, &xAttr );
+
+    pvTask[ 0 ] = ( void * ) pxTaskCode;
+    pvTask[ 1 ] = pvParameters;
+
+    if( pxCreatedTask != NULL )
+    {
+        *pxCreatedTask = ( TaskHandle_t ) &xTaskThread;
+    }
+
+    return ( pthread_create( &xTaskThread, NULL, prvTaskThread, pvTask ) == 0 ) ? pdPASS : pdFALSE;
+}
+
+/* Called by the sampling task only. Ends its thread once the check is done. */
+uint32_t ulTaskNotifyTake( BaseType_t xClearCountOnExit,
+                           TickType_t xTicksToWait )
+{
+    uint64_t ullDeadlineUs = prvNowUs() + ( ( uint64_t ) xTicksToWait * ( 1000000U / configTICK_RATE_HZ ) );
+    struct timespec xDeadline =
+    {
+        .tv_sec  = ( time_t ) ( ullDeadlineUs / 1000000U ),
+        .tv_nsec = ( long ) ( ( ullDeadlineUs % 1000000U ) * 1000U ),
+    };
+    uint32_t ulCount;
+
+    ( void ) pthread_mutex_lock( &xNotifyMutex );
+
+    while( ( ulNotifyCount == 0 ) && ( xStopTask == false ) )
+    {
+        if( pthread_cond_timedwait( &xNotifyCond, &xNotifyMutex, &xDeadline ) != 0 )
+        {
+            break;
+        }
+    }
+
+    if( xStopTask )
+    {
+        ( void ) pthread_mutex_unlock( &xNotifyMutex );
+        pthread_exit( NULL );
+    }
+
+    ulCount = ulNotifyCount;
+    ulNotifyCount = ( xClearCountOnExit != pdFALSE ) ? 0 : ( ( ulCount > 0 ) ? ulCount - 1 : 0 );
+
+    ( void ) pthread_mutex_unlock( &xNotifyMutex );
+
+    return ulCount;
+}
+
+void vTaskNotifyGiveFromISR( TaskHandle_t xTaskToNotify,
+                             BaseType_t * pxHigherPriorityTaskWoken )
+{
+    ( void ) xTaskToNotify;
+
+    ( void ) pthread_mutex_lock( &xNotifyMutex );
+    ulNotifyCount++;
+    ( void ) pthread_cond_signal( &xNotifyCond );
+    ( void ) pthread_mutex_unlock( &xNotifyMutex );
+
+    *pxHigherPriorityTaskWoken = pdTRUE;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulGetCycleCount( void )
+{
+    return ( uint32_t ) ( prvNowUs() * CHECK_CYCLES_PER_US );
+}
+
+void GPIO_EXTI_Register_Callback( uint16_t usGpioPinMask,
+                                  GPIOInterruptCallback_t pvCallback,
+                                  void * pvContext )
+{
+    ( void ) pvContext;
+
+    usExtiPin = usGpioPinMask;
+    pxExtiCallback = pvCallback;
+}
+
+int32_t ISM330DHCX_DRDY_Set_Mode( void * pObj,
+                                  ism330dhcx_dataready_pulsed_t Mode )
+{
+    pvDrdyModeObj = pObj;
+    lDrdyMode = ( int32_t ) Mode;
+
+    return ISM330DHCX_OK;
+}
+
+int32_t ISM330DHCX_ACC_Set_INT1_DRDY( void * pObj,
+                                      uint8_t Status )
+{
+    pvInt1Obj = pObj;
+    ucInt1Status = Status;
+
+    return ISM330DHCX_OK;
+}
+
+int32_t BSP_MOTION_SENSOR_Init( uint32_t Instance,
+                                uint32_t Functions )
+{
+    ( void ) Functions;
+
+    return ( Instance == 0 ) ? BSP_ERROR_NONE : BSP_ERROR_COMPONENT_FAILURE;
+}
+
+int32_t BSP_MOTION_SENSOR_Enable( uint32_t Instance,
+                                  uint32_t Function )
+{
+    ( void ) Function;
+
+    return ( Instance == 0 ) ? BSP_ERROR_NONE : BSP_ERROR_COMPONENT_FAILURE;
+}
+
+int32_t BSP_MOTION_SENSOR_SetOutputDataRate( uint32_t Instance,
+                                             uint32_t Function,
+                                             float Odr )
+{
+    if( Function == MOTION_ACCELERO )
+    {
+        fAcceleroOdr = Odr;
+    }
+    else if( Function == MOTION_GYRO )
+    {
+        fGyroOdr = Odr;
+    }
+
+    return ( Instance == 0 ) ? BSP_ERROR_NONE : BSP_ERROR_COMPONENT_FAILURE;
+}
+
+/* Sample n reads accelerometer ( n, -n, 1000 ) and gyroscope ( 2n, 0, -n ). */
+int32_t BSP_MOTION_SENSOR_GetAxes( uint32_t Instance,
+                                   uint32_t Function,
+                                   BSP_MOTION_SENSOR_Axes_t * pAxes )
+{
+    if( Function == MOTION_ACCELERO )
+    {
+        lSampleCounter++;
+        __atomic_store_n( &ulSensorReads, ( uint32_t ) lSampleCounter, __ATOMIC_RELEASE );
+        *pAxes = ( BSP_MOTION_SENSOR_Axes_t ) { lSampleCounter, -lSampleCounter, 1000 };
+    }
+    else
+    {
+        *pAxes = ( BSP_MOTION_SENSOR_Axes_t ) { 2 * lSampleCounter, 0, -lSampleCounter };
+    }
+
+    return ( Instance == 0 ) ? BSP_ERROR_NONE : BSP_ERROR_COMPONENT_FAILURE;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Wait until the sampling task has read every pending sample. */
+static uint32_t prvWaitForQuiet( void )
+{
+    uint32_t ulReads = __atomic_load_n( &ulSensorReads, __ATOMIC_ACQUIRE );
+    uint32_t ulPrevious;
+
+    do
+    {
+        ulPrevious = ulReads;
+        prvSleepUs( 5000 );
+        ulReads = __atomic_load_n( &ulSensorReads, __ATOMIC_ACQUIRE );
+    } while( ulReads != ulPrevious );
+
+    return ulReads;
+}
+
+/*-----------------------------------------------------------*/
+
+/* A window must hold the consecutive samples ulFirst .. ulFirst + ulNumSamples - 1. */
+static bool prvWindowIsConsecutive( const MotionWindowStats_t * pxStats,
+                                    uint32_t ulFirst )
+{
+    int32_t lFirst = ( int32_t ) ulFirst;
+    int32_t lLast = lFirst + ( int32_t ) pxStats->ulNumSamples - 1;
+    float fMean = ( ( float ) lFirst + ( float ) lLast ) / 2.0f;
+
+    return ( pxStats->ulNumSamples > 0 ) &&
+           ( pxStats->xAccelero.xMin.x == lFirst ) && ( pxStats->xAccelero.xMax.x == lLast ) &&
+           ( pxStats->xAccelero.xMin.y == -lLast ) && ( pxStats->xAccelero.xMax.y == -lFirst ) &&
+           ( pxStats->xGyro.xMin.x == 2 * lFirst ) && ( pxStats->xGyro.xMax.x == 2 * lLast ) &&
+           ( fabsf( pxStats->xAccelero.pfMean[ 0 ] - fMean ) < 0.01f ) &&
+           ( fabsf( pxStats->xGyro.pfMean[ 2 ] + fMean ) < 0.01f ) &&
+           ( fabsf( pxStats->xAccelero.pfRms[ 2 ] - 1000.0f ) < 0.01f ) &&
+           ( pxStats->xGyro.pfRms[ 1 ] == 0.0f );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCheckStart( void )
+{
+    prvCheck( xMotionSamplerStart() == pdTRUE, "Sampler started" );
+    prvCheck( ( fAcceleroOdr == ( float ) MOTION_SAMPLER_ODR_HZ ) && ( fGyroOdr == ( float ) MOTION_SAMPLER_ODR_HZ ),
+              "Accelerometer and gyroscope set to the sampler rate" );
+    prvCheck( ( pxExtiCallback != NULL ) && ( usExtiPin == IMU_INT1_Pin ), "Callback registered on the IMU INT1 line" );
+    prvCheck( ( pvDrdyModeObj == MotionCompObj[ 0 ] ) && ( lDrdyMode == ISM330DHCX_DRDY_PULSED ),
+              "ISM330DHCX data ready set to pulsed" );
+    prvCheck( ( pvInt1Obj == MotionCompObj[ 0 ] ) && ( ucInt1Status == PROPERTY_ENABLE ),
+              "Accelerometer data ready routed to INT1" );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Interrupts at the output data rate, drained every 100 ms as the publishing task does once per period. */
+static uint32_t prvCheckInterruptDriven( void )
+{
+    MotionWindowStats_t xStats;
+    uint32_t ulNext = prvWaitForQuiet() + 1;
+    uint32_t ulWindows = 0;
+    uint32_t ulSamples = 0;
+    uint32_t ulDropped = 0;
+    uint32_t ulMaxIntervalCycles = 0;
+    bool xConsecutive = true;
+
+    /* Drop whatever the task polled before the first interrupt */
+    ( void ) xMotionSamplerGetWindow( &xStats );
+
+    for( uint32_t i = 1; i <= MOTION_SAMPLER_ODR_HZ; i++ )
+    {
+        pxExtiCallback( NULL );
+        prvSleepUs( CHECK_SAMPLE_PERIOD_US );
+
+        if( ( i % ( MOTION_SAMPLER_ODR_HZ / 10 ) ) == 0 )
+        {
+            if( xMotionSamplerGetWindow( &xStats ) )
+            {
+                xConsecutive = xConsecutive && prvWindowIsConsecutive( &xStats, ulNext );
+                ulNext += xStats.ulNumSamples;
+                ulSamples += xStats.ulNumSamples;
+                ulDropped += xStats.ulDropped;
+                ulMaxIntervalCycles = ( xStats.ulMaxIntervalCycles > ulMaxIntervalCycles ) ? xStats.ulMaxIntervalCycles : ulMaxIntervalCycles;
+                ulWindows++;
+            }
+        }
+    }
+
+    ( void ) prvWaitForQuiet();
+
+    if( xMotionSamplerGetWindow( &xStats ) )
+    {
+        xConsecutive = xConsecutive && prvWindowIsConsecutive( &xStats, ulNext );
+        ulNext += xStats.ulNumSamples;
+        ulSamples += xStats.ulNumSamples;
+        ulDropped += xStats.ulDropped;
+    }
+
+    printf( "%u interrupts: %u samples in %u windows, longest interval %u us\n",
+            ( unsigned ) MOTION_SAMPLER_ODR_HZ, ( unsigned ) ulSamples, ( unsigned ) ulWindows,
+            ( unsigned ) ( ulMaxIntervalCycles / CHECK_CYCLES_PER_US ) );
+    prvCheck( xConsecutive, "Windows hold consecutive samples with exact statistics" );
+    prvCheck( ( ulDropped == 0 ) && ( ulNext == __atomic_load_n( &ulSensorReads, __ATOMIC_ACQUIRE ) + 1 ),
+              "Every sample read reached the consumer" );
+    prvCheck( ( ulSamples >= ( MOTION_SAMPLER_ODR_HZ * 9 ) / 10 ) && ( ulSamples <= MOTION_SAMPLER_ODR_HZ + 2 ),
+              "One sample per interrupt" );
+
+    return ulNext;
+}
+
+/*-----------------------------------------------------------*/
+
+/* A consumer that falls behind loses the newest samples and is told how many. */
+static uint32_t prvCheckOverflow( uint32_t ulNext )
+{
+    MotionWindowStats_t xStats;
+    uint32_t ulReads;
+
+    for( uint32_t i = 0; i < ( 3 * MOTION_SAMPLER_RING_LEN ); i++ )
+    {
+        pxExtiCallback( NULL );
+        prvSleepUs( 500 );
+    }
+
+    ulReads = prvWaitForQuiet();
+
+    prvCheck( xMotionSamplerGetWindow( &xStats ) &&
+              ( xStats.ulNumSamples == MOTION_SAMPLER_RING_LEN ) &&
+              prvWindowIsConsecutive( &xStats, ulNext ),
+              "Full ring keeps the oldest samples" );
+    prvCheck( xStats.ulDropped == ( ulReads + 1 - ulNext - MOTION_SAMPLER_RING_LEN ),
+              "Dropped samples counted" );
+    printf( "%u samples read while the consumer waited, %u dropped\n",
+            ( unsigned ) ( ulReads + 1 - ulNext ), ( unsigned ) xStats.ulDropped );
+
+    return ulReads + 1;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Without interrupts the task reads the sensor every two sample periods. */
+static void prvCheckFallback( uint32_t ulNext )
+{
+    MotionWindowStats_t xStats;
+    uint32_t ulExpected = 500000U / ( 2U * CHECK_SAMPLE_PERIOD_US );
+    uint32_t ulIntervalUs;
+
+    /* Drain, then let a few polled samples through so the next interval is measured between polled samples */
+    ( void ) xMotionSamplerGetWindow( &xStats );
+    ulNext += xStats.ulNumSamples + xStats.ulDropped;
+    prvSleepUs( 100000 );
+    ( void ) xMotionSamplerGetWindow( &xStats );
+    ulNext += xStats.ulNumSamples + xStats.ulDropped;
+
+    prvSleepUs( 500000 );
+    prvCheck( xMotionSamplerGetWindow( &xStats ) && prvWindowIsConsecutive( &xStats, ulNext ),
+              "Polled samples are consecutive" );
+    ulIntervalUs = xStats.ulMaxIntervalCycles / CHECK_CYCLES_PER_US;
+
+    printf( "No interrupts for 500 ms: %u samples, longest interval %u us\n",
+            ( unsigned ) xStats.ulNumSamples, ( unsigned ) ulIntervalUs );
+    prvCheck( ( xStats.ulNumSamples >= ( ulExpected * 3 ) / 4 ) && ( xStats.ulNumSamples <= ulExpected + 1 ),
+              "Polling at half the output data rate" );
+    prvCheck( ( ulIntervalUs >= 2U * CHECK_SAMPLE_PERIOD_US ) && ( ulIntervalUs < 4U * CHECK_SAMPLE_PERIOD_US ),
+              "Polling interval of two sample periods" );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    uint32_t ulNext;
+
+    prvCheckStart();
+
+    if( pxExtiCallback != NULL )
+    {
+        ulNext = prvCheckInterruptDriven();
+        ulNext = prvCheckOverflow( ulNext );
+        prvCheckFallback( ulNext );
+    }
+
+    ( void ) pthread_mutex_lock( &xNotifyMutex );
+    xStopTask = true;
+    ( void ) pthread_cond_signal( &xNotifyCond );
+    ( void ) pthread_mutex_unlock( &xNotifyMutex );
+    ( void ) pthread_join( xTaskThread, NULL );
+
+    return ( lFailures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Host benchmark of the schema driven telemetry serializer in
+ * telemetry_serializer.c. The serializer output is compared with a reference
+ * written with snprintf and gmtime_r, in the shape the iotcl DOM produced, for
+ * samples with different sensors valid. The reference lists the keys and
+ * members by hand, so it also checks the bindings generated into
+ * telemetry_schema.h. Messages split over a small buffer are checked, then the
+ * time per message of both is reported for several batch sizes.
+ *
+ * See the README in Projects/posix_host for build instructions.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "app/telemetry_serializer.h"
+
+#define BENCH_MAX_SAMPLES     ( 16 )
+#define BENCH_BUFFER_LEN      ( 8192 )
+#define BENCH_ITERATIONS      ( 20000 )
+
+static int lFailures = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvCheck( int lCondition,
+                      const char * pcWhat )
+{
+    printf( "%-60s %s\n", pcWhat, lCondition ? "ok" : "FAILED" );
+
+    if( lCondition == 0 )
+    {
+        lFailures++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000000ULL ) + ( uint64_t ) xNow.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Sample values are whole or have at most two binary exact decimals, so both writers round them the same way */
+static void prvMakeSample( iotcU5IotTelemetrySample_t * pxSample,
+                           uint32_t ulIndex )
+{
+    iotcU5IotTelemetry_t * pxTelemetry = &( pxSample->xTelemetry );
+    int32_t lBase = ( int32_t ) ( ulIndex * 37U ) - 500;
+
+    ( void ) memset( pxSample, 0, sizeof( *pxSample ) );
+
+    pxTelemetry->xAcceleroAxes = ( BSP_MOTION_SENSOR_Axes_t ) { lBase, -lBase, 1000 + lBase };
+    pxTelemetry->xGyroAxes = ( BSP_MOTION_SENSOR_Axes_t ) { 70 * lBase, 0, -2100 };
+    pxTelemetry->xMagnetoAxes = ( BSP_MOTION_SENSOR_Axes_t ) { 312, -48, lBase / 3 };
+    pxTelemetry->xEnvSensorData.fTemperature0 = 21.25f + ( float ) ( ulIndex % 8U );
+    pxTelemetry->xEnvSensorData.fTemperature1 = -3.5f;
+    pxTelemetry->xEnvSensorData.fHumidity = 45.75f;
+    pxTelemetry->xEnvSensorData.fBarometricPressure = 1013.5f - ( float ) ulIndex;
+    pxTelemetry->xMotionStats.xAcceleroMin = ( BSP_MOTION_SENSOR_Axes_t ) { lBase - 20, -lBase - 20, 980 + lBase };
+    pxTelemetry->xMotionStats.xAcceleroMax = ( BSP_MOTION_SENSOR_Axes_t ) { lBase + 20, -lBase + 20, 1020 + lBase };
+    pxTelemetry->xMotionStats.pfAcceleroRms[ 0 ] = 12.5f;
+    pxTelemetry->xMotionStats.pfAcceleroRms[ 1 ] = 0.25f;
+    pxTelemetry->xMotionStats.pfAcceleroRms[ 2 ] = 1001.75f;
+    pxTelemetry->xMotionStats.pfGyroRms[ 0 ] = 140.0f;
+    pxTelemetry->xMotionStats.pfGyroRms[ 1 ] = 0.0f;
+    pxTelemetry->xMotionStats.pfGyroRms[ 2 ] = 2100.5f;
+    pxTelemetry->bMotionSensorValid = ( ( ulIndex % 5U ) != 4U );
+    pxTelemetry->bEnvSensorDataValid = ( ( ulIndex % 3U ) != 2U );
+    pxTelemetry->bMotionStatsValid = ( ( ulIndex % 2U ) == 0U );
+
+    pxSample->xTimestamp = ( time_t ) 1729209600 + ( time_t ) ( ulIndex * 86399U );
+    pxSample->usTimestampMs = ( uint16_t ) ( ( ulIndex * 251U ) % 1000U );
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t prvAppendf( char * pcBuffer,
+                          size_t uxPos,
+                          size_t uxLen,
+                          const char * pcFormat,
+                          ... )
+{
+    va_list xArgs;
+    int lWritten;
+
+    va_start( xArgs, pcFormat );
+    lWritten = vsnprintf( &( pcBuffer[ uxPos ] ), uxLen - uxPos, pcFormat, xArgs );
+    va_end( xArgs );
+
+    return ( lWritten > 0 ) ? ( uxPos + ( size_t ) lWritten ) : uxPos;
+}
+
+/*-----------------------------------------------------------*/
+
+/* The message the iotcl DOM produced, written field by field with printf. */
+static size_t prvReferenceSerialize( const iotcU5IotTelemetrySample_t * pxSamples,
+                                     size_t uxNumSamples,
+                                     char * pcBuffer,
+                                     size_t uxBufferLen )
+{
+    size_t uxPos = prvAppendf( pcBuffer, 0, uxBufferLen, "{\"d\":[" );
+
+    for( size_t i = 0; i < uxNumSamples; i++ )
+    {
+        const iotcU5IotTelemetry_t * pxTelemetry = &( pxSamples[ i ].xTelemetry );
+        const char * pcSeparator = "";
+        struct tm xTime;
+        char cTime[ 32 ];
+
+        ( void ) gmtime_r( &( pxSamples[ i ].xTimestamp ), &xTime );
+        ( void ) strftime( cTime, sizeof( cTime ), "%Y-%m-%dT%H:%M:%S", &xTime );
+
+        uxPos = prvAppendf( pcBuffer, uxPos, uxBufferLen, "%s{\"dt\":\"%s.%03uZ\",\"d\":{",
+                            ( i > 0 ) ? "," : "", cTime, ( unsigned ) pxSamples[ i ].usTimestampMs );
+
+        if( pxTelemetry->bMotionSensorValid )
+        {
+            uxPos = prvAppendf( pcBuffer, uxPos, uxBufferLen,
+                                "\"acc_x\":%d,\"acc_y\":%d,\"acc_z\":%d,"
+                                "\"mgnt_x\":%d,\"mgnt_y\":%d,\"mgnt_Z\":%d,"
+                                "\"gyro_x\":%d,\"gyro_y\":%d,\"gyro_z\":%d",
+                                pxTelemetry->xAcceleroAxes.x, pxTelemetry->xAcceleroAxes.y, pxTelemetry->xAcceleroAxes.z,
+                                pxTelemetry->xMagnetoAxes.x, pxTelemetry->xMagnetoAxes.y, pxTelemetry->xMagnetoAxes.z,
+                                pxTelemetry->xGyroAxes.x, pxTelemetry->xGyroAxes.y, pxTelemetry->xGyroAxes.z );
+            pcSeparator = ",";
+        }
+
+        if( pxTelemetry->bEnvSensorDataValid )
+        {
+            uxPos = prvAppendf( pcBuffer, uxPos, uxBufferLen,
+                                "%s\"temp_1\":%.2f,\"temp_0\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f",
+                                pcSeparator,
+                                ( double ) pxTelemetry->xEnvSensorData.fTemperature1,
+                                ( double ) pxTelemetry->xEnvSensorData.fTemperature0,
+                                ( double ) pxTelemetry->xEnvSensorData.fHumidity,
+                                ( double ) pxTelemetry->xEnvSensorData.fBarometricPressure );
+            pcSeparator = ",";
+        }
+
+        if( pxTelemetry->bMotionStatsValid )
+        {
+            const MotionSensorStats_t * pxStats = &( pxTelemetry->xMotionStats );
+
+            uxPos = prvAppendf( pcBuffer, uxPos, uxBufferLen,
+                                "%s\"acc_min_x\":%d,\"acc_min_y\":%d,\"acc_min_z\":%d,"
+                                "\"acc_max_x\":%d,\"acc_max_y\":%d,\"acc_max_z\":%d,"
+                                "\"acc_rms_x\":%.2f,\"acc_rms_y\":%.2f,\"acc_rms_z\":%.2f,"
+                                "\"gyro_rms_x\":%.2f,\"gyro_rms_y\":%.2f,\"gyro_rms_z\":%.2f",
+                                pcSeparator,
+                                pxStats->xAcceleroMin.x, pxStats->xAcceleroMin.y, pxStats->xAcceleroMin.z,
+                                pxStats->xAcceleroMax.x, pxStats->xAcceleroMax.y, pxStats->xAcceleroMax.z,
+                                ( double ) pxStats->pfAcceleroRms[ 0 ], ( double ) pxStats->pfAcceleroRms[ 1 ],
+                                ( double ) pxStats->pfAcceleroRms[ 2 ], ( double ) pxStats->pfGyroRms[ 0 ],
+                                ( double ) pxStats->pfGyroRms[ 1 ], ( double ) pxStats->pfGyroRms[ 2 ] );
+        }
+
+        uxPos = prvAppendf( pcBuffer, uxPos, uxBufferLen, "}}" );
+    }
+
+    return prvAppendf( pcBuffer, uxPos, uxBufferLen, "]}" );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCheckOutput( const iotcU5IotTelemetrySample_t * pxSamples )
+{
+    static char cOutput[ BENCH_BUFFER_LEN ];
+    static char cExpected[ BENCH_BUFFER_LEN ];
+    char cWhat[ 64 ];
+    size_t uxWritten = 0;
+    size_t uxLen;
+
+    for( size_t uxNum = 1; uxNum <= BENCH_MAX_SAMPLES; uxNum++ )
+    {
+        uxLen = uxTelemetrySerialize( pxSamples, uxNum, cOutput, sizeof( cOutput ), &uxWritten );
+        ( void ) prvReferenceSerialize( pxSamples, uxNum, cExpected, sizeof( cExpected ) );
+
+        ( void ) snprintf( cWhat, sizeof( cWhat ), "%u samples match the reference", ( unsigned ) uxNum );
+        prvCheck( ( uxWritten == uxNum ) && ( uxLen == strlen( cOutput ) ) && ( strcmp( cOutput, cExpected ) == 0 ), cWhat );
+
+        if( strcmp( cOutput, cExpected ) != 0 )
+        {
+            printf( "  got      %s\n  expected %s\n", cOutput, cExpected );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* A batch larger than the buffer must be sent as several complete messages that together hold every sample. */
+static void prvCheckSplit( const iotcU5IotTelemetrySample_t * pxSamples )
+{
+    static char cOutput[ 1024 ];
+    static char cExpected[ BENCH_BUFFER_LEN ];
+    size_t uxSent = 0;
+    size_t uxMessages = 0;
+    int lOk = 1;
+
+    while( ( uxSent < BENCH_MAX_SAMPLES ) && lOk )
+    {
+        size_t uxWritten = 0;
+        size_t uxLen = uxTelemetrySerialize( &( pxSamples[ uxSent ] ), BENCH_MAX_SAMPLES - uxSent,
+                                             cOutput, sizeof( cOutput ), &uxWritten );
+
+        ( void ) prvReferenceSerialize( &( pxSamples[ uxSent ] ), uxWritten, cExpected, sizeof( cExpected ) );
+
+        lOk = ( uxWritten > 0 ) && ( uxLen < sizeof( cOutput ) ) && ( strcmp( cOutput, cExpected ) == 0 );
+        uxSent += uxWritten;
+        uxMessages++;
+    }
+
+    printf( "%u samples sent in %u messages of at most %u bytes\n",
+            ( unsigned ) uxSent, ( unsigned ) uxMessages, ( unsigned ) sizeof( cOutput ) );
+    prvCheck( lOk && ( uxSent == BENCH_MAX_SAMPLES ) && ( uxMessages > 1 ), "Batch split over a small buffer" );
+    prvCheck( uxTelemetrySerialize( pxSamples, 1, cOutput, 16, &uxSent ) == 0 && ( uxSent == 0 ) && ( cOutput[ 0 ] == '\0' ),
+              "Nothing written when one sample does not fit" );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvMeasure( const iotcU5IotTelemetrySample_t * pxSamples,
+                        size_t uxNumSamples )
+{
+    static char cOutput[ BENCH_BUFFER_LEN ];
+    volatile size_t uxSink = 0;
+    size_t uxWritten = 0;
+    uint64_t ullStart;
+    uint64_t ullSchemaNs;
+    uint64_t ullPrintfNs;
+
+    ullStart = prvNowNs();
+
+    for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+    {
+        uxSink += uxTelemetrySerialize( pxSamples, uxNumSamples, cOutput, sizeof( cOutput ), &uxWritten );
+    }
+
+    ullSchemaNs = prvNowNs() - ullStart;
+    ullStart = prvNowNs();
+
+    for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+    {
+        uxSink += prvReferenceSerialize( pxSamples, uxNumSamples, cOutput, sizeof( cOutput ) );
+    }
+
+    ullPrintfNs = prvNowNs() - ullStart;
+
+    printf( "%2u samples, %5u bytes: schema %7.0f ns, snprintf %7.0f ns per message\n",
+            ( unsigned ) uxNumSamples,
+            ( unsigned ) uxTelemetrySerialize( pxSamples, uxNumSamples, cOutput, sizeof( cOutput ), &uxWritten ),
+            ( double ) ullSchemaNs / BENCH_ITERATIONS,
+            ( double ) ullPrintfNs / BENCH_ITERATIONS );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    static iotcU5IotTelemetrySample_t xSamples[ BENCH_MAX_SAMPLES ];
+
+    for( uint32_t i = 0; i < BENCH_MAX_SAMPLES; i++ )
+    {
+        prvMakeSample( &( xSamples[ i ] ), i );
+    }
+
+    prvCheckOutput( xSamples );
+    prvCheckSplit( xSamples );
+
+    prvMeasure( xSamples, 1 );
+    prvMeasure( xSamples, 3 );
+    prvMeasure( xSamples, BENCH_MAX_SAMPLES );
+
+    return ( lFailures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,607 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/*
+ * Host simulation of repeated TLS reconnects, comparing mbedTLS allocations
+ * served directly by heap_4 with the size class pools of heap_pool.c in
+ * front of heap_4.
+ *
+ * A client and a server context perform mutually authenticated handshakes
+ * over an in-memory transport, as the transport does on the board: the
+ * contexts are set up once and mbedtls_ssl_session_reset is called after each
+ * connection. Between connections a set of long lived application buffers is
+ * reallocated, so that TLS allocations interleave with other heap users.
+ * After every connection the fragmentation of heap_4 is sampled.
+ *
+ * Usage: tls_pool_bench heap|pool [connections]
+ *
+ * See the README in Projects/posix_host for build instructions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+#if defined( MBEDTLS_PSA_CRYPTO_C )
+    #include "psa/crypto.h"
+#endif
+
+#include "heap_pool.h"
+
+#if !defined( MBEDTLS_PLATFORM_MEMORY ) || defined( MBEDTLS_PLATFORM_CALLOC_MACRO )
+    #error "tls_pool_bench needs mbedtls built with MBEDTLS_PLATFORM_MEMORY and without MBEDTLS_PLATFORM_CALLOC_MACRO"
+#endif
+
+#define BENCH_DEFAULT_CONNECTIONS    ( 1000 )
+#define BENCH_PIPE_SIZE              ( 32 * 1024 )
+#define BENCH_NUM_APP_BUFFERS        ( 24 )
+#define BENCH_APP_BUFFER_MAX         ( 2048 )
+#define BENCH_HOSTNAME               "tls-pool-bench"
+
+/* Size of the heap_4 block header, sizeof( BlockLink_t ) rounded up to portBYTE_ALIGNMENT */
+#define BENCH_HEAP_HEADER_SIZE       ( ( sizeof( void * ) + sizeof( size_t ) + 7U ) & ~( ( size_t ) 7U ) )
+
+typedef struct
+{
+    uint8_t pucData[ BENCH_PIPE_SIZE ];
+    size_t uxHead;
+    size_t uxCount;
+} BenchPipe_t;
+
+typedef struct
+{
+    BenchPipe_t * pxTx;
+    BenchPipe_t * pxRx;
+} BenchEndpoint_t;
+
+static BenchPipe_t xClientToServer;
+static BenchPipe_t xServerToClient;
+
+static void * pvAppBuffers[ BENCH_NUM_APP_BUFFERS ];
+
+/*-----------------------------------------------------------*/
+
+/* heap_4.c and heap_pool.c only need the scheduler and critical section calls, there is no scheduler here. */
+void vTaskSuspendAll( void )
+{
+}
+
+BaseType_t xTaskResumeAll( void )
+{
+    return pdFALSE;
+}
+
+void vPortEnterCritical( void )
+{
+}
+
+void vPortExitCritical( void )
+{
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000ULL ) + ( ( uint64_t ) xNow.tv_nsec / 1000ULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvHeapCalloc( size_t uxNum,
+                             size_t uxSize )
+{
+    size_t uxTotal = uxNum * uxSize;
+    void * pvBuffer = NULL;
+
+    if( ( uxTotal > 0 ) &&
+        ( ( uxTotal / uxSize ) == uxNum ) )
+    {
+        pvBuffer = pvPortMalloc( uxTotal );
+
+        if( pvBuffer != NULL )
+        {
+            explicit_bzero( pvBuffer, uxTotal );
+        }
+    }
+
+    return pvBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Block size from the heap_4 header, as malloc_usable_size does on the board */
+static size_t prvHeapBlockSize( void * pv )
+{
+    const size_t uxAllocatedBit = ( ( size_t ) 1 ) << ( ( sizeof( size_t ) * 8 ) - 1 );
+    size_t uxBlockSize = *( ( size_t * ) ( ( uint8_t * ) pv - sizeof( size_t ) ) );
+
+    return ( uxBlockSize & ~uxAllocatedBit ) - BENCH_HEAP_HEADER_SIZE;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvHeapFree( void * pv )
+{
+    if( pv != NULL )
+    {
+        explicit_bzero( pv, prvHeapBlockSize( pv ) );
+        vPortFree( pv );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Same order as mbedtls_platform_calloc in Common/sys/mbedtls_freertos_port.c, without the arena */
+static void * prvPoolCalloc( size_t uxNum,
+                             size_t uxSize )
+{
+    size_t uxTotal = uxNum * uxSize;
+    void * pvBuffer = NULL;
+
+    if( ( uxTotal > 0 ) &&
+        ( ( uxTotal / uxSize ) == uxNum ) )
+    {
+        pvBuffer = pvHeapPoolAlloc( uxTotal );
+
+        if( pvBuffer == NULL )
+        {
+            pvBuffer = prvHeapCalloc( uxNum, uxSize );
+        }
+    }
+
+    return pvBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPoolFree( void * pv )
+{
+    if( xHeapPoolContains( pv ) )
+    {
+        ( void ) xHeapPoolFree( pv );
+    }
+    else
+    {
+        prvHeapFree( pv );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvPipeSend( void * pvCtx,
+                        const unsigned char * pucBuf,
+                        size_t uxLen )
+{
+    BenchPipe_t * pxPipe = ( ( BenchEndpoint_t * ) pvCtx )->pxTx;
+    size_t uxSpace = BENCH_PIPE_SIZE - pxPipe->uxCount;
+    size_t uxCopy = ( uxLen < uxSpace ) ? uxLen : uxSpace;
+
+    if( uxCopy == 0 )
+    {
+        return MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
+    for( size_t i = 0; i < uxCopy; i++ )
+    {
+        pxPipe->pucData[ ( pxPipe->uxHead + pxPipe->uxCount + i ) % BENCH_PIPE_SIZE ] = pucBuf[ i ];
+    }
+
+    pxPipe->uxCount += uxCopy;
+
+    return ( int ) uxCopy;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvPipeRecv( void * pvCtx,
+                        unsigned char * pucBuf,
+                        size_t uxLen )
+{
+    BenchPipe_t * pxPipe = ( ( BenchEndpoint_t * ) pvCtx )->pxRx;
+    size_t uxCopy = ( uxLen < pxPipe->uxCount ) ? uxLen : pxPipe->uxCount;
+
+    if( uxCopy == 0 )
+    {
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    }
+
+    for( size_t i = 0; i < uxCopy; i++ )
+    {
+        pucBuf[ i ] = pxPipe->pucData[ pxPipe->uxHead ];
+        pxPipe->uxHead = ( pxPipe->uxHead + 1 ) % BENCH_PIPE_SIZE;
+    }
+
+    pxPipe->uxCount -= uxCopy;
+
+    return ( int ) uxCopy;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Self signed P-256 certificate used by both ends, which also acts as the CA */
+static int prvCreateCredentials( mbedtls_pk_context * pxKey,
+                                 mbedtls_x509_crt * pxCert,
+                                 mbedtls_ctr_drbg_context * pxDrbg )
+{
+    static unsigned char pucDer[ 1024 ];
+    mbedtls_x509write_cert xWriter;
+    mbedtls_mpi xSerial;
+    int lResult = 0;
+
+    mbedtls_x509write_crt_init( &xWriter );
+    mbedtls_mpi_init( &xSerial );
+
+    lResult = mbedtls_pk_setup( pxKey, mbedtls_pk_info_from_type( MBEDTLS_PK_ECKEY ) );
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_ecp_gen_key( MBEDTLS_ECP_DP_SECP256R1, mbedtls_pk_ec( *pxKey ),
+                                       mbedtls_ctr_drbg_random, pxDrbg );
+    }
+
+    if( lResult == 0 )
+    {
+        mbedtls_x509write_crt_set_version( &xWriter, MBEDTLS_X509_CRT_VERSION_3 );
+        mbedtls_x509write_crt_set_md_alg( &xWriter, MBEDTLS_MD_SHA256 );
+        mbedtls_x509write_crt_set_subject_key( &xWriter, pxKey );
+        mbedtls_x509write_crt_set_issuer_key( &xWriter, pxKey );
+
+        lResult = mbedtls_mpi_lset( &xSerial, 1 );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_x509write_crt_set_serial( &xWriter, &xSerial );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_x509write_crt_set_subject_name( &xWriter, "CN=" BENCH_HOSTNAME );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_x509write_crt_set_issuer_name( &xWriter, "CN=" BENCH_HOSTNAME );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_x509write_crt_set_validity( &xWriter, "20240101000000", "20991231235959" );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_x509write_crt_set_basic_constraints( &xWriter, 1, -1 );
+    }
+
+    if( lResult == 0 )
+    {
+        /* The certificate is written at the end of the buffer */
+        lResult = mbedtls_x509write_crt_der( &xWriter, pucDer, sizeof( pucDer ), mbedtls_ctr_drbg_random, pxDrbg );
+    }
+
+    if( lResult > 0 )
+    {
+        lResult = mbedtls_x509_crt_parse_der( pxCert, &pucDer[ sizeof( pucDer ) - lResult ], ( size_t ) lResult );
+    }
+
+    mbedtls_mpi_free( &xSerial );
+    mbedtls_x509write_crt_free( &xWriter );
+
+    return lResult;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Long lived allocations made by the rest of the system between connections */
+static void prvChurnAppBuffers( void )
+{
+    for( size_t i = 0; i < 4; i++ )
+    {
+        size_t uxIndex = ( size_t ) rand() % BENCH_NUM_APP_BUFFERS;
+
+        vPortFree( pvAppBuffers[ uxIndex ] );
+        pvAppBuffers[ uxIndex ] = pvPortMalloc( 64 + ( ( size_t ) rand() % BENCH_APP_BUFFER_MAX ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvFragmentationPct( const HeapStats_t * pxStats )
+{
+    uint32_t ulPct = 0;
+
+    if( pxStats->xAvailableHeapSpaceInBytes > 0 )
+    {
+        ulPct = ( uint32_t ) ( 100U - ( ( 100U * ( uint64_t ) pxStats->xSizeOfLargestFreeBlockInBytes ) /
+                                        pxStats->xAvailableHeapSpaceInBytes ) );
+    }
+
+    return ulPct;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvHandshake( mbedtls_ssl_context * pxClient,
+                         mbedtls_ssl_context * pxServer )
+{
+    int lClientResult = MBEDTLS_ERR_SSL_WANT_READ;
+    int lServerResult = MBEDTLS_ERR_SSL_WANT_READ;
+
+    while( ( lClientResult != 0 ) || ( lServerResult != 0 ) )
+    {
+        if( lClientResult != 0 )
+        {
+            lClientResult = mbedtls_ssl_handshake( pxClient );
+        }
+
+        if( lServerResult != 0 )
+        {
+            lServerResult = mbedtls_ssl_handshake( pxServer );
+        }
+
+        if( ( ( lClientResult != 0 ) && ( lClientResult != MBEDTLS_ERR_SSL_WANT_READ ) && ( lClientResult != MBEDTLS_ERR_SSL_WANT_WRITE ) ) ||
+            ( ( lServerResult != 0 ) && ( lServerResult != MBEDTLS_ERR_SSL_WANT_READ ) && ( lServerResult != MBEDTLS_ERR_SSL_WANT_WRITE ) ) )
+        {
+            fprintf( stderr, "Handshake failed: client -0x%04x, server -0x%04x\n",
+                     ( unsigned int ) -lClientResult, ( unsigned int ) -lServerResult );
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char * argv[] )
+{
+    mbedtls_entropy_context xEntropy;
+    mbedtls_ctr_drbg_context xDrbg;
+    mbedtls_pk_context xKey;
+    mbedtls_x509_crt xCert;
+    mbedtls_ssl_config xClientConf;
+    mbedtls_ssl_config xServerConf;
+    mbedtls_ssl_context xClient;
+    mbedtls_ssl_context xServer;
+    BenchEndpoint_t xClientEndpoint = { &xClientToServer, &xServerToClient };
+    BenchEndpoint_t xServerEndpoint = { &xServerToClient, &xClientToServer };
+    unsigned char pucRecord[ 256 ];
+    uint32_t ulConnections = BENCH_DEFAULT_CONNECTIONS;
+    uint64_t ullTotalUs = 0;
+    uint64_t ullMaxUs = 0;
+    uint32_t ulMaxFragPct = 0;
+    size_t uxMinLargestFree = SIZE_MAX;
+    HeapStats_t xStats = { 0 };
+    int lResult = 0;
+
+    if( ( argc < 2 ) ||
+        ( ( strcmp( argv[ 1 ], "heap" ) != 0 ) && ( strcmp( argv[ 1 ], "pool" ) != 0 ) ) )
+    {
+        fprintf( stderr, "Usage: %s heap|pool [connections]\n", argv[ 0 ] );
+        return EXIT_FAILURE;
+    }
+
+    if( strcmp( argv[ 1 ], "pool" ) == 0 )
+    {
+        ( void ) mbedtls_platform_set_calloc_free( prvPoolCalloc, prvPoolFree );
+    }
+    else
+    {
+        ( void ) mbedtls_platform_set_calloc_free( prvHeapCalloc, prvHeapFree );
+    }
+
+    if( argc > 2 )
+    {
+        ulConnections = ( uint32_t ) strtoul( argv[ 2 ], NULL, 10 );
+    }
+
+    srand( 1 );
+
+    #if defined( MBEDTLS_PSA_CRYPTO_C )
+        ( void ) psa_crypto_init();
+    #endif
+
+    mbedtls_entropy_init( &xEntropy );
+    mbedtls_ctr_drbg_init( &xDrbg );
+    mbedtls_pk_init( &xKey );
+    mbedtls_x509_crt_init( &xCert );
+    mbedtls_ssl_config_init( &xClientConf );
+    mbedtls_ssl_config_init( &xServerConf );
+    mbedtls_ssl_init( &xClient );
+    mbedtls_ssl_init( &xServer );
+
+    lResult = mbedtls_ctr_drbg_seed( &xDrbg, mbedtls_entropy_func, &xEntropy, NULL, 0 );
+
+    if( lResult == 0 )
+    {
+        lResult = prvCreateCredentials( &xKey, &xCert, &xDrbg );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_ssl_config_defaults( &xClientConf, MBEDTLS_SSL_IS_CLIENT,
+                                               MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_ssl_config_defaults( &xServerConf, MBEDTLS_SSL_IS_SERVER,
+                                               MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT );
+    }
+
+    if( lResult == 0 )
+    {
+        mbedtls_ssl_conf_rng( &xClientConf, mbedtls_ctr_drbg_random, &xDrbg );
+        mbedtls_ssl_conf_rng( &xServerConf, mbedtls_ctr_drbg_random, &xDrbg );
+        mbedtls_ssl_conf_authmode( &xClientConf, MBEDTLS_SSL_VERIFY_REQUIRED );
+        mbedtls_ssl_conf_authmode( &xServerConf, MBEDTLS_SSL_VERIFY_REQUIRED );
+        mbedtls_ssl_conf_ca_chain( &xClientConf, &xCert, NULL );
+        mbedtls_ssl_conf_ca_chain( &xServerConf, &xCert, NULL );
+
+        lResult = mbedtls_ssl_conf_own_cert( &xClientConf, &xCert, &xKey );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_ssl_conf_own_cert( &xServerConf, &xCert, &xKey );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_ssl_setup( &xClient, &xClientConf );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_ssl_setup( &xServer, &xServerConf );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_ssl_set_hostname( &xClient, BENCH_HOSTNAME );
+    }
+
+    if( lResult != 0 )
+    {
+        fprintf( stderr, "Setup failed: -0x%04x\n", ( unsigned int ) -lResult );
+        return EXIT_FAILURE;
+    }
+
+    mbedtls_ssl_set_bio( &xClient, &xClientEndpoint, prvPipeSend, prvPipeRecv, NULL );
+    mbedtls_ssl_set_bio( &xServer, &xServerEndpoint, prvPipeSend, prvPipeRecv, NULL );
+
+    for( uint32_t ulConnection = 0; ( ulConnection < ulConnections ) && ( lResult == 0 ); ulConnection++ )
+    {
+        uint64_t ullStartUs = 0;
+        uint64_t ullElapsedUs = 0;
+
+        prvChurnAppBuffers();
+
+        ullStartUs = prvNowUs();
+        lResult = prvHandshake( &xClient, &xServer );
+        ullElapsedUs = prvNowUs() - ullStartUs;
+
+        ullTotalUs += ullElapsedUs;
+        ullMaxUs = ( ullElapsedUs > ullMaxUs ) ? ullElapsedUs : ullMaxUs;
+
+        /* One application record in each direction */
+        if( ( lResult == 0 ) &&
+            ( mbedtls_ssl_write( &xClient, ( const unsigned char * ) "ping", 4 ) != 4 ) )
+        {
+            lResult = -1;
+        }
+
+        if( ( lResult == 0 ) &&
+            ( mbedtls_ssl_read( &xServer, pucRecord, sizeof( pucRecord ) ) != 4 ) )
+        {
+            lResult = -1;
+        }
+
+        ( void ) mbedtls_ssl_close_notify( &xClient );
+        ( void ) mbedtls_ssl_session_reset( &xClient );
+        ( void ) mbedtls_ssl_session_reset( &xServer );
+        xClientToServer.uxCount = 0;
+        xServerToClient.uxCount = 0;
+
+        vPortGetHeapStats( &xStats );
+
+        if( prvFragmentationPct( &xStats ) > ulMaxFragPct )
+        {
+            ulMaxFragPct = prvFragmentationPct( &xStats );
+        }
+
+        if( xStats.xSizeOfLargestFreeBlockInBytes < uxMinLargestFree )
+        {
+            uxMinLargestFree = xStats.xSizeOfLargestFreeBlockInBytes;
+        }
+    }
+
+    if( lResult != 0 )
+    {
+        fprintf( stderr, "Connection failed\n" );
+        return EXIT_FAILURE;
+    }
+
+    printf( "mode: %s, %lu connections\n", argv[ 1 ], ( unsigned long ) ulConnections );
+    printf( "handshake: %lu us average, %lu us worst\n",
+            ( unsigned long ) ( ullTotalUs / ulConnections ), ( unsigned long ) ullMaxUs );
+    printf( "heap_4 after reconnect: worst fragmentation %lu%%, smallest largest free block %lu bytes\n",
+            ( unsigned long ) ulMaxFragPct, ( unsigned long ) uxMinLargestFree );
+    printf( "heap_4 at end: %lu free bytes in %lu blocks, minimum ever free %lu bytes\n",
+            ( unsigned long ) xStats.xAvailableHeapSpaceInBytes,
+            ( unsigned long ) xStats.xNumberOfFreeBlocks,
+            ( unsigned long ) xPortGetMinimumEverFreeHeapSize() );
+
+    if( strcmp( argv[ 1 ], "pool" ) == 0 )
+    {
+        HeapPoolClassInfo_t pxClasses[ HEAP_POOL_NUM_CLASSES ];
+        size_t uxNumClasses = uxHeapPoolGetInfo( pxClasses, HEAP_POOL_NUM_CLASSES );
+
+        printf( "\n%-6s %7s %7s %10s %10s\n", "class", "blocks", "peak", "allocs", "exhausted" );
+
+        for( size_t i = 0; i < uxNumClasses; i++ )
+        {
+            printf( "%-6lu %7lu %7lu %10lu %10lu\n",
+                    ( unsigned long ) pxClasses[ i ].uxBlockSize,
+                    ( unsigned long ) pxClasses[ i ].uxNumBlocks,
+                    ( unsigned long ) pxClasses[ i ].uxPeak,
+                    ( unsigned long ) pxClasses[ i ].ulAllocs,
+                    ( unsigned long ) pxClasses[ i ].ulExhausted );
+        }
+    }
+
+    mbedtls_ssl_free( &xClient );
+    mbedtls_ssl_free( &xServer );
+    mbedtls_ssl_config_free( &xClientConf );
+    mbedtls_ssl_config_free( &xServerConf );
+    mbedtls_x509_crt_free( &xCert );
+    mbedtls_pk_free( &xKey );
+    mbedtls_ctr_drbg_free( &xDrbg );
+    mbedtls_entropy_free( &xEntropy );
+
+    return EXIT_SUCCESS;
+}
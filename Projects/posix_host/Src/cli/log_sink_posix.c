@@ -0,0 +1,135 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Host log output. Stands in for the console UART driver of
+ * Common/cli/cli_uart_drv.c: early and dying gasp output is written to
+ * stdout directly, other log lines are drained from xLogMBuf by a task.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "message_buffer.h"
+
+#include "cli_prv.h"
+#include "logging.h"
+#include "hw_defs.h"
+#include "log_sink_posix.h"
+
+extern volatile StreamBufferHandle_t xLogMBuf;
+
+static UART_HandleTypeDef xStdoutHandle = { .lFd = STDOUT_FILENO };
+
+/*-----------------------------------------------------------*/
+
+UART_HandleTypeDef * vInitUartEarly( void )
+{
+    return &xStdoutHandle;
+}
+
+/*-----------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_UART_Transmit( UART_HandleTypeDef * pxHuart,
+                                     const uint8_t * pucData,
+                                     uint16_t usSize,
+                                     uint32_t ulTimeout )
+{
+    HAL_StatusTypeDef xStatus = HAL_OK;
+    size_t uxWritten = 0;
+
+    ( void ) ulTimeout;
+
+    while( ( xStatus == HAL_OK ) && ( uxWritten < usSize ) )
+    {
+        ssize_t xRslt = write( pxHuart->lFd, &( pucData[ uxWritten ] ), usSize - uxWritten );
+
+        if( xRslt > 0 )
+        {
+            uxWritten += ( size_t ) xRslt;
+        }
+        else if( errno != EINTR )
+        {
+            xStatus = HAL_ERROR;
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+void HAL_GPIO_WritePin( GPIO_TypeDef * pxPort,
+                        uint16_t usPin,
+                        GPIO_PinState xPinState )
+{
+    /* No status LEDs on the host */
+    ( void ) pxPort;
+    ( void ) usPin;
+    ( void ) xPinState;
+}
+
+/*-----------------------------------------------------------*/
+
+void vLogSinkTask( void * pvParameters )
+{
+    static char pcLine[ dlMAX_LOG_LINE_LENGTH + 1 ];
+
+    ( void ) pvParameters;
+
+    configASSERT( xLogMBuf != NULL );
+
+    for( ; ; )
+    {
+        size_t uxLen = xMessageBufferReceive( xLogMBuf, pcLine, dlMAX_LOG_LINE_LENGTH, portMAX_DELAY );
+
+        if( uxLen > 0 )
+        {
+            pcLine[ uxLen ] = '\n';
+            ( void ) HAL_UART_Transmit( &xStdoutHandle, ( uint8_t * ) pcLine, uxLen + 1, 0 );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vLogSinkFlush( TickType_t xTimeout )
+{
+    TickType_t xStartTicks = xTaskGetTickCount();
+
+    /* The sink task prints the pending lines while this task waits */
+    while( ( xMessageBufferIsEmpty( xLogMBuf ) == pdFALSE ) &&
+           ( ( xTaskGetTickCount() - xStartTicks ) < xTimeout ) )
+    {
+        vTaskDelay( 1 );
+    }
+
+    /* Let the sink finish writing the last line it received */
+    vTaskDelay( 1 );
+}
@@ -0,0 +1,307 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_ERROR
+#include "logging.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "lfs_util.h"
+#include "lfs.h"
+#include "lfs_port.h"
+
+/*
+ * LittleFS port backed by a file on the host. Uses the same geometry as the
+ * external NOR flash port so filesystem behavior matches the target.
+ */
+
+#ifndef LFS_FILE_BLOCK_SIZE
+#define LFS_FILE_BLOCK_SIZE     ( 4096 )
+#endif
+
+#ifndef LFS_FILE_BLOCK_COUNT
+#define LFS_FILE_BLOCK_COUNT    ( 16384 )
+#endif
+
+#define LFS_FILE_PROG_SIZE      ( 256 )
+#define LFS_FILE_ERASED_BYTE    ( 0xFF )
+
+struct LfsFilePortCtx
+{
+    SemaphoreHandle_t xMutex;
+    TickType_t xBlockTime;
+    int lFd;
+};
+
+/* Forward declarations */
+static int lfs_port_read( const struct lfs_config * c,
+                          lfs_block_t block,
+                          lfs_off_t off,
+                          void * pvBuffer,
+                          lfs_size_t size );
+
+static int lfs_port_prog( const struct lfs_config * pxCfg,
+                          lfs_block_t block,
+                          lfs_off_t off,
+                          const void * pvBuffer,
+                          lfs_size_t size );
+
+static int lfs_port_erase( const struct lfs_config * pxCfg,
+                           lfs_block_t block );
+
+static int lfs_port_sync( const struct lfs_config * c );
+
+static int lfs_port_lock( const struct lfs_config * c );
+
+static int lfs_port_unlock( const struct lfs_config * c );
+
+static void vPopulateConfig( struct lfs_config * pxCfg,
+                             struct LfsFilePortCtx * pxCtx )
+{
+    pxCfg->read_size = 1;
+    pxCfg->prog_size = LFS_FILE_PROG_SIZE;
+
+    pxCfg->block_count = LFS_FILE_BLOCK_COUNT;
+    pxCfg->block_size = LFS_FILE_BLOCK_SIZE;
+
+    pxCfg->context = pxCtx;
+
+    pxCfg->read = lfs_port_read;
+    pxCfg->prog = lfs_port_prog;
+    pxCfg->erase = lfs_port_erase;
+    pxCfg->sync = lfs_port_sync;
+
+    #ifdef LFS_THREADSAFE
+        pxCfg->lock = &lfs_port_lock;
+        pxCfg->unlock = &lfs_port_unlock;
+    #endif
+
+    pxCfg->block_cycles = 500;
+    pxCfg->cache_size = 4096;
+    pxCfg->lookahead_size = 256;
+
+    pxCfg->read_buffer = NULL;
+    pxCfg->prog_buffer = NULL;
+    pxCfg->lookahead_buffer = NULL;
+
+    pxCfg->name_max = 0;
+    pxCfg->file_max = 0;
+    pxCfg->attr_max = 0;
+    pxCfg->metadata_max = 0;
+}
+
+/* Grow a new or truncated image file to its full size with erased blocks */
+static BaseType_t prvFormatImage( int lFd )
+{
+    static uint8_t ucErasedBlock[ LFS_FILE_BLOCK_SIZE ];
+    BaseType_t xSuccess = pdTRUE;
+    off_t xSize = lseek( lFd, 0, SEEK_END );
+
+    ( void ) memset( ucErasedBlock, LFS_FILE_ERASED_BYTE, sizeof( ucErasedBlock ) );
+
+    if( xSize < 0 )
+    {
+        xSuccess = pdFALSE;
+    }
+    else
+    {
+        for( off_t xOffset = xSize - ( xSize % LFS_FILE_BLOCK_SIZE );
+             xOffset < ( ( off_t ) LFS_FILE_BLOCK_SIZE * LFS_FILE_BLOCK_COUNT );
+             xOffset += LFS_FILE_BLOCK_SIZE )
+        {
+            if( pwrite( lFd, ucErasedBlock, LFS_FILE_BLOCK_SIZE, xOffset ) != LFS_FILE_BLOCK_SIZE )
+            {
+                xSuccess = pdFALSE;
+                break;
+            }
+        }
+    }
+
+    return xSuccess;
+}
+
+/*
+ * Initializes littlefs on an image file on the host.
+ * @param pcImagePath Path of the image file
+ * @param xBlockTime Amount of time to wait for the filesystem lock
+ */
+const struct lfs_config * pxInitializeFileFs( const char * pcImagePath,
+                                              TickType_t xBlockTime )
+{
+    struct lfs_config * pxCfg = ( struct lfs_config * ) pvPortMalloc( sizeof( struct lfs_config ) );
+
+    configASSERT( pxCfg != NULL );
+
+    struct LfsFilePortCtx * pxCtx = ( struct LfsFilePortCtx * ) ( pvPortMalloc( sizeof( struct LfsFilePortCtx ) ) );
+
+    configASSERT( pxCtx != NULL );
+
+    pxCtx->xBlockTime = xBlockTime;
+    pxCtx->xMutex = xSemaphoreCreateMutex();
+
+    configASSERT( pxCtx->xMutex != NULL );
+
+    pxCtx->lFd = open( pcImagePath, O_RDWR | O_CREAT, 0644 );
+
+    if( pxCtx->lFd < 0 )
+    {
+        LogError( "Failed to open filesystem image %s: %d", pcImagePath, errno );
+    }
+
+    configASSERT( pxCtx->lFd >= 0 );
+
+    BaseType_t xSuccess = prvFormatImage( pxCtx->lFd );
+
+    configASSERT( xSuccess == pdTRUE );
+
+    vPopulateConfig( pxCfg, pxCtx );
+
+    ( void ) xSemaphoreGive( pxCtx->xMutex );
+
+    return pxCfg;
+}
+
+static int lfs_port_read( const struct lfs_config * c,
+                          lfs_block_t block,
+                          lfs_off_t off,
+                          void * pvBuffer,
+                          lfs_size_t size )
+{
+    configASSERT( c != NULL );
+    configASSERT( block < c->block_count );
+    configASSERT( pvBuffer != NULL );
+    configASSERT( size > 0 );
+
+    struct LfsFilePortCtx * pxCtx = ( struct LfsFilePortCtx * ) c->context;
+    off_t xOffset = ( ( off_t ) block * c->block_size ) + off;
+    int32_t lReturnValue = 0;
+
+    if( pread( pxCtx->lFd, pvBuffer, size, xOffset ) != ( ssize_t ) size )
+    {
+        lReturnValue = LFS_ERR_IO;
+    }
+
+    LogDebug( "Reading offset 0x%08lX, size: %lu, rv: %ld", ( unsigned long ) xOffset, ( unsigned long ) size, ( long ) lReturnValue );
+
+    return lReturnValue;
+}
+
+/* Programming can only clear bits, as on NOR flash */
+static int lfs_port_prog( const struct lfs_config * pxCfg,
+                          lfs_block_t block,
+                          lfs_off_t off,
+                          const void * pvBuffer,
+                          lfs_size_t size )
+{
+    configASSERT( pxCfg != NULL );
+    configASSERT( block < pxCfg->block_count );
+    configASSERT( pvBuffer != NULL );
+    configASSERT( size > 0 );
+    configASSERT( ( size % pxCfg->prog_size ) == 0 );
+
+    struct LfsFilePortCtx * pxCtx = ( struct LfsFilePortCtx * ) pxCfg->context;
+    off_t xOffset = ( ( off_t ) block * pxCfg->block_size ) + off;
+    const uint8_t * pucData = ( const uint8_t * ) pvBuffer;
+    uint8_t ucPage[ LFS_FILE_PROG_SIZE ];
+    int32_t lReturnValue = 0;
+
+    for( lfs_size_t ulDone = 0; ulDone < size; ulDone += LFS_FILE_PROG_SIZE )
+    {
+        if( pread( pxCtx->lFd, ucPage, LFS_FILE_PROG_SIZE, xOffset + ulDone ) != LFS_FILE_PROG_SIZE )
+        {
+            lReturnValue = LFS_ERR_IO;
+            break;
+        }
+
+        for( size_t i = 0; i < LFS_FILE_PROG_SIZE; i++ )
+        {
+            ucPage[ i ] &= pucData[ ulDone + i ];
+        }
+
+        if( pwrite( pxCtx->lFd, ucPage, LFS_FILE_PROG_SIZE, xOffset + ulDone ) != LFS_FILE_PROG_SIZE )
+        {
+            lReturnValue = LFS_ERR_IO;
+            break;
+        }
+    }
+
+    LogDebug( "Programming offset 0x%08lX, size: %lu, rv: %ld", ( unsigned long ) xOffset, ( unsigned long ) size, ( long ) lReturnValue );
+
+    return lReturnValue;
+}
+
+static int lfs_port_erase( const struct lfs_config * pxCfg,
+                           lfs_block_t block )
+{
+    static uint8_t ucErasedBlock[ LFS_FILE_BLOCK_SIZE ];
+
+    configASSERT( pxCfg != NULL );
+    configASSERT( block < pxCfg->block_count );
+
+    struct LfsFilePortCtx * pxCtx = ( struct LfsFilePortCtx * ) pxCfg->context;
+    off_t xOffset = ( off_t ) block * pxCfg->block_size;
+    int32_t lReturnValue = 0;
+
+    ( void ) memset( ucErasedBlock, LFS_FILE_ERASED_BYTE, sizeof( ucErasedBlock ) );
+
+    if( pwrite( pxCtx->lFd, ucErasedBlock, LFS_FILE_BLOCK_SIZE, xOffset ) != LFS_FILE_BLOCK_SIZE )
+    {
+        lReturnValue = LFS_ERR_IO;
+    }
+
+    LogDebug( "Erased block at offset 0x%08lX, rv: %ld", ( unsigned long ) xOffset, ( long ) lReturnValue );
+
+    return lReturnValue;
+}
+
+static int lfs_port_sync( const struct lfs_config * c )
+{
+    struct LfsFilePortCtx * pxCtx = ( struct LfsFilePortCtx * ) c->context;
+
+    return( ( fdatasync( pxCtx->lFd ) == 0 ) ? 0 : LFS_ERR_IO );
+}
+
+static int lfs_port_lock( const struct lfs_config * c )
+{
+    struct LfsFilePortCtx * pxCtx = ( struct LfsFilePortCtx * ) c->context;
+
+    return( ( xSemaphoreTake( pxCtx->xMutex, pxCtx->xBlockTime ) == pdTRUE ) ? 0 : -1 );
+}
+
+static int lfs_port_unlock( const struct lfs_config * c )
+{
+    struct LfsFilePortCtx * pxCtx = ( struct LfsFilePortCtx * ) c->context;
+
+    return( ( xSemaphoreGive( pxCtx->xMutex ) == pdTRUE ) ? 0 : -1 );
+}
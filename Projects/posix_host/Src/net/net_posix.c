@@ -0,0 +1,165 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Host replacements for the network task of Common/net/mxchip. The host
+ * network is up before the scheduler starts, so there is no link to manage.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "tls_transport_posix.h"
+#include "mx_netconn.h"
+
+/*-----------------------------------------------------------*/
+
+BaseType_t net_request_reconnect( void )
+{
+    LogWarn( "Link reconnect requested. The host network is not managed by the application." );
+
+    return pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+int sock_posix_setsockopt( int lSock,
+                           int lLevel,
+                           int lOptName,
+                           const void * pvOptVal,
+                           socklen_t xOptLen )
+{
+    int lRslt;
+
+    if( ( lLevel == SOL_SOCKET ) &&
+        ( ( lOptName == SO_RCVTIMEO ) || ( lOptName == SO_SNDTIMEO ) ) &&
+        ( xOptLen == sizeof( uint32_t ) ) )
+    {
+        uint32_t ulTimeoutMs;
+        struct timeval xTimeout;
+
+        ( void ) memcpy( &ulTimeoutMs, pvOptVal, sizeof( ulTimeoutMs ) );
+
+        xTimeout.tv_sec = ulTimeoutMs / 1000;
+        xTimeout.tv_usec = ( ulTimeoutMs % 1000 ) * 1000;
+
+        lRslt = setsockopt( lSock, lLevel, lOptName, &xTimeout, sizeof( xTimeout ) );
+    }
+    else
+    {
+        lRslt = setsockopt( lSock, lLevel, lOptName, pvOptVal, xOptLen );
+    }
+
+    return lRslt;
+}
+
+/*-----------------------------------------------------------*/
+
+int sock_posix_select( int lMaxFd,
+                       fd_set * pxReadSet,
+                       fd_set * pxWriteSet,
+                       fd_set * pxErrorSet,
+                       struct timeval * pxTimeout )
+{
+    fd_set xReadSet;
+    fd_set xWriteSet;
+    fd_set xErrorSet;
+    TickType_t xStartTicks = xTaskGetTickCount();
+    TickType_t xWaitTicks = portMAX_DELAY;
+    int lRslt;
+
+    FD_ZERO( &xReadSet );
+    FD_ZERO( &xWriteSet );
+    FD_ZERO( &xErrorSet );
+
+    /* select() modifies the sets, so keep the requested ones for each poll */
+    if( pxReadSet != NULL )
+    {
+        xReadSet = *pxReadSet;
+    }
+
+    if( pxWriteSet != NULL )
+    {
+        xWriteSet = *pxWriteSet;
+    }
+
+    if( pxErrorSet != NULL )
+    {
+        xErrorSet = *pxErrorSet;
+    }
+
+    if( pxTimeout != NULL )
+    {
+        xWaitTicks = pdMS_TO_TICKS( ( pxTimeout->tv_sec * 1000 ) + ( pxTimeout->tv_usec / 1000 ) );
+    }
+
+    for( ; ; )
+    {
+        struct timeval xPoll = { 0 };
+
+        if( pxReadSet != NULL )
+        {
+            *pxReadSet = xReadSet;
+        }
+
+        if( pxWriteSet != NULL )
+        {
+            *pxWriteSet = xWriteSet;
+        }
+
+        if( pxErrorSet != NULL )
+        {
+            *pxErrorSet = xErrorSet;
+        }
+
+        lRslt = select( lMaxFd, pxReadSet, pxWriteSet, pxErrorSet, &xPoll );
+
+        /* The tick signal of the POSIX port interrupts system calls */
+        if( ( lRslt < 0 ) && ( errno == EINTR ) )
+        {
+            lRslt = 0;
+        }
+
+        if( ( lRslt != 0 ) ||
+            ( ( xWaitTicks != portMAX_DELAY ) &&
+              ( ( xTaskGetTickCount() - xStartTicks ) >= xWaitTicks ) ) )
+        {
+            break;
+        }
+
+        vTaskDelay( 1 );
+    }
+
+    return lRslt;
+}
@@ -0,0 +1,67 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file  ota_pal.h
+ * @brief OTA PAL of the host build, see ota_pal_posix.c
+ */
+
+#ifndef OTA_PAL_H_
+#define OTA_PAL_H_
+
+#include <stdint.h>
+
+#include "ota.h"
+#include "PkiObject.h"
+
+OtaPalStatus_t otaPal_CreateFileForRx( OtaFileContext_t * const pxFileContext );
+
+int16_t otaPal_WriteBlock( OtaFileContext_t * const pxFileContext,
+                           uint32_t ulOffset,
+                           uint8_t * const pucData,
+                           uint32_t ulBlockSize );
+
+OtaPalStatus_t otaPal_CloseFile( OtaFileContext_t * const pxFileContext );
+
+OtaPalStatus_t otaPal_Abort( OtaFileContext_t * const pxFileContext );
+
+OtaPalStatus_t otaPal_ActivateNewImage( OtaFileContext_t * const pxFileContext );
+
+OtaPalStatus_t otaPal_ResetDevice( OtaFileContext_t * const pxFileContext );
+
+OtaPalStatus_t otaPal_SetPlatformImageState( OtaFileContext_t * const pxFileContext,
+                                             OtaImageState_t xState );
+
+OtaPalImageState_t otaPal_GetPlatformImageState( OtaFileContext_t * const pxFileContext );
+
+/*
+ * Sets the public key that image signatures are checked against. The key
+ * stored under OTA_SIGNING_KEY_LABEL is used until this is called.
+ */
+void otaPal_SetSigningKey( const PkiObject_t * pxSigningKey );
+
+#endif /* OTA_PAL_H_ */
@@ -0,0 +1,437 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * OTA PAL of the host build. The image is received into a regular file and
+ * its signature is checked on close as the ntz PAL does, against the SHA-256
+ * of the whole file. The platform image state is kept in a second file.
+ * Activating the image exits the process, as there is no bootloader to hand
+ * the image to.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ota_pal.h"
+#include "hw_defs.h"
+
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls_error_utils.h"
+#include "PkiObject.h"
+#include "tls_transport_config.h"
+
+#ifndef OTA_PAL_POSIX_IMAGE_PATH
+#define OTA_PAL_POSIX_IMAGE_PATH    "ota_image.bin"
+#endif
+
+#ifndef OTA_PAL_POSIX_STATE_PATH
+#define OTA_PAL_POSIX_STATE_PATH    "ota_image.state"
+#endif
+
+#define OTA_PAL_HASH_CHUNK_LEN      ( 4096U )
+
+static FILE * pxImageFile = NULL;
+
+static PkiObject_t xSigningKey;
+static BaseType_t xSigningKeySet = pdFALSE;
+
+/*-----------------------------------------------------------*/
+
+void otaPal_SetSigningKey( const PkiObject_t * pxSigningKey )
+{
+    configASSERT( pxSigningKey != NULL );
+
+    xSigningKey = *pxSigningKey;
+    xSigningKeySet = pdTRUE;
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvWriteImageState( OtaPalImageState_t xState )
+{
+    BaseType_t xResult = pdFALSE;
+    FILE * pxFile = fopen( OTA_PAL_POSIX_STATE_PATH, "w" );
+
+    if( pxFile != NULL )
+    {
+        xResult = ( fprintf( pxFile, "%d\n", ( int ) xState ) > 0 ) ? pdTRUE : pdFALSE;
+
+        if( fclose( pxFile ) != 0 )
+        {
+            xResult = pdFALSE;
+        }
+    }
+
+    if( xResult != pdTRUE )
+    {
+        LogError( "Failed to write the image state to %s.", OTA_PAL_POSIX_STATE_PATH );
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHashImage( FILE * pxFile,
+                                unsigned char * pucHash )
+{
+    static unsigned char pucChunk[ OTA_PAL_HASH_CHUNK_LEN ];
+    mbedtls_sha256_context xHashCtx;
+    int lRslt;
+
+    mbedtls_sha256_init( &xHashCtx );
+
+    lRslt = fseek( pxFile, 0, SEEK_SET );
+
+    if( lRslt == 0 )
+    {
+        lRslt = mbedtls_sha256_starts( &xHashCtx, 0 );
+    }
+
+    while( lRslt == 0 )
+    {
+        size_t uxRead = fread( pucChunk, 1, sizeof( pucChunk ), pxFile );
+
+        if( uxRead > 0 )
+        {
+            lRslt = mbedtls_sha256_update( &xHashCtx, pucChunk, uxRead );
+        }
+
+        if( uxRead < sizeof( pucChunk ) )
+        {
+            break;
+        }
+    }
+
+    if( ( lRslt == 0 ) && ( ferror( pxFile ) != 0 ) )
+    {
+        lRslt = -1;
+    }
+
+    if( lRslt == 0 )
+    {
+        lRslt = mbedtls_sha256_finish( &xHashCtx, pucHash );
+    }
+
+    mbedtls_sha256_free( &xHashCtx );
+
+    return ( lRslt == 0 ) ? pdTRUE : pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+static OtaPalStatus_t prvValidateSignature( const unsigned char * pucSignature,
+                                            const size_t uxSignatureLength,
+                                            const unsigned char * pucImageHash,
+                                            const size_t uxHashLength )
+{
+    OtaPalStatus_t uxStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    PkiObject_t xOtaSigningPubKey;
+    mbedtls_pk_context xPubKeyCtx;
+
+    if( ( pucSignature == NULL ) || ( uxSignatureLength == 0 ) )
+    {
+        return OTA_PAL_COMBINE_ERR( OtaPalBadSignerCert, 0 );
+    }
+
+    mbedtls_pk_init( &xPubKeyCtx );
+
+    if( xSigningKeySet == pdTRUE )
+    {
+        xOtaSigningPubKey = xSigningKey;
+    }
+    else
+    {
+        xOtaSigningPubKey = xPkiObjectFromLabel( OTA_SIGNING_KEY_LABEL );
+    }
+
+    if( xPkiReadPublicKey( &xPubKeyCtx, &xOtaSigningPubKey ) != PKI_SUCCESS )
+    {
+        LogError( "Failed to load OTA Signing public key." );
+        uxStatus = OTA_PAL_COMBINE_ERR( OtaPalBadSignerCert, 0 );
+    }
+
+    if( OTA_PAL_MAIN_ERR( uxStatus ) == OtaPalSuccess )
+    {
+        int lRslt = mbedtls_pk_verify( &xPubKeyCtx, MBEDTLS_MD_SHA256,
+                                       pucImageHash, uxHashLength,
+                                       pucSignature, uxSignatureLength );
+
+        if( lRslt != 0 )
+        {
+            MBEDTLS_MSG_IF_ERROR( lRslt, "OTA Image signature verification failed." );
+            uxStatus = OTA_PAL_COMBINE_ERR( OtaPalSignatureCheckFailed, lRslt );
+        }
+    }
+
+    mbedtls_pk_free( &xPubKeyCtx );
+
+    return uxStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+OtaPalStatus_t otaPal_CreateFileForRx( OtaFileContext_t * const pxFileContext )
+{
+    OtaPalStatus_t uxStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+
+    if( pxFileContext == NULL )
+    {
+        uxStatus = OTA_PAL_COMBINE_ERR( OtaPalNullFileContext, 0 );
+    }
+    else
+    {
+        if( pxImageFile != NULL )
+        {
+            ( void ) fclose( pxImageFile );
+        }
+
+        /* Truncates an image left over from an earlier download */
+        pxImageFile = fopen( OTA_PAL_POSIX_IMAGE_PATH, "w+b" );
+
+        if( pxImageFile == NULL )
+        {
+            LogError( "Failed to create %s.", OTA_PAL_POSIX_IMAGE_PATH );
+            uxStatus = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, 0 );
+        }
+        else
+        {
+            LogInfo( "Receiving a %lu byte image into %s.",
+                     ( unsigned long ) pxFileContext->fileSize, OTA_PAL_POSIX_IMAGE_PATH );
+        }
+
+        pxFileContext->pFile = ( void * ) pxImageFile;
+    }
+
+    return uxStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+int16_t otaPal_WriteBlock( OtaFileContext_t * const pxFileContext,
+                           uint32_t ulOffset,
+                           uint8_t * const pucData,
+                           uint32_t ulBlockSize )
+{
+    int16_t sBytesWritten = -1;
+
+    if( ( pxFileContext != NULL ) &&
+        ( pxImageFile != NULL ) &&
+        ( pucData != NULL ) &&
+        ( ulBlockSize <= INT16_MAX ) &&
+        ( fseek( pxImageFile, ( long ) ulOffset, SEEK_SET ) == 0 ) &&
+        ( fwrite( pucData, 1, ulBlockSize, pxImageFile ) == ulBlockSize ) )
+    {
+        sBytesWritten = ( int16_t ) ulBlockSize;
+    }
+    else
+    {
+        LogError( "Failed to write %lu bytes at offset %lu.",
+                  ( unsigned long ) ulBlockSize, ( unsigned long ) ulOffset );
+    }
+
+    return sBytesWritten;
+}
+
+/*-----------------------------------------------------------*/
+
+OtaPalStatus_t otaPal_CloseFile( OtaFileContext_t * const pxFileContext )
+{
+    OtaPalStatus_t uxStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    unsigned char pucHash[ 32 ];
+
+    if( ( pxFileContext == NULL ) || ( pxImageFile == NULL ) )
+    {
+        uxStatus = OTA_PAL_COMBINE_ERR( OtaPalNullFileContext, 0 );
+    }
+    else if( ( fflush( pxImageFile ) != 0 ) ||
+             ( prvHashImage( pxImageFile, pucHash ) != pdTRUE ) )
+    {
+        LogError( "Failed to hash %s.", OTA_PAL_POSIX_IMAGE_PATH );
+        uxStatus = OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
+    }
+    else if( pxFileContext->pSignature == NULL )
+    {
+        uxStatus = OTA_PAL_COMBINE_ERR( OtaPalSignatureCheckFailed, 0 );
+    }
+    else
+    {
+        uxStatus = prvValidateSignature( pxFileContext->pSignature->data,
+                                         pxFileContext->pSignature->size,
+                                         pucHash, sizeof( pucHash ) );
+    }
+
+    if( pxImageFile != NULL )
+    {
+        if( ( fclose( pxImageFile ) != 0 ) &&
+            ( OTA_PAL_MAIN_ERR( uxStatus ) == OtaPalSuccess ) )
+        {
+            uxStatus = OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
+        }
+
+        pxImageFile = NULL;
+    }
+
+    if( pxFileContext != NULL )
+    {
+        pxFileContext->pFile = NULL;
+    }
+
+    if( OTA_PAL_MAIN_ERR( uxStatus ) == OtaPalSuccess )
+    {
+        LogInfo( "Image signature verified." );
+    }
+    else
+    {
+        ( void ) remove( OTA_PAL_POSIX_IMAGE_PATH );
+    }
+
+    return uxStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+OtaPalStatus_t otaPal_Abort( OtaFileContext_t * const pxFileContext )
+{
+    if( pxImageFile != NULL )
+    {
+        ( void ) fclose( pxImageFile );
+        pxImageFile = NULL;
+        ( void ) remove( OTA_PAL_POSIX_IMAGE_PATH );
+    }
+
+    if( pxFileContext != NULL )
+    {
+        pxFileContext->pFile = NULL;
+    }
+
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+OtaPalStatus_t otaPal_ActivateNewImage( OtaFileContext_t * const pxFileContext )
+{
+    OtaPalStatus_t uxStatus = OTA_PAL_COMBINE_ERR( OtaPalActivateFailed, 0 );
+
+    if( prvWriteImageState( OtaPalImageStatePendingCommit ) == pdTRUE )
+    {
+        LogSys( "New image received in %s.", OTA_PAL_POSIX_IMAGE_PATH );
+        uxStatus = otaPal_ResetDevice( pxFileContext );
+    }
+
+    return uxStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+OtaPalStatus_t otaPal_ResetDevice( OtaFileContext_t * const pxFileContext )
+{
+    ( void ) pxFileContext;
+
+    vDoSystemReset();
+
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+/*-----------------------------------------------------------*/
+
+OtaPalStatus_t otaPal_SetPlatformImageState( OtaFileContext_t * const pxFileContext,
+                                             OtaImageState_t xState )
+{
+    OtaPalStatus_t uxStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    OtaPalImageState_t xPalState = OtaPalImageStateUnknown;
+
+    ( void ) pxFileContext;
+
+    switch( xState )
+    {
+        case OtaImageStateTesting:
+            xPalState = OtaPalImageStatePendingCommit;
+            break;
+
+        case OtaImageStateAccepted:
+            xPalState = OtaPalImageStateValid;
+            break;
+
+        case OtaImageStateRejected:
+        case OtaImageStateAborted:
+            xPalState = OtaPalImageStateInvalid;
+            break;
+
+        default:
+            uxStatus = OTA_PAL_COMBINE_ERR( OtaPalBadImageState, 0 );
+            break;
+    }
+
+    if( ( OTA_PAL_MAIN_ERR( uxStatus ) == OtaPalSuccess ) &&
+        ( prvWriteImageState( xPalState ) != pdTRUE ) )
+    {
+        uxStatus = OTA_PAL_COMBINE_ERR( ( xState == OtaImageStateAccepted ) ? OtaPalCommitFailed : OtaPalRejectFailed, 0 );
+    }
+
+    return uxStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+OtaPalImageState_t otaPal_GetPlatformImageState( OtaFileContext_t * const pxFileContext )
+{
+    /* Without a state file the running image has never been updated */
+    OtaPalImageState_t xPalState = OtaPalImageStateValid;
+    FILE * pxFile = fopen( OTA_PAL_POSIX_STATE_PATH, "r" );
+
+    ( void ) pxFileContext;
+
+    if( pxFile != NULL )
+    {
+        int lState = 0;
+
+        if( ( fscanf( pxFile, "%d", &lState ) == 1 ) &&
+            ( lState >= ( int ) OtaPalImageStateUnknown ) &&
+            ( lState <= ( int ) OtaPalImageStateInvalid ) )
+        {
+            xPalState = ( OtaPalImageState_t ) lState;
+        }
+        else
+        {
+            xPalState = OtaPalImageStateUnknown;
+        }
+
+        ( void ) fclose( pxFile );
+    }
+
+    return xPalState;
+}
@@ -0,0 +1,170 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Kernel hooks and system services that the board provides through
+ * app_main.c, hal_init.c and the RNG peripheral.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/random.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "hw_defs.h"
+
+/*-----------------------------------------------------------*/
+
+/* Fills pucOutput from the kernel entropy pool, in place of the RNG peripheral */
+static int prvReadRandom( unsigned char * pucOutput,
+                          size_t uxLen )
+{
+    size_t uxRead = 0;
+
+    while( uxRead < uxLen )
+    {
+        ssize_t xRslt = getrandom( &( pucOutput[ uxRead ] ), uxLen - uxRead, 0 );
+
+        if( xRslt > 0 )
+        {
+            uxRead += ( size_t ) xRslt;
+        }
+        else if( errno != EINTR )
+        {
+            break;
+        }
+    }
+
+    return ( uxRead == uxLen ) ? 0 : -1;
+}
+
+/*-----------------------------------------------------------*/
+
+/* Entropy source of MBEDTLS_ENTROPY_HARDWARE_ALT */
+int mbedtls_hardware_poll( void * pvCtx,
+                           unsigned char * pucOutput,
+                           size_t uxLen,
+                           size_t * puxOutputLen )
+{
+    int lRslt = prvReadRandom( pucOutput, uxLen );
+
+    ( void ) pvCtx;
+
+    *puxOutputLen = ( lRslt == 0 ) ? uxLen : 0;
+
+    return lRslt;
+}
+
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxRand( void )
+{
+    UBaseType_t uxValue = 0;
+    int lRslt = prvReadRandom( ( unsigned char * ) &uxValue, sizeof( uxValue ) );
+
+    configASSERT( lRslt == 0 );
+
+    return uxValue;
+}
+
+/*-----------------------------------------------------------*/
+
+/* heap_3 passes allocations to the C library, which does not report its free space */
+size_t xPortGetFreeHeapSize( void )
+{
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+#ifndef xPortIsInsideInterrupt
+
+/* Overridden if the kernel port provides its own */
+__attribute__( ( weak ) ) long xPortIsInsideInterrupt( void )
+{
+    return pdFALSE;
+}
+#endif
+
+/*-----------------------------------------------------------*/
+
+void vDoSystemReset( void )
+{
+    LogSys( "System reset requested. Exiting." );
+
+    exit( EXIT_SUCCESS );
+}
+
+/*-----------------------------------------------------------*/
+
+/* configUSE_STATIC_ALLOCATION is set to 1, so the application must provide an
+ * implementation of vApplicationGetIdleTaskMemory() to provide the memory that is
+ * used by the Idle task. */
+void vApplicationGetIdleTaskMemory( StaticTask_t ** ppxIdleTaskTCBBuffer,
+                                    StackType_t ** ppxIdleTaskStackBuffer,
+                                    uint32_t * pulIdleTaskStackSize )
+{
+    static StaticTask_t xIdleTaskTCB;
+    static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+/*-----------------------------------------------------------*/
+
+/* configUSE_STATIC_ALLOCATION and configUSE_TIMERS are both set to 1, so the
+ * application must provide an implementation of vApplicationGetTimerTaskMemory()
+ * to provide the memory that is used by the Timer service task. */
+void vApplicationGetTimerTaskMemory( StaticTask_t ** ppxTimerTaskTCBBuffer,
+                                     StackType_t ** ppxTimerTaskStackBuffer,
+                                     uint32_t * pulTimerTaskStackSize )
+{
+    static StaticTask_t xTimerTaskTCB;
+    static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+    *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+    *ppxTimerTaskStackBuffer = uxTimerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+
+/*-----------------------------------------------------------*/
+
+void vApplicationMallocFailedHook( void )
+{
+    LogError( "Malloc failed" );
+
+    vDyingGasp();
+    abort();
+}
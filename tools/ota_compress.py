@@ -0,0 +1,223 @@
+#!/usr/bin/env python
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+#
+#
+"""
+Compress a firmware image for OTA delivery.
+
+The output is a 16 byte header followed by a heatshrink compatible LZSS
+bitstream which is decoded incrementally by ota_pal_decompress.c on the
+device. Use --verify to decompress the result again and compare it against
+the input image.
+"""
+import argparse
+import struct
+import sys
+
+HEADER_MAGIC = b"HSZ1"
+HEADER_FORMAT = "<4sBBHII"
+HEADER_LEN = struct.calcsize(HEADER_FORMAT)
+
+WINDOW_BITS_MIN = 4
+WINDOW_BITS_MAX = 11
+
+MIN_MATCH_LEN = 3
+MAX_CHAIN_LEN = 64
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.count = 0
+
+    def write(self, value, num_bits):
+        self.acc = (self.acc << num_bits) | (value & ((1 << num_bits) - 1))
+        self.count += num_bits
+        while self.count >= 8:
+            self.count -= 8
+            self.out.append((self.acc >> self.count) & 0xFF)
+        self.acc &= (1 << self.count) - 1
+
+    def flush(self):
+        if self.count > 0:
+            self.out.append((self.acc << (8 - self.count)) & 0xFF)
+            self.acc = 0
+            self.count = 0
+        return bytes(self.out)
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+        self.acc = 0
+        self.count = 0
+
+    def read(self, num_bits):
+        while self.count < num_bits:
+            if self.pos >= len(self.data):
+                raise ValueError("Compressed stream is truncated")
+            self.acc = (self.acc << 8) | self.data[self.pos]
+            self.pos += 1
+            self.count += 8
+        self.count -= num_bits
+        value = (self.acc >> self.count) & ((1 << num_bits) - 1)
+        self.acc &= (1 << self.count) - 1
+        return value
+
+
+def compress(data, window_bits, lookahead_bits):
+    """Greedy LZSS encoder using hash chains over 3 byte prefixes."""
+    window_size = 1 << window_bits
+    max_match = 1 << lookahead_bits
+    writer = BitWriter()
+    chains = {}
+    pos = 0
+    length = len(data)
+
+    def insert(index):
+        if index + MIN_MATCH_LEN <= length:
+            key = data[index:index + MIN_MATCH_LEN]
+            chain = chains.setdefault(key, [])
+            chain.append(index)
+            if len(chain) > MAX_CHAIN_LEN:
+                del chain[0]
+
+    while pos < length:
+        best_len = 0
+        best_dist = 0
+
+        if pos + MIN_MATCH_LEN <= length:
+            limit = min(max_match, length - pos)
+            for candidate in reversed(chains.get(data[pos:pos + MIN_MATCH_LEN], [])):
+                dist = pos - candidate
+                if dist > window_size:
+                    break
+                match_len = 0
+                while match_len < limit and data[candidate + match_len] == data[pos + match_len]:
+                    match_len += 1
+                if match_len > best_len:
+                    best_len = match_len
+                    best_dist = dist
+                    if match_len == limit:
+                        break
+
+        if best_len >= MIN_MATCH_LEN:
+            writer.write(0, 1)
+            writer.write(best_dist - 1, window_bits)
+            writer.write(best_len - 1, lookahead_bits)
+            for index in range(pos, pos + best_len):
+                insert(index)
+            pos += best_len
+        else:
+            writer.write(1, 1)
+            writer.write(data[pos], 8)
+            insert(pos)
+            pos += 1
+
+    header = struct.pack(HEADER_FORMAT, HEADER_MAGIC, window_bits, lookahead_bits, 0, length, 0)
+    return header + writer.flush()
+
+
+def decompress(blob):
+    """Reference decoder mirroring ota_pal_decompress.c."""
+    magic, window_bits, lookahead_bits, reserved16, image_size, reserved32 = struct.unpack_from(HEADER_FORMAT, blob)
+
+    if magic != HEADER_MAGIC:
+        raise ValueError("Missing compressed image header")
+
+    if reserved16 != 0 or reserved32 != 0:
+        raise ValueError("Reserved header fields must be zero")
+
+    mask = (1 << window_bits) - 1
+    window = bytearray(1 << window_bits)
+    head = 0
+    out = bytearray()
+    reader = BitReader(blob[HEADER_LEN:])
+
+    def emit(byte):
+        nonlocal head
+        window[head] = byte
+        head = (head + 1) & mask
+        out.append(byte)
+
+    while len(out) < image_size:
+        if reader.read(1):
+            emit(reader.read(8))
+        else:
+            dist = reader.read(window_bits) + 1
+            count = reader.read(lookahead_bits) + 1
+            for _ in range(count):
+                if len(out) >= image_size:
+                    raise ValueError("Back-reference runs past the end of the image")
+                emit(window[(head - dist) & mask])
+
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compress a firmware image for OTA delivery.")
+    parser.add_argument("-i", "--input", required=True, help="Path of the firmware image (.bin).")
+    parser.add_argument("-o", "--output", required=True, help="Path of the compressed image to write.")
+    parser.add_argument("-w", "--window-bits", type=int, default=10,
+                        help="log2 of the back-reference window size ({}-{}).".format(WINDOW_BITS_MIN, WINDOW_BITS_MAX))
+    parser.add_argument("-l", "--lookahead-bits", type=int, default=4,
+                        help="log2 of the maximum back-reference length.")
+    parser.add_argument("--verify", action="store_true",
+                        help="Decompress the output again and compare it with the input.")
+    args = parser.parse_args()
+
+    if not WINDOW_BITS_MIN <= args.window_bits <= WINDOW_BITS_MAX:
+        parser.error("window bits must be between {} and {}".format(WINDOW_BITS_MIN, WINDOW_BITS_MAX))
+
+    if not 3 <= args.lookahead_bits < args.window_bits:
+        parser.error("lookahead bits must be at least 3 and less than window bits")
+
+    with open(args.input, "rb") as f:
+        image = f.read()
+
+    if len(image) == 0:
+        parser.error("input image is empty")
+
+    blob = compress(image, args.window_bits, args.lookahead_bits)
+
+    with open(args.output, "wb") as f:
+        f.write(blob)
+
+    print("{}: {} -> {} bytes ({:.1f}%)".format(args.output, len(image), len(blob), 100.0 * len(blob) / len(image)))
+
+    if args.verify:
+        if decompress(blob) != image:
+            print("Verification FAILED: decompressed image does not match the input.")
+            return 1
+        print("Verification passed.")
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,211 @@
+#!/usr/bin/env python
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+#
+#
+"""
+Generate Common/app/telemetry_schema.h from an IoTConnect device template.
+
+The header holds a static table with one entry per template attribute: the
+pre-quoted JSON key, the attribute type and the location of the value in
+iotcU5IotTelemetry_t, taken from BINDINGS below. telemetry_serializer.c walks
+this table to write telemetry directly into a publish buffer. Run this script
+again whenever the device template or BINDINGS change.
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+TYPE_MAP = {
+    "INTEGER": "TELEMETRY_TYPE_INTEGER",
+    "DECIMAL": "TELEMETRY_TYPE_DECIMAL",
+}
+
+MOTION = ("TELEMETRY_SOURCE_MOTION", "TELEMETRY_STORAGE_INT32")
+ENV = ("TELEMETRY_SOURCE_ENV", "TELEMETRY_STORAGE_FLOAT")
+STATS_INT = ("TELEMETRY_SOURCE_MOTION_STATS", "TELEMETRY_STORAGE_INT32")
+STATS_FLOAT = ("TELEMETRY_SOURCE_MOTION_STATS", "TELEMETRY_STORAGE_FLOAT")
+
+# Member of iotcU5IotTelemetry_t holding each attribute. Attributes without a binding are never sent.
+BINDINGS = {
+    "acc_x": (MOTION, "xAcceleroAxes.x"),
+    "acc_y": (MOTION, "xAcceleroAxes.y"),
+    "acc_z": (MOTION, "xAcceleroAxes.z"),
+    "gyro_x": (MOTION, "xGyroAxes.x"),
+    "gyro_y": (MOTION, "xGyroAxes.y"),
+    "gyro_z": (MOTION, "xGyroAxes.z"),
+    "mgnt_x": (MOTION, "xMagnetoAxes.x"),
+    "mgnt_y": (MOTION, "xMagnetoAxes.y"),
+    "mgnt_Z": (MOTION, "xMagnetoAxes.z"),
+    "temp_0": (ENV, "xEnvSensorData.fTemperature0"),
+    "temp_1": (ENV, "xEnvSensorData.fTemperature1"),
+    "humidity": (ENV, "xEnvSensorData.fHumidity"),
+    "pressure": (ENV, "xEnvSensorData.fBarometricPressure"),
+    "acc_min_x": (STATS_INT, "xMotionStats.xAcceleroMin.x"),
+    "acc_min_y": (STATS_INT, "xMotionStats.xAcceleroMin.y"),
+    "acc_min_z": (STATS_INT, "xMotionStats.xAcceleroMin.z"),
+    "acc_max_x": (STATS_INT, "xMotionStats.xAcceleroMax.x"),
+    "acc_max_y": (STATS_INT, "xMotionStats.xAcceleroMax.y"),
+    "acc_max_z": (STATS_INT, "xMotionStats.xAcceleroMax.z"),
+    "acc_rms_x": (STATS_FLOAT, "xMotionStats.pfAcceleroRms[ 0 ]"),
+    "acc_rms_y": (STATS_FLOAT, "xMotionStats.pfAcceleroRms[ 1 ]"),
+    "acc_rms_z": (STATS_FLOAT, "xMotionStats.pfAcceleroRms[ 2 ]"),
+    "gyro_rms_x": (STATS_FLOAT, "xMotionStats.pfGyroRms[ 0 ]"),
+    "gyro_rms_y": (STATS_FLOAT, "xMotionStats.pfGyroRms[ 1 ]"),
+    "gyro_rms_z": (STATS_FLOAT, "xMotionStats.pfGyroRms[ 2 ]"),
+}
+
+HEADER_TEMPLATE = """/*
+ * Generated by tools/telemetry_schema_gen.py from {template}.
+ * Do not edit, run the script again after changing the device template or the bindings in the script.
+ */
+
+#ifndef APP_TELEMETRY_SCHEMA_H_
+#define APP_TELEMETRY_SCHEMA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app/sensor_telemetry.h"
+
+typedef enum
+{{
+    TELEMETRY_TYPE_INTEGER = 0,
+    TELEMETRY_TYPE_DECIMAL
+}} TelemetryFieldType_t;
+
+/* Validity flag of iotcU5IotTelemetry_t that covers a value */
+typedef enum
+{{
+    TELEMETRY_SOURCE_NONE = 0,
+    TELEMETRY_SOURCE_MOTION,
+    TELEMETRY_SOURCE_ENV,
+    TELEMETRY_SOURCE_MOTION_STATS
+}} TelemetryFieldSource_t;
+
+typedef enum
+{{
+    TELEMETRY_STORAGE_INT32 = 0,
+    TELEMETRY_STORAGE_FLOAT
+}} TelemetryFieldStorage_t;
+
+typedef enum
+{{
+{enum_entries}
+    TELEMETRY_FIELD_COUNT
+}} TelemetryFieldId_t;
+
+typedef struct
+{{
+    const char * pcKey;    /*!< Key including quotes and the trailing ':' */
+    uint8_t ucKeyLength;
+    uint8_t ucType;        /*!< TelemetryFieldType_t */
+    uint8_t ucSource;      /*!< TelemetryFieldSource_t, TELEMETRY_SOURCE_NONE if the attribute is not sent */
+    uint8_t ucStorage;     /*!< TelemetryFieldStorage_t */
+    uint16_t usOffset;     /*!< Offset of the value in iotcU5IotTelemetry_t */
+}} TelemetrySchemaField_t;
+
+static const TelemetrySchemaField_t xTelemetrySchema[ TELEMETRY_FIELD_COUNT ] =
+{{
+{table_entries}
+}};
+
+#endif /* APP_TELEMETRY_SCHEMA_H_ */
+"""
+
+
+def field_id(name):
+    ident = re.sub(r"[^0-9A-Za-z]", "_", name).upper()
+    return "TELEMETRY_FIELD_" + ident
+
+
+def generate(template_path, template_name):
+    with open(template_path, "r") as f:
+        template = json.load(f)
+
+    enum_entries = []
+    table_entries = []
+    seen = set()
+
+    for attribute in template.get("attributes", []):
+        name = attribute["name"]
+        attr_type = attribute["type"]
+
+        if attr_type not in TYPE_MAP:
+            raise ValueError("Attribute {} has unsupported type {}".format(name, attr_type))
+
+        ident = field_id(name)
+
+        if ident in seen:
+            raise ValueError("Attribute {} maps to duplicate identifier {}".format(name, ident))
+
+        if not re.match(r"^[0-9A-Za-z_]+$", name):
+            raise ValueError("Attribute name {} must not need escaping in JSON".format(name))
+
+        seen.add(ident)
+        key = '"{}":'.format(name)
+
+        if name in BINDINGS:
+            (source, storage), member = BINDINGS[name]
+            binding = "{}, {}, offsetof( iotcU5IotTelemetry_t, {} )".format(source, storage, member)
+        else:
+            print("Warning: attribute {} has no binding and will not be sent".format(name), file=sys.stderr)
+            binding = "TELEMETRY_SOURCE_NONE, TELEMETRY_STORAGE_INT32, 0"
+
+        enum_entries.append("    {},".format(ident))
+        table_entries.append('    [ {} ] = {{ "\\"{}\\":", {}, {}, {} }},'.format(ident, name, len(key), TYPE_MAP[attr_type], binding))
+
+    for name in BINDINGS:
+        if name not in [attribute["name"] for attribute in template.get("attributes", [])]:
+            raise ValueError("Binding {} does not match an attribute of the template".format(name))
+
+    return HEADER_TEMPLATE.format(template=template_name,
+                                  enum_entries="\n".join(enum_entries),
+                                  table_entries="\n".join(table_entries))
+
+
+def main():
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description="Generate the telemetry schema header from an IoTConnect device template.")
+    parser.add_argument("-t", "--template", default=os.path.join(root, "IoTConnect", "templates", "device-template.json"),
+                        help="Path of the device template.")
+    parser.add_argument("-o", "--output", default=os.path.join(root, "Common", "app", "telemetry_schema.h"),
+                        help="Path of the header to write.")
+    args = parser.parse_args()
+
+    template_name = os.path.relpath(args.template, root).replace(os.sep, "/")
+    header = generate(args.template, template_name)
+
+    with open(args.output, "w", newline="\n") as f:
+        f.write(header)
+
+    print("Wrote {}".format(args.output))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
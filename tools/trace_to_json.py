@@ -0,0 +1,234 @@
+#!/usr/bin/env python
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+#
+#
+"""
+Convert a trace ring dump to the Chrome trace event JSON format.
+
+Capture the output of the "trace dump" CLI command, including the
+-----BEGIN TRACE----- and -----END TRACE----- lines, to a file. Any other
+console output in the file is ignored. Open the resulting JSON file in
+https://ui.perfetto.dev or chrome://tracing. Use --summary to print the
+count, total, mean and maximum duration of each trace point.
+
+Timestamps are DWT cycle counts, which wrap every 2^32 cycles (about 26 s at
+160 MHz). Gaps between consecutive events longer than that cannot be detected.
+"""
+import argparse
+import base64
+import json
+import re
+import struct
+import sys
+
+HEADER_MAGIC = b"TRC1"
+HEADER_FORMAT = "<4sBBBBIII"
+HEADER_LEN = struct.calcsize(HEADER_FORMAT)
+EVENT_FORMAT = "<IIIBBH"
+EVENT_LEN = struct.calcsize(EVENT_FORMAT)
+
+TYPE_BEGIN = 0
+TYPE_END = 1
+TYPE_INSTANT = 2
+
+# MQTTAgentCommandType_t, the argument of agent_cmd and agent_enqueue
+AGENT_COMMANDS = ["process_loop", "process_loop", "publish", "subscribe", "unsubscribe",
+                  "ping", "connect", "disconnect", "terminate"]
+
+DUMP_RE = re.compile(r"-----BEGIN TRACE-----(.*?)-----END TRACE-----", re.DOTALL)
+
+
+def read_name(blob, pos):
+    length = blob[pos]
+    return blob[pos + 1:pos + 1 + length].decode("utf-8", "replace"), pos + 1 + length
+
+
+def parse_dump(blob):
+    """Return the core clock, overwritten event count, id names, task names and events."""
+    magic, version, event_len, num_ids, num_tasks, clock, num_events, overwritten = \
+        struct.unpack_from(HEADER_FORMAT, blob)
+
+    if magic != HEADER_MAGIC:
+        raise ValueError("Missing trace dump header")
+
+    if version != 1 or event_len != EVENT_LEN:
+        raise ValueError("Unsupported trace dump version {} with {} byte events".format(version, event_len))
+
+    pos = HEADER_LEN
+    id_names = []
+    for _ in range(num_ids):
+        name, pos = read_name(blob, pos)
+        id_names.append(name)
+
+    tasks = {}
+    for _ in range(num_tasks):
+        (handle,) = struct.unpack_from("<I", blob, pos)
+        name, pos = read_name(blob, pos + 4)
+        tasks[handle] = name
+
+    if len(blob) - pos != num_events * EVENT_LEN:
+        raise ValueError("Trace dump is truncated: expected {} events".format(num_events))
+
+    events = []
+    cycles = 0
+    last_raw = None
+    for index in range(num_events):
+        raw, task, arg, event_id, event_type, _ = struct.unpack_from(EVENT_FORMAT, blob, pos + index * EVENT_LEN)
+        if last_raw is not None:
+            cycles += (raw - last_raw) & 0xFFFFFFFF
+        last_raw = raw
+        events.append((cycles, task, arg, event_id, event_type))
+
+    return clock, overwritten, id_names, tasks, events
+
+
+def to_signed(value):
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def begin_args(name, arg):
+    """Decode the argument of a begin or instant event, see trace_ring.h."""
+    if name.startswith("agent_"):
+        return {"command": AGENT_COMMANDS[arg] if arg < len(AGENT_COMMANDS) else arg}
+    if name == "spi_xfer":
+        return {"tx_waiting": arg}
+    if name.startswith("tls_"):
+        return {"length": arg}
+    if name == "ota_write_block":
+        return {"offset": arg}
+    return {"address": "0x{:08x}".format(arg)}
+
+
+def end_args(name, arg):
+    """Decode the argument of an end event, see trace_ring.h."""
+    if name.startswith("agent_"):
+        return None
+    if name == "spi_xfer":
+        return {"tx_len": arg >> 16, "rx_len": arg & 0xFFFF}
+    return {"result": to_signed(arg)}
+
+
+def to_chrome(clock, id_names, tasks, events):
+    """Build the trace event list, dropping end events whose begin was overwritten."""
+    trace = []
+    open_spans = {}
+    tids = {}
+
+    def tid_for(task):
+        if task not in tids:
+            tids[task] = len(tids) + 1
+            name = tasks.get(task, "task 0x{:08x}".format(task) if task else "(no task)")
+            trace.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tids[task], "args": {"name": name}})
+        return tids[task]
+
+    trace.append({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "stm32u5"}})
+
+    for cycles, task, arg, event_id, event_type in events:
+        name = id_names[event_id] if event_id < len(id_names) else "id_{}".format(event_id)
+        tid = tid_for(task)
+        entry = {"name": name, "cat": name.split("_")[0], "pid": 1, "tid": tid, "ts": cycles * 1e6 / clock}
+        key = (tid, event_id)
+
+        if event_type == TYPE_BEGIN:
+            open_spans[key] = open_spans.get(key, 0) + 1
+            entry["ph"] = "B"
+            entry["args"] = begin_args(name, arg)
+        elif event_type == TYPE_END:
+            if open_spans.get(key, 0) == 0:
+                continue
+            open_spans[key] -= 1
+            entry["ph"] = "E"
+            if end_args(name, arg) is not None:
+                entry["args"] = end_args(name, arg)
+        else:
+            entry["ph"] = "i"
+            entry["s"] = "t"
+            entry["args"] = begin_args(name, arg)
+
+        trace.append(entry)
+
+    return trace
+
+
+def summarize(clock, id_names, events):
+    """Duration statistics per trace point, in microseconds."""
+    stacks = {}
+    stats = {}
+
+    for cycles, task, _, event_id, event_type in events:
+        key = (task, event_id)
+        if event_type == TYPE_BEGIN:
+            stacks.setdefault(key, []).append(cycles)
+        elif event_type == TYPE_END and stacks.get(key):
+            duration = (cycles - stacks[key].pop()) * 1e6 / clock
+            count, total, peak = stats.get(event_id, (0, 0.0, 0.0))
+            stats[event_id] = (count + 1, total + duration, max(peak, duration))
+
+    lines = ["{:<16} {:>8} {:>12} {:>10} {:>10}".format("trace point", "count", "total us", "mean us", "max us")]
+    for event_id in sorted(stats):
+        count, total, peak = stats[event_id]
+        name = id_names[event_id] if event_id < len(id_names) else "id_{}".format(event_id)
+        lines.append("{:<16} {:>8} {:>12.1f} {:>10.1f} {:>10.1f}".format(name, count, total, total / count, peak))
+
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a trace ring dump to Chrome trace / Perfetto JSON.")
+    parser.add_argument("-i", "--input", required=True, help="Console log containing the output of \"trace dump\".")
+    parser.add_argument("-o", "--output", help="Path of the JSON trace to write.")
+    parser.add_argument("--summary", action="store_true", help="Print duration statistics per trace point.")
+    args = parser.parse_args()
+
+    if args.output is None and not args.summary:
+        parser.error("nothing to do, specify --output and / or --summary")
+
+    with open(args.input, "r", errors="replace") as f:
+        dumps = DUMP_RE.findall(f.read())
+
+    if len(dumps) == 0:
+        parser.error("no trace dump found in {}".format(args.input))
+
+    # Use the last dump in the log
+    blob = base64.b64decode("".join(dumps[-1].split()))
+    clock, overwritten, id_names, tasks, events = parse_dump(blob)
+
+    print("{} events over {:.3f} ms, {} older events overwritten.".format(
+        len(events), events[-1][0] * 1e3 / clock if events else 0.0, overwritten))
+
+    if args.output is not None:
+        with open(args.output, "w") as f:
+            json.dump({"traceEvents": to_chrome(clock, id_names, tasks, events), "displayTimeUnit": "ns"}, f)
+        print("Wrote {}".format(args.output))
+
+    if args.summary:
+        print(summarize(clock, id_names, events))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())